@@ -141,6 +141,10 @@
       ARG_BOOLEAN,                                                                              \
       "no",                                                                                     \
       "Compute all senone scores in every frame (can be faster when there are many senones)" }, \
+{ "-pipeline",                                                                                  \
+      ARG_BOOLEAN,                                                                              \
+      "no",                                                                                     \
+      "Process live audio on separate front end and search threads" },                          \
 { "-fwdtree",                                                                                   \
       ARG_BOOLEAN,                                                                              \
       "yes",                                                                                    \
@@ -161,6 +165,10 @@
       ARG_INT32,                                                                                \
       "5000",                                                                                   \
       "Initial backpointer table size" },                                                       \
+{ "-bpgc",                                                                                      \
+      ARG_BOOLEAN,                                                                              \
+      "no",                                                                                     \
+      "Discard unreachable backpointer entries in long utterances (not with -fwdflat)" },       \
 { "-maxwpf",                                                                                    \
       ARG_INT32,                                                                                \
       "-1",                                                                                     \
@@ -222,7 +230,15 @@
 { "-fsgusefiller",                                              \
         ARG_BOOLEAN,                                            \
         "yes",                                                  \
-        "Insert filler words at each state."}
+        "Insert filler words at each state."},                  \
+{ "-fsgminimize",                                               \
+        ARG_BOOLEAN,                                            \
+        "no",                                                   \
+        "Merge equivalent states of FSGs before searching them"}, \
+{ "-fsgcache",                                                  \
+        ARG_INT32,                                              \
+        "0",                                                    \
+        "Number of replaced FSG searches to keep for reuse if their grammar is set again"}
 
 /** Command-line options for statistical language models. */
 #define POCKETSPHINX_NGRAM_OPTIONS \
@@ -290,6 +306,14 @@
       ARG_BOOLEAN, \
       "no", \
       "Bigram-mode: If TRUE only one BP entry/frame; else one per LM state" }, \
+{ "-lmla",										\
+      ARG_BOOLEAN,									\
+      "no",										\
+      "Apply the best language model score of the words below each node of the lexicon tree (allows narrower beams)" }, \
+{ "-lmlacache",										\
+      ARG_INT32,									\
+      "32",										\
+      "Number of history words whose bigram lookahead scores are kept for -lmla (0 for unigram lookahead only)" }, \
 { "-lextreedump", \
       ARG_INT32, \
       "0", \
@@ -372,6 +396,10 @@
       ARG_STRING,                                                               \
       NULL,                                                                     \
       "Senone dump (compressed mixture weights) input file" },                  \
+{ "-amimage",                                                                   \
+      ARG_STRING,                                                               \
+      NULL,                                                                     \
+      "Precompiled acoustic model image (replaces -mdef, -tmat, -mean, etc)" }, \
 { "-mllr",                                                                      \
       ARG_STRING,                                                               \
       NULL,                                                                     \
@@ -384,6 +412,14 @@
       ARG_INT32,                                                                \
       "1",                                                                      \
       "Frame GMM computation downsampling ratio" },                             \
+{ "-simd",                                                                      \
+      ARG_STRING,                                                               \
+      "auto",                                                                   \
+      "Vector instructions for Gaussian and HMM evaluation: auto, none, sse2, avx2, neon" },\
+{ "-nthreads",                                                                  \
+      ARG_INT32,                                                                \
+      "1",                                                                      \
+      "Number of threads used to compute senone scores (continuous models only)" },\
 { "-topn",                                                                      \
       ARG_INT32,                                                                \
       "4",                                                                      \
@@ -67,6 +67,11 @@ typedef struct ps_decoder_s ps_decoder_t;
 
 #include <ps_search.h>
 
+/**
+ * PocketSphinx shared model object.
+ */
+typedef struct ps_model_s ps_model_t;
+
 /**
  * PocketSphinx N-best hypothesis iterator object.
  */
@@ -117,6 +122,70 @@ ps_decoder_t *ps_init(cmd_ln_t *config);
 POCKETSPHINX_EXPORT
 int ps_reinit(ps_decoder_t *ps, cmd_ln_t *config);
 
+/**
+ * Load model parameters which can be shared between decoders.
+ *
+ * This reads the acoustic model, dictionary and language model (if
+ * any) named in <code>config</code> once.  Any number of decoders can
+ * then be created from it with ps_init_model(), each of which only
+ * allocates its own feature computation, scoring and search state.
+ * Decoders created this way can run concurrently in different
+ * threads, though they must be created and freed from one thread at a
+ * time.  The shared parameters cannot be modified, so ps_add_word(),
+ * ps_load_dict() and ps_update_mllr() will fail on these decoders.
+ *
+ * @note The model retains a reference to <code>config</code>, so
+ * you can release your own with cmd_ln_free_r() once it is created.
+ *
+ * @param config a command-line structure, as created by
+ * cmd_ln_parse_r() or cmd_ln_parse_file_r().
+ * @return a newly created model, or NULL on failure.
+ */
+POCKETSPHINX_EXPORT
+ps_model_t *ps_model_init(cmd_ln_t *config);
+
+/**
+ * Retain a pointer to a shared model.
+ *
+ * @return pointer to retained model.
+ */
+POCKETSPHINX_EXPORT
+ps_model_t *ps_model_retain(ps_model_t *model);
+
+/**
+ * Release a pointer to a shared model.
+ *
+ * Every decoder created from the model also holds a reference to it,
+ * so it is safe to call this as soon as the decoders are created.
+ *
+ * @return New reference count (0 if freed).
+ */
+POCKETSPHINX_EXPORT
+int ps_model_free(ps_model_t *model);
+
+/**
+ * Initialize a decoder which uses shared model parameters.
+ *
+ * The decoder uses the configuration of <code>model</code>.
+ * Reinitializing it with ps_reinit() and a new configuration detaches
+ * it from the model and loads its own parameters.
+ *
+ * @param model model created with ps_model_init().
+ * @return a newly created decoder, or NULL on failure.
+ */
+POCKETSPHINX_EXPORT
+ps_decoder_t *ps_init_model(ps_model_t *model);
+
+/**
+ * Get the shared model used by this decoder.
+ *
+ * @return The model, or NULL if the decoder has its own parameters.
+ *         The decoder retains ownership of this pointer.  Use
+ *         ps_model_retain() if you wish to reuse it elsewhere.
+ */
+POCKETSPHINX_EXPORT
+ps_model_t *ps_get_model(ps_decoder_t *ps);
+
 /**
  * Returns the argument definitions used in ps_init().
  *
@@ -357,7 +426,10 @@ char const *ps_get_uttid(ps_decoder_t *ps);
  * @param full_utt If non-zero, this block of data is a full utterance
  *                 worth of data.  This may allow the recognizer to
  *                 produce more accurate results.
- * @return Number of frames of data searched, or <0 for error.
+ * @return Number of frames of data searched, or <0 for error.  With
+ *         <code>-pipeline yes</code>, live audio (neither no_search
+ *         nor full_utt) is only queued here, and this is the number of
+ *         frames searched since the previous call.
  */
 POCKETSPHINX_EXPORT
 int ps_process_raw(ps_decoder_t *ps,
@@ -386,6 +458,26 @@ int ps_process_cep(ps_decoder_t *ps,
                    int no_search,
                    int full_utt);
 
+/**
+ * Search several utterances together, one frame at a time.
+ *
+ * Each decoder should have an utterance started, with its data given
+ * to ps_process_raw() or ps_process_cep() with <code>no_search</code>
+ * set.  All of the frames available in each of them are then searched
+ * in lockstep.  Where decoders share their acoustic model (see
+ * ps_init_model()), the senones they need for a frame are scored
+ * together, which is faster for continuous models than scoring them
+ * separately, as each codebook is only read once for all of them.
+ * The results are the same.  Call ps_end_utt() on each decoder
+ * afterwards as usual.
+ *
+ * @param decoders Decoders to search.
+ * @param n_decoders Number of entries in decoders.
+ * @return Total number of frames searched, or <0 for error.
+ */
+POCKETSPHINX_EXPORT
+int ps_search_batch(ps_decoder_t **decoders, int n_decoders);
+
 /**
  * Get the number of frames of data searched.
  *
@@ -435,6 +527,34 @@ char const *ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score,
 POCKETSPHINX_EXPORT
 char const *ps_get_hyp_final(ps_decoder_t *ps, int32 *out_is_final);
 
+/**
+ * Get hypothesis string and the length of its stable part.
+ *
+ * This is meant to be called repeatedly during an utterance, for
+ * instance to show live captions.  The first characters of the
+ * hypothesis are words which all paths still considered by the
+ * search agree on, and which therefore will not change any more, so
+ * only the rest needs to be redrawn.  The N-Gram and FSG searches
+ * also only backtrace through words which changed since the previous
+ * call.
+ *
+ * @note Words are only reported as stable before the end of an
+ * utterance by the N-Gram and FSG searches, and only when no later
+ * pass (-bestpath, or -fwdflat after -fwdtree) will rescore them.
+ * Otherwise nothing is stable until ps_end_utt() has been called,
+ * after which the whole hypothesis is.
+ *
+ * @param ps Decoder.
+ * @param out_best_score Output: path score corresponding to returned string.
+ * @param out_n_stable Output: number of characters at the start of
+ *                     the returned string which will not change.
+ * @return String containing best hypothesis at this point in
+ *         decoding.  NULL if no hypothesis is available.
+ */
+POCKETSPHINX_EXPORT
+char const *ps_get_hyp_stable(ps_decoder_t *ps, int32 *out_best_score,
+                              int32 *out_n_stable);
+
 /**
  * Get posterior probability.
  *
@@ -463,7 +583,9 @@ int32 ps_get_prob(ps_decoder_t *ps, char const **out_uttid);
  *         if no hypotheses are available.  This pointer is owned by
  *         the decoder and you should not attempt to free it manually.
  *         It is only valid until the next utterance, unless you use
- *         ps_lattice_retain() to retain it.
+ *         ps_lattice_retain() to retain it.  With -pipeline, it is
+ *         safe to get it in the middle of an utterance, but not to
+ *         search it until ps_end_utt() has returned.
  */
 POCKETSPHINX_EXPORT
 ps_lattice_t *ps_get_lattice(ps_decoder_t *ps);
@@ -474,7 +596,9 @@ ps_lattice_t *ps_get_lattice(ps_decoder_t *ps);
  * @param ps Decoder.
  * @param out_best_score Output: path score corresponding to hypothesis.
  * @return Iterator over the best hypothesis at this point in
- *         decoding.  NULL if no hypothesis is available.
+ *         decoding.  NULL if no hypothesis is available.  With
+ *         -pipeline, this is a copy which does not change as the
+ *         search goes on.
  */
 POCKETSPHINX_EXPORT
 ps_seg_t *ps_seg_iter(ps_decoder_t *ps, int32 *out_best_score);
@@ -556,7 +680,8 @@ void ps_seg_free(ps_seg_t *seg);
  * @param ef End frame for N-best search (-1 for whole utterance) 
  * @param ctx1 First word of trigram context (NULL for whole utterance)
  * @param ctx2 First word of trigram context (NULL for whole utterance)
- * @return Iterator over N-best hypotheses or NULL if no hypothesis is available
+ * @return Iterator over N-best hypotheses or NULL if no hypothesis is
+ *         available, or if -pipeline is still decoding the utterance.
  */
 POCKETSPHINX_EXPORT
 ps_nbest_t *ps_nbest(ps_decoder_t *ps, int sf, int ef,
@@ -624,6 +749,58 @@ POCKETSPHINX_EXPORT
 void ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
                      double *out_ncpu, double *out_nwall);
 
+/**
+ * Performance counters for the decoder.
+ *
+ * Times are wall-clock seconds.  The stages do not overlap, so with
+ * -pipeline the front end time is spent on a separate thread from
+ * the others.
+ */
+typedef struct ps_stats_s {
+    int64 n_frame;            /**< Frames searched. */
+    int64 n_senone_eval;      /**< Senone scores computed. */
+    int64 n_codebook_eval;    /**< Gaussian codebooks evaluated. */
+    int64 n_root_hmm_eval;    /**< Lexicon tree root HMMs evaluated. */
+    int64 n_nonroot_hmm_eval; /**< Other HMMs evaluated, except word-final ones. */
+    int64 n_word_hmm_eval;    /**< Word-final and flat lexicon HMMs evaluated. */
+    int64 n_bp;               /**< Word exits entered in the backpointer table. */
+    int64 n_bp_retired;       /**< Of those, entries garbage collected. */
+    int64 n_bp_peak;          /**< Most entries in the table at once. */
+    int64 n_lm_lookup;        /**< Language model scores computed. */
+    int64 n_lm_cache_hit;     /**< Language model transitions reused instead. */
+    double t_fe;              /**< Front end (audio to cepstra). */
+    double t_feat;            /**< Dynamic features and normalization. */
+    double t_mgau;            /**< Senone scoring (split evenly among
+                                   decoders scored together by
+                                   ps_search_batch()). */
+    double t_search;          /**< Search, excluding senone scoring. */
+    double t_lattice;         /**< Hypotheses, word lattices and N-best lists. */
+} ps_stats_t;
+
+/**
+ * Get performance counters for the current utterance.
+ *
+ * Counting is always on and costs a few timer calls per frame.  This
+ * can be called at any time, including while an utterance is being
+ * processed.  Counters which do not apply to the current search are
+ * zero.
+ *
+ * @param ps Decoder.
+ * @param out_stats Output: Counters for the current (or most recent)
+ *                  utterance.
+ */
+POCKETSPHINX_EXPORT
+void ps_get_utt_stats(ps_decoder_t *ps, ps_stats_t *out_stats);
+
+/**
+ * Get performance counters for all utterances decoded so far.
+ *
+ * @param ps Decoder.
+ * @param out_stats Output: Totals, including the current utterance.
+ */
+POCKETSPHINX_EXPORT
+void ps_get_all_stats(ps_decoder_t *ps, ps_stats_t *out_stats);
+
 /**
  * Checks if the last feed audio buffer contained speech
  *
@@ -85,6 +85,42 @@ const char* ps_get_search(ps_decoder_t *ps);
 POCKETSPHINX_EXPORT
 int ps_unset_search(ps_decoder_t *ps, const char *name);
 
+/**
+ * Runs a search in parallel with the current one.
+ *
+ * The search, previously added with ps_set_fsg(), ps_set_lm(),
+ * ps_set_kws() or the like, is then started, stepped and finished along
+ * with the current search in every utterance.  Senones needed by any
+ * of them are scored only once per frame.  Use ps_get_search_hyp() to
+ * get its hypothesis.  This cannot be done during an utterance.
+ *
+ * @return 0 on success, -1 on failure
+ */
+POCKETSPHINX_EXPORT
+int ps_add_parallel_search(ps_decoder_t *ps, const char *name);
+
+/**
+ * Stops running a search in parallel with the current one.
+ *
+ * @see ps_add_parallel_search
+ * @return 0 on success, -1 on failure
+ */
+POCKETSPHINX_EXPORT
+int ps_remove_parallel_search(ps_decoder_t *ps, const char *name);
+
+/**
+ * Gets the hypothesis of the current search or of a parallel one.
+ *
+ * @see ps_get_hyp
+ * @see ps_add_parallel_search
+ * @param out_best_score Output: path score corresponding to returned string.
+ * @return String containing best hypothesis so far, or NULL if the
+ *         search is not being run.
+ */
+POCKETSPHINX_EXPORT
+char const *ps_get_search_hyp(ps_decoder_t *ps, const char *name,
+                              int32 *out_best_score);
+
 /**
  * Returns iterator over current searches 
  *
@@ -75,10 +75,72 @@ static const arg_t feat_defn[] = {
 
 static int32 acmod_process_mfcbuf(acmod_t *acmod);
 
+static int
+acmod_init_mllr(acmod_t *acmod)
+{
+    char const *mllrfn;
+
+    /* If there is an MLLR transform, apply it. */
+    if ((mllrfn = cmd_ln_str_r(acmod->config, "-mllr"))) {
+        ps_mllr_t *mllr = ps_mllr_read(mllrfn);
+        if (mllr == NULL)
+            return -1;
+        acmod_update_mllr(acmod, mllr);
+    }
+
+    return 0;
+}
+
+static int
+acmod_init_am_image(acmod_t *acmod, char const *imagefn)
+{
+    char const *mgau;
+
+    if ((acmod->image = acmod_image_read(imagefn,
+                                         cmd_ln_boolean_r(acmod->config,
+                                                          "-mmap"))) == NULL)
+        return -1;
+    /* Everything in the image is quantized in this log base. */
+    if (acmod_image_logbase(acmod->image) != logmath_get_base(acmod->lmath)) {
+        E_ERROR("Acoustic model image %s was written with log base %f, not %f\n",
+                imagefn, acmod_image_logbase(acmod->image),
+                logmath_get_base(acmod->lmath));
+        return -1;
+    }
+    /* So are the floors, which must match the ones asked for. */
+    if (acmod_image_check_floors(acmod->image, acmod->config) < 0)
+        return -1;
+    if ((acmod->mdef = bin_mdef_read_image(acmod->image)) == NULL)
+        return -1;
+    if ((acmod->tmat = tmat_init_image(acmod->image)) == NULL)
+        return -1;
+
+    mgau = acmod_image_mgau(acmod->image);
+    if (0 == strcmp(mgau, "s2_semi"))
+        acmod->mgau = s2_semi_mgau_init(acmod);
+    else if (0 == strcmp(mgau, "ptm"))
+        acmod->mgau = ptm_mgau_init(acmod, acmod->mdef);
+    else if (0 == strcmp(mgau, "ms"))
+        acmod->mgau = ms_mgau_init(acmod, acmod->lmath, acmod->mdef);
+    else
+        E_ERROR("Unknown computation module %s in %s\n", mgau, imagefn);
+    if (acmod->mgau == NULL)
+        return -1;
+
+    return 0;
+}
+
 static int
 acmod_init_am(acmod_t *acmod)
 {
-    char const *mdeffn, *tmatfn, *mllrfn, *hmmdir;
+    char const *mdeffn, *tmatfn, *imagefn, *hmmdir;
+
+    /* Use a precompiled image if we have one. */
+    if ((imagefn = cmd_ln_str_r(acmod->config, "-amimage")) != NULL) {
+        if (acmod_init_am_image(acmod, imagefn) < 0)
+            return -1;
+        return acmod_init_mllr(acmod);
+    }
 
     /* Read model definition. */
     if ((mdeffn = cmd_ln_str_r(acmod->config, "-mdef")) == NULL) {
@@ -133,15 +195,7 @@ acmod_init_am(acmod_t *acmod)
         }
     }
 
-    /* If there is an MLLR transform, apply it. */
-    if ((mllrfn = cmd_ln_str_r(acmod->config, "-mllr"))) {
-        ps_mllr_t *mllr = ps_mllr_read(mllrfn);
-        if (mllr == NULL)
-            return -1;
-        acmod_update_mllr(acmod, mllr);
-    }
-
-    return 0;
+    return acmod_init_mllr(acmod);
 }
 
 static int
@@ -233,6 +287,34 @@ acmod_feat_mismatch(acmod_t *acmod, feat_t *fcb)
     return FALSE;
 }
 
+static void
+acmod_init_buffers(acmod_t *acmod)
+{
+    /* The MFCC buffer needs to be at least as large as the dynamic
+     * feature window.  */
+    acmod->n_mfc_alloc = acmod->fcb->window_size * 2 + 1;
+    acmod->mfc_buf = (mfcc_t **)
+        ckd_calloc_2d(acmod->n_mfc_alloc, acmod->fcb->cepsize,
+                      sizeof(**acmod->mfc_buf));
+
+    /* Feature buffer has to be at least as large as MFCC buffer. */
+    acmod->n_feat_alloc = acmod->n_mfc_alloc
+        + cmd_ln_int32_r(acmod->config, "-pl_window");
+    acmod->feat_buf = feat_array_alloc(acmod->fcb, acmod->n_feat_alloc);
+    acmod->framepos = ckd_calloc(acmod->n_feat_alloc, sizeof(*acmod->framepos));
+
+    acmod->utt_start_frame = 0;
+
+    /* Senone computation stuff. */
+    acmod->senone_scores = ckd_calloc(bin_mdef_n_sen(acmod->mdef),
+                                                     sizeof(*acmod->senone_scores));
+    acmod->senone_active_vec = bitvec_alloc(bin_mdef_n_sen(acmod->mdef));
+    acmod->senone_active = ckd_calloc(bin_mdef_n_sen(acmod->mdef),
+                                                     sizeof(*acmod->senone_active));
+    acmod->log_zero = logmath_get_zero(acmod->lmath);
+    acmod->compallsen = cmd_ln_boolean_r(acmod->config, "-compallsen");
+}
+
 acmod_t *
 acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
 {
@@ -283,29 +365,46 @@ acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
     if (acmod_init_am(acmod) < 0)
         goto error_out;
 
+    acmod_init_buffers(acmod);
+    return acmod;
 
-    /* The MFCC buffer needs to be at least as large as the dynamic
-     * feature window.  */
-    acmod->n_mfc_alloc = acmod->fcb->window_size * 2 + 1;
-    acmod->mfc_buf = (mfcc_t **)
-        ckd_calloc_2d(acmod->n_mfc_alloc, acmod->fcb->cepsize,
-                      sizeof(**acmod->mfc_buf));
+error_out:
+    acmod_free(acmod);
+    return NULL;
+}
 
-    /* Feature buffer has to be at least as large as MFCC buffer. */
-    acmod->n_feat_alloc = acmod->n_mfc_alloc + cmd_ln_int32_r(config, "-pl_window");
-    acmod->feat_buf = feat_array_alloc(acmod->fcb, acmod->n_feat_alloc);
-    acmod->framepos = ckd_calloc(acmod->n_feat_alloc, sizeof(*acmod->framepos));
+acmod_t *
+acmod_copy(acmod_t *other, logmath_t *lmath)
+{
+    acmod_t *acmod;
 
-    acmod->utt_start_frame = 0;
+    if (logmath_get_base(lmath) != logmath_get_base(other->lmath)) {
+        E_ERROR("Log base %f does not match shared acoustic model (%f)\n",
+                logmath_get_base(lmath), logmath_get_base(other->lmath));
+        return NULL;
+    }
+    acmod = ckd_calloc(1, sizeof(*acmod));
+    acmod->config = cmd_ln_retain(other->config);
+    acmod->lmath = lmath;
+    acmod->state = ACMOD_IDLE;
 
-    /* Senone computation stuff. */
-    acmod->senone_scores = ckd_calloc(bin_mdef_n_sen(acmod->mdef),
-                                                     sizeof(*acmod->senone_scores));
-    acmod->senone_active_vec = bitvec_alloc(bin_mdef_n_sen(acmod->mdef));
-    acmod->senone_active = ckd_calloc(bin_mdef_n_sen(acmod->mdef),
-                                                     sizeof(*acmod->senone_active));
-    acmod->log_zero = logmath_get_zero(acmod->lmath);
-    acmod->compallsen = cmd_ln_boolean_r(config, "-compallsen");
+    /* Feature computation is stateful, so it is not shared. */
+    if ((acmod->fe = fe_init_auto_r(acmod->config)) == NULL)
+        goto error_out;
+    if (acmod_init_feat(acmod) < 0)
+        goto error_out;
+
+    /* Model parameters are shared, scoring state is not. */
+    acmod->mdef = bin_mdef_retain(other->mdef);
+    acmod->tmat = tmat_retain(other->tmat);
+    if (other->image)
+        acmod->image = acmod_image_retain(other->image);
+    if (other->mllr)
+        acmod->mllr = ps_mllr_retain(other->mllr);
+    if ((acmod->mgau = ps_mgau_copy(other->mgau)) == NULL)
+        goto error_out;
+
+    acmod_init_buffers(acmod);
     return acmod;
 
 error_out:
@@ -349,6 +448,7 @@ acmod_free(acmod_t *acmod)
         ps_mgau_free(acmod->mgau);
     if (acmod->mllr)
         ps_mllr_free(acmod->mllr);
+    acmod_image_free(acmod->image);
 
     ckd_free(acmod);
 }
@@ -356,6 +456,10 @@ acmod_free(acmod_t *acmod)
 ps_mllr_t *
 acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr)
 {
+    if (acmod->mgau->shared || acmod->mgau->refcount > 1) {
+        E_ERROR("Cannot transform acoustic model shared with other decoders\n");
+        return NULL;
+    }
     if (acmod->mllr)
         ps_mllr_free(acmod->mllr);
     acmod->mllr = mllr;
@@ -364,6 +468,30 @@ acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr)
     return mllr;
 }
 
+int
+acmod_write_image(acmod_t *acmod, const char *filename)
+{
+    acmod_image_writer_t *w;
+    FILE *fh;
+    int rv = 0;
+
+    if ((w = acmod_image_writer_init(filename, acmod->mgau->vt->name,
+                                     acmod->lmath, acmod->config)) == NULL)
+        return -1;
+    if ((fh = acmod_image_writer_section(w, "mdef")) == NULL
+        || bin_mdef_write_fh(acmod->mdef, fh) < 0)
+        rv = -1;
+    if (rv == 0 && tmat_write_image(acmod->tmat, w) < 0)
+        rv = -1;
+    if (rv == 0 && ps_mgau_write_image(acmod->mgau, w) < 0)
+        rv = -1;
+    if (acmod_image_writer_close(w) < 0)
+        rv = -1;
+    if (rv < 0)
+        E_ERROR("Failed to write acoustic model image %s\n", filename);
+    return rv;
+}
+
 int
 acmod_write_senfh_header(acmod_t *acmod, FILE *logfh)
 {
@@ -450,7 +578,12 @@ acmod_start_utt(acmod_t *acmod)
     acmod->senscr_frame = -1;
     acmod->n_senone_active = 0;
     acmod->mgau->frame_idx = 0;
+    acmod->mgau->n_codebook_eval = 0;
     acmod->rawdata_pos = 0;
+    acmod->n_senone_eval = 0;
+    ptmr_reset(&acmod->fe_perf);
+    ptmr_reset(&acmod->feat_perf);
+    ptmr_reset(&acmod->mgau_perf);
 
     return 0;
 }
@@ -529,6 +662,39 @@ acmod_log_mfc(acmod_t *acmod,
     return 0;
 }
 
+/**
+ * Run the front end on some audio, accumulating the time spent.
+ */
+static int
+acmod_fe_frames(acmod_t *acmod, int16 const **inout_raw,
+                size_t *inout_n_samps, mfcc_t **buf_cep,
+                int32 *inout_nframes, int32 *out_frameidx)
+{
+    int rv;
+
+    ptmr_start(&acmod->fe_perf);
+    rv = fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
+                           buf_cep, inout_nframes, out_frameidx);
+    ptmr_stop(&acmod->fe_perf);
+    return rv;
+}
+
+/**
+ * Compute dynamic features, accumulating the time spent.
+ */
+static int32
+acmod_feat_frames(acmod_t *acmod, mfcc_t **uttcep, int32 *inout_ncep,
+                  int32 beginutt, int32 endutt, mfcc_t ***ofeat)
+{
+    int32 nfeat;
+
+    ptmr_start(&acmod->feat_perf);
+    nfeat = feat_s2mfc2feat_live(acmod->fcb, uttcep, inout_ncep,
+                                 beginutt, endutt, ofeat);
+    ptmr_stop(&acmod->feat_perf);
+    return nfeat;
+}
+
 static int
 acmod_process_full_cep(acmod_t *acmod,
                        mfcc_t ***inout_cep,
@@ -554,8 +720,8 @@ acmod_process_full_cep(acmod_t *acmod,
         acmod->feat_outidx = 0;
     }
     /* Make dynamic features. */
-    nfr = feat_s2mfc2feat_live(acmod->fcb, *inout_cep, inout_n_frames,
-                               TRUE, TRUE, acmod->feat_buf);
+    nfr = acmod_feat_frames(acmod, *inout_cep, inout_n_frames,
+                            TRUE, TRUE, acmod->feat_buf);
     acmod->n_feat_frame = nfr;
     assert(acmod->n_feat_frame <= acmod->n_feat_alloc);
     *inout_cep += *inout_n_frames;
@@ -564,6 +730,20 @@ acmod_process_full_cep(acmod_t *acmod,
     return nfr;
 }
 
+/**
+ * Keep a copy of audio passed to the front end, and log it if requested.
+ */
+static void
+acmod_log_raw(acmod_t *acmod, int16 const *raw, size_t n_samps)
+{
+    if (n_samps + acmod->rawdata_pos < acmod->rawdata_size) {
+	memcpy(acmod->rawdata + acmod->rawdata_pos, raw, n_samps * sizeof(int16));
+	acmod->rawdata_pos += n_samps;
+    }
+    if (acmod->rawfh)
+        fwrite(raw, sizeof(int16), n_samps, acmod->rawfh);
+}
+
 static int
 acmod_process_full_raw(acmod_t *acmod,
                        int16 const **inout_raw,
@@ -573,12 +753,7 @@ acmod_process_full_raw(acmod_t *acmod,
     mfcc_t **cepptr;
 
     /* Write to logging file if any. */
-    if (*inout_n_samps + acmod->rawdata_pos < acmod->rawdata_size) {
-	memcpy(acmod->rawdata + acmod->rawdata_pos, *inout_raw, *inout_n_samps * sizeof(int16));
-	acmod->rawdata_pos += *inout_n_samps;
-    }
-    if (acmod->rawfh)
-        fwrite(*inout_raw, sizeof(int16), *inout_n_samps, acmod->rawfh);
+    acmod_log_raw(acmod, *inout_raw, *inout_n_samps);
     /* Resize mfc_buf to fit. */
     if (fe_process_frames(acmod->fe, NULL, inout_n_samps, NULL, &nfr, NULL) < 0)
         return -1;
@@ -591,8 +766,8 @@ acmod_process_full_raw(acmod_t *acmod,
     acmod->n_mfc_frame = 0;
     acmod->mfc_outidx = 0;
     fe_start_utt(acmod->fe);
-    if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                          acmod->mfc_buf, &nfr, NULL) < 0)
+    if (acmod_fe_frames(acmod, inout_raw, inout_n_samps,
+                        acmod->mfc_buf, &nfr, NULL) < 0)
         return -1;
     fe_end_utt(acmod->fe, acmod->mfc_buf[nfr], &ntail);
     nfr += ntail;
@@ -657,7 +832,6 @@ acmod_process_raw(acmod_t *acmod,
      * (in practice, there will probably be none) */
     if (inout_n_samps && *inout_n_samps) {
         int inptr;
-        int32 processed_samples;
 
         prev_audio_inptr = *inout_raw;
         /* Total number of frames available. */
@@ -668,24 +842,16 @@ acmod_process_raw(acmod_t *acmod,
         /* Write them in two (or more) parts if there is wraparound. */
         while (inptr + ncep > acmod->n_mfc_alloc) {
             int32 ncep1 = acmod->n_mfc_alloc - inptr;
-            if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                                  acmod->mfc_buf + inptr, &ncep1, &out_frameidx) < 0)
+            if (acmod_fe_frames(acmod, inout_raw, inout_n_samps,
+                                acmod->mfc_buf + inptr, &ncep1, &out_frameidx) < 0)
                 return -1;
 	    
 	    if (out_frameidx > 0)
 		acmod->utt_start_frame = out_frameidx;
 
-    	    processed_samples = *inout_raw - prev_audio_inptr;
-	    if (processed_samples + acmod->rawdata_pos < acmod->rawdata_size) {
-		memcpy(acmod->rawdata + acmod->rawdata_pos, prev_audio_inptr, processed_samples * sizeof(int16));
-		acmod->rawdata_pos += processed_samples;
-	    }
             /* Write to logging file if any. */
-            if (acmod->rawfh) {
-                fwrite(prev_audio_inptr, sizeof(int16),
-                       processed_samples,
-                       acmod->rawfh);
-            }
+            acmod_log_raw(acmod, prev_audio_inptr,
+                          *inout_raw - prev_audio_inptr);
             prev_audio_inptr = *inout_raw;
             
             /* ncep1 now contains the number of frames actually
@@ -704,23 +870,16 @@ acmod_process_raw(acmod_t *acmod,
         }
 
         assert(inptr + ncep <= acmod->n_mfc_alloc);        
-        if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                              acmod->mfc_buf + inptr, &ncep, &out_frameidx) < 0)
+        if (acmod_fe_frames(acmod, inout_raw, inout_n_samps,
+                            acmod->mfc_buf + inptr, &ncep, &out_frameidx) < 0)
             return -1;
 
 	if (out_frameidx > 0)
 	    acmod->utt_start_frame = out_frameidx;
 
 	
-	processed_samples = *inout_raw - prev_audio_inptr;
-	if (processed_samples + acmod->rawdata_pos < acmod->rawdata_size) {
-	    memcpy(acmod->rawdata + acmod->rawdata_pos, prev_audio_inptr, processed_samples * sizeof(int16));
-	    acmod->rawdata_pos += processed_samples;
-	}
-        if (acmod->rawfh) {
-            fwrite(prev_audio_inptr, sizeof(int16),
-                   processed_samples, acmod->rawfh);
-        }
+        acmod_log_raw(acmod, prev_audio_inptr,
+                      *inout_raw - prev_audio_inptr);
         prev_audio_inptr = *inout_raw;
         acmod->n_mfc_frame += ncep;
     alldone:
@@ -731,6 +890,50 @@ acmod_process_raw(acmod_t *acmod,
     return acmod_process_mfcbuf(acmod);
 }
 
+int
+acmod_fe_process_raw(acmod_t *acmod,
+                     int16 const **inout_raw,
+                     size_t *inout_n_samps,
+                     mfcc_t **cep_block,
+                     int32 *inout_n_frames)
+{
+    int16 const *prev_audio_inptr;
+    int32 out_frameidx;
+
+    prev_audio_inptr = *inout_raw;
+    if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
+                          cep_block, inout_n_frames, &out_frameidx) < 0)
+        return -1;
+    if (out_frameidx > 0)
+        acmod->utt_start_frame = out_frameidx;
+    acmod_log_raw(acmod, prev_audio_inptr, *inout_raw - prev_audio_inptr);
+
+    return *inout_n_frames;
+}
+
+int
+acmod_process_fe_cep(acmod_t *acmod,
+                     mfcc_t **cep_block,
+                     int32 n_frames)
+{
+    int32 inptr, i;
+
+    if (n_frames > acmod->n_mfc_alloc - acmod->n_mfc_frame) {
+        E_ERROR("Too many frames (%d) for cepstrum buffer (%d free)\n",
+                n_frames, acmod->n_mfc_alloc - acmod->n_mfc_frame);
+        return -1;
+    }
+    inptr = (acmod->mfc_outidx + acmod->n_mfc_frame) % acmod->n_mfc_alloc;
+    for (i = 0; i < n_frames; ++i) {
+        memcpy(acmod->mfc_buf[inptr], cep_block[i],
+               fe_get_output_size(acmod->fe) * sizeof(**cep_block));
+        inptr = (inptr + 1) % acmod->n_mfc_alloc;
+    }
+    acmod->n_mfc_frame += n_frames;
+
+    return acmod_process_mfcbuf(acmod);
+}
+
 int
 acmod_process_cep(acmod_t *acmod,
                   mfcc_t ***inout_cep,
@@ -793,11 +996,11 @@ acmod_process_cep(acmod_t *acmod,
         int32 ncep1 = acmod->n_feat_alloc - inptr;
 
         /* Make sure we don't end the utterance here. */
-        nfeat = feat_s2mfc2feat_live(acmod->fcb, *inout_cep,
-                                     &ncep1,
-                                     (acmod->state == ACMOD_STARTED),
-                                     FALSE,
-                                     acmod->feat_buf + inptr);
+        nfeat = acmod_feat_frames(acmod, *inout_cep,
+                                  &ncep1,
+                                  (acmod->state == ACMOD_STARTED),
+                                  FALSE,
+                                  acmod->feat_buf + inptr);
         if (nfeat < 0)
             return -1;
         /* Move the output feature pointer forward. */
@@ -811,11 +1014,11 @@ acmod_process_cep(acmod_t *acmod,
         ncep -= ncep1;
     }
 
-    nfeat = feat_s2mfc2feat_live(acmod->fcb, *inout_cep,
-                                 &ncep,
-                                 (acmod->state == ACMOD_STARTED),
-                                 (acmod->state == ACMOD_ENDED),
-                                 acmod->feat_buf + inptr);
+    nfeat = acmod_feat_frames(acmod, *inout_cep,
+                              &ncep,
+                              (acmod->state == ACMOD_STARTED),
+                              (acmod->state == ACMOD_ENDED),
+                              acmod->feat_buf + inptr);
     if (nfeat < 0)
         return -1;
     acmod->n_feat_frame += nfeat;
@@ -1138,6 +1341,37 @@ acmod_get_frame(acmod_t *acmod, int *inout_frame_idx)
     return acmod->feat_buf[feat_idx];
 }
 
+/* Can scores for frame_idx be reused as they are? */
+static int
+acmod_scores_cached(acmod_t *acmod, int frame_idx)
+{
+    /* If all senones are being computed, or we are using a senone file,
+       or the scores were computed for the union of several searches,
+       then we can reuse existing scores. */
+    return (acmod->compallsen || acmod->insenfh || acmod->senscr_shared)
+        && frame_idx == acmod->senscr_frame;
+}
+
+/* Record that frame_idx has been scored, and dump its scores if
+ * requested. */
+static int
+acmod_scores_done(acmod_t *acmod, int frame_idx)
+{
+    acmod->senscr_frame = frame_idx;
+
+    /* Dump scores to the senone dump file if one exists. */
+    if (acmod->senfh) {
+        if (acmod_write_scores(acmod, acmod->n_senone_active,
+                               acmod->senone_active,
+                               acmod->senone_scores,
+                               acmod->senfh) < 0)
+            return -1;
+        E_DEBUG(1,("Frame %d has %d active states\n", frame_idx,
+                   acmod->n_senone_active));
+    }
+    return 0;
+}
+
 int16 const *
 acmod_score(acmod_t *acmod, int *inout_frame_idx)
 {
@@ -1146,10 +1380,7 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
     /* Calculate the absolute frame index to be scored. */
     frame_idx = calc_frame_idx(acmod, inout_frame_idx);
 
-    /* If all senones are being computed, or we are using a senone file,
-       then we can reuse existing scores. */
-    if ((acmod->compallsen || acmod->insenfh)
-        && frame_idx == acmod->senscr_frame) {
+    if (acmod_scores_cached(acmod, frame_idx)) {
         if (inout_frame_idx)
             *inout_frame_idx = frame_idx;
         return acmod->senone_scores;
@@ -1173,6 +1404,7 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
         acmod_flags2list(acmod);
 
         /* Generate scores for the next available frame */
+        ptmr_start(&acmod->mgau_perf);
         ps_mgau_frame_eval(acmod->mgau,
                            acmod->senone_scores,
                            acmod->senone_active,
@@ -1180,24 +1412,122 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
                            acmod->feat_buf[feat_idx],
                            frame_idx,
                            acmod->compallsen);
+        ptmr_stop(&acmod->mgau_perf);
+        acmod->n_senone_eval += acmod->compallsen
+            ? bin_mdef_n_sen(acmod->mdef) : acmod->n_senone_active;
     }
 
     if (inout_frame_idx)
         *inout_frame_idx = frame_idx;
-    acmod->senscr_frame = frame_idx;
+    if (acmod_scores_done(acmod, frame_idx) < 0)
+        return NULL;
 
-    /* Dump scores to the senone dump file if one exists. */
-    if (acmod->senfh) {
-        if (acmod_write_scores(acmod, acmod->n_senone_active,
-                               acmod->senone_active,
-                               acmod->senone_scores,
-                               acmod->senfh) < 0)
-            return NULL;
-        E_DEBUG(1,("Frame %d has %d active states\n", frame_idx,
-                   acmod->n_senone_active));
+    return acmod->senone_scores;
+}
+
+acmod_batch_t *
+acmod_batch_init(int n_acmod)
+{
+    acmod_batch_t *ab;
+
+    ab = ckd_calloc(1, sizeof(*ab));
+    ab->n_alloc = n_acmod;
+    ab->acmods = ckd_calloc(n_acmod, sizeof(*ab->acmods));
+    ab->mgau = ckd_calloc(n_acmod, sizeof(*ab->mgau));
+    ab->senscr = ckd_calloc(n_acmod, sizeof(*ab->senscr));
+    ab->senone_active = ckd_calloc(n_acmod, sizeof(*ab->senone_active));
+    ab->n_senone_active = ckd_calloc(n_acmod, sizeof(*ab->n_senone_active));
+    ab->frame = ckd_calloc(n_acmod, sizeof(*ab->frame));
+    ab->feat = ckd_calloc(n_acmod, sizeof(*ab->feat));
+    return ab;
+}
+
+void
+acmod_batch_free(acmod_batch_t *ab)
+{
+    if (ab == NULL)
+        return;
+    ckd_free(ab->acmods);
+    ckd_free(ab->mgau);
+    ckd_free(ab->senscr);
+    ckd_free(ab->senone_active);
+    ckd_free(ab->n_senone_active);
+    ckd_free(ab->frame);
+    ckd_free(ab->feat);
+    ckd_free(ab);
+}
+
+int
+acmod_score_batch(acmod_batch_t *ab, acmod_t **acmods, int n_acmod,
+                  int *inout_frame_idx)
+{
+    ps_mgau_t *params;
+    ptmr_t tm;
+    int i, n, compallsen, rv;
+
+    assert(n_acmod <= ab->n_alloc);
+
+    /* Gather the frames which actually need to be evaluated. */
+    rv = 0;
+    n = 0;
+    params = NULL;
+    compallsen = acmods[0]->compallsen;
+    for (i = 0; i < n_acmod; ++i) {
+        acmod_t *acmod = acmods[i];
+        int frame_idx, feat_idx;
+
+        frame_idx = calc_frame_idx(acmod, &inout_frame_idx[i]);
+        inout_frame_idx[i] = frame_idx;
+        if (acmod_scores_cached(acmod, frame_idx))
+            continue;
+        /* Senone files and mismatched models are scored on their own. */
+        if (acmod->insenfh
+            || acmod->mgau->vt->frame_eval_batch == NULL
+            || acmod->compallsen != compallsen
+            || (params && ps_mgau_params(acmod->mgau) != params)) {
+            if (acmod_score(acmod, &inout_frame_idx[i]) == NULL)
+                rv = -1;
+            continue;
+        }
+        if ((feat_idx = calc_feat_idx(acmod, frame_idx)) < 0) {
+            rv = -1;
+            continue;
+        }
+        params = ps_mgau_params(acmod->mgau);
+        acmod_flags2list(acmod);
+        ab->mgau[n] = acmod->mgau;
+        ab->senscr[n] = acmod->senone_scores;
+        ab->senone_active[n] = acmod->senone_active;
+        ab->n_senone_active[n] = acmod->n_senone_active;
+        ab->feat[n] = acmod->feat_buf[feat_idx];
+        ab->frame[n] = frame_idx;
+        ab->acmods[n] = acmod;
+        ++n;
     }
+    if (n == 0)
+        return rv;
 
-    return acmod->senone_scores;
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    (*ab->mgau[0]->vt->frame_eval_batch)(ab->mgau, n, ab->senscr,
+                                         ab->senone_active,
+                                         ab->n_senone_active, ab->feat,
+                                         ab->frame, compallsen);
+    ptmr_stop(&tm);
+    for (i = 0; i < n; ++i) {
+        acmod_t *acmod = ab->acmods[i];
+        /* Each of them gets its share of the time. */
+        acmod->mgau_perf.t_cpu += tm.t_cpu / n;
+        acmod->mgau_perf.t_elapsed += tm.t_elapsed / n;
+        acmod->mgau_perf.t_tot_cpu += tm.t_cpu / n;
+        acmod->mgau_perf.t_tot_elapsed += tm.t_elapsed / n;
+        acmod->n_senone_eval += acmod->compallsen
+            ? bin_mdef_n_sen(acmod->mdef) : acmod->n_senone_active;
+        if (acmod_scores_done(acmod, ab->frame[i]) < 0)
+            rv = -1;
+    }
+
+    return rv;
 }
 
 int
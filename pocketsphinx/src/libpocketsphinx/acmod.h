@@ -54,12 +54,14 @@
 #include <sphinxbase/bitvec.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/prim_type.h>
+#include <sphinxbase/profile.h>
 
 /* Local headers. */
 #include "ps_mllr.h"
 #include "bin_mdef.h"
 #include "tmat.h"
 #include "hmm.h"
+#include "acmod_image.h"
 
 /**
  * States in utterance processing.
@@ -108,11 +110,27 @@ typedef struct ps_mgaufuncs_s {
     int (*transform)(ps_mgau_t *mgau,
                      ps_mllr_t *mllr);
     void (*free)(ps_mgau_t *mgau);
+    int (*write_image)(ps_mgau_t *mgau,
+                       acmod_image_writer_t *w);
+    ps_mgau_t *(*copy)(ps_mgau_t *mgau);
+    /* Optional: score one frame each for several models sharing the
+     * same parameters, in one pass over them. */
+    int (*frame_eval_batch)(ps_mgau_t **mgau,
+                            int n_mgau,
+                            int16 **senscr,
+                            uint8 **senone_active,
+                            int32 *n_senone_active,
+                            mfcc_t ***feat,
+                            int32 *frame,
+                            int32 compallsen);
 } ps_mgaufuncs_t;    
 
 struct ps_mgau_s {
     ps_mgaufuncs_t *vt;  /**< vtable of mgau functions. */
     int frame_idx;       /**< frame counter. */
+    int refcount;        /**< Reference count. */
+    ps_mgau_t *shared;   /**< Model whose parameters this one uses (or NULL). */
+    int32 n_codebook_eval; /**< Codebooks evaluated in this utterance. */
 };
 
 #define ps_mgau_base(mg) ((ps_mgau_t *)(mg))
@@ -123,6 +141,14 @@ struct ps_mgau_s {
     (*ps_mgau_base(mg)->vt->transform)(mg, mllr)
 #define ps_mgau_free(mg)                                  \
     (*ps_mgau_base(mg)->vt->free)(mg)
+#define ps_mgau_write_image(mg, w)                        \
+    (*ps_mgau_base(mg)->vt->write_image)(mg, w)
+#define ps_mgau_copy(mg)                                  \
+    (*ps_mgau_base(mg)->vt->copy)(mg)
+#define ps_mgau_retain(mg)                                \
+    (++ps_mgau_base(mg)->refcount, ps_mgau_base(mg))
+#define ps_mgau_params(mg)                                \
+    (ps_mgau_base(mg)->shared ? ps_mgau_base(mg)->shared : ps_mgau_base(mg))
 
 /**
  * Acoustic model structure.
@@ -159,6 +185,7 @@ struct acmod_s {
     bin_mdef_t *mdef;          /**< Model definition. */
     tmat_t *tmat;              /**< Transition matrices. */
     ps_mgau_t *mgau;           /**< Model parameters. */
+    acmod_image_t *image;      /**< Precompiled model image (or NULL). */
     ps_mllr_t *mllr;           /**< Speaker transformation. */
 
     /* Senone scoring: */
@@ -186,6 +213,8 @@ struct acmod_s {
     /* A whole bunch of flags and counters: */
     uint8 state;        /**< State of utterance processing. */
     uint8 compallsen;   /**< Compute all senones? */
+    uint8 senscr_shared; /**< Are senone_scores for senscr_frame shared by
+                            several searches, and thus to be reused? */
     uint8 grow_feat;    /**< Whether to grow feat_buf. */
     uint8 insen_swap;   /**< Whether to swap input senone score. */
 
@@ -198,9 +227,30 @@ struct acmod_s {
     frame_idx_t n_feat_alloc; /**< Number of frames allocated in feat_buf */
     frame_idx_t n_feat_frame; /**< Number of frames active in feat_buf */
     frame_idx_t feat_outidx;  /**< Start of active frames in feat_buf */
+
+    /* Per-utterance statistics: */
+    int32 n_senone_eval; /**< Number of senones scored. */
+    ptmr_t fe_perf;      /**< Time spent in the front end. */
+    ptmr_t feat_perf;    /**< Time spent computing dynamic features. */
+    ptmr_t mgau_perf;    /**< Time spent scoring senones. */
 };
 typedef struct acmod_s acmod_t;
 
+/**
+ * Work space for scoring frames of several acoustic models together
+ * with acmod_score_batch(), allocated once for a batch of models.
+ */
+typedef struct acmod_batch_s {
+    int n_alloc;                /**< Number of models there is room for. */
+    acmod_t **acmods;           /**< Models whose frames are scored together. */
+    ps_mgau_t **mgau;           /**< Their Gaussian models. */
+    int16 **senscr;             /**< Their output senone scores. */
+    uint8 **senone_active;      /**< Their active senone lists. */
+    int32 *n_senone_active;     /**< Number of entries in each list. */
+    int32 *frame;               /**< Frame scored in each of them. */
+    mfcc_t ***feat;             /**< Features of that frame. */
+} acmod_batch_t;
+
 /**
  * Initialize an acoustic model.
  *
@@ -219,6 +269,22 @@ typedef struct acmod_s acmod_t;
  */
 acmod_t *acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb);
 
+/**
+ * Create an acoustic model which shares parameters with another one.
+ *
+ * The model definition, transition matrices and Gaussian parameters
+ * of @a other are retained rather than copied, while the front end,
+ * feature buffers and scoring state are private to the new object.
+ * Neither object can be adapted with acmod_update_mllr() once they
+ * are shared.
+ *
+ * @param other acoustic model to share parameters with.
+ * @param lmath log-math parameters for the new object, with the same
+ *              base as those of @a other.
+ * @return a newly initialized acmod_t, or NULL on failure.
+ */
+acmod_t *acmod_copy(acmod_t *other, logmath_t *lmath);
+
 /**
  * Adapt acoustic model using a linear transform.
  *
@@ -232,6 +298,17 @@ acmod_t *acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb);
  */
 ps_mllr_t *acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr);
 
+/**
+ * Write the acoustic model parameters to an image file.
+ *
+ * The image contains the parameters exactly as they are used for
+ * computation, and can be loaded in place of the original model files
+ * with the <code>-amimage</code> option.
+ *
+ * @return 0 for success, <0 on error.
+ */
+int acmod_write_image(acmod_t *acmod, const char *filename);
+
 /**
  * Start logging senone scores to a filehandle.
  *
@@ -332,6 +409,49 @@ int acmod_process_raw(acmod_t *acmod,
                       size_t *inout_n_samps,
                       int full_utt);
 
+/**
+ * Run the front end on raw audio without buffering the output.
+ *
+ * This converts audio to cepstra as acmod_process_raw() does,
+ * including raw audio logging, but writes the cepstra to a
+ * caller-supplied block so that they can be passed to
+ * acmod_process_fe_cep() later, possibly from another thread.  It
+ * touches only the front end and the raw audio log, so it may run
+ * concurrently with feature computation and scoring.
+ *
+ * One call to acmod_process_raw() produces at most n_mfc_alloc frames
+ * and then computes features from them.  Live cepstral mean
+ * normalization depends on how frames are grouped, so to get the same
+ * features, request n_mfc_alloc frames at a time and pass each block
+ * to acmod_process_fe_cep() as it is, even if it is empty.
+ *
+ * @param inout_raw In: Pointer to buffer of raw samples
+ *                  Out: Pointer to next sample to be read
+ * @param inout_n_samps In: Number of samples available
+ *                      Out: Number of samples remaining
+ * @param cep_block Output block of cepstra
+ * @param inout_n_frames In: Number of frames available in cep_block
+ *                       Out: Number of frames written
+ * @return Number of frames written, or -1 on error.
+ */
+int acmod_fe_process_raw(acmod_t *acmod,
+                         int16 const **inout_raw,
+                         size_t *inout_n_samps,
+                         mfcc_t **cep_block,
+                         int32 *inout_n_frames);
+
+/**
+ * Compute features from a block of cepstra from acmod_fe_process_raw().
+ *
+ * @param cep_block Block of cepstra
+ * @param n_frames Number of frames in cep_block, no more than
+ *                 n_mfc_alloc minus any frames still buffered.
+ * @return Number of frames of data processed, or -1 on error.
+ */
+int acmod_process_fe_cep(acmod_t *acmod,
+                         mfcc_t **cep_block,
+                         int32 n_frames);
+
 /**
  * Feed acoustic feature data into the acoustic model for scoring.
  *
@@ -401,11 +521,42 @@ mfcc_t **acmod_get_frame(acmod_t *acmod, int *inout_frame_idx);
  *         is available for scoring (such as if a frame index is
  *         requested that is not yet or no longer available).  The
  *         data pointed to persists only until the next call to
- *         acmod_score() or acmod_advance().
+ *         acmod_score() or acmod_advance().  If senscr_shared is
+ *         set, scores already computed for the requested frame are
+ *         returned as they are, whatever senones are active now.
  */
 int16 const *acmod_score(acmod_t *acmod,
                          int *inout_frame_idx);
 
+/**
+ * Allocate work space for acmod_score_batch() on up to n_acmod models.
+ */
+acmod_batch_t *acmod_batch_init(int n_acmod);
+
+/**
+ * Free work space allocated with acmod_batch_init().
+ */
+void acmod_batch_free(acmod_batch_t *ab);
+
+/**
+ * Score one frame of data in each of several acoustic models.
+ *
+ * If the models share their parameters (see acmod_copy()) and these
+ * support it, the Gaussians for all of the frames are evaluated
+ * together, so that each codebook is only read once.  Otherwise this
+ * is the same as calling acmod_score() on each of them.  The time
+ * spent evaluating them together is split evenly between the models.
+ *
+ * @param ab Work space from acmod_batch_init() for at least n_acmod
+ *           models.
+ * @param inout_frame_idx Input: frame index to score in each model.
+ *                        Output: frame index corresponding to each
+ *                        set of scores, as for acmod_score().
+ * @return 0, or <0 if any of the frames could not be scored.
+ */
+int acmod_score_batch(acmod_batch_t *ab, acmod_t **acmods, int n_acmod,
+                      int *inout_frame_idx);
+
 /**
  * Write senone dump file header.
  */
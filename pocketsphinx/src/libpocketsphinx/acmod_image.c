@@ -0,0 +1,391 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file acmod_image.c
+ * @brief Precompiled, memory-mappable acoustic model images.
+ */
+
+/* System headers. */
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/fe.h>
+
+/* Local headers. */
+#include "acmod_image.h"
+
+#define ACMOD_IMAGE_MAGIC "PSAMIMG"
+#define ACMOD_IMAGE_BYTEORDER 0x11223344
+#define ACMOD_IMAGE_VERSION 1
+#define ACMOD_IMAGE_MAX_SECTION 8
+/* Alignment of sections in the file, a cache line. */
+#define ACMOD_IMAGE_SECTION_ALIGN 64
+
+#ifdef FIXED_POINT
+#define ACMOD_IMAGE_FIXED_POINT 1
+#else
+#define ACMOD_IMAGE_FIXED_POINT 0
+#endif
+
+/**
+ * Image file header, in native byte order.
+ */
+typedef struct acmod_image_header_s {
+    char magic[8];       /**< ACMOD_IMAGE_MAGIC */
+    int32 byteorder;     /**< ACMOD_IMAGE_BYTEORDER */
+    int32 version;       /**< ACMOD_IMAGE_VERSION */
+    int32 mfcc_size;     /**< sizeof(mfcc_t) */
+    int32 fixed_point;   /**< Nonzero for fixed-point parameters */
+    int32 n_section;     /**< Number of sections in use */
+    int32 reserved;
+    float64 logbase;     /**< Log base for all quantized values */
+    float32 varfloor;    /**< Variance floor applied */
+    float32 mixwfloor;   /**< Mixture weight floor applied */
+    float32 tmatfloor;   /**< Transition probability floor applied */
+    int32 reserved2;
+    char mgau[16];       /**< Computation module name */
+} acmod_image_header_t;
+
+/**
+ * Section table entry.
+ */
+typedef struct acmod_image_entry_s {
+    char name[16];       /**< Section name */
+    int64 offset;        /**< Offset from start of file */
+    int64 len;           /**< Length in bytes */
+} acmod_image_entry_t;
+
+struct acmod_image_s {
+    int refcount;
+    mmio_file_t *filemap;           /**< Memory map (or NULL if read) */
+    char *data;                     /**< Start of image */
+    size_t len;                     /**< Length of image */
+    acmod_image_header_t *hdr;      /**< Header (points into data) */
+    acmod_image_entry_t *sections;  /**< Section table (points into data) */
+};
+
+struct acmod_image_writer_s {
+    FILE *fh;
+    acmod_image_header_t hdr;
+    acmod_image_entry_t sections[ACMOD_IMAGE_MAX_SECTION];
+};
+
+static int
+acmod_image_check(acmod_image_t *img, const char *filename)
+{
+    acmod_image_header_t *hdr;
+    int i;
+
+    if (img->len < sizeof(*hdr)
+        + ACMOD_IMAGE_MAX_SECTION * sizeof(acmod_image_entry_t)) {
+        E_ERROR("%s is too short to be an acoustic model image\n", filename);
+        return -1;
+    }
+    hdr = img->hdr = (acmod_image_header_t *)img->data;
+    img->sections = (acmod_image_entry_t *)(img->data + sizeof(*hdr));
+    if (0 != memcmp(hdr->magic, ACMOD_IMAGE_MAGIC, sizeof(hdr->magic))) {
+        E_ERROR("%s is not an acoustic model image\n", filename);
+        return -1;
+    }
+    if (hdr->byteorder != ACMOD_IMAGE_BYTEORDER) {
+        E_ERROR("%s was written on a machine with different byte order\n",
+                filename);
+        return -1;
+    }
+    if (hdr->version != ACMOD_IMAGE_VERSION) {
+        E_ERROR("%s has version %d, expected %d\n",
+                filename, hdr->version, ACMOD_IMAGE_VERSION);
+        return -1;
+    }
+    if (hdr->mfcc_size != sizeof(mfcc_t)
+        || hdr->fixed_point != ACMOD_IMAGE_FIXED_POINT) {
+        E_ERROR("%s was written for %s-point computation\n",
+                filename, hdr->fixed_point ? "fixed" : "floating");
+        return -1;
+    }
+    if (hdr->n_section < 0 || hdr->n_section > ACMOD_IMAGE_MAX_SECTION) {
+        E_ERROR("%s has an invalid section count %d\n",
+                filename, hdr->n_section);
+        return -1;
+    }
+    if (memchr(hdr->mgau, '\0', sizeof(hdr->mgau)) == NULL) {
+        E_ERROR("%s has an invalid computation module name\n", filename);
+        return -1;
+    }
+    for (i = 0; i < hdr->n_section; ++i) {
+        acmod_image_entry_t *ent = img->sections + i;
+        if (ent->offset < 0 || ent->len < 0
+            || ent->offset % ACMOD_IMAGE_SECTION_ALIGN != 0
+            || (uint64)(ent->offset + ent->len) > img->len) {
+            E_ERROR("Section %d of %s is out of bounds\n", i, filename);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+acmod_image_t *
+acmod_image_read(const char *filename, int do_mmap)
+{
+    acmod_image_t *img;
+
+    img = ckd_calloc(1, sizeof(*img));
+    img->refcount = 1;
+    if (do_mmap) {
+        FILE *fh;
+        long len;
+
+        /* mmio doesn't tell us the size, so find it first. */
+        if ((fh = fopen(filename, "rb")) == NULL) {
+            E_ERROR_SYSTEM("Failed to open acoustic model image '%s'",
+                           filename);
+            goto error_out;
+        }
+        fseek(fh, 0, SEEK_END);
+        len = ftell(fh);
+        fclose(fh);
+        if (len < 0 || (img->filemap = mmio_file_read(filename)) == NULL)
+            goto error_out;
+        img->data = mmio_file_ptr(img->filemap);
+        img->len = len;
+        E_INFO("Mapped acoustic model image %s (%ld bytes)\n",
+               filename, len);
+    }
+    else {
+        FILE *fh;
+        long len;
+
+        if ((fh = fopen(filename, "rb")) == NULL) {
+            E_ERROR_SYSTEM("Failed to open acoustic model image '%s'",
+                           filename);
+            goto error_out;
+        }
+        fseek(fh, 0, SEEK_END);
+        len = ftell(fh);
+        fseek(fh, 0, SEEK_SET);
+        if (len < 0) {
+            fclose(fh);
+            goto error_out;
+        }
+        img->data = ckd_malloc(len);
+        img->len = len;
+        if (fread(img->data, 1, len, fh) != (size_t)len) {
+            E_ERROR_SYSTEM("Failed to read acoustic model image '%s'",
+                           filename);
+            fclose(fh);
+            goto error_out;
+        }
+        fclose(fh);
+        E_INFO("Read acoustic model image %s (%ld bytes)\n",
+               filename, len);
+    }
+    if (acmod_image_check(img, filename) < 0)
+        goto error_out;
+    return img;
+
+error_out:
+    acmod_image_free(img);
+    return NULL;
+}
+
+acmod_image_t *
+acmod_image_retain(acmod_image_t *img)
+{
+    ++img->refcount;
+    return img;
+}
+
+int
+acmod_image_free(acmod_image_t *img)
+{
+    if (img == NULL)
+        return 0;
+    if (--img->refcount > 0)
+        return img->refcount;
+    if (img->filemap)
+        mmio_file_unmap(img->filemap);
+    else
+        ckd_free(img->data);
+    ckd_free(img);
+    return 0;
+}
+
+const char *
+acmod_image_mgau(acmod_image_t *img)
+{
+    return img->hdr->mgau;
+}
+
+float64
+acmod_image_logbase(acmod_image_t *img)
+{
+    return img->hdr->logbase;
+}
+
+int
+acmod_image_check_floors(acmod_image_t *img, cmd_ln_t *config)
+{
+    static const char *names[] = { "-varfloor", "-mixwfloor", "-tmatfloor" };
+    float32 stored[3];
+    int i, rv = 0;
+
+    stored[0] = img->hdr->varfloor;
+    stored[1] = img->hdr->mixwfloor;
+    stored[2] = img->hdr->tmatfloor;
+    for (i = 0; i < 3; ++i) {
+        float32 want = cmd_ln_float32_r(config, names[i]);
+        if (stored[i] != want) {
+            E_ERROR("Acoustic model image was written with %s %g, not %g\n",
+                    names[i], stored[i], want);
+            rv = -1;
+        }
+    }
+    return rv;
+}
+
+void const *
+acmod_image_section(acmod_image_t *img, const char *name, size_t *out_len)
+{
+    int i;
+
+    for (i = 0; i < img->hdr->n_section; ++i) {
+        acmod_image_entry_t *ent = img->sections + i;
+        if (0 == strncmp(ent->name, name, sizeof(ent->name))) {
+            *out_len = (size_t)ent->len;
+            return img->data + ent->offset;
+        }
+    }
+    *out_len = 0;
+    return NULL;
+}
+
+acmod_image_writer_t *
+acmod_image_writer_init(const char *filename, const char *mgau,
+                        logmath_t *lmath, cmd_ln_t *config)
+{
+    acmod_image_writer_t *w;
+
+    w = ckd_calloc(1, sizeof(*w));
+    if ((w->fh = fopen(filename, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open '%s' for writing", filename);
+        ckd_free(w);
+        return NULL;
+    }
+    memcpy(w->hdr.magic, ACMOD_IMAGE_MAGIC, sizeof(w->hdr.magic));
+    w->hdr.byteorder = ACMOD_IMAGE_BYTEORDER;
+    w->hdr.version = ACMOD_IMAGE_VERSION;
+    w->hdr.mfcc_size = sizeof(mfcc_t);
+    w->hdr.fixed_point = ACMOD_IMAGE_FIXED_POINT;
+    w->hdr.logbase = logmath_get_base(lmath);
+    w->hdr.varfloor = cmd_ln_float32_r(config, "-varfloor");
+    w->hdr.mixwfloor = cmd_ln_float32_r(config, "-mixwfloor");
+    w->hdr.tmatfloor = cmd_ln_float32_r(config, "-tmatfloor");
+    strncpy(w->hdr.mgau, mgau, sizeof(w->hdr.mgau) - 1);
+
+    /* Reserve space for the header and section table, which will be
+     * rewritten once the sections are known. */
+    fwrite(&w->hdr, sizeof(w->hdr), 1, w->fh);
+    fwrite(w->sections, sizeof(w->sections), 1, w->fh);
+    return w;
+}
+
+static int
+acmod_image_writer_pad(acmod_image_writer_t *w, int align)
+{
+    long pos = ftell(w->fh);
+
+    while (pos % align) {
+        if (fputc(0, w->fh) == EOF)
+            return -1;
+        ++pos;
+    }
+    return 0;
+}
+
+static void
+acmod_image_writer_end_section(acmod_image_writer_t *w)
+{
+    acmod_image_entry_t *ent;
+
+    if (w->hdr.n_section == 0)
+        return;
+    ent = w->sections + w->hdr.n_section - 1;
+    ent->len = ftell(w->fh) - ent->offset;
+}
+
+FILE *
+acmod_image_writer_section(acmod_image_writer_t *w, const char *name)
+{
+    acmod_image_entry_t *ent;
+
+    acmod_image_writer_end_section(w);
+    if (w->hdr.n_section == ACMOD_IMAGE_MAX_SECTION) {
+        E_ERROR("Too many sections in acoustic model image\n");
+        return NULL;
+    }
+    if (acmod_image_writer_pad(w, ACMOD_IMAGE_SECTION_ALIGN) < 0)
+        return NULL;
+    ent = w->sections + w->hdr.n_section++;
+    strncpy(ent->name, name, sizeof(ent->name) - 1);
+    ent->offset = ftell(w->fh);
+    return w->fh;
+}
+
+int
+acmod_image_writer_align(acmod_image_writer_t *w)
+{
+    return acmod_image_writer_pad(w, ACMOD_IMAGE_ALIGN(1));
+}
+
+int
+acmod_image_writer_close(acmod_image_writer_t *w)
+{
+    int rv;
+
+    acmod_image_writer_end_section(w);
+    fseek(w->fh, 0, SEEK_SET);
+    fwrite(&w->hdr, sizeof(w->hdr), 1, w->fh);
+    fwrite(w->sections, sizeof(w->sections), 1, w->fh);
+    rv = ferror(w->fh) ? -1 : 0;
+    if (fclose(w->fh) != 0)
+        rv = -1;
+    ckd_free(w);
+    return rv;
+}
@@ -0,0 +1,176 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file acmod_image.h
+ * @brief Precompiled, memory-mappable acoustic model images.
+ *
+ * Loading an acoustic model from its usual files means parsing,
+ * byte-swapping, normalizing and quantizing each of them in every
+ * process that uses it.  An acoustic model image contains the same
+ * parameters after all of that has been done (precomputed Gaussian
+ * determinants and inverse variances, quantized mixture weights and
+ * transition probabilities, and a binary model definition), laid out
+ * so that they can be used in place from a read-only memory map.
+ * Several processes using the same image will then share its pages.
+ *
+ * An image is specific to the byte order, the log base and the
+ * fixed/floating-point configuration of the library which wrote it.
+ * Images are written with the <code>pocketsphinx_model_image</code>
+ * program and used with the <code>-amimage</code> option.
+ */
+
+#ifndef __ACMOD_IMAGE_H__
+#define __ACMOD_IMAGE_H__
+
+/* System headers. */
+#include <stdio.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/cmd_ln.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Alignment of arrays inside an image section.
+ */
+#define ACMOD_IMAGE_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+/**
+ * Acoustic model image, opened for reading.
+ */
+typedef struct acmod_image_s acmod_image_t;
+
+/**
+ * Acoustic model image, opened for writing.
+ */
+typedef struct acmod_image_writer_s acmod_image_writer_t;
+
+/**
+ * Open an acoustic model image.
+ *
+ * @param do_mmap Map the image into memory rather than reading it.
+ * @return Image object, or NULL on failure (if it does not exist or
+ * was written for an incompatible configuration).
+ */
+acmod_image_t *acmod_image_read(const char *filename, int do_mmap);
+
+/**
+ * Retain a pointer to an acoustic model image.
+ */
+acmod_image_t *acmod_image_retain(acmod_image_t *img);
+
+/**
+ * Release a pointer to an acoustic model image.
+ *
+ * @return New reference count (0 if freed).
+ */
+int acmod_image_free(acmod_image_t *img);
+
+/**
+ * Get the name of the computation module the image was written for.
+ */
+const char *acmod_image_mgau(acmod_image_t *img);
+
+/**
+ * Get the log base the image was written with.
+ */
+float64 acmod_image_logbase(acmod_image_t *img);
+
+/**
+ * Check that the floors the image was written with match a configuration.
+ *
+ * The variance, mixture weight and transition probability floors are
+ * baked into the image, so loading it with different -varfloor,
+ * -mixwfloor or -tmatfloor would silently give a different model than
+ * reading the text files would.
+ *
+ * @return 0 if they match, -1 (after logging an error) if not.
+ */
+int acmod_image_check_floors(acmod_image_t *img, cmd_ln_t *config);
+
+/**
+ * Find a section in an acoustic model image.
+ *
+ * @param out_len Output: length of the section in bytes.
+ * @return Pointer to the start of the section (aligned to at least 16
+ * bytes), or NULL if there is no such section.
+ */
+void const *acmod_image_section(acmod_image_t *img, const char *name,
+                                size_t *out_len);
+
+/**
+ * Create a new acoustic model image.
+ *
+ * @param mgau Name of the computation module the image is for.
+ * @param lmath Log math the parameters were computed with.
+ * @param config Configuration the parameters were read with (for
+ * reporting floor values only).
+ */
+acmod_image_writer_t *acmod_image_writer_init(const char *filename,
+                                              const char *mgau,
+                                              logmath_t *lmath,
+                                              cmd_ln_t *config);
+
+/**
+ * Start a new section in an image being written.
+ *
+ * @return File handle to write the section's contents to, or NULL on
+ * failure.
+ */
+FILE *acmod_image_writer_section(acmod_image_writer_t *w, const char *name);
+
+/**
+ * Pad the current section to the alignment given by ACMOD_IMAGE_ALIGN().
+ */
+int acmod_image_writer_align(acmod_image_writer_t *w);
+
+/**
+ * Finish writing an image.
+ *
+ * @return 0, or -1 if any errors occurred while writing it.
+ */
+int acmod_image_writer_close(acmod_image_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACMOD_IMAGE_H__ */
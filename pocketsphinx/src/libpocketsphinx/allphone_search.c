@@ -124,6 +124,8 @@ allphone_search_seg_iter(ps_search_t * search, int32 * out_score)
     return (ps_seg_t *) iter;
 }
 
+static void allphone_search_sen_active(ps_search_t * search, int frame_idx);
+
 static ps_searchfuncs_t allphone_funcs = {
     /* name: */ "allphone",
     /* start: */ allphone_search_start,
@@ -135,6 +137,8 @@ static ps_searchfuncs_t allphone_funcs = {
     /* hyp: */ allphone_search_hyp,
     /* prob: */ allphone_search_prob,
     /* seg_iter: */ allphone_search_seg_iter,
+    /* stats: */ NULL,
+    /* sen_active: */ allphone_search_sen_active,
 };
 
 /**
@@ -707,8 +711,9 @@ allphone_search_start(ps_search_t * search)
 }
 
 static void
-allphone_search_sen_active(allphone_search_t * allphs)
+allphone_search_sen_active(ps_search_t * search, int frame_idx)
 {
+    allphone_search_t *allphs = (allphone_search_t *) search;
     acmod_t *acmod;
     bin_mdef_t *mdef;
     phmm_t *p;
@@ -717,7 +722,6 @@ allphone_search_sen_active(allphone_search_t * allphs)
     acmod = ps_search_acmod(allphs);
     mdef = acmod->mdef;
 
-    acmod_clear_active(acmod);
     for (ci = 0; ci < bin_mdef_n_ciphone(mdef); ci++)
         for (p = allphs->ci_phmm[ci]; p; p = p->next)
             if (hmm_frame(&(p->hmm)) == allphs->frame)
@@ -732,8 +736,10 @@ allphone_search_step(ps_search_t * search, int frame_idx)
     allphone_search_t *allphs = (allphone_search_t *) search;
     acmod_t *acmod = search->acmod;
 
-    if (!acmod->compallsen)
-        allphone_search_sen_active(allphs);
+    if (!acmod->compallsen && !acmod->senscr_shared) {
+        acmod_clear_active(acmod);
+        allphone_search_sen_active(search, frame_idx);
+    }
     senscr = acmod_score(acmod, &frame_idx);
     allphs->n_sen_eval += acmod->n_senone_active;
     bestscr = phmm_eval_all(allphs, senscr);
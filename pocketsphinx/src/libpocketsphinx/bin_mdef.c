@@ -291,6 +291,7 @@ bin_mdef_free(bin_mdef_t * m)
     }
     if (m->filemap)
         mmio_file_unmap(m->filemap);
+    acmod_image_free(m->image);
     ckd_free(m->cd2cisen);
     ckd_free(m->sen2cimap);
     ckd_free(m->ciname);
@@ -319,15 +320,110 @@ static const char format_desc[] =
     "int8 sseq_len[];    /**< Number of states in each sseq (none if homogeneous) */\n"
     "END FILE FORMAT DESCRIPTION\n";
 
+/**
+ * Set up pointers into the binary data, whose start is in
+ * m->ciname[0], and build the derived mappings.
+ */
+static void
+bin_mdef_setup(bin_mdef_t *m, int swap)
+{
+    size_t tree_start;
+    int32 i, *sseq_size;
+
+    for (i = 1; i < m->n_ciphone; ++i)
+        m->ciname[i] = m->ciname[i - 1] + strlen(m->ciname[i - 1]) + 1;
+
+    /* Skip past the padding. */
+    tree_start =
+        m->ciname[i - 1] + strlen(m->ciname[i - 1]) + 1 - m->ciname[0];
+    tree_start = (tree_start + 3) & ~3;
+    m->cd_tree = (cd_tree_t *) (m->ciname[0] + tree_start);
+    if (swap) {
+        for (i = 0; i < m->n_cd_tree; ++i) {
+            SWAP_INT16(&m->cd_tree[i].ctx);
+            SWAP_INT16(&m->cd_tree[i].n_down);
+            SWAP_INT32(&m->cd_tree[i].c.down);
+        }
+    }
+    m->phone = (mdef_entry_t *) (m->cd_tree + m->n_cd_tree);
+    if (swap) {
+        for (i = 0; i < m->n_phone; ++i) {
+            SWAP_INT32(&m->phone[i].ssid);
+            SWAP_INT32(&m->phone[i].tmat);
+        }
+    }
+    sseq_size = (int32 *) (m->phone + m->n_phone);
+    if (swap)
+        SWAP_INT32(sseq_size);
+    m->sseq = ckd_calloc(m->n_sseq, sizeof(*m->sseq));
+    m->sseq[0] = (uint16 *) (sseq_size + 1);
+    if (swap) {
+        for (i = 0; i < *sseq_size; ++i)
+            SWAP_INT16(m->sseq[0] + i);
+    }
+    if (m->n_emit_state) {
+        for (i = 1; i < m->n_sseq; ++i)
+            m->sseq[i] = m->sseq[0] + i * m->n_emit_state;
+    }
+    else {
+        m->sseq_len = (uint8 *) (m->sseq[0] + *sseq_size);
+        for (i = 1; i < m->n_sseq; ++i)
+            m->sseq[i] = m->sseq[i - 1] + m->sseq_len[i - 1];
+    }
+
+    /* Now build the CD-to-CI mappings using the senone sequences.
+     * This is the only really accurate way to do it, though it is
+     * still inaccurate in the case of heterogeneous topologies or
+     * cross-state tying. */
+    m->cd2cisen = (int16 *) ckd_malloc(m->n_sen * sizeof(*m->cd2cisen));
+    m->sen2cimap = (int16 *) ckd_malloc(m->n_sen * sizeof(*m->sen2cimap));
+
+    /* Default mappings (identity, none) */
+    for (i = 0; i < m->n_ci_sen; ++i)
+        m->cd2cisen[i] = i;
+    for (; i < m->n_sen; ++i)
+        m->cd2cisen[i] = -1;
+    for (i = 0; i < m->n_sen; ++i)
+        m->sen2cimap[i] = -1;
+    for (i = 0; i < m->n_phone; ++i) {
+        int32 j, ssid = m->phone[i].ssid;
+
+        for (j = 0; j < bin_mdef_n_emit_state_phone(m, i); ++j) {
+            int s = bin_mdef_sseq2sen(m, ssid, j);
+            int ci = bin_mdef_pid2ci(m, i);
+            /* Take the first one and warn if we have cross-state tying. */
+            if (m->sen2cimap[s] == -1)
+                m->sen2cimap[s] = ci;
+            if (m->sen2cimap[s] != ci)
+                E_WARN
+                    ("Senone %d is shared between multiple base phones\n",
+                     s);
+
+            if (j > bin_mdef_n_emit_state_phone(m, ci))
+                E_WARN("CD phone %d has fewer states than CI phone %d\n",
+                       i, ci);
+            else
+                m->cd2cisen[s] =
+                    bin_mdef_sseq2sen(m, m->phone[ci].ssid, j);
+        }
+    }
+
+    /* Set the silence phone. */
+    m->sil = bin_mdef_ciphone_id(m, S3_SILENCE_CIPHONE);
+
+    E_INFO
+        ("%d CI-phone, %d CD-phone, %d emitstate/phone, %d CI-sen, %d Sen, %d Sen-Seq\n",
+         m->n_ciphone, m->n_phone - m->n_ciphone, m->n_emit_state,
+         m->n_ci_sen, m->n_sen, m->n_sseq);
+}
+
 bin_mdef_t *
 bin_mdef_read(cmd_ln_t *config, const char *filename)
 {
     bin_mdef_t *m;
     FILE *fh;
-    size_t tree_start;
-    int32 val, i, do_mmap, swap;
+    int32 val, do_mmap, swap;
     long pos, end;
-    int32 *sseq_size;
 
     /* Try to read it as text first. */
     if ((m = bin_mdef_read_text(config, filename)) != NULL)
@@ -429,92 +525,59 @@ bin_mdef_read(cmd_ln_t *config, const char *filename)
             E_FATAL("Failed to read %d bytes of data from %s\n", end - pos, filename);
     }
 
-    for (i = 1; i < m->n_ciphone; ++i)
-        m->ciname[i] = m->ciname[i - 1] + strlen(m->ciname[i - 1]) + 1;
+    bin_mdef_setup(m, swap);
+    fclose(fh);
+    return m;
+}
 
-    /* Skip past the padding. */
-    tree_start =
-        m->ciname[i - 1] + strlen(m->ciname[i - 1]) + 1 - m->ciname[0];
-    tree_start = (tree_start + 3) & ~3;
-    m->cd_tree = (cd_tree_t *) (m->ciname[0] + tree_start);
-    if (swap) {
-        for (i = 0; i < m->n_cd_tree; ++i) {
-            SWAP_INT16(&m->cd_tree[i].ctx);
-            SWAP_INT16(&m->cd_tree[i].n_down);
-            SWAP_INT32(&m->cd_tree[i].c.down);
-        }
-    }
-    m->phone = (mdef_entry_t *) (m->cd_tree + m->n_cd_tree);
-    if (swap) {
-        for (i = 0; i < m->n_phone; ++i) {
-            SWAP_INT32(&m->phone[i].ssid);
-            SWAP_INT32(&m->phone[i].tmat);
-        }
-    }
-    sseq_size = (int32 *) (m->phone + m->n_phone);
-    if (swap)
-        SWAP_INT32(sseq_size);
-    m->sseq = ckd_calloc(m->n_sseq, sizeof(*m->sseq));
-    m->sseq[0] = (uint16 *) (sseq_size + 1);
-    if (swap) {
-        for (i = 0; i < *sseq_size; ++i)
-            SWAP_INT16(m->sseq[0] + i);
-    }
-    if (m->n_emit_state) {
-        for (i = 1; i < m->n_sseq; ++i)
-            m->sseq[i] = m->sseq[0] + i * m->n_emit_state;
+bin_mdef_t *
+bin_mdef_read_image(acmod_image_t *img)
+{
+    bin_mdef_t *m;
+    void const *data;
+    int32 const *hdr;
+    size_t pos, len;
+
+    if ((data = acmod_image_section(img, "mdef", &len)) == NULL
+        || len < 3 * sizeof(int32)) {
+        E_ERROR("Acoustic model image has no model definition\n");
+        return NULL;
     }
-    else {
-        m->sseq_len = (uint8 *) (m->sseq[0] + *sseq_size);
-        for (i = 1; i < m->n_sseq; ++i)
-            m->sseq[i] = m->sseq[i - 1] + m->sseq_len[i - 1];
+    hdr = (int32 const *)data;
+    if (hdr[0] != BIN_MDEF_NATIVE_ENDIAN) {
+        E_ERROR("Model definition is not in native byte order\n");
+        return NULL;
     }
-
-    /* Now build the CD-to-CI mappings using the senone sequences.
-     * This is the only really accurate way to do it, though it is
-     * still inaccurate in the case of heterogeneous topologies or
-     * cross-state tying. */
-    m->cd2cisen = (int16 *) ckd_malloc(m->n_sen * sizeof(*m->cd2cisen));
-    m->sen2cimap = (int16 *) ckd_malloc(m->n_sen * sizeof(*m->sen2cimap));
-
-    /* Default mappings (identity, none) */
-    for (i = 0; i < m->n_ci_sen; ++i)
-        m->cd2cisen[i] = i;
-    for (; i < m->n_sen; ++i)
-        m->cd2cisen[i] = -1;
-    for (i = 0; i < m->n_sen; ++i)
-        m->sen2cimap[i] = -1;
-    for (i = 0; i < m->n_phone; ++i) {
-        int32 j, ssid = m->phone[i].ssid;
-
-        for (j = 0; j < bin_mdef_n_emit_state_phone(m, i); ++j) {
-            int s = bin_mdef_sseq2sen(m, ssid, j);
-            int ci = bin_mdef_pid2ci(m, i);
-            /* Take the first one and warn if we have cross-state tying. */
-            if (m->sen2cimap[s] == -1)
-                m->sen2cimap[s] = ci;
-            if (m->sen2cimap[s] != ci)
-                E_WARN
-                    ("Senone %d is shared between multiple base phones\n",
-                     s);
-
-            if (j > bin_mdef_n_emit_state_phone(m, ci))
-                E_WARN("CD phone %d has fewer states than CI phone %d\n",
-                       i, ci);
-            else
-                m->cd2cisen[s] =
-                    bin_mdef_sseq2sen(m, m->phone[ci].ssid, j);
-        }
+    if (hdr[1] > BIN_MDEF_FORMAT_VERSION) {
+        E_ERROR("File format version %d is newer than library\n", hdr[1]);
+        return NULL;
     }
+    /* Skip format descriptor. */
+    pos = 3 * sizeof(int32) + hdr[2];
+    if (pos + 10 * sizeof(int32) > len)
+        return NULL;
+    hdr = (int32 const *)((char const *)data + pos);
 
-    /* Set the silence phone. */
-    m->sil = bin_mdef_ciphone_id(m, S3_SILENCE_CIPHONE);
-
-    E_INFO
-        ("%d CI-phone, %d CD-phone, %d emitstate/phone, %d CI-sen, %d Sen, %d Sen-Seq\n",
-         m->n_ciphone, m->n_phone - m->n_ciphone, m->n_emit_state,
-         m->n_ci_sen, m->n_sen, m->n_sseq);
-    fclose(fh);
+    m = ckd_calloc(1, sizeof(*m));
+    m->refcnt = 1;
+    m->n_ciphone = hdr[0];
+    m->n_phone = hdr[1];
+    m->n_emit_state = hdr[2];
+    m->n_ci_sen = hdr[3];
+    m->n_sen = hdr[4];
+    m->n_tmat = hdr[5];
+    m->n_sseq = hdr[6];
+    m->n_ctx = hdr[7];
+    m->n_cd_tree = hdr[8];
+    m->sil = hdr[9];
+    pos += 10 * sizeof(int32);
+
+    /* The image owns the memory, which is never modified. */
+    m->alloc_mode = BIN_MDEF_ON_DISK;
+    m->image = acmod_image_retain(img);
+    m->ciname = ckd_calloc(m->n_ciphone, sizeof(*m->ciname));
+    m->ciname[0] = (char *)data + pos;
+    bin_mdef_setup(m, FALSE);
     return m;
 }
 
@@ -522,10 +585,23 @@ int
 bin_mdef_write(bin_mdef_t * m, const char *filename)
 {
     FILE *fh;
-    int32 val, i;
+    int rv;
 
     if ((fh = fopen(filename, "wb")) == NULL)
         return -1;
+    rv = bin_mdef_write_fh(m, fh);
+    fclose(fh);
+    return rv;
+}
+
+int
+bin_mdef_write_fh(bin_mdef_t * m, FILE *fh)
+{
+    long start;
+    int32 val, i;
+
+    /* Padding is relative to the start of the model definition. */
+    start = ftell(fh);
 
     /* Byteorder marker. */
     val = BIN_MDEF_NATIVE_ENDIAN;
@@ -563,9 +639,9 @@ bin_mdef_write(bin_mdef_t * m, const char *filename)
     for (i = 0; i < m->n_ciphone; ++i)
         fwrite(m->ciname[i], 1, strlen(m->ciname[i]) + 1, fh);
     /* Pad with zeros. */
-    val = (ftell(fh) + 3) & ~3;
+    val = (ftell(fh) - start + 3) & ~3;
     i = 0;
-    fwrite(&i, 1, val - ftell(fh), fh);
+    fwrite(&i, 1, val - (ftell(fh) - start), fh);
 
     /* Write CD-tree */
     fwrite(m->cd_tree, sizeof(*m->cd_tree), m->n_cd_tree, fh);
@@ -597,9 +673,8 @@ bin_mdef_write(bin_mdef_t * m, const char *filename)
         /* Write sseq_len */
         fwrite(m->sseq_len, 1, m->n_sseq, fh);
     }
-    fclose(fh);
 
-    return 0;
+    return ferror(fh) ? -1 : 0;
 }
 
 int
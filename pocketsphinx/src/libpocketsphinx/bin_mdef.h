@@ -55,6 +55,7 @@ extern "C" {
 #include <pocketsphinx_export.h>
 
 #include "mdef.h"
+#include "acmod_image.h"
 
 #define BIN_MDEF_FORMAT_VERSION 1
 /* Little-endian machines will write "BMDF" to disk, big-endian ones "FDMB". */
@@ -128,6 +129,7 @@ struct bin_mdef_s {
 	int16 sil;	    /**< CI phone ID for silence */
 
 	mmio_file_t *filemap;/**< File map for this file (if any) */
+	acmod_image_t *image;/**< Model image containing this (if any) */
 	char **ciname;       /**< CI phone names */
 	cd_tree_t *cd_tree;  /**< Tree mapping CD phones to phone IDs */
 	mdef_entry_t *phone; /**< All phone structures */
@@ -167,6 +169,11 @@ struct bin_mdef_s {
  */
 POCKETSPHINX_EXPORT
 bin_mdef_t *bin_mdef_read(cmd_ln_t *config, const char *filename);
+/**
+ * Read a binary mdef from an acoustic model image.  The data is used
+ * in place and a reference to the image is retained.
+ */
+bin_mdef_t *bin_mdef_read_image(acmod_image_t *img);
 /**
  * Read a text mdef from a file (creating an in-memory binary mdef).
  */
@@ -177,6 +184,10 @@ bin_mdef_t *bin_mdef_read_text(cmd_ln_t *config, const char *filename);
  */
 POCKETSPHINX_EXPORT
 int bin_mdef_write(bin_mdef_t *m, const char *filename);
+/**
+ * Write a binary mdef to an open file at its current position.
+ */
+int bin_mdef_write_fh(bin_mdef_t *m, FILE *fh);
 /**
  * Write a binary mdef to a text file.
  */
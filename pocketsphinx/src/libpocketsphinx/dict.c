@@ -84,6 +84,10 @@ dict_add_word(dict_t * d, char const *word, s3cipid_t const * p, int32 np)
     s3wid_t newwid;
     char *wword;
 
+    if (d->shared) {
+        E_ERROR("Cannot add words to a shared dictionary\n");
+        return BAD_S3WID;
+    }
     if (d->n_word >= d->max_words) {
         E_INFO("Reallocating to %d KiB for word entries\n",
                (d->max_words + S3DICT_INC_SZ) * sizeof(dictword_t) / 1024);
@@ -448,6 +452,20 @@ dict_retain(dict_t *d)
     return d;
 }
 
+dict_t *
+dict_copy(dict_t *d)
+{
+    dict_t *c;
+
+    if (d->shared)
+        return dict_copy(d->shared);
+    c = ckd_calloc(1, sizeof(*c));
+    *c = *d;
+    c->refcnt = 1;
+    c->shared = dict_retain(d);
+    return c;
+}
+
 int
 dict_free(dict_t * d)
 {
@@ -458,6 +476,11 @@ dict_free(dict_t * d)
         return 0;
     if (--d->refcnt > 0)
         return d->refcnt;
+    if (d->shared) {
+        dict_free(d->shared);
+        ckd_free(d);
+        return 0;
+    }
 
     /* First Step, free all memory allocated for each word */
     for (i = 0; i < d->n_word; i++) {
@@ -73,8 +73,11 @@ typedef struct {
     \brief a structure for a dictionary. 
 */
 
-typedef struct {
+typedef struct dict_s dict_t;
+
+struct dict_s {
     int refcnt;
+    dict_t *shared;	/**< Dictionary whose entries are used (or NULL) */
     bin_mdef_t *mdef;	/**< Model definition used for phone IDs; NULL if none used */
     dictword_t *word;	/**< Array of entries in dictionary */
     hash_table_t *ht;	/**< Hash table for mapping word strings to word ids */
@@ -86,7 +89,7 @@ typedef struct {
     s3wid_t finishwid;	/**< FOR INTERNAL-USE ONLY */
     s3wid_t silwid;	/**< FOR INTERNAL-USE ONLY */
     int nocase;
-} dict_t;
+};
 
 
 /**
@@ -194,6 +197,15 @@ int32 dict_word2basestr(char *word);
  */
 dict_t *dict_retain(dict_t *d);
 
+/**
+ * Create a dictionary which shares the entries of another one.
+ *
+ * The new object has its own reference count, so it can be retained
+ * and released from one thread without touching @a d, but no words
+ * can be added to it.
+ */
+dict_t *dict_copy(dict_t *d);
+
 /**
  * Release a pointer to a dictionary.
  */
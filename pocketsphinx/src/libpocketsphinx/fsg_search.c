@@ -50,6 +50,7 @@
 
 /* System headers. */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -73,6 +74,8 @@
 static ps_seg_t *fsg_search_seg_iter(ps_search_t *search, int32 *out_score);
 static ps_lattice_t *fsg_search_lattice(ps_search_t *search);
 static int fsg_search_prob(ps_search_t *search);
+static void fsg_search_stats(ps_search_t *search, ps_stats_t *stats);
+static void fsg_search_sen_active(ps_search_t *search, int frame_idx);
 
 static ps_searchfuncs_t fsg_funcs = {
     /* name: */   "fsg",
@@ -85,6 +88,8 @@ static ps_searchfuncs_t fsg_funcs = {
     /* hyp: */      fsg_search_hyp,
     /* prob: */     fsg_search_prob,
     /* seg_iter: */ fsg_search_seg_iter,
+    /* stats: */    fsg_search_stats,
+    /* sen_active: */ fsg_search_sen_active,
 };
 
 static int
@@ -185,7 +190,18 @@ fsg_search_init(fsg_model_t *fsg,
     fsg_search_t *fsgs = ckd_calloc(1, sizeof(*fsgs));
     ps_search_init(ps_search_base(fsgs), &fsg_funcs, config, acmod, dict, d2p);
 
-    fsgs->fsg = fsg_model_retain(fsg);
+    /* Fillers and alternate pronunciations are added to fsg below,
+     * so keep a copy of it as it was given to compare with later
+     * ones, unless it is left alone because it is minimized. */
+    fsg_search_hash(fsg, fsgs->fsg_hash);
+    if (cmd_ln_boolean_r(config, "-fsgminimize")) {
+        fsgs->fsg_given = fsg_model_retain(fsg);
+        fsg = fsgs->fsg = fsg_model_minimize(fsg);
+    }
+    else {
+        fsgs->fsg_given = fsg_model_copy(fsg);
+        fsgs->fsg = fsg_model_retain(fsg);
+    }
     /* Initialize HMM context. */
     fsgs->hmmctx = hmm_context_init(bin_mdef_n_emit_state(acmod->mdef),
                                     acmod->tmat->tp, NULL, acmod->mdef->sseq);
@@ -250,6 +266,162 @@ fsg_search_init(fsg_model_t *fsg,
     return ps_search_base(fsgs);
 }
 
+/* FNV-1a, continued from h. */
+static uint32
+fsg_hash_bytes(uint32 h, void const *data, size_t len)
+{
+    unsigned char const *p = data;
+
+    while (len--) {
+        h ^= *p++;
+        h *= 16777619;
+    }
+    return h;
+}
+
+void
+fsg_search_hash(fsg_model_t *fsg, uint32 *out_hash)
+{
+    static const uint32 seed[2] = { 2166136261u, 3323198485u };
+    int32 header[3], s;
+    int i;
+
+    header[0] = fsg_model_n_state(fsg);
+    header[1] = fsg_model_start_state(fsg);
+    header[2] = fsg_model_final_state(fsg);
+    for (i = 0; i < 2; ++i)
+        out_hash[i] = fsg_hash_bytes(seed[i], header, sizeof(header));
+
+    /* Add up the hashes of transitions, so that their order does not
+     * matter.  Words are hashed by name, not ID. */
+    for (s = 0; s < fsg_model_n_state(fsg); ++s) {
+        fsg_arciter_t *itor;
+
+        for (itor = fsg_model_arcs(fsg, s); itor;
+             itor = fsg_arciter_next(itor)) {
+            fsg_link_t *link = fsg_arciter_get(itor);
+            int32 arc[3];
+
+            arc[0] = fsg_link_from_state(link);
+            arc[1] = fsg_link_to_state(link);
+            arc[2] = fsg_link_logs2prob(link);
+            for (i = 0; i < 2; ++i) {
+                uint32 h = fsg_hash_bytes(seed[i], arc, sizeof(arc));
+                if (fsg_link_wid(link) >= 0) {
+                    char const *word = fsg_model_word_str(fsg, fsg_link_wid(link));
+                    h = fsg_hash_bytes(h, word, strlen(word));
+                    /* Fillers and alternates are compiled differently. */
+                    h = fsg_hash_bytes(h, "s",
+                                       fsg_model_is_filler(fsg, fsg_link_wid(link)) != 0);
+                    h = fsg_hash_bytes(h, "a",
+                                       fsg_model_is_alt(fsg, fsg_link_wid(link)) != 0);
+                }
+                out_hash[i] += h;
+            }
+        }
+    }
+}
+
+/* A transition, as compared by fsg_search_same_fsg(). */
+typedef struct fsg_cmp_arc_s {
+    int32 to;
+    int32 logs2prob;
+    char const *word;   /* NULL for null transitions. */
+    int32 flags;        /* 1 for fillers, 2 for alternates. */
+} fsg_cmp_arc_t;
+
+static int
+fsg_cmp_arc_cmp(void const *a, void const *b)
+{
+    fsg_cmp_arc_t const *aa = a, *bb = b;
+
+    if (aa->to != bb->to)
+        return aa->to < bb->to ? -1 : 1;
+    if (aa->logs2prob != bb->logs2prob)
+        return aa->logs2prob < bb->logs2prob ? -1 : 1;
+    if (aa->word == NULL || bb->word == NULL)
+        return (aa->word != NULL) - (bb->word != NULL);
+    if (aa->flags != bb->flags)
+        return aa->flags - bb->flags;
+    return strcmp(aa->word, bb->word);
+}
+
+/* Get the transitions out of state s, sorted, growing arcs as needed. */
+static int32
+fsg_cmp_arcs(fsg_model_t *fsg, int32 s, fsg_cmp_arc_t **arcs,
+             int32 *n_alloc)
+{
+    fsg_arciter_t *itor;
+    int32 n = 0;
+
+    for (itor = fsg_model_arcs(fsg, s); itor;
+         itor = fsg_arciter_next(itor)) {
+        fsg_link_t *link = fsg_arciter_get(itor);
+        fsg_cmp_arc_t *arc;
+        int32 wid = fsg_link_wid(link);
+
+        if (n == *n_alloc) {
+            *n_alloc = *n_alloc ? *n_alloc * 2 : 16;
+            *arcs = ckd_realloc(*arcs, *n_alloc * sizeof(**arcs));
+        }
+        arc = *arcs + n++;
+        arc->to = fsg_link_to_state(link);
+        arc->logs2prob = fsg_link_logs2prob(link);
+        arc->word = NULL;
+        arc->flags = 0;
+        if (wid >= 0) {
+            arc->word = fsg_model_word_str(fsg, wid);
+            arc->flags = (fsg_model_is_filler(fsg, wid) != 0)
+                | ((fsg_model_is_alt(fsg, wid) != 0) << 1);
+        }
+    }
+    qsort(*arcs, n, sizeof(**arcs), fsg_cmp_arc_cmp);
+    return n;
+}
+
+int
+fsg_search_same_fsg(fsg_search_t *fsgs, fsg_model_t *fsg,
+                    uint32 const *hash)
+{
+    fsg_model_t *given = fsgs->fsg_given;
+    fsg_cmp_arc_t *arcs1 = NULL, *arcs2 = NULL;
+    int32 n_alloc1 = 0, n_alloc2 = 0;
+    int32 s, same;
+
+    if (fsgs->fsg_hash[0] != hash[0] || fsgs->fsg_hash[1] != hash[1])
+        return FALSE;
+    if (given == fsg)
+        return TRUE;
+    if (fsg_model_n_state(given) != fsg_model_n_state(fsg)
+        || fsg_model_start_state(given) != fsg_model_start_state(fsg)
+        || fsg_model_final_state(given) != fsg_model_final_state(fsg))
+        return FALSE;
+
+    same = TRUE;
+    for (s = 0; same && s < fsg_model_n_state(fsg); ++s) {
+        int32 n1, n2, i;
+
+        n1 = fsg_cmp_arcs(given, s, &arcs1, &n_alloc1);
+        n2 = fsg_cmp_arcs(fsg, s, &arcs2, &n_alloc2);
+        if (n1 != n2) {
+            same = FALSE;
+            break;
+        }
+        for (i = 0; i < n1; ++i) {
+            if (fsg_cmp_arc_cmp(arcs1 + i, arcs2 + i) != 0) {
+                same = FALSE;
+                break;
+            }
+        }
+    }
+    ckd_free(arcs1);
+    ckd_free(arcs2);
+    if (!same)
+        E_WARN("Grammar %s has the same hash as %s but is different\n",
+               fsg_model_name(fsg), fsg_model_name(given));
+    return same;
+}
+
 void
 fsg_search_free(ps_search_t *search)
 {
@@ -264,6 +436,10 @@ fsg_search_free(ps_search_t *search)
     }
     hmm_context_free(fsgs->hmmctx);
     fsg_model_free(fsgs->fsg);
+    fsg_model_free(fsgs->fsg_given);
+    ckd_free(fsgs->hyp_bp);
+    ckd_free(fsgs->hyp_len);
+    bitvec_free(fsgs->hist_live);
     ckd_free(fsgs);
 }
 
@@ -295,14 +471,13 @@ fsg_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p)
 
 
 static void
-fsg_search_sen_active(fsg_search_t *fsgs)
+fsg_search_sen_active(ps_search_t *search, int frame_idx)
 {
+    fsg_search_t *fsgs = (fsg_search_t *)search;
     gnode_t *gn;
     fsg_pnode_t *pnode;
     hmm_t *hmm;
 
-    acmod_clear_active(ps_search_acmod(fsgs));
-
     for (gn = fsgs->pnode_active; gn; gn = gnode_next(gn)) {
         pnode = (fsg_pnode_t *) gnode_ptr(gn);
         hmm = fsg_pnode_hmmptr(pnode);
@@ -682,8 +857,10 @@ fsg_search_step(ps_search_t *search, int frame_idx)
     hmm_t *hmm;
 
     /* Activate our HMMs for the current frame if need be. */
-    if (!acmod->compallsen)
-        fsg_search_sen_active(fsgs);
+    if (!acmod->compallsen && !acmod->senscr_shared) {
+        acmod_clear_active(acmod);
+        fsg_search_sen_active(search, frame_idx);
+    }
     /* Compute GMM scores for the current frame. */
     senscr = acmod_score(acmod, &frame_idx);
     fsgs->n_sen_eval += acmod->n_senone_active;
@@ -776,6 +953,7 @@ fsg_search_start(ps_search_t *search)
     fsg_history_reset(fsgs->history);
     fsg_history_utt_start(fsgs->history);
     fsgs->final = FALSE;
+    fsgs->n_hyp_bp = 0;
 
     /* Dummy context structure that allows all right contexts to use this entry */
     fsg_pnode_add_all_ctxt(&ctxt);
@@ -944,14 +1122,181 @@ fsg_search_bestpath(ps_search_t *search, int32 *out_score, int backward)
     return search->last_link;
 }
 
+/*
+ * Word ID of a history entry for the hypothesis string, or -1 if it
+ * has none.
+ */
+static int32
+fsg_search_hist_wid(fsg_search_t *fsgs, int32 bp)
+{
+    fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
+    fsg_link_t *fl = fsg_hist_entry_fsglink(hist_entry);
+    int32 wid;
+
+    wid = fsg_link_wid(fl);
+    if (wid < 0 || fsg_model_is_filler(fsgs->fsg, wid))
+        return -1;
+    return dict_wordid(ps_search_dict(fsgs),
+                       fsg_model_word_str(fsgs->fsg, wid));
+}
+
+/*
+ * Backtrace from a history entry to get the hypothesis string.  As in
+ * ngram_search_bp_hyp(), only the part of the path which differs from
+ * the one of the previous hypothesis is visited.
+ */
+static char const *
+fsg_search_bp_hyp(fsg_search_t *fsgs, int32 bpidx)
+{
+    ps_search_t *search = ps_search_base(fsgs);
+    dict_t *dict = ps_search_dict(fsgs);
+    char *c;
+    int32 len, bp, i, n, n_new;
+
+    n = (search->hyp_str == NULL) ? 0 : fsgs->n_hyp_bp;
+    n_new = 0;
+    for (bp = bpidx; bp > 0;
+         bp = fsg_hist_entry_pred(fsg_history_entry_get(fsgs->history, bp))) {
+        while (n > 0 && fsgs->hyp_bp[n - 1] > bp)
+            --n;
+        if (n > 0 && fsgs->hyp_bp[n - 1] == bp)
+            break;
+        ++n_new;
+    }
+    if (bp <= 0)
+        n = 0;
+
+    if (n + n_new > fsgs->n_hyp_bp_alloc) {
+        fsgs->n_hyp_bp_alloc = (n + n_new) * 2;
+        fsgs->hyp_bp = ckd_realloc(fsgs->hyp_bp, fsgs->n_hyp_bp_alloc
+                                   * sizeof(*fsgs->hyp_bp));
+        fsgs->hyp_len = ckd_realloc(fsgs->hyp_len, fsgs->n_hyp_bp_alloc
+                                    * sizeof(*fsgs->hyp_len));
+    }
+    fsgs->n_hyp_bp = n + n_new;
+    for (i = fsgs->n_hyp_bp, bp = bpidx; i > n;
+         bp = fsg_hist_entry_pred(fsg_history_entry_get(fsgs->history, bp)))
+        fsgs->hyp_bp[--i] = bp;
+    len = (n == 0) ? 0 : fsgs->hyp_len[n - 1];
+    for (i = n; i < fsgs->n_hyp_bp; ++i) {
+        int32 wid = fsg_search_hist_wid(fsgs, fsgs->hyp_bp[i]);
+        if (wid >= 0)
+            len += strlen(dict_basestr(dict, wid)) + (len > 0);
+        fsgs->hyp_len[i] = len;
+    }
+
+    if (len == 0) {
+        ckd_free(search->hyp_str);
+        search->hyp_str = NULL;
+        return search->hyp_str;
+    }
+    search->hyp_str = ckd_realloc(search->hyp_str, len + 1);
+    c = search->hyp_str + ((n == 0) ? 0 : fsgs->hyp_len[n - 1]);
+    for (i = n; i < fsgs->n_hyp_bp; ++i) {
+        int32 wid = fsg_search_hist_wid(fsgs, fsgs->hyp_bp[i]);
+        size_t wlen;
+
+        if (wid < 0)
+            continue;
+        if (c > search->hyp_str)
+            *c++ = ' ';
+        wlen = strlen(dict_basestr(dict, wid));
+        memcpy(c, dict_basestr(dict, wid), wlen);
+        c += wlen;
+    }
+    *c = '\0';
+
+    return search->hyp_str;
+}
+
+static void
+fsg_search_mark_live(fsg_search_t *fsgs, int32 bp, int32 *n_live, int32 *max_live)
+{
+    if (bp < 0 || bitvec_is_set(fsgs->hist_live, bp))
+        return;
+    bitvec_set(fsgs->hist_live, bp);
+    ++*n_live;
+    if (bp > *max_live)
+        *max_live = bp;
+}
+
+/*
+ * Find the length of the part of the current hypothesis that all
+ * active paths agree on.  Must be called after fsg_search_bp_hyp().
+ */
+static int32
+fsg_search_hyp_stable(fsg_search_t *fsgs)
+{
+    gnode_t *gn;
+    int32 bp, n_entries, n_live, max_live, stable, frm, i;
+
+    if (fsgs->n_hyp_bp == 0)
+        return 0;
+
+    n_entries = fsg_history_n_entries(fsgs->history);
+    if (fsgs->hist_live_size < n_entries) {
+        fsgs->hist_live = bitvec_realloc(fsgs->hist_live,
+                                         fsgs->hist_live_size, n_entries * 2);
+        fsgs->hist_live_size = n_entries * 2;
+    }
+
+    /* Mark the current hypothesis, the most recent word exits and
+     * the histories of all active HMMs. */
+    n_live = 0;
+    max_live = -1;
+    fsg_search_mark_live(fsgs, fsgs->hyp_bp[fsgs->n_hyp_bp - 1],
+                         &n_live, &max_live);
+    frm = fsg_hist_entry_frame(fsg_history_entry_get(fsgs->history,
+                                                     n_entries - 1));
+    for (bp = n_entries - 1; bp > 0; --bp) {
+        if (fsg_hist_entry_frame(fsg_history_entry_get(fsgs->history, bp)) != frm)
+            break;
+        fsg_search_mark_live(fsgs, bp, &n_live, &max_live);
+    }
+    for (gn = fsgs->pnode_active; gn; gn = gnode_next(gn)) {
+        hmm_t *hmm = fsg_pnode_hmmptr((fsg_pnode_t *) gnode_ptr(gn));
+
+        for (i = 0; i < hmm_n_emit_state(hmm); ++i)
+            if (hmm_score(hmm, i) BETTER_THAN WORST_SCORE)
+                fsg_search_mark_live(fsgs, hmm_history(hmm, i),
+                                     &n_live, &max_live);
+        if (hmm_out_score(hmm) BETTER_THAN WORST_SCORE)
+            fsg_search_mark_live(fsgs, hmm_out_history(hmm),
+                                 &n_live, &max_live);
+    }
+
+    /* Walk back until all of them have merged. */
+    stable = -1;
+    for (bp = max_live; n_live > 0; --bp) {
+        int32 pbp;
+
+        if (bitvec_is_clear(fsgs->hist_live, bp))
+            continue;
+        bitvec_clear(fsgs->hist_live, bp);
+        if (n_live == 1) {
+            stable = bp;
+            break;
+        }
+        --n_live;
+        pbp = fsg_hist_entry_pred(fsg_history_entry_get(fsgs->history, bp));
+        if (pbp >= 0 && bitvec_is_clear(fsgs->hist_live, pbp)) {
+            bitvec_set(fsgs->hist_live, pbp);
+            ++n_live;
+        }
+    }
+
+    for (i = fsgs->n_hyp_bp - 1; i >= 0; --i)
+        if (fsgs->hyp_bp[i] == stable)
+            return fsgs->hyp_len[i];
+    return 0;
+}
+
 char const *
 fsg_search_hyp(ps_search_t *search, int32 *out_score, int32 *out_is_final)
 {
     fsg_search_t *fsgs = (fsg_search_t *)search;
-    dict_t *dict = ps_search_dict(search);
-    char *c;
-    size_t len;
-    int bp, bpidx;
+    char const *hyp;
+    int bpidx;
 
     /* Get last backpointer table index. */
     bpidx = fsg_search_find_exit(fsgs, fsgs->frame, fsgs->final, out_score, out_is_final);
@@ -975,56 +1320,11 @@ fsg_search_hyp(ps_search_t *search, int32 *out_score, int32 *out_is_final)
         return ps_lattice_hyp(dag, link);
     }
 
-    bp = bpidx;
-    len = 0;
-    while (bp > 0) {
-        fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
-        fsg_link_t *fl = fsg_hist_entry_fsglink(hist_entry);
-        char const *baseword;
-        int32 wid;
-
-        bp = fsg_hist_entry_pred(hist_entry);
-        wid = fsg_link_wid(fl);
-        if (wid < 0 || fsg_model_is_filler(fsgs->fsg, wid))
-            continue;
-        baseword = dict_basestr(dict,
-                                dict_wordid(dict,
-                                            fsg_model_word_str(fsgs->fsg, wid)));
-        len += strlen(baseword) + 1;
-    }
-    
-    ckd_free(search->hyp_str);
-    if (len == 0) {
-	search->hyp_str = NULL;
-	return search->hyp_str;
-    }
-    search->hyp_str = ckd_calloc(1, len);
-
-    bp = bpidx;
-    c = search->hyp_str + len - 1;
-    while (bp > 0) {
-        fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
-        fsg_link_t *fl = fsg_hist_entry_fsglink(hist_entry);
-        char const *baseword;
-        int32 wid;
-
-        bp = fsg_hist_entry_pred(hist_entry);
-        wid = fsg_link_wid(fl);
-        if (wid < 0 || fsg_model_is_filler(fsgs->fsg, wid))
-            continue;
-        baseword = dict_basestr(dict,
-                                dict_wordid(dict,
-                                            fsg_model_word_str(fsgs->fsg, wid)));
-        len = strlen(baseword);
-        c -= len;
-        memcpy(c, baseword, len);
-        if (c > search->hyp_str) {
-            --c;
-            *c = ' ';
-        }
-    }
-
-    return search->hyp_str;
+    hyp = fsg_search_bp_hyp(fsgs, bpidx);
+    /* Bestpath may still change anything. */
+    if (hyp && !fsgs->final && !fsgs->bestpath)
+        search->hyp_n_stable = fsg_search_hyp_stable(fsgs);
+    return hyp;
 }
 
 static void
@@ -1162,6 +1462,16 @@ fsg_search_prob(ps_search_t *search)
     }
 }
 
+static void
+fsg_search_stats(ps_search_t *search, ps_stats_t *stats)
+{
+    fsg_search_t *fsgs = (fsg_search_t *)search;
+
+    /* The FSG lextree does not distinguish roots from other HMMs. */
+    stats->n_nonroot_hmm_eval = fsgs->n_hmm_eval;
+    stats->n_bp = fsg_history_n_entries(fsgs->history);
+}
+
 static ps_latnode_t *
 find_node(ps_lattice_t *dag, fsg_model_t *fsg, int sf, int32 wid, int32 node_id)
 {
@@ -44,6 +44,7 @@
 /* SphinxBase headers. */
 #include <sphinxbase/glist.h>
 #include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/bitvec.h>
 #include <sphinxbase/fsg_model.h>
 
 /* Local headers. */
@@ -100,6 +101,21 @@ typedef struct fsg_search_s {
   
     int32 n_hmm_eval;		/**< Total HMMs evaluated this utt */
     int32 n_sen_eval;		/**< Total senones evaluated this utt */
+
+    int32 *hyp_bp;              /**< History entries on the path of hyp_str,
+                                     oldest first. */
+    int32 *hyp_len;             /**< Length of hyp_str up to the word in
+                                     each of them. */
+    int32 n_hyp_bp;             /**< Number of entries in hyp_bp. */
+    int32 n_hyp_bp_alloc;       /**< Number allocated in hyp_bp and hyp_len. */
+    bitvec_t *hist_live;        /**< History entries still on active paths. */
+    int32 hist_live_size;       /**< Number of bits allocated in hist_live. */
+
+    uint32 fsg_hash[2];         /**< Hash of the grammar as it was given
+                                     (see fsg_search_hash()). */
+    fsg_model_t *fsg_given;     /**< The grammar as it was given, before
+                                     minimization or fillers and
+                                     alternates were added to fsg. */
 } fsg_search_t;
 
 /* Access macros */
@@ -119,6 +135,26 @@ ps_search_t *fsg_search_init(fsg_model_t *fsg,
  */
 void fsg_search_free(ps_search_t *search);
 
+/**
+ * Compute a hash of the words, states and transitions of an FSG, to
+ * recognize a grammar that has already been compiled into a search.
+ * It does not depend on the order of words or transitions.
+ *
+ * @param out_hash Two words of hash value.
+ */
+void fsg_search_hash(fsg_model_t *fsg, uint32 *out_hash);
+
+/**
+ * Check whether a search was compiled from a grammar identical to
+ * fsg, meaning it has the same hash and, since hashes can collide,
+ * the same states and the same transitions out of each of them.
+ *
+ * @param hash Hash of fsg from fsg_search_hash().
+ * @return TRUE if it was.
+ */
+int fsg_search_same_fsg(fsg_search_t *fsgs, fsg_model_t *fsg,
+                        uint32 const *hash);
+
 /**
  * Update FSG search module for new or updated FSGs.
  */
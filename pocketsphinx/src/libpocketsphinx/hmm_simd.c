@@ -0,0 +1,373 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file hmm_simd.c
+ * @brief Vectorized Viterbi evaluation of many HMMs at once.
+ */
+
+/* System headers */
+#include <string.h>
+#include <limits.h>
+
+/* SphinxBase headers */
+#include <sphinx_config.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers */
+#include "hmm_simd.h"
+
+/*
+ * These are integer kernels, so unlike the Gaussian ones they are
+ * exact in fixed-point builds too.  As there, x86 kernels are
+ * compiled with a function-specific target and the CPU is checked at
+ * run time.
+ */
+#if (defined(__x86_64__) || defined(__i386__))                          \
+    && (defined(__clang__)                                              \
+        || (defined(__GNUC__)                                           \
+            && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HMM_SIMD_X86
+#include <immintrin.h>
+#define HMM_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define HMM_SIMD_ARM
+#include <arm_neon.h>
+#endif
+
+/*
+ * Body of a block kernel, in terms of vector primitives defined for
+ * each instruction set.  This is hmm_vit_eval_3st_lr() with every
+ * branch replaced by a select, including its quirk of falling back
+ * to the 1-3 skip score for the 0-2 transition when the latter is
+ * not allowed.
+ */
+#define HMM_SIMD_KERNEL(VEC, MASK, LANES, LOAD, STORE, SET1, ADD, GT, SEL, MAX) \
+    int i;                                                              \
+    for (i = 0; i < HMM_SIMD_BLOCK; i += LANES) {                       \
+        VEC worst = SET1(WORST_SCORE);                                  \
+        VEC tworst = SET1(TMAT_WORST_SCORE);                            \
+        VEC s0, s1, s2, h0, h1, h2, s, h, t0, t1, t2, tp, best;         \
+        MASK ex, m;                                                     \
+                                                                        \
+        s0 = ADD(LOAD(blk->score[0] + i), LOAD(blk->senscr[0] + i));    \
+        s1 = ADD(LOAD(blk->score[1] + i), LOAD(blk->senscr[1] + i));    \
+        s2 = ADD(LOAD(blk->score[2] + i), LOAD(blk->senscr[2] + i));    \
+        h0 = LOAD(blk->history[0] + i);                                 \
+        h1 = LOAD(blk->history[1] + i);                                 \
+        h2 = LOAD(blk->history[2] + i);                                 \
+                                                                        \
+        /* Transitions into non-emitting state 3 */                     \
+        ex = GT(s1, worst);                                             \
+        tp = LOAD(blk->tprob[5] + i);                                   \
+        t2 = SEL(GT(tp, tworst), ADD(s1, tp), SET1(INT_MIN));           \
+        t2 = SEL(ex, t2, SET1(INT_MIN));                                \
+        t1 = ADD(s2, LOAD(blk->tprob[7] + i));                          \
+        m = GT(t1, t2);                                                 \
+        s = MAX(SEL(m, t1, t2), worst);                                 \
+        h = SEL(m, h2, h1);                                             \
+        STORE(blk->out_score + i, SEL(ex, s, LOAD(blk->out_score + i))); \
+        STORE(blk->out_history + i,                                     \
+              SEL(ex, h, LOAD(blk->out_history + i)));                  \
+        best = SEL(ex, s, worst);                                       \
+                                                                        \
+        /* All transitions into state 2 */                              \
+        t0 = ADD(s2, LOAD(blk->tprob[6] + i));                          \
+        t1 = ADD(s1, LOAD(blk->tprob[4] + i));                          \
+        tp = LOAD(blk->tprob[2] + i);                                   \
+        t2 = SEL(GT(tp, tworst), ADD(s0, tp), t2);                      \
+        m = GT(t0, t1);                                                 \
+        s = SEL(m, t0, t1);                                             \
+        h = SEL(m, h2, h1);                                             \
+        m = GT(t2, s);                                                  \
+        s = MAX(SEL(m, t2, s), worst);                                  \
+        h = SEL(m, h0, h);                                              \
+        best = MAX(best, s);                                            \
+        STORE(blk->score[2] + i, s);                                    \
+        STORE(blk->history[2] + i, h);                                  \
+                                                                        \
+        /* All transitions into state 1 */                              \
+        t0 = ADD(s1, LOAD(blk->tprob[3] + i));                          \
+        t1 = ADD(s0, LOAD(blk->tprob[1] + i));                          \
+        m = GT(t0, t1);                                                 \
+        s = MAX(SEL(m, t0, t1), worst);                                 \
+        h = SEL(m, h1, h0);                                             \
+        best = MAX(best, s);                                            \
+        STORE(blk->score[1] + i, s);                                    \
+        STORE(blk->history[1] + i, h);                                  \
+                                                                        \
+        /* All transitions into state 0 */                              \
+        s = MAX(ADD(s0, LOAD(blk->tprob[0] + i)), worst);               \
+        best = MAX(best, s);                                            \
+        STORE(blk->score[0] + i, s);                                    \
+        STORE(blk->bestscore + i, best);                                \
+    }
+
+#ifdef HMM_SIMD_X86
+#define SSE2_LOAD(p) _mm_loadu_si128((__m128i const *)(p))
+#define SSE2_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define SSE2_SEL(m, a, b) _mm_or_si128(_mm_and_si128(m, a),     \
+                                       _mm_andnot_si128(m, b))
+#define SSE2_MAX(a, b) sse2_max(a, b)
+
+HMM_SIMD_TARGET("sse2")
+static __inline__ __m128i
+sse2_max(__m128i a, __m128i b)
+{
+    __m128i m = _mm_cmpgt_epi32(a, b);
+    return SSE2_SEL(m, a, b);
+}
+
+HMM_SIMD_TARGET("sse2")
+static void
+eval_block_sse2(hmm_simd_block_t *blk)
+{
+    HMM_SIMD_KERNEL(__m128i, __m128i, 4, SSE2_LOAD, SSE2_STORE,
+                    _mm_set1_epi32, _mm_add_epi32, _mm_cmpgt_epi32,
+                    SSE2_SEL, SSE2_MAX)
+}
+
+#define AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define AVX2_SEL(m, a, b) _mm256_blendv_epi8(b, a, m)
+
+HMM_SIMD_TARGET("avx2")
+static void
+eval_block_avx2(hmm_simd_block_t *blk)
+{
+    HMM_SIMD_KERNEL(__m256i, __m256i, 8, AVX2_LOAD, AVX2_STORE,
+                    _mm256_set1_epi32, _mm256_add_epi32, _mm256_cmpgt_epi32,
+                    AVX2_SEL, _mm256_max_epi32)
+}
+
+static int
+cpu_has(mgau_simd_type_t type)
+{
+    __builtin_cpu_init();
+    switch (type) {
+    case MGAU_SIMD_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case MGAU_SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+    default:
+        return FALSE;
+    }
+}
+#endif /* HMM_SIMD_X86 */
+
+#ifdef HMM_SIMD_ARM
+#define NEON_SEL(m, a, b) vbslq_s32(m, a, b)
+
+static void
+eval_block_neon(hmm_simd_block_t *blk)
+{
+    HMM_SIMD_KERNEL(int32x4_t, uint32x4_t, 4, vld1q_s32, vst1q_s32,
+                    vdupq_n_s32, vaddq_s32, vcgtq_s32, NEON_SEL, vmaxq_s32)
+}
+#endif /* HMM_SIMD_ARM */
+
+static int
+hmm_simd_supported(mgau_simd_type_t type)
+{
+    switch (type) {
+    case MGAU_SIMD_NONE:
+        return TRUE;
+#ifdef HMM_SIMD_X86
+    case MGAU_SIMD_SSE2:
+    case MGAU_SIMD_AVX2:
+        return cpu_has(type);
+#endif
+#ifdef HMM_SIMD_ARM
+    case MGAU_SIMD_NEON:
+        return TRUE;
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+static hmm_simd_block_f
+hmm_simd_kernel(mgau_simd_type_t type)
+{
+    switch (type) {
+#ifdef HMM_SIMD_X86
+    case MGAU_SIMD_SSE2:
+        return eval_block_sse2;
+    case MGAU_SIMD_AVX2:
+        return eval_block_avx2;
+#endif
+#ifdef HMM_SIMD_ARM
+    case MGAU_SIMD_NEON:
+        return eval_block_neon;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+/* Offsets of the transitions in hmm_simd_block_t::tprob in a 3x4
+ * transition matrix. */
+static const int tprob_idx[8] = { 0, 1, 2, 5, 6, 7, 10, 11 };
+
+hmm_simd_t *
+hmm_simd_init(char const *name, hmm_context_t *ctx, int32 n_tmat)
+{
+    hmm_simd_t *simd;
+    int type, i, j;
+
+    if (ctx->n_emit_state != 3) {
+        E_INFO("Using scalar HMM evaluation for %d-state HMMs\n",
+               ctx->n_emit_state);
+        return NULL;
+    }
+    if (name == NULL || 0 == strcmp(name, "auto")) {
+        if (hmm_simd_supported(MGAU_SIMD_AVX2))
+            type = MGAU_SIMD_AVX2;
+        else if (hmm_simd_supported(MGAU_SIMD_SSE2))
+            type = MGAU_SIMD_SSE2;
+        else if (hmm_simd_supported(MGAU_SIMD_NEON))
+            type = MGAU_SIMD_NEON;
+        else
+            type = MGAU_SIMD_NONE;
+    }
+    else {
+        if ((type = mgau_simd_parse(name)) < 0) {
+            E_WARN("Unknown SIMD kernel %s, using scalar code\n", name);
+            return NULL;
+        }
+        if (!hmm_simd_supported(type)) {
+            E_WARN("SIMD kernel %s not supported on this machine, "
+                   "using scalar code\n", name);
+            return NULL;
+        }
+    }
+    if (type == MGAU_SIMD_NONE) {
+        E_INFO("Using scalar HMM evaluation\n");
+        return NULL;
+    }
+
+    simd = ckd_calloc(1, sizeof(*simd));
+    simd->type = type;
+    simd->eval_block = hmm_simd_kernel(type);
+    simd->bestscore = WORST_SCORE;
+    /* Widen and negate the transition matrices once and for all. */
+    simd->n_tmat = n_tmat;
+    simd->tprob = ckd_calloc(n_tmat * 8, sizeof(*simd->tprob));
+    for (i = 0; i < n_tmat; ++i)
+        for (j = 0; j < 8; ++j)
+            simd->tprob[i * 8 + j] = -ctx->tp[i][0][tprob_idx[j]];
+    E_INFO("Using %s HMM evaluation (%d HMMs per block)\n",
+           mgau_simd_name(type), HMM_SIMD_BLOCK);
+    return simd;
+}
+
+void
+hmm_simd_start(hmm_simd_t *simd)
+{
+    simd->n_hmm = 0;
+    simd->bestscore = WORST_SCORE;
+}
+
+void
+hmm_simd_add(hmm_simd_t *simd, hmm_t *hmm)
+{
+    hmm_simd_block_t *blk = &simd->blk;
+    int16 const *senscore;
+    int32 const *tprob;
+    int n, j;
+
+    if (hmm_is_mpx(hmm) || hmm_n_emit_state(hmm) != 3) {
+        int32 score = hmm_vit_eval(hmm);
+        if (score BETTER_THAN simd->bestscore)
+            simd->bestscore = score;
+        return;
+    }
+
+    n = simd->n_hmm;
+    senscore = hmm->ctx->senscore;
+    tprob = simd->tprob + hmm->tmatid * 8;
+    for (j = 0; j < 3; ++j) {
+        blk->score[j][n] = hmm_score(hmm, j);
+        blk->history[j][n] = hmm_history(hmm, j);
+        blk->senscr[j][n] = -senscore[hmm_nonmpx_senid(hmm, j)];
+    }
+    for (j = 0; j < 8; ++j)
+        blk->tprob[j][n] = tprob[j];
+    blk->out_score[n] = hmm_out_score(hmm);
+    blk->out_history[n] = hmm_out_history(hmm);
+    simd->hmm[n] = hmm;
+    if (++simd->n_hmm == HMM_SIMD_BLOCK)
+        hmm_simd_finish(simd);
+}
+
+int32
+hmm_simd_finish(hmm_simd_t *simd)
+{
+    hmm_simd_block_t *blk = &simd->blk;
+    int n, j;
+
+    if (simd->n_hmm == 0)
+        return simd->bestscore;
+
+    /* Unused lanes are evaluated too, on stale but harmless data. */
+    (*simd->eval_block)(blk);
+    for (n = 0; n < simd->n_hmm; ++n) {
+        hmm_t *hmm = simd->hmm[n];
+
+        for (j = 0; j < 3; ++j) {
+            hmm_score(hmm, j) = blk->score[j][n];
+            hmm_history(hmm, j) = blk->history[j][n];
+        }
+        hmm_out_score(hmm) = blk->out_score[n];
+        hmm_out_history(hmm) = blk->out_history[n];
+        hmm_bestscore(hmm) = blk->bestscore[n];
+        if (blk->bestscore[n] BETTER_THAN simd->bestscore)
+            simd->bestscore = blk->bestscore[n];
+    }
+    simd->n_hmm = 0;
+    return simd->bestscore;
+}
+
+void
+hmm_simd_free(hmm_simd_t *simd)
+{
+    if (simd == NULL)
+        return;
+    ckd_free(simd->tprob);
+    ckd_free(simd);
+}
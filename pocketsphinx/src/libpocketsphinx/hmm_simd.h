@@ -0,0 +1,155 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file hmm_simd.h
+ * @brief Vectorized Viterbi evaluation of many HMMs at once.
+ *
+ * hmm_vit_eval() updates one HMM at a time, and most of its cost is
+ * in data-dependent branches that the CPU cannot predict.  Here,
+ * HMMs are instead queued up in blocks, their state scores,
+ * histories, senone scores and transition probabilities are copied
+ * into structure-of-arrays lanes, and the whole block is updated
+ * with branch-free vector instructions before the results are
+ * written back.  Each lane performs exactly the same integer
+ * operations as hmm_vit_eval(), so scores and histories are
+ * identical.
+ *
+ * Only non-multiplex 3-state left-to-right HMMs (i.e. the non-root
+ * and last-phone channels of the lexicon tree with the usual
+ * topology) are vectorized.  Anything else is passed through to
+ * hmm_vit_eval().  The kernel is chosen with the <code>-simd</code>
+ * option, like the one for Gaussian evaluation.
+ */
+
+#ifndef __HMM_SIMD_H__
+#define __HMM_SIMD_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+/* Local headers. */
+#include "hmm.h"
+#include "tied_mgau_simd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of HMMs evaluated by one call to a block kernel.
+ */
+#define HMM_SIMD_BLOCK 8
+
+/**
+ * Structure-of-arrays copy of a block of 3-state HMMs.
+ *
+ * Transition scores are stored negated (as log probabilities), in the
+ * order 0-0, 0-1, 0-2, 1-1, 1-2, 1-3, 2-2, 2-3.
+ */
+typedef struct hmm_simd_block_s {
+    int32 score[3][HMM_SIMD_BLOCK];   /**< State scores. */
+    int32 history[3][HMM_SIMD_BLOCK]; /**< State histories. */
+    int32 senscr[3][HMM_SIMD_BLOCK];  /**< Senone scores (log probabilities). */
+    int32 tprob[8][HMM_SIMD_BLOCK];   /**< Transition scores. */
+    int32 out_score[HMM_SIMD_BLOCK];  /**< Exit state score. */
+    int32 out_history[HMM_SIMD_BLOCK]; /**< Exit state history. */
+    int32 bestscore[HMM_SIMD_BLOCK];  /**< Output: best state score. */
+} hmm_simd_block_t;
+
+/**
+ * Update a block of HMMs in place.
+ */
+typedef void (*hmm_simd_block_f)(hmm_simd_block_t *blk);
+
+/**
+ * Queue of HMMs waiting to be evaluated.
+ */
+typedef struct hmm_simd_s {
+    mgau_simd_type_t type;     /**< Kernel in use. */
+    hmm_simd_block_f eval_block; /**< Block kernel. */
+    hmm_t *hmm[HMM_SIMD_BLOCK]; /**< HMMs in the current block. */
+    int32 n_hmm;               /**< Number of HMMs in the current block. */
+    int32 bestscore;           /**< Best score since hmm_simd_start(). */
+    int32 n_tmat;              /**< Number of transition matrices. */
+    int32 *tprob;              /**< Transition scores for each matrix, in
+                                  the same order as in hmm_simd_block_t. */
+    hmm_simd_block_t blk;      /**< Staging area for the current block. */
+} hmm_simd_t;
+
+/**
+ * Create a queue for vectorized HMM evaluation.
+ *
+ * @param name Requested kernel, as for <code>-simd</code>, or "auto"
+ *             to use the best available.
+ * @param ctx HMM context whose HMMs will be evaluated.
+ * @param n_tmat Number of transition matrices in ctx.
+ * @return Newly allocated object, or NULL if vectorized evaluation is
+ *         disabled or not available, or the HMMs do not have 3 states
+ *         (the caller then uses hmm_vit_eval() directly).
+ */
+hmm_simd_t *hmm_simd_init(char const *name, hmm_context_t *ctx, int32 n_tmat);
+
+/**
+ * Start evaluating a set of HMMs.
+ */
+void hmm_simd_start(hmm_simd_t *simd);
+
+/**
+ * Queue an HMM for evaluation.
+ *
+ * Its scores are only valid after the next call to hmm_simd_finish().
+ * The HMMs must all share the same hmm_context_t.
+ */
+void hmm_simd_add(hmm_simd_t *simd, hmm_t *hmm);
+
+/**
+ * Evaluate any HMMs still queued.
+ *
+ * @return Best score of all HMMs added since hmm_simd_start().
+ */
+int32 hmm_simd_finish(hmm_simd_t *simd);
+
+/**
+ * Release a queue.
+ */
+void hmm_simd_free(hmm_simd_t *simd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HMM_SIMD_H__ */
@@ -37,6 +37,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -51,7 +52,7 @@
 
 /** Access macros */
 #define hmm_is_active(hmm) ((hmm)->frame > 0)
-#define kws_nth_hmm(keyword,n) (&((keyword)->hmms[n]))
+#define kws_nth_hmm(kwss,n) (&((kwss)->nodes[n].hmm))
 
 static ps_lattice_t *
 kws_search_lattice(ps_search_t * search)
@@ -126,6 +127,8 @@ kws_search_seg_iter(ps_search_t * search, int32 * out_score)
     return (ps_seg_t *)itor;
 }
 
+static void kws_search_sen_active(ps_search_t *search, int frame_idx);
+
 static ps_searchfuncs_t kws_funcs = {
     /* name: */ "kws",
     /* start: */ kws_search_start,
@@ -137,6 +140,8 @@ static ps_searchfuncs_t kws_funcs = {
     /* hyp: */ kws_search_hyp,
     /* prob: */ kws_search_prob,
     /* seg_iter: */ kws_search_seg_iter,
+    /* stats: */ NULL,
+    /* sen_active: */ kws_search_sen_active,
 };
 
 /* Scans the dictionary and check if all words are present. */
@@ -175,24 +180,19 @@ kws_search_check_dict(kws_search_t * kwss)
 
 /* Activate senones for scoring */
 static void
-kws_search_sen_active(kws_search_t * kwss)
+kws_search_sen_active(ps_search_t * search, int frame_idx)
 {
-    int i, keyword_iter;
-
-    acmod_clear_active(ps_search_acmod(kwss));
+    kws_search_t *kwss = (kws_search_t *) search;
+    int i;
 
     /* active phone loop hmms */
     for (i = 0; i < kwss->n_pl; i++)
         acmod_activate_hmm(ps_search_acmod(kwss), &kwss->pl_hmms[i]);
 
     /* activate hmms in active nodes */
-    for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
-        kws_keyword_t *keyword = &kwss->keyphrases[keyword_iter];
-        for (i = 0; i < keyword->n_hmms; i++) {
-            if (hmm_is_active(kws_nth_hmm(keyword, i)))
-                acmod_activate_hmm(ps_search_acmod(kwss), kws_nth_hmm(keyword, i));
-        }
-    }
+    for (i = 0; i < kwss->n_active; i++)
+        acmod_activate_hmm(ps_search_acmod(kwss),
+                           kws_nth_hmm(kwss, kwss->active[i]));
 }
 
 /*
@@ -202,7 +202,7 @@ kws_search_sen_active(kws_search_t * kwss)
 static void
 kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
 {
-    int32 i, keyword_iter;
+    int32 i;
     int32 bestscore = WORST_SCORE;
 
     hmm_context_set_senscore(kwss->hmmctx, senscr);
@@ -217,18 +217,13 @@ kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
             bestscore = score;
     }
     /* evaluate hmms for active nodes */
-    for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
-        kws_keyword_t *keyword = &kwss->keyphrases[keyword_iter];
-        for (i = 0; i < keyword->n_hmms; i++) {
-            hmm_t *hmm = kws_nth_hmm(keyword, i);
-
-            if (hmm_is_active(hmm)) {
-                int32 score;
-                score = hmm_vit_eval(hmm);
-                if (score BETTER_THAN bestscore)
-                    bestscore = score;
-            }
-        }
+    for (i = 0; i < kwss->n_active; i++) {
+        hmm_t *hmm = kws_nth_hmm(kwss, kwss->active[i]);
+        int32 score;
+
+        score = hmm_vit_eval(hmm);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
     }
 
     kwss->bestscore = bestscore;
@@ -241,18 +236,35 @@ kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
 static void
 kws_search_hmm_prune(kws_search_t * kwss)
 {
-    int32 thresh, i, keyword_iter;
+    int32 thresh, i, n;
 
     thresh = kwss->bestscore + kwss->beam;
 
-    for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
-        kws_keyword_t *keyword = &kwss->keyphrases[keyword_iter];
-        for (i = 0; i < keyword->n_hmms; i++) {
-    	    hmm_t *hmm = kws_nth_hmm(keyword, i);
-            if (hmm_is_active(hmm) && hmm_bestscore(hmm) < thresh)
-                hmm_clear(hmm);
-        }
+    for (i = n = 0; i < kwss->n_active; i++) {
+        hmm_t *hmm = kws_nth_hmm(kwss, kwss->active[i]);
+        if (hmm_bestscore(hmm) < thresh)
+            hmm_clear(hmm);
+        else
+            kwss->active[n++] = kwss->active[i];
     }
+    kwss->n_active = n;
+}
+
+/* Enter a node, adding it to the active list if it was inactive. */
+static void
+kws_search_enter(kws_search_t * kwss, int32 nid, int32 score, int32 hist)
+{
+    hmm_t *hmm = kws_nth_hmm(kwss, nid);
+
+    if (!hmm_is_active(hmm))
+        kwss->active[kwss->n_active++] = nid;
+    hmm_enter(hmm, score, hist, kwss->frame + 1);
+}
+
+static int
+kws_cmp_int32(const void *a, const void *b)
+{
+    return *(const int32 *)a - *(const int32 *)b;
 }
 
 
@@ -264,8 +276,7 @@ kws_search_trans(kws_search_t * kwss)
 {
     hmm_t *pl_best_hmm = NULL;
     int32 best_out_score = WORST_SCORE;
-    int i, keyword_iter;
-    uint8 to_clear;
+    int i, n_active, n_spotted;
 
     /* select best hmm in phone-loop to be a predecessor */
     for (i = 0; i < kwss->n_pl; i++)
@@ -279,38 +290,38 @@ kws_search_trans(kws_search_t * kwss)
         return;
 
     /* Check whether keyword wasn't spotted yet */
-    to_clear = FALSE;
-    for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
-        kws_keyword_t *keyword;
-        hmm_t *last_hmm;
-        
-        keyword = &kwss->keyphrases[keyword_iter];
-        last_hmm = kws_nth_hmm(keyword, keyword->n_hmms - 1);
-        if (hmm_is_active(last_hmm)
-            && hmm_out_score(pl_best_hmm) BETTER_THAN WORST_SCORE) {
-            
-            if (hmm_out_score(last_hmm) - hmm_out_score(pl_best_hmm) 
-                >= keyword->threshold) {
-
-                int32 prob = hmm_out_score(last_hmm) - hmm_out_score(pl_best_hmm) - 
-                             keyword->threshold;
-                kws_detections_add(kwss->detections, keyword->word, 
-                                  hmm_out_history(last_hmm), 
-                                  kwss->frame, prob, 
-                                  hmm_out_score(last_hmm));
-                to_clear = TRUE;
-            } /* keyword is spotted */
-        } /* last hmm of keyword is active */
-    } /* keywords loop */
-
-    if (to_clear) {
-        for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
-            kws_keyword_t* keyword = &kwss->keyphrases[keyword_iter];
-            for (i = 0; i < keyword->n_hmms; i++) {
-                hmm_clear(kws_nth_hmm(keyword, i));
-            }
+    n_spotted = 0;
+    for (i = 0; i < kwss->n_active; i++) {
+        kws_node_t *node = &kwss->nodes[kwss->active[i]];
+        int32 kid;
+
+        for (kid = node->keyphrase; kid != -1;
+             kid = kwss->keyphrases[kid].next) {
+            if (hmm_out_score(&node->hmm) - hmm_out_score(pl_best_hmm)
+                >= kwss->keyphrases[kid].threshold)
+                kwss->spotted[n_spotted++] = kid;
         }
-    } /* clear all keywords because something was spotted */
+    }
+
+    if (n_spotted) {
+        /* Report them in the order of the keyphrase list. */
+        qsort(kwss->spotted, n_spotted, sizeof(*kwss->spotted),
+              kws_cmp_int32);
+        for (i = 0; i < n_spotted; i++) {
+            kws_keyword_t *keyword = &kwss->keyphrases[kwss->spotted[i]];
+            hmm_t *last_hmm = kws_nth_hmm(kwss, keyword->node);
+            int32 prob = hmm_out_score(last_hmm) - hmm_out_score(pl_best_hmm) -
+                         keyword->threshold;
+            kws_detections_add(kwss->detections, keyword->word,
+                               hmm_out_history(last_hmm),
+                               kwss->frame, prob,
+                               hmm_out_score(last_hmm));
+        }
+        /* clear all keywords because something was spotted */
+        for (i = 0; i < kwss->n_active; i++)
+            hmm_clear(kws_nth_hmm(kwss, kwss->active[i]));
+        kwss->n_active = 0;
+    }
 
     /* Make transition for all phone loop hmms */
     for (i = 0; i < kwss->n_pl; i++) {
@@ -322,28 +333,29 @@ kws_search_trans(kws_search_t * kwss)
         }
     }
 
-    /* Activate new keyword nodes, enter their hmms */
-    for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
-        kws_keyword_t *keyword = &kwss->keyphrases[keyword_iter];
-        for (i = keyword->n_hmms - 1; i > 0; i--) {
-            hmm_t *pred_hmm = kws_nth_hmm(keyword, i - 1);
-	    hmm_t *hmm = kws_nth_hmm(keyword, i);
-
-            if (hmm_is_active(pred_hmm)) {    
-                if (!hmm_is_active(hmm)
-                    || hmm_out_score(pred_hmm) BETTER_THAN
-                    hmm_in_score(hmm))
-                        hmm_enter(hmm, hmm_out_score(pred_hmm),
-                                  hmm_out_history(pred_hmm), kwss->frame + 1);
-            }
+    /* Activate successors of the nodes which survived pruning, nodes
+     * entered here are only propagated in the next frame */
+    n_active = kwss->n_active;
+    for (i = 0; i < n_active; i++) {
+        hmm_t *pred_hmm = kws_nth_hmm(kwss, kwss->active[i]);
+        int32 nid;
+
+        for (nid = kwss->nodes[kwss->active[i]].child; nid != -1;
+             nid = kwss->nodes[nid].sibling) {
+            if (hmm_out_score(pred_hmm) BETTER_THAN
+                hmm_in_score(kws_nth_hmm(kwss, nid)))
+                kws_search_enter(kwss, nid, hmm_out_score(pred_hmm),
+                                 hmm_out_history(pred_hmm));
         }
+    }
 
-        /* Enter keyword start node from phone loop */
+    /* Enter keyword start nodes from phone loop */
+    for (i = kwss->root; i != -1; i = kwss->nodes[i].sibling) {
         if (hmm_out_score(pl_best_hmm) BETTER_THAN
-            hmm_in_score(kws_nth_hmm(keyword, 0)))
-                hmm_enter(kws_nth_hmm(keyword, 0), hmm_out_score(pl_best_hmm),
-                    kwss->frame, kwss->frame + 1);
-    } /* keywords loop */
+            hmm_in_score(kws_nth_hmm(kwss, i)))
+            kws_search_enter(kwss, i, hmm_out_score(pl_best_hmm),
+                             kwss->frame);
+    }
 }
 
 static int
@@ -454,6 +466,58 @@ kws_search_init(const char *keyphrase,
     return ps_search_base(kwss);
 }
 
+static void
+kws_search_free_tree(kws_search_t * kwss)
+{
+    int32 i;
+
+    for (i = 0; i < kwss->n_nodes; i++)
+        hmm_deinit(kws_nth_hmm(kwss, i));
+    ckd_free(kwss->nodes);
+    ckd_free(kwss->active);
+    ckd_free(kwss->spotted);
+    kwss->nodes = NULL;
+    kwss->active = NULL;
+    kwss->spotted = NULL;
+    kwss->n_nodes = kwss->n_active = 0;
+    kwss->root = -1;
+}
+
+/*
+ * Find the successor of a node (or a start node if pred is -1) with
+ * the given senone sequence and transition matrix, adding it if there
+ * is none. Keyphrases sharing their first phones thus share nodes.
+ */
+static int32
+kws_search_add_node(kws_search_t * kwss, int32 pred, int32 ssid,
+                    int32 tmatid, int32 * n_alloc)
+{
+    int32 *first, nid;
+
+    first = (pred == -1) ? &kwss->root : &kwss->nodes[pred].child;
+    for (nid = *first; nid != -1; nid = kwss->nodes[nid].sibling) {
+        hmm_t *hmm = kws_nth_hmm(kwss, nid);
+        if (hmm_nonmpx_ssid(hmm) == ssid && hmm_tmatid(hmm) == tmatid)
+            return nid;
+    }
+
+    if (kwss->n_nodes == *n_alloc) {
+        *n_alloc = *n_alloc ? *n_alloc * 2 : 256;
+        kwss->nodes = (kws_node_t *) ckd_realloc(kwss->nodes,
+                                                 *n_alloc * sizeof(*kwss->nodes));
+        /* The predecessor list head may have moved. */
+        first = (pred == -1) ? &kwss->root : &kwss->nodes[pred].child;
+    }
+    nid = kwss->n_nodes++;
+    hmm_init(kwss->hmmctx, kws_nth_hmm(kwss, nid), FALSE, ssid, tmatid);
+    kwss->nodes[nid].child = -1;
+    kwss->nodes[nid].keyphrase = -1;
+    /* Prepend, the order of successors does not matter. */
+    kwss->nodes[nid].sibling = *first;
+    *first = nid;
+    return nid;
+}
+
 void
 kws_search_free(ps_search_t * search)
 {
@@ -464,11 +528,11 @@ kws_search_free(ps_search_t * search)
     ps_search_deinit(search);
     hmm_context_free(kwss->hmmctx);
     kws_detections_reset(kwss->detections);
+    ckd_free(kwss->detections);
     ckd_free(kwss->pl_hmms);
-    for (i = 0; i < kwss->n_keyphrases; i++) {
-        ckd_free(kwss->keyphrases[i].hmms);
+    kws_search_free_tree(kwss);
+    for (i = 0; i < kwss->n_keyphrases; i++)
         ckd_free(kwss->keyphrases[i].word);
-    }
     ckd_free(kwss->keyphrases);
     ckd_free(kwss);
 }
@@ -479,9 +543,9 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
     char **wrdptr;
     char *tmp_keyphrase;
     int32 wid, pronlen;
-    int32 n_hmms, n_wrds;
+    int32 n_wrds, n_alloc;
     int32 ssid, tmatid;
-    int i, j, p, keyword_iter;
+    int i, p, keyword_iter;
     kws_search_t *kwss = (kws_search_t *) search;
     bin_mdef_t *mdef = search->acmod->mdef;
     int32 silcipid = bin_mdef_silphone(mdef);
@@ -515,31 +579,18 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
                  bin_mdef_pid2tmatid(search->acmod->mdef, i));
     }
 
+    /* Build the prefix tree of keyphrase HMMs. */
+    kws_search_free_tree(kwss);
+    n_alloc = 0;
     for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
         kws_keyword_t *keyword = &kwss->keyphrases[keyword_iter];
+        int32 nid = -1;
 
-        /* Initialize keyphrase HMMs */
         tmp_keyphrase = (char *) ckd_salloc(keyword->word);
         n_wrds = str2words(tmp_keyphrase, NULL, 0);
         wrdptr = (char **) ckd_calloc(n_wrds, sizeof(*wrdptr));
         str2words(tmp_keyphrase, wrdptr, n_wrds);
 
-        /* count amount of hmms */
-        n_hmms = 0;
-        for (i = 0; i < n_wrds; i++) {
-            wid = dict_wordid(dict, wrdptr[i]);
-            pronlen = dict_pronlen(dict, wid);
-            n_hmms += pronlen;
-        }
-
-        /* allocate node array */
-        if (keyword->hmms)
-            ckd_free(keyword->hmms);
-        keyword->hmms = (hmm_t *) ckd_calloc(n_hmms, sizeof(hmm_t));
-        keyword->n_hmms = n_hmms;
-
-        /* fill node array */
-        j = 0;
         for (i = 0; i < n_wrds; i++) {
             wid = dict_wordid(dict, wrdptr[i]);
             pronlen = dict_pronlen(dict, wid);
@@ -563,15 +614,28 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
                     ssid = dict2pid_internal(d2p, wid, p);
                 }
                 tmatid = bin_mdef_pid2tmatid(mdef, ci);
-                hmm_init(kwss->hmmctx, &keyword->hmms[j], FALSE, ssid,
-                         tmatid);
-                j++;
+                nid = kws_search_add_node(kwss, nid, ssid, tmatid, &n_alloc);
             }
         }
 
+        /* Keep keyphrases ending in the same node in list order. */
+        keyword->node = nid;
+        keyword->next = -1;
+        if (nid != -1) {
+            int32 *last = &kwss->nodes[nid].keyphrase;
+            while (*last != -1)
+                last = &kwss->keyphrases[*last].next;
+            *last = keyword_iter;
+        }
+
         ckd_free(wrdptr);
         ckd_free(tmp_keyphrase);
     }
+    kwss->active = (int32 *) ckd_calloc(kwss->n_nodes + 1,
+                                        sizeof(*kwss->active));
+    kwss->spotted = (int32 *) ckd_calloc(kwss->n_keyphrases + 1,
+                                         sizeof(*kwss->spotted));
+    E_INFO("%d keyphrases in %d HMMs\n", kwss->n_keyphrases, kwss->n_nodes);
 
     return 0;
 }
@@ -586,6 +650,11 @@ kws_search_start(ps_search_t * search)
     kwss->bestscore = 0;
     kws_detections_reset(kwss->detections);
 
+    /* Nothing is left over from the previous utterance. */
+    for (i = 0; i < kwss->n_active; ++i)
+        hmm_clear(kws_nth_hmm(kwss, kwss->active[i]));
+    kwss->n_active = 0;
+
     /* Reset and enter all phone-loop HMMs. */
     for (i = 0; i < kwss->n_pl; ++i) {
         hmm_t *hmm = (hmm_t *) & kwss->pl_hmms[i];
@@ -603,8 +672,10 @@ kws_search_step(ps_search_t * search, int frame_idx)
     acmod_t *acmod = search->acmod;
 
     /* Activate senones */
-    if (!acmod->compallsen)
-        kws_search_sen_active(kwss);
+    if (!acmod->compallsen && !acmod->senscr_shared) {
+        acmod_clear_active(acmod);
+        kws_search_sen_active(search, frame_idx);
+    }
 
     /* Calculate senone scores for current frame. */
     senscr = acmod_score(acmod, &frame_idx);
@@ -59,10 +59,20 @@ typedef struct kws_seg_s {
 typedef struct kws_keyword_s {
     char* word;
     int32 threshold;
-    hmm_t* hmms;
-    int32 n_hmms;
+    int32 node;          /**< Node for the last phone, or -1 if empty. */
+    int32 next;          /**< Next keyphrase ending in the same node, or -1. */
 } kws_keyword_t;
 
+/**
+ * Node of the phonetic prefix tree shared by all keyphrases.
+ */
+typedef struct kws_node_s {
+    hmm_t hmm;           /**< HMM for this phone in its context. */
+    int32 child;         /**< First successor node, or -1. */
+    int32 sibling;       /**< Next node with the same predecessor, or -1. */
+    int32 keyphrase;     /**< First keyphrase ending in this node, or -1. */
+} kws_node_t;
+
 /**
  * Implementation of KWS search structure.
  */
@@ -74,6 +84,12 @@ typedef struct kws_search_s {
     kws_detections_t *detections; /**< Keyword spotting history */
     kws_keyword_t* keyphrases;   /**< Keyphrases to spot */
     int n_keyphrases;             /**< Keyphrases amount */
+    kws_node_t *nodes;            /**< Prefix tree of keyphrase HMMs */
+    int32 n_nodes;                /**< Number of nodes in the tree */
+    int32 root;                   /**< First node entered from phone loop */
+    int32 *active;                /**< Nodes with active HMMs */
+    int32 n_active;               /**< Number of active nodes */
+    int32 *spotted;               /**< Keyphrases spotted in this frame */
     frame_idx_t frame;            /**< Frame index */
 
     int32 beam;
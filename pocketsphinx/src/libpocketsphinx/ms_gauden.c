@@ -395,22 +395,150 @@ gauden_init(char const *meanfile, char const *varfile, float32 varfloor, logmath
     return g;
 }
 
+/*
+ * Release the parameters, which may either have been read from files
+ * or point into an acoustic model image.
+ */
+static void
+gauden_free_params(gauden_t * g)
+{
+    if (g->image) {
+        /* Only the pointer arrays belong to us. */
+        ckd_free_3d(g->mean);
+        ckd_free_3d(g->var);
+        ckd_free_3d_ptr(g->det);
+        acmod_image_free(g->image);
+        g->image = NULL;
+    }
+    else {
+        if (g->mean)
+            gauden_param_free(g->mean);
+        if (g->var)
+            gauden_param_free(g->var);
+        if (g->det)
+            ckd_free_3d(g->det);
+    }
+    if (g->featlen)
+        ckd_free(g->featlen);
+    g->mean = NULL;
+    g->var = NULL;
+    g->det = NULL;
+    g->featlen = NULL;
+}
+
 void
 gauden_free(gauden_t * g)
 {
     if (g == NULL)
         return;
-    if (g->mean)
-        gauden_param_free(g->mean);
-    if (g->var)
-        gauden_param_free(g->var);
-    if (g->det)
-        ckd_free_3d(g->det);
-    if (g->featlen)
-        ckd_free(g->featlen);
+    gauden_free_params(g);
     ckd_free(g);
 }
 
+/*
+ * Set up pointers to each density vector in a flat array of
+ * parameters, laid out as in gauden_param_read().
+ */
+static mfcc_t ****
+gauden_param_ptrs(gauden_t * g, mfcc_t const *buf)
+{
+    mfcc_t ****out;
+    int32 i, j, k;
+
+    out = (mfcc_t ****) ckd_calloc_3d(g->n_mgau, g->n_feat, g->n_density,
+                                      sizeof(mfcc_t *));
+    for (i = 0; i < g->n_mgau; i++) {
+        for (j = 0; j < g->n_feat; j++) {
+            for (k = 0; k < g->n_density; k++) {
+                out[i][j][k] = (mfcc_t *)buf;
+                buf += g->featlen[j];
+            }
+        }
+    }
+    return out;
+}
+
+gauden_t *
+gauden_init_image(acmod_image_t *img, logmath_t *lmath)
+{
+    gauden_t *g;
+    int32 const *hdr;
+    char const *data;
+    size_t len, pos, n_param, n_det;
+    int32 i, veclen;
+
+    if ((data = acmod_image_section(img, "gauden", &len)) == NULL
+        || len < 4 * sizeof(int32)) {
+        E_ERROR("Acoustic model image has no Gaussian parameters\n");
+        return NULL;
+    }
+    hdr = (int32 const *)data;
+    g = (gauden_t *) ckd_calloc(1, sizeof(gauden_t));
+    g->lmath = lmath;
+    g->n_mgau = hdr[0];
+    g->n_feat = hdr[1];
+    g->n_density = hdr[2];
+    veclen = hdr[3];
+    pos = ACMOD_IMAGE_ALIGN((4 + g->n_feat) * sizeof(int32));
+    n_param = (size_t)g->n_mgau * g->n_density * veclen;
+    n_det = (size_t)g->n_mgau * g->n_feat * g->n_density;
+    if (pos + 2 * ACMOD_IMAGE_ALIGN(n_param * sizeof(mfcc_t))
+        + n_det * sizeof(mfcc_t) > len) {
+        E_ERROR("Gaussian parameters in acoustic model image are truncated\n");
+        ckd_free(g);
+        return NULL;
+    }
+    g->featlen = ckd_calloc(g->n_feat, sizeof(*g->featlen));
+    for (i = 0; i < g->n_feat; ++i)
+        g->featlen[i] = hdr[4 + i];
+
+    /* Parameters are already floored and precomputed. */
+    g->image = acmod_image_retain(img);
+    g->mean = gauden_param_ptrs(g, (mfcc_t const *)(data + pos));
+    pos += ACMOD_IMAGE_ALIGN(n_param * sizeof(mfcc_t));
+    g->var = gauden_param_ptrs(g, (mfcc_t const *)(data + pos));
+    pos += ACMOD_IMAGE_ALIGN(n_param * sizeof(mfcc_t));
+    g->det = ckd_alloc_3d_ptr(g->n_mgau, g->n_feat, g->n_density,
+                              (void *)(data + pos), sizeof(mfcc_t));
+    E_INFO("Using %d codebook, %d feature, size %d Gaussians from image\n",
+           g->n_mgau, g->n_feat, g->n_density);
+
+    return g;
+}
+
+int
+gauden_write_image(gauden_t * g, acmod_image_writer_t * w)
+{
+    FILE *fh;
+    int32 i, m, f, d, veclen;
+
+    if ((fh = acmod_image_writer_section(w, "gauden")) == NULL)
+        return -1;
+    for (veclen = i = 0; i < g->n_feat; ++i)
+        veclen += g->featlen[i];
+    fwrite(&g->n_mgau, sizeof(int32), 1, fh);
+    fwrite(&g->n_feat, sizeof(int32), 1, fh);
+    fwrite(&g->n_density, sizeof(int32), 1, fh);
+    fwrite(&veclen, sizeof(int32), 1, fh);
+    fwrite(g->featlen, sizeof(int32), g->n_feat, fh);
+    acmod_image_writer_align(w);
+    for (m = 0; m < g->n_mgau; ++m)
+        for (f = 0; f < g->n_feat; ++f)
+            for (d = 0; d < g->n_density; ++d)
+                fwrite(g->mean[m][f][d], sizeof(mfcc_t), g->featlen[f], fh);
+    acmod_image_writer_align(w);
+    for (m = 0; m < g->n_mgau; ++m)
+        for (f = 0; f < g->n_feat; ++f)
+            for (d = 0; d < g->n_density; ++d)
+                fwrite(g->var[m][f][d], sizeof(mfcc_t), g->featlen[f], fh);
+    acmod_image_writer_align(w);
+    for (m = 0; m < g->n_mgau; ++m)
+        for (f = 0; f < g->n_feat; ++f)
+            fwrite(g->det[m][f], sizeof(mfcc_t), g->n_density, fh);
+
+    return ferror(fh) ? -1 : 0;
+}
+
 /* See compute_dist below */
 static int32
 compute_dist_all(gauden_dist_t * out_dist, mfcc_t* obs, int32 featlen,
@@ -546,25 +674,123 @@ gauden_dist(gauden_t * g,
     return 0;
 }
 
+/*
+ * Compute the top-N closest gaussians for several observation vectors,
+ * with the same results as compute_dist() for each of them.  The
+ * codewords are the outer loop, so that each one is only loaded once.
+ */
+static void
+compute_dist_batch(gauden_dist_t *** out_dist, int32 n_top, int32 n_obs,
+                   mfcc_t *** obs, int32 f, int32 featlen,
+                   mfcc_t ** mean, mfcc_t ** var, mfcc_t * det,
+                   int32 n_density)
+{
+    int32 i, j, k, d;
+
+    if (n_top >= n_density)
+        n_top = n_density;
+    else {
+        for (k = 0; k < n_obs; ++k)
+            for (i = 0; i < n_top; i++)
+                out_dist[k][f][i].dist = WORST_DIST;
+    }
+
+    for (d = 0; d < n_density; d++) {
+        mfcc_t *m;
+        mfcc_t *v;
+
+        m = mean[d];
+        v = var[d];
+        for (k = 0; k < n_obs; ++k) {
+            gauden_dist_t *worst;
+            mfcc_t *x;
+            mfcc_t dval;
+
+            x = obs[k][f];
+            dval = det[d];
+            if (n_top == n_density) {
+                /* As in compute_dist_all(). */
+                for (i = 0; i < featlen; i++) {
+                    mfcc_t diff;
+#ifdef FIXED_POINT
+                    mfcc_t pdval = dval;
+                    diff = x[i] - m[i];
+                    dval -= MFCCMUL(MFCCMUL(diff, diff), v[i]);
+                    if (dval > pdval) {
+                        dval = WORST_SCORE;
+                        break;
+                    }
+#else
+                    diff = x[i] - m[i];
+                    dval -= diff * diff * v[i];
+#endif
+                }
+                out_dist[k][f][d].dist = dval;
+                out_dist[k][f][d].id = d;
+                continue;
+            }
+
+            worst = &(out_dist[k][f][n_top - 1]);
+            for (i = 0; (i < featlen) && (dval >= worst->dist); i++) {
+                mfcc_t diff;
+#ifdef FIXED_POINT
+                mfcc_t pdval = dval;
+                diff = x[i] - m[i];
+                dval -= MFCCMUL(MFCCMUL(diff, diff), v[i]);
+                if (dval > pdval) {
+                    dval = WORST_SCORE;
+                    break;
+                }
+#else
+                diff = x[i] - m[i];
+                dval -= diff * diff * v[i];
+#endif
+            }
+            if ((i < featlen) || (dval < worst->dist))
+                continue;
+
+            for (i = 0; (i < n_top) && (dval < out_dist[k][f][i].dist); i++);
+            assert(i < n_top);
+            for (j = n_top - 1; j > i; --j)
+                out_dist[k][f][j] = out_dist[k][f][j - 1];
+            out_dist[k][f][i].dist = dval;
+            out_dist[k][f][i].id = d;
+        }
+    }
+}
+
+int32
+gauden_dist_batch(gauden_t * g, int mgau, int32 n_top, int32 n_obs,
+                  mfcc_t *** obs, gauden_dist_t *** out_dist)
+{
+    int32 f;
+
+    assert((n_top > 0) && (n_top <= g->n_density));
+
+    for (f = 0; f < g->n_feat; f++)
+        compute_dist_batch(out_dist, n_top, n_obs, obs, f, g->featlen[f],
+                           g->mean[mgau][f], g->var[mgau][f],
+                           g->det[mgau][f], g->n_density);
+
+    return 0;
+}
+
 int32
 gauden_mllr_transform(gauden_t *g, ps_mllr_t *mllr, cmd_ln_t *config)
 {
     int32 i, m, f, d, *flen;
     float32 ****fgau;
 
+    /* Precomputed parameters can't be transformed, so the originals
+     * are needed even if we were loaded from an image. */
+    if (cmd_ln_str_r(config, "-mean") == NULL
+        || cmd_ln_str_r(config, "-var") == NULL) {
+        E_ERROR("Means and variances are required for adaptation\n");
+        return -1;
+    }
+
     /* Free data if already here */
-    if (g->mean)
-        gauden_param_free(g->mean);
-    if (g->var)
-        gauden_param_free(g->var);
-    if (g->det)
-        ckd_free_3d(g->det);
-    if (g->featlen)
-        ckd_free(g->featlen);
-    g->mean = NULL;
-    g->var = NULL;
-    g->det = NULL;
-    g->featlen = NULL;
+    gauden_free_params(g);
 
     /* Reload means and variances (un-precomputed). */
     fgau = NULL;
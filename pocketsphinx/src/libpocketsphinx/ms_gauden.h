@@ -59,6 +59,7 @@
 #include "vector.h"
 #include "pocketsphinx_internal.h"
 #include "hmm.h"
+#include "acmod_image.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -89,6 +90,7 @@ typedef struct {
     int32 n_feat;	/**< Number feature streams in each codebook */
     int32 n_density;	/**< Number gaussian densities in each codebook-feature stream */
     int32 *featlen;	/**< feature length for each feature */
+    acmod_image_t *image; /**< Model image parameters point into (or NULL) */
 } gauden_t;
 
 
@@ -105,6 +107,19 @@ gauden_init (char const *meanfile,/**< Input: File containing means of mixture g
              logmath_t *lmath
     );
 
+/**
+ * Use precomputed mixture gaussian codebooks from an acoustic model
+ * image.  The parameters are not copied and must not be modified.
+ * Return value: ptr to the model created; NULL if error.
+ */
+gauden_t *
+gauden_init_image(acmod_image_t *img, /**< In: Acoustic model image */
+                  logmath_t *lmath
+    );
+
+/** Write precomputed codebooks to an acoustic model image. */
+int gauden_write_image(gauden_t *g, acmod_image_writer_t *w);
+
 /** Release memory allocated by gauden_init. */
 void gauden_free(gauden_t *g); /**< In: The gauden_t to free */
 
@@ -130,6 +145,23 @@ gauden_dist (gauden_t *g,	/**< In: handle to entire ensemble of codebooks */
 		Caller must allocate memory for this output */
     );
 
+/**
+ * Compute gaussian density values for several observation vectors wrt
+ * the same codebook, as gauden_dist() does for each of them.  Each
+ * codeword is read once for all of the observations.
+ * @return 0 if successful, -1 otherwise.
+ */
+int32
+gauden_dist_batch (gauden_t *g,	/**< In: handle to entire ensemble of codebooks */
+		   int mgau,	/**< In: codebook to be evaluated */
+		   int n_top,	/**< In: Number top densities to be evaluated */
+		   int n_obs,	/**< In: Number of observation vectors */
+		   mfcc_t ***obs, /**< In: obs[k][f] = feature f of observation k */
+		   gauden_dist_t ***out_dist
+		   /**< Out: out_dist[k] is as out_dist in gauden_dist()
+		      for observation k */
+    );
+
 /**
    Dump the definitionn of Gaussian distribution. 
 */
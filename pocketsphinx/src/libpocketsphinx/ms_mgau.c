@@ -68,6 +68,9 @@
  *
  */
 
+/* SphinxBase headers. */
+#include <sphinxbase/sbthread.h>
+
 /* Local headers. */
 #include "ms_mgau.h"
 
@@ -75,9 +78,226 @@ static ps_mgaufuncs_t ms_mgau_funcs = {
     "ms",
     ms_cont_mgau_frame_eval, /* frame_eval */
     ms_mgau_mllr_transform,  /* transform */
-    ms_mgau_free             /* free */
+    ms_mgau_free,            /* free */
+    ms_mgau_write_image,     /* write_image */
+    ms_mgau_copy,            /* copy */
+    ms_cont_mgau_frame_eval_batch /* frame_eval_batch */
+};
+
+/**
+ * Steps of frame evaluation which can be split among threads.
+ */
+enum ms_mgau_phase_e {
+    MS_MGAU_CODEBOOKS, /**< Compute top-N densities for cb_list. */
+    MS_MGAU_SENONES,   /**< Compute senone scores for sen_list. */
+    MS_MGAU_EXIT       /**< Shut down worker threads. */
+};
+
+/**
+ * Helper thread for frame evaluation.
+ */
+struct ms_mgau_worker_s {
+    ms_mgau_model_t *msg; /**< Parent object. */
+    sbthread_t *thr;      /**< Thread. */
+    sbevent_t *start;     /**< Signalled when there is work to do. */
+    sbevent_t *done;      /**< Signalled when the work is done. */
+    int idx;              /**< Slice of the work lists to process. */
+    int gen;              /**< Last step completed. */
+    int32 best;           /**< Best senone score in this slice. */
 };
 
+/**
+ * Compute top-N densities for one slice of the active codebooks.
+ */
+static void
+eval_codebooks(ms_mgau_model_t *msg, int idx)
+{
+    int32 i, start, end;
+
+    start = msg->n_cb_list * idx / msg->n_thread;
+    end = msg->n_cb_list * (idx + 1) / msg->n_thread;
+    for (i = start; i < end; ++i) {
+        int32 gid = msg->cb_list[i];
+        gauden_dist(msg->g, gid, msg->topn, msg->feat, msg->dist[gid]);
+    }
+}
+
+/**
+ * Compute scores for one slice of the active senones.  Slices are
+ * disjoint so each thread writes its own part of senscr.
+ *
+ * @return best (lowest) unnormalized score in the slice.
+ */
+static int32
+eval_senones(ms_mgau_model_t *msg, int idx)
+{
+    int32 i, start, end, best;
+    senone_t *sen = msg->s;
+
+    start = msg->n_sen_list * idx / msg->n_thread;
+    end = msg->n_sen_list * (idx + 1) / msg->n_thread;
+    best = (int32) 0x7fffffff;
+    for (i = start; i < end; ++i) {
+        int32 s = msg->sen_list[i];
+        msg->senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]],
+                                     msg->topn);
+        if (best > msg->senscr[s])
+            best = msg->senscr[s];
+    }
+    return best;
+}
+
+static int
+ms_mgau_worker_main(sbthread_t *th)
+{
+    ms_mgau_worker_t *w = sbthread_arg(th);
+    ms_mgau_model_t *msg = w->msg;
+
+    for (;;) {
+        int32 best = 0;
+        int phase, gen;
+
+        /* Loop to guard against spurious wakeups. */
+        sbmtx_lock(msg->mtx);
+        while (w->gen == msg->gen) {
+            sbmtx_unlock(msg->mtx);
+            sbevent_wait(w->start, -1, -1);
+            sbmtx_lock(msg->mtx);
+        }
+        phase = msg->phase;
+        gen = msg->gen;
+        sbmtx_unlock(msg->mtx);
+
+        switch (phase) {
+        case MS_MGAU_CODEBOOKS:
+            eval_codebooks(msg, w->idx);
+            break;
+        case MS_MGAU_SENONES:
+            best = eval_senones(msg, w->idx);
+            break;
+        default:
+            return 0;
+        }
+
+        sbmtx_lock(msg->mtx);
+        w->best = best;
+        w->gen = gen;
+        sbmtx_unlock(msg->mtx);
+        sbevent_signal(w->done);
+    }
+}
+
+/**
+ * Run one step of frame evaluation on all threads and wait for it to
+ * finish.  The calling thread does slice 0.
+ *
+ * @return best senone score, for MS_MGAU_SENONES.
+ */
+static int32
+run_phase(ms_mgau_model_t *msg, int phase)
+{
+    int32 best = (int32) 0x7fffffff;
+    int i;
+
+    sbmtx_lock(msg->mtx);
+    msg->phase = phase;
+    ++msg->gen;
+    sbmtx_unlock(msg->mtx);
+    for (i = 0; i < msg->n_thread - 1; ++i)
+        sbevent_signal(msg->workers[i].start);
+    if (phase == MS_MGAU_CODEBOOKS)
+        eval_codebooks(msg, 0);
+    else if (phase == MS_MGAU_SENONES)
+        best = eval_senones(msg, 0);
+    else
+        return best; /* Threads exit without signalling. */
+    sbmtx_lock(msg->mtx);
+    for (i = 0; i < msg->n_thread - 1; ++i) {
+        ms_mgau_worker_t *w = msg->workers + i;
+        while (w->gen != msg->gen) {
+            sbmtx_unlock(msg->mtx);
+            sbevent_wait(w->done, -1, -1);
+            sbmtx_lock(msg->mtx);
+        }
+        if (phase == MS_MGAU_SENONES && best > w->best)
+            best = w->best;
+    }
+    sbmtx_unlock(msg->mtx);
+    return best;
+}
+
+static void
+worker_free(ms_mgau_worker_t *w)
+{
+    if (w->thr)
+        sbthread_free(w->thr);
+    if (w->start)
+        sbevent_free(w->start);
+    if (w->done)
+        sbevent_free(w->done);
+}
+
+static int
+start_workers(ms_mgau_model_t *msg, int n_thread)
+{
+    int i;
+
+    msg->n_thread = 1;
+    if (n_thread <= 1)
+        return 0;
+    if ((msg->mtx = sbmtx_init()) == NULL) {
+        E_ERROR("Failed to create scoring thread mutex\n");
+        return -1;
+    }
+    msg->workers = ckd_calloc(n_thread - 1, sizeof(*msg->workers));
+    for (i = 0; i < n_thread - 1; ++i) {
+        ms_mgau_worker_t *w = msg->workers + i;
+        w->msg = msg;
+        w->idx = i + 1;
+        if ((w->start = sbevent_init()) == NULL
+            || (w->done = sbevent_init()) == NULL
+            || (w->thr = sbthread_start(NULL, ms_mgau_worker_main, w)) == NULL) {
+            E_ERROR("Failed to start scoring thread %d\n", i + 1);
+            worker_free(w);
+            return -1;
+        }
+        ++msg->n_thread;
+    }
+    E_INFO("Scoring senones with %d threads\n", msg->n_thread);
+    return 0;
+}
+
+static void
+stop_workers(ms_mgau_model_t *msg)
+{
+    int i;
+
+    if (msg->workers == NULL)
+        return;
+    run_phase(msg, MS_MGAU_EXIT);
+    for (i = 0; i < msg->n_thread - 1; ++i)
+        worker_free(msg->workers + i);
+    ckd_free(msg->workers);
+    msg->workers = NULL;
+    msg->n_thread = 1;
+    sbmtx_free(msg->mtx);
+    msg->mtx = NULL;
+}
+
+static int
+init_work(ms_mgau_model_t *msg)
+{
+    gauden_t *g = msg->g;
+
+    msg->dist = (gauden_dist_t ***)
+        ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
+                      sizeof(gauden_dist_t));
+    msg->mgau_active = ckd_calloc(g->n_mgau, sizeof(int8));
+    msg->cb_list = ckd_calloc(g->n_mgau, sizeof(*msg->cb_list));
+    msg->sen_list = ckd_calloc(msg->s->n_sen, sizeof(*msg->sen_list));
+    return start_workers(msg, cmd_ln_int32_r(msg->config, "-nthreads"));
+}
+
 ps_mgau_t *
 ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
 {
@@ -92,14 +312,20 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
     config = acmod->config;
 
     msg = (ms_mgau_model_t *) ckd_calloc(1, sizeof(ms_mgau_model_t));
+    msg->base.refcount = 1;
     msg->config = config;
     msg->g = NULL;
     msg->s = NULL;
     
-    g = msg->g = gauden_init(cmd_ln_str_r(config, "-mean"),
-                             cmd_ln_str_r(config, "-var"),
-                             cmd_ln_float32_r(config, "-varfloor"),
-                             lmath);
+    if (acmod->image)
+        g = msg->g = gauden_init_image(acmod->image, lmath);
+    else
+        g = msg->g = gauden_init(cmd_ln_str_r(config, "-mean"),
+                                 cmd_ln_str_r(config, "-var"),
+                                 cmd_ln_float32_r(config, "-varfloor"),
+                                 lmath);
+    if (g == NULL)
+        goto error_out;
 
     /* Verify n_feat and veclen, against acmod. */
     if (g->n_feat != feat_dimension1(acmod->fcb)) {
@@ -115,11 +341,16 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         }
     }
 
-    s = msg->s = senone_init(msg->g,
-                             cmd_ln_str_r(config, "-mixw"),
-                             cmd_ln_str_r(config, "-senmgau"),
-                             cmd_ln_float32_r(config, "-mixwfloor"),
-                             lmath, mdef);
+    if (acmod->image) {
+        if ((s = msg->s = senone_init_image(acmod->image, lmath)) == NULL)
+            goto error_out;
+    }
+    else
+        s = msg->s = senone_init(msg->g,
+                                 cmd_ln_str_r(config, "-mixw"),
+                                 cmd_ln_str_r(config, "-senmgau"),
+                                 cmd_ln_float32_r(config, "-mixwfloor"),
+                                 lmath, mdef);
 
     s->aw = cmd_ln_int32_r(config, "-aw");
 
@@ -146,10 +377,8 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         msg->topn = msg->g->n_density;
     }
 
-    msg->dist = (gauden_dist_t ***)
-        ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
-                      sizeof(gauden_dist_t));
-    msg->mgau_active = ckd_calloc(g->n_mgau, sizeof(int8));
+    if (init_work(msg) < 0)
+        goto error_out;
 
     mg = (ps_mgau_t *)msg;
     mg->vt = &ms_mgau_funcs;
@@ -159,21 +388,59 @@ error_out:
     return NULL;    
 }
 
+ps_mgau_t *
+ms_mgau_copy(ps_mgau_t *mg)
+{
+    ms_mgau_model_t *other = (ms_mgau_model_t *)mg;
+    ms_mgau_model_t *msg;
+
+    /* Always share the parameters of the original model. */
+    if (mg->shared)
+        return ms_mgau_copy(mg->shared);
+
+    msg = (ms_mgau_model_t *) ckd_calloc(1, sizeof(ms_mgau_model_t));
+    msg->base.vt = mg->vt;
+    msg->base.refcount = 1;
+    msg->base.shared = ps_mgau_retain(mg);
+    msg->g = other->g;
+    msg->s = other->s;
+    msg->topn = other->topn;
+    msg->config = other->config;
+    if (init_work(msg) < 0) {
+        ms_mgau_free(ps_mgau_base(msg));
+        return NULL;
+    }
+
+    return ps_mgau_base(msg);
+}
+
 void
 ms_mgau_free(ps_mgau_t * mg)
 {
     ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
     if (msg == NULL)
         return;
+    if (--mg->refcount > 0)
+        return;
+
+    stop_workers(msg);
 
-    if (msg->g)
-	gauden_free(msg->g);
-    if (msg->s)
-        senone_free(msg->s);
+    if (mg->shared)
+        ps_mgau_free(mg->shared);
+    else {
+        if (msg->g)
+            gauden_free(msg->g);
+        if (msg->s)
+            senone_free(msg->s);
+    }
     if (msg->dist)
         ckd_free_3d((void *) msg->dist);
     if (msg->mgau_active)
         ckd_free(msg->mgau_active);
+    ckd_free(msg->cb_list);
+    ckd_free(msg->sen_list);
+    ckd_free(msg->batch_obs);
+    ckd_free(msg->batch_dist);
     
     ckd_free(msg);
 }
@@ -186,52 +453,49 @@ ms_mgau_mllr_transform(ps_mgau_t *s,
     return gauden_mllr_transform(msg->g, mllr, msg->config);
 }
 
-int32
-ms_cont_mgau_frame_eval(ps_mgau_t * mg,
-			int16 *senscr,
-			uint8 *senone_active,
-			int32 n_senone_active,
-                        mfcc_t ** feat,
-			int32 frame,
-			int32 compallsen)
+int
+ms_mgau_write_image(ps_mgau_t *s,
+                    acmod_image_writer_t *w)
+{
+    ms_mgau_model_t *msg = (ms_mgau_model_t *)s;
+
+    if (gauden_write_image(msg->g, w) < 0)
+        return -1;
+    return senone_write_image(msg->s, w);
+}
+
+/**
+ * Build the lists of codebooks and senones to evaluate for one frame,
+ * which are then divided evenly among the threads.
+ */
+static void
+init_frame(ms_mgau_model_t *msg,
+           int16 *senscr,
+           uint8 *senone_active,
+           int32 n_senone_active,
+           mfcc_t ** feat,
+           int32 compallsen)
 {
-    ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
     int32 gid;
-    int32 topn;
-    int32 best;
+    int32 i;
     gauden_t *g;
     senone_t *sen;
 
-    topn = ms_mgau_topn(msg);
     g = ms_mgau_gauden(msg);
     sen = ms_mgau_senone(msg);
 
     if (compallsen) {
-	int32 s;
-
-	for (gid = 0; gid < g->n_mgau; gid++)
-	    gauden_dist(g, gid, topn, feat, msg->dist[gid]);
-
-	best = (int32) 0x7fffffff;
-	for (s = 0; s < sen->n_sen; s++) {
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	}
-
-	/* Normalize senone scores */
-	for (s = 0; s < sen->n_sen; s++) {
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
+	for (gid = 0; gid < g->n_mgau; gid++) {
+	    msg->mgau_active[gid] = 1;
+	    msg->cb_list[gid] = gid;
 	}
+	msg->n_cb_list = g->n_mgau;
+	for (i = 0; i < sen->n_sen; i++)
+	    msg->sen_list[i] = i;
+	msg->n_sen_list = sen->n_sen;
     }
     else {
-	int32 i, n;
+	int32 n;
 	/* Flag all active mixture-gaussian codebooks */
 	for (gid = 0; gid < g->n_mgau; gid++)
 	    msg->mgau_active[gid] = 0;
@@ -241,39 +505,118 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 	    /* senone_active consists of deltas. */
 	    int32 s = senone_active[i] + n;
 	    msg->mgau_active[sen->mgau[s]] = 1;
+	    msg->sen_list[i] = s;
 	    n = s;
 	}
+	msg->n_sen_list = n_senone_active;
 
-	/* Compute topn gaussian density values (for active codebooks) */
+	msg->n_cb_list = 0;
 	for (gid = 0; gid < g->n_mgau; gid++) {
 	    if (msg->mgau_active[gid])
-		gauden_dist(g, gid, topn, feat, msg->dist[gid]);
+		msg->cb_list[msg->n_cb_list++] = gid;
 	}
+    }
+    msg->senscr = senscr;
+    msg->feat = feat;
+    msg->base.n_codebook_eval += msg->n_cb_list;
+}
 
-	best = (int32) 0x7fffffff;
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	    n = s;
-	}
+/**
+ * Compute senone scores once the densities are known, and normalize
+ * them.
+ */
+static void
+finish_frame(ms_mgau_model_t *msg)
+{
+    int32 best;
+    int32 i;
 
-	/* Normalize senone scores */
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
-	    n = s;
-	}
+    if (msg->n_thread > 1)
+	best = run_phase(msg, MS_MGAU_SENONES);
+    else
+	best = eval_senones(msg, 0);
+
+    /* Normalize senone scores */
+    for (i = 0; i < msg->n_sen_list; i++) {
+	int32 s = msg->sen_list[i];
+	int32 bs = msg->senscr[s] - best;
+	if (bs > 32767)
+	    bs = 32767;
+	if (bs < -32768)
+	    bs = -32768;
+	msg->senscr[s] = bs;
+    }
+}
+
+int32
+ms_cont_mgau_frame_eval(ps_mgau_t * mg,
+			int16 *senscr,
+			uint8 *senone_active,
+			int32 n_senone_active,
+                        mfcc_t ** feat,
+			int32 frame,
+			int32 compallsen)
+{
+    ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
+
+    init_frame(msg, senscr, senone_active, n_senone_active,
+               feat, compallsen);
+
+    /* Compute topn gaussian density values, then senone scores. */
+    if (msg->n_thread > 1)
+	run_phase(msg, MS_MGAU_CODEBOOKS);
+    else
+	eval_codebooks(msg, 0);
+    finish_frame(msg);
+
+    return 0;
+}
+
+int32
+ms_cont_mgau_frame_eval_batch(ps_mgau_t ** mg,
+                              int n_mgau,
+                              int16 **senscr,
+                              uint8 **senone_active,
+                              int32 *n_senone_active,
+                              mfcc_t *** feat,
+                              int32 *frame,
+                              int32 compallsen)
+{
+    ms_mgau_model_t **msgs = (ms_mgau_model_t **)mg;
+    ms_mgau_model_t *lead = msgs[0];
+    gauden_t *g;
+    int32 gid;
+    int k;
+
+    for (k = 0; k < n_mgau; ++k)
+        init_frame(msgs[k], senscr[k], senone_active[k],
+                   n_senone_active[k], feat[k], compallsen);
+
+    /* Evaluate each codebook for all the frames which need it. */
+    g = ms_mgau_gauden(lead);
+    if (lead->n_batch_alloc < n_mgau) {
+        lead->batch_obs = ckd_realloc(lead->batch_obs,
+                                      n_mgau * sizeof(*lead->batch_obs));
+        lead->batch_dist = ckd_realloc(lead->batch_dist,
+                                       n_mgau * sizeof(*lead->batch_dist));
+        lead->n_batch_alloc = n_mgau;
+    }
+    for (gid = 0; gid < g->n_mgau; gid++) {
+        int n = 0;
+        for (k = 0; k < n_mgau; ++k) {
+            if (msgs[k]->mgau_active[gid]) {
+                lead->batch_obs[n] = msgs[k]->feat;
+                lead->batch_dist[n] = msgs[k]->dist[gid];
+                ++n;
+            }
+        }
+        if (n > 0)
+            gauden_dist_batch(g, gid, lead->topn, n,
+                              lead->batch_obs, lead->batch_dist);
     }
 
+    for (k = 0; k < n_mgau; ++k)
+        finish_frame(msgs[k]);
+
     return 0;
 }
@@ -100,6 +100,7 @@
 #include <sphinxbase/cmd_ln.h>
 #include <sphinxbase/logmath.h>
 #include <sphinxbase/feat.h>
+#include <sphinxbase/sbthread.h>
 
 /* Local headers. */
 #include "acmod.h"
@@ -107,6 +108,8 @@
 #include "ms_gauden.h"
 #include "ms_senone.h"
 
+typedef struct ms_mgau_worker_s ms_mgau_worker_t;
+
 /** \struct ms_mgau_t
     \brief Multi-stream mixture gaussian. It is not necessary to be continr
 */
@@ -121,6 +124,26 @@ typedef struct {
     gauden_dist_t ***dist;  
     uint8 *mgau_active;
     cmd_ln_t *config;
+
+    /* Work for the current frame, split among threads. */
+    int32 *cb_list;      /**< Codebooks to evaluate. */
+    int32 n_cb_list;     /**< Number of entries in cb_list. */
+    int32 *sen_list;     /**< Senones to evaluate (absolute ids). */
+    int32 n_sen_list;    /**< Number of entries in sen_list. */
+    int16 *senscr;       /**< Output senone scores. */
+    mfcc_t **feat;       /**< Input feature vector. */
+
+    /* Kept for frames of several models scored with this one first. */
+    mfcc_t ***batch_obs;          /**< Feature vector of each model. */
+    gauden_dist_t ***batch_dist;  /**< Codebook densities of each model. */
+    int n_batch_alloc;            /**< Number allocated in both. */
+
+    /* Persistent worker pool for -nthreads > 1. */
+    int n_thread;        /**< Number of threads, including the caller. */
+    ms_mgau_worker_t *workers; /**< The other n_thread - 1 threads. */
+    sbmtx_t *mtx;        /**< Guards phase, gen and each worker's gen and best. */
+    int phase;           /**< Step of frame evaluation to run. */
+    int gen;             /**< Incremented for each step dispatched. */
 } ms_mgau_model_t;  
 
 #define ms_mgau_gauden(msg) (msg->g)
@@ -136,8 +159,19 @@ int32 ms_cont_mgau_frame_eval(ps_mgau_t * msg,
                               mfcc_t ** feat,
                               int32 frame,
                               int32 compallsen);
+int32 ms_cont_mgau_frame_eval_batch(ps_mgau_t ** msg,
+                                    int n_mgau,
+                                    int16 **senscr,
+                                    uint8 **senone_active,
+                                    int32 *n_senone_active,
+                                    mfcc_t *** feat,
+                                    int32 *frame,
+                                    int32 compallsen);
 int32 ms_mgau_mllr_transform(ps_mgau_t *s,
                              ps_mllr_t *mllr);
+int ms_mgau_write_image(ps_mgau_t *s,
+                        acmod_image_writer_t *w);
+ps_mgau_t *ms_mgau_copy(ps_mgau_t *s);
 
 #endif /* _LIBFBS_MS_CONT_MGAU_H_*/
 
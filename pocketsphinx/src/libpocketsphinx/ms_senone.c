@@ -337,15 +337,91 @@ senone_init(gauden_t *g, char const *mixwfile, char const *sen2mgau_map_file,
     return s;
 }
 
+senone_t *
+senone_init_image(acmod_image_t *img, logmath_t *lmath)
+{
+    senone_t *s;
+    char const *data;
+    int32 const *hdr;
+    size_t len, pos;
+
+    if ((data = acmod_image_section(img, "senone", &len)) == NULL
+        || len < 5 * sizeof(int32)) {
+        E_ERROR("Acoustic model image has no mixture weights\n");
+        return NULL;
+    }
+    hdr = (int32 const *)data;
+    s = (senone_t *) ckd_calloc(1, sizeof(senone_t));
+    s->n_sen = hdr[0];
+    s->n_feat = hdr[1];
+    s->n_cw = hdr[2];
+    s->n_gauden = hdr[3];
+    s->mixwfloor = ((float32 const *)hdr)[4];
+    pos = ACMOD_IMAGE_ALIGN(5 * sizeof(int32));
+    if (pos + ACMOD_IMAGE_ALIGN(s->n_sen * sizeof(*s->mgau))
+        + (size_t)s->n_sen * s->n_feat * s->n_cw > len) {
+        E_ERROR("Mixture weights in acoustic model image are truncated\n");
+        ckd_free(s);
+        return NULL;
+    }
+    s->lmath = logmath_init(logmath_get_base(lmath), SENSCR_SHIFT, TRUE);
+    s->image = acmod_image_retain(img);
+    s->mgau = (uint32 *)(data + pos);
+    pos += ACMOD_IMAGE_ALIGN(s->n_sen * sizeof(*s->mgau));
+    /* Organized as in senone_mixw_read(). */
+    if (s->n_gauden > 1)
+        s->pdf = (senprob_t ***) ckd_alloc_3d_ptr(s->n_sen, s->n_feat, s->n_cw,
+                                                  (void *)(data + pos),
+                                                  sizeof(senprob_t));
+    else
+        s->pdf = (senprob_t ***) ckd_alloc_3d_ptr(s->n_feat, s->n_cw, s->n_sen,
+                                                  (void *)(data + pos),
+                                                  sizeof(senprob_t));
+    E_INFO("Using mixture weights for %d senones from image: "
+           "%d features x %d codewords\n", s->n_sen, s->n_feat, s->n_cw);
+
+    s->featscr = NULL;
+    return s;
+}
+
+int
+senone_write_image(senone_t * s, acmod_image_writer_t * w)
+{
+    FILE *fh;
+
+    if ((fh = acmod_image_writer_section(w, "senone")) == NULL)
+        return -1;
+    fwrite(&s->n_sen, sizeof(int32), 1, fh);
+    fwrite(&s->n_feat, sizeof(int32), 1, fh);
+    fwrite(&s->n_cw, sizeof(int32), 1, fh);
+    fwrite(&s->n_gauden, sizeof(int32), 1, fh);
+    fwrite(&s->mixwfloor, sizeof(float32), 1, fh);
+    acmod_image_writer_align(w);
+    fwrite(s->mgau, sizeof(*s->mgau), s->n_sen, fh);
+    acmod_image_writer_align(w);
+    fwrite(s->pdf[0][0], sizeof(senprob_t),
+           (size_t)s->n_sen * s->n_feat * s->n_cw, fh);
+
+    return ferror(fh) ? -1 : 0;
+}
+
 void
 senone_free(senone_t * s)
 {
     if (s == NULL)
         return;
-    if (s->pdf)
-        ckd_free_3d((void *) s->pdf);
-    if (s->mgau)
-        ckd_free(s->mgau);
+    if (s->image) {
+        /* Only the pointer arrays belong to us. */
+        if (s->pdf)
+            ckd_free_3d_ptr((void *) s->pdf);
+        acmod_image_free(s->image);
+    }
+    else {
+        if (s->pdf)
+            ckd_free_3d((void *) s->pdf);
+        if (s->mgau)
+            ckd_free(s->mgau);
+    }
     if (s->featscr)
         ckd_free(s->featscr);
     logmath_free(s->lmath);
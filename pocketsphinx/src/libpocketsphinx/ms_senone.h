@@ -158,6 +158,7 @@ typedef struct {
     uint32 *mgau;		/**< senone-id -> mgau-id mapping for senones in this set */
     int32 *featscr;              /**< The feature score for every senone, will be initialized inside senone_eval_all */
     int32 aw;			/**< Inverse acoustic weight */
+    acmod_image_t *image;	/**< Model image pdf and mgau point into (or NULL) */
 } senone_t;
 
 
@@ -177,6 +178,18 @@ senone_t *senone_init (gauden_t *g,             /**< In: codebooks */
                        bin_mdef_t *mdef         /**< In: model definition */
     );
 
+/**
+ * Use quantized senone mixture weights and codebook mappings from an
+ * acoustic model image.  The data are not copied.
+ * @return pointer to senone structure created, or NULL on error.
+ */
+senone_t *senone_init_image(acmod_image_t *img, /**< In: acoustic model image */
+                            logmath_t *lmath    /**< In: log math computation */
+    );
+
+/** Write quantized mixture weights to an acoustic model image. */
+int senone_write_image(senone_t *s, acmod_image_writer_t *w);
+
 /** Release memory allocated by senone_init. */
 void senone_free(senone_t *s); /**< In: The senone_t to free */
 
@@ -62,6 +62,8 @@ static int ngram_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2
 static char const *ngram_search_hyp(ps_search_t *search, int32 *out_score, int32 *out_is_final);
 static int32 ngram_search_prob(ps_search_t *search);
 static ps_seg_t *ngram_search_seg_iter(ps_search_t *search, int32 *out_score);
+static void ngram_search_stats(ps_search_t *search, ps_stats_t *stats);
+static void ngram_search_sen_active(ps_search_t *search, int frame_idx);
 
 static ps_searchfuncs_t ngram_funcs = {
     /* name: */   "ngram",
@@ -74,6 +76,8 @@ static ps_searchfuncs_t ngram_funcs = {
     /* hyp: */      ngram_search_hyp,
     /* prob: */     ngram_search_prob,
     /* seg_iter: */ ngram_search_seg_iter,
+    /* stats: */    ngram_search_stats,
+    /* sen_active: */ ngram_search_sen_active,
 };
 
 static ngram_model_t *default_lm;
@@ -160,6 +164,8 @@ ngram_search_init(ngram_model_t *lm,
         ps_search_free(ps_search_base(ngs));
         return NULL;
     }
+    ngs->hmm_simd = hmm_simd_init(cmd_ln_str_r(config, "-simd"),
+                                  ngs->hmmctx, acmod->tmat->n_tmat);
     ngs->chan_alloc = listelem_alloc_init(sizeof(chan_t));
     ngs->root_chan_alloc = listelem_alloc_init(sizeof(root_chan_t));
     ngs->latnode_alloc = listelem_alloc_init(sizeof(ps_latnode_t));
@@ -227,6 +233,8 @@ ngram_search_init(ngram_model_t *lm,
         ngs->bestpath_perf.name = "bestpath";
         ptmr_init(&ngs->bestpath_perf);
     }
+    if (ngs->fwdtree && ngs->fwdflat && cmd_ln_boolean_r(config, "-bpgc"))
+        E_WARN("-bpgc has no effect when -fwdflat is enabled\n");
 
     return (ps_search_t *)ngs;
 
@@ -307,6 +315,7 @@ ngram_search_free(ps_search_t *search)
     }
 
     hmm_context_free(ngs->hmmctx);
+    hmm_simd_free(ngs->hmm_simd);
     listelem_alloc_free(ngs->chan_alloc);
     listelem_alloc_free(ngs->root_chan_alloc);
     listelem_alloc_free(ngs->latnode_alloc);
@@ -321,6 +330,9 @@ ngram_search_free(ps_search_t *search)
         ckd_free(ngs->bp_table_idx - 1);
     ckd_free_2d(ngs->active_word_list);
     ckd_free(ngs->last_ltrans);
+    ckd_free(ngs->hyp_bp);
+    ckd_free(ngs->hyp_len);
+    bitvec_free(ngs->bp_live);
     ckd_free(ngs);
 }
 
@@ -343,6 +355,19 @@ ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx)
     return ngs->bpidx;
 }
 
+/*
+ * Number of right context scores kept in bscore_stack for an entry.
+ */
+static int32
+bptbl_rcsize(ngram_search_t *ngs, bptbl_t *be)
+{
+    if (be->s_idx == -1)
+        return 0;
+    return dict2pid_rssid(ps_search_dict2pid(ngs),
+                          bptbl_last_phone(ngs, be),
+                          bptbl_last2_phone(ngs, be))->n_ssid;
+}
+
 static void
 set_real_wid(ngram_search_t *ngs, int32 bp)
 {
@@ -478,17 +503,9 @@ ngram_search_save_bp(ngram_search_t *ngs, int frame_idx,
 
         /* DICT2PID */
         /* Get diphone ID for final phone and number of ssids corresponding to it. */
-        be->last_phone = dict_last_phone(ps_search_dict(ngs),w);
-        if (dict_is_single_phone(ps_search_dict(ngs), w)) {
-            be->last2_phone = -1;
+        if (dict_is_single_phone(ps_search_dict(ngs), w))
             be->s_idx = -1;
-            rcsize = 0;
-        }
-        else {
-            be->last2_phone = dict_second_last_phone(ps_search_dict(ngs),w);
-            rcsize = dict2pid_rssid(ps_search_dict2pid(ngs),
-                                    be->last_phone, be->last2_phone)->n_ssid;
-        }
+        rcsize = bptbl_rcsize(ngs, be);
         /* Allocate some space on the bscore_stack for all of these triphones. */
         for (i = 0; i < rcsize; ++i)
             ngs->bscore_stack[ngs->bss_head + i] = WORST_SCORE;
@@ -498,7 +515,93 @@ ngram_search_save_bp(ngram_search_t *ngs, int frame_idx,
 
         ngs->bpidx++;
         ngs->bss_head += rcsize;
+        ++ngs->st.n_bp;
+        if (ngs->bpidx > ngs->st.n_bp_peak)
+            ngs->st.n_bp_peak = ngs->bpidx;
+    }
+}
+
+int32 *
+ngram_search_gc_bptable(ngram_search_t *ngs, int32 first_active)
+{
+    int32 *map;
+    int32 i, f, j, n_kept, first_retired, bss_head;
+
+    /* Mark everything before first_active that is an ancestor of
+     * something kept.  Predecessors always come before their
+     * successors, so one backwards sweep is enough. */
+    map = ckd_calloc(ngs->bpidx, sizeof(*map));
+    for (i = 0; i < first_active; ++i)
+        map[i] = NO_BP;
+    for (i = ngs->bpidx - 1; i >= 0; --i) {
+        if (map[i] != NO_BP && ngs->bp_table[i].bp != NO_BP)
+            map[ngs->bp_table[i].bp] = 0;
+    }
+    for (first_retired = 0; first_retired < first_active; ++first_retired)
+        if (map[first_retired] == NO_BP)
+            break;
+    if (first_retired == first_active) {
+        ckd_free(map);
+        return NULL;
+    }
+
+    /* Slide the survivors and their right context scores down. */
+    bss_head = ngs->bss_head;
+    for (i = first_retired; i < ngs->bpidx; ++i) {
+        if (ngs->bp_table[i].s_idx != -1) {
+            bss_head = ngs->bp_table[i].s_idx;
+            break;
+        }
+    }
+    for (i = 0; i < first_retired; ++i)
+        map[i] = i;
+    n_kept = first_retired;
+    for (i = first_retired; i < ngs->bpidx; ++i) {
+        bptbl_t *be = ngs->bp_table + i;
+        int32 rcsize;
+
+        if (map[i] == NO_BP)
+            continue;
+        if ((rcsize = bptbl_rcsize(ngs, be)) > 0) {
+            memmove(ngs->bscore_stack + bss_head,
+                    ngs->bscore_stack + be->s_idx,
+                    rcsize * sizeof(*ngs->bscore_stack));
+            be->s_idx = bss_head;
+            bss_head += rcsize;
+        }
+        if (be->bp != NO_BP) {
+            be->bp = map[be->bp];
+            assert(be->bp != NO_BP);
+        }
+        map[i] = n_kept;
+        ngs->bp_table[n_kept++] = *be;
     }
+
+    /* Renumber the frame index from the first frame that lost
+     * anything. */
+    for (f = 0; f < ngs->n_frame; ++f)
+        if (ngs->bp_table_idx[f] > first_retired)
+            break;
+    for (j = first_retired, i = first_retired; f < ngs->n_frame; ++f) {
+        for (; j < ngs->bp_table_idx[f]; ++j)
+            if (map[j] != NO_BP)
+                ++i;
+        ngs->bp_table_idx[f] = i;
+    }
+
+    /* Discarded entries can only be at the end of the cached
+     * hypothesis, since their ancestors are kept. */
+    for (i = 0; i < ngs->n_hyp_bp; ++i) {
+        if (map[ngs->hyp_bp[i]] == NO_BP)
+            break;
+        ngs->hyp_bp[i] = map[ngs->hyp_bp[i]];
+    }
+    ngs->n_hyp_bp = i;
+
+    ngs->st.n_bp_retired += ngs->bpidx - n_kept;
+    ngs->bpidx = n_kept;
+    ngs->bss_head = bss_head;
+    return map;
 }
 
 int
@@ -552,48 +655,143 @@ char const *
 ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
 {
     ps_search_t *base = ps_search_base(ngs);
+    dict_t *dict = ps_search_dict(ngs);
     char *c;
-    size_t len;
-    int bp;
+    int32 len;
+    int bp, i, n, n_new;
 
     if (bpidx == NO_BP)
         return NULL;
 
-    bp = bpidx;
-    len = 0;
-    while (bp != NO_BP) {
-        bptbl_t *be = &ngs->bp_table[bp];
-        bp = be->bp;
-        if (dict_real_word(ps_search_dict(ngs), be->wid))
-            len += strlen(dict_basestr(ps_search_dict(ngs), be->wid)) + 1;
+    /* Find the most recent entry shared with the previous hypothesis,
+     * whose words are still in hyp_str.  Both paths are in order of
+     * increasing entry ID, so any cached entry newer than the one
+     * we are looking at cannot be on this path. */
+    n = (base->hyp_str == NULL) ? 0 : ngs->n_hyp_bp;
+    n_new = 0;
+    for (bp = bpidx; bp != NO_BP; bp = ngs->bp_table[bp].bp) {
+        while (n > 0 && ngs->hyp_bp[n - 1] > bp)
+            --n;
+        if (n > 0 && ngs->hyp_bp[n - 1] == bp)
+            break;
+        ++n_new;
+    }
+    if (bp == NO_BP)
+        n = 0;
+
+    /* Add the new entries after it. */
+    if (n + n_new > ngs->n_hyp_bp_alloc) {
+        ngs->n_hyp_bp_alloc = (n + n_new) * 2;
+        ngs->hyp_bp = ckd_realloc(ngs->hyp_bp, ngs->n_hyp_bp_alloc
+                                  * sizeof(*ngs->hyp_bp));
+        ngs->hyp_len = ckd_realloc(ngs->hyp_len, ngs->n_hyp_bp_alloc
+                                   * sizeof(*ngs->hyp_len));
+    }
+    ngs->n_hyp_bp = n + n_new;
+    for (i = ngs->n_hyp_bp, bp = bpidx; i > n; bp = ngs->bp_table[bp].bp)
+        ngs->hyp_bp[--i] = bp;
+    len = (n == 0) ? 0 : ngs->hyp_len[n - 1];
+    for (i = n; i < ngs->n_hyp_bp; ++i) {
+        int32 wid = ngs->bp_table[ngs->hyp_bp[i]].wid;
+        if (dict_real_word(dict, wid))
+            len += strlen(dict_basestr(dict, wid)) + (len > 0);
+        ngs->hyp_len[i] = len;
     }
 
-    ckd_free(base->hyp_str);
+    /* And only rebuild the string from there. */
     if (len == 0) {
-	base->hyp_str = NULL;
-	return base->hyp_str;
+        ckd_free(base->hyp_str);
+        base->hyp_str = NULL;
+        return base->hyp_str;
     }
-    base->hyp_str = ckd_calloc(1, len);
+    base->hyp_str = ckd_realloc(base->hyp_str, len + 1);
+    c = base->hyp_str + ((n == 0) ? 0 : ngs->hyp_len[n - 1]);
+    for (i = n; i < ngs->n_hyp_bp; ++i) {
+        int32 wid = ngs->bp_table[ngs->hyp_bp[i]].wid;
+        size_t wlen;
 
-    bp = bpidx;
-    c = base->hyp_str + len - 1;
-    while (bp != NO_BP) {
-        bptbl_t *be = &ngs->bp_table[bp];
-        size_t len;
+        if (!dict_real_word(dict, wid))
+            continue;
+        if (c > base->hyp_str)
+            *c++ = ' ';
+        wlen = strlen(dict_basestr(dict, wid));
+        memcpy(c, dict_basestr(dict, wid), wlen);
+        c += wlen;
+    }
+    *c = '\0';
 
-        bp = be->bp;
-        if (dict_real_word(ps_search_dict(ngs), be->wid)) {
-            len = strlen(dict_basestr(ps_search_dict(ngs), be->wid));
-            c -= len;
-            memcpy(c, dict_basestr(ps_search_dict(ngs), be->wid), len);
-            if (c > base->hyp_str) {
-                --c;
-                *c = ' ';
-            }
+    return base->hyp_str;
+}
+
+void
+ngram_search_mark_live(ngram_search_t *ngs, int32 bp)
+{
+    if (bp == NO_BP || bitvec_is_set(ngs->bp_live, bp))
+        return;
+    bitvec_set(ngs->bp_live, bp);
+    ++ngs->n_bp_live;
+    if (bp > ngs->max_bp_live)
+        ngs->max_bp_live = bp;
+}
+
+int32
+ngram_search_hyp_stable(ngram_search_t *ngs)
+{
+    int32 bp, ef, n, stable;
+
+    if (ngs->n_hyp_bp == 0)
+        return 0;
+
+    if (ngs->bp_live_size < ngs->bp_table_size) {
+        ngs->bp_live = bitvec_realloc(ngs->bp_live, ngs->bp_live_size,
+                                      ngs->bp_table_size);
+        ngs->bp_live_size = ngs->bp_table_size;
+    }
+    ngs->n_bp_live = 0;
+    ngs->max_bp_live = NO_BP;
+
+    /* Live paths are the current hypothesis, the most recent word
+     * exits, and the histories of all active HMMs. */
+    ngram_search_mark_live(ngs, ngs->hyp_bp[ngs->n_hyp_bp - 1]);
+    for (ef = ngs->n_frame - 1;
+         ef > 0 && ngs->bp_table_idx[ef] == ngs->bpidx; --ef)
+        ;
+    for (bp = ngs->bp_table_idx[ef]; bp < ngs->bpidx; ++bp)
+        ngram_search_mark_live(ngs, bp);
+    if (ngs->fwdtree)
+        ngram_fwdtree_mark_live(ngs);
+    else
+        ngram_fwdflat_mark_live(ngs);
+
+    /* Their most recent common ancestor is the first entry, counting
+     * backwards, at which only one marked path remains.  Only the
+     * entries since then are visited. */
+    stable = NO_BP;
+    for (bp = ngs->max_bp_live, n = ngs->n_bp_live; n > 0; --bp) {
+        int32 pbp;
+
+        if (bitvec_is_clear(ngs->bp_live, bp))
+            continue;
+        bitvec_clear(ngs->bp_live, bp);
+        if (n == 1) {
+            stable = bp;
+            break;
+        }
+        --n;
+        pbp = ngs->bp_table[bp].bp;
+        if (pbp != NO_BP && bitvec_is_clear(ngs->bp_live, pbp)) {
+            bitvec_set(ngs->bp_live, pbp);
+            ++n;
         }
     }
+    if (stable == NO_BP)
+        return 0;
 
-    return base->hyp_str;
+    /* Which makes it part of the current hypothesis. */
+    for (n = ngs->n_hyp_bp - 1; n >= 0; --n)
+        if (ngs->hyp_bp[n] == stable)
+            return ngs->hyp_len[n];
+    return 0;
 }
 
 void
@@ -664,7 +862,7 @@ ngram_search_exit_score(ngram_search_t *ngs, bptbl_t *pbe, int rcphone)
     /* DICT2PID */
     /* Get the mapping from right context phone ID to index in the
      * right context table and the bscore_stack. */
-    if (pbe->last2_phone == -1) {
+    if (pbe->s_idx == -1) {
         /* No right context for single phone predecessor words. */
         return pbe->score;
     }
@@ -673,7 +871,8 @@ ngram_search_exit_score(ngram_search_t *ngs, bptbl_t *pbe, int rcphone)
         /* Find the index for the last diphone of the previous word +
          * the first phone of the current word. */
         rssid = dict2pid_rssid(ps_search_dict2pid(ngs),
-                               pbe->last_phone, pbe->last2_phone);
+                               bptbl_last_phone(ngs, pbe),
+                               bptbl_last2_phone(ngs, pbe));
         /* This may be WORST_SCORE, which means that there was no exit
          * with rcphone as right context. */
         return ngs->bscore_stack[pbe->s_idx + rssid->cimap[rcphone]];
@@ -732,6 +931,11 @@ ngram_search_start(ps_search_t *search)
 
     ngs->done = FALSE;
     ngram_model_flush(ngs->lmset);
+    ngs->st.n_bp = 0;
+    ngs->st.n_bp_retired = 0;
+    ngs->st.n_bp_peak = 0;
+    ngs->st.n_lm_lookup = 0;
+    ngs->st.n_lm_cache_hit = 0;
     if (ngs->fwdtree)
         ngram_fwdtree_start(ngs);
     else if (ngs->fwdflat)
@@ -754,6 +958,17 @@ ngram_search_step(ps_search_t *search, int frame_idx)
         return -1;
 }
 
+static void
+ngram_search_sen_active(ps_search_t *search, int frame_idx)
+{
+    ngram_search_t *ngs = (ngram_search_t *)search;
+
+    if (ngs->fwdtree)
+        ngram_fwdtree_sen_active(ngs, frame_idx);
+    else if (ngs->fwdflat)
+        ngram_fwdflat_sen_active(ngs, frame_idx);
+}
+
 void
 dump_bptable(ngram_search_t *ngs)
 {
@@ -770,11 +985,7 @@ dump_bptable(ngram_search_t *ngs)
                     bpe->frame, bpe->score, bpe->bp,
                     bpe->real_wid, bpe->prev_real_wid);
 
-        if (bpe->last2_phone == -1)
-            rcsize = 0;
-        else
-            rcsize = dict2pid_rssid(ps_search_dict2pid(ngs),
-                                    bpe->last_phone, bpe->last2_phone)->n_ssid;
+        rcsize = bptbl_rcsize(ngs, bpe);
         if (rcsize) {
             E_INFOCONT("\tbss");
             for (j = 0; j < rcsize; ++j)
@@ -878,12 +1089,19 @@ ngram_search_hyp(ps_search_t *search, int32 *out_score, int32 *out_is_final)
         return hyp;
     }
     else {
+        char const *hyp;
         int32 bpidx;
 
         /* fwdtree and fwdflat use same backpointer table. */
         bpidx = ngram_search_find_exit(ngs, -1, out_score, out_is_final);
-        if (bpidx != NO_BP)
-            return ngram_search_bp_hyp(ngs, bpidx);
+        if (bpidx != NO_BP) {
+            hyp = ngram_search_bp_hyp(ngs, bpidx);
+            /* A later pass may still change anything. */
+            if (hyp && !ngs->done && !ngs->bestpath
+                && !(ngs->fwdtree && ngs->fwdflat))
+                search->hyp_n_stable = ngram_search_hyp_stable(ngs);
+            return hyp;
+        }
     }
 
     return NULL;
@@ -1068,6 +1286,25 @@ ngram_search_prob(ps_search_t *search)
     }
 }
 
+static void
+ngram_search_stats(ps_search_t *search, ps_stats_t *stats)
+{
+    ngram_search_t *ngs = (ngram_search_t *)search;
+
+    /* Last channels are counted among the non-root ones in the tree
+     * search; every channel in the flat search belongs to a word. */
+    stats->n_root_hmm_eval = ngs->st.n_root_chan_eval;
+    stats->n_nonroot_hmm_eval = ngs->st.n_nonroot_chan_eval
+        - ngs->st.n_last_chan_eval;
+    stats->n_word_hmm_eval = ngs->st.n_last_chan_eval
+        + ngs->st.n_fwdflat_chan;
+    stats->n_bp = ngs->st.n_bp;
+    stats->n_bp_retired = ngs->st.n_bp_retired;
+    stats->n_bp_peak = ngs->st.n_bp_peak;
+    stats->n_lm_lookup = ngs->st.n_lm_lookup;
+    stats->n_lm_cache_hit = ngs->st.n_lm_cache_hit;
+}
+
 static void
 create_dag_nodes(ngram_search_t *ngs, ps_lattice_t *dag)
 {
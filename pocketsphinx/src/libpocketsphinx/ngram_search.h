@@ -52,6 +52,7 @@
 /* Local headers. */
 #include "pocketsphinx_internal.h"
 #include "hmm.h"
+#include "hmm_simd.h"
 
 /**
  * Lexical tree node data type.
@@ -105,21 +106,34 @@ typedef struct root_chan_s {
 
 /**
  * Back pointer table (forward pass lattice; actually a tree)
+ *
+ * Anything that can be recomputed from the word ID (such as its last
+ * two phones, see bptbl_last_phone()) is not stored here, to keep
+ * entries small in long utterances.
  */
 typedef struct bptbl_s {
     frame_idx_t  frame;		/**< start or end frame */
     uint8    valid;		/**< For absolute pruning */
-    uint8    refcnt;            /**< Reference count (number of successors) */
     int32    wid;		/**< Word index */
     int32    bp;		/**< Back Pointer */
     int32    score;		/**< Score (best among all right contexts) */
     int32    s_idx;		/**< Start of BScoreStack for various right contexts*/
     int32    real_wid;		/**< wid of this or latest predecessor real word */
     int32    prev_real_wid;	/**< wid of second-last real word */
-    int16    last_phone;        /**< last phone of this word */
-    int16    last2_phone;       /**< next-to-last phone of this word */
 } bptbl_t;
 
+/**
+ * Last phone of the word in a backpointer entry.
+ */
+#define bptbl_last_phone(ngs, be) dict_last_phone(ps_search_dict(ngs), (be)->wid)
+/**
+ * Next-to-last phone of the word in a backpointer entry, or -1 for
+ * single-phone words.
+ */
+#define bptbl_last2_phone(ngs, be)                                      \
+    (dict_is_single_phone(ps_search_dict(ngs), (be)->wid)               \
+     ? -1 : dict_second_last_phone(ps_search_dict(ngs), (be)->wid))
+
 /**
  * Segmentation "iterator" for backpointer table results.
  */
@@ -188,6 +202,11 @@ typedef struct ngram_search_stats_s {
     int32 n_fwdflat_words;
     int32 n_fwdflat_word_transition;
     int32 n_senone_active_utt;
+    int32 n_bp;            /**< Backpointer entries created. */
+    int32 n_bp_retired;    /**< Backpointer entries garbage collected. */
+    int32 n_bp_peak;       /**< Most backpointer entries kept at once. */
+    int32 n_lm_lookup;     /**< Language model scores looked up. */
+    int32 n_lm_cache_hit;  /**< Word transitions reusing a known LM score. */
 } ngram_search_stats_t;
 
 
@@ -198,6 +217,7 @@ struct ngram_search_s {
     ps_search_t base;
     ngram_model_t *lmset;  /**< Set of language models. */
     hmm_context_t *hmmctx; /**< HMM context. */
+    hmm_simd_t *hmm_simd;  /**< Vectorized HMM evaluation, or NULL. */
 
     /* Flags to quickly indicate which passes are enabled. */
     uint8 fwdtree;
@@ -231,6 +251,7 @@ struct ngram_search_s {
     root_chan_t *root_chan;  /**< Roots of search tree. */
     int32 n_root_chan_alloc; /**< Number of root_chan allocated */
     int32 n_root_chan;       /**< Number of valid root_chan */
+    chan_t *nonroot_chan;    /**< Non-root channels, in breadth-first order */
     int32 n_nonroot_chan;    /**< Number of valid non-root channels */
     int32 max_nonroot_chan;  /**< Maximum possible number of non-root channels */
     root_chan_t *rhmm_1ph;   /**< Root HMMs for single-phone words */
@@ -287,6 +308,26 @@ struct ngram_search_s {
     int32 **active_word_list;
     int32 n_active_word[2];  /**< Number entries in active_word_list */
 
+    /**
+     * Language model lookahead (see -lmla).
+     *
+     * Each node of the HMM tree gets the best LM score of the words
+     * below it, which is added to paths as they enter the node, less
+     * that of its parent, so that unlikely words are pruned before
+     * their last phones.  It is taken back off when a word enters its
+     * last phone and the real LM score is applied.  Nodes are
+     * numbered with the root channels first, then the non-root
+     * channels in the order of nonroot_chan.
+     */
+    int32 n_lmla_node;   /**< Number of nodes, or 0 if lookahead is off. */
+    int32 *lmla_uni;     /**< Unigram lookahead scores. */
+    int32 **lmla;        /**< Bigram lookahead scores for recent histories. */
+    int32 *lmla_hist;    /**< History word of each row of lmla, or -1. */
+    int32 *lmla_stamp;   /**< Value of lmla_clock when each row was last used. */
+    int32 *lmla_row;     /**< Row of lmla for each history word, or -1. */
+    int32 n_lmla_cache;  /**< Number of rows in lmla (0 for unigrams only). */
+    int32 lmla_clock;    /**< Frames searched, for least recently used rows. */
+
     /*
      * FIXME: Document all of these bits.
      */
@@ -303,6 +344,8 @@ struct ngram_search_s {
     int32 *bscore_stack;     /* Score stack for all possible right contexts */
     int32 bss_head;          /* First free BScoreStack entry */
     int32 bscore_stack_size;
+    int32 bp_gc_next;        /**< Garbage collect bp_table once bpidx gets
+                                past this (0 for never, see -bpgc). */
 
     int32 n_frame_alloc; /**< Number of frames allocated in bp_table_idx and friends. */
     int32 n_frame;       /**< Number of frames actually present. */
@@ -310,6 +353,18 @@ struct ngram_search_s {
     int32 *word_lat_idx; /* BPTable index for any word in current frame;
                             cleared before each frame */
 
+    /*
+     * Partial hypothesis cache (see ngram_search_bp_hyp()).
+     */
+    int32 *hyp_bp;       /**< Backpointers on the path of hyp_str, oldest first. */
+    int32 *hyp_len;      /**< Length of hyp_str up to the word in each of them. */
+    int32 n_hyp_bp;      /**< Number of entries in hyp_bp. */
+    int32 n_hyp_bp_alloc; /**< Number of entries allocated in hyp_bp and hyp_len. */
+    bitvec_t *bp_live;   /**< Entries marked by ngram_search_mark_live(). */
+    int32 bp_live_size;  /**< Number of bits allocated in bp_live. */
+    int32 n_bp_live;     /**< Number of bits set in bp_live. */
+    int32 max_bp_live;   /**< Highest bit set in bp_live. */
+
     /*
      * Flat lexicon (2nd pass) search stuff.
      */
@@ -384,6 +439,22 @@ int ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx);
 void ngram_search_save_bp(ngram_search_t *ngs, int frame_idx, int32 w,
                           int32 score, int32 path, int32 rc);
 
+/**
+ * Garbage collect the backpointer table.
+ *
+ * Entries before first_active which are not ancestors of an entry at
+ * or after it are discarded, and the table, score stack and frame
+ * index are compacted.
+ *
+ * @param first_active First entry which must be kept along with
+ *                     everything after it.
+ * @return Newly allocated array mapping old entry IDs to new ones
+ *         (NO_BP for discarded ones), which the caller must use to
+ *         update any references it holds and then free, or NULL if
+ *         nothing was discarded.
+ */
+int32 *ngram_search_gc_bptable(ngram_search_t *ngs, int32 first_active);
+
 /**
  * Allocate last phone channels for all possible right contexts for word w.
  */
@@ -408,6 +479,23 @@ int ngram_search_find_exit(ngram_search_t *ngs, int frame_idx, int32 *out_best_s
  */
 char const *ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx);
 
+/**
+ * Mark a backpointer entry as the history of some path still active
+ * in the search.
+ */
+void ngram_search_mark_live(ngram_search_t *ngs, int32 bp);
+
+/**
+ * Find the length of the part of the current hypothesis which all
+ * active paths agree on, and which therefore will not change.
+ *
+ * Must be called after ngram_search_bp_hyp().
+ *
+ * @return Number of characters at the start of hyp_str which will
+ *         not change in this pass.
+ */
+int32 ngram_search_hyp_stable(ngram_search_t *ngs);
+
 /**
  * Compute language and acoustic scores for backpointer table entries.
  */
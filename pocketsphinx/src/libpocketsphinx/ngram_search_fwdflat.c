@@ -383,6 +383,7 @@ ngram_fwdflat_start(ngram_search_t *ngs)
 
     ngs->bpidx = 0;
     ngs->bss_head = 0;
+    ngs->n_hyp_bp = 0;
 
     for (i = 0; i < ps_search_n_words(ngs); i++)
         ngs->word_lat_idx[i] = NO_BP;
@@ -416,16 +417,14 @@ ngram_fwdflat_start(ngram_search_t *ngs)
     ngs->st.n_senone_active_utt = 0;
 }
 
-static void
-compute_fwdflat_sen_active(ngram_search_t *ngs, int frame_idx)
+void
+ngram_fwdflat_sen_active(ngram_search_t *ngs, int frame_idx)
 {
     int32 i, w;
     int32 *awl;
     root_chan_t *rhmm;
     chan_t *hmm;
 
-    acmod_clear_active(ps_search_acmod(ngs));
-
     i = ngs->n_active_word[frame_idx & 0x1];
     awl = ngs->active_word_list[frame_idx & 0x1];
 
@@ -678,10 +677,11 @@ fwdflat_word_transition(ngram_search_t *ngs, int frame_idx)
         /* Get the mapping from right context phone ID to index in the
          * right context table and the bscore_stack. */
         rcss = ngs->bscore_stack + bp->s_idx;
-        if (bp->last2_phone == -1)
+        if (bp->s_idx == -1)
             rssid = NULL;
         else
-            rssid = dict2pid_rssid(d2p, bp->last_phone, bp->last2_phone);
+            rssid = dict2pid_rssid(d2p, bptbl_last_phone(ngs, bp),
+                                   bptbl_last2_phone(ngs, bp));
 
         /* Transition to all successor words. */
         for (i = 0; ngs->expand_word_list[i] >= 0; i++) {
@@ -698,6 +698,7 @@ fwdflat_word_transition(ngram_search_t *ngs, int frame_idx)
             if (newscore == WORST_SCORE)
                 continue;
             /* FIXME: Floating point... */
+            ++ngs->st.n_lm_lookup;
             newscore += lwf
                 * (ngram_tg_score(ngs->lmset,
                                   dict_basewid(dict, w),
@@ -812,8 +813,11 @@ ngram_fwdflat_search(ngram_search_t *ngs, int frame_idx)
     int32 *nawl;
 
     /* Activate our HMMs for the current frame if need be. */
-    if (!ps_search_acmod(ngs)->compallsen)
-        compute_fwdflat_sen_active(ngs, frame_idx);
+    if (!ps_search_acmod(ngs)->compallsen
+        && !ps_search_acmod(ngs)->senscr_shared) {
+        acmod_clear_active(ps_search_acmod(ngs));
+        ngram_fwdflat_sen_active(ngs, frame_idx);
+    }
 
     /* Compute GMM scores for the current frame. */
     senscr = acmod_score(ps_search_acmod(ngs), &frame_idx);
@@ -866,6 +870,38 @@ ngram_fwdflat_search(ngram_search_t *ngs, int frame_idx)
     return 1;
 }
 
+static void
+fwdflat_mark_hmm_history(ngram_search_t *ngs, hmm_t *hmm)
+{
+    int i;
+
+    for (i = 0; i < hmm_n_emit_state(hmm); ++i)
+        if (hmm_score(hmm, i) BETTER_THAN WORST_SCORE)
+            ngram_search_mark_live(ngs, hmm_history(hmm, i));
+    if (hmm_out_score(hmm) BETTER_THAN WORST_SCORE)
+        ngram_search_mark_live(ngs, hmm_out_history(hmm));
+}
+
+void
+ngram_fwdflat_mark_live(ngram_search_t *ngs)
+{
+    root_chan_t *rhmm;
+    chan_t *hmm;
+    int32 i, nf, w, *awl;
+
+    nf = ngs->n_frame;
+    i = ngs->n_active_word[nf & 0x1];
+    awl = ngs->active_word_list[nf & 0x1];
+    for (w = *(awl++); i > 0; --i, w = *(awl++)) {
+        rhmm = (root_chan_t *) ngs->word_chan[w];
+        if (hmm_frame(&rhmm->hmm) == nf)
+            fwdflat_mark_hmm_history(ngs, &rhmm->hmm);
+        for (hmm = rhmm->next; hmm; hmm = hmm->next)
+            if (hmm_frame(&hmm->hmm) == nf)
+                fwdflat_mark_hmm_history(ngs, &hmm->hmm);
+    }
+}
+
 /**
  * Destroy wordlist from the current utterance.
  */
@@ -72,6 +72,18 @@ void ngram_fwdflat_start(ngram_search_t *ngs);
  */
 int ngram_fwdflat_search(ngram_search_t *ngs, int frame_idx);
 
+/**
+ * Activate the senones of all HMMs active in a frame, without clearing
+ * the ones already active.
+ */
+void ngram_fwdflat_sen_active(ngram_search_t *ngs, int frame_idx);
+
+/**
+ * Mark the histories of all HMMs active in the next frame with
+ * ngram_search_mark_live().
+ */
+void ngram_fwdflat_mark_live(ngram_search_t *ngs);
+
 /**
  * Finish fwdflat decoding for an utterance.
  */
@@ -161,6 +161,206 @@ init_nonroot_chan(ngram_search_t *ngs, chan_t * hmm, int32 ph, int32 ci, int32 t
     hmm_init(ngs->hmmctx, &hmm->hmm, FALSE, ph, tmatid);
 }
 
+/*
+ * Copy a list of sibling channels to the end of the compacted tree,
+ * freeing the originals, and return the first copy.  Their children
+ * are left in place to be copied later.
+ */
+static chan_t *
+copy_siblings(ngram_search_t *ngs, chan_t *hmm, int32 *n_chan)
+{
+    chan_t *first, *sibling;
+
+    first = NULL;
+    for (; hmm; hmm = sibling) {
+        chan_t *copy = ngs->nonroot_chan + (*n_chan)++;
+
+        sibling = hmm->alt;
+        *copy = *hmm;
+        if (first == NULL)
+            first = copy;
+        else
+            copy[-1].alt = copy;
+        copy->alt = NULL;
+        listelem_free(ngs->chan_alloc, hmm);
+    }
+    return first;
+}
+
+/*
+ * Move the interior channels of the search tree into a single array,
+ * in breadth-first order.  The children of any channel are then
+ * adjacent in memory, as are the channels of each level of the tree,
+ * which makes pruning and entering successors much more cache
+ * friendly than following individually allocated nodes.  The order
+ * of siblings, and therefore the search itself, does not change.
+ */
+static void
+compact_search_tree(ngram_search_t *ngs)
+{
+    int32 i, n_chan;
+
+    ngs->nonroot_chan = ckd_calloc(ngs->n_nonroot_chan + 1,
+                                   sizeof(*ngs->nonroot_chan));
+    n_chan = 0;
+    for (i = 0; i < ngs->n_root_chan; i++)
+        ngs->root_chan[i].next =
+            copy_siblings(ngs, ngs->root_chan[i].next, &n_chan);
+    for (i = 0; i < n_chan; i++)
+        ngs->nonroot_chan[i].next =
+            copy_siblings(ngs, ngs->nonroot_chan[i].next, &n_chan);
+    assert(n_chan == ngs->n_nonroot_chan);
+}
+
+/* Lookahead node number of a non-root channel. */
+#define lmla_node(ngs, hmm) \
+    ((ngs)->n_root_chan + (int32)((hmm) - (ngs)->nonroot_chan))
+
+/*
+ * Best LM score, following history word hist (or the unigram score if
+ * hist is negative), of the words w and its homophone set, and of the
+ * channels from child onwards, whose lookahead scores are in la.
+ */
+static int32
+lmla_best_score(ngram_search_t *ngs, int32 const *la, int32 hist,
+                int32 w, chan_t *child)
+{
+    dict_t *dict = ps_search_dict(ngs);
+    int32 best, score, n_used;
+
+    best = WORST_SCORE;
+    for (; w >= 0; w = ngs->homophone_set[w]) {
+        if (hist < 0)
+            score = ngram_ng_score(ngs->lmset, dict_basewid(dict, w),
+                                   NULL, 0, &n_used);
+        else
+            score = ngram_bg_score(ngs->lmset, dict_basewid(dict, w),
+                                   hist, &n_used);
+        ++ngs->st.n_lm_lookup;
+        score >>= SENSCR_SHIFT;
+        if (score BETTER_THAN best)
+            best = score;
+    }
+    for (; child; child = child->alt) {
+        if (la[lmla_node(ngs, child)] BETTER_THAN best)
+            best = la[lmla_node(ngs, child)];
+    }
+    return best;
+}
+
+/*
+ * Compute the lookahead scores of all nodes for history word hist.
+ * Children always come after their parents in nonroot_chan, so going
+ * backwards finds them before they are needed.
+ */
+static void
+lmla_fill(ngram_search_t *ngs, int32 *la, int32 hist)
+{
+    int32 i;
+
+    for (i = ngs->n_nonroot_chan - 1; i >= 0; --i) {
+        chan_t *hmm = ngs->nonroot_chan + i;
+        la[ngs->n_root_chan + i] =
+            lmla_best_score(ngs, la, hist,
+                            hmm->info.penult_phn_wid, hmm->next);
+    }
+    for (i = ngs->n_root_chan - 1; i >= 0; --i) {
+        root_chan_t *rhmm = ngs->root_chan + i;
+        la[i] = lmla_best_score(ngs, la, hist,
+                                rhmm->penult_phn_wid, rhmm->next);
+    }
+}
+
+/*
+ * Set up lookahead scores for a newly created search tree, if enabled.
+ * The bigram ones are only computed when first needed.
+ */
+static void
+lmla_init(ngram_search_t *ngs)
+{
+    cmd_ln_t *config = ps_search_config(ngs);
+    int32 i;
+
+    if (!cmd_ln_boolean_r(config, "-lmla"))
+        return;
+    ngs->n_lmla_node = ngs->n_root_chan + ngs->n_nonroot_chan;
+    ngs->lmla_uni = ckd_calloc(ngs->n_lmla_node + 1,
+                               sizeof(*ngs->lmla_uni));
+    lmla_fill(ngs, ngs->lmla_uni, -1);
+
+    ngs->n_lmla_cache = cmd_ln_int32_r(config, "-lmlacache");
+    if (ngs->n_lmla_cache > 0) {
+        ngs->lmla = ckd_calloc_2d(ngs->n_lmla_cache, ngs->n_lmla_node + 1,
+                                  sizeof(**ngs->lmla));
+        ngs->lmla_hist = ckd_calloc(ngs->n_lmla_cache,
+                                    sizeof(*ngs->lmla_hist));
+        ngs->lmla_stamp = ckd_calloc(ngs->n_lmla_cache,
+                                     sizeof(*ngs->lmla_stamp));
+        for (i = 0; i < ngs->n_lmla_cache; ++i)
+            ngs->lmla_hist[i] = -1;
+        ngs->lmla_row = ckd_calloc(ps_search_n_words(ngs),
+                                   sizeof(*ngs->lmla_row));
+        for (i = 0; i < ps_search_n_words(ngs); ++i)
+            ngs->lmla_row[i] = -1;
+    }
+    else
+        ngs->n_lmla_cache = 0;
+    E_INFO("LM lookahead on %d nodes, bigrams cached for %d history words\n",
+           ngs->n_lmla_node, ngs->n_lmla_cache);
+}
+
+static void
+lmla_free(ngram_search_t *ngs)
+{
+    ckd_free(ngs->lmla_uni);
+    ngs->lmla_uni = NULL;
+    if (ngs->lmla)
+        ckd_free_2d(ngs->lmla);
+    ngs->lmla = NULL;
+    ckd_free(ngs->lmla_hist);
+    ngs->lmla_hist = NULL;
+    ckd_free(ngs->lmla_stamp);
+    ngs->lmla_stamp = NULL;
+    ckd_free(ngs->lmla_row);
+    ngs->lmla_row = NULL;
+    ngs->n_lmla_node = 0;
+    ngs->n_lmla_cache = 0;
+}
+
+/*
+ * Find the lookahead scores for paths in the tree whose history is
+ * backpointer bp, or NULL if lookahead is off.  Bigram scores are
+ * computed for a new history word in place of the least recently
+ * used ones.
+ */
+static int32 const *
+lmla_scores(ngram_search_t *ngs, int32 bp)
+{
+    int32 hist, row, i;
+
+    if (ngs->lmla_uni == NULL)
+        return NULL;
+    if (ngs->n_lmla_cache == 0 || bp < 0 || bp >= ngs->bpidx)
+        return ngs->lmla_uni;
+    hist = ngs->bp_table[bp].real_wid;
+    if (hist < 0)
+        return ngs->lmla_uni;
+
+    if ((row = ngs->lmla_row[hist]) < 0) {
+        row = 0;
+        for (i = 1; i < ngs->n_lmla_cache; ++i)
+            if (ngs->lmla_stamp[i] < ngs->lmla_stamp[row])
+                row = i;
+        if (ngs->lmla_hist[row] >= 0)
+            ngs->lmla_row[ngs->lmla_hist[row]] = -1;
+        ngs->lmla_hist[row] = hist;
+        ngs->lmla_row[hist] = row;
+        lmla_fill(ngs, ngs->lmla[row], hist);
+    }
+    ngs->lmla_stamp[row] = ngs->lmla_clock;
+    return ngs->lmla[row];
+}
+
 /*
  * Allocate and initialize search channel-tree structure.
  * At this point, all the root-channels have been allocated and partly initialized
@@ -334,27 +534,13 @@ create_search_tree(ngram_search_t *ngs)
 
     if (!ngs->n_root_chan)
 	E_ERROR("No word from the language model has pronunciation in the dictionary\n");
+    compact_search_tree(ngs);
+    lmla_init(ngs);
 
     E_INFO("after: %d root, %d non-root channels, %d single-phone words\n",
            ngs->n_root_chan, ngs->n_nonroot_chan, ngs->n_1ph_words);
 }
 
-static void
-reinit_search_subtree(ngram_search_t *ngs, chan_t * hmm)
-{
-    chan_t *child, *sibling;
-
-    /* First free all children under hmm */
-    for (child = hmm->next; child; child = sibling) {
-        sibling = child->alt;
-        reinit_search_subtree(ngs, child);
-    }
-
-    /* Now free hmm */
-    hmm_deinit(&hmm->hmm);
-    listelem_free(ngs->chan_alloc, hmm);
-}
-
 /*
  * Delete search tree by freeing all interior channels within search tree and
  * restoring root channel state to the init state (i.e., just after init_search_tree()).
@@ -363,17 +549,13 @@ static void
 reinit_search_tree(ngram_search_t *ngs)
 {
     int32 i;
-    chan_t *hmm, *sibling;
 
+    lmla_free(ngs);
+    for (i = 0; i < ngs->n_nonroot_chan; i++)
+        hmm_deinit(&ngs->nonroot_chan[i].hmm);
+    ckd_free(ngs->nonroot_chan);
+    ngs->nonroot_chan = NULL;
     for (i = 0; i < ngs->n_root_chan; i++) {
-        hmm = ngs->root_chan[i].next;
-
-        while (hmm) {
-            sibling = hmm->alt;
-            reinit_search_subtree(ngs, hmm);
-            hmm = sibling;
-        }
-
         ngs->root_chan[i].penult_phn_wid = -1;
         ngs->root_chan[i].next = NULL;
     }
@@ -487,6 +669,11 @@ ngram_fwdtree_start(ngram_search_t *ngs)
     /* Reset backpointer table. */
     ngs->bpidx = 0;
     ngs->bss_head = 0;
+    /* fwdflat needs all of the first pass backpointers. */
+    if (cmd_ln_boolean_r(ps_search_config(ngs), "-bpgc") && !ngs->fwdflat)
+        ngs->bp_gc_next = cmd_ln_int32_r(ps_search_config(ngs), "-latsize");
+    else
+        ngs->bp_gc_next = 0;
 
     /* Reset word lattice. */
     for (i = 0; i < n_words; ++i)
@@ -508,6 +695,7 @@ ngram_fwdtree_start(ngram_search_t *ngs)
     /* Clear the hypothesis string. */
     ckd_free(base->hyp_str);
     base->hyp_str = NULL;
+    ngs->n_hyp_bp = 0;
 
     /* Reset the permanently allocated single-phone words, since they
      * may have junk left over in them from FWDFLAT. */
@@ -527,15 +715,13 @@ ngram_fwdtree_start(ngram_search_t *ngs)
  * Mark the active senones for all senones belonging to channels that are active in the
  * current frame.
  */
-static void
-compute_sen_active(ngram_search_t *ngs, int frame_idx)
+void
+ngram_fwdtree_sen_active(ngram_search_t *ngs, int frame_idx)
 {
     root_chan_t *rhmm;
     chan_t *hmm, **acl;
     int32 i, w, *awl;
 
-    acmod_clear_active(ps_search_acmod(ngs));
-
     /* Flag active senones for root channels */
     for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++) {
         if (hmm_frame(&rhmm->hmm) == frame_idx)
@@ -635,6 +821,15 @@ eval_nonroot_chan(ngram_search_t *ngs, int frame_idx)
     bestscore = WORST_SCORE;
     ngs->st.n_nonroot_chan_eval += i;
 
+    if (ngs->hmm_simd) {
+        hmm_simd_start(ngs->hmm_simd);
+        for (hmm = *(acl++); i > 0; --i, hmm = *(acl++)) {
+            assert(hmm_frame(&hmm->hmm) == frame_idx);
+            hmm_simd_add(ngs->hmm_simd, &hmm->hmm);
+        }
+        return hmm_simd_finish(ngs->hmm_simd);
+    }
+
     for (hmm = *(acl++); i > 0; --i, hmm = *(acl++)) {
         int32 score = chan_v_eval(hmm);
         assert(hmm_frame(&hmm->hmm) == frame_idx);
@@ -656,6 +851,8 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
     bestscore = WORST_SCORE;
     awl = ngs->active_word_list[frame_idx & 0x1];
 
+    if (ngs->hmm_simd)
+        hmm_simd_start(ngs->hmm_simd);
     i = ngs->n_active_word[frame_idx & 0x1];
     for (w = *(awl++); i > 0; --i, w = *(awl++)) {
         assert(bitvec_is_set(ngs->word_active, w));
@@ -666,15 +863,20 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
             int32 score;
 
             assert(hmm_frame(&hmm->hmm) == frame_idx);
+            k++;
+            if (ngs->hmm_simd) {
+                hmm_simd_add(ngs->hmm_simd, &hmm->hmm);
+                continue;
+            }
             score = chan_v_eval(hmm);
             /*printf("eval word chan %d score %d\n", w, score); */
 
             if (score BETTER_THAN bestscore)
                 bestscore = score;
-
-            k++;
         }
     }
+    if (ngs->hmm_simd)
+        bestscore = hmm_simd_finish(ngs->hmm_simd);
 
     /* Similarly for statically allocated single-phone words */
     j = 0;
@@ -749,19 +951,30 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
             continue;
 
         if (hmm_bestscore(&rhmm->hmm) BETTER_THAN thresh) {
+            int32 const *la;
+            int32 lascr;
+
             hmm_frame(&rhmm->hmm) = nf;  /* rhmm will be active in next frame */
             E_DEBUG(3,("Preserving root channel %d score %d\n", i, hmm_bestscore(&rhmm->hmm)));
             /* transitions out of this root channel */
             /* transition to all next-level channels in the HMM tree */
             newphone_score = hmm_out_score(&rhmm->hmm) + ngs->pip;
+            /* LM lookahead already applied to this path, if any. */
+            la = lmla_scores(ngs, hmm_out_history(&rhmm->hmm));
+            lascr = la ? la[i] : 0;
             if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
                 for (hmm = rhmm->next; hmm; hmm = hmm->alt) {
-                    int32 pl_newphone_score = newphone_score
+                    int32 score = newphone_score;
+                    int32 pl_newphone_score;
+
+                    if (la)
+                        score += la[lmla_node(ngs, hmm)] - lascr;
+                    pl_newphone_score = score
                         + phone_loop_search_score(pls, hmm->ciphone);
                     if (pl_newphone_score BETTER_THAN newphone_thresh) {
                         if ((hmm_frame(&hmm->hmm) < frame_idx)
-                            || (newphone_score BETTER_THAN hmm_in_score(&hmm->hmm))) {
-                            hmm_enter(&hmm->hmm, newphone_score,
+                            || (score BETTER_THAN hmm_in_score(&hmm->hmm))) {
+                            hmm_enter(&hmm->hmm, score,
                                       hmm_out_history(&rhmm->hmm), nf);
                             *(nacl++) = hmm;
                         }
@@ -786,7 +999,7 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
                         ngs->n_lastphn_cand++;
                         candp->wid = w;
                         candp->score =
-                            newphone_score - ngs->nwpen;
+                            newphone_score - ngs->nwpen - lascr;
                         candp->bp = hmm_out_history(&rhmm->hmm);
                     }
                 }
@@ -809,6 +1022,8 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
     chan_t **acl, **nacl;       /* active list, next active list */
     lastphn_cand_t *candp;
     phone_loop_search_t *pls;
+    int32 const *la;
+    int32 lascr;
 
     nf = frame_idx + 1;
 
@@ -833,19 +1048,26 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
 
             /* transition to all next-level channel in the HMM tree */
             newphone_score = hmm_out_score(&hmm->hmm) + ngs->pip;
+            la = lmla_scores(ngs, hmm_out_history(&hmm->hmm));
+            lascr = la ? la[lmla_node(ngs, hmm)] : 0;
             if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
                 for (nexthmm = hmm->next; nexthmm; nexthmm = nexthmm->alt) {
-                    int32 pl_newphone_score = newphone_score
+                    int32 score = newphone_score;
+                    int32 pl_newphone_score;
+
+                    if (la)
+                        score += la[lmla_node(ngs, nexthmm)] - lascr;
+                    pl_newphone_score = score
                         + phone_loop_search_score(pls, nexthmm->ciphone);
                     if ((pl_newphone_score BETTER_THAN newphone_thresh)
                         && ((hmm_frame(&nexthmm->hmm) < frame_idx)
-                            || (newphone_score
+                            || (score
                                 BETTER_THAN hmm_in_score(&nexthmm->hmm)))) {
                         if (hmm_frame(&nexthmm->hmm) != nf) {
                             /* Keep this HMM on the active list */
                             *(nacl++) = nexthmm;
                         }
-                        hmm_enter(&nexthmm->hmm, newphone_score,
+                        hmm_enter(&nexthmm->hmm, score,
                                   hmm_out_history(&hmm->hmm), nf);
                     }
                 }
@@ -867,7 +1089,7 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
                         ngs->n_lastphn_cand++;
                         candp->wid = w;
                         candp->score =
-                            newphone_score - ngs->nwpen;
+                            newphone_score - ngs->nwpen - lascr;
                         candp->bp = hmm_out_history(&hmm->hmm);
                     }
                 }
@@ -964,6 +1186,8 @@ last_phone_transition(ngram_search_t *ngs, int frame_idx)
             ngs->last_ltrans[candp->wid].dscr = WORST_SCORE;
             ngs->last_ltrans[candp->wid].sf = bpe->frame + 1;
         }
+        else
+            ++ngs->st.n_lm_cache_hit;
     }
 
     /* Compute best LM score and bp for new cands entered in the sorted lists above */
@@ -983,6 +1207,7 @@ last_phone_transition(ngram_search_t *ngs, int frame_idx)
                     (ngs, bpe, dict_first_phone(ps_search_dict(ngs), candp->wid));
                 if (dscr BETTER_THAN WORST_SCORE) {
                     assert(!dict_filler_word(ps_search_dict(ngs), candp->wid));
+                    ++ngs->st.n_lm_lookup;
                     dscr += ngram_tg_score(ngs->lmset,
                                            dict_basewid(ps_search_dict(ngs), candp->wid),
                                            bpe->real_wid,
@@ -1245,12 +1470,13 @@ static void
 word_transition(ngram_search_t *ngs, int frame_idx)
 {
     int32 i, k, bp, w, nf;
-    int32 rc;
+    int32 rc, last_phone;
     int32 thresh, newscore, pl_newscore;
     bptbl_t *bpe;
     root_chan_t *rhmm;
     struct bestbp_rc_s *bestbp_rc_ptr;
     phone_loop_search_t *pls;
+    int32 const *la;
     dict_t *dict = ps_search_dict(ngs);
     dict2pid_t *d2p = ps_search_dict2pid(ngs);
 
@@ -1277,28 +1503,30 @@ word_transition(ngram_search_t *ngs, int frame_idx)
         /* Array of HMM scores corresponding to all the possible right
          * context expansions of the final phone.  It's likely that a
          * lot of these are going to be missing, actually. */
-        if (bpe->last2_phone == -1) { /* implies s_idx == -1 */
+        last_phone = bptbl_last_phone(ngs, bpe);
+        if (bpe->s_idx == -1) {
             /* No right context expansion. */
             for (rc = 0; rc < bin_mdef_n_ciphone(ps_search_acmod(ngs)->mdef); ++rc) {
                 if (bpe->score BETTER_THAN ngs->bestbp_rc[rc].score) {
                     E_DEBUG(4,("bestbp_rc[0] = %d lc %d\n",
-                               bpe->score, bpe->last_phone));
+                               bpe->score, last_phone));
                     ngs->bestbp_rc[rc].score = bpe->score;
                     ngs->bestbp_rc[rc].path = bp;
-                    ngs->bestbp_rc[rc].lc = bpe->last_phone;
+                    ngs->bestbp_rc[rc].lc = last_phone;
                 }
             }
         }
         else {
-            xwdssid_t *rssid = dict2pid_rssid(d2p, bpe->last_phone, bpe->last2_phone);
+            xwdssid_t *rssid = dict2pid_rssid(d2p, last_phone,
+                                              bptbl_last2_phone(ngs, bpe));
             int32 *rcss = &(ngs->bscore_stack[bpe->s_idx]);
             for (rc = 0; rc < bin_mdef_n_ciphone(ps_search_acmod(ngs)->mdef); ++rc) {
                 if (rcss[rssid->cimap[rc]] BETTER_THAN ngs->bestbp_rc[rc].score) {
                     E_DEBUG(4,("bestbp_rc[%d] = %d lc %d\n",
-                               rc, rcss[rssid->cimap[rc]], bpe->last_phone));
+                               rc, rcss[rssid->cimap[rc]], last_phone));
                     ngs->bestbp_rc[rc].score = rcss[rssid->cimap[rc]];
                     ngs->bestbp_rc[rc].path = bp;
-                    ngs->bestbp_rc[rc].lc = bpe->last_phone;
+                    ngs->bestbp_rc[rc].lc = last_phone;
                 }
             }
         }
@@ -1316,6 +1544,8 @@ word_transition(ngram_search_t *ngs, int frame_idx)
         bestbp_rc_ptr = &(ngs->bestbp_rc[rhmm->ciphone]);
 
         newscore = bestbp_rc_ptr->score + ngs->nwpen + ngs->pip;
+        if ((la = lmla_scores(ngs, bestbp_rc_ptr->path)) != NULL)
+            newscore += la[rhmm - ngs->root_chan];
         pl_newscore = newscore
             + phone_loop_search_score(pls, rhmm->ciphone);
         if (pl_newscore BETTER_THAN thresh) {
@@ -1352,12 +1582,14 @@ word_transition(ngram_search_t *ngs, int frame_idx)
                 (ngs, bpe, dict_first_phone(dict, w));
             E_DEBUG(4, ("initial newscore for %s: %d\n",
                         dict_wordstr(dict, w), newscore));
-            if (newscore != WORST_SCORE)
+            if (newscore != WORST_SCORE) {
+                ++ngs->st.n_lm_lookup;
                 newscore += ngram_tg_score(ngs->lmset,
                                            dict_basewid(dict, w),
                                            bpe->real_wid,
                                            bpe->prev_real_wid,
                                            &n_used)>>SENSCR_SHIFT;
+            }
 
             /* FIXME: Not sure how WORST_SCORE could be better, but it
              * apparently happens. */
@@ -1454,14 +1686,164 @@ deactivate_channels(ngram_search_t *ngs, int frame_idx)
     }
 }
 
+/*
+ * Function called on each HMM by foreach_active_hmm().
+ */
+typedef void (*hmm_visit_f)(ngram_search_t *ngs, hmm_t *hmm, void *udata);
+
+/*
+ * Call a function on all HMMs active in frame nf (after
+ * deactivate_channels()).
+ */
+static void
+foreach_active_hmm(ngram_search_t *ngs, int nf, hmm_visit_f fn, void *udata)
+{
+    root_chan_t *rhmm;
+    chan_t *hmm, **acl;
+    int32 i, w, *awl;
+
+    for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++)
+        (*fn)(ngs, &rhmm->hmm, udata);
+    i = ngs->n_active_chan[nf & 0x1];
+    acl = ngs->active_chan_list[nf & 0x1];
+    for (hmm = *(acl++); i > 0; --i, hmm = *(acl++))
+        (*fn)(ngs, &hmm->hmm, udata);
+    i = ngs->n_active_word[nf & 0x1];
+    awl = ngs->active_word_list[nf & 0x1];
+    for (w = *(awl++); i > 0; --i, w = *(awl++))
+        for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next)
+            (*fn)(ngs, &hmm->hmm, udata);
+    for (i = 0; i < ngs->n_1ph_words; i++) {
+        w = ngs->single_phone_wid[i];
+        rhmm = (root_chan_t *) ngs->word_chan[w];
+        (*fn)(ngs, &rhmm->hmm, udata);
+    }
+}
+
+/*
+ * Find the oldest frame in the histories of the live states of an
+ * HMM.  Dead states may hold stale histories, which are ignored.
+ */
+static void
+oldest_hmm_history(ngram_search_t *ngs, hmm_t *hmm, void *udata)
+{
+    int32 *oldest = (int32 *)udata;
+    int i;
+
+    for (i = 0; i < hmm_n_emit_state(hmm); ++i) {
+        if (hmm_score(hmm, i) BETTER_THAN WORST_SCORE
+            && hmm_history(hmm, i) != NO_BP
+            && ngs->bp_table[hmm_history(hmm, i)].frame < *oldest)
+            *oldest = ngs->bp_table[hmm_history(hmm, i)].frame;
+    }
+    if (hmm_out_score(hmm) BETTER_THAN WORST_SCORE
+        && hmm_out_history(hmm) != NO_BP
+        && ngs->bp_table[hmm_out_history(hmm)].frame < *oldest)
+        *oldest = ngs->bp_table[hmm_out_history(hmm)].frame;
+}
+
+/*
+ * Renumber the histories of the live states of an HMM after garbage
+ * collection, and drop those of dead states.
+ */
+static void
+remap_hmm_history(ngram_search_t *ngs, hmm_t *hmm, void *udata)
+{
+    int32 const *map = (int32 const *)udata;
+    int i;
+
+    for (i = 0; i < hmm_n_emit_state(hmm); ++i) {
+        if (!(hmm_score(hmm, i) BETTER_THAN WORST_SCORE)
+            || hmm_history(hmm, i) == NO_BP)
+            hmm_history(hmm, i) = NO_BP;
+        else {
+            hmm_history(hmm, i) = map[hmm_history(hmm, i)];
+            assert(hmm_history(hmm, i) != NO_BP);
+        }
+    }
+    if (!(hmm_out_score(hmm) BETTER_THAN WORST_SCORE)
+        || hmm_out_history(hmm) == NO_BP)
+        hmm_out_history(hmm) = NO_BP;
+    else {
+        hmm_out_history(hmm) = map[hmm_out_history(hmm)];
+        assert(hmm_out_history(hmm) != NO_BP);
+    }
+}
+
+/*
+ * Mark the histories of the live states of an HMM.
+ */
+static void
+mark_hmm_history(ngram_search_t *ngs, hmm_t *hmm, void *udata)
+{
+    int i;
+
+    for (i = 0; i < hmm_n_emit_state(hmm); ++i)
+        if (hmm_score(hmm, i) BETTER_THAN WORST_SCORE)
+            ngram_search_mark_live(ngs, hmm_history(hmm, i));
+    if (hmm_out_score(hmm) BETTER_THAN WORST_SCORE)
+        ngram_search_mark_live(ngs, hmm_out_history(hmm));
+}
+
+void
+ngram_fwdtree_mark_live(ngram_search_t *ngs)
+{
+    foreach_active_hmm(ngs, ngs->n_frame, mark_hmm_history, NULL);
+}
+
+/*
+ * Discard backpointer entries which can no longer be part of any
+ * hypothesis, i.e. those which are neither ancestors of a history of
+ * an active HMM nor of the most recent word exits, the latter so that
+ * partial hypotheses are still available.
+ */
+static void
+gc_bptable(ngram_search_t *ngs, int frame_idx)
+{
+    int32 *map;
+    int32 nf, sf, ef, w;
+
+    /* Everything from the oldest active history or the last frame
+     * with word exits (as found by ngram_search_find_exit()) onwards
+     * is kept. */
+    nf = frame_idx + 1;
+    sf = nf;
+    foreach_active_hmm(ngs, nf, oldest_hmm_history, &sf);
+    for (ef = frame_idx; ef > 0 && ngs->bp_table_idx[ef] == ngs->bpidx; --ef)
+        ;
+    if (ef < sf)
+        sf = ef;
+
+    if ((map = ngram_search_gc_bptable(ngs, ngs->bp_table_idx[sf])) != NULL) {
+        foreach_active_hmm(ngs, nf, remap_hmm_history, map);
+        for (w = 0; w < ps_search_n_words(ngs); ++w) {
+            if (ngs->last_ltrans[w].sf == -1)
+                continue;
+            if (map[ngs->last_ltrans[w].bp] == NO_BP)
+                ngs->last_ltrans[w].sf = -1;
+            else
+                ngs->last_ltrans[w].bp = map[ngs->last_ltrans[w].bp];
+        }
+        ckd_free(map);
+    }
+    /* Amortize the cost over as many new entries as there are live
+     * ones. */
+    ngs->bp_gc_next = ngs->bpidx * 2;
+    if (ngs->bp_gc_next < cmd_ln_int32_r(ps_search_config(ngs), "-latsize"))
+        ngs->bp_gc_next = cmd_ln_int32_r(ps_search_config(ngs), "-latsize");
+}
+
 int
 ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
 {
     int16 const *senscr;
 
     /* Activate our HMMs for the current frame if need be. */
-    if (!ps_search_acmod(ngs)->compallsen)
-        compute_sen_active(ngs, frame_idx);
+    if (!ps_search_acmod(ngs)->compallsen
+        && !ps_search_acmod(ngs)->senscr_shared) {
+        acmod_clear_active(ps_search_acmod(ngs));
+        ngram_fwdtree_sen_active(ngs, frame_idx);
+    }
 
     /* Compute GMM scores for the current frame. */
     if ((senscr = acmod_score(ps_search_acmod(ngs), &frame_idx)) == NULL)
@@ -1483,6 +1865,7 @@ ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
     }
 
     /* Evaluate HMMs */
+    ++ngs->lmla_clock;
     evaluate_channels(ngs, senscr, frame_idx);
     /* Prune HMMs and do phone transitions. */
     prune_channels(ngs, frame_idx);
@@ -1494,6 +1877,9 @@ ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
     deactivate_channels(ngs, frame_idx);
 
     ++ngs->n_frame;
+    /* Collect garbage in the backpointer table if necessary. */
+    if (ngs->bp_gc_next && ngs->bpidx > ngs->bp_gc_next)
+        gc_bptable(ngs, frame_idx);
     /* Return the number of frames processed. */
     return 1;
 }
@@ -1550,7 +1936,10 @@ ngram_fwdtree_finish(ngram_search_t *ngs)
         double n_speech = (double)(cf + 1)
             / cmd_ln_int32_r(ps_search_config(ngs), "-frate");
         E_INFO("%8d words recognized (%d/fr)\n",
-               ngs->bpidx, (ngs->bpidx + (cf >> 1)) / (cf + 1));
+               ngs->st.n_bp, (ngs->st.n_bp + (cf >> 1)) / (cf + 1));
+        if (ngs->st.n_bp_retired)
+            E_INFO("%8d backpointer entries discarded, %d kept\n",
+                   ngs->st.n_bp_retired, ngs->bpidx);
         E_INFO("%8d senones evaluated (%d/fr)\n", ngs->st.n_senone_active_utt,
                (ngs->st.n_senone_active_utt + (cf >> 1)) / (cf + 1));
         E_INFO("%8d channels searched (%d/fr), %d 1st, %d last\n",
@@ -74,6 +74,18 @@ void ngram_fwdtree_start(ngram_search_t *ngs);
  */
 int ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx);
 
+/**
+ * Activate the senones of all HMMs active in a frame, without clearing
+ * the ones already active.
+ */
+void ngram_fwdtree_sen_active(ngram_search_t *ngs, int frame_idx);
+
+/**
+ * Mark the histories of all HMMs active in the next frame with
+ * ngram_search_mark_live().
+ */
+void ngram_fwdtree_mark_live(ngram_search_t *ngs);
+
 /**
  * Finish fwdtree decoding for an utterance.
  */
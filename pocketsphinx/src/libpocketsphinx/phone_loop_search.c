@@ -51,6 +51,7 @@ static void phone_loop_search_free(ps_search_t *search);
 static char const *phone_loop_search_hyp(ps_search_t *search, int32 *out_score, int32 *out_is_final);
 static int32 phone_loop_search_prob(ps_search_t *search);
 static ps_seg_t *phone_loop_search_seg_iter(ps_search_t *search, int32 *out_score);
+static void phone_loop_search_sen_active(ps_search_t *search, int frame_idx);
 
 static ps_searchfuncs_t phone_loop_search_funcs = {
     /* name: */   "phone_loop",
@@ -63,6 +64,8 @@ static ps_searchfuncs_t phone_loop_search_funcs = {
     /* hyp: */      phone_loop_search_hyp,
     /* prob: */     phone_loop_search_prob,
     /* seg_iter: */ phone_loop_search_seg_iter,
+    /* stats: */    NULL,
+    /* sen_active: */ phone_loop_search_sen_active,
 };
 
 static int
@@ -297,19 +300,28 @@ phone_transition(phone_loop_search_t *pls, int frame_idx)
     }
 }
 
+static void
+phone_loop_search_sen_active(ps_search_t *search, int frame_idx)
+{
+    phone_loop_search_t *pls = (phone_loop_search_t *)search;
+    acmod_t *acmod = ps_search_acmod(search);
+    int i;
+
+    /* All CI senones are active all the time. */
+    for (i = 0; i < pls->n_phones; ++i)
+        acmod_activate_hmm(acmod, (hmm_t *)&pls->hmms[i]);
+}
+
 static int
 phone_loop_search_step(ps_search_t *search, int frame_idx)
 {
     phone_loop_search_t *pls = (phone_loop_search_t *)search;
     acmod_t *acmod = ps_search_acmod(search);
     int16 const *senscr;
-    int i;
 
-    /* All CI senones are active all the time. */
-    if (!ps_search_acmod(pls)->compallsen) {
-        acmod_clear_active(ps_search_acmod(pls));
-        for (i = 0; i < pls->n_phones; ++i)
-            acmod_activate_hmm(acmod, (hmm_t *)&pls->hmms[i]);
+    if (!acmod->compallsen && !acmod->senscr_shared) {
+        acmod_clear_active(acmod);
+        phone_loop_search_sen_active(search, frame_idx);
     }
 
     /* Calculate senone scores for current frame. */
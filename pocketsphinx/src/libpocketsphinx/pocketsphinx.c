@@ -38,6 +38,7 @@
 /* System headers. */
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -63,6 +64,7 @@
 #include "ngram_search_fwdtree.h"
 #include "ngram_search_fwdflat.h"
 #include "allphone_search.h"
+#include "ps_pipeline.h"
 
 static const arg_t ps_args_def[] = {
     POCKETSPHINX_OPTIONS,
@@ -95,44 +97,127 @@ hmmdir_exists(const char *path)
 #endif
 
 static void
-ps_add_file(ps_decoder_t *ps, const char *arg,
+ps_add_file(cmd_ln_t *config, const char *arg,
             const char *hmmdir, const char *file)
 {
     char *tmp = string_join(hmmdir, "/", file, NULL);
 
-    if (cmd_ln_str_r(ps->config, arg) == NULL && file_exists(tmp))
-        cmd_ln_set_str_r(ps->config, arg, tmp);
+    if (cmd_ln_str_r(config, arg) == NULL && file_exists(tmp))
+        cmd_ln_set_str_r(config, arg, tmp);
     ckd_free(tmp);
 }
 
 static void
-ps_init_defaults(ps_decoder_t *ps)
+ps_init_defaults(cmd_ln_t *config)
 {
     /* Disable memory mapping on Blackfin (FIXME: should be uClinux in general). */
 #ifdef __ADSPBLACKFIN__
     E_INFO("Will not use mmap() on uClinux/Blackfin.");
-    cmd_ln_set_boolean_r(ps->config, "-mmap", FALSE);
+    cmd_ln_set_boolean_r(config, "-mmap", FALSE);
 #endif
 
     char const *hmmdir;
     /* Get acoustic model filenames and add them to the command-line */
-    if ((hmmdir = cmd_ln_str_r(ps->config, "-hmm")) != NULL) {
-        ps_add_file(ps, "-mdef", hmmdir, "mdef");
-        ps_add_file(ps, "-mean", hmmdir, "means");
-        ps_add_file(ps, "-var", hmmdir, "variances");
-        ps_add_file(ps, "-tmat", hmmdir, "transition_matrices");
-        ps_add_file(ps, "-mixw", hmmdir, "mixture_weights");
-        ps_add_file(ps, "-sendump", hmmdir, "sendump");
-        ps_add_file(ps, "-fdict", hmmdir, "noisedict");
-        ps_add_file(ps, "-lda", hmmdir, "feature_transform");
-        ps_add_file(ps, "-featparams", hmmdir, "feat.params");
-        ps_add_file(ps, "-senmgau", hmmdir, "senmgau");
+    if ((hmmdir = cmd_ln_str_r(config, "-hmm")) != NULL) {
+        ps_add_file(config, "-mdef", hmmdir, "mdef");
+        ps_add_file(config, "-mean", hmmdir, "means");
+        ps_add_file(config, "-var", hmmdir, "variances");
+        ps_add_file(config, "-tmat", hmmdir, "transition_matrices");
+        ps_add_file(config, "-mixw", hmmdir, "mixture_weights");
+        ps_add_file(config, "-sendump", hmmdir, "sendump");
+        ps_add_file(config, "-fdict", hmmdir, "noisedict");
+        ps_add_file(config, "-lda", hmmdir, "feature_transform");
+        ps_add_file(config, "-featparams", hmmdir, "feat.params");
+        ps_add_file(config, "-senmgau", hmmdir, "senmgau");
     }
 }
 
+static void
+ps_fsg_cache_flush(ps_decoder_t *ps)
+{
+    int i;
+
+    for (i = 0; i < ps->n_fsg_cache; ++i)
+        ps_search_free(ps->fsg_cache[i]);
+    ckd_free(ps->fsg_cache);
+    ps->fsg_cache = NULL;
+    ps->n_fsg_cache = 0;
+}
+
+/* Take a compiled FSG search for the given grammar out of the cache. */
+static ps_search_t *
+ps_fsg_cache_get(ps_decoder_t *ps, fsg_model_t *fsg, uint32 const *hash)
+{
+    int i;
+
+    for (i = ps->n_fsg_cache - 1; i >= 0; --i) {
+        fsg_search_t *fsgs = (fsg_search_t *) ps->fsg_cache[i];
+        if (fsg_search_same_fsg(fsgs, fsg, hash)) {
+            --ps->n_fsg_cache;
+            memmove(ps->fsg_cache + i, ps->fsg_cache + i + 1,
+                    (ps->n_fsg_cache - i) * sizeof(*ps->fsg_cache));
+            E_INFO("Reusing compiled grammar %s\n",
+                   fsg_model_name(fsgs->fsg));
+            return ps_search_base(fsgs);
+        }
+    }
+    return NULL;
+}
+
+/* Find a search in the list of parallel searches. */
+static int
+ps_parallel_index(ps_decoder_t *ps, ps_search_t *search)
+{
+    int i;
+
+    for (i = 0; i < ps->n_parallel; ++i)
+        if (ps->parallel[i] == search)
+            return i;
+    return -1;
+}
+
+/* Stop running a search in parallel, if it was. */
+static void
+ps_parallel_remove(ps_decoder_t *ps, ps_search_t *search)
+{
+    int i;
+
+    if ((i = ps_parallel_index(ps, search)) < 0)
+        return;
+    --ps->n_parallel;
+    memmove(ps->parallel + i, ps->parallel + i + 1,
+            (ps->n_parallel - i) * sizeof(*ps->parallel));
+}
+
+/* Dispose of a search that is no longer registered under any name. */
+static void
+ps_release_search(ps_decoder_t *ps, ps_search_t *search)
+{
+    int max_cache = cmd_ln_int32_r(ps->config, "-fsgcache");
+
+    if (search == NULL)
+        return;
+    ps_parallel_remove(ps, search);
+    if (max_cache <= 0 || strcmp(PS_SEARCH_FSG, ps_search_name(search))) {
+        ps_search_free(search);
+        return;
+    }
+    if (ps->fsg_cache == NULL)
+        ps->fsg_cache = ckd_calloc(max_cache, sizeof(*ps->fsg_cache));
+    if (ps->n_fsg_cache == max_cache) {
+        /* Drop the oldest one. */
+        ps_search_free(ps->fsg_cache[0]);
+        --ps->n_fsg_cache;
+        memmove(ps->fsg_cache, ps->fsg_cache + 1,
+                ps->n_fsg_cache * sizeof(*ps->fsg_cache));
+    }
+    ps->fsg_cache[ps->n_fsg_cache++] = search;
+}
+
 static void
 ps_free_searches(ps_decoder_t *ps)
 {
+    ps_fsg_cache_flush(ps);
     if (ps->searches) {
         /* Release keys manually as we used ckd_salloc to add them, release every search too. */
         hash_iter_t *search_it;
@@ -148,6 +233,9 @@ ps_free_searches(ps_decoder_t *ps)
 
     ps->searches = NULL;
     ps->search = NULL;
+    ckd_free(ps->parallel);
+    ps->parallel = NULL;
+    ps->n_parallel = 0;
 }
 
 static ps_search_t *
@@ -218,20 +306,29 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
 {
     const char *path;
     const char *keyphrase;
-    int32 lw;
+    float32 lw;
 
     if (config && config != ps->config) {
         cmd_ln_free_r(ps->config);
         ps->config = cmd_ln_retain(config);
+        /* A new configuration means new model parameters. */
+        ps_model_free(ps->model);
+        ps->model = NULL;
     }
+    config = ps->config;
 
     err_set_debug_level(cmd_ln_int32_r(ps->config, "-debug"));
     ps->mfclogdir = cmd_ln_str_r(ps->config, "-mfclogdir");
     ps->rawlogdir = cmd_ln_str_r(ps->config, "-rawlogdir");
     ps->senlogdir = cmd_ln_str_r(ps->config, "-senlogdir");
 
-    /* Fill in some default arguments. */
-    ps_init_defaults(ps);
+    /* Fill in some default arguments (the shared model already has). */
+    if (ps->model == NULL)
+        ps_init_defaults(ps->config);
+
+    /* Free the pipeline (it refers to the acmod) */
+    ps_pipeline_free(ps->pipeline);
+    ps->pipeline = NULL;
 
     /* Free old searches (do this before other reinit) */
     ps_free_searches(ps);
@@ -249,7 +346,8 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
     dict2pid_free(ps->d2p);
     ps->d2p = NULL;
 
-    /* Logmath computation (used in acmod and search) */
+    /* Logmath computation (used in acmod and search).  This is not
+     * shared with the model as lattices retain it. */
     if (ps->lmath == NULL
         || (logmath_get_base(ps->lmath) !=
             (float64)cmd_ln_float32_r(ps->config, "-logbase"))) {
@@ -262,7 +360,15 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
 
     /* Acoustic model (this is basically everything that
      * uttproc.c, senscr.c, and others used to do) */
-    if ((ps->acmod = acmod_init(ps->config, ps->lmath, NULL, NULL)) == NULL)
+    if (ps->model)
+        ps->acmod = acmod_copy(ps->model->acmod, ps->lmath);
+    else
+        ps->acmod = acmod_init(ps->config, ps->lmath, NULL, NULL);
+    if (ps->acmod == NULL)
+        return -1;
+
+    if (cmd_ln_boolean_r(ps->config, "-pipeline")
+        && (ps->pipeline = ps_pipeline_init(ps)) == NULL)
         return -1;
 
     if ((ps->pl_window = cmd_ln_int32_r(ps->config, "-pl_window"))) {
@@ -278,10 +384,18 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
 
     /* Dictionary and triphone mappings (depends on acmod). */
     /* FIXME: pass config, change arguments, implement LTS, etc. */
-    if ((ps->dict = dict_init(ps->config, ps->acmod->mdef)) == NULL)
-        return -1;
-    if ((ps->d2p = dict2pid_build(ps->acmod->mdef, ps->dict)) == NULL)
-        return -1;
+    if (ps->model) {
+        /* Lattices retain the dictionary, so give this decoder its
+         * own reference count. */
+        ps->dict = dict_copy(ps->model->dict);
+        ps->d2p = dict2pid_retain(ps->model->d2p);
+    }
+    else {
+        if ((ps->dict = dict_init(ps->config, ps->acmod->mdef)) == NULL)
+            return -1;
+        if ((ps->d2p = dict2pid_build(ps->acmod->mdef, ps->dict)) == NULL)
+            return -1;
+    }
 
     lw = cmd_ln_float32_r(config, "-lw");
 
@@ -324,7 +438,12 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
                 return -1;
     }
 
-    if ((path = cmd_ln_str_r(ps->config, "-lm")) && 
+    if (ps->model && ps->model->lm) {
+        if (ps_set_lm(ps, PS_DEFAULT_SEARCH, ps->model->lm)
+            || ps_set_search(ps, PS_DEFAULT_SEARCH))
+            return -1;
+    }
+    else if ((path = cmd_ln_str_r(ps->config, "-lm")) && 
         !cmd_ln_boolean_r(ps->config, "-allphone")) {
         if (ps_set_lm_file(ps, PS_DEFAULT_SEARCH, path)
             || ps_set_search(ps, PS_DEFAULT_SEARCH))
@@ -366,6 +485,9 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
     /* Initialize performance timer. */
     ps->perf.name = "decode";
     ptmr_init(&ps->perf);
+    ptmr_init(&ps->search_perf);
+    ptmr_init(&ps->lattice_perf);
+    memset(&ps->all_stats, 0, sizeof(ps->all_stats));
 
     return 0;
 }
@@ -384,6 +506,85 @@ ps_init(cmd_ln_t *config)
     return ps;
 }
 
+ps_model_t *
+ps_model_init(cmd_ln_t *config)
+{
+    ps_model_t *model;
+    char const *path;
+
+    model = ckd_calloc(1, sizeof(*model));
+    model->refcount = 1;
+    model->config = cmd_ln_retain(config);
+    ps_init_defaults(model->config);
+
+    model->lmath = logmath_init
+        ((float64)cmd_ln_float32_r(config, "-logbase"), 0,
+         cmd_ln_boolean_r(config, "-bestpath"));
+    if ((model->acmod = acmod_init(config, model->lmath, NULL, NULL)) == NULL)
+        goto error_out;
+    if ((model->dict = dict_init(config, model->acmod->mdef)) == NULL)
+        goto error_out;
+    if ((model->d2p = dict2pid_build(model->acmod->mdef, model->dict)) == NULL)
+        goto error_out;
+    if ((path = cmd_ln_str_r(config, "-lm"))
+        && !cmd_ln_boolean_r(config, "-allphone")) {
+        model->lm = ngram_model_read(config, path, NGRAM_AUTO, model->lmath);
+        if (model->lm == NULL)
+            goto error_out;
+    }
+    return model;
+
+error_out:
+    ps_model_free(model);
+    return NULL;
+}
+
+ps_model_t *
+ps_model_retain(ps_model_t *model)
+{
+    ++model->refcount;
+    return model;
+}
+
+int
+ps_model_free(ps_model_t *model)
+{
+    if (model == NULL)
+        return 0;
+    if (--model->refcount > 0)
+        return model->refcount;
+    ngram_model_free(model->lm);
+    dict2pid_free(model->d2p);
+    dict_free(model->dict);
+    acmod_free(model->acmod);
+    logmath_free(model->lmath);
+    cmd_ln_free_r(model->config);
+    ckd_free(model);
+    return 0;
+}
+
+ps_decoder_t *
+ps_init_model(ps_model_t *model)
+{
+    ps_decoder_t *ps;
+
+    ps = ckd_calloc(1, sizeof(*ps));
+    ps->refcount = 1;
+    ps->model = ps_model_retain(model);
+    ps->config = cmd_ln_retain(model->config);
+    if (ps_reinit(ps, NULL) < 0) {
+        ps_free(ps);
+        return NULL;
+    }
+    return ps;
+}
+
+ps_model_t *
+ps_get_model(ps_decoder_t *ps)
+{
+    return ps->model;
+}
+
 arg_t const *
 ps_args(void)
 {
@@ -404,11 +605,13 @@ ps_free(ps_decoder_t *ps)
         return 0;
     if (--ps->refcount > 0)
         return ps->refcount;
+    ps_pipeline_free(ps->pipeline);
     ps_free_searches(ps);
     dict_free(ps->dict);
     dict2pid_free(ps->d2p);
     acmod_free(ps->acmod);
     logmath_free(ps->lmath);
+    ps_model_free(ps->model);
     cmd_ln_free_r(ps->config);
     ckd_free(ps->uttid);
     ckd_free(ps);
@@ -483,7 +686,43 @@ ps_unset_search(ps_decoder_t *ps, const char *name)
         return -1;
     if (ps->search == search)
         ps->search = NULL;
-    ps_search_free(search);
+    ps_release_search(ps, search);
+    return 0;
+}
+
+int
+ps_add_parallel_search(ps_decoder_t *ps, const char *name)
+{
+    ps_search_t *search = ps_find_search(ps, name);
+
+    if (search == NULL)
+        return -1;
+    if (ps->acmod->state == ACMOD_STARTED
+        || ps->acmod->state == ACMOD_PROCESSING) {
+        E_ERROR("Cannot add a parallel search during an utterance\n");
+        return -1;
+    }
+    if (ps_parallel_index(ps, search) >= 0)
+        return 0;
+    ps->parallel = ckd_realloc(ps->parallel,
+                               (ps->n_parallel + 1) * sizeof(*ps->parallel));
+    ps->parallel[ps->n_parallel++] = search;
+    return 0;
+}
+
+int
+ps_remove_parallel_search(ps_decoder_t *ps, const char *name)
+{
+    ps_search_t *search = ps_find_search(ps, name);
+
+    if (search == NULL || ps_parallel_index(ps, search) < 0)
+        return -1;
+    if (ps->acmod->state == ACMOD_STARTED
+        || ps->acmod->state == ACMOD_PROCESSING) {
+        E_ERROR("Cannot remove a parallel search during an utterance\n");
+        return -1;
+    }
+    ps_parallel_remove(ps, search);
     return 0;
 }
 
@@ -548,8 +787,16 @@ set_search_internal(ps_decoder_t *ps, const char *name, ps_search_t *search)
 
     search->pls = ps->phone_loop;
     old_search = (ps_search_t *) hash_table_replace(ps->searches, ckd_salloc(name), search);
-    if (old_search != search)
-        ps_search_free(old_search);
+    if (old_search != search) {
+        int i;
+
+        /* Keep decoding with the same name if it was active. */
+        if (old_search && ps->search == old_search)
+            ps->search = search;
+        if (old_search && (i = ps_parallel_index(ps, old_search)) >= 0)
+            ps->parallel[i] = search;
+        ps_release_search(ps, old_search);
+    }
 
     return 0;
 }
@@ -620,7 +867,17 @@ int
 ps_set_fsg(ps_decoder_t *ps, const char *name, fsg_model_t *fsg)
 {
     ps_search_t *search;
-    search = fsg_search_init(fsg, ps->config, ps->acmod, ps->dict, ps->d2p);
+    uint32 hash[2];
+
+    /* Compiling a large grammar takes a while, so do not do it again
+     * if it is already there, or was replaced recently. */
+    fsg_search_hash(fsg, hash);
+    search = ps_find_search(ps, name);
+    if (search && 0 == strcmp(PS_SEARCH_FSG, ps_search_name(search))
+        && fsg_search_same_fsg((fsg_search_t *) search, fsg, hash))
+        return 0;
+    if ((search = ps_fsg_cache_get(ps, fsg, hash)) == NULL)
+        search = fsg_search_init(fsg, ps->config, ps->acmod, ps->dict, ps->d2p);
     return set_search_internal(ps, name, search);
 }
 
@@ -706,6 +963,11 @@ ps_load_dict(ps_decoder_t *ps, char const *dictfile,
     dict_t *dict;
     hash_iter_t *search_it;
 
+    if (ps->model) {
+        E_ERROR("Cannot load a dictionary into a decoder with a shared model\n");
+        return -1;
+    }
+
     /* Create a new scratch config to load this dict (so existing one
      * won't be affected if it fails) */
     newconfig = cmd_ln_init(NULL, ps_args(), TRUE, NULL);
@@ -741,6 +1003,8 @@ ps_load_dict(ps_decoder_t *ps, char const *dictfile,
     dict2pid_free(ps->d2p);
     ps->d2p = d2p;
 
+    /* Cached grammars were compiled with the old dictionary. */
+    ps_fsg_cache_flush(ps);
     /* And tell all searches to reconfigure themselves. */
     for (search_it = hash_table_iter(ps->searches); search_it;
        search_it = hash_table_iter_next(search_it)) {
@@ -803,6 +1067,7 @@ ps_add_word(ps_decoder_t *ps,
 
     /* Now we also have to add it to dict2pid. */
     dict2pid_add_word(ps->d2p, wid);
+    ps_fsg_cache_flush(ps);
 
     /* TODO: we definitely need to refactor this */
     for (search_it = hash_table_iter(ps->searches); search_it;
@@ -901,10 +1166,22 @@ ps_start_stream(ps_decoder_t *ps)
     return 0;
 }
 
+/* Remove any residual word lattice and hypothesis. */
+static void
+ps_search_clear_result(ps_search_t *search)
+{
+    ps_lattice_free(search->dag);
+    search->dag = NULL;
+    search->last_link = NULL;
+    search->post = 0;
+    ckd_free(search->hyp_str);
+    search->hyp_str = NULL;
+}
+
 int
 ps_start_utt(ps_decoder_t *ps, char const *uttid)
 {
-    int rv;
+    int rv, i;
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
                 "specify a language model or grammar?\n");
@@ -913,6 +1190,8 @@ ps_start_utt(ps_decoder_t *ps, char const *uttid)
 
     ptmr_reset(&ps->perf);
     ptmr_start(&ps->perf);
+    ptmr_reset(&ps->search_perf);
+    ptmr_reset(&ps->lattice_perf);
 
     if (uttid) {
         ckd_free(ps->uttid);
@@ -925,13 +1204,7 @@ ps_start_utt(ps_decoder_t *ps, char const *uttid)
         ps->uttid = ckd_salloc(nuttid);
         ++ps->uttno;
     }
-    /* Remove any residual word lattice and hypothesis. */
-    ps_lattice_free(ps->search->dag);
-    ps->search->dag = NULL;
-    ps->search->last_link = NULL;
-    ps->search->post = 0;
-    ckd_free(ps->search->hyp_str);
-    ps->search->hyp_str = NULL;
+    ps_search_clear_result(ps->search);
 
     if ((rv = acmod_start_utt(ps->acmod)) < 0)
         return rv;
@@ -981,31 +1254,238 @@ ps_start_utt(ps_decoder_t *ps, char const *uttid)
     if (ps->phone_loop)
         ps_search_start(ps->phone_loop);
 
+    /* Start searches running in parallel. */
+    for (i = 0; i < ps->n_parallel; ++i) {
+        if (ps->parallel[i] == ps->search)
+            continue;
+        ps_search_clear_result(ps->parallel[i]);
+        if ((rv = ps_search_start(ps->parallel[i])) < 0)
+            return rv;
+    }
+
     return ps_search_start(ps->search);
 }
 
+/* Can the senones for all running searches be activated together? */
+static int
+ps_search_shared(ps_decoder_t *ps)
+{
+    int i;
+
+    if (ps->acmod->compallsen || ps->acmod->insenfh
+        || !ps->search->vt->sen_active)
+        return FALSE;
+    for (i = 0; i < ps->n_parallel; ++i)
+        if (!ps->parallel[i]->vt->sen_active)
+            return FALSE;
+    return TRUE;
+}
+
+/* Activate the senones needed by all running searches for a frame. */
+static void
+ps_search_activate(ps_decoder_t *ps, int frame_idx)
+{
+    int i;
+
+    acmod_clear_active(ps->acmod);
+    ps_search_sen_active(ps->search, frame_idx);
+    for (i = 0; i < ps->n_parallel; ++i)
+        if (ps->parallel[i] != ps->search)
+            ps_search_sen_active(ps->parallel[i], frame_idx);
+}
+
+/* Step all running searches, using shared scores if they were
+ * computed. */
+static int
+ps_search_step_each(ps_decoder_t *ps, int frame_idx)
+{
+    int i, k;
+
+    k = ps_search_step(ps->search, frame_idx);
+    for (i = 0; k >= 0 && i < ps->n_parallel; ++i)
+        if (ps->parallel[i] != ps->search)
+            k = ps_search_step(ps->parallel[i], frame_idx);
+    ps->acmod->senscr_shared = FALSE;
+    return k;
+}
+
+/*
+ * Step the current search and any parallel searches through one
+ * frame.  The senones they need are scored all at once, unless one of
+ * them cannot say which ones it needs.
+ */
 static int
+ps_search_step_all(ps_decoder_t *ps, int frame_idx)
+{
+    acmod_t *acmod = ps->acmod;
+
+    if (ps->n_parallel == 0)
+        return ps_search_step(ps->search, frame_idx);
+
+    if (ps_search_shared(ps)) {
+        ps_search_activate(ps, frame_idx);
+        if (acmod_score(acmod, &frame_idx) != NULL)
+            acmod->senscr_shared = TRUE;
+    }
+    return ps_search_step_each(ps, frame_idx);
+}
+
+/* Search the next available frame. */
+static int
+ps_search_frame(ps_decoder_t *ps)
+{
+    int k;
+
+    if (ps->phone_loop)
+        if ((k = ps_search_step(ps->phone_loop, ps->acmod->output_frame)) < 0)
+            return k;
+    if (ps->acmod->output_frame >= ps->pl_window)
+        if ((k = ps_search_step_all(ps,
+                                    ps->acmod->output_frame - ps->pl_window)) < 0)
+            return k;
+    acmod_advance(ps->acmod);
+    ++ps->n_frame;
+    return 0;
+}
+
+int
 ps_search_forward(ps_decoder_t *ps)
 {
     int nfr;
 
     nfr = 0;
+    ptmr_start(&ps->search_perf);
     while (ps->acmod->n_feat_frame > 0) {
         int k;
-        if (ps->phone_loop)
-            if ((k = ps_search_step(ps->phone_loop, ps->acmod->output_frame)) < 0)
-                return k;
-        if (ps->acmod->output_frame >= ps->pl_window)
-            if ((k = ps_search_step(ps->search,
-                                    ps->acmod->output_frame - ps->pl_window)) < 0)
-                return k;
-        acmod_advance(ps->acmod);
-        ++ps->n_frame;
+        if ((k = ps_search_frame(ps)) < 0) {
+            ptmr_stop(&ps->search_perf);
+            return k;
+        }
         ++nfr;
     }
+    ptmr_stop(&ps->search_perf);
     return nfr;
 }
 
+/*
+ * Score one frame in each of several decoders together, then step
+ * either their phone loops or their main searches on it.
+ */
+static int
+ps_search_step_batch(ps_decoder_t **batch, int n, int lookahead,
+                     acmod_batch_t *ab, acmod_t **acmods, int *frame_idx)
+{
+    int i, m, rv;
+
+    m = 0;
+    for (i = 0; i < n; ++i) {
+        ps_decoder_t *ps = batch[i];
+        acmod_t *acmod = ps->acmod;
+
+        if (lookahead) {
+            if (ps->phone_loop == NULL)
+                continue;
+            frame_idx[m] = acmod->output_frame;
+            if (!acmod->compallsen) {
+                acmod_clear_active(acmod);
+                ps_search_sen_active(ps->phone_loop, frame_idx[m]);
+            }
+        }
+        else {
+            if (acmod->output_frame < ps->pl_window)
+                continue;
+            frame_idx[m] = acmod->output_frame - ps->pl_window;
+            if (!acmod->compallsen)
+                ps_search_activate(ps, frame_idx[m]);
+        }
+        batch[m] = ps;
+        acmods[m] = acmod;
+        ++m;
+    }
+    if (m == 0)
+        return 0;
+
+    if ((rv = acmod_score_batch(ab, acmods, m, frame_idx)) < 0)
+        return rv;
+    for (i = 0; rv >= 0 && i < m; ++i) {
+        ps_decoder_t *ps = batch[i];
+
+        ps->acmod->senscr_shared = TRUE;
+        if (lookahead) {
+            rv = ps_search_step(ps->phone_loop, frame_idx[i]);
+            ps->acmod->senscr_shared = FALSE;
+        }
+        else
+            rv = ps_search_step_each(ps, frame_idx[i]);
+    }
+    return rv;
+}
+
+int
+ps_search_batch(ps_decoder_t **decoders, int n_decoders)
+{
+    ps_decoder_t **batch, **step;
+    acmod_batch_t *ab;
+    acmod_t **acmods;
+    int *frame_idx;
+    int i, n, nfr, more, rv;
+
+    ab = acmod_batch_init(n_decoders);
+    batch = ckd_calloc(n_decoders, sizeof(*batch));
+    step = ckd_calloc(n_decoders, sizeof(*step));
+    acmods = ckd_calloc(n_decoders, sizeof(*acmods));
+    frame_idx = ckd_calloc(n_decoders, sizeof(*frame_idx));
+    nfr = rv = 0;
+    do {
+        more = FALSE;
+        n = 0;
+        for (i = 0; rv >= 0 && i < n_decoders; ++i) {
+            ps_decoder_t *ps = decoders[i];
+            acmod_t *acmod = ps->acmod;
+
+            if (acmod->n_feat_frame == 0)
+                continue;
+            more = TRUE;
+            /* Senone files and searches which need scores for
+             * senones they don't activate are searched on their own. */
+            if (acmod->insenfh || ps_pipeline_running(ps->pipeline)
+                || !(acmod->compallsen || ps_search_shared(ps))) {
+                ptmr_start(&ps->search_perf);
+                rv = ps_search_frame(ps);
+                ptmr_stop(&ps->search_perf);
+                ++nfr;
+                continue;
+            }
+            batch[n++] = ps;
+        }
+        if (rv < 0 || n == 0)
+            continue;
+
+        /* The phone loop looks ahead of the main search, so it scores
+         * a different frame. */
+        memcpy(step, batch, n * sizeof(*step));
+        if ((rv = ps_search_step_batch(step, n, TRUE, ab,
+                                       acmods, frame_idx)) < 0)
+            break;
+        memcpy(step, batch, n * sizeof(*step));
+        if ((rv = ps_search_step_batch(step, n, FALSE, ab,
+                                       acmods, frame_idx)) < 0)
+            break;
+        for (i = 0; i < n; ++i) {
+            acmod_advance(batch[i]->acmod);
+            ++batch[i]->n_frame;
+            ++nfr;
+        }
+    } while (more && rv >= 0);
+
+    acmod_batch_free(ab);
+    ckd_free(batch);
+    ckd_free(step);
+    ckd_free(acmods);
+    ckd_free(frame_idx);
+    return rv < 0 ? rv : nfr;
+}
+
 int
 ps_decode_senscr(ps_decoder_t *ps, FILE *senfh,
                  char const *uttid)
@@ -1037,11 +1517,28 @@ ps_process_raw(ps_decoder_t *ps,
 {
     int n_searchfr = 0;
 
+    /* The pipeline threads own the acoustic model while they run. */
+    if (ps_pipeline_running(ps->pipeline)) {
+        if (no_search || full_utt) {
+            E_ERROR("Cannot mix pipelined and full-utterance or no-search "
+                    "processing in one utterance\n");
+            return -1;
+        }
+        return ps_pipeline_process_raw(ps->pipeline, data, n_samples);
+    }
+
     if (ps->acmod->state == ACMOD_IDLE) {
 	E_ERROR("Failed to process data, utterance is not started. Use start_utt to start it\n");
 	return 0;
     }
 
+    /* Live audio goes to the pipeline threads if there are any. */
+    if (ps->pipeline && !no_search && !full_utt) {
+        if (ps_pipeline_start_utt(ps->pipeline) < 0)
+            return -1;
+        return ps_pipeline_process_raw(ps->pipeline, data, n_samples);
+    }
+
     if (no_search)
         acmod_set_grow(ps->acmod, TRUE);
 
@@ -1073,6 +1570,11 @@ ps_process_cep(ps_decoder_t *ps,
 {
     int n_searchfr = 0;
 
+    if (ps_pipeline_running(ps->pipeline)) {
+        E_ERROR("Cannot mix audio and cepstra in one pipelined utterance\n");
+        return -1;
+    }
+
     if (no_search)
         acmod_set_grow(ps->acmod, TRUE);
 
@@ -1095,11 +1597,52 @@ ps_process_cep(ps_decoder_t *ps,
     return n_searchfr;
 }
 
+/**
+ * Add the counters for the current utterance, except for the time
+ * spent producing results, to stats.
+ */
+static void
+ps_add_utt_stats(ps_decoder_t *ps, ps_stats_t *stats)
+{
+    acmod_t *acmod = ps->acmod;
+    ps_stats_t st;
+    double t_search;
+
+    memset(&st, 0, sizeof(st));
+    if (ps->search)
+        ps_search_stats(ps->search, &st);
+    /* Senone scoring happens inside the search. */
+    t_search = ps->search_perf.t_elapsed - acmod->mgau_perf.t_elapsed;
+    stats->n_frame += acmod->output_frame;
+    stats->n_senone_eval += acmod->n_senone_eval;
+    stats->n_codebook_eval += acmod->mgau->n_codebook_eval;
+    stats->n_root_hmm_eval += st.n_root_hmm_eval;
+    stats->n_nonroot_hmm_eval += st.n_nonroot_hmm_eval;
+    stats->n_word_hmm_eval += st.n_word_hmm_eval;
+    stats->n_bp += st.n_bp;
+    stats->n_bp_retired += st.n_bp_retired;
+    /* The table is emptied for each utterance. */
+    if (st.n_bp_peak > stats->n_bp_peak)
+        stats->n_bp_peak = st.n_bp_peak;
+    stats->n_lm_lookup += st.n_lm_lookup;
+    stats->n_lm_cache_hit += st.n_lm_cache_hit;
+    stats->t_fe += acmod->fe_perf.t_elapsed
+        + ps_pipeline_fe_time(ps->pipeline);
+    stats->t_feat += acmod->feat_perf.t_elapsed;
+    stats->t_mgau += acmod->mgau_perf.t_elapsed;
+    stats->t_search += t_search > 0 ? t_search : 0;
+}
+
 int
 ps_end_utt(ps_decoder_t *ps)
 {
     int rv, i;
 
+    /* Finish with any audio still in the pipeline. */
+    if ((rv = ps_pipeline_end_utt(ps->pipeline)) < 0) {
+        ptmr_stop(&ps->perf);
+        return rv;
+    }
     acmod_end_utt(ps->acmod);
 
     /* Search any remaining frames. */
@@ -1115,15 +1658,23 @@ ps_end_utt(ps_decoder_t *ps)
         }
     }
     /* Search any frames remaining in the lookahead window. */
+    ptmr_start(&ps->search_perf);
     for (i = ps->acmod->output_frame - ps->pl_window;
          i < ps->acmod->output_frame; ++i)
-        ps_search_step(ps->search, i);
+        ps_search_step_all(ps, i);
     /* Finish main search. */
-    if ((rv = ps_search_finish(ps->search)) < 0) {
+    rv = ps_search_finish(ps->search);
+    /* And the ones running in parallel. */
+    for (i = 0; rv >= 0 && i < ps->n_parallel; ++i)
+        if (ps->parallel[i] != ps->search)
+            rv = ps_search_finish(ps->parallel[i]);
+    ptmr_stop(&ps->search_perf);
+    if (rv < 0) {
         ptmr_stop(&ps->perf);
         return rv;
     }
     ptmr_stop(&ps->perf);
+    ps_add_utt_stats(ps, &ps->all_stats);
 
     /* Log a backtrace if requested. */
     if (cmd_ln_boolean_r(ps->config, "-backtrace")) {
@@ -1161,7 +1712,11 @@ ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score, char const **out_uttid)
     char const *hyp;
 
     ptmr_start(&ps->perf);
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
     hyp = ps_search_hyp(ps->search, out_best_score, NULL);
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
     if (out_uttid)
         *out_uttid = ps->uttid;
     ptmr_stop(&ps->perf);
@@ -1174,11 +1729,58 @@ ps_get_hyp_final(ps_decoder_t *ps, int32 *out_is_final)
     char const *hyp;
 
     ptmr_start(&ps->perf);
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
     hyp = ps_search_hyp(ps->search, NULL, out_is_final);
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
     ptmr_stop(&ps->perf);
     return hyp;
 }
 
+char const *
+ps_get_hyp_stable(ps_decoder_t *ps, int32 *out_best_score,
+                  int32 *out_n_stable)
+{
+    char const *hyp;
+
+    ptmr_start(&ps->perf);
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
+    ps->search->hyp_n_stable = 0;
+    hyp = ps_search_hyp(ps->search, out_best_score, NULL);
+    if (out_n_stable) {
+        if (hyp == NULL)
+            *out_n_stable = 0;
+        else if (ps->acmod->state == ACMOD_ENDED)
+            *out_n_stable = strlen(hyp);
+        else
+            *out_n_stable = ps->search->hyp_n_stable;
+    }
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
+    ptmr_stop(&ps->perf);
+    return hyp;
+}
+
+char const *
+ps_get_search_hyp(ps_decoder_t *ps, const char *name, int32 *out_best_score)
+{
+    ps_search_t *search = ps_find_search(ps, name);
+    char const *hyp;
+
+    if (search == NULL
+        || (search != ps->search && ps_parallel_index(ps, search) < 0))
+        return NULL;
+    ptmr_start(&ps->perf);
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
+    hyp = ps_search_hyp(search, out_best_score, NULL);
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
+    ptmr_stop(&ps->perf);
+    return hyp;
+}
 
 int32
 ps_get_prob(ps_decoder_t *ps, char const **out_uttid)
@@ -1186,20 +1788,107 @@ ps_get_prob(ps_decoder_t *ps, char const **out_uttid)
     int32 prob;
 
     ptmr_start(&ps->perf);
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
     prob = ps_search_prob(ps->search);
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
     if (out_uttid)
         *out_uttid = ps->uttid;
     ptmr_stop(&ps->perf);
     return prob;
 }
 
+/*
+ * Word segmentation copied out of the search while the search thread
+ * was locked out, so that it can be walked while that thread goes on
+ * growing and garbage collecting the backpointer table.
+ */
+typedef struct seg_snapshot_s {
+    ps_seg_t base;
+    ps_seg_t *segs;
+    int n_segs;
+    int cur;
+} seg_snapshot_t;
+
+static void
+seg_snapshot_fill(seg_snapshot_t *snap)
+{
+    ps_segfuncs_t *vt = snap->base.vt;
+
+    snap->base = snap->segs[snap->cur];
+    snap->base.vt = vt;
+}
+
+static ps_seg_t *
+seg_snapshot_next(ps_seg_t *seg)
+{
+    seg_snapshot_t *snap = (seg_snapshot_t *)seg;
+
+    if (++snap->cur == snap->n_segs) {
+        ps_search_seg_free(seg);
+        return NULL;
+    }
+    seg_snapshot_fill(snap);
+    return seg;
+}
+
+static void
+seg_snapshot_free(ps_seg_t *seg)
+{
+    seg_snapshot_t *snap = (seg_snapshot_t *)seg;
+
+    ckd_free(snap->segs);
+    ckd_free(snap);
+}
+
+static ps_segfuncs_t seg_snapshot_funcs = {
+    /* seg_next = */ seg_snapshot_next,
+    /* seg_free = */ seg_snapshot_free
+};
+
+/* Consume a search's iterator, returning a snapshot of it. */
+static ps_seg_t *
+seg_snapshot(ps_seg_t *seg)
+{
+    seg_snapshot_t *snap;
+    int n_alloc;
+
+    snap = ckd_calloc(1, sizeof(*snap));
+    n_alloc = 16;
+    snap->segs = ckd_calloc(n_alloc, sizeof(*snap->segs));
+    for (; seg; seg = ps_search_seg_next(seg)) {
+        if (snap->n_segs == n_alloc) {
+            n_alloc *= 2;
+            snap->segs = ckd_realloc(snap->segs,
+                                     n_alloc * sizeof(*snap->segs));
+        }
+        snap->segs[snap->n_segs++] = *seg;
+    }
+    if (snap->n_segs == 0) {
+        ckd_free(snap->segs);
+        ckd_free(snap);
+        return NULL;
+    }
+    snap->base.vt = &seg_snapshot_funcs;
+    seg_snapshot_fill(snap);
+    return &snap->base;
+}
+
 ps_seg_t *
 ps_seg_iter(ps_decoder_t *ps, int32 *out_best_score)
 {
     ps_seg_t *itor;
 
     ptmr_start(&ps->perf);
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
     itor = ps_search_seg_iter(ps->search, out_best_score);
+    /* The search's own iterators read its data as they go. */
+    if (itor && ps_pipeline_running(ps->pipeline))
+        itor = seg_snapshot(itor);
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
     ptmr_stop(&ps->perf);
     return itor;
 }
@@ -1243,7 +1932,14 @@ ps_seg_free(ps_seg_t *seg)
 ps_lattice_t *
 ps_get_lattice(ps_decoder_t *ps)
 {
-    return ps_search_lattice(ps->search);
+    ps_lattice_t *dag;
+
+    ptmr_start(&ps->lattice_perf);
+    ps_pipeline_lock(ps->pipeline);
+    dag = ps_search_lattice(ps->search);
+    ps_pipeline_unlock(ps->pipeline);
+    ptmr_stop(&ps->lattice_perf);
+    return dag;
 }
 
 ps_nbest_t *
@@ -1258,6 +1954,12 @@ ps_nbest(ps_decoder_t *ps, int sf, int ef,
 
     if (ps->search == NULL)
         return NULL;
+    /* A* search scores the language model, which the search thread
+     * is also doing, so it has to wait for the end of the utterance. */
+    if (ps_pipeline_running(ps->pipeline)) {
+        E_ERROR("N-best search is not available until ps_end_utt()\n");
+        return NULL;
+    }
     if ((dag = ps_get_lattice(ps)) == NULL)
         return NULL;
 
@@ -1274,7 +1976,9 @@ ps_nbest(ps_decoder_t *ps, int sf, int ef,
 
     w1 = ctx1 ? dict_wordid(ps_search_dict(ps->search), ctx1) : -1;
     w2 = ctx2 ? dict_wordid(ps_search_dict(ps->search), ctx2) : -1;
+    ptmr_start(&ps->lattice_perf);
     nbest = ps_astar_start(dag, lmset, lwf, sf, ef, w1, w2);
+    ptmr_stop(&ps->lattice_perf);
 
     return (ps_nbest_t *)nbest;
 }
@@ -1348,6 +2052,30 @@ ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
     *out_nwall = ps->perf.t_tot_elapsed;
 }
 
+void
+ps_get_utt_stats(ps_decoder_t *ps, ps_stats_t *out_stats)
+{
+    memset(out_stats, 0, sizeof(*out_stats));
+    ps_pipeline_lock(ps->pipeline);
+    ps_add_utt_stats(ps, out_stats);
+    ps_pipeline_unlock(ps->pipeline);
+    out_stats->t_lattice = ps->lattice_perf.t_elapsed;
+}
+
+void
+ps_get_all_stats(ps_decoder_t *ps, ps_stats_t *out_stats)
+{
+    *out_stats = ps->all_stats;
+    /* Finished utterances were added by ps_end_utt(). */
+    if (ps->acmod->state == ACMOD_STARTED
+        || ps->acmod->state == ACMOD_PROCESSING) {
+        ps_pipeline_lock(ps->pipeline);
+        ps_add_utt_stats(ps, out_stats);
+        ps_pipeline_unlock(ps->pipeline);
+    }
+    out_stats->t_lattice = ps->lattice_perf.t_tot_elapsed;
+}
+
 uint8 
 ps_get_in_speech(ps_decoder_t *ps)
 {
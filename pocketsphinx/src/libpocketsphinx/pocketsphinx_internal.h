@@ -63,6 +63,24 @@
  */
 typedef struct ps_search_s ps_search_t;
 
+/**
+ * Pipeline for processing live audio on separate threads.
+ */
+typedef struct ps_pipeline_s ps_pipeline_t;
+
+/**
+ * Read-only model parameters shared between decoders.
+ */
+struct ps_model_s {
+    int refcount;      /**< Reference count. */
+    cmd_ln_t *config;  /**< Configuration. */
+    logmath_t *lmath;  /**< Log math computation. */
+    acmod_t *acmod;    /**< Acoustic model whose parameters are shared. */
+    dict_t *dict;      /**< Pronunciation dictionary. */
+    dict2pid_t *d2p;   /**< Dictionary to senone mapping. */
+    ngram_model_t *lm; /**< Language model from -lm (or NULL). */
+};
+
 #define PS_DEFAULT_SEARCH  "default"
 #define PS_SEARCH_KWS    "kws"
 #define PS_SEARCH_FSG    "fsg"
@@ -84,6 +102,8 @@ typedef struct ps_searchfuncs_s {
     char const *(*hyp)(ps_search_t *search, int32 *out_score, int32 *out_is_final);
     int32 (*prob)(ps_search_t *search);
     ps_seg_t *(*seg_iter)(ps_search_t *search, int32 *out_score);
+    void (*stats)(ps_search_t *search, ps_stats_t *stats);
+    void (*sen_active)(ps_search_t *search, int frame_idx);
 } ps_searchfuncs_t;
 
 /**
@@ -98,6 +118,8 @@ struct ps_search_s {
     dict_t *dict;        /**< Pronunciation dictionary. */
     dict2pid_t *d2p;       /**< Dictionary to senone mappings. */
     char *hyp_str;         /**< Current hypothesis string. */
+    int32 hyp_n_stable;    /**< Length of the prefix of hyp_str which
+                              will not change (see ps_get_hyp_stable()). */
     ps_lattice_t *dag;	   /**< Current hypothesis word graph. */
     ps_latlink_t *last_link; /**< Final link in best path. */
     int32 post;            /**< Utterance posterior probability. */
@@ -131,6 +153,16 @@ struct ps_search_s {
 #define ps_search_hyp(s,sc,final) (*(ps_search_base(s)->vt->hyp))(s,sc,final)
 #define ps_search_prob(s) (*(ps_search_base(s)->vt->prob))(s)
 #define ps_search_seg_iter(s,sc) (*(ps_search_base(s)->vt->seg_iter))(s,sc)
+/** Fill in search-specific fields of stats, if the search has any. */
+#define ps_search_stats(s,st) \
+    do { if (ps_search_base(s)->vt->stats) \
+            (*(ps_search_base(s)->vt->stats))(s,st); } while (0)
+/**
+ * Add the senones a search needs in the next frame to those active
+ * in its acoustic model, without clearing them first.  Searches
+ * without this cannot share senone scores with others.
+ */
+#define ps_search_sen_active(s,i) (*(ps_search_base(s)->vt->sen_active))(s,i)
 
 /* For convenience... */
 #define ps_search_silence_wid(s) ps_search_base(s)->silence_wid
@@ -196,6 +228,7 @@ struct ps_decoder_s {
     dict_t *dict;    /**< Pronunciation dictionary. */
     dict2pid_t *d2p;   /**< Dictionary to senone mapping. */
     logmath_t *lmath;  /**< Log math computation. */
+    ps_model_t *model; /**< Shared model parameters (or NULL). */
 
     /* Search modules. */
     hash_table_t *searches;        /**< Set of search modules. */
@@ -203,18 +236,34 @@ struct ps_decoder_s {
      * lookahead value. */
     ps_search_t *search;     /**< Currently active search module. */
     ps_search_t *phone_loop; /**< Phone loop search for lookahead. */
+    ps_search_t **parallel;  /**< Searches run along with the current
+                                  one, sharing its senone scores. */
+    int n_parallel;          /**< Number of searches in parallel. */
+    ps_search_t **fsg_cache; /**< Replaced FSG searches kept for reuse,
+                                  oldest first (see -fsgcache). */
+    int n_fsg_cache;         /**< Number of searches in fsg_cache. */
     int pl_window;           /**< Window size for phoneme lookahead. */
+    ps_pipeline_t *pipeline; /**< Pipeline for live audio (or NULL). */
 
     /* Utterance-processing related stuff. */
     uint32 uttno;       /**< Utterance counter. */
     char *uttid;        /**< Utterance ID for current utterance. */
     ptmr_t perf;        /**< Performance counter for all of decoding. */
+    ptmr_t search_perf; /**< Time spent searching (including scoring). */
+    ptmr_t lattice_perf; /**< Time spent producing results. */
+    ps_stats_t all_stats; /**< Counters for finished utterances. */
     uint32 n_frame;     /**< Total number of frames processed. */
     char const *mfclogdir; /**< Log directory for MFCC files. */
     char const *rawlogdir; /**< Log directory for audio files. */
     char const *senlogdir; /**< Log directory for senone score files. */
 };
 
+/**
+ * Score and search all frames currently in the acoustic model.
+ *
+ * @return Number of frames searched, or <0 on error.
+ */
+int ps_search_forward(ps_decoder_t *ps);
 
 struct ps_search_iter_s {
     hash_iter_t itor;
@@ -57,6 +57,26 @@
 #include "ngram_search.h"
 #include "dict.h"
 
+static void
+ps_lattice_topo_free(ps_lattice_t *dag)
+{
+    ps_lattopo_t *topo = dag->topo;
+
+    if (topo == NULL)
+        return;
+    ngram_model_free(topo->lmset);
+    ckd_free(topo->links);
+    ckd_free(topo->fwd);
+    ckd_free(topo->rev);
+    ckd_free(topo->succ_start);
+    ckd_free(topo->succ_end);
+    ckd_free(topo->succ);
+    ckd_free(topo->skip);
+    ckd_free(topo->bprob);
+    ckd_free(topo);
+    dag->topo = NULL;
+}
+
 /*
  * Create a directed link between "from" and "to" nodes, but if a link already exists,
  * choose one with the best ascr.
@@ -77,6 +97,7 @@ ps_lattice_link(ps_lattice_t *dag, ps_latnode_t *from, ps_latnode_t *to,
         ps_latlink_t *link;
 
         /* No link between the two nodes; create a new one */
+        ps_lattice_topo_free(dag);
         link = listelem_malloc(dag->latlink_alloc);
         fwdlink = listelem_malloc(dag->latlink_list_alloc);
         revlink = listelem_malloc(dag->latlink_list_alloc);
@@ -199,6 +220,7 @@ ps_lattice_delete_unreachable(ps_lattice_t *dag)
     ps_latnode_t *node, *prev_node, *next_node;
     int i;
 
+    ps_lattice_topo_free(dag);
     /* Remove unreachable nodes from the list of nodes. */
     prev_node = NULL;
     for (node = dag->nodes; node; node = next_node) {
@@ -691,6 +713,7 @@ ps_lattice_free(ps_lattice_t *dag)
         return 0;
     if (--dag->refcount > 0)
         return dag->refcount;
+    ps_lattice_topo_free(dag);
     logmath_free(dag->lmath);
     dict_free(dag->dict);
     listelem_alloc_free(dag->latnode_alloc);
@@ -1223,6 +1246,131 @@ ps_lattice_reverse_next(ps_lattice_t *dag, ps_latnode_t *start)
     return next;
 }
 
+ps_lattopo_t *
+ps_lattice_topo(ps_lattice_t *dag)
+{
+    ps_lattopo_t *topo;
+    ps_latnode_t *node;
+    latlink_list_t *x;
+    int32 i, j, n, head;
+
+    if ((topo = dag->topo) != NULL)
+        return topo;
+    dag->topo = topo = ckd_calloc(1, sizeof(*topo));
+
+    /* Number the links, and list the successors of each node. */
+    for (node = dag->nodes; node; node = node->next)
+        for (x = node->exits; x; x = x->next)
+            ++topo->n_links;
+    topo->links = ckd_calloc(topo->n_links, sizeof(*topo->links));
+    topo->skip = ckd_calloc(topo->n_links, sizeof(*topo->skip));
+    topo->succ_start = ckd_calloc(topo->n_links,
+                                  sizeof(*topo->succ_start));
+    topo->succ_end = ckd_calloc(topo->n_links, sizeof(*topo->succ_end));
+    topo->succ = ckd_calloc(topo->n_links, sizeof(*topo->succ));
+    i = 0;
+    for (node = dag->nodes; node; node = node->next) {
+        for (x = node->exits; x; x = x->next) {
+            x->link->id = i;
+            topo->links[i++] = x->link;
+        }
+    }
+    j = 0;
+    for (node = dag->nodes; node; node = node->next) {
+        int32 start = j;
+
+        for (x = node->exits; x; x = x->next) {
+            if (dict_filler_word(dag->dict, x->link->to->basewid)
+                && x->link->to != dag->end)
+                continue;
+            topo->succ[j++] = x->link->id;
+        }
+        for (x = node->entries; x; x = x->next) {
+            ps_latlink_t *link = x->link;
+
+            topo->succ_start[link->id] = start;
+            topo->succ_end[link->id] = j;
+            topo->skip[link->id]
+                = ((dict_filler_word(dag->dict, link->from->basewid)
+                    && link->from != dag->start)
+                   || (dict_filler_word(dag->dict, link->to->basewid)
+                       && link->to != dag->end));
+        }
+    }
+
+    /* Forward order, as in ps_lattice_traverse_edges(), which
+     * stops once all links to the final node are seen.  The
+     * array is its own queue. */
+    topo->fwd = ckd_calloc(topo->n_links, sizeof(*topo->fwd));
+    for (node = dag->nodes; node; node = node->next)
+        node->info.fanin = 0;
+    for (i = 0; i < topo->n_links; ++i)
+        ++topo->links[i]->to->info.fanin;
+    n = 0;
+    for (x = dag->start->exits; x; x = x->next)
+        topo->fwd[n++] = x->link->id;
+    for (head = 0; head < n; ++head) {
+        ps_latlink_t *link = topo->links[topo->fwd[head]];
+
+        if (--link->to->info.fanin == 0) {
+            if (link->to == dag->end) {
+                n = head + 1;
+                break;
+            }
+            for (x = link->to->exits; x; x = x->next)
+                topo->fwd[n++] = x->link->id;
+        }
+    }
+    topo->n_fwd = n;
+
+    /* Reverse order, as in ps_lattice_reverse_edges(). */
+    topo->rev = ckd_calloc(topo->n_links, sizeof(*topo->rev));
+    for (node = dag->nodes; node; node = node->next)
+        node->info.fanin = 0;
+    for (i = 0; i < topo->n_links; ++i)
+        ++topo->links[i]->from->info.fanin;
+    n = 0;
+    for (x = dag->end->entries; x; x = x->next)
+        topo->rev[n++] = x->link->id;
+    for (head = 0; head < n; ++head) {
+        ps_latlink_t *link = topo->links[topo->rev[head]];
+
+        if (--link->from->info.fanin == 0) {
+            if (link->from == dag->start) {
+                n = head + 1;
+                break;
+            }
+            for (x = link->from->entries; x; x = x->next)
+                topo->rev[n++] = x->link->id;
+        }
+    }
+    topo->n_rev = n;
+
+    return topo;
+}
+
+void
+ps_lattice_topo_bprob(ps_lattice_t *dag, ngram_model_t *lmset)
+{
+    ps_lattopo_t *topo = ps_lattice_topo(dag);
+    int32 i;
+
+    ngram_model_free(topo->lmset);
+    topo->lmset = lmset ? ngram_model_retain(lmset) : NULL;
+    if (topo->bprob == NULL)
+        topo->bprob = ckd_calloc(topo->n_links, sizeof(*topo->bprob));
+    for (i = 0; i < topo->n_links; ++i) {
+        ps_latlink_t *link = topo->links[i];
+        int32 n_used;
+
+        if (lmset == NULL)
+            topo->bprob[i] = 0;
+        else if (!topo->skip[i] || link->to == dag->end)
+            topo->bprob[i] = ngram_ng_prob(lmset, link->to->basewid,
+                                           &link->from->basewid, 1, &n_used);
+    }
+}
+
 /*
  * Find the best score from dag->start to end point of any link and
  * use it to update links further down the path.  This is like
@@ -1239,24 +1387,23 @@ ps_lattice_bestpath(ps_lattice_t *dag, ngram_model_t *lmset,
                     float32 lwf, float32 ascale)
 {
     ps_search_t *search;
-    ps_latnode_t *node;
-    ps_latlink_t *link;
+    ps_lattopo_t *topo;
     ps_latlink_t *bestend;
     latlink_list_t *x;
     logmath_t *lmath;
-    int32 bestescr;
+    int32 bestescr, i;
 
     search = dag->search;
     lmath = dag->lmath;
+    topo = ps_lattice_topo(dag);
+    ps_lattice_topo_bprob(dag, lmset);
 
     /* Initialize path scores for all links exiting dag->start, and
      * set all other scores to the minimum.  Also initialize alphas to
      * log-zero. */
-    for (node = dag->nodes; node; node = node->next) {
-        for (x = node->exits; x; x = x->next) {
-            x->link->path_scr = MAX_NEG_INT32;
-            x->link->alpha = logmath_get_zero(lmath);
-        }
+    for (i = 0; i < topo->n_links; ++i) {
+        topo->links[i]->path_scr = MAX_NEG_INT32;
+        topo->links[i]->alpha = logmath_get_zero(lmath);
     }
     for (x = dag->start->exits; x; x = x->next) {
         int32 n_used;
@@ -1281,55 +1428,46 @@ ps_lattice_bestpath(ps_lattice_t *dag, ngram_model_t *lmset,
     }
 
     /* Traverse the edges in the graph, updating path scores. */
-    for (link = ps_lattice_traverse_edges(dag, NULL, NULL);
-         link; link = ps_lattice_traverse_next(dag, NULL)) {
-        int32 bprob, n_used;
+    for (i = 0; i < topo->n_fwd; ++i) {
+        int32 id = topo->fwd[i];
+        ps_latlink_t *link = topo->links[id];
+        int32 bprob, j;
 
         /* Skip filler nodes in traversal. */
-        if (dict_filler_word(ps_search_dict(search), link->from->basewid) && link->from != dag->start)
-            continue;
-        if (dict_filler_word(ps_search_dict(search), link->to->basewid) && link->to != dag->end)
+        if (topo->skip[id])
             continue;
 
         /* Sanity check, we should not be traversing edges that
          * weren't previously updated, otherwise nasty overflows will result. */
         assert(link->path_scr != MAX_NEG_INT32);
 
-        /* Calculate common bigram probability for all alphas. */
-        if (lmset)
-            bprob = ngram_ng_prob(lmset,
-                                  link->to->basewid,
-                                  &link->from->basewid, 1, &n_used);
-        else
-            bprob = 0;
+        /* Common bigram probability for all alphas. */
+        bprob = topo->bprob[id];
         /* Add in this link's acoustic score, which was a constant
            factor in previous computations (if any). */
         link->alpha += (link->ascr << SENSCR_SHIFT) * ascale;
 
-        /* Update scores for all paths exiting link->to. */
-        for (x = link->to->exits; x; x = x->next) {
-            int32 tscore, score;
-
-            /* Skip links to filler words in update. */
-            if (dict_filler_word(ps_search_dict(search), x->link->to->basewid)
-                && x->link->to != dag->end)
-                continue;
+        /* Update scores for all paths exiting link->to (except those
+         * to filler words, which were left out of succ). */
+        for (j = topo->succ_start[id]; j < topo->succ_end[id]; ++j) {
+            ps_latlink_t *next = topo->links[topo->succ[j]];
+            int32 tscore, score, n_used;
 
             /* Update alpha with sum of previous alphas. */
-            x->link->alpha = logmath_add(lmath, x->link->alpha, link->alpha + bprob);
+            next->alpha = logmath_add(lmath, next->alpha, link->alpha + bprob);
             /* Calculate trigram score for bestpath. */
             if (lmset)
-                tscore = (ngram_tg_score(lmset, x->link->to->basewid,
+                tscore = (ngram_tg_score(lmset, next->to->basewid,
                                         link->to->basewid,
                                         link->from->basewid, &n_used) >> SENSCR_SHIFT)
                     * lwf;
             else
                 tscore = 0;
             /* Update link score with maximum link score. */
-            score = link->path_scr + tscore + x->link->ascr;
-            if (score BETTER_THAN x->link->path_scr) {
-                x->link->path_scr = score;
-                x->link->best_prev = link;
+            score = link->path_scr + tscore + next->ascr;
+            if (score BETTER_THAN next->path_scr) {
+                next->path_scr = score;
+                next->best_prev = link;
             }
         }
     }
@@ -1343,17 +1481,10 @@ ps_lattice_bestpath(ps_lattice_t *dag, ngram_model_t *lmset,
        final node. */
     dag->norm = logmath_get_zero(lmath);
     for (x = dag->end->entries; x; x = x->next) {
-        int32 bprob, n_used;
-
         if (dict_filler_word(ps_search_dict(search), x->link->from->basewid))
             continue;
-        if (lmset)
-            bprob = ngram_ng_prob(lmset,
-                                  x->link->to->basewid,
-                                  &x->link->from->basewid, 1, &n_used);
-        else
-            bprob = 0;
-        dag->norm = logmath_add(lmath, dag->norm, x->link->alpha + bprob);
+        dag->norm = logmath_add(lmath, dag->norm,
+                                x->link->alpha + topo->bprob[x->link->id]);
         if (x->link->path_scr BETTER_THAN bestescr) {
             bestescr = x->link->path_scr;
             bestend = x->link;
@@ -1408,43 +1539,36 @@ int32
 ps_lattice_posterior(ps_lattice_t *dag, ngram_model_t *lmset,
                      float32 ascale)
 {
-    ps_search_t *search;
     logmath_t *lmath;
-    ps_latnode_t *node;
-    ps_latlink_t *link;
-    latlink_list_t *x;
+    ps_lattopo_t *topo;
     ps_latlink_t *bestend;
-    int32 bestescr;
+    int32 bestescr, i;
 
-    search = dag->search;
     lmath = dag->lmath;
+    /* Bigram probabilities are normally still there from
+     * ps_lattice_bestpath(), which computed the alphas. */
+    topo = ps_lattice_topo(dag);
+    if (topo->bprob == NULL || topo->lmset != lmset)
+        ps_lattice_topo_bprob(dag, lmset);
 
     /* Reset all betas to zero. */
-    for (node = dag->nodes; node; node = node->next) {
-        for (x = node->exits; x; x = x->next) {
-            x->link->beta = logmath_get_zero(lmath);
-        }
-    }
+    for (i = 0; i < topo->n_links; ++i)
+        topo->links[i]->beta = logmath_get_zero(lmath);
 
     bestend = NULL;
     bestescr = MAX_NEG_INT32;
     /* Accumulate backward probabilities for all links. */
-    for (link = ps_lattice_reverse_edges(dag, NULL, NULL);
-         link; link = ps_lattice_reverse_next(dag, NULL)) {
-        int32 bprob, n_used;
+    for (i = 0; i < topo->n_rev; ++i) {
+        int32 id = topo->rev[i];
+        ps_latlink_t *link = topo->links[id];
+        int32 bprob, j;
 
         /* Skip filler nodes in traversal. */
-        if (dict_filler_word(ps_search_dict(search), link->from->basewid) && link->from != dag->start)
-            continue;
-        if (dict_filler_word(ps_search_dict(search), link->to->basewid) && link->to != dag->end)
+        if (topo->skip[id])
             continue;
 
-        /* Calculate LM probability. */
-        if (lmset)
-            bprob = ngram_ng_prob(lmset, link->to->basewid,
-                                  &link->from->basewid, 1, &n_used);
-        else
-            bprob = 0;
+        /* LM probability. */
+        bprob = topo->bprob[id];
 
         if (link->to == dag->end) {
             /* Track the best path - we will backtrace in order to
@@ -1459,12 +1583,11 @@ ps_lattice_posterior(ps_lattice_t *dag, ngram_model_t *lmset,
         }
         else {
             /* Update beta from all outgoing betas. */
-            for (x = link->to->exits; x; x = x->next) {
-                if (dict_filler_word(ps_search_dict(search), x->link->to->basewid) && x->link->to != dag->end)
-                    continue;
+            for (j = topo->succ_start[id]; j < topo->succ_end[id]; ++j) {
+                ps_latlink_t *next = topo->links[topo->succ[j]];
                 link->beta = logmath_add(lmath, link->beta,
-                                         x->link->beta + bprob
-                                         + (x->link->ascr << SENSCR_SHIFT) * ascale);
+                                         next->beta + bprob
+                                         + (next->ascr << SENSCR_SHIFT) * ascale);
             }
         }
     }
@@ -1479,6 +1602,7 @@ ps_lattice_posterior_prune(ps_lattice_t *dag, int32 beam)
     ps_latlink_t *link;
     int npruned = 0;
 
+    ps_lattice_topo_free(dag);
     for (link = ps_lattice_traverse_edges(dag, dag->start, dag->end);
          link; link = ps_lattice_traverse_next(dag, dag->end)) {
         link->from->reachable = FALSE;
@@ -1557,52 +1681,139 @@ best_rem_score(ps_astar_t *nbest, ps_latnode_t * from)
 }
 
 /*
- * Insert newpath in sorted (by path score) list of paths.  But if newpath is
- * too far down the list, drop it (FIXME: necessary?)
- * total_score = path score (newpath) + rem_score to end of utt.
+ * Partial paths waiting to be extended are kept in a min-max heap
+ * ordered by total score (path score + rem_score to end of utt), so
+ * that both the best one (to extend next) and the worst one (to drop
+ * when there are too many) can be found quickly.  Ties go to the
+ * older path, as they did with the sorted list this replaces.
  */
+#define PATH_TOTAL(p) ((p)->score + (p)->node->info.rem_score)
+
+static int
+path_better(ps_latpath_t *a, ps_latpath_t *b)
+{
+    int32 ta = PATH_TOTAL(a), tb = PATH_TOTAL(b);
+
+    return ta > tb || (ta == tb && a->seq < b->seq);
+}
+
+/* Levels alternate between max (even, including the root) and min (odd). */
+static int
+heap_is_max_level(int32 i)
+{
+    int level = 0;
+
+    for (++i; i > 1; i >>= 1)
+        ++level;
+    return (level & 1) == 0;
+}
+
 static void
-path_insert(ps_astar_t *nbest, ps_latpath_t *newpath, int32 total_score)
+heap_swap(ps_latpath_t **heap, int32 i, int32 j)
 {
-    ps_latpath_t *prev, *p;
-    int32 i;
+    ps_latpath_t *tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+}
 
-    prev = NULL;
-    for (i = 0, p = nbest->path_list; (i < MAX_PATHS) && p; p = p->next, i++) {
-        if ((p->score + p->node->info.rem_score) < total_score)
+/* Order two entries as they should be on a max level (max = TRUE) or
+ * a min level (max = FALSE). */
+static int
+heap_before(ps_latpath_t *a, ps_latpath_t *b, int max)
+{
+    return max ? path_better(a, b) : path_better(b, a);
+}
+
+static void
+heap_bubble_up(ps_latpath_t **heap, int32 i)
+{
+    int max;
+
+    if (i == 0)
+        return;
+    max = heap_is_max_level(i);
+    /* If it belongs on the parent's level, move it there first. */
+    if (heap_before(heap[(i - 1) / 2], heap[i], max)) {
+        heap_swap(heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+        max = !max;
+    }
+    /* Then move it up through the levels of its kind. */
+    while (i > 2) {
+        int32 g = ((i - 1) / 2 - 1) / 2;
+        if (!heap_before(heap[i], heap[g], max))
             break;
-        prev = p;
+        heap_swap(heap, i, g);
+        i = g;
     }
+}
 
-    /* newpath should be inserted between prev and p */
-    if (i < MAX_PATHS) {
-        /* Insert new partial hyp */
-        newpath->next = p;
-        if (!prev)
-            nbest->path_list = newpath;
-        else
-            prev->next = newpath;
-        if (!p)
-            nbest->path_tail = newpath;
-
-        nbest->n_path++;
-        nbest->n_hyp_insert++;
-        nbest->insert_depth += i;
+static void
+heap_trickle_down(ps_latpath_t **heap, int32 n, int32 i)
+{
+    int max = heap_is_max_level(i);
+
+    while (2 * i + 1 < n) {
+        int32 m, c, k;
+
+        /* Find the first in order among children and grandchildren. */
+        m = 2 * i + 1;
+        for (c = 2 * i + 1; c <= 2 * i + 2 && c < n; ++c) {
+            if (heap_before(heap[c], heap[m], max))
+                m = c;
+            for (k = 2 * c + 1; k <= 2 * c + 2 && k < n; ++k)
+                if (heap_before(heap[k], heap[m], max))
+                    m = k;
+        }
+        if (!heap_before(heap[m], heap[i], max))
+            break;
+        heap_swap(heap, i, m);
+        if (m <= 2 * i + 2)
+            break;
+        /* Moved down two levels; fix up against its new parent. */
+        if (heap_before(heap[(m - 1) / 2], heap[m], max))
+            heap_swap(heap, m, (m - 1) / 2);
+        i = m;
     }
-    else {
-        /* newpath score too low; reject it and also prune paths beyond MAX_PATHS */
-        nbest->path_tail = prev;
-        prev->next = NULL;
-        nbest->n_path = MAX_PATHS;
-        listelem_free(nbest->latpath_alloc, newpath);
+}
+
+/* Remove the best (i = 0) or worst path from the heap and return it. */
+static ps_latpath_t *
+path_remove(ps_astar_t *nbest, int32 i)
+{
+    ps_latpath_t *path = nbest->paths[i];
+
+    nbest->paths[i] = nbest->paths[--nbest->n_path];
+    if (i < nbest->n_path)
+        heap_trickle_down(nbest->paths, nbest->n_path, i);
+    return path;
+}
 
+/*
+ * Insert newpath in the heap of paths.  But if there are already
+ * MAX_PATHS of them, drop the worst one, which may be newpath.
+ */
+static void
+path_insert(ps_astar_t *nbest, ps_latpath_t *newpath)
+{
+    newpath->seq = nbest->n_seq++;
+    if (nbest->n_path >= MAX_PATHS) {
+        int32 worst;
+
+        /* The worst path is on the first min level. */
+        worst = 1;
+        if (nbest->n_path > 2 && path_better(nbest->paths[1], nbest->paths[2]))
+            worst = 2;
         nbest->n_hyp_reject++;
-        for (; p; p = newpath) {
-            newpath = p->next;
-            listelem_free(nbest->latpath_alloc, p);
-            nbest->n_hyp_reject++;
+        if (!path_better(newpath, nbest->paths[worst])) {
+            listelem_free(nbest->latpath_alloc, newpath);
+            return;
         }
+        listelem_free(nbest->latpath_alloc, path_remove(nbest, worst));
     }
+    nbest->paths[nbest->n_path] = newpath;
+    heap_bubble_up(nbest->paths, nbest->n_path++);
+    nbest->n_hyp_insert++;
 }
 
 /* Find all possible extensions to given partial path */
@@ -1611,7 +1822,6 @@ path_extend(ps_astar_t *nbest, ps_latpath_t * path)
 {
     latlink_list_t *x;
     ps_latpath_t *newpath;
-    int32 total_score, tail_score;
 
     /* Consider all successors of path->node */
     for (x = path->node->exits; x; x = x->next) {
@@ -1641,23 +1851,9 @@ path_extend(ps_astar_t *nbest, ps_latpath_t * path)
                        >> SENSCR_SHIFT);
         }
 
-        /* Insert new partial path hypothesis into sorted path_list */
+        /* Insert new partial path hypothesis into the heap */
         nbest->n_hyp_tried++;
-        total_score = newpath->score + newpath->node->info.rem_score;
-
-        /* First see if hyp would be worse than the worst */
-        if (nbest->n_path >= MAX_PATHS) {
-            tail_score =
-                nbest->path_tail->score
-                + nbest->path_tail->node->info.rem_score;
-            if (total_score < tail_score) {
-                listelem_free(nbest->latpath_alloc, newpath);
-                nbest->n_hyp_reject++;
-                continue;
-            }
-        }
-
-        path_insert(nbest, newpath, total_score);
+        path_insert(nbest, newpath);
     }
 }
 
@@ -1683,6 +1879,7 @@ ps_astar_start(ps_lattice_t *dag,
     nbest->w1 = w1;
     nbest->w2 = w2;
     nbest->latpath_alloc = listelem_alloc_init(sizeof(ps_latpath_t));
+    nbest->paths = ckd_calloc(MAX_PATHS, sizeof(*nbest->paths));
 
     /* Initialize rem_score (A* heuristic) to default values */
     for (node = dag->nodes; node; node = node->next) {
@@ -1695,7 +1892,6 @@ ps_astar_start(ps_lattice_t *dag,
     }
 
     /* Create initial partial hypotheses list consisting of nodes starting at sf */
-    nbest->path_list = nbest->path_tail = NULL;
     for (node = dag->nodes; node; node = node->next) {
         if (node->sf == sf) {
             ps_latpath_t *path;
@@ -1713,7 +1909,7 @@ ps_astar_start(ps_lattice_t *dag,
             else
                 path->score = 0;
             path->score >>= SENSCR_SHIFT;
-            path_insert(nbest, path, path->score + node->info.rem_score);
+            path_insert(nbest, path);
         }
     }
 
@@ -1728,11 +1924,8 @@ ps_astar_next(ps_astar_t *nbest)
     dag = nbest->dag;
 
     /* Pop the top (best) partial hypothesis */
-    while ((nbest->top = nbest->path_list) != NULL) {
-        nbest->path_list = nbest->path_list->next;
-        if (nbest->top == nbest->path_tail)
-            nbest->path_tail = NULL;
-        nbest->n_path--;
+    while (nbest->n_path > 0) {
+        nbest->top = path_remove(nbest, 0);
 
         /* Complete hypothesis? */
         if ((nbest->top->node->sf >= nbest->ef)
@@ -1750,6 +1943,7 @@ ps_astar_next(ps_astar_t *nbest)
     }
 
     /* Did not find any more paths to extend. */
+    nbest->top = NULL;
     return NULL;
 }
 
@@ -1885,6 +2079,7 @@ ps_astar_finish(ps_astar_t *nbest)
     }
     glist_free(nbest->hyps);
     /* Free all paths. */
+    ckd_free(nbest->paths);
     listelem_alloc_free(nbest->latpath_alloc);
     /* Free the Henge. */
     ckd_free(nbest);
@@ -84,6 +84,9 @@ struct ps_lattice_s {
     /* This will probably be replaced with a heap. */
     latlink_list_t *q_head; /**< Queue of links for traversal. */
     latlink_list_t *q_tail; /**< Queue of links for traversal. */
+
+    struct ps_lattopo_s *topo; /**< Sorted links (see ps_lattice_topo()),
+                                    or NULL if not built or out of date. */
 };
 
 /**
@@ -102,8 +105,36 @@ struct ps_latlink_s {
     frame_idx_t ef;			/**< Ending frame of this word  */
     int32 alpha;                /**< Forward probability of this link P(w,o_1^{ef}) */
     int32 beta;                 /**< Backward probability of this link P(w|o_{ef+1}^T) */
+    int32 id;                   /**< Index in ps_lattopo_t (if built) */
 };
 
+/**
+ * Links of a word graph in traversal order, with the successors of
+ * each one in compressed sparse row form, for bestpath and posterior
+ * computation.
+ *
+ * Forward and reverse orders are exactly those of
+ * ps_lattice_traverse_edges() and ps_lattice_reverse_edges().  Links
+ * to filler words other than the final node, which these searches
+ * skip, are left out of the successor lists.
+ */
+typedef struct ps_lattopo_s {
+    ps_latlink_t **links;   /**< All links, indexed by ID. */
+    int32 n_links;          /**< Number of links. */
+    int32 *fwd;             /**< IDs of links in forward order. */
+    int32 n_fwd;            /**< Number of entries in fwd. */
+    int32 *rev;             /**< IDs of links in reverse order. */
+    int32 n_rev;            /**< Number of entries in rev. */
+    int32 *succ_start;      /**< First entry in succ for each link. */
+    int32 *succ_end;        /**< End of the entries in succ for each link. */
+    int32 *succ;            /**< IDs of the successors of links. */
+    uint8 *skip;            /**< Whether a link touches a filler word. */
+    ngram_model_t *lmset;   /**< Language model for bprob, or NULL. */
+    int32 *bprob;           /**< Bigram probability of the word at the
+                                 end of each link given the one at its
+                                 start, from lmset. */
+} ps_lattopo_t;
+
 /**
  * DAG nodes.
  *
@@ -153,8 +184,8 @@ typedef struct dag_seg_s {
 typedef struct ps_latpath_s {
     ps_latnode_t *node;            /**< Node ending this path. */
     struct ps_latpath_s *parent;   /**< Previous element in this path. */
-    struct ps_latpath_s *next;     /**< Pointer to next path in list of paths. */
     int32 score;                  /**< Exact score from start node up to node->sf. */
+    int32 seq;                    /**< Creation order, to break ties. */
 } ps_latpath_t;
 
 /**
@@ -173,11 +204,10 @@ typedef struct ps_astar_s {
     int32 n_hyp_tried;
     int32 n_hyp_insert;
     int32 n_hyp_reject;
-    int32 insert_depth;
     int32 n_path;
+    int32 n_seq;          /**< Number of paths created so far. */
 
-    ps_latpath_t *path_list;
-    ps_latpath_t *path_tail;
+    ps_latpath_t **paths; /**< Min-max heap of partial paths to extend. */
     ps_latpath_t *top;
 
     glist_t hyps;	             /**< List of hypothesis strings. */
@@ -230,6 +260,22 @@ void ps_lattice_delq(ps_lattice_t *dag);
 latlink_list_t *latlink_list_new(ps_lattice_t *dag, ps_latlink_t *link,
                                  latlink_list_t *next);
 
+/**
+ * Sort the links of a word graph for bestpath and posterior
+ * computation, if this has not already been done since they were
+ * last modified.
+ *
+ * @return Sorted links, owned by dag.
+ */
+ps_lattopo_t *ps_lattice_topo(ps_lattice_t *dag);
+
+/**
+ * Look up the bigram probabilities of all links in a word graph.
+ *
+ * @param lmset Language model to use, or NULL for none.
+ */
+void ps_lattice_topo_bprob(ps_lattice_t *dag, ngram_model_t *lmset);
+
 /**
  * Get hypothesis string after bestpath search.
  */
@@ -0,0 +1,428 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_pipeline.c Pipelined processing of live audio.
+ */
+
+/* System headers. */
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/profile.h>
+
+/* Local headers. */
+#include "ps_pipeline.h"
+
+/* A block of audio, as passed to ps_process_raw(). */
+typedef struct pipe_block_s {
+    int16 *data;
+    size_t n_samps;
+    size_t n_alloc;
+} pipe_block_t;
+
+/* A block of cepstra, as produced by one acmod_process_raw(). */
+typedef struct pipe_chunk_s {
+    mfcc_t **cep;
+    int32 n_frames;
+} pipe_chunk_t;
+
+/*
+ * Both queues are circular arrays of blocks.  The head and count of
+ * each are protected by mtx; a block in a queue belongs to its
+ * consumer, and a free one to its producer, so its contents are
+ * accessed without locking.  Each thread has an event which is
+ * signalled whenever something it might be waiting for changes, and
+ * waits on it in a loop that re-checks its condition with mtx held.
+ *
+ * Blocks are never split or merged, so that the acoustic model sees
+ * exactly the same sequence of calls as it does without the pipeline.
+ */
+struct ps_pipeline_s {
+    ps_decoder_t *ps;
+    sbthread_t *fe_thread;
+    sbthread_t *search_thread;
+
+    sbmtx_t *mtx;              /**< Protects everything below. */
+    sbmtx_t *search_mtx;       /**< Held while the search thread searches. */
+    sbevent_t *caller_evt;     /**< Audio queue has room, or error. */
+    sbevent_t *fe_evt;         /**< Audio, room for cepstra, or end. */
+    sbevent_t *search_evt;     /**< Cepstra, or front end finished. */
+
+    pipe_block_t blocks[PS_PIPELINE_BLOCKS];  /**< Audio queue. */
+    int block_out;             /**< Index of first queued block. */
+    int n_blocks;              /**< Number of queued blocks. */
+    size_t n_samps;            /**< Number of queued samples. */
+
+    pipe_chunk_t chunks[PS_PIPELINE_CHUNKS];  /**< Cepstrum queue. */
+    int chunk_out;             /**< Index of first queued chunk. */
+    int n_chunks;              /**< Number of queued chunks. */
+    int32 chunk_alloc;         /**< Frames allocated in each chunk. */
+
+    int32 n_searched;          /**< Frames searched, not yet reported. */
+    float64 t_fe;              /**< Time spent in the front end. */
+    int running;               /**< Threads have been started. */
+    int ended;                 /**< No more audio will be queued. */
+    int fe_done;               /**< Front end thread has finished. */
+    int error;                 /**< Something has failed. */
+};
+
+/* Wait on evt (with pipe->mtx held) until cond is true. */
+#define PIPE_WAIT(pipe, evt, cond)              \
+    while (!(cond)) {                           \
+        sbmtx_unlock((pipe)->mtx);              \
+        sbevent_wait((evt), -1, -1);            \
+        sbmtx_lock((pipe)->mtx);                \
+    }
+
+static int
+fe_main(sbthread_t *th)
+{
+    ps_pipeline_t *pipe = sbthread_arg(th);
+    acmod_t *acmod = pipe->ps->acmod;
+    ptmr_t fe_perf;
+    int rv;
+
+    ptmr_init(&fe_perf);
+    sbmtx_lock(pipe->mtx);
+    while (!pipe->error) {
+        pipe_block_t *block;
+        int16 const *rawptr;
+        size_t n_left;
+        int failed = FALSE;
+
+        PIPE_WAIT(pipe, pipe->fe_evt,
+                  pipe->error || pipe->ended || pipe->n_blocks > 0);
+        if (pipe->error || pipe->n_blocks == 0)
+            break;
+        block = pipe->blocks + pipe->block_out;
+        sbmtx_unlock(pipe->mtx);
+
+        /* Convert it in the same pieces as ps_process_raw() would. */
+        rawptr = block->data;
+        n_left = block->n_samps;
+        while (n_left > 0) {
+            pipe_chunk_t *chunk;
+
+            sbmtx_lock(pipe->mtx);
+            PIPE_WAIT(pipe, pipe->fe_evt,
+                      pipe->error || pipe->n_chunks < PS_PIPELINE_CHUNKS);
+            if (pipe->error) {
+                failed = TRUE;
+                break;
+            }
+            chunk = pipe->chunks
+                + (pipe->chunk_out + pipe->n_chunks) % PS_PIPELINE_CHUNKS;
+            sbmtx_unlock(pipe->mtx);
+
+            chunk->n_frames = pipe->chunk_alloc;
+            ptmr_start(&fe_perf);
+            rv = acmod_fe_process_raw(acmod, &rawptr, &n_left,
+                                      chunk->cep, &chunk->n_frames);
+            ptmr_stop(&fe_perf);
+            if (rv < 0) {
+                sbmtx_lock(pipe->mtx);
+                pipe->error = failed = TRUE;
+                break;
+            }
+
+            sbmtx_lock(pipe->mtx);
+            pipe->t_fe = fe_perf.t_elapsed;
+            ++pipe->n_chunks;
+            sbevent_signal(pipe->search_evt);
+            sbmtx_unlock(pipe->mtx);
+        }
+        if (failed)
+            break; /* mtx is still held. */
+
+        sbmtx_lock(pipe->mtx);
+        pipe->block_out = (pipe->block_out + 1) % PS_PIPELINE_BLOCKS;
+        --pipe->n_blocks;
+        pipe->n_samps -= block->n_samps;
+        sbevent_signal(pipe->caller_evt);
+    }
+    pipe->fe_done = TRUE;
+    rv = pipe->error ? -1 : 0;
+    sbevent_signal(pipe->caller_evt);
+    sbevent_signal(pipe->search_evt);
+    sbmtx_unlock(pipe->mtx);
+
+    return rv;
+}
+
+static int
+search_main(sbthread_t *th)
+{
+    ps_pipeline_t *pipe = sbthread_arg(th);
+    ps_decoder_t *ps = pipe->ps;
+    int rv;
+
+    sbmtx_lock(pipe->mtx);
+    while (!pipe->error) {
+        pipe_chunk_t *chunk;
+        int nfr;
+
+        PIPE_WAIT(pipe, pipe->search_evt,
+                  pipe->error || pipe->fe_done || pipe->n_chunks > 0);
+        if (pipe->error || pipe->n_chunks == 0)
+            break;
+        chunk = pipe->chunks + pipe->chunk_out;
+        sbmtx_unlock(pipe->mtx);
+
+        /* Compute features, then score and search them. */
+        sbmtx_lock(pipe->search_mtx);
+        if ((nfr = acmod_process_fe_cep(ps->acmod, chunk->cep,
+                                        chunk->n_frames)) >= 0)
+            nfr = ps_search_forward(ps);
+        sbmtx_unlock(pipe->search_mtx);
+
+        sbmtx_lock(pipe->mtx);
+        if (nfr < 0) {
+            pipe->error = TRUE;
+            break;
+        }
+        pipe->chunk_out = (pipe->chunk_out + 1) % PS_PIPELINE_CHUNKS;
+        --pipe->n_chunks;
+        pipe->n_searched += nfr;
+        sbevent_signal(pipe->fe_evt);
+    }
+    /* Wake up anybody waiting for us, in case we failed. */
+    rv = pipe->error ? -1 : 0;
+    sbevent_signal(pipe->caller_evt);
+    sbevent_signal(pipe->fe_evt);
+    sbmtx_unlock(pipe->mtx);
+
+    return rv;
+}
+
+ps_pipeline_t *
+ps_pipeline_init(ps_decoder_t *ps)
+{
+    ps_pipeline_t *pipe;
+
+    pipe = ckd_calloc(1, sizeof(*pipe));
+    pipe->ps = ps;
+    if ((pipe->mtx = sbmtx_init()) == NULL
+        || (pipe->search_mtx = sbmtx_init()) == NULL
+        || (pipe->caller_evt = sbevent_init()) == NULL
+        || (pipe->fe_evt = sbevent_init()) == NULL
+        || (pipe->search_evt = sbevent_init()) == NULL) {
+        E_ERROR("Failed to initialize synchronization for pipeline\n");
+        ps_pipeline_free(pipe);
+        return NULL;
+    }
+    E_INFO("Pipelined processing of live audio, queues of %d samples "
+           "and %d blocks of frames\n", PS_PIPELINE_SAMPLES,
+           PS_PIPELINE_CHUNKS);
+
+    return pipe;
+}
+
+void
+ps_pipeline_free(ps_pipeline_t *pipe)
+{
+    int i;
+
+    if (pipe == NULL)
+        return;
+    ps_pipeline_end_utt(pipe);
+    if (pipe->mtx)
+        sbmtx_free(pipe->mtx);
+    if (pipe->search_mtx)
+        sbmtx_free(pipe->search_mtx);
+    if (pipe->caller_evt)
+        sbevent_free(pipe->caller_evt);
+    if (pipe->fe_evt)
+        sbevent_free(pipe->fe_evt);
+    if (pipe->search_evt)
+        sbevent_free(pipe->search_evt);
+    for (i = 0; i < PS_PIPELINE_BLOCKS; ++i)
+        ckd_free(pipe->blocks[i].data);
+    for (i = 0; i < PS_PIPELINE_CHUNKS; ++i)
+        ckd_free_2d(pipe->chunks[i].cep);
+    ckd_free(pipe);
+}
+
+int
+ps_pipeline_start_utt(ps_pipeline_t *pipe)
+{
+    acmod_t *acmod = pipe->ps->acmod;
+
+    if (pipe->running) {
+        E_ERROR("Pipeline is already running\n");
+        return -1;
+    }
+    /* The cepstrum buffer can grow for full utterances. */
+    if (pipe->chunk_alloc < acmod->n_mfc_alloc) {
+        int i;
+        pipe->chunk_alloc = acmod->n_mfc_alloc;
+        for (i = 0; i < PS_PIPELINE_CHUNKS; ++i) {
+            ckd_free_2d(pipe->chunks[i].cep);
+            pipe->chunks[i].cep = (mfcc_t **)
+                ckd_calloc_2d(pipe->chunk_alloc,
+                              fe_get_output_size(acmod->fe),
+                              sizeof(**pipe->chunks[i].cep));
+        }
+    }
+    pipe->block_out = pipe->n_blocks = 0;
+    pipe->n_samps = 0;
+    pipe->chunk_out = pipe->n_chunks = 0;
+    pipe->n_searched = 0;
+    pipe->t_fe = 0.0;
+    pipe->ended = pipe->fe_done = pipe->error = FALSE;
+    /* Clear any stale signals from the previous utterance. */
+    sbevent_wait(pipe->caller_evt, 0, 0);
+    sbevent_wait(pipe->fe_evt, 0, 0);
+    sbevent_wait(pipe->search_evt, 0, 0);
+
+    if ((pipe->search_thread = sbthread_start(NULL, search_main, pipe)) == NULL)
+        return -1;
+    if ((pipe->fe_thread = sbthread_start(NULL, fe_main, pipe)) == NULL) {
+        sbmtx_lock(pipe->mtx);
+        pipe->fe_done = TRUE;
+        sbevent_signal(pipe->search_evt);
+        sbmtx_unlock(pipe->mtx);
+        sbthread_free(pipe->search_thread);
+        pipe->search_thread = NULL;
+        return -1;
+    }
+    pipe->running = TRUE;
+
+    return 0;
+}
+
+int
+ps_pipeline_process_raw(ps_pipeline_t *pipe,
+                        int16 const *data,
+                        size_t n_samples)
+{
+    pipe_block_t *block;
+    int nfr;
+
+    sbmtx_lock(pipe->mtx);
+    /* Wait for room, but always take a block if the queue is empty. */
+    PIPE_WAIT(pipe, pipe->caller_evt,
+              pipe->error
+              || pipe->n_blocks == 0
+              || (pipe->n_blocks < PS_PIPELINE_BLOCKS
+                  && pipe->n_samps + n_samples <= PS_PIPELINE_SAMPLES));
+    if (!pipe->error && n_samples > 0) {
+        block = pipe->blocks
+            + (pipe->block_out + pipe->n_blocks) % PS_PIPELINE_BLOCKS;
+        sbmtx_unlock(pipe->mtx);
+
+        if (block->n_alloc < n_samples) {
+            ckd_free(block->data);
+            block->data = ckd_calloc(n_samples, sizeof(*block->data));
+            block->n_alloc = n_samples;
+        }
+        memcpy(block->data, data, n_samples * sizeof(*data));
+        block->n_samps = n_samples;
+
+        sbmtx_lock(pipe->mtx);
+        ++pipe->n_blocks;
+        pipe->n_samps += n_samples;
+        sbevent_signal(pipe->fe_evt);
+    }
+    nfr = pipe->error ? -1 : pipe->n_searched;
+    pipe->n_searched = 0;
+    sbmtx_unlock(pipe->mtx);
+
+    return nfr;
+}
+
+int
+ps_pipeline_end_utt(ps_pipeline_t *pipe)
+{
+    int rv;
+
+    if (pipe == NULL || !pipe->running)
+        return 0;
+    sbmtx_lock(pipe->mtx);
+    pipe->ended = TRUE;
+    sbevent_signal(pipe->fe_evt);
+    sbmtx_unlock(pipe->mtx);
+
+    rv = sbthread_wait(pipe->fe_thread);
+    if (sbthread_wait(pipe->search_thread) < 0)
+        rv = -1;
+    sbthread_free(pipe->fe_thread);
+    sbthread_free(pipe->search_thread);
+    pipe->fe_thread = pipe->search_thread = NULL;
+    pipe->running = FALSE;
+    /* The front end time now belongs to the acoustic model. */
+    pipe->ps->acmod->fe_perf.t_elapsed += pipe->t_fe;
+    pipe->t_fe = 0.0;
+
+    return rv < 0 ? -1 : 0;
+}
+
+int
+ps_pipeline_running(ps_pipeline_t *pipe)
+{
+    return pipe != NULL && pipe->running;
+}
+
+float64
+ps_pipeline_fe_time(ps_pipeline_t *pipe)
+{
+    float64 t_fe;
+
+    if (pipe == NULL)
+        return 0.0;
+    sbmtx_lock(pipe->mtx);
+    t_fe = pipe->t_fe;
+    sbmtx_unlock(pipe->mtx);
+    return t_fe;
+}
+
+void
+ps_pipeline_lock(ps_pipeline_t *pipe)
+{
+    if (pipe)
+        sbmtx_lock(pipe->search_mtx);
+}
+
+void
+ps_pipeline_unlock(ps_pipeline_t *pipe)
+{
+    if (pipe)
+        sbmtx_unlock(pipe->search_mtx);
+}
@@ -0,0 +1,137 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file ps_pipeline.h
+ * @brief Pipelined processing of live audio.
+ *
+ * Normally ps_process_raw() runs the front end, feature computation,
+ * senone scoring and search on the caller's thread, one block of
+ * frames after another.  In pipelined mode (<code>-pipeline
+ * yes</code>) it only copies the audio into a bounded queue and
+ * returns.  A front end thread turns the audio into cepstra, which go
+ * into a second bounded queue, and a search thread computes dynamic
+ * features, scores senones and searches them.  The caller only waits
+ * when the audio queue is full.  ps_end_utt() drains both queues and
+ * joins the threads, after which the utterance is finished on the
+ * caller's thread as it is otherwise.  The acoustic model sees the same
+ * sequence of operations as it does without the pipeline, so the
+ * results are identical.
+ *
+ * Senone scoring stays on the search thread because the set of active
+ * senones for a frame depends on the search of the previous one; use
+ * <code>-nthreads</code> to spread the scoring itself over several
+ * threads.
+ */
+
+#ifndef __PS_PIPELINE_H__
+#define __PS_PIPELINE_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+
+/* Local headers. */
+#include "pocketsphinx_internal.h"
+
+/**
+ * Number of samples in the audio queue (more if a single block is
+ * larger than this).
+ */
+#define PS_PIPELINE_SAMPLES 8192
+
+/**
+ * Maximum number of blocks of audio in the audio queue.
+ */
+#define PS_PIPELINE_BLOCKS 32
+
+/**
+ * Number of blocks of cepstra in the cepstrum queue.  Each holds the
+ * output of one acmod_fe_process_raw(), a few frames.
+ */
+#define PS_PIPELINE_CHUNKS 16
+
+/**
+ * Create the pipeline for a decoder.
+ */
+ps_pipeline_t *ps_pipeline_init(ps_decoder_t *ps);
+
+/**
+ * Free the pipeline, stopping its threads if they are running.
+ */
+void ps_pipeline_free(ps_pipeline_t *pipe);
+
+/**
+ * Start the front end and search threads for the current utterance.
+ */
+int ps_pipeline_start_utt(ps_pipeline_t *pipe);
+
+/**
+ * Queue audio for processing.
+ *
+ * @return Number of frames searched since the previous call, or -1 if
+ * processing has failed.
+ */
+int ps_pipeline_process_raw(ps_pipeline_t *pipe,
+                            int16 const *data,
+                            size_t n_samples);
+
+/**
+ * Process all queued audio and stop the threads.
+ *
+ * @return 0, or -1 if processing has failed.
+ */
+int ps_pipeline_end_utt(ps_pipeline_t *pipe);
+
+/**
+ * Are the pipeline threads running?
+ */
+int ps_pipeline_running(ps_pipeline_t *pipe);
+
+/**
+ * Time spent by the front end thread in the current utterance and not
+ * yet added to the acoustic model's fe_perf (0 if pipe is NULL).
+ */
+float64 ps_pipeline_fe_time(ps_pipeline_t *pipe);
+
+/**
+ * Lock out the search thread while examining the search.
+ *
+ * Both functions do nothing if pipe is NULL.
+ */
+void ps_pipeline_lock(ps_pipeline_t *pipe);
+void ps_pipeline_unlock(ps_pipeline_t *pipe);
+
+#endif /* __PS_PIPELINE_H__ */
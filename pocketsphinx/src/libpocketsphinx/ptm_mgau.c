@@ -64,7 +64,10 @@ static ps_mgaufuncs_t ptm_mgau_funcs = {
     "ptm",
     ptm_mgau_frame_eval,      /* frame_eval */
     ptm_mgau_mllr_transform,  /* transform */
-    ptm_mgau_free             /* free */
+    ptm_mgau_free,            /* free */
+    ptm_mgau_write_image,     /* write_image */
+    ptm_mgau_copy,            /* copy */
+    NULL                      /* frame_eval_batch */
 };
 
 #define COMPUTE_GMM_MAP(_idx)                           \
@@ -188,9 +191,9 @@ eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
             compl[0] = MFCCMUL(sqdiff[0], *var++);
             d = GMMSUB(d, compl[0]);
         }
-        /* Now do 4 dimensions at a time.  You'd think that GCC would
-         * vectorize this?  Apparently not.  And it's right, because
-         * that won't make this any faster, at least on x86-64. */
+        /* Now do 4 dimensions at a time.  GCC won't vectorize this,
+         * and it would not help much along this axis anyway.  See
+         * eval_cb_simd() for vectorization across codewords. */
         for (; j < ceplen && d >= thresh; j += 4) {
             COMPUTE_GMM_MAP(0);
             COMPUTE_GMM_MAP(1);
@@ -225,6 +228,58 @@ eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
     return best->score;
 }
 
+/**
+ * Equivalent to eval_cb(), but scores MGAU_SIMD_BLOCK codewords at a
+ * time with a vector kernel over the transposed codebook.
+ */
+static int
+eval_cb_simd(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+{
+    ptm_topn_t *worst, *best, *topn;
+    mgau_simd_t *simd;
+    mfcc_t const *mean, *var, *det;
+    mfcc_t dist[MGAU_SIMD_BLOCK];
+    int32 i, cw0, ceplen;
+
+    simd = s->simd;
+    best = topn = s->f->topn[cb][feat];
+    worst = topn + (s->max_topn - 1);
+    mean = simd->mean[cb][feat];
+    var = simd->var[cb][feat];
+    det = simd->det[cb][feat];
+    ceplen = s->g->featlen[feat];
+
+    for (cw0 = 0; cw0 < s->g->n_density; cw0 += MGAU_SIMD_BLOCK) {
+        int32 k, n;
+
+        /* The kernel can only prune with the threshold from the start
+         * of the block, which is never higher than the one eval_cb()
+         * would use, so nothing is lost. */
+        if (!(*simd->eval_block)(dist, NULL, z, mean + cw0, var + cw0,
+                                 det + cw0, simd->stride, ceplen,
+                                 (mfcc_t) worst->score))
+            continue;
+        n = MIN(MGAU_SIMD_BLOCK, s->g->n_density - cw0);
+        for (k = 0; k < n; ++k) {
+            ptm_topn_t *cur;
+            int32 cw = cw0 + k;
+
+            if (dist[k] < (mfcc_t) worst->score)
+                continue;
+            for (i = 0; i < s->max_topn; i++) {
+                /* already there, so don't need to insert */
+                if (topn[i].cw == cw)
+                    break;
+            }
+            if (i < s->max_topn)
+                continue;       /* already there.  Don't insert */
+            insertion_sort_cb(&cur, worst, best, cw, (int32)dist[k]);
+        }
+    }
+
+    return best->score;
+}
+
 /**
  * Compute top-N densities for active codebooks (and prune)
  */
@@ -246,8 +301,12 @@ ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
     for (i = 0; i < s->g->n_mgau; ++i) {
         if (bitvec_is_clear(s->f->mgau_active, i))
             continue;
+        s->base.n_codebook_eval += s->g->n_feat;
         for (j = 0; j < s->g->n_feat; ++j) {
-            eval_cb(s, i, j, z[j]);
+            if (s->simd)
+                eval_cb_simd(s, i, j, z[j]);
+            else
+                eval_cb(s, i, j, z[j]);
         }
     }
     return 0;
@@ -766,6 +825,139 @@ read_mixw(ptm_mgau_t * s, char const *file_name, double SmoothMin)
     return n_sen;
 }
 
+static int32
+read_mixw_image(ptm_mgau_t *s, bin_mdef_t *mdef, acmod_image_t *img)
+{
+    char const *data;
+    int32 const *hdr;
+    size_t len, pos, step;
+    int n_feat, n_density, n_bits, n, i;
+
+    if ((data = acmod_image_section(img, "mixw", &len)) == NULL
+        || len < 4 * sizeof(int32) + 16) {
+        E_ERROR("Acoustic model image has no quantized mixture weights\n");
+        return -1;
+    }
+    hdr = (int32 const *)data;
+    n_feat = hdr[0];
+    n_density = hdr[1];
+    s->n_sen = hdr[2];
+    n_bits = hdr[3];
+    if (n_feat != s->g->n_feat || n_density != s->g->n_density) {
+        E_ERROR("Mixture weights in image don't match codebooks\n");
+        return -1;
+    }
+    if (s->n_sen != bin_mdef_n_sen(mdef)) {
+        E_ERROR("Number of senones in image (%d) doesn't match mdef (%d)\n",
+                s->n_sen, bin_mdef_n_sen(mdef));
+        return -1;
+    }
+    step = (n_bits == 4) ? (s->n_sen + 1) / 2 : s->n_sen;
+    pos = ACMOD_IMAGE_ALIGN(4 * sizeof(int32) + 16);
+    if (pos + (size_t)n_feat * n_density * step > len) {
+        E_ERROR("Mixture weights in acoustic model image are truncated\n");
+        return -1;
+    }
+
+    /* Set up pointers like we do for a memory-mapped sendump. */
+    s->image = acmod_image_retain(img);
+    if (n_bits == 4)
+        s->mixw_cb = (uint8 *)(data + 4 * sizeof(int32));
+    s->mixw = ckd_calloc_2d(n_feat, n_density, sizeof(*s->mixw));
+    for (n = 0; n < n_feat; n++) {
+        for (i = 0; i < n_density; i++) {
+            s->mixw[n][i] = (uint8 *)(data + pos);
+            pos += step;
+        }
+    }
+    E_INFO("Using %d-bit mixture weights for %d senones from image\n",
+           n_bits, s->n_sen);
+    return 0;
+}
+
+int
+ptm_mgau_write_image(ps_mgau_t *ps, acmod_image_writer_t *w)
+{
+    ptm_mgau_t *s = (ptm_mgau_t *)ps;
+    FILE *fh;
+    uint8 cb[16];
+    int32 val;
+    int n, i, step;
+
+    if (gauden_write_image(s->g, w) < 0)
+        return -1;
+    if ((fh = acmod_image_writer_section(w, "mixw")) == NULL)
+        return -1;
+    val = s->g->n_feat;
+    fwrite(&val, sizeof(val), 1, fh);
+    val = s->g->n_density;
+    fwrite(&val, sizeof(val), 1, fh);
+    val = s->n_sen;
+    fwrite(&val, sizeof(val), 1, fh);
+    /* Clustered weights are packed two to a byte. */
+    val = s->mixw_cb ? 4 : 8;
+    fwrite(&val, sizeof(val), 1, fh);
+    memset(cb, 0, sizeof(cb));
+    if (s->mixw_cb)
+        memcpy(cb, s->mixw_cb, sizeof(cb));
+    fwrite(cb, 1, sizeof(cb), fh);
+    acmod_image_writer_align(w);
+    step = s->mixw_cb ? (s->n_sen + 1) / 2 : s->n_sen;
+    for (n = 0; n < s->g->n_feat; n++)
+        for (i = 0; i < s->g->n_density; i++)
+            fwrite(s->mixw[n][i], 1, step, fh);
+
+    return ferror(fh) ? -1 : 0;
+}
+
+static void
+init_fast_hist(ptm_mgau_t *s)
+{
+    int i;
+
+    /* We need enough for the phoneme lookahead window, plus the
+     * current frame, plus one for good measure? (FIXME: I don't
+     * remember why) */
+    s->n_fast_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
+    s->hist = ckd_calloc(s->n_fast_hist, sizeof(*s->hist));
+    /* s->f will be a rotating pointer into s->hist. */
+    s->f = s->hist;
+    for (i = 0; i < s->n_fast_hist; ++i) {
+        int j, k, m;
+        /* Top-N codewords for every codebook and feature. */
+        s->hist[i].topn = ckd_calloc_3d(s->g->n_mgau, s->g->n_feat,
+                                        s->max_topn, sizeof(ptm_topn_t));
+        /* Initialize them to sane (yet arbitrary) defaults. */
+        for (j = 0; j < s->g->n_mgau; ++j) {
+            for (k = 0; k < s->g->n_feat; ++k) {
+                for (m = 0; m < s->max_topn; ++m) {
+                    s->hist[i].topn[j][k][m].cw = m;
+                    s->hist[i].topn[j][k][m].score = WORST_DIST;
+                }
+            }
+        }
+        /* Active codebook mapping (just codebook, not features,
+           at least not yet) */
+        s->hist[i].mgau_active = bitvec_alloc(s->g->n_mgau);
+        /* Start with them all on, prune them later. */
+        bitvec_set_all(s->hist[i].mgau_active, s->g->n_mgau);
+    }
+}
+
+static void
+free_fast_hist(ptm_mgau_t *s)
+{
+    int i;
+
+    if (s->hist == NULL)
+        return;
+    for (i = 0; i < s->n_fast_hist; ++i) {
+        ckd_free_3d(s->hist[i].topn);
+        bitvec_free(s->hist[i].mgau_active);
+    }
+    ckd_free(s->hist);
+}
+
 ps_mgau_t *
 ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
 {
@@ -775,6 +967,7 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     int i;
 
     s = ckd_calloc(1, sizeof(*s));
+    s->base.refcount = 1;
     s->config = acmod->config;
 
     s->lmath = logmath_retain(acmod->lmath);
@@ -790,11 +983,16 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     }
 
     /* Read means and variances. */
-    if ((s->g = gauden_init(cmd_ln_str_r(s->config, "-mean"),
-                            cmd_ln_str_r(s->config, "-var"),
-                            cmd_ln_float32_r(s->config, "-varfloor"),
-                            s->lmath)) == NULL)
+    if (acmod->image)
+        s->g = gauden_init_image(acmod->image, s->lmath);
+    else
+        s->g = gauden_init(cmd_ln_str_r(s->config, "-mean"),
+                           cmd_ln_str_r(s->config, "-var"),
+                           cmd_ln_float32_r(s->config, "-varfloor"),
+                           s->lmath);
+    if (s->g == NULL)
         goto error_out;
+    s->simd = mgau_simd_init(s->g, cmd_ln_str_r(s->config, "-simd"));
     /* We only support 256 codebooks or less (like 640k or 2GB, this
      * should be enough for anyone) */
     if (s->g->n_mgau > 256) {
@@ -819,7 +1017,12 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
         }
     }
     /* Read mixture weights. */
-    if ((sendump_path = cmd_ln_str_r(s->config, "-sendump"))) {
+    if (acmod->image) {
+        if (read_mixw_image(s, acmod->mdef, acmod->image) < 0) {
+            goto error_out;
+        }
+    }
+    else if ((sendump_path = cmd_ln_str_r(s->config, "-sendump"))) {
         if (read_sendump(s, acmod->mdef, sendump_path) < 0) {
             goto error_out;
         }
@@ -840,33 +1043,8 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     for (i = 0; i < s->n_sen; ++i)
         s->sen2cb[i] = bin_mdef_sen2cimap(acmod->mdef, i);
 
-    /* Allocate fast-match history buffers.  We need enough for the
-     * phoneme lookahead window, plus the current frame, plus one for
-     * good measure? (FIXME: I don't remember why) */
-    s->n_fast_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
-    s->hist = ckd_calloc(s->n_fast_hist, sizeof(*s->hist));
-    /* s->f will be a rotating pointer into s->hist. */
-    s->f = s->hist;
-    for (i = 0; i < s->n_fast_hist; ++i) {
-        int j, k, m;
-        /* Top-N codewords for every codebook and feature. */
-        s->hist[i].topn = ckd_calloc_3d(s->g->n_mgau, s->g->n_feat,
-                                        s->max_topn, sizeof(ptm_topn_t));
-        /* Initialize them to sane (yet arbitrary) defaults. */
-        for (j = 0; j < s->g->n_mgau; ++j) {
-            for (k = 0; k < s->g->n_feat; ++k) {
-                for (m = 0; m < s->max_topn; ++m) {
-                    s->hist[i].topn[j][k][m].cw = m;
-                    s->hist[i].topn[j][k][m].score = WORST_DIST;
-                }
-            }
-        }
-        /* Active codebook mapping (just codebook, not features,
-           at least not yet) */
-        s->hist[i].mgau_active = bitvec_alloc(s->g->n_mgau);
-        /* Start with them all on, prune them later. */
-        bitvec_set_all(s->hist[i].mgau_active, s->g->n_mgau);
-    }
+    /* Allocate fast-match history buffers. */
+    init_fast_hist(s);
 
     ps = (ps_mgau_t *)s;
     ps->vt = &ptm_mgau_funcs;
@@ -881,7 +1059,31 @@ ptm_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
-    return gauden_mllr_transform(s->g, mllr, s->config);
+    int rv;
+
+    rv = gauden_mllr_transform(s->g, mllr, s->config);
+    mgau_simd_reload(s->simd, s->g);
+    return rv;
+}
+
+ps_mgau_t *
+ptm_mgau_copy(ps_mgau_t *ps)
+{
+    ptm_mgau_t *other = (ptm_mgau_t *)ps;
+    ptm_mgau_t *s;
+
+    /* Always share the parameters of the original model. */
+    if (ps->shared)
+        return ptm_mgau_copy(ps->shared);
+
+    s = ckd_calloc(1, sizeof(*s));
+    *s = *other;
+    s->base.frame_idx = 0;
+    s->base.refcount = 1;
+    s->base.shared = ps_mgau_retain(ps);
+    init_fast_hist(s);
+
+    return ps_mgau_base(s);
 }
 
 void
@@ -889,16 +1091,30 @@ ptm_mgau_free(ps_mgau_t *ps)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
 
+    if (--ps->refcount > 0)
+        return;
+    free_fast_hist(s);
+    if (ps->shared) {
+        ps_mgau_free(ps->shared);
+        ckd_free(s);
+        return;
+    }
+
     logmath_free(s->lmath);
     logmath_free(s->lmath_8b);
     if (s->sendump_mmap) {
         ckd_free_2d(s->mixw); 
         mmio_file_unmap(s->sendump_mmap);
     }
+    else if (s->image) {
+        ckd_free_2d(s->mixw);
+        acmod_image_free(s->image);
+    }
     else {
         ckd_free_3d(s->mixw);
     }
     ckd_free(s->sen2cb);
+    mgau_simd_free(s->simd);
     gauden_free(s->g);
     ckd_free(s);
 }
@@ -52,6 +52,7 @@
 #include "hmm.h"
 #include "bin_mdef.h"
 #include "ms_gauden.h"
+#include "tied_mgau_simd.h"
 
 typedef struct ptm_mgau_s ptm_mgau_t;
 
@@ -69,10 +70,12 @@ struct ptm_mgau_s {
     ps_mgau_t base;     /**< base structure. */
     cmd_ln_t *config;   /**< Configuration parameters */
     gauden_t *g;        /**< Set of Gaussians. */
+    mgau_simd_t *simd;  /**< Transposed Gaussians for vector code (or NULL). */
     int32 n_sen;       /**< Number of senones. */
     uint8 *sen2cb;     /**< Senone to codebook mapping. */
     uint8 ***mixw;     /**< Mixture weight distributions by feature, codeword, senone */
     mmio_file_t *sendump_mmap;/* Memory map for mixw (or NULL if not mmap) */
+    acmod_image_t *image;     /* Model image mixw points into (or NULL) */
     uint8 *mixw_cb;    /* Mixture weight codebook, if any (assume it contains 16 values) */
     int16 max_topn;
     int16 ds_ratio;
@@ -98,6 +101,9 @@ int ptm_mgau_frame_eval(ps_mgau_t *s,
                         int32 compallsen);
 int ptm_mgau_mllr_transform(ps_mgau_t *s,
                             ps_mllr_t *mllr);
+int ptm_mgau_write_image(ps_mgau_t *s,
+                         acmod_image_writer_t *w);
+ps_mgau_t *ptm_mgau_copy(ps_mgau_t *s);
 
 
 #endif /*  __PTM_MGAU_H__ */
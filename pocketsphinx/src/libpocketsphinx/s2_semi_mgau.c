@@ -64,7 +64,10 @@ static ps_mgaufuncs_t s2_semi_mgau_funcs = {
     "s2_semi",
     s2_semi_mgau_frame_eval,      /* frame_eval */
     s2_semi_mgau_mllr_transform,  /* transform */
-    s2_semi_mgau_free             /* free */
+    s2_semi_mgau_free,            /* free */
+    s2_semi_mgau_write_image,     /* write_image */
+    s2_semi_mgau_copy,            /* copy */
+    NULL                          /* frame_eval_batch */
 };
 
 struct vqFeature_s {
@@ -168,6 +171,63 @@ eval_cb(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
     }
 }
 
+/**
+ * Equivalent to eval_cb(), but scores MGAU_SIMD_BLOCK codewords at a
+ * time with a vector kernel over the transposed codebook.
+ */
+static void
+eval_cb_simd(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
+{
+    vqFeature_t *worst, *best, *topn;
+    mgau_simd_t *simd;
+    mfcc_t const *mean, *var, *det;
+    mfcc_t dist[MGAU_SIMD_BLOCK], prev[MGAU_SIMD_BLOCK];
+    int32 i, cw0, ceplen;
+
+    simd = s->simd;
+    best = topn = s->f[feat];
+    worst = topn + (s->max_topn - 1);
+    mean = simd->mean[0][feat];
+    var = simd->var[0][feat];
+    det = simd->det[0][feat];
+    ceplen = s->g->featlen[feat];
+
+    for (cw0 = 0; cw0 < s->g->n_density; cw0 += MGAU_SIMD_BLOCK) {
+        int32 k, n;
+
+        if (!(*simd->eval_block)(dist, prev, z, mean + cw0, var + cw0,
+                                 det + cw0, simd->stride, ceplen,
+                                 (mfcc_t) worst->score))
+            continue;
+        n = MIN(MGAU_SIMD_BLOCK, s->g->n_density - cw0);
+        for (k = 0; k < n; ++k) {
+            vqFeature_t *cur;
+            mfcc_t d = dist[k];
+            int32 cw = cw0 + k;
+
+            /* The same tests as eval_cb(): the last one inside its
+             * loop, which is made before the last dimension and
+             * covers early termination since scores only decrease,
+             * then the integer part of the final score. */
+            if (!(prev[k] >= worst->score) || (int32)d < worst->score)
+                continue;
+            for (i = 0; i < s->max_topn; i++) {
+                /* already there, so don't need to insert */
+                if (topn[i].codeword == cw)
+                    break;
+            }
+            if (i < s->max_topn)
+                continue;       /* already there.  Don't insert */
+            /* remaining code inserts codeword and dist in correct spot */
+            for (cur = worst - 1; cur >= best && (int32)d >= cur->score; --cur)
+                memcpy(cur + 1, cur, sizeof(vqFeature_t));
+            ++cur;
+            cur->codeword = cw;
+            cur->score = (int32)d;
+        }
+    }
+}
+
 static void
 mgau_dist(s2_semi_mgau_t * s, int32 frame, int32 feat, mfcc_t * z)
 {
@@ -178,7 +238,10 @@ mgau_dist(s2_semi_mgau_t * s, int32 frame, int32 feat, mfcc_t * z)
         return;
 
     /* Evaluate the rest of the codebook (or subset thereof). */
-    eval_cb(s, feat, z);
+    if (s->simd)
+        eval_cb_simd(s, feat, z);
+    else
+        eval_cb(s, feat, z);
 }
 
 static int
@@ -861,6 +924,7 @@ s2_semi_mgau_frame_eval(ps_mgau_t *ps,
             memcpy(s->f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
             mgau_dist(s, frame, i, featbuf[i]);
             s->topn_hist_n[topn_idx][i] = mgau_norm(s, i);
+            ++ps_mgau_base(ps)->n_codebook_eval;
         }
         if (s->mixw_cb) {
             if (compallsen)
@@ -1193,6 +1257,91 @@ read_mixw(s2_semi_mgau_t * s, char const *file_name, double SmoothMin)
     return n_sen;
 }
 
+static int32
+read_mixw_image(s2_semi_mgau_t *s, bin_mdef_t *mdef, acmod_image_t *img)
+{
+    char const *data;
+    int32 const *hdr;
+    size_t len, pos, step;
+    int n_feat, n_density, n_bits, n, i;
+
+    if ((data = acmod_image_section(img, "mixw", &len)) == NULL
+        || len < 4 * sizeof(int32) + 16) {
+        E_ERROR("Acoustic model image has no quantized mixture weights\n");
+        return -1;
+    }
+    hdr = (int32 const *)data;
+    n_feat = hdr[0];
+    n_density = hdr[1];
+    s->n_sen = hdr[2];
+    n_bits = hdr[3];
+    if (n_feat != s->g->n_feat || n_density != s->g->n_density) {
+        E_ERROR("Mixture weights in image don't match codebooks\n");
+        return -1;
+    }
+    if (s->n_sen != bin_mdef_n_sen(mdef)) {
+        E_ERROR("Number of senones in image (%d) doesn't match mdef (%d)\n",
+                s->n_sen, bin_mdef_n_sen(mdef));
+        return -1;
+    }
+    step = (n_bits == 4) ? (s->n_sen + 1) / 2 : s->n_sen;
+    pos = ACMOD_IMAGE_ALIGN(4 * sizeof(int32) + 16);
+    if (pos + (size_t)n_feat * n_density * step > len) {
+        E_ERROR("Mixture weights in acoustic model image are truncated\n");
+        return -1;
+    }
+
+    /* Set up pointers like we do for a memory-mapped sendump. */
+    s->image = acmod_image_retain(img);
+    if (n_bits == 4)
+        s->mixw_cb = (uint8 *)(data + 4 * sizeof(int32));
+    s->mixw = ckd_calloc_2d(n_feat, n_density, sizeof(*s->mixw));
+    for (n = 0; n < n_feat; n++) {
+        for (i = 0; i < n_density; i++) {
+            s->mixw[n][i] = (uint8 *)(data + pos);
+            pos += step;
+        }
+    }
+    E_INFO("Using %d-bit mixture weights for %d senones from image\n",
+           n_bits, s->n_sen);
+    return 0;
+}
+
+int
+s2_semi_mgau_write_image(ps_mgau_t *ps, acmod_image_writer_t *w)
+{
+    s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
+    FILE *fh;
+    uint8 cb[16];
+    int32 val;
+    int n, i, step;
+
+    if (gauden_write_image(s->g, w) < 0)
+        return -1;
+    if ((fh = acmod_image_writer_section(w, "mixw")) == NULL)
+        return -1;
+    val = s->g->n_feat;
+    fwrite(&val, sizeof(val), 1, fh);
+    val = s->g->n_density;
+    fwrite(&val, sizeof(val), 1, fh);
+    val = s->n_sen;
+    fwrite(&val, sizeof(val), 1, fh);
+    /* Clustered weights are packed two to a byte. */
+    val = s->mixw_cb ? 4 : 8;
+    fwrite(&val, sizeof(val), 1, fh);
+    memset(cb, 0, sizeof(cb));
+    if (s->mixw_cb)
+        memcpy(cb, s->mixw_cb, sizeof(cb));
+    fwrite(cb, 1, sizeof(cb), fh);
+    acmod_image_writer_align(w);
+    step = s->mixw_cb ? (s->n_sen + 1) / 2 : s->n_sen;
+    for (n = 0; n < s->g->n_feat; n++)
+        for (i = 0; i < s->g->n_density; i++)
+            fwrite(s->mixw[n][i], 1, step, fh);
+
+    return ferror(fh) ? -1 : 0;
+}
+
 
 static int
 split_topn(char const *str, uint8 *out, int nfeat)
@@ -1224,6 +1373,30 @@ split_topn(char const *str, uint8 *out, int nfeat)
 }
 
 
+static void
+init_topn_hist(s2_semi_mgau_t *s)
+{
+    int i, n_feat = s->g->n_feat;
+
+    s->n_topn_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
+    s->topn_hist = (vqFeature_t ***)
+        ckd_calloc_3d(s->n_topn_hist, n_feat, s->max_topn,
+                      sizeof(***s->topn_hist));
+    s->topn_hist_n = ckd_calloc_2d(s->n_topn_hist, n_feat,
+                                   sizeof(**s->topn_hist_n));
+    for (i = 0; i < s->n_topn_hist; ++i) {
+        int j;
+        for (j = 0; j < n_feat; ++j) {
+            int k;
+            for (k = 0; k < s->max_topn; ++k) {
+                s->topn_hist[i][j][k].score = WORST_DIST;
+                s->topn_hist[i][j][k].codeword = k;
+            }
+        }
+    }
+    s->f = NULL;
+}
+
 ps_mgau_t *
 s2_semi_mgau_init(acmod_t *acmod)
 {
@@ -1234,6 +1407,7 @@ s2_semi_mgau_init(acmod_t *acmod)
     int n_feat;
 
     s = ckd_calloc(1, sizeof(*s));
+    s->base.refcount = 1;
     s->config = acmod->config;
 
     s->lmath = logmath_retain(acmod->lmath);
@@ -1249,14 +1423,19 @@ s2_semi_mgau_init(acmod_t *acmod)
     }
 
     /* Read means and variances. */
-    if ((s->g = gauden_init(cmd_ln_str_r(s->config, "-mean"),
-                            cmd_ln_str_r(s->config, "-var"),
-                            cmd_ln_float32_r(s->config, "-varfloor"),
-                            s->lmath)) == NULL)
+    if (acmod->image)
+        s->g = gauden_init_image(acmod->image, s->lmath);
+    else
+        s->g = gauden_init(cmd_ln_str_r(s->config, "-mean"),
+                           cmd_ln_str_r(s->config, "-var"),
+                           cmd_ln_float32_r(s->config, "-varfloor"),
+                           s->lmath);
+    if (s->g == NULL)
         goto error_out;
     /* Currently only a single codebook is supported. */
     if (s->g->n_mgau != 1)
         goto error_out;
+    s->simd = mgau_simd_init(s->g, cmd_ln_str_r(s->config, "-simd"));
 
     n_feat = s->g->n_feat;
 
@@ -1274,7 +1453,12 @@ s2_semi_mgau_init(acmod_t *acmod)
         }
     }
     /* Read mixture weights */
-    if ((sendump_path = cmd_ln_str_r(s->config, "-sendump"))) {
+    if (acmod->image) {
+        if (read_mixw_image(s, acmod->mdef, acmod->image) < 0) {
+            goto error_out;
+        }
+    }
+    else if ((sendump_path = cmd_ln_str_r(s->config, "-sendump"))) {
         if (read_sendump(s, acmod->mdef, sendump_path) < 0) {
             goto error_out;
         }
@@ -1299,22 +1483,7 @@ s2_semi_mgau_init(acmod_t *acmod)
     E_INFOCONT("\n");
 
     /* Top-N scores from recent frames */
-    s->n_topn_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
-    s->topn_hist = (vqFeature_t ***)
-        ckd_calloc_3d(s->n_topn_hist, n_feat, s->max_topn,
-                      sizeof(***s->topn_hist));
-    s->topn_hist_n = ckd_calloc_2d(s->n_topn_hist, n_feat,
-                                   sizeof(**s->topn_hist_n));
-    for (i = 0; i < s->n_topn_hist; ++i) {
-        int j;
-        for (j = 0; j < n_feat; ++j) {
-            int k;
-            for (k = 0; k < s->max_topn; ++k) {
-                s->topn_hist[i][j][k].score = WORST_DIST;
-                s->topn_hist[i][j][k].codeword = k;
-            }
-        }
-    }
+    init_topn_hist(s);
 
     ps = (ps_mgau_t *)s;
     ps->vt = &s2_semi_mgau_funcs;
@@ -1329,7 +1498,34 @@ s2_semi_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
-    return gauden_mllr_transform(s->g, mllr, s->config);
+    int rv;
+
+    rv = gauden_mllr_transform(s->g, mllr, s->config);
+    mgau_simd_reload(s->simd, s->g);
+    return rv;
+}
+
+ps_mgau_t *
+s2_semi_mgau_copy(ps_mgau_t *ps)
+{
+    s2_semi_mgau_t *other = (s2_semi_mgau_t *)ps;
+    s2_semi_mgau_t *s;
+
+    /* Always share the parameters of the original model. */
+    if (ps->shared)
+        return s2_semi_mgau_copy(ps->shared);
+
+    s = ckd_calloc(1, sizeof(*s));
+    *s = *other;
+    s->base.frame_idx = 0;
+    s->base.refcount = 1;
+    s->base.shared = ps_mgau_retain(ps);
+    s->topn_beam = ckd_calloc(s->g->n_feat, sizeof(*s->topn_beam));
+    memcpy(s->topn_beam, other->topn_beam,
+           s->g->n_feat * sizeof(*s->topn_beam));
+    init_topn_hist(s);
+
+    return ps_mgau_base(s);
 }
 
 void
@@ -1337,20 +1533,33 @@ s2_semi_mgau_free(ps_mgau_t *ps)
 {
     s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
 
+    if (--ps->refcount > 0)
+        return;
+    ckd_free(s->topn_beam);
+    ckd_free_2d(s->topn_hist_n);
+    ckd_free_3d((void **)s->topn_hist);
+    if (ps->shared) {
+        ps_mgau_free(ps->shared);
+        ckd_free(s);
+        return;
+    }
+
     logmath_free(s->lmath);
     logmath_free(s->lmath_8b);
     if (s->sendump_mmap) {
         ckd_free_2d(s->mixw); 
         mmio_file_unmap(s->sendump_mmap);
     }
+    else if (s->image) {
+        ckd_free_2d(s->mixw);
+        acmod_image_free(s->image);
+    }
     else {
         ckd_free_3d(s->mixw);
         if (s->mixw_cb)
             ckd_free(s->mixw_cb);
     }
+    mgau_simd_free(s->simd);
     gauden_free(s->g);
-    ckd_free(s->topn_beam);
-    ckd_free_2d(s->topn_hist_n);
-    ckd_free_3d((void **)s->topn_hist);
     ckd_free(s);
 }
@@ -52,6 +52,7 @@
 #include "hmm.h"
 #include "bin_mdef.h"
 #include "ms_gauden.h"
+#include "tied_mgau_simd.h"
 
 typedef struct vqFeature_s vqFeature_t;
 
@@ -61,9 +62,11 @@ struct s2_semi_mgau_s {
     cmd_ln_t *config;   /* configuration parameters */
 
     gauden_t *g;        /* Set of Gaussians (pointers below point in here and will go away soon) */
+    mgau_simd_t *simd;  /* Transposed Gaussians for vector code (or NULL) */
 
     uint8 ***mixw;     /* mixture weight distributions */
     mmio_file_t *sendump_mmap;/* memory map for mixw (or NULL if not mmap) */
+    acmod_image_t *image;     /* model image mixw points into (or NULL) */
 
     uint8 *mixw_cb;    /* mixture weight codebook, if any (assume it contains 16 values) */
     int32 n_sen;	/* Number of senones */
@@ -93,6 +96,9 @@ int s2_semi_mgau_frame_eval(ps_mgau_t *s,
                             int32 compallsen);
 int s2_semi_mgau_mllr_transform(ps_mgau_t *s,
                                 ps_mllr_t *mllr);
+int s2_semi_mgau_write_image(ps_mgau_t *s,
+                             acmod_image_writer_t *w);
+ps_mgau_t *s2_semi_mgau_copy(ps_mgau_t *s);
 
 
 #endif /*  __S2_SEMI_MGAU_H__ */
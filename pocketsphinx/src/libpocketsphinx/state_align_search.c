@@ -274,6 +274,8 @@ static ps_searchfuncs_t state_align_search_funcs = {
     /* hyp: */      NULL,
     /* prob: */     NULL,
     /* seg_iter: */ NULL,
+    /* stats: */    NULL,
+    /* sen_active: */ NULL,
 };
 
 ps_search_t *
@@ -0,0 +1,437 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file tied_mgau_simd.c
+ * @brief Vectorized codebook evaluation for SC and PTM (tied-state) models.
+ */
+
+/* System headers */
+#include <string.h>
+#include <float.h>
+
+/* SphinxBase headers */
+#include <sphinx_config.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+/* Local headers */
+#include "tied_mgau_common.h"
+#include "tied_mgau_simd.h"
+
+/*
+ * Kernels are only built for floating point.  The fixed-point
+ * arithmetic in GMMSUB() saturates, which has no cheap vector
+ * equivalent, and fixed-point builds are mostly for targets without
+ * any of these instruction sets anyway.
+ *
+ * On x86 every kernel is compiled with a function-specific target
+ * so the rest of the library does not require the instruction set,
+ * and the CPU is checked at run time.  ARMv7 NEON flushes denormals
+ * to zero, so it is not bit-exact with the scalar code; we only use
+ * NEON on AArch64 where it is IEEE compliant.
+ */
+#ifndef FIXED_POINT
+#if (defined(__x86_64__) || defined(__i386__))                          \
+    && (defined(__clang__)                                              \
+        || (defined(__GNUC__)                                           \
+            && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define MGAU_SIMD_X86
+#include <immintrin.h>
+#define MGAU_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define MGAU_SIMD_ARM
+#include <arm_neon.h>
+#endif
+#endif /* !FIXED_POINT */
+
+/* Alignment of transposed codebooks, enough for AVX. */
+#define MGAU_SIMD_ALIGN 32
+
+/* Determinant for padding codewords. */
+#ifdef FIXED_POINT
+#define MGAU_SIMD_PAD_DET ((mfcc_t)WORST_DIST)
+#else
+#define MGAU_SIMD_PAD_DET (-FLT_MAX)
+#endif
+
+#ifdef MGAU_SIMD_X86
+MGAU_SIMD_TARGET("sse2")
+static int
+eval_block_sse2(mfcc_t *out, mfcc_t *prev, mfcc_t const *z,
+                mfcc_t const *mean, mfcc_t const *var,
+                mfcc_t const *det, int32 stride,
+                int32 ceplen, mfcc_t thresh)
+{
+    __m128 d0, d1, d2, d3, t;
+    int32 j;
+
+    d0 = _mm_load_ps(det);
+    d1 = _mm_load_ps(det + 4);
+    d2 = _mm_load_ps(det + 8);
+    d3 = _mm_load_ps(det + 12);
+    t = _mm_set1_ps(thresh);
+    for (j = 0; j < ceplen; ++j) {
+        __m128 obs, diff;
+
+        if (j == ceplen - 1 && prev) {
+            _mm_storeu_ps(prev, d0);
+            _mm_storeu_ps(prev + 4, d1);
+            _mm_storeu_ps(prev + 8, d2);
+            _mm_storeu_ps(prev + 12, d3);
+        }
+        /* Same operations in the same order as COMPUTE_GMM_MAP() and
+         * COMPUTE_GMM_REDUCE() - no fused multiply-add here. */
+        obs = _mm_set1_ps(z[j]);
+        diff = _mm_sub_ps(obs, _mm_load_ps(mean));
+        d0 = _mm_sub_ps(d0, _mm_mul_ps(_mm_mul_ps(diff, diff),
+                                       _mm_load_ps(var)));
+        diff = _mm_sub_ps(obs, _mm_load_ps(mean + 4));
+        d1 = _mm_sub_ps(d1, _mm_mul_ps(_mm_mul_ps(diff, diff),
+                                       _mm_load_ps(var + 4)));
+        diff = _mm_sub_ps(obs, _mm_load_ps(mean + 8));
+        d2 = _mm_sub_ps(d2, _mm_mul_ps(_mm_mul_ps(diff, diff),
+                                       _mm_load_ps(var + 8)));
+        diff = _mm_sub_ps(obs, _mm_load_ps(mean + 12));
+        d3 = _mm_sub_ps(d3, _mm_mul_ps(_mm_mul_ps(diff, diff),
+                                       _mm_load_ps(var + 12)));
+        mean += stride;
+        var += stride;
+        /* Scores only decrease, so once the whole block is below the
+         * threshold none of it can make the top-N.  The score after
+         * the last dimension is left to the caller, since eval_cb()
+         * in s2_semi_mgau.c only compares its integer part. */
+        if ((j & 3) == 3 && j < ceplen - 1) {
+            __m128 alive = _mm_or_ps(_mm_or_ps(_mm_cmpge_ps(d0, t),
+                                               _mm_cmpge_ps(d1, t)),
+                                     _mm_or_ps(_mm_cmpge_ps(d2, t),
+                                               _mm_cmpge_ps(d3, t)));
+            if (_mm_movemask_ps(alive) == 0)
+                return 0;
+        }
+    }
+    _mm_storeu_ps(out, d0);
+    _mm_storeu_ps(out + 4, d1);
+    _mm_storeu_ps(out + 8, d2);
+    _mm_storeu_ps(out + 12, d3);
+    return 1;
+}
+
+MGAU_SIMD_TARGET("avx2")
+static int
+eval_block_avx2(mfcc_t *out, mfcc_t *prev, mfcc_t const *z,
+                mfcc_t const *mean, mfcc_t const *var,
+                mfcc_t const *det, int32 stride,
+                int32 ceplen, mfcc_t thresh)
+{
+    __m256 d0, d1, t;
+    int32 j;
+
+    d0 = _mm256_load_ps(det);
+    d1 = _mm256_load_ps(det + 8);
+    t = _mm256_set1_ps(thresh);
+    for (j = 0; j < ceplen; ++j) {
+        __m256 obs, diff;
+
+        if (j == ceplen - 1 && prev) {
+            _mm256_storeu_ps(prev, d0);
+            _mm256_storeu_ps(prev + 8, d1);
+        }
+        obs = _mm256_set1_ps(z[j]);
+        diff = _mm256_sub_ps(obs, _mm256_load_ps(mean));
+        d0 = _mm256_sub_ps(d0, _mm256_mul_ps(_mm256_mul_ps(diff, diff),
+                                             _mm256_load_ps(var)));
+        diff = _mm256_sub_ps(obs, _mm256_load_ps(mean + 8));
+        d1 = _mm256_sub_ps(d1, _mm256_mul_ps(_mm256_mul_ps(diff, diff),
+                                             _mm256_load_ps(var + 8)));
+        mean += stride;
+        var += stride;
+        if ((j & 3) == 3 && j < ceplen - 1) {
+            __m256 alive = _mm256_or_ps(_mm256_cmp_ps(d0, t, _CMP_GE_OQ),
+                                        _mm256_cmp_ps(d1, t, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(alive) == 0)
+                return 0;
+        }
+    }
+    _mm256_storeu_ps(out, d0);
+    _mm256_storeu_ps(out + 8, d1);
+    return 1;
+}
+
+static int
+cpu_has(mgau_simd_type_t type)
+{
+    __builtin_cpu_init();
+    switch (type) {
+    case MGAU_SIMD_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case MGAU_SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+    default:
+        return FALSE;
+    }
+}
+#endif /* MGAU_SIMD_X86 */
+
+#ifdef MGAU_SIMD_ARM
+static int
+eval_block_neon(mfcc_t *out, mfcc_t *prev, mfcc_t const *z,
+                mfcc_t const *mean, mfcc_t const *var,
+                mfcc_t const *det, int32 stride,
+                int32 ceplen, mfcc_t thresh)
+{
+    float32x4_t d0, d1, d2, d3, t;
+    int32 j;
+
+    d0 = vld1q_f32(det);
+    d1 = vld1q_f32(det + 4);
+    d2 = vld1q_f32(det + 8);
+    d3 = vld1q_f32(det + 12);
+    t = vdupq_n_f32(thresh);
+    for (j = 0; j < ceplen; ++j) {
+        float32x4_t obs, diff;
+
+        if (j == ceplen - 1 && prev) {
+            vst1q_f32(prev, d0);
+            vst1q_f32(prev + 4, d1);
+            vst1q_f32(prev + 8, d2);
+            vst1q_f32(prev + 12, d3);
+        }
+        obs = vdupq_n_f32(z[j]);
+        diff = vsubq_f32(obs, vld1q_f32(mean));
+        d0 = vsubq_f32(d0, vmulq_f32(vmulq_f32(diff, diff),
+                                     vld1q_f32(var)));
+        diff = vsubq_f32(obs, vld1q_f32(mean + 4));
+        d1 = vsubq_f32(d1, vmulq_f32(vmulq_f32(diff, diff),
+                                     vld1q_f32(var + 4)));
+        diff = vsubq_f32(obs, vld1q_f32(mean + 8));
+        d2 = vsubq_f32(d2, vmulq_f32(vmulq_f32(diff, diff),
+                                     vld1q_f32(var + 8)));
+        diff = vsubq_f32(obs, vld1q_f32(mean + 12));
+        d3 = vsubq_f32(d3, vmulq_f32(vmulq_f32(diff, diff),
+                                     vld1q_f32(var + 12)));
+        mean += stride;
+        var += stride;
+        if ((j & 3) == 3 && j < ceplen - 1) {
+            uint32x4_t alive = vorrq_u32(vorrq_u32(vcgeq_f32(d0, t),
+                                                   vcgeq_f32(d1, t)),
+                                         vorrq_u32(vcgeq_f32(d2, t),
+                                                   vcgeq_f32(d3, t)));
+            if (vmaxvq_u32(alive) == 0)
+                return 0;
+        }
+    }
+    vst1q_f32(out, d0);
+    vst1q_f32(out + 4, d1);
+    vst1q_f32(out + 8, d2);
+    vst1q_f32(out + 12, d3);
+    return 1;
+}
+#endif /* MGAU_SIMD_ARM */
+
+static const char *mgau_simd_names[] = {
+    "none", "sse2", "avx2", "neon"
+};
+
+int
+mgau_simd_parse(char const *name)
+{
+    int i;
+
+    for (i = 0; i < sizeof(mgau_simd_names) / sizeof(mgau_simd_names[0]); ++i)
+        if (0 == strcmp(name, mgau_simd_names[i]))
+            return i;
+    return -1;
+}
+
+char const *
+mgau_simd_name(mgau_simd_type_t type)
+{
+    return mgau_simd_names[type];
+}
+
+int
+mgau_simd_supported(mgau_simd_type_t type)
+{
+    switch (type) {
+    case MGAU_SIMD_NONE:
+        return TRUE;
+#ifdef MGAU_SIMD_X86
+    case MGAU_SIMD_SSE2:
+    case MGAU_SIMD_AVX2:
+        return cpu_has(type);
+#endif
+#ifdef MGAU_SIMD_ARM
+    case MGAU_SIMD_NEON:
+        return TRUE;
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+static mgau_simd_block_f
+mgau_simd_kernel(mgau_simd_type_t type)
+{
+    switch (type) {
+#ifdef MGAU_SIMD_X86
+    case MGAU_SIMD_SSE2:
+        return eval_block_sse2;
+    case MGAU_SIMD_AVX2:
+        return eval_block_avx2;
+#endif
+#ifdef MGAU_SIMD_ARM
+    case MGAU_SIMD_NEON:
+        return eval_block_neon;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+mgau_simd_t *
+mgau_simd_init(gauden_t *g, char const *name)
+{
+    mgau_simd_t *simd;
+    mfcc_t *ptr;
+    size_t n_float;
+    int type, i, j;
+
+    if (name == NULL || 0 == strcmp(name, "auto")) {
+        if (mgau_simd_supported(MGAU_SIMD_AVX2))
+            type = MGAU_SIMD_AVX2;
+        else if (mgau_simd_supported(MGAU_SIMD_SSE2))
+            type = MGAU_SIMD_SSE2;
+        else if (mgau_simd_supported(MGAU_SIMD_NEON))
+            type = MGAU_SIMD_NEON;
+        else
+            type = MGAU_SIMD_NONE;
+    }
+    else {
+        if ((type = mgau_simd_parse(name)) < 0) {
+            E_WARN("Unknown SIMD kernel %s, using scalar code\n", name);
+            return NULL;
+        }
+        if (!mgau_simd_supported(type)) {
+            E_WARN("SIMD kernel %s not supported on this machine, "
+                   "using scalar code\n", name);
+            return NULL;
+        }
+    }
+    if (type == MGAU_SIMD_NONE) {
+        E_INFO("Using scalar Gaussian evaluation\n");
+        return NULL;
+    }
+
+    simd = ckd_calloc(1, sizeof(*simd));
+    simd->type = type;
+    simd->eval_block = mgau_simd_kernel(type);
+    simd->n_mgau = g->n_mgau;
+    simd->n_feat = g->n_feat;
+    simd->n_density = g->n_density;
+    simd->stride = (g->n_density + MGAU_SIMD_BLOCK - 1)
+        / MGAU_SIMD_BLOCK * MGAU_SIMD_BLOCK;
+
+    /* Every block is a multiple of MGAU_SIMD_BLOCK floats so aligning
+     * the first one aligns them all. */
+    n_float = 0;
+    for (j = 0; j < g->n_feat; ++j)
+        n_float += (2 * g->featlen[j] + 1) * simd->stride;
+    n_float *= g->n_mgau;
+    simd->buf = ckd_calloc(n_float * sizeof(mfcc_t) + MGAU_SIMD_ALIGN, 1);
+    ptr = (mfcc_t *)(((size_t)simd->buf + MGAU_SIMD_ALIGN - 1)
+                     & ~(size_t)(MGAU_SIMD_ALIGN - 1));
+
+    simd->mean = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(mfcc_t *));
+    simd->var = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(mfcc_t *));
+    simd->det = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(mfcc_t *));
+    for (i = 0; i < g->n_mgau; ++i) {
+        for (j = 0; j < g->n_feat; ++j) {
+            simd->mean[i][j] = ptr;
+            ptr += g->featlen[j] * simd->stride;
+            simd->var[i][j] = ptr;
+            ptr += g->featlen[j] * simd->stride;
+            simd->det[i][j] = ptr;
+            ptr += simd->stride;
+        }
+    }
+    mgau_simd_reload(simd, g);
+
+    E_INFO("Using %s Gaussian evaluation (%d codewords per block)\n",
+           mgau_simd_name(type), MGAU_SIMD_BLOCK);
+    return simd;
+}
+
+void
+mgau_simd_reload(mgau_simd_t *simd, gauden_t *g)
+{
+    int i, j, k, d;
+
+    if (simd == NULL)
+        return;
+    for (i = 0; i < simd->n_mgau; ++i) {
+        for (j = 0; j < simd->n_feat; ++j) {
+            int32 ceplen = g->featlen[j];
+
+            for (d = 0; d < simd->n_density; ++d) {
+                for (k = 0; k < ceplen; ++k) {
+                    simd->mean[i][j][k * simd->stride + d]
+                        = g->mean[i][j][d][k];
+                    simd->var[i][j][k * simd->stride + d]
+                        = g->var[i][j][d][k];
+                }
+                simd->det[i][j][d] = g->det[i][j][d];
+            }
+            /* Padding codewords score below any threshold, so they
+             * never keep a block alive. */
+            for (; d < simd->stride; ++d)
+                simd->det[i][j][d] = MGAU_SIMD_PAD_DET;
+        }
+    }
+}
+
+void
+mgau_simd_free(mgau_simd_t *simd)
+{
+    if (simd == NULL)
+        return;
+    ckd_free_2d(simd->mean);
+    ckd_free_2d(simd->var);
+    ckd_free_2d(simd->det);
+    ckd_free(simd->buf);
+    ckd_free(simd);
+}
@@ -0,0 +1,166 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * @file tied_mgau_simd.h
+ * @brief Vectorized codebook evaluation for SC and PTM (tied-state) models.
+ *
+ * The scalar code in ptm_mgau.c and s2_semi_mgau.c walks one
+ * codeword at a time over the codeword-major mean and variance
+ * arrays in gauden_t.  The kernels here instead keep a transposed
+ * (dimension-major) copy of each codebook so that a whole block of
+ * codewords can be scored against one observation with vector
+ * instructions.  Each lane performs exactly the same sequence of
+ * floating point operations as the scalar code, so the top-N
+ * codewords and their scores are bit-identical.
+ *
+ * The kernel is selected at run time from the instruction sets
+ * supported by the CPU, or forced with the <code>-simd</code>
+ * option.  In fixed-point builds only the scalar code is available.
+ */
+
+#ifndef __TIED_MGAU_SIMD_H__
+#define __TIED_MGAU_SIMD_H__
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/fe.h>
+
+/* Local headers. */
+#include "ms_gauden.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of codewords scored by one call to a block kernel.
+ */
+#define MGAU_SIMD_BLOCK 16
+
+/**
+ * Available codebook evaluation kernels.
+ */
+typedef enum mgau_simd_type_e {
+    MGAU_SIMD_NONE,  /**< Scalar code in the caller (no vectorization). */
+    MGAU_SIMD_SSE2,  /**< 4 codewords per instruction. */
+    MGAU_SIMD_AVX2,  /**< 8 codewords per instruction. */
+    MGAU_SIMD_NEON   /**< 4 codewords per instruction. */
+} mgau_simd_type_t;
+
+/**
+ * Score one block of MGAU_SIMD_BLOCK codewords.
+ *
+ * @param out Output: unnormalized log densities for the block.
+ * @param prev Output: the same before the last dimension was added,
+ *             or NULL if not wanted.
+ * @param z Observation vector.
+ * @param mean Transposed means, offset to the first codeword of the block.
+ * @param var Transposed precomputed variances, offset likewise.
+ * @param det Determinants, offset likewise.
+ * @param stride Distance between successive dimensions in mean and var.
+ * @param ceplen Dimensionality of the observation.
+ * @param thresh Pruning threshold.
+ * @return 0 if every codeword in the block fell below thresh before
+ *         the last dimension (in which case out and prev are
+ *         undefined), 1 otherwise.
+ */
+typedef int (*mgau_simd_block_f)(mfcc_t *out, mfcc_t *prev,
+                                 mfcc_t const *z,
+                                 mfcc_t const *mean, mfcc_t const *var,
+                                 mfcc_t const *det, int32 stride,
+                                 int32 ceplen, mfcc_t thresh);
+
+/**
+ * Transposed codebooks and the kernel used to evaluate them.
+ */
+typedef struct mgau_simd_s {
+    mgau_simd_type_t type;   /**< Kernel in use. */
+    mgau_simd_block_f eval_block; /**< Block kernel. */
+    int32 n_mgau;            /**< Number of codebooks. */
+    int32 n_feat;            /**< Number of feature streams. */
+    int32 n_density;         /**< Number of codewords per codebook. */
+    int32 stride;            /**< n_density rounded up to MGAU_SIMD_BLOCK. */
+    mfcc_t ***mean;          /**< mean[codebook][feature] is featlen x stride */
+    mfcc_t ***var;           /**< Precomputed variances, laid out like mean. */
+    mfcc_t ***det;           /**< det[codebook][feature] is padded to stride */
+    void *buf;               /**< Storage for all of the above (unaligned). */
+} mgau_simd_t;
+
+/**
+ * Parse a kernel name as accepted by the <code>-simd</code> option.
+ *
+ * @return kernel type, or -1 if the name is not recognized.
+ */
+int mgau_simd_parse(char const *name);
+
+/**
+ * Get the printable name of a kernel type.
+ */
+char const *mgau_simd_name(mgau_simd_type_t type);
+
+/**
+ * Determine whether a kernel can run on this machine.
+ */
+int mgau_simd_supported(mgau_simd_type_t type);
+
+/**
+ * Create transposed codebooks for a set of Gaussians.
+ *
+ * @param g Gaussians, with variances and determinants precomputed.
+ * @param name Requested kernel, or "auto" to use the best available.
+ * @return Newly allocated object, or NULL if vectorized evaluation is
+ *         disabled or not available (the caller then uses its scalar
+ *         code).
+ */
+mgau_simd_t *mgau_simd_init(gauden_t *g, char const *name);
+
+/**
+ * Refresh transposed codebooks after the Gaussians have changed
+ * (e.g. after MLLR adaptation).
+ */
+void mgau_simd_reload(mgau_simd_t *simd, gauden_t *g);
+
+/**
+ * Release transposed codebooks.
+ */
+void mgau_simd_free(mgau_simd_t *simd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TIED_MGAU_SIMD_H__ */
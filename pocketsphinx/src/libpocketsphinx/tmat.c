@@ -207,6 +207,7 @@ tmat_init(char const *file_name, logmath_t *lmath, float64 tpfloor, int32 brepor
     }
 
     t = (tmat_t *) ckd_calloc(1, sizeof(tmat_t));
+    t->refcount = 1;
 
     if ((fp = fopen(file_name, "rb")) == NULL)
         E_FATAL_SYSTEM("Failed to open transition file '%s' for reading", file_name);
@@ -325,15 +326,75 @@ tmat_report(tmat_t * t)
 
 }
 
+tmat_t *
+tmat_init_image(acmod_image_t *img)
+{
+    tmat_t *t;
+    char const *data;
+    int32 const *hdr;
+    size_t len, n_tp;
+
+    if ((data = acmod_image_section(img, "tmat", &len)) == NULL
+        || len < 2 * sizeof(int32)) {
+        E_ERROR("Acoustic model image has no transition matrices\n");
+        return NULL;
+    }
+    hdr = (int32 const *)data;
+    n_tp = (size_t)hdr[0] * hdr[1] * (hdr[1] + 1);
+    if (2 * sizeof(int32) + n_tp > len) {
+        E_ERROR("Transition matrices in acoustic model image are truncated\n");
+        return NULL;
+    }
+
+    /* These are tiny, so just copy them. */
+    t = (tmat_t *) ckd_calloc(1, sizeof(tmat_t));
+    t->refcount = 1;
+    t->n_tmat = hdr[0];
+    t->n_state = hdr[1];
+    t->tp = ckd_calloc_3d(t->n_tmat, t->n_state, t->n_state + 1,
+                          sizeof(***t->tp));
+    memcpy(t->tp[0][0], data + 2 * sizeof(int32), n_tp);
+
+    return t;
+}
+
+int
+tmat_write_image(tmat_t *t, acmod_image_writer_t *w)
+{
+    FILE *fh;
+    int32 val;
+
+    if ((fh = acmod_image_writer_section(w, "tmat")) == NULL)
+        return -1;
+    val = t->n_tmat;
+    fwrite(&val, sizeof(val), 1, fh);
+    val = t->n_state;
+    fwrite(&val, sizeof(val), 1, fh);
+    fwrite(t->tp[0][0], sizeof(***t->tp),
+           t->n_tmat * t->n_state * (t->n_state + 1), fh);
+
+    return ferror(fh) ? -1 : 0;
+}
+
 /* 
  *  RAH, Free memory allocated in tmat_init ()
  */
-void
+tmat_t *
+tmat_retain(tmat_t * t)
+{
+    ++t->refcount;
+    return t;
+}
+
+int
 tmat_free(tmat_t * t)
 {
-    if (t) {
-        if (t->tp)
-            ckd_free_3d(t->tp);
-        ckd_free(t);
-    }
+    if (t == NULL)
+        return 0;
+    if (--t->refcount > 0)
+        return t->refcount;
+    if (t->tp)
+        ckd_free_3d(t->tp);
+    ckd_free(t);
+    return 0;
 }
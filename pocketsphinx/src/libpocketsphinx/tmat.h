@@ -91,6 +91,9 @@
 /* SphinxBase headers. */
 #include <sphinxbase/logmath.h>
 
+/* Local headers. */
+#include "acmod_image.h"
+
 /** \file tmat.h
  *  \brief Transition matrix data structure.
  */
@@ -109,6 +112,7 @@ typedef struct {
     int16 n_tmat;	/**< Number matrices */
     int16 n_state;	/**< Number source states in matrix (only the emitting states);
 			   Number destination states = n_state+1, it includes the exit state */
+    int refcount;       /**< Reference count. */
 } tmat_t;
 
 
@@ -121,6 +125,16 @@ tmat_t *tmat_init (char const *tmatfile,/**< In: input file */
     );
 					    
 
+/** Initialize transition matrix from an acoustic model image */
+
+tmat_t *tmat_init_image (acmod_image_t *img /**< In: acoustic model image */
+    );
+
+/** Write transition matrix to an acoustic model image */
+
+int tmat_write_image (tmat_t *t,              /**< In: transition matrix */
+                      acmod_image_writer_t *w /**< In: image being written */
+    );
 
 /** Dumping the transition matrix for debugging */
 
@@ -129,11 +143,18 @@ void tmat_dump (tmat_t *tmat,  /**< In: transition matrix */
     );	
 
 
+/**
+ * Retain a pointer to a transition matrix.
+ */
+tmat_t *tmat_retain (tmat_t *t /**< In: transition matrix */
+    );
+
 /**
  * RAH, add code to remove memory allocated by tmat_init
+ * @return new reference count (0 if freed completely)
  */
 
-void tmat_free (tmat_t *t /**< In: transition matrix */
+int tmat_free (tmat_t *t /**< In: transition matrix */
     );
 
 /**
@@ -37,6 +37,9 @@
 
 /* System headers. */
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
 
 /* SphinxBase headers. */
 #include <sphinxbase/pio.h>
@@ -44,6 +47,8 @@
 #include <sphinxbase/strfuncs.h>
 #include <sphinxbase/filename.h>
 #include <sphinxbase/byteorder.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/sbthread.h>
 
 /* PocketSphinx headers. */
 #include <pocketsphinx.h>
@@ -56,6 +61,9 @@
     void setbuf(FILE* file, char* buf){
     }
 #endif
+#if defined(_WIN32) && !defined(__MINGW32__) && !defined(CYGWIN)
+#define vsnprintf _vsnprintf
+#endif
 
 static const arg_t ps_args_def[] = {
     POCKETSPHINX_OPTIONS,
@@ -82,6 +90,14 @@ static const arg_t ps_args_def[] = {
       ARG_INT32,
       "1",
       "Do every Nth line in the control file" },
+    { "-batchsize",
+      ARG_INT32,
+      "1",
+      "No. of utterances to search together, scoring their frames in one pass over the acoustic model" },
+    { "-nworkers",
+      ARG_INT32,
+      "1",
+      "No. of threads decoding utterances in parallel, each with its own decoder (see also -nthreads)" },
     { "-mllrctl",
       ARG_STRING,
       NULL,
@@ -363,12 +379,29 @@ build_outdirs(cmd_ln_t *config, char const *uttid)
     return 0;
 }
 
+/* Build the name of the input file for a control file entry. */
+static char *
+ctl_infile(cmd_ln_t *config, char const *file)
+{
+    char const *cepdir, *cepext;
+
+    cepdir = cmd_ln_str_r(config, "-cepdir");
+    cepext = cmd_ln_str_r(config, "-cepext");
+    return string_join(cepdir ? cepdir : "",
+                       "/", file,
+                       cepext ? cepext : "", NULL);
+}
+
+/*
+ * Decode one utterance, or if no_search is set, start it and compute
+ * its features, leaving it to be searched with ps_search_batch().
+ */
 static int
 process_ctl_line(ps_decoder_t *ps, cmd_ln_t *config,
-                 char const *file, char const *uttid, int32 sf, int32 ef)
+                 char const *file, char const *uttid, int32 sf, int32 ef,
+                 int no_search)
 {
     FILE *infh;
-    char const *cepdir, *cepext;
     char *infile;
 
     if (ef != -1 && ef < sf) {
@@ -376,13 +409,7 @@ process_ctl_line(ps_decoder_t *ps, cmd_ln_t *config,
         return -1;
     }
     
-    cepdir = cmd_ln_str_r(config, "-cepdir");
-    cepext = cmd_ln_str_r(config, "-cepext");
-
-    /* Build input filename. */
-    infile = string_join(cepdir ? cepdir : "",
-                         "/", file,
-                         cepext ? cepext : "", NULL);
+    infile = ctl_infile(config, file);
     if (uttid == NULL) uttid = file;
 
     if ((infh = fopen(infile, "rb")) == NULL) {
@@ -411,7 +438,25 @@ process_ctl_line(ps_decoder_t *ps, cmd_ln_t *config,
                      * (cmd_ln_float32_r(config, "-samprate")
                         / cmd_ln_int32_r(config, "-frate")));
         fseek(infh, cmd_ln_int32_r(config, "-adchdr") + sf * sizeof(int16), SEEK_SET);
-        ps_decode_raw(ps, infh, uttid, ef);
+        if (no_search) {
+            int16 *data;
+            long pos, total;
+
+            if (ef == -1) {
+                pos = ftell(infh);
+                fseek(infh, 0, SEEK_END);
+                ef = (ftell(infh) - pos) / sizeof(*data);
+                fseek(infh, pos, SEEK_SET);
+            }
+            data = ckd_calloc(ef, sizeof(*data));
+            total = fread(data, sizeof(*data), ef, infh);
+            ps_start_stream(ps);
+            ps_start_utt(ps, uttid);
+            ps_process_raw(ps, data, total, TRUE, TRUE);
+            ckd_free(data);
+        }
+        else
+            ps_decode_raw(ps, infh, uttid, ef);
     }
     else {
         mfcc_t **mfcs;
@@ -426,8 +471,9 @@ process_ctl_line(ps_decoder_t *ps, cmd_ln_t *config,
         }
         ps_start_stream(ps);
         ps_start_utt(ps, uttid);
-        ps_process_cep(ps, mfcs, nfr, FALSE, TRUE);
-        ps_end_utt(ps);
+        ps_process_cep(ps, mfcs, nfr, no_search, TRUE);
+        if (!no_search)
+            ps_end_utt(ps);
         ckd_free_2d(mfcs);
     }
     fclose(infh);
@@ -501,8 +547,42 @@ write_nbest(ps_decoder_t *ps, char const *nbestdir, char const *uttid)
     return 0;
 }
 
+/* Growable buffer for output which is written later. */
+typedef struct outbuf_s {
+    char *buf;
+    size_t len, alloc;
+} outbuf_t;
+
+static void
+outbuf_printf(outbuf_t *ob, char const *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    for (;;) {
+        va_start(args, fmt);
+        n = vsnprintf(ob->buf + ob->len, ob->alloc - ob->len, fmt, args);
+        va_end(args);
+        if (n >= 0 && ob->len + n < ob->alloc)
+            break;
+        ob->alloc = ob->alloc * 2 + (n > 0 ? n : 0) + 128;
+        ob->buf = ckd_realloc(ob->buf, ob->alloc);
+    }
+    ob->len += n;
+}
+
+/* Write out and release the contents of a buffer. */
+static void
+outbuf_flush(outbuf_t *ob, FILE *fh)
+{
+    if (fh && ob->len)
+        fwrite(ob->buf, 1, ob->len, fh);
+    ckd_free(ob->buf);
+    memset(ob, 0, sizeof(*ob));
+}
+
 static int
-write_hypseg(FILE *fh, ps_decoder_t *ps, char const *uttid)
+write_hypseg(outbuf_t *ob, ps_decoder_t *ps, char const *uttid)
 {
     int32 score, lscr, sf, ef;
     ps_seg_t *itor = ps_seg_iter(ps, &score);
@@ -515,9 +595,9 @@ write_hypseg(FILE *fh, ps_decoder_t *ps, char const *uttid)
         lscr += wlscr;
         itor = ps_seg_next(itor);
     }
-    fprintf(fh, "%s S %d T %d A %d L %d", uttid,
-            0, /* "scaling factor" which is mostly useless anyway */
-            score, score - lscr, lscr);
+    outbuf_printf(ob, "%s S %d T %d A %d L %d", uttid,
+                  0, /* "scaling factor" which is mostly useless anyway */
+                  score, score - lscr, lscr);
     /* Now print out words. */
     itor = ps_seg_iter(ps, &score);
     while (itor) {
@@ -526,16 +606,16 @@ write_hypseg(FILE *fh, ps_decoder_t *ps, char const *uttid)
 
         ps_seg_prob(itor, &ascr, &wlscr, NULL);
         ps_seg_frames(itor, &sf, &ef);
-        fprintf(fh, " %d %d %d %s", sf, ascr, wlscr, w);
+        outbuf_printf(ob, " %d %d %d %s", sf, ascr, wlscr, w);
         itor = ps_seg_next(itor);
     }
-    fprintf(fh, " %d\n", ef);
+    outbuf_printf(ob, " %d\n", ef);
 
     return 0;
 }
 
 static int
-write_ctm(FILE *fh, ps_decoder_t *ps, ps_seg_t *itor, char const *uttid, int32 frate)
+write_ctm(outbuf_t *ob, ps_decoder_t *ps, ps_seg_t *itor, char const *uttid, int32 frate)
 {
     logmath_t *lmath = ps_get_logmath(ps);
     char *dupid, *show, *channel, *c;
@@ -572,14 +652,14 @@ write_ctm(FILE *fh, ps_decoder_t *ps, ps_seg_t *itor, char const *uttid, int32 f
             prob = ps_seg_prob(itor, NULL, NULL, NULL);
             ps_seg_frames(itor, &sf, &ef);
         
-            fprintf(fh, "%s %s %.2f %.2f %s %.3f\n",
-                    show,
-                    channel ? channel : "1",
-                    ustart + (double)sf / frate,
-                    (double)(ef - sf) / frate,
-                    /* FIXME: More s3kr3tz */
-                    dict_basestr(ps->dict, wid),
-                    logmath_exp(lmath, prob));
+            outbuf_printf(ob, "%s %s %.2f %.2f %s %.3f\n",
+                          show,
+                          channel ? channel : "1",
+                          ustart + (double)sf / frate,
+                          (double)(ef - sf) / frate,
+                          /* FIXME: More s3kr3tz */
+                          dict_basestr(ps->dict, wid),
+                          logmath_exp(lmath, prob));
         }
         itor = ps_seg_next(itor);
     }
@@ -588,27 +668,101 @@ write_ctm(FILE *fh, ps_decoder_t *ps, ps_seg_t *itor, char const *uttid, int32 f
     return 0;
 }
 
+/* Output files for process_ctl(). */
+typedef struct output_s {
+    FILE *hypfh, *hypsegfh, *ctmfh;
+    char const *outlatdir;
+    char const *nbestdir;
+    int frate;
+} output_t;
+
+/* One utterance from the control file. */
+typedef struct ctl_job_s {
+    char *line;         /**< Control file line (file and uttid point here). */
+    char *mllrline, *lmline, *fsgline; /**< Lines from other control files. */
+    char *file, *uttid;
+    char *mllrfile, *lmname, *fsgfile;
+    int32 sf, ef;
+    long size;          /**< Estimated length, for ordering. */
+    int done;           /**< Decoded (or failed), output can be written. */
+    outbuf_t hyp, hypseg, ctm; /**< Output to be written in order. */
+} ctl_job_t;
+
+/* Work shared by all the decoding threads. */
+typedef struct ctl_s {
+    cmd_ln_t *config;
+    output_t out;
+    ctl_job_t *jobs;    /**< Utterances in control file order. */
+    int n_jobs;
+    ctl_job_t **order;  /**< Utterances in the order they are started. */
+    int next;           /**< Next entry in order to start. */
+    int next_out;       /**< Next job whose output is to be written. */
+    sbmtx_t *mtx;       /**< Lock for next, next_out and done flags. */
+} ctl_t;
+
+/* A decoding thread and its statistics. */
+typedef struct worker_s {
+    ctl_t *ctl;
+    ps_decoder_t **decoders; /**< One per utterance in a batch. */
+    int n_decoders;
+    int n_utt;          /**< Utterances decoded. */
+    double n_speech;    /**< Seconds of speech decoded. */
+    ptmr_t busy;        /**< Time spent decoding. */
+} worker_t;
+
 static void
-process_ctl(ps_decoder_t *ps, cmd_ln_t *config, FILE *ctlfh)
+ctl_job_free(ctl_job_t *job)
+{
+    ckd_free(job->line);
+    ckd_free(job->mllrline);
+    ckd_free(job->lmline);
+    ckd_free(job->fsgline);
+    ckd_free(job->hyp.buf);
+    ckd_free(job->hypseg.buf);
+    ckd_free(job->ctm.buf);
+}
+
+/* Estimate the length of an utterance in frames from its input file. */
+static long
+ctl_job_size(cmd_ln_t *config, ctl_job_t *job)
+{
+    struct stat st;
+    char *infile;
+    long size;
+
+    if (job->ef != -1)
+        return job->ef - job->sf;
+    infile = ctl_infile(config, job->file);
+    size = (stat(infile, &st) == 0) ? (long)st.st_size : 0;
+    ckd_free(infile);
+    if (cmd_ln_boolean_r(config, "-adcin"))
+        size = (long)((size - cmd_ln_int32_r(config, "-adchdr"))
+                      / sizeof(int16) * cmd_ln_int32_r(config, "-frate")
+                      / cmd_ln_float32_r(config, "-samprate"));
+    else if (!cmd_ln_boolean_r(config, "-senin"))
+        size /= 4 * cmd_ln_int32_r(config, "-ceplen");
+    return size - job->sf;
+}
+
+/*
+ * Read the utterances to be decoded from the control file, along with
+ * the matching lines of any MLLR, LM or FSG control files.
+ */
+static ctl_job_t *
+read_ctl(cmd_ln_t *config, FILE *ctlfh, int *out_n_jobs)
 {
     int32 ctloffset, ctlcount, ctlincr;
     int32 i;
     char *line;
     size_t len;
-    FILE *hypfh = NULL, *hypsegfh = NULL, *ctmfh = NULL;
     FILE *mllrfh = NULL, *lmfh = NULL, *fsgfh = NULL;
-    double n_speech, n_cpu, n_wall;
-    char const *outlatdir;
-    char const *nbestdir;
     char const *str;
-    int frate;
+    ctl_job_t *jobs = NULL;
+    int n_jobs = 0, n_alloc = 0;
 
     ctloffset = cmd_ln_int32_r(config, "-ctloffset");
     ctlcount = cmd_ln_int32_r(config, "-ctlcount");
     ctlincr = cmd_ln_int32_r(config, "-ctlincr");
-    outlatdir = cmd_ln_str_r(config, "-outlatdir");
-    nbestdir = cmd_ln_str_r(config, "-nbestdir");
-    frate = cmd_ln_int32_r(config, "-frate");
 
     if ((str = cmd_ln_str_r(config, "-mllrctl"))) {
         mllrfh = fopen(str, "r");
@@ -631,168 +785,377 @@ process_ctl(ps_decoder_t *ps, cmd_ln_t *config, FILE *ctlfh)
             goto done;
         }
     }
-    if ((str = cmd_ln_str_r(config, "-hyp"))) {
-        hypfh = fopen(str, "w");
-        if (hypfh == NULL) {
-            E_ERROR_SYSTEM("Failed to open hypothesis file %s for writing", str);
-            goto done;
-        }
-        setbuf(hypfh, NULL);
-    }
-    if ((str = cmd_ln_str_r(config, "-hypseg"))) {
-        hypsegfh = fopen(str, "w");
-        if (hypsegfh == NULL) {
-            E_ERROR_SYSTEM("Failed to open hypothesis file %s for writing", str);
-            goto done;
-        }
-        setbuf(hypsegfh, NULL);
-    }
-    if ((str = cmd_ln_str_r(config, "-ctm"))) {
-        ctmfh = fopen(str, "w");
-        if (ctmfh == NULL) {
-            E_ERROR_SYSTEM("Failed to open hypothesis file %s for writing", str);
-            goto done;
-        }
-        setbuf(ctmfh, NULL);
-    }
 
     i = 0;
     while ((line = fread_line(ctlfh, &len))) {
         char *wptr[4];
-        int32 nf, sf, ef;
-        char *mllrline = NULL, *lmline = NULL, *fsgline = NULL;
-        char *fsgfile = NULL, *lmname = NULL, *mllrfile = NULL;
+        int32 nf;
+        ctl_job_t job;
 
+        memset(&job, 0, sizeof(job));
+        job.line = line;
         if (mllrfh) {
-            mllrline = fread_line(mllrfh, &len);
-            if (mllrline == NULL) {
+            job.mllrline = fread_line(mllrfh, &len);
+            if (job.mllrline == NULL) {
                 E_ERROR("File size mismatch between control and MLLR control\n");
-                ckd_free(line);
-                ckd_free(mllrline);
+                ctl_job_free(&job);
                 goto done;
             }
-            mllrfile = string_trim(mllrline, STRING_BOTH);
+            job.mllrfile = string_trim(job.mllrline, STRING_BOTH);
         }
         if (lmfh) {
-            lmline = fread_line(lmfh, &len);
-            if (lmline == NULL) {
+            job.lmline = fread_line(lmfh, &len);
+            if (job.lmline == NULL) {
                 E_ERROR("File size mismatch between control and LM control\n");
-                ckd_free(line);
-                ckd_free(lmline);
+                ctl_job_free(&job);
                 goto done;
             }
-            lmname = string_trim(lmline, STRING_BOTH);
+            job.lmname = string_trim(job.lmline, STRING_BOTH);
         }
         if (fsgfh) {
-            fsgline = fread_line(fsgfh, &len);
-            if (fsgline == NULL) {
+            job.fsgline = fread_line(fsgfh, &len);
+            if (job.fsgline == NULL) {
                 E_ERROR("File size mismatch between control and FSG control\n");
-                ckd_free(line);
-                ckd_free(fsgline);
+                ctl_job_free(&job);
                 goto done;
             }
-            fsgfile = string_trim(fsgline, STRING_BOTH);
+            job.fsgfile = string_trim(job.fsgline, STRING_BOTH);
         }
 
         if (i < ctloffset) {
             i += ctlincr;
-            goto nextline;
+            ctl_job_free(&job);
+            continue;
         }
         if (ctlcount != -1 && i >= ctloffset + ctlcount) {
-            goto nextline;
+            ctl_job_free(&job);
+            continue;
         }
+        i += ctlincr;
 
-        sf = 0;
-        ef = -1;
+        job.sf = 0;
+        job.ef = -1;
         nf = str2words(line, wptr, 4);
-        if (nf == 0) {
-            /* Do nothing. */
+        if (nf <= 0) {
+            if (nf < 0)
+                E_ERROR("Unexpected extra data in control file at line %d\n", i);
+            ctl_job_free(&job);
+            continue;
         }
-        else if (nf < 0) {
-            E_ERROR("Unexpected extra data in control file at line %d\n", i);
+        job.file = wptr[0];
+        if (nf > 1)
+            job.sf = atoi(wptr[1]);
+        if (nf > 2)
+            job.ef = atoi(wptr[2]);
+        if (nf > 3)
+            job.uttid = wptr[3];
+        job.size = ctl_job_size(config, &job);
+
+        if (n_jobs == n_alloc) {
+            n_alloc = n_alloc * 2 + 64;
+            jobs = ckd_realloc(jobs, n_alloc * sizeof(*jobs));
         }
-        else {
-            char const *hyp, *file, *uttid;
-            int32 score;
-
-            file = wptr[0];
-            uttid = NULL;
-            if (nf > 1)
-                sf = atoi(wptr[1]);
-            if (nf > 2)
-                ef = atoi(wptr[2]);
-            if (nf > 3)
-                uttid = wptr[3];
-
-            E_INFO("Decoding '%s'\n", uttid ? uttid : file);
-
-            /* Do actual decoding. */
-            if(process_mllrctl_line(ps, config, mllrfile) < 0)
-                continue;
-            if(process_lmnamectl_line(ps, config, lmname) < 0)
-                continue;
-            if(process_fsgctl_line(ps, config, fsgfile) < 0)
-                continue;
-            if(process_ctl_line(ps, config, file, uttid, sf, ef) < 0)
-                continue;
-            hyp = ps_get_hyp(ps, &score, &uttid);
-            
-            /* Write out results and such. */
-            if (hypfh) {
-                fprintf(hypfh, "%s (%s %d)\n", hyp ? hyp : "", uttid, score);
-            }
-            if (hypsegfh) {
-                write_hypseg(hypsegfh, ps, uttid);
-            }
-            if (ctmfh) {
-                ps_seg_t *itor = ps_seg_iter(ps, &score);
-                write_ctm(ctmfh, ps, itor, uttid, frate);
-            }
-            if (outlatdir) {
-                write_lattice(ps, outlatdir, uttid);
-            }
-            if (nbestdir) {
-                write_nbest(ps, nbestdir, uttid);
-            }
-            ps_get_utt_time(ps, &n_speech, &n_cpu, &n_wall);
-            E_INFO("%s: %.2f seconds speech, %.2f seconds CPU, %.2f seconds wall\n",
-                   uttid, n_speech, n_cpu, n_wall);
-            E_INFO("%s: %.2f xRT (CPU), %.2f xRT (elapsed)\n",
-                   uttid, n_cpu / n_speech, n_wall / n_speech);
-            /* help make the logfile somewhat less opaque (air) */
-            E_INFO_NOFN("%s (%s %d)\n", hyp ? hyp : "", uttid, score); 
-            E_INFO_NOFN("%s done --------------------------------------\n", uttid);
+        jobs[n_jobs++] = job;
+    }
+
+done:
+    if (mllrfh)
+        fclose(mllrfh);
+    if (lmfh)
+        fclose(lmfh);
+    if (fsgfh)
+        fclose(fsgfh);
+    *out_n_jobs = n_jobs;
+    return jobs;
+}
+
+/* Write out the decoding results of one utterance, or keep them if
+ * they have to wait for earlier ones. */
+static void
+write_results(ps_decoder_t *ps, ctl_job_t *job, output_t *out)
+{
+    char const *hyp, *uttid;
+    int32 score;
+    double n_speech, n_cpu, n_wall;
+
+    hyp = ps_get_hyp(ps, &score, &uttid);
+
+    /* Write out results and such. */
+    if (out->hypfh) {
+        outbuf_printf(&job->hyp, "%s (%s %d)\n", hyp ? hyp : "", uttid, score);
+    }
+    if (out->hypsegfh) {
+        write_hypseg(&job->hypseg, ps, uttid);
+    }
+    if (out->ctmfh) {
+        ps_seg_t *itor = ps_seg_iter(ps, &score);
+        write_ctm(&job->ctm, ps, itor, uttid, out->frate);
+    }
+    if (out->outlatdir) {
+        write_lattice(ps, out->outlatdir, uttid);
+    }
+    if (out->nbestdir) {
+        write_nbest(ps, out->nbestdir, uttid);
+    }
+    ps_get_utt_time(ps, &n_speech, &n_cpu, &n_wall);
+    E_INFO("%s: %.2f seconds speech, %.2f seconds CPU, %.2f seconds wall\n",
+           uttid, n_speech, n_cpu, n_wall);
+    E_INFO("%s: %.2f xRT (CPU), %.2f xRT (elapsed)\n",
+           uttid, n_cpu / n_speech, n_wall / n_speech);
+    /* help make the logfile somewhat less opaque (air) */
+    E_INFO_NOFN("%s (%s %d)\n", hyp ? hyp : "", uttid, score); 
+    E_INFO_NOFN("%s done --------------------------------------\n", uttid);
+}
+
+/*
+ * Decode some utterances, one on each of the worker's decoders.  If
+ * it has several, they are searched together with ps_search_batch().
+ */
+static void
+decode_jobs(worker_t *w, ctl_job_t **jobs, int n_jobs)
+{
+    cmd_ln_t *config = w->ctl->config;
+    ps_decoder_t **started;
+    ctl_job_t **ok;
+    int i, n, batch;
+
+    batch = (w->n_decoders > 1);
+    started = ckd_calloc(n_jobs, sizeof(*started));
+    ok = ckd_calloc(n_jobs, sizeof(*ok));
+    n = 0;
+    for (i = 0; i < n_jobs; ++i) {
+        ctl_job_t *job = jobs[i];
+        ps_decoder_t *ps = w->decoders[i];
+
+        E_INFO("Decoding '%s'\n", job->uttid ? job->uttid : job->file);
+        if (process_mllrctl_line(ps, config, job->mllrfile) < 0)
+            continue;
+        if (process_lmnamectl_line(ps, config, job->lmname) < 0)
+            continue;
+        if (process_fsgctl_line(ps, config, job->fsgfile) < 0)
+            continue;
+        if (process_ctl_line(ps, config, job->file, job->uttid,
+                             job->sf, job->ef, batch) < 0)
+            continue;
+        started[n] = ps;
+        ok[n] = job;
+        ++n;
+    }
+    if (batch && n > 0) {
+        if (ps_search_batch(started, n) < 0)
+            E_ERROR("Failed to search batch of %d utterances\n", n);
+        for (i = 0; i < n; ++i)
+            ps_end_utt(started[i]);
+    }
+    for (i = 0; i < n; ++i) {
+        double n_speech, n_cpu, n_wall;
+
+        write_results(started[i], ok[i], &w->ctl->out);
+        ps_get_utt_time(started[i], &n_speech, &n_cpu, &n_wall);
+        w->n_speech += n_speech;
+        ++w->n_utt;
+    }
+    ckd_free(started);
+    ckd_free(ok);
+}
+
+/* Write out the results of all finished utterances that are next in
+ * control file order. */
+static void
+flush_results(ctl_t *ctl)
+{
+    while (ctl->next_out < ctl->n_jobs && ctl->jobs[ctl->next_out].done) {
+        ctl_job_t *job = ctl->jobs + ctl->next_out;
+
+        outbuf_flush(&job->hyp, ctl->out.hypfh);
+        outbuf_flush(&job->hypseg, ctl->out.hypsegfh);
+        outbuf_flush(&job->ctm, ctl->out.ctmfh);
+        ++ctl->next_out;
+    }
+}
+
+/*
+ * Take utterances from the queue, as many at a time as there are
+ * decoders, until there are none left.
+ */
+static void
+run_worker(worker_t *w)
+{
+    ctl_t *ctl = w->ctl;
+    ctl_job_t **jobs;
+
+    jobs = ckd_calloc(w->n_decoders, sizeof(*jobs));
+    ptmr_init(&w->busy);
+    for (;;) {
+        int i, n;
+
+        sbmtx_lock(ctl->mtx);
+        for (n = 0; n < w->n_decoders && ctl->next < ctl->n_jobs; ++n)
+            jobs[n] = ctl->order[ctl->next++];
+        sbmtx_unlock(ctl->mtx);
+        if (n == 0)
+            break;
+
+        ptmr_start(&w->busy);
+        decode_jobs(w, jobs, n);
+        ptmr_stop(&w->busy);
+
+        sbmtx_lock(ctl->mtx);
+        for (i = 0; i < n; ++i)
+            jobs[i]->done = TRUE;
+        flush_results(ctl);
+        sbmtx_unlock(ctl->mtx);
+    }
+    ckd_free(jobs);
+}
+
+static int
+worker_main(sbthread_t *th)
+{
+    run_worker(sbthread_arg(th));
+    return 0;
+}
+
+/* Longest utterances first, otherwise in control file order. */
+static int
+cmp_job_size(void const *a, void const *b)
+{
+    ctl_job_t const *ja = *(ctl_job_t * const *)a;
+    ctl_job_t const *jb = *(ctl_job_t * const *)b;
+
+    if (ja->size != jb->size)
+        return ja->size > jb->size ? -1 : 1;
+    return ja < jb ? -1 : (ja > jb);
+}
+
+/*
+ * Decode the utterances in the control file.  With several workers,
+ * each one runs in its own thread with batchsize decoders, and takes
+ * the longest utterances not yet started whenever it is idle.  The
+ * results are written in control file order regardless.
+ */
+static void
+process_ctl(ps_decoder_t **decoders, int n_workers, int batchsize,
+            cmd_ln_t *config, FILE *ctlfh)
+{
+    ctl_t ctl;
+    worker_t *workers;
+    sbthread_t **threads;
+    ptmr_t tm;
+    double n_speech;
+    char const *str;
+    int i;
+
+    memset(&ctl, 0, sizeof(ctl));
+    ctl.config = config;
+    ctl.out.outlatdir = cmd_ln_str_r(config, "-outlatdir");
+    ctl.out.nbestdir = cmd_ln_str_r(config, "-nbestdir");
+    ctl.out.frate = cmd_ln_int32_r(config, "-frate");
+
+    if ((str = cmd_ln_str_r(config, "-hyp"))) {
+        ctl.out.hypfh = fopen(str, "w");
+        if (ctl.out.hypfh == NULL) {
+            E_ERROR_SYSTEM("Failed to open hypothesis file %s for writing", str);
+            goto done;
         }
-        i += ctlincr;
-    nextline:
-        ckd_free(mllrline);
-        ckd_free(fsgline);
-        ckd_free(lmline);
-        ckd_free(line);
+        setbuf(ctl.out.hypfh, NULL);
     }
+    if ((str = cmd_ln_str_r(config, "-hypseg"))) {
+        ctl.out.hypsegfh = fopen(str, "w");
+        if (ctl.out.hypsegfh == NULL) {
+            E_ERROR_SYSTEM("Failed to open hypothesis file %s for writing", str);
+            goto done;
+        }
+        setbuf(ctl.out.hypsegfh, NULL);
+    }
+    if ((str = cmd_ln_str_r(config, "-ctm"))) {
+        ctl.out.ctmfh = fopen(str, "w");
+        if (ctl.out.ctmfh == NULL) {
+            E_ERROR_SYSTEM("Failed to open hypothesis file %s for writing", str);
+            goto done;
+        }
+        setbuf(ctl.out.ctmfh, NULL);
+    }
+
+    ctl.jobs = read_ctl(config, ctlfh, &ctl.n_jobs);
+    ctl.order = ckd_calloc(ctl.n_jobs + 1, sizeof(*ctl.order));
+    for (i = 0; i < ctl.n_jobs; ++i)
+        ctl.order[i] = ctl.jobs + i;
+    if (n_workers > 1)
+        qsort(ctl.order, ctl.n_jobs, sizeof(*ctl.order), cmp_job_size);
+    /* Don't start threads that would have nothing to do. */
+    if (n_workers > (ctl.n_jobs + batchsize - 1) / batchsize)
+        n_workers = ctl.n_jobs > 0 ? (ctl.n_jobs + batchsize - 1) / batchsize : 1;
+    ctl.mtx = sbmtx_init();
+
+    /* This thread is the first worker. */
+    workers = ckd_calloc(n_workers, sizeof(*workers));
+    threads = ckd_calloc(n_workers, sizeof(*threads));
+    for (i = 0; i < n_workers; ++i) {
+        workers[i].ctl = &ctl;
+        workers[i].decoders = decoders + i * batchsize;
+        workers[i].n_decoders = batchsize;
+    }
+    if (n_workers > 1)
+        E_INFO("Decoding %d utterances with %d threads\n",
+               ctl.n_jobs, n_workers);
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (i = 1; i < n_workers; ++i)
+        if ((threads[i] = sbthread_start(NULL, worker_main,
+                                         workers + i)) == NULL)
+            E_ERROR("Failed to start decoding thread %d\n", i);
+    run_worker(workers);
+    for (i = 1; i < n_workers; ++i) {
+        if (threads[i]) {
+            sbthread_wait(threads[i]);
+            sbthread_free(threads[i]);
+        }
+    }
+    ptmr_stop(&tm);
 
-    ps_get_all_time(ps, &n_speech, &n_cpu, &n_wall);
+    n_speech = 0;
+    for (i = 0; i < n_workers; ++i)
+        n_speech += workers[i].n_speech;
     E_INFO("TOTAL %.2f seconds speech, %.2f seconds CPU, %.2f seconds wall\n",
-           n_speech, n_cpu, n_wall);
+           n_speech, tm.t_cpu, tm.t_elapsed);
     E_INFO("AVERAGE %.2f xRT (CPU), %.2f xRT (elapsed)\n",
-           n_cpu / n_speech, n_wall / n_speech);
+           tm.t_cpu / n_speech, tm.t_elapsed / n_speech);
+    if (n_workers > 1) {
+        for (i = 0; i < n_workers; ++i)
+            E_INFO("Thread %d: %d utterances, %.2f seconds speech, "
+                   "%.2f seconds busy (%.0f%% utilization)\n",
+                   i, workers[i].n_utt, workers[i].n_speech,
+                   workers[i].busy.t_elapsed,
+                   tm.t_elapsed > 0
+                   ? 100 * workers[i].busy.t_elapsed / tm.t_elapsed : 0.0);
+    }
+
+    for (i = 0; i < ctl.n_jobs; ++i)
+        ctl_job_free(ctl.jobs + i);
+    ckd_free(ctl.jobs);
+    ckd_free(ctl.order);
+    ckd_free(workers);
+    ckd_free(threads);
+    sbmtx_free(ctl.mtx);
 
 done:
-    if (hypfh)
-        fclose(hypfh);
-    if (hypsegfh)
-        fclose(hypsegfh);
-    if (ctmfh)
-        fclose(ctmfh);
+    if (ctl.out.hypfh)
+        fclose(ctl.out.hypfh);
+    if (ctl.out.hypsegfh)
+        fclose(ctl.out.hypsegfh);
+    if (ctl.out.ctmfh)
+        fclose(ctl.out.ctmfh);
 }
 
 int
 main(int32 argc, char *argv[])
 {
-    ps_decoder_t *ps;
+    ps_decoder_t **decoders;
     cmd_ln_t *config;
     char const *ctl;
     FILE *ctlfh;
+    int i, n_workers, batchsize, n_decoders;
 
     config = cmd_ln_parse_r(NULL, ps_args_def, argc, argv, TRUE);
 
@@ -814,15 +1177,55 @@ main(int32 argc, char *argv[])
     }
 
     ps_default_search_args(config);
-    if (!(ps = ps_init(config))) {
+    n_workers = cmd_ln_int32_r(config, "-nworkers");
+    batchsize = cmd_ln_int32_r(config, "-batchsize");
+    if (n_workers < 1)
+        n_workers = 1;
+    if (batchsize < 1)
+        batchsize = 1;
+    if ((n_workers > 1 || batchsize > 1) && cmd_ln_str_r(config, "-mllrctl")) {
+        E_WARN("-nworkers and -batchsize are not supported with -mllrctl, "
+               "decoding one utterance at a time\n");
+        n_workers = batchsize = 1;
+    }
+    if (batchsize > 1 && cmd_ln_boolean_r(config, "-senin")) {
+        E_WARN("-batchsize is not supported with -senin, "
+               "decoding one utterance at a time\n");
+        batchsize = 1;
+    }
+    /* Every decoder starts its own -nthreads scoring threads. */
+    if (n_workers > 1 && cmd_ln_int32_r(config, "-nthreads") > 1)
+        E_INFO("%d workers with %d scoring threads each\n",
+               n_workers, cmd_ln_int32_r(config, "-nthreads"));
+
+    n_decoders = n_workers * batchsize;
+    decoders = ckd_calloc(n_decoders, sizeof(*decoders));
+    if (n_decoders > 1) {
+        /* All of the decoders share one model. */
+        ps_model_t *model;
+
+        if ((model = ps_model_init(config)) == NULL) {
+            cmd_ln_free_r(config);
+            E_FATAL("PocketSphinx model init failed\n");
+        }
+        for (i = 0; i < n_decoders; ++i)
+            if (!(decoders[i] = ps_init_model(model)))
+                E_FATAL("PocketSphinx decoder init failed\n");
+        ps_model_free(model);
+        if (batchsize > 1)
+            E_INFO("Searching %d utterances at a time\n", batchsize);
+    }
+    else if (!(decoders[0] = ps_init(config))) {
         cmd_ln_free_r(config);
         E_FATAL("PocketSphinx decoder init failed\n");
     }
 
-    process_ctl(ps, config, ctlfh);
+    process_ctl(decoders, n_workers, batchsize, config, ctlfh);
 
     fclose(ctlfh);
-    ps_free(ps);
+    for (i = 0; i < n_decoders; ++i)
+        ps_free(decoders[i]);
+    ckd_free(decoders);
     cmd_ln_free_r(config);
     return 0;
 }
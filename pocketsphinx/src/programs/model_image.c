@@ -0,0 +1,116 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/**
+ * model_image.c - write a precompiled acoustic model image
+ *
+ * Reads an acoustic model in the usual way, with the same options as
+ * the decoder, and writes its parameters to an image which can then
+ * be loaded with <code>-amimage</code>.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/strfuncs.h>
+
+#include <pocketsphinx.h>
+
+#include "acmod.h"
+
+static void
+add_file(cmd_ln_t *config, const char *arg,
+         const char *hmmdir, const char *file)
+{
+    char *tmp = string_join(hmmdir, "/", file, NULL);
+    FILE *fh;
+
+    if (cmd_ln_str_r(config, arg) == NULL
+        && (fh = fopen(tmp, "rb")) != NULL) {
+        fclose(fh);
+        cmd_ln_set_str_r(config, arg, tmp);
+    }
+    ckd_free(tmp);
+}
+
+int
+main(int argc, char *argv[])
+{
+    cmd_ln_t *config;
+    logmath_t *lmath;
+    acmod_t *acmod;
+    char const *hmmdir, *outfile;
+    int rv;
+
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "Usage: %s OUTPUT -hmm HMMDIR [options]\n",
+                argv[0]);
+        return 1;
+    }
+    outfile = argv[1];
+    if ((config = cmd_ln_parse_r(NULL, ps_args(), argc - 1,
+                                 argv + 1, TRUE)) == NULL)
+        return 1;
+    if (cmd_ln_str_r(config, "-amimage")) {
+        fprintf(stderr, "Cannot create an image from another image\n");
+        return 1;
+    }
+    if ((hmmdir = cmd_ln_str_r(config, "-hmm")) != NULL) {
+        add_file(config, "-mdef", hmmdir, "mdef");
+        add_file(config, "-mean", hmmdir, "means");
+        add_file(config, "-var", hmmdir, "variances");
+        add_file(config, "-tmat", hmmdir, "transition_matrices");
+        add_file(config, "-mixw", hmmdir, "mixture_weights");
+        add_file(config, "-sendump", hmmdir, "sendump");
+        add_file(config, "-featparams", hmmdir, "feat.params");
+        add_file(config, "-senmgau", hmmdir, "senmgau");
+    }
+
+    lmath = logmath_init((float64)cmd_ln_float32_r(config, "-logbase"),
+                         0, FALSE);
+    if ((acmod = acmod_init(config, lmath, NULL, NULL)) == NULL) {
+        fprintf(stderr, "Failed to load acoustic model\n");
+        return 1;
+    }
+    rv = acmod_write_image(acmod, outfile);
+    if (rv == 0)
+        E_INFO("Wrote acoustic model image to %s\n", outfile);
+
+    acmod_free(acmod);
+    logmath_free(lmath);
+    cmd_ln_free_r(config);
+    return rv < 0;
+}
@@ -91,6 +91,7 @@ typedef ps_decoder_t Decoder;
 typedef ps_decoder_t SegmentList;
 typedef ps_decoder_t NBestList;
 typedef ps_lattice_t Lattice;
+typedef ps_stats_t Stats;
 %}
 
 
@@ -129,6 +130,25 @@ typedef struct {} Lattice;
 typedef struct {} NBestList;
 typedef struct {} SegmentList;
 
+%immutable;
+typedef struct {
+    long long n_frame;
+    long long n_senone_eval;
+    long long n_codebook_eval;
+    long long n_root_hmm_eval;
+    long long n_nonroot_hmm_eval;
+    long long n_word_hmm_eval;
+    long long n_bp;
+    long long n_lm_lookup;
+    long long n_lm_cache_hit;
+    double t_fe;
+    double t_feat;
+    double t_mgau;
+    double t_search;
+    double t_lattice;
+} Stats;
+%mutable;
+
 #ifdef HAS_DOC
 %include pydoc.i
 #endif
@@ -157,6 +177,12 @@ typedef struct {} SegmentList;
     }
 }
 
+%extend Stats {
+    ~Stats() {
+        ckd_free($self);
+    }
+}
+
 %extend Segment {
 
     static Segment* fromIter(ps_seg_t *itor) {
@@ -233,6 +233,20 @@
         return ps_get_n_frames($self);
     }
 
+    %newobject utt_stats;
+    Stats *utt_stats() {
+        Stats *stats = ckd_malloc(sizeof(*stats));
+        ps_get_utt_stats($self, stats);
+        return stats;
+    }
+
+    %newobject all_stats;
+    Stats *all_stats() {
+        Stats *stats = ckd_malloc(sizeof(*stats));
+        ps_get_all_stats($self, stats);
+        return stats;
+    }
+
     SegmentList *seg() {
 	return $self;
     }
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <string.h>
+#include <pocketsphinx.h>
+
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/strfuncs.h>
+
+#include "acmod.h"
+#include "test_macros.h"
+
+/*
+ * Write acoustic model images for a semi-continuous and a continuous
+ * model, then check that scoring an utterance with each image gives
+ * exactly the same results as scoring it with the original files.
+ */
+
+#define MAX_FRAMES 1000
+#define MAX_SENONES 8192
+#define IMAGE "test_acmod_image.img"
+
+static cmd_ln_t *
+model_config(char const *hmmdir, char const *image, char const *do_mmap)
+{
+    cmd_ln_t *config;
+    char *featparams = string_join(hmmdir, "/feat.params", NULL);
+
+    if (image) {
+        config = cmd_ln_init(NULL, ps_args(), TRUE,
+                             "-featparams", featparams,
+                             "-amimage", image,
+                             "-mmap", do_mmap,
+                             "-compallsen", "yes",
+                             "-input_endian", "little",
+                             "-samprate", "16000", NULL);
+    }
+    else {
+        char *mdef = string_join(hmmdir, "/mdef", NULL);
+        char *mean = string_join(hmmdir, "/means", NULL);
+        char *var = string_join(hmmdir, "/variances", NULL);
+        char *tmat = string_join(hmmdir, "/transition_matrices", NULL);
+        char *sendump = string_join(hmmdir, "/sendump", NULL);
+        char *mixw = string_join(hmmdir, "/mixture_weights", NULL);
+        FILE *fh;
+
+        /* Prefer the sendump if there is one. */
+        if ((fh = fopen(sendump, "rb")) != NULL)
+            fclose(fh);
+        config = cmd_ln_init(NULL, ps_args(), TRUE,
+                             "-featparams", featparams,
+                             "-mdef", mdef,
+                             "-mean", mean,
+                             "-var", var,
+                             "-tmat", tmat,
+                             fh ? "-sendump" : "-mixw", fh ? sendump : mixw,
+                             "-compallsen", "yes",
+                             "-input_endian", "little",
+                             "-samprate", "16000", NULL);
+        ckd_free(mdef);
+        ckd_free(mean);
+        ckd_free(var);
+        ckd_free(tmat);
+        ckd_free(sendump);
+        ckd_free(mixw);
+    }
+    ckd_free(featparams);
+    return config;
+}
+
+static int
+score_utt(acmod_t *acmod, int16 *scores)
+{
+    FILE *rawfh;
+    int16 *buf;
+    int nfr, n_sen;
+
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    TEST_ASSERT(n_sen <= MAX_SENONES);
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    buf = ckd_calloc(160000, sizeof(*buf));
+    TEST_EQUAL(0, acmod_set_grow(acmod, TRUE));
+    TEST_EQUAL(0, acmod_start_utt(acmod));
+    while (!feof(rawfh)) {
+        int16 const *bptr = buf;
+        size_t nread = fread(buf, sizeof(*buf), 160000, rawfh);
+        while (nread > 0)
+            acmod_process_raw(acmod, &bptr, &nread, TRUE);
+    }
+    fclose(rawfh);
+    ckd_free(buf);
+    TEST_EQUAL(0, acmod_end_utt(acmod));
+
+    nfr = 0;
+    while (acmod->n_feat_frame > 0 && nfr < MAX_FRAMES) {
+        int16 const *senscr;
+        int frame_idx = -1;
+
+        senscr = acmod_score(acmod, &frame_idx);
+        memcpy(scores + nfr * n_sen, senscr, n_sen * sizeof(*scores));
+        acmod_advance(acmod);
+        ++nfr;
+    }
+    return nfr;
+}
+
+static void
+test_image(char const *hmmdir, char const *mgau, char const *do_mmap,
+           int16 *ref, int16 *scores)
+{
+    logmath_t *lmath;
+    cmd_ln_t *config;
+    acmod_t *acmod;
+    int nfr, n_sen;
+
+    lmath = logmath_init(1.0001, 0, 0);
+
+    /* Score with the original model and write it out. */
+    config = model_config(hmmdir, NULL, NULL);
+    TEST_ASSERT(acmod = acmod_init(config, lmath, NULL, NULL));
+    TEST_EQUAL(0, strcmp(acmod->mgau->vt->name, mgau));
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    nfr = score_utt(acmod, ref);
+    TEST_ASSERT(nfr > 0);
+    TEST_EQUAL(0, acmod_write_image(acmod, IMAGE));
+    acmod_free(acmod);
+    cmd_ln_free_r(config);
+
+    /* Score with the image. */
+    config = model_config(hmmdir, IMAGE, do_mmap);
+    TEST_ASSERT(acmod = acmod_init(config, lmath, NULL, NULL));
+    TEST_ASSERT(acmod->image);
+    TEST_EQUAL(0, strcmp(acmod->mgau->vt->name, mgau));
+    TEST_EQUAL(n_sen, bin_mdef_n_sen(acmod->mdef));
+    TEST_EQUAL(nfr, score_utt(acmod, scores));
+    TEST_EQUAL(0, memcmp(ref, scores, nfr * n_sen * sizeof(*ref)));
+    acmod_free(acmod);
+    cmd_ln_free_r(config);
+
+    /* Nor with different floors than it was written with. */
+    config = model_config(hmmdir, IMAGE, do_mmap);
+    cmd_ln_set_float32_r(config, "-varfloor", 0.001);
+    TEST_ASSERT(NULL == acmod_init(config, lmath, NULL, NULL));
+    cmd_ln_free_r(config);
+
+    /* An image can't be used with a different log base. */
+    logmath_free(lmath);
+    lmath = logmath_init(1.0003, 0, 0);
+    config = model_config(hmmdir, IMAGE, do_mmap);
+    TEST_ASSERT(NULL == acmod_init(config, lmath, NULL, NULL));
+    cmd_ln_free_r(config);
+
+    logmath_free(lmath);
+    remove(IMAGE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int16 *ref, *scores;
+
+    ref = ckd_calloc(MAX_FRAMES * MAX_SENONES, sizeof(*ref));
+    scores = ckd_calloc(MAX_FRAMES * MAX_SENONES, sizeof(*scores));
+
+    test_image(MODELDIR "/hmm/en_US/hub4wsj_sc_8k", "s2_semi", "yes",
+               ref, scores);
+    test_image(DATADIR "/an4_ci_cont", "ms", "no", ref, scores);
+
+    ckd_free(ref);
+    ckd_free(scores);
+    return 0;
+}
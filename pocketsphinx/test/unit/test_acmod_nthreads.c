@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include <pocketsphinx.h>
+
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/profile.h>
+
+#include "acmod.h"
+#include "test_macros.h"
+
+/*
+ * Score an utterance with a continuous model using one and several
+ * threads, with all senones and with a changing subset of them
+ * active, and check that the scores are identical.
+ */
+
+#define MAX_FRAMES 1000
+#define MAX_SENONES 1024
+
+static int
+score_utt(char const *nthreads, int compallsen, int16 *scores,
+          int *out_n_sen, double *out_time)
+{
+    acmod_t *acmod;
+    logmath_t *lmath;
+    cmd_ln_t *config;
+    FILE *rawfh;
+    int16 *buf;
+    ptmr_t tm;
+    int nfr, n_sen;
+
+    lmath = logmath_init(1.0001, 0, 0);
+    config = cmd_ln_init(NULL, ps_args(), TRUE,
+                 "-featparams", DATADIR "/an4_ci_cont/feat.params",
+                 "-mdef", DATADIR "/an4_ci_cont/mdef",
+                 "-mean", DATADIR "/an4_ci_cont/means",
+                 "-var", DATADIR "/an4_ci_cont/variances",
+                 "-tmat", DATADIR "/an4_ci_cont/transition_matrices",
+                 "-mixw", DATADIR "/an4_ci_cont/mixture_weights",
+                 "-compallsen", compallsen ? "yes" : "no",
+                 "-nthreads", nthreads,
+                 "-input_endian", "little",
+                 "-samprate", "16000", NULL);
+    TEST_ASSERT(config);
+    TEST_ASSERT(acmod = acmod_init(config, lmath, NULL, NULL));
+    TEST_EQUAL(0, strcmp(acmod->mgau->vt->name, "ms"));
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    TEST_ASSERT(n_sen <= MAX_SENONES);
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    buf = ckd_calloc(160000, sizeof(*buf));
+    TEST_EQUAL(0, acmod_set_grow(acmod, TRUE));
+    TEST_EQUAL(0, acmod_start_utt(acmod));
+    while (!feof(rawfh)) {
+        int16 const *bptr = buf;
+        size_t nread = fread(buf, sizeof(*buf), 160000, rawfh);
+        while (nread > 0)
+            acmod_process_raw(acmod, &bptr, &nread, TRUE);
+    }
+    fclose(rawfh);
+    ckd_free(buf);
+    TEST_EQUAL(0, acmod_end_utt(acmod));
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    nfr = 0;
+    memset(scores, 0, MAX_FRAMES * MAX_SENONES * sizeof(*scores));
+    while (acmod->n_feat_frame > 0 && nfr < MAX_FRAMES) {
+        int16 const *senscr;
+        int i, frame_idx = -1;
+
+        if (!compallsen) {
+            /* Activate every third senone, shifting each frame. */
+            acmod_clear_active(acmod);
+            for (i = nfr % 3; i < n_sen; i += 3)
+                bitvec_set(acmod->senone_active_vec, i);
+        }
+        senscr = acmod_score(acmod, &frame_idx);
+        for (i = 0; i < n_sen; ++i)
+            if (compallsen || i % 3 == nfr % 3)
+                scores[nfr * n_sen + i] = senscr[i];
+        acmod_advance(acmod);
+        ++nfr;
+    }
+    ptmr_stop(&tm);
+
+    *out_n_sen = n_sen;
+    *out_time = tm.t_elapsed;
+    acmod_free(acmod);
+    logmath_free(lmath);
+    cmd_ln_free_r(config);
+    return nfr;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int16 *ref, *scores;
+    int compallsen;
+
+    ref = ckd_calloc(MAX_FRAMES * MAX_SENONES, sizeof(*ref));
+    scores = ckd_calloc(MAX_FRAMES * MAX_SENONES, sizeof(*scores));
+
+    for (compallsen = 0; compallsen < 2; ++compallsen) {
+        double t1, t4;
+        int nfr, n_sen;
+
+        nfr = score_utt("1", compallsen, ref, &n_sen, &t1);
+        TEST_ASSERT(nfr > 0);
+        TEST_EQUAL(nfr, score_utt("4", compallsen, scores, &n_sen, &t4));
+        TEST_EQUAL(0, memcmp(ref, scores, nfr * n_sen * sizeof(*ref)));
+        printf("compallsen %d: %d frames, 1 thread %.3f sec, "
+               "4 threads %.3f sec\n", compallsen, nfr, t1, t4);
+    }
+
+    ckd_free(ref);
+    ckd_free(scores);
+    return 0;
+}
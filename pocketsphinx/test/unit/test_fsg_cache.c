@@ -0,0 +1,135 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pocketsphinx_internal.h"
+#include "fsg_search_internal.h"
+#include "test_macros.h"
+
+static int32
+decode(ps_decoder_t *ps)
+{
+	FILE *rawfh;
+	char const *hyp;
+	int32 score;
+
+	TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+	ps_decode_raw(ps, rawfh, "goforward", -1);
+	fclose(rawfh);
+	hyp = ps_get_hyp(ps, &score, NULL);
+	printf("%s (%d)\n", hyp, score);
+	TEST_EQUAL(0, strcmp(hyp, "go forward ten meters"));
+	return score;
+}
+
+static fsg_model_t *
+read_fsg(ps_decoder_t *ps)
+{
+	return fsg_model_readfile(DATADIR "/goforward.fsg", ps_get_logmath(ps),
+				  cmd_ln_float32_r(ps_get_config(ps), "-lw"));
+}
+
+/* Check reuse of compiled grammars, with or without minimization. */
+static void
+check_cache(char const *minimize, int32 n_state, int32 score)
+{
+	ps_decoder_t *ps;
+	cmd_ln_t *config;
+	fsg_model_t *fsg;
+	ps_search_t *search;
+	uint32 hash[2];
+
+	TEST_ASSERT(config =
+		    cmd_ln_init(NULL, ps_args(), TRUE,
+				"-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+				"-fsg", DATADIR "/goforward.fsg",
+				"-dict", MODELDIR "/lm/en/turtle.dic",
+				"-fsgminimize", minimize,
+				"-fsgcache", "2",
+				"-input_endian", "little",
+				"-samprate", "16000", NULL));
+	TEST_ASSERT(ps = ps_init(config));
+	TEST_EQUAL(score, decode(ps));
+	TEST_EQUAL(n_state, fsg_model_n_state(ps_get_fsg(ps, PS_DEFAULT_SEARCH)));
+
+	/* Setting the same grammar again does nothing, even though
+	 * fillers have been added to the one being searched. */
+	search = ps->search;
+	TEST_ASSERT(fsg = read_fsg(ps));
+	TEST_EQUAL(0, ps_set_fsg(ps, PS_DEFAULT_SEARCH, fsg));
+	fsg_model_free(fsg);
+	TEST_ASSERT(search == ps->search);
+
+	/* Replacing it keeps it in the cache, and the new one is used. */
+	TEST_EQUAL(0, ps_set_jsgf_string(ps, PS_DEFAULT_SEARCH,
+					 "#JSGF V1.0; grammar turn; "
+					 "public <turn> = left | stop;"));
+	TEST_ASSERT(search != ps->search);
+	TEST_EQUAL(1, ps->n_fsg_cache);
+
+	/* So setting it again brings it back without compiling it. */
+	TEST_ASSERT(fsg = read_fsg(ps));
+	TEST_EQUAL(0, ps_set_fsg(ps, PS_DEFAULT_SEARCH, fsg));
+	fsg_model_free(fsg);
+	TEST_ASSERT(search == ps->search);
+	TEST_EQUAL(1, ps->n_fsg_cache);
+	TEST_EQUAL(score, decode(ps));
+
+	/* A different grammar whose hash collides is not mistaken for
+	 * it.  Forge the collision rather than searching for one. */
+	TEST_ASSERT(fsg = read_fsg(ps));
+	fsg_model_trans_add(fsg, 5, 6, 0, fsg_model_word_add(fsg, "forward"));
+	fsg_search_hash(fsg, hash);
+	memcpy(((fsg_search_t *)search)->fsg_hash, hash, sizeof(hash));
+	TEST_EQUAL(0, ps_set_fsg(ps, PS_DEFAULT_SEARCH, fsg));
+	fsg_model_free(fsg);
+	TEST_ASSERT(search != ps->search);
+	search = ps->search;
+
+	/* An identical copy of a cached grammar is still found. */
+	TEST_EQUAL(0, ps_set_jsgf_string(ps, PS_DEFAULT_SEARCH,
+					 "#JSGF V1.0; grammar turn; "
+					 "public <turn> = left | stop;"));
+	TEST_ASSERT(search != ps->search);
+	TEST_ASSERT(fsg = read_fsg(ps));
+	fsg_model_trans_add(fsg, 5, 6, 0, fsg_model_word_add(fsg, "forward"));
+	TEST_EQUAL(0, ps_set_fsg(ps, PS_DEFAULT_SEARCH, fsg));
+	fsg_model_free(fsg);
+	TEST_ASSERT(search == ps->search);
+
+	/* Changing the dictionary empties the cache. */
+	TEST_ASSERT(ps_add_word(ps, "foobie", "F UW B IY", FALSE) >= 0);
+	TEST_EQUAL(0, ps->n_fsg_cache);
+
+	ps_free(ps);
+	cmd_ln_free_r(config);
+}
+
+int
+main(int argc, char *argv[])
+{
+	ps_decoder_t *ps;
+	cmd_ln_t *config;
+	int32 score;
+
+	/* Reference result without minimization. */
+	TEST_ASSERT(config =
+		    cmd_ln_init(NULL, ps_args(), TRUE,
+				"-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+				"-fsg", DATADIR "/goforward.fsg",
+				"-dict", MODELDIR "/lm/en/turtle.dic",
+				"-input_endian", "little",
+				"-samprate", "16000", NULL));
+	TEST_ASSERT(ps = ps_init(config));
+	score = decode(ps);
+	TEST_EQUAL(7, fsg_model_n_state(ps_get_fsg(ps, PS_DEFAULT_SEARCH)));
+	ps_free(ps);
+	cmd_ln_free_r(config);
+
+	check_cache("no", 7, score);
+	/* Paths through "forward" and "backward" rejoin, so their end
+	 * states are merged, and the result should not change. */
+	check_cache("yes", 6, score);
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+#include <pocketsphinx.h>
+
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/profile.h>
+
+#include "hmm.h"
+#include "hmm_simd.h"
+#include "test_macros.h"
+
+/*
+ * Evaluate a set of random 3-state HMMs, with and without skip
+ * transitions and with some multiplex ones mixed in, for a number of
+ * frames with each available vectorized HMM kernel.  Check that every
+ * score and history is identical to hmm_vit_eval(), and report how
+ * long evaluation took.
+ */
+
+#define N_HMM 4096
+#define N_FRAMES 200
+#define N_SEN 1000
+#define N_SSEQ 200
+#define N_TMAT 4
+
+static uint32 seed = 42;
+
+static int32
+rand_int(int32 n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static int16 senscore[N_FRAMES][N_SEN];
+
+static void
+make_hmms(hmm_context_t *ctx, hmm_t *hmms)
+{
+    int i, j;
+
+    for (i = 0; i < N_HMM; ++i) {
+        hmm_t *hmm = hmms + i;
+        int mpx = (rand_int(8) == 0);
+
+        memset(hmm, 0, sizeof(*hmm));
+        hmm_init(ctx, hmm, mpx, rand_int(N_SSEQ), rand_int(N_TMAT));
+        if (mpx)
+            for (j = 1; j < 3; ++j)
+                hmm_mpx_ssid(hmm, j) = rand_int(N_SSEQ);
+        /* Some HMMs are entirely inactive, some only partly. */
+        for (j = 0; j < 3; ++j) {
+            if (rand_int(4) == 0)
+                continue;
+            hmm_score(hmm, j) = -rand_int(200000);
+            hmm_history(hmm, j) = rand_int(100000);
+        }
+        hmm_out_history(hmm) = -1;
+    }
+}
+
+/* Evaluate all the HMMs for all frames, entering some of them again
+ * every frame as the search would. */
+static double
+eval_hmms(hmm_context_t *ctx, hmm_simd_t *simd, hmm_t *hmms, int32 *best)
+{
+    ptmr_t tm;
+    int f, i;
+
+    ptmr_init(&tm);
+    for (f = 0; f < N_FRAMES; ++f) {
+        hmm_context_set_senscore(ctx, senscore[f]);
+        ptmr_start(&tm);
+        if (simd) {
+            hmm_simd_start(simd);
+            for (i = 0; i < N_HMM; ++i)
+                hmm_simd_add(simd, hmms + i);
+            best[f] = hmm_simd_finish(simd);
+        }
+        else {
+            best[f] = WORST_SCORE;
+            for (i = 0; i < N_HMM; ++i) {
+                int32 score = hmm_vit_eval(hmms + i);
+                if (score BETTER_THAN best[f])
+                    best[f] = score;
+            }
+        }
+        ptmr_stop(&tm);
+        for (i = f % 7; i < N_HMM; i += 7)
+            hmm_enter(hmms + i, best[f] - rand_int(50000), f, f + 1);
+    }
+    return tm.t_cpu;
+}
+
+int
+main(int argc, char *argv[])
+{
+    hmm_context_t *ctx;
+    uint8 ***tp;
+    uint16 **sseq;
+    hmm_t *ref, *hmms;
+    int32 ref_best[N_FRAMES], best[N_FRAMES];
+    double ref_time;
+    uint32 hmm_seed;
+    int i, j, k;
+
+    /* Transition matrices with and without skips. */
+    tp = (uint8 ***)ckd_calloc_3d(N_TMAT, 3, 4, sizeof(***tp));
+    for (i = 0; i < N_TMAT; ++i) {
+        for (j = 0; j < 3; ++j) {
+            for (k = 0; k < 4; ++k) {
+                if (k < j || k > j + 2)
+                    tp[i][j][k] = 255;
+                else
+                    tp[i][j][k] = 1 + rand_int(100);
+            }
+        }
+        if (i & 1)
+            tp[i][0][2] = 255;
+        if (i & 2)
+            tp[i][1][3] = 255;
+    }
+    sseq = (uint16 **)ckd_calloc_2d(N_SSEQ, 3, sizeof(**sseq));
+    for (i = 0; i < N_SSEQ; ++i)
+        for (j = 0; j < 3; ++j)
+            sseq[i][j] = rand_int(N_SEN);
+    for (i = 0; i < N_FRAMES; ++i)
+        for (j = 0; j < N_SEN; ++j)
+            senscore[i][j] = rand_int(20000);
+    TEST_ASSERT(ctx = hmm_context_init(3, tp, NULL, sseq));
+
+    /* Scalar reference. */
+    ref = ckd_calloc(N_HMM, sizeof(*ref));
+    hmms = ckd_calloc(N_HMM, sizeof(*hmms));
+    hmm_seed = seed;
+    make_hmms(ctx, ref);
+    ref_time = eval_hmms(ctx, NULL, ref, ref_best);
+    printf("%-6s %d HMMs x %d frames %.3f sec\n", "none",
+           N_HMM, N_FRAMES, ref_time);
+    TEST_ASSERT(hmm_simd_init("none", ctx, N_TMAT) == NULL);
+
+    for (i = MGAU_SIMD_NONE + 1; i <= MGAU_SIMD_NEON; ++i) {
+        hmm_simd_t *simd;
+        double t;
+
+        if ((simd = hmm_simd_init(mgau_simd_name(i), ctx, N_TMAT)) == NULL) {
+            printf("%-6s not supported\n", mgau_simd_name(i));
+            continue;
+        }
+        seed = hmm_seed;
+        make_hmms(ctx, hmms);
+        t = eval_hmms(ctx, simd, hmms, best);
+        TEST_EQUAL(0, memcmp(ref_best, best, sizeof(best)));
+        TEST_EQUAL(0, memcmp(ref, hmms, N_HMM * sizeof(*hmms)));
+        printf("%-6s %d HMMs x %d frames %.3f sec (%.2fx)\n",
+               mgau_simd_name(i), N_HMM, N_FRAMES, t,
+               t > 0 ? ref_time / t : 0.0);
+        hmm_simd_free(simd);
+    }
+
+    ckd_free(ref);
+    ckd_free(hmms);
+    hmm_context_free(ctx);
+    ckd_free_3d(tp);
+    ckd_free_2d(sseq);
+    return 0;
+}
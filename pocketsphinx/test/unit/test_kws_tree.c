@@ -0,0 +1,129 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+
+#include "pocketsphinx_internal.h"
+#include "kws_search.h"
+#include "test_macros.h"
+
+/*
+ * Spot a few keyphrases in a known utterance, then time the search
+ * with keyphrase lists of increasing size built from the dictionary.
+ */
+
+#define KWS_LIST "test_kws_tree.list"
+
+static char const *
+decode(ps_decoder_t *ps)
+{
+    FILE *rawfh;
+    char const *hyp;
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    ps_decode_raw(ps, rawfh, "goforward", -1);
+    fclose(rawfh);
+    hyp = ps_get_hyp(ps, NULL, NULL);
+    return hyp ? hyp : "";
+}
+
+/* Write n keyphrases of one or two words from the dictionary. */
+static void
+write_list(ps_decoder_t *ps, int n)
+{
+    dict_t *dict = ps->dict;
+    int32 *wids;
+    int32 w, n_wids;
+    FILE *fh;
+    int i;
+
+    wids = ckd_calloc(dict_size(dict), sizeof(*wids));
+    n_wids = 0;
+    for (w = 0; w < dict_size(dict); ++w) {
+        if (dict_filler_word(dict, w) || dict_basewid(dict, w) != w
+            || w == dict_startwid(dict) || w == dict_finishwid(dict))
+            continue;
+        wids[n_wids++] = w;
+    }
+    TEST_ASSERT(n <= n_wids * (n_wids + 1));
+    TEST_ASSERT(fh = fopen(KWS_LIST, "w"));
+    for (i = 0; i < n; ++i) {
+        if (i < n_wids)
+            fprintf(fh, "%s /1/\n", dict_wordstr(dict, wids[i]));
+        else
+            fprintf(fh, "%s %s /1/\n",
+                    dict_wordstr(dict, wids[(i - n_wids) % n_wids]),
+                    dict_wordstr(dict, wids[(i - n_wids) / n_wids]));
+    }
+    fclose(fh);
+    ckd_free(wids);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int sizes[] = { 10, 100, 1000, 5000 };
+    ps_decoder_t *ps;
+    cmd_ln_t *config;
+    kws_search_t *kwss;
+    char const *hyp;
+    FILE *fh;
+    int i;
+
+    TEST_ASSERT(config =
+                cmd_ln_init(NULL, ps_args(), TRUE,
+                            "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                            "-dict", MODELDIR "/lm/en/turtle.dic",
+                            "-keyphrase", "forward",
+                            "-kws_threshold", "1e-20",
+                            "-input_endian", "little",
+                            "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    hyp = decode(ps);
+    printf("forward: %s\n", hyp);
+    TEST_EQUAL(0, strcmp(hyp, "forward"));
+
+    /* Keyphrases sharing a prefix, one of them inside another. */
+    TEST_ASSERT(fh = fopen(KWS_LIST, "w"));
+    fprintf(fh, "go forward /1e-30/\n");
+    fprintf(fh, "go\n");
+    fprintf(fh, "ten meters /1e-30/\n");
+    fprintf(fh, "ten\n");
+    fprintf(fh, "go backward\n");
+    fclose(fh);
+    TEST_EQUAL(0, ps_set_kws(ps, "list", KWS_LIST));
+    TEST_EQUAL(0, ps_set_search(ps, "list"));
+    kwss = (kws_search_t *)ps->search;
+    /* go, forward, ten, meters and backward, minus the shared phones. */
+    TEST_EQUAL(22, kwss->n_nodes);
+    TEST_ASSERT(kwss->nodes[kwss->keyphrases[1].node].child != -1);
+    TEST_ASSERT(kwss->nodes[kwss->keyphrases[3].node].child != -1);
+    hyp = decode(ps);
+    printf("list: %s\n", hyp);
+    TEST_EQUAL(0, strcmp(hyp, "go go forward go ten meters go"));
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        ptmr_t tm;
+        char name[16];
+
+        write_list(ps, sizes[i]);
+        sprintf(name, "kws%d", sizes[i]);
+        TEST_EQUAL(0, ps_set_kws(ps, name, KWS_LIST));
+        TEST_EQUAL(0, ps_set_search(ps, name));
+        kwss = (kws_search_t *)ps->search;
+        TEST_EQUAL(sizes[i], kwss->n_keyphrases);
+        ptmr_init(&tm);
+        ptmr_start(&tm);
+        hyp = decode(ps);
+        ptmr_stop(&tm);
+        printf("%d keyphrases, %d HMMs: %.3f sec CPU, %.3f xRT\n",
+               sizes[i], kwss->n_nodes,
+               tm.t_cpu, tm.t_cpu * 100 / ps_get_n_frames(ps));
+    }
+    remove(KWS_LIST);
+
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+
+#include "pocketsphinx_internal.h"
+#include "ngram_search.h"
+#include "ps_lattice_internal.h"
+#include "test_macros.h"
+
+/*
+ * Check that bestpath and posterior computation over the sorted links
+ * of a lattice give exactly the same scores as a plain traversal of
+ * its link lists, report how long each of them took, and run an N-best
+ * search over it.
+ */
+
+#define N_ITER 100
+
+static int
+is_filler(ps_lattice_t *dag, ps_latnode_t *node)
+{
+    return dict_filler_word(dag->dict, node->basewid);
+}
+
+/* Forward pass, traversing link lists directly. */
+static void
+ref_bestpath(ps_lattice_t *dag, ngram_model_t *lmset,
+             float32 lwf, float32 ascale)
+{
+    ps_latnode_t *node;
+    ps_latlink_t *link;
+    latlink_list_t *x;
+    int32 n_used;
+
+    for (node = dag->nodes; node; node = node->next) {
+        for (x = node->exits; x; x = x->next) {
+            x->link->path_scr = MAX_NEG_INT32;
+            x->link->alpha = logmath_get_zero(dag->lmath);
+        }
+    }
+    for (x = dag->start->exits; x; x = x->next) {
+        if (is_filler(dag, x->link->to) && x->link->to != dag->end)
+            continue;
+        x->link->path_scr = x->link->ascr +
+            (ngram_bg_score(lmset, x->link->to->basewid,
+                            ps_search_start_wid(dag->search), &n_used)
+             >> SENSCR_SHIFT) * lwf;
+        x->link->alpha = 0;
+    }
+    for (link = ps_lattice_traverse_edges(dag, NULL, NULL);
+         link; link = ps_lattice_traverse_next(dag, NULL)) {
+        int32 bprob;
+
+        if (is_filler(dag, link->from) && link->from != dag->start)
+            continue;
+        if (is_filler(dag, link->to) && link->to != dag->end)
+            continue;
+        bprob = ngram_ng_prob(lmset, link->to->basewid,
+                              &link->from->basewid, 1, &n_used);
+        link->alpha += (link->ascr << SENSCR_SHIFT) * ascale;
+        for (x = link->to->exits; x; x = x->next) {
+            int32 score;
+
+            if (is_filler(dag, x->link->to) && x->link->to != dag->end)
+                continue;
+            x->link->alpha = logmath_add(dag->lmath, x->link->alpha,
+                                         link->alpha + bprob);
+            score = link->path_scr + x->link->ascr
+                + (ngram_tg_score(lmset, x->link->to->basewid,
+                                  link->to->basewid, link->from->basewid,
+                                  &n_used) >> SENSCR_SHIFT) * lwf;
+            if (score BETTER_THAN x->link->path_scr)
+                x->link->path_scr = score;
+        }
+    }
+}
+
+/* Backward pass, traversing link lists directly. */
+static void
+ref_posterior(ps_lattice_t *dag, ngram_model_t *lmset, float32 ascale)
+{
+    ps_latnode_t *node;
+    ps_latlink_t *link;
+    latlink_list_t *x;
+    int32 n_used;
+
+    for (node = dag->nodes; node; node = node->next)
+        for (x = node->exits; x; x = x->next)
+            x->link->beta = logmath_get_zero(dag->lmath);
+    for (link = ps_lattice_reverse_edges(dag, NULL, NULL);
+         link; link = ps_lattice_reverse_next(dag, NULL)) {
+        int32 bprob;
+
+        if (is_filler(dag, link->from) && link->from != dag->start)
+            continue;
+        if (is_filler(dag, link->to) && link->to != dag->end)
+            continue;
+        bprob = ngram_ng_prob(lmset, link->to->basewid,
+                              &link->from->basewid, 1, &n_used);
+        if (link->to == dag->end) {
+            link->beta = bprob
+                + (dag->final_node_ascr << SENSCR_SHIFT) * ascale;
+            continue;
+        }
+        for (x = link->to->exits; x; x = x->next) {
+            if (is_filler(dag, x->link->to) && x->link->to != dag->end)
+                continue;
+            link->beta = logmath_add(dag->lmath, link->beta,
+                                     x->link->beta + bprob
+                                     + (x->link->ascr << SENSCR_SHIFT) * ascale);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    ps_decoder_t *ps;
+    cmd_ln_t *config;
+    ps_lattice_t *dag;
+    ps_lattopo_t *topo;
+    ngram_model_t *lmset;
+    ps_astar_t *nbest;
+    ps_latpath_t *path;
+    FILE *rawfh;
+    int32 *alpha, *beta, *path_scr;
+    float32 lwf, ascale;
+    ptmr_t tm_ref, tm_topo;
+    int i, n;
+
+    TEST_ASSERT(config =
+                cmd_ln_init(NULL, ps_args(), TRUE,
+                            "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                            "-lm", MODELDIR "/lm/en/turtle.DMP",
+                            "-dict", MODELDIR "/lm/en/turtle.dic",
+                            "-fwdtree", "yes",
+                            "-fwdflat", "no",
+                            "-bestpath", "yes",
+                            "-input_endian", "little",
+                            "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    ps_decode_raw(ps, rawfh, "goforward", -1);
+    fclose(rawfh);
+    TEST_ASSERT(dag = ps_get_lattice(ps));
+    lmset = ((ngram_search_t *)ps->search)->lmset;
+    lwf = 1.0;
+    ascale = 1.0 / 20.0;
+
+    topo = ps_lattice_topo(dag);
+    printf("%d links, %d forward, %d reverse\n",
+           topo->n_links, topo->n_fwd, topo->n_rev);
+    TEST_ASSERT(topo->n_links > 0);
+    TEST_EQUAL(topo->n_fwd, topo->n_rev);
+
+    /* Reference scores. */
+    alpha = ckd_calloc(topo->n_links, sizeof(*alpha));
+    beta = ckd_calloc(topo->n_links, sizeof(*beta));
+    path_scr = ckd_calloc(topo->n_links, sizeof(*path_scr));
+    ptmr_init(&tm_ref);
+    ptmr_start(&tm_ref);
+    for (n = 0; n < N_ITER; ++n) {
+        ref_bestpath(dag, lmset, lwf, ascale);
+        ref_posterior(dag, lmset, ascale);
+    }
+    ptmr_stop(&tm_ref);
+    for (i = 0; i < topo->n_links; ++i) {
+        alpha[i] = topo->links[i]->alpha;
+        beta[i] = topo->links[i]->beta;
+        path_scr[i] = topo->links[i]->path_scr;
+    }
+
+    ptmr_init(&tm_topo);
+    ptmr_start(&tm_topo);
+    for (n = 0; n < N_ITER; ++n) {
+        TEST_ASSERT(ps_lattice_bestpath(dag, lmset, lwf, ascale));
+        ps_lattice_posterior(dag, lmset, ascale);
+    }
+    ptmr_stop(&tm_topo);
+    /* The lattice should not have been sorted again. */
+    TEST_ASSERT(topo == dag->topo);
+    for (i = 0; i < topo->n_links; ++i) {
+        TEST_EQUAL(alpha[i], topo->links[i]->alpha);
+        TEST_EQUAL(beta[i], topo->links[i]->beta);
+        TEST_EQUAL(path_scr[i], topo->links[i]->path_scr);
+    }
+    printf("traversal: %.3f sec, sorted: %.3f sec (%.2fx)\n",
+           tm_ref.t_cpu, tm_topo.t_cpu,
+           tm_topo.t_cpu > 0 ? tm_ref.t_cpu / tm_topo.t_cpu : 0.0);
+    ckd_free(alpha);
+    ckd_free(beta);
+    ckd_free(path_scr);
+
+    /* N-best search over the same lattice. */
+    TEST_ASSERT(nbest = ps_astar_start(dag, lmset, lwf, 0, -1, -1, -1));
+    n = 0;
+    while ((path = ps_astar_next(nbest)) != NULL && n < 20) {
+        TEST_ASSERT(nbest->n_path <= 500);
+        printf("NBEST %d: %s (%d)\n", n, ps_astar_hyp(nbest, path),
+               path->score);
+        ++n;
+    }
+    printf("%d tried, %d inserted, %d rejected\n", nbest->n_hyp_tried,
+           nbest->n_hyp_insert, nbest->n_hyp_reject);
+    TEST_ASSERT(n > 0);
+    ps_astar_finish(nbest);
+
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <pocketsphinx.h>
+
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/bio.h>
+
+#include "acmod.h"
+#include "tied_mgau_simd.h"
+#include "test_macros.h"
+
+/*
+ * Score an utterance with each available Gaussian evaluation kernel,
+ * check that the senone scores are identical to the scalar code, and
+ * report how long scoring took with each of them.  This is done for
+ * the semi-continuous model, and for a phonetically-tied one made
+ * from it by giving every CI phone its own copy of the codebook.
+ */
+
+#define MAX_FRAMES 1000
+#define MAX_SENONES 8192
+
+#define SC_DIR MODELDIR "/hmm/en_US/hub4wsj_sc_8k"
+#define PTM_MEAN "test_mgau_simd.means"
+#define PTM_VAR "test_mgau_simd.variances"
+
+/*
+ * Write n_cb copies of the single codebook in infn to outfn, with the
+ * means of each one moved a little so that they are not all the same.
+ */
+static void
+write_ptm(char const *infn, char const *outfn, int n_cb, float32 shift)
+{
+    FILE *fh;
+    char **argname, **argval;
+    int32 swap, n_feat, dims[3], veclen[8], n, i, j;
+    uint32 chksum = 0;
+    float32 *buf, *out;
+
+    TEST_ASSERT(fh = fopen(infn, "rb"));
+    TEST_EQUAL(0, bio_readhdr(fh, &argname, &argval, &swap));
+    bio_hdrarg_free(argname, argval);
+    /* n_mgau, n_feat, n_density, then the length of each stream */
+    TEST_EQUAL(3, bio_fread(dims, sizeof(int32), 3, fh, swap, &chksum));
+    TEST_EQUAL(1, dims[0]);
+    n_feat = dims[1];
+    TEST_ASSERT(n_feat <= 8);
+    TEST_EQUAL(n_feat, bio_fread(veclen, sizeof(int32), n_feat,
+                                 fh, swap, &chksum));
+    TEST_EQUAL(1, bio_fread(&n, sizeof(int32), 1, fh, swap, &chksum));
+    buf = ckd_calloc(n, sizeof(*buf));
+    TEST_EQUAL(n, bio_fread(buf, sizeof(*buf), n, fh, swap, &chksum));
+    fclose(fh);
+
+    out = ckd_calloc(n, sizeof(*out));
+    TEST_ASSERT(fh = fopen(outfn, "wb"));
+    bio_writehdr_version(fh, "1.0");
+    dims[0] = n_cb;
+    fwrite(dims, sizeof(int32), 3, fh);
+    fwrite(veclen, sizeof(int32), n_feat, fh);
+    i = n * n_cb;
+    fwrite(&i, sizeof(int32), 1, fh);
+    for (i = 0; i < n_cb; ++i) {
+        for (j = 0; j < n; ++j)
+            out[j] = buf[j] + shift * i;
+        TEST_EQUAL(n, fwrite(out, sizeof(*out), n, fh));
+    }
+    fclose(fh);
+    ckd_free(out);
+    ckd_free(buf);
+}
+
+static int
+score_utt(char const *simd, char const *mean, char const *var,
+          char const *mgau, int16 *scores, int *out_n_sen, double *out_time)
+{
+    acmod_t *acmod;
+    logmath_t *lmath;
+    cmd_ln_t *config;
+    FILE *rawfh;
+    int16 *buf;
+    ptmr_t tm;
+    int nfr, n_sen;
+
+    lmath = logmath_init(1.0001, 0, 0);
+    config = cmd_ln_init(NULL, ps_args(), TRUE,
+                 "-featparams", SC_DIR "/feat.params",
+                 "-mdef", SC_DIR "/mdef",
+                 "-mean", mean,
+                 "-var", var,
+                 "-tmat", SC_DIR "/transition_matrices",
+                 "-sendump", SC_DIR "/sendump",
+                 "-compallsen", "true",
+                 "-cmn", "current",
+                 "-topn", "4",
+                 "-simd", simd,
+                 "-input_endian", "little",
+                 "-samprate", "16000", NULL);
+    TEST_ASSERT(config);
+    TEST_ASSERT(acmod = acmod_init(config, lmath, NULL, NULL));
+    TEST_EQUAL(0, strcmp(mgau, acmod->mgau->vt->name));
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    TEST_ASSERT(n_sen <= MAX_SENONES);
+
+    /* Compute features for the whole utterance up front so that only
+     * scoring is timed. */
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    buf = ckd_calloc(160000, sizeof(*buf));
+    TEST_EQUAL(0, acmod_set_grow(acmod, TRUE));
+    TEST_EQUAL(0, acmod_start_utt(acmod));
+    while (!feof(rawfh)) {
+        int16 const *bptr = buf;
+        size_t nread = fread(buf, sizeof(*buf), 160000, rawfh);
+        while (nread > 0)
+            acmod_process_raw(acmod, &bptr, &nread, TRUE);
+    }
+    fclose(rawfh);
+    ckd_free(buf);
+    TEST_EQUAL(0, acmod_end_utt(acmod));
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    nfr = 0;
+    while (acmod->n_feat_frame > 0 && nfr < MAX_FRAMES) {
+        int16 const *senscr;
+        int frame_idx = -1;
+
+        senscr = acmod_score(acmod, &frame_idx);
+        memcpy(scores + nfr * n_sen, senscr, n_sen * sizeof(*scores));
+        acmod_advance(acmod);
+        ++nfr;
+    }
+    ptmr_stop(&tm);
+
+    *out_n_sen = n_sen;
+    *out_time = tm.t_cpu;
+    acmod_free(acmod);
+    logmath_free(lmath);
+    cmd_ln_free_r(config);
+    return nfr;
+}
+
+static void
+test_model(char const *mean, char const *var, char const *mgau)
+{
+    int16 *ref, *scores;
+    double ref_time;
+    int ref_nfr, n_sen, i;
+
+    ref = ckd_calloc(MAX_FRAMES * MAX_SENONES, sizeof(*ref));
+    scores = ckd_calloc(MAX_FRAMES * MAX_SENONES, sizeof(*scores));
+
+    ref_nfr = score_utt("none", mean, var, mgau, ref, &n_sen, &ref_time);
+    TEST_ASSERT(ref_nfr > 0);
+    printf("%-8s %-6s %d frames %.3f sec\n", mgau, "none", ref_nfr, ref_time);
+
+    for (i = MGAU_SIMD_NONE + 1; i <= MGAU_SIMD_NEON; ++i) {
+        double t;
+        int nfr;
+
+        if (!mgau_simd_supported(i)) {
+            printf("%-8s %-6s not supported\n", mgau, mgau_simd_name(i));
+            continue;
+        }
+        nfr = score_utt(mgau_simd_name(i), mean, var, mgau,
+                        scores, &n_sen, &t);
+        TEST_EQUAL(ref_nfr, nfr);
+        TEST_EQUAL(0, memcmp(ref, scores, nfr * n_sen * sizeof(*ref)));
+        printf("%-8s %-6s %d frames %.3f sec (%.2fx)\n", mgau,
+               mgau_simd_name(i), nfr, t, t > 0 ? ref_time / t : 0.0);
+    }
+
+    ckd_free(ref);
+    ckd_free(scores);
+}
+
+int
+main(int argc, char *argv[])
+{
+    bin_mdef_t *mdef;
+    int n_ci;
+
+    test_model(SC_DIR "/means", SC_DIR "/variances", "s2_semi");
+
+    TEST_ASSERT(mdef = bin_mdef_read(NULL, SC_DIR "/mdef"));
+    n_ci = bin_mdef_n_ciphone(mdef);
+    bin_mdef_free(mdef);
+    write_ptm(SC_DIR "/means", PTM_MEAN, n_ci, 0.01f);
+    write_ptm(SC_DIR "/variances", PTM_VAR, n_ci, 0.0f);
+    test_model(PTM_MEAN, PTM_VAR, "ptm");
+    remove(PTM_MEAN);
+    remove(PTM_VAR);
+
+    return 0;
+}
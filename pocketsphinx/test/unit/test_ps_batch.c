@@ -0,0 +1,142 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+#include <sphinxbase/strfuncs.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Decode a few utterances one at a time, then all together in
+ * lockstep, which should give exactly the same results.
+ */
+
+#define N_UTT 3
+
+static char const *utts[N_UTT] = { "goforward", "numbers", "something" };
+
+static int16 *
+read_raw(char const *name, size_t *out_nsamp)
+{
+    FILE *rawfh;
+    char *path;
+    int16 *data;
+    long len;
+
+    path = string_join(DATADIR, "/", name, ".raw", NULL);
+    TEST_ASSERT(rawfh = fopen(path, "rb"));
+    fseek(rawfh, 0, SEEK_END);
+    len = ftell(rawfh) / sizeof(*data);
+    fseek(rawfh, 0, SEEK_SET);
+    data = ckd_calloc(len, sizeof(*data));
+    *out_nsamp = fread(data, sizeof(*data), len, rawfh);
+    fclose(rawfh);
+    ckd_free(path);
+    return data;
+}
+
+static void
+test_model(cmd_ln_t *config)
+{
+    ps_model_t *model;
+    ps_decoder_t *decoders[N_UTT];
+    int16 *data[N_UTT];
+    size_t nsamp[N_UTT];
+    char *hyps[N_UTT];
+    int32 scores[N_UTT];
+    ptmr_t tm_ref, tm_batch;
+    int i, nfr;
+
+    TEST_ASSERT(model = ps_model_init(config));
+    for (i = 0; i < N_UTT; ++i)
+        data[i] = read_raw(utts[i], &nsamp[i]);
+
+    /* Each utterance on its own. */
+    ptmr_init(&tm_ref);
+    for (i = 0; i < N_UTT; ++i) {
+        ps_decoder_t *ps;
+        char const *hyp;
+
+        TEST_ASSERT(ps = ps_init_model(model));
+        ptmr_start(&tm_ref);
+        ps_start_utt(ps, utts[i]);
+        TEST_ASSERT(ps_process_raw(ps, data[i], nsamp[i], FALSE, TRUE) > 0);
+        TEST_EQUAL(0, ps_end_utt(ps));
+        ptmr_stop(&tm_ref);
+        hyp = ps_get_hyp(ps, &scores[i], NULL);
+        hyps[i] = ckd_salloc(hyp ? hyp : "");
+        printf("%s: %s (%d)\n", utts[i], hyps[i], scores[i]);
+        ps_free(ps);
+    }
+
+    /* All of them together. */
+    for (i = 0; i < N_UTT; ++i)
+        TEST_ASSERT(decoders[i] = ps_init_model(model));
+    ptmr_init(&tm_batch);
+    ptmr_start(&tm_batch);
+    for (i = 0; i < N_UTT; ++i) {
+        ps_start_utt(decoders[i], utts[i]);
+        TEST_EQUAL(0, ps_process_raw(decoders[i], data[i], nsamp[i],
+                                     TRUE, TRUE));
+    }
+    nfr = ps_search_batch(decoders, N_UTT);
+    for (i = 0; i < N_UTT; ++i)
+        TEST_EQUAL(0, ps_end_utt(decoders[i]));
+    ptmr_stop(&tm_batch);
+    TEST_ASSERT(nfr > 0);
+    for (i = 0; i < N_UTT; ++i) {
+        char const *hyp;
+        int32 score;
+        ps_stats_t stats;
+
+        hyp = ps_get_hyp(decoders[i], &score, NULL);
+        ps_get_utt_stats(decoders[i], &stats);
+        printf("%s: %s (%d), %.3f sec scoring\n", utts[i], hyp, score,
+               stats.t_mgau);
+        TEST_EQUAL(0, strcmp(hyp ? hyp : "", hyps[i]));
+        TEST_EQUAL(score, scores[i]);
+        /* Each of them is charged for scoring, not just the first. */
+        TEST_ASSERT(stats.t_mgau > 0);
+    }
+    printf("%d frames, one at a time: %.3f sec, together: %.3f sec CPU\n",
+           nfr, tm_ref.t_cpu, tm_batch.t_cpu);
+
+    for (i = 0; i < N_UTT; ++i) {
+        ps_free(decoders[i]);
+        ckd_free(data[i]);
+        ckd_free(hyps[i]);
+    }
+    ps_model_free(model);
+}
+
+int
+main(int argc, char *argv[])
+{
+    cmd_ln_t *config;
+
+    /* Continuous model, whose codebooks are evaluated together. */
+    TEST_ASSERT(config =
+                cmd_ln_init(NULL, ps_args(), TRUE,
+                            "-hmm", DATADIR "/an4_ci_cont",
+                            "-lm", MODELDIR "/lm/en/turtle.DMP",
+                            "-dict", MODELDIR "/lm/en/turtle.dic",
+                            "-input_endian", "little",
+                            "-samprate", "16000", NULL));
+    test_model(config);
+    cmd_ln_free_r(config);
+
+    /* Semi-continuous model, scored separately, with a grammar. */
+    TEST_ASSERT(config =
+                cmd_ln_init(NULL, ps_args(), TRUE,
+                            "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                            "-fsg", DATADIR "/goforward.fsg",
+                            "-dict", MODELDIR "/lm/en/turtle.dic",
+                            "-input_endian", "little",
+                            "-samprate", "16000", NULL));
+    test_model(config);
+    cmd_ln_free_r(config);
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+#include "ps_test.c"
+
+static cmd_ln_t *
+bpgc_config(char const *bpgc)
+{
+    cmd_ln_t *config;
+
+    /* Small -latsize so that the backpointer table gets garbage
+     * collected many times in the utterance. */
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                "-lm", MODELDIR "/lm/en_US/wsj0vp.5000.DMP",
+                "-dict", MODELDIR "/lm/en_US/cmu07a.dic",
+                "-fwdtree", "yes",
+                "-fwdflat", "no",
+                "-bestpath", "no",
+                "-bpgc", bpgc,
+                "-latsize", "256",
+                "-input_endian", "little",
+                "-samprate", "16000", NULL));
+    return config;
+}
+
+/* Decode the test file n_rep times over as a single utterance. */
+static void
+decode_long(char const *bpgc, int n_rep, ps_stats_t *stats)
+{
+    cmd_ln_t *config;
+    ps_decoder_t *ps;
+    FILE *rawfh;
+    int16 buf[2048];
+    int i;
+
+    config = bpgc_config(bpgc);
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(0, ps_start_utt(ps, NULL));
+    for (i = 0; i < n_rep; ++i) {
+        fseek(rawfh, 0, SEEK_SET);
+        while (!feof(rawfh)) {
+            size_t nread = fread(buf, sizeof(*buf), 2048, rawfh);
+            TEST_ASSERT(ps_process_raw(ps, buf, nread, FALSE, FALSE) >= 0);
+        }
+        clearerr(rawfh);
+    }
+    fclose(rawfh);
+    TEST_EQUAL(0, ps_end_utt(ps));
+    ps_get_utt_stats(ps, stats);
+    printf("-bpgc %s, %d times: %s\n"
+           "%lld bps, %lld retired, at most %lld at once\n",
+           bpgc, n_rep, ps_get_hyp(ps, NULL, NULL),
+           (long long)stats->n_bp, (long long)stats->n_bp_retired,
+           (long long)stats->n_bp_peak);
+    ps_free(ps);
+    cmd_ln_free_r(config);
+}
+
+int
+main(int argc, char *argv[])
+{
+    ps_stats_t one, many, nogc;
+
+    TEST_EQUAL(0, ps_decoder_test(bpgc_config("yes"), "BPGC",
+                                  "go forward ten leaders"));
+
+    /* Garbage collection has to actually happen... */
+    decode_long("yes", 1, &one);
+    TEST_ASSERT(one.n_bp_retired > 0);
+    decode_long("yes", 8, &many);
+    TEST_ASSERT(many.n_bp_retired > one.n_bp_retired);
+    /* ...and keep the table from growing with the utterance. */
+    TEST_ASSERT(many.n_bp > 4 * one.n_bp);
+    TEST_ASSERT(many.n_bp_peak < 2 * one.n_bp_peak);
+    /* Without it, everything is kept. */
+    decode_long("no", 8, &nogc);
+    TEST_EQUAL(0, nogc.n_bp_retired);
+    TEST_EQUAL(nogc.n_bp, nogc.n_bp_peak);
+    TEST_ASSERT(many.n_bp_peak < nogc.n_bp_peak / 4);
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Poll for partial hypotheses while decoding, and check that the
+ * stable part of each one is never changed by later ones, and that
+ * they agree with ps_get_hyp().
+ */
+
+static void
+decode(ps_decoder_t *ps, char const *expected)
+{
+    FILE *rawfh;
+    int16 buf[512];
+    char *stable, *hyp_copy;
+    char const *hyp;
+    int32 n_stable, score, hyp_score;
+
+    stable = ckd_calloc(1, 1);
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(0, ps_start_utt(ps, NULL));
+    while (!feof(rawfh)) {
+        size_t nread = fread(buf, sizeof(*buf), 512, rawfh);
+        TEST_ASSERT(ps_process_raw(ps, buf, nread, FALSE, FALSE) >= 0);
+        if ((hyp = ps_get_hyp_stable(ps, &score, &n_stable)) == NULL)
+            continue;
+        TEST_ASSERT(n_stable >= 0 && n_stable <= strlen(hyp));
+        TEST_EQUAL(0, strncmp(hyp, stable, strlen(stable)));
+        if (n_stable > strlen(stable)) {
+            stable = ckd_realloc(stable, n_stable + 1);
+            memcpy(stable, hyp, n_stable);
+            stable[n_stable] = '\0';
+            printf("stable: %s\n", stable);
+        }
+        /* A full backtrace gives the same result. */
+        hyp_copy = ckd_salloc(hyp);
+        ckd_free(ps->search->hyp_str);
+        ps->search->hyp_str = NULL;
+        TEST_EQUAL(0, strcmp(hyp_copy, ps_get_hyp(ps, &hyp_score, NULL)));
+        TEST_EQUAL(score, hyp_score);
+        ckd_free(hyp_copy);
+    }
+    fclose(rawfh);
+    TEST_EQUAL(0, ps_end_utt(ps));
+    TEST_ASSERT(hyp = ps_get_hyp_stable(ps, NULL, &n_stable));
+    printf("final: %s\n", hyp);
+    TEST_EQUAL(0, strcmp(hyp, expected));
+    TEST_EQUAL(n_stable, strlen(hyp));
+    TEST_EQUAL(0, strncmp(hyp, stable, strlen(stable)));
+    /* Some words should have become stable before the end. */
+    TEST_ASSERT(strlen(stable) > 0);
+    ckd_free(stable);
+}
+
+int
+main(int argc, char *argv[])
+{
+    cmd_ln_t *config;
+    ps_decoder_t *ps;
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                "-lm", MODELDIR "/lm/en/turtle.DMP",
+                "-dict", MODELDIR "/lm/en/turtle.dic",
+                "-fwdflat", "no",
+                "-bestpath", "no",
+                "-input_endian", "little",
+                "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    decode(ps, "go forward ten meters");
+    ps_free(ps);
+
+    /* Again, with the backpointer table garbage collected. */
+    cmd_ln_set_boolean_r(config, "-bpgc", TRUE);
+    cmd_ln_set_int32_r(config, "-latsize", 256);
+    TEST_ASSERT(ps = ps_init(config));
+    decode(ps, "go forward ten meters");
+    ps_free(ps);
+
+    /* Flat lexicon search only. */
+    cmd_ln_set_boolean_r(config, "-fwdtree", FALSE);
+    cmd_ln_set_boolean_r(config, "-fwdflat", TRUE);
+    TEST_ASSERT(ps = ps_init(config));
+    decode(ps, "go forward ten meters");
+    ps_free(ps);
+    cmd_ln_free_r(config);
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                "-fsg", DATADIR "/goforward.fsg",
+                "-dict", MODELDIR "/lm/en/turtle.dic",
+                "-bestpath", "no",
+                "-input_endian", "little",
+                "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    decode(ps, "go forward ten meters");
+    ps_free(ps);
+    cmd_ln_free_r(config);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Decode with and without language model lookahead in the lexicon
+ * tree, which should give the same result with narrower beams and
+ * fewer HMMs evaluated.
+ */
+
+static char *
+decode(char const *lmla, char const *cache, char const *beam,
+       int32 *out_score, int64 *out_n_hmm)
+{
+    ps_decoder_t *ps;
+    cmd_ln_t *config;
+    ps_stats_t stats;
+    FILE *rawfh;
+    char const *hyp;
+    char *rv;
+
+    TEST_ASSERT(config =
+                cmd_ln_init(NULL, ps_args(), TRUE,
+                            "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                            "-lm", MODELDIR "/lm/en/turtle.DMP",
+                            "-dict", MODELDIR "/lm/en/turtle.dic",
+                            "-fwdflat", "no",
+                            "-bestpath", "no",
+                            "-lmla", lmla,
+                            "-lmlacache", cache,
+                            "-beam", beam,
+                            "-pbeam", beam,
+                            "-input_endian", "little",
+                            "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    ps_decode_raw(ps, rawfh, "goforward", -1);
+    fclose(rawfh);
+    hyp = ps_get_hyp(ps, out_score, NULL);
+    ps_get_utt_stats(ps, &stats);
+    *out_n_hmm = stats.n_root_hmm_eval + stats.n_nonroot_hmm_eval
+        + stats.n_word_hmm_eval;
+    printf("lmla %s cache %s beam %s: %s (%d), %ld HMMs\n",
+           lmla, cache, beam, hyp, *out_score, (long)*out_n_hmm);
+    rv = ckd_salloc(hyp ? hyp : "");
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    return rv;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *ref, *hyp;
+    int32 ref_score, score, score2;
+    int64 ref_n_hmm, n_hmm;
+
+    ref = decode("no", "32", "1e-48", &ref_score, &ref_n_hmm);
+    TEST_EQUAL(0, strcmp(ref, "go forward ten meters"));
+
+    /* The lookahead is taken back off at word ends, so the best path
+     * has the same score. */
+    hyp = decode("yes", "32", "1e-48", &score, &n_hmm);
+    TEST_EQUAL(0, strcmp(hyp, ref));
+    TEST_EQUAL(score, ref_score);
+    TEST_ASSERT(n_hmm < ref_n_hmm);
+    ckd_free(hyp);
+
+    /* Much narrower beams still find it. */
+    hyp = decode("yes", "32", "1e-30", &score, &n_hmm);
+    TEST_EQUAL(0, strcmp(hyp, ref));
+    TEST_EQUAL(score, ref_score);
+    TEST_ASSERT(n_hmm < ref_n_hmm / 2);
+    ckd_free(hyp);
+
+    /* Replacing cached bigram scores doesn't change anything. */
+    hyp = decode("yes", "1", "1e-30", &score2, &n_hmm);
+    TEST_EQUAL(0, strcmp(hyp, ref));
+    TEST_EQUAL(score2, score);
+    ckd_free(hyp);
+
+    /* Nor does using only unigrams here. */
+    hyp = decode("yes", "0", "1e-30", &score, &n_hmm);
+    TEST_EQUAL(0, strcmp(hyp, ref));
+    TEST_EQUAL(score, ref_score);
+    ckd_free(hyp);
+
+    ckd_free(ref);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+#include <sphinxbase/sbthread.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Create several decoders from one shared model, decode with them
+ * concurrently, and check that they agree with a standalone decoder.
+ */
+
+#define N_DECODERS 4
+
+typedef struct result_s {
+    ps_decoder_t *ps;
+    char hyp[256];
+    int32 score;
+} result_t;
+
+static cmd_ln_t *
+make_config(void)
+{
+    cmd_ln_t *config;
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                "-lm", MODELDIR "/lm/en/turtle.DMP",
+                "-dict", MODELDIR "/lm/en/turtle.dic",
+                "-input_endian", "little",
+                "-samprate", "16000", NULL));
+    return config;
+}
+
+static int
+decode(result_t *res)
+{
+    FILE *rawfh;
+    char const *hyp;
+    int i;
+
+    /* Decode twice to make sure the decoder can be reused. */
+    for (i = 0; i < 2; ++i) {
+        if ((rawfh = fopen(DATADIR "/goforward.raw", "rb")) == NULL)
+            return -1;
+        if (ps_decode_raw(res->ps, rawfh, NULL, -1) < 0)
+            return -1;
+        fclose(rawfh);
+    }
+    if ((hyp = ps_get_hyp(res->ps, &res->score, NULL)) == NULL)
+        return -1;
+    strcpy(res->hyp, hyp);
+    return 0;
+}
+
+static int
+decode_main(sbthread_t *th)
+{
+    return decode(sbthread_arg(th));
+}
+
+int
+main(int argc, char *argv[])
+{
+    result_t ref, res[N_DECODERS];
+    sbthread_t *threads[N_DECODERS];
+    ps_model_t *model;
+    cmd_ln_t *config;
+    ptmr_t tm;
+    int i;
+
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    config = make_config();
+    TEST_ASSERT(ref.ps = ps_init(config));
+    ptmr_stop(&tm);
+    cmd_ln_free_r(config);
+    printf("ps_init(): %.3f sec\n", tm.t_elapsed);
+    TEST_ASSERT(ps_get_model(ref.ps) == NULL);
+    TEST_EQUAL(0, decode(&ref));
+    TEST_EQUAL(0, strcmp(ref.hyp, "go forward ten meters"));
+
+    config = make_config();
+    TEST_ASSERT(model = ps_model_init(config));
+    cmd_ln_free_r(config);
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    for (i = 0; i < N_DECODERS; ++i) {
+        TEST_ASSERT(res[i].ps = ps_init_model(model));
+        TEST_ASSERT(ps_get_model(res[i].ps) == model);
+    }
+    ptmr_stop(&tm);
+    printf("ps_init_model(): %.3f sec\n", tm.t_elapsed / N_DECODERS);
+    /* Decoders keep the model alive. */
+    TEST_EQUAL(N_DECODERS, ps_model_free(model));
+
+    /* Shared parameters are read-only. */
+    TEST_ASSERT(ps_add_word(res[0].ps, "foobie", "F UW B IY", TRUE) < 0);
+    TEST_ASSERT(ps_load_dict(res[0].ps, MODELDIR "/lm/en/turtle.dic",
+                             NULL, NULL) < 0);
+
+    for (i = 0; i < N_DECODERS; ++i)
+        TEST_ASSERT(threads[i] = sbthread_start(NULL, decode_main, res + i));
+    for (i = 0; i < N_DECODERS; ++i) {
+        TEST_EQUAL(0, sbthread_wait(threads[i]));
+        sbthread_free(threads[i]);
+        TEST_EQUAL(0, strcmp(ref.hyp, res[i].hyp));
+        TEST_EQUAL(ref.score, res[i].score);
+    }
+
+    /* A new configuration detaches the decoder from the model. */
+    config = make_config();
+    TEST_EQUAL(0, ps_reinit(res[0].ps, config));
+    TEST_ASSERT(ps_get_model(res[0].ps) == NULL);
+    cmd_ln_free_r(config);
+    TEST_EQUAL(0, decode(res));
+    TEST_EQUAL(0, strcmp(ref.hyp, res[0].hyp));
+
+    for (i = 0; i < N_DECODERS; ++i)
+        ps_free(res[i].ps);
+    ps_free(ref.ps);
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Decode with a grammar and with keyword spotting separately, then
+ * both at once, which should give the same results while scoring no
+ * more senones than the two separate passes.
+ */
+
+static char *
+decode(ps_decoder_t *ps, int32 *out_n_sen, double *out_cpu)
+{
+    FILE *rawfh;
+    char const *hyp;
+    ptmr_t tm;
+
+    ptmr_init(&tm);
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    ptmr_start(&tm);
+    ps_decode_raw(ps, rawfh, "goforward", -1);
+    ptmr_stop(&tm);
+    fclose(rawfh);
+    hyp = ps_get_hyp(ps, NULL, NULL);
+    *out_n_sen = ps->acmod->n_senone_eval;
+    *out_cpu = tm.t_cpu;
+    return ckd_salloc(hyp ? hyp : "");
+}
+
+int
+main(int argc, char *argv[])
+{
+    ps_decoder_t *ps;
+    cmd_ln_t *config;
+    char *fsg_hyp, *kws_hyp, *hyp;
+    char const *kws_par_hyp;
+    int32 fsg_sen, kws_sen, n_sen, par_sen;
+    double fsg_cpu, kws_cpu, cpu;
+
+    TEST_ASSERT(config =
+                cmd_ln_init(NULL, ps_args(), TRUE,
+                            "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                            "-fsg", DATADIR "/goforward.fsg",
+                            "-dict", MODELDIR "/lm/en/turtle.dic",
+                            "-kws_threshold", "1e-20",
+                            "-input_endian", "little",
+                            "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    TEST_EQUAL(0, ps_set_keyphrase(ps, "kws", "forward"));
+
+    /* Each search on its own. */
+    fsg_hyp = decode(ps, &fsg_sen, &fsg_cpu);
+    printf("fsg: %s (%d senones, %.3f sec)\n", fsg_hyp, fsg_sen, fsg_cpu);
+    TEST_EQUAL(0, strcmp(fsg_hyp, "go forward ten meters"));
+    TEST_EQUAL(0, ps_set_search(ps, "kws"));
+    kws_hyp = decode(ps, &kws_sen, &kws_cpu);
+    printf("kws: %s (%d senones, %.3f sec)\n", kws_hyp, kws_sen, kws_cpu);
+    TEST_EQUAL(0, strcmp(kws_hyp, "forward"));
+    /* Only searches being run have a hypothesis. */
+    TEST_ASSERT(ps_get_search_hyp(ps, PS_DEFAULT_SEARCH, NULL) == NULL);
+    TEST_ASSERT(ps_get_search_hyp(ps, "kws", NULL) != NULL);
+
+    /* Both at once. */
+    TEST_EQUAL(0, ps_set_search(ps, PS_DEFAULT_SEARCH));
+    TEST_EQUAL(-1, ps_add_parallel_search(ps, "nosuchsearch"));
+    TEST_EQUAL(0, ps_add_parallel_search(ps, "kws"));
+    TEST_EQUAL(0, ps_add_parallel_search(ps, "kws"));
+    TEST_EQUAL(1, ps->n_parallel);
+    hyp = decode(ps, &n_sen, &cpu);
+    kws_par_hyp = ps_get_search_hyp(ps, "kws", NULL);
+    printf("fsg+kws: %s / %s (%d senones, %.3f sec)\n",
+           hyp, kws_par_hyp, n_sen, cpu);
+    TEST_EQUAL(0, strcmp(hyp, fsg_hyp));
+    TEST_EQUAL(0, strcmp(kws_par_hyp, kws_hyp));
+    TEST_EQUAL(0, strcmp(ps_get_search_hyp(ps, PS_DEFAULT_SEARCH, NULL),
+                         fsg_hyp));
+    TEST_ASSERT(n_sen <= fsg_sen + kws_sen);
+    ckd_free(hyp);
+
+    /* Replacing the search keeps it running in parallel. */
+    TEST_EQUAL(0, ps_set_keyphrase(ps, "kws", "go"));
+    TEST_EQUAL(1, ps->n_parallel);
+    hyp = decode(ps, &n_sen, &cpu);
+    printf("fsg+kws: %s / %s\n", hyp, ps_get_search_hyp(ps, "kws", NULL));
+    TEST_EQUAL(0, strcmp(hyp, fsg_hyp));
+    ckd_free(hyp);
+
+    /* Spotting along with an N-Gram search. */
+    TEST_EQUAL(0, ps_set_lm_file(ps, "lm", MODELDIR "/lm/en/turtle.DMP"));
+    TEST_EQUAL(0, ps_set_search(ps, "lm"));
+    TEST_EQUAL(0, ps_remove_parallel_search(ps, "kws"));
+    TEST_EQUAL(-1, ps_remove_parallel_search(ps, "kws"));
+    ckd_free(fsg_hyp);
+    fsg_hyp = decode(ps, &fsg_sen, &fsg_cpu);
+    TEST_EQUAL(0, ps_add_parallel_search(ps, "kws"));
+    hyp = decode(ps, &par_sen, &cpu);
+    printf("lm: %s (%d senones), lm+kws: %s / %s (%d senones)\n",
+           fsg_hyp, fsg_sen, hyp, ps_get_search_hyp(ps, "kws", NULL), par_sen);
+    TEST_EQUAL(0, strcmp(hyp, fsg_hyp));
+    TEST_EQUAL(0, strcmp(ps_get_search_hyp(ps, "kws", NULL), "go go go"));
+    ckd_free(hyp);
+
+    /* And removing it stops it. */
+    TEST_EQUAL(0, ps_unset_search(ps, "kws"));
+    TEST_EQUAL(0, ps->n_parallel);
+    hyp = decode(ps, &n_sen, &cpu);
+    TEST_EQUAL(0, strcmp(hyp, fsg_hyp));
+    /* Not exactly the same as the first time, as CMN has moved on. */
+    TEST_ASSERT(n_sen < par_sen);
+    ckd_free(hyp);
+
+    ckd_free(fsg_hyp);
+    ckd_free(kws_hyp);
+    ps_free(ps);
+    cmd_ln_free_r(config);
+    return 0;
+}
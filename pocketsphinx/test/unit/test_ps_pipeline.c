@@ -0,0 +1,163 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Decode an utterance block by block with and without -pipeline, and
+ * check that the hypotheses and word segmentations are identical, and
+ * that partial results can be examined while the pipeline runs.
+ */
+
+#define MAX_SEGS 64
+
+typedef struct result_s {
+    char hyp[256];
+    int32 score;
+    int n_frames;
+    int n_segs;
+    char words[MAX_SEGS][32];
+    int sf[MAX_SEGS], ef[MAX_SEGS];
+    double latency;
+} result_t;
+
+/* Walk a partial segmentation, which must be contiguous. */
+static void
+check_segs(ps_seg_t *seg)
+{
+    int prev_ef;
+
+    for (prev_ef = -1; seg; seg = ps_seg_next(seg)) {
+        int sf, ef;
+        TEST_ASSERT(ps_seg_word(seg));
+        ps_seg_frames(seg, &sf, &ef);
+        TEST_ASSERT(sf <= ef);
+        if (prev_ef >= 0)
+            TEST_EQUAL(prev_ef + 1, sf);
+        prev_ef = ef;
+    }
+}
+
+static void
+decode(char const *pipeline, char const *fwdflat, char const *bpgc,
+       result_t *res)
+{
+    cmd_ln_t *config;
+    ps_decoder_t *ps;
+    FILE *rawfh;
+    int16 buf[256];
+    ps_seg_t *seg;
+    char const *hyp;
+    ptmr_t tm;
+    int nfr, n_searched;
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                "-lm", MODELDIR "/lm/en/turtle.DMP",
+                "-dict", MODELDIR "/lm/en/turtle.dic",
+                "-fwdflat", fwdflat,
+                "-bestpath", "no",
+                "-bpgc", bpgc,
+                "-latsize", "256",
+                "-pipeline", pipeline,
+                "-input_endian", "little",
+                "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(0, ps_start_utt(ps, "goforward"));
+    n_searched = 0;
+    seg = NULL;
+    while (!feof(rawfh)) {
+        size_t nread = fread(buf, sizeof(*buf), 256, rawfh);
+        TEST_ASSERT((nfr = ps_process_raw(ps, buf, nread, FALSE, FALSE)) >= 0);
+        n_searched += nfr;
+        /* Partial hypotheses must be safe to get at any time. */
+        ps_get_hyp(ps, NULL, NULL);
+        /* As must segmentations.  With the pipeline, they stay valid
+         * while the search thread is given more audio. */
+        check_segs(seg);
+        seg = ps_seg_iter(ps, NULL);
+        if (strcmp(pipeline, "yes") != 0) {
+            check_segs(seg);
+            seg = NULL;
+        }
+        if (strcmp(pipeline, "yes") == 0)
+            TEST_ASSERT(NULL == ps_nbest(ps, 0, -1, NULL, NULL));
+    }
+    fclose(rawfh);
+    if (seg)
+        ps_seg_free(seg);
+    ptmr_init(&tm);
+    ptmr_start(&tm);
+    TEST_EQUAL(0, ps_end_utt(ps));
+    ptmr_stop(&tm);
+    res->latency = tm.t_elapsed;
+
+    hyp = ps_get_hyp(ps, &res->score, NULL);
+    TEST_ASSERT(hyp);
+    strcpy(res->hyp, hyp);
+    res->n_frames = ps_get_n_frames(ps);
+    TEST_ASSERT(n_searched <= res->n_frames);
+    res->n_segs = 0;
+    for (seg = ps_seg_iter(ps, NULL); seg; seg = ps_seg_next(seg)) {
+        TEST_ASSERT(res->n_segs < MAX_SEGS);
+        strcpy(res->words[res->n_segs], ps_seg_word(seg));
+        ps_seg_frames(seg, &res->sf[res->n_segs], &res->ef[res->n_segs]);
+        ++res->n_segs;
+    }
+    printf("-pipeline %s -fwdflat %s -bpgc %s: %s (%d), %d frames, "
+           "%d searched before end, %.3f sec in ps_end_utt()\n",
+           pipeline, fwdflat, bpgc, res->hyp, res->score, res->n_frames,
+           n_searched, res->latency);
+
+    ps_free(ps);
+    cmd_ln_free_r(config);
+}
+
+static void
+compare(result_t *ref, result_t *res)
+{
+    int i;
+
+    TEST_EQUAL(0, strcmp(ref->hyp, res->hyp));
+    TEST_EQUAL(ref->score, res->score);
+    TEST_EQUAL(ref->n_frames, res->n_frames);
+    TEST_EQUAL(ref->n_segs, res->n_segs);
+    for (i = 0; i < ref->n_segs; ++i) {
+        TEST_EQUAL(0, strcmp(ref->words[i], res->words[i]));
+        TEST_EQUAL(ref->sf[i], res->sf[i]);
+        TEST_EQUAL(ref->ef[i], res->ef[i]);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    result_t ref, res;
+
+    decode("no", "no", "no", &ref);
+    TEST_EQUAL(0, strcmp(ref.hyp, "go forward ten meters"));
+    decode("yes", "no", "no", &res);
+    compare(&ref, &res);
+
+    /* Garbage collect the backpointer table often, while partial
+     * segmentations are being walked. */
+    decode("no", "no", "yes", &ref);
+    decode("yes", "no", "yes", &res);
+    compare(&ref, &res);
+
+    /* Second pass search runs at the end of the utterance either way. */
+    decode("no", "yes", "no", &ref);
+    decode("yes", "yes", "no", &res);
+    TEST_EQUAL(0, strcmp(ref.hyp, res.hyp));
+    TEST_EQUAL(ref.score, res.score);
+    TEST_EQUAL(ref.n_frames, res.n_frames);
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <pocketsphinx.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sphinxbase/profile.h>
+
+#include "pocketsphinx_internal.h"
+#include "test_macros.h"
+
+/*
+ * Decode an utterance with and without -pipeline, and check that the
+ * performance counters are sensible, that they add up across
+ * utterances, and that they do not depend on the pipeline.
+ */
+
+static ps_decoder_t *
+init_decoder(char const *pipeline)
+{
+    cmd_ln_t *config;
+    ps_decoder_t *ps;
+
+    TEST_ASSERT(config =
+            cmd_ln_init(NULL, ps_args(), TRUE,
+                "-hmm", MODELDIR "/hmm/en_US/hub4wsj_sc_8k",
+                "-lm", MODELDIR "/lm/en/turtle.DMP",
+                "-dict", MODELDIR "/lm/en/turtle.dic",
+                "-fwdflat", "yes",
+                "-bestpath", "yes",
+                "-pipeline", pipeline,
+                "-input_endian", "little",
+                "-samprate", "16000", NULL));
+    TEST_ASSERT(ps = ps_init(config));
+    cmd_ln_free_r(config);
+    return ps;
+}
+
+static void
+decode(ps_decoder_t *ps, ps_stats_t *stats)
+{
+    FILE *rawfh;
+    int16 buf[2048];
+    ps_stats_t partial;
+
+    TEST_ASSERT(rawfh = fopen(DATADIR "/goforward.raw", "rb"));
+    TEST_EQUAL(0, ps_start_utt(ps, NULL));
+    ps_get_utt_stats(ps, &partial);
+    TEST_EQUAL(0, partial.n_frame);
+    TEST_EQUAL(0, partial.n_senone_eval);
+    while (!feof(rawfh)) {
+        size_t nread = fread(buf, sizeof(*buf), 2048, rawfh);
+        TEST_ASSERT(ps_process_raw(ps, buf, nread, FALSE, FALSE) >= 0);
+        /* Counters can be read while decoding. */
+        ps_get_utt_stats(ps, &partial);
+        TEST_ASSERT(partial.n_frame >= 0);
+    }
+    fclose(rawfh);
+    TEST_EQUAL(0, ps_end_utt(ps));
+    TEST_ASSERT(ps_get_hyp(ps, NULL, NULL));
+    ps_get_utt_stats(ps, stats);
+
+    TEST_ASSERT(stats->n_frame >= partial.n_frame);
+    TEST_EQUAL(stats->n_frame, ps_get_n_frames(ps) - 1);
+    TEST_ASSERT(stats->n_senone_eval > stats->n_frame);
+    TEST_ASSERT(stats->n_codebook_eval > 0);
+    TEST_ASSERT(stats->n_root_hmm_eval > 0);
+    TEST_ASSERT(stats->n_nonroot_hmm_eval > 0);
+    TEST_ASSERT(stats->n_word_hmm_eval > 0);
+    TEST_ASSERT(stats->n_bp > 0);
+    TEST_ASSERT(stats->n_bp_retired <= stats->n_bp);
+    TEST_ASSERT(stats->n_bp_peak > 0);
+    TEST_ASSERT(stats->n_bp_peak <= stats->n_bp);
+    TEST_ASSERT(stats->n_lm_lookup > 0);
+    TEST_ASSERT(stats->n_lm_cache_hit >= 0);
+    TEST_ASSERT(stats->t_fe > 0);
+    TEST_ASSERT(stats->t_feat >= 0);
+    TEST_ASSERT(stats->t_mgau > 0);
+    TEST_ASSERT(stats->t_search > 0);
+    TEST_ASSERT(stats->t_lattice >= 0);
+    printf("%lld frames, %lld senones, %lld codebooks, "
+           "%lld/%lld/%lld HMMs, %lld bps, %lld LM (%lld reused)\n",
+           (long long)stats->n_frame, (long long)stats->n_senone_eval,
+           (long long)stats->n_codebook_eval,
+           (long long)stats->n_root_hmm_eval,
+           (long long)stats->n_nonroot_hmm_eval,
+           (long long)stats->n_word_hmm_eval, (long long)stats->n_bp,
+           (long long)stats->n_lm_lookup, (long long)stats->n_lm_cache_hit);
+    printf("fe %.3f feat %.3f mgau %.3f search %.3f lattice %.3f sec\n",
+           stats->t_fe, stats->t_feat, stats->t_mgau,
+           stats->t_search, stats->t_lattice);
+}
+
+static void
+check_counts(ps_stats_t *a, ps_stats_t *b)
+{
+    TEST_EQUAL(a->n_frame, b->n_frame);
+    TEST_EQUAL(a->n_senone_eval, b->n_senone_eval);
+    TEST_EQUAL(a->n_codebook_eval, b->n_codebook_eval);
+    TEST_EQUAL(a->n_root_hmm_eval, b->n_root_hmm_eval);
+    TEST_EQUAL(a->n_nonroot_hmm_eval, b->n_nonroot_hmm_eval);
+    TEST_EQUAL(a->n_word_hmm_eval, b->n_word_hmm_eval);
+    TEST_EQUAL(a->n_bp, b->n_bp);
+    TEST_EQUAL(a->n_bp_retired, b->n_bp_retired);
+    TEST_EQUAL(a->n_bp_peak, b->n_bp_peak);
+    TEST_EQUAL(a->n_lm_lookup, b->n_lm_lookup);
+    TEST_EQUAL(a->n_lm_cache_hit, b->n_lm_cache_hit);
+}
+
+int
+main(int argc, char *argv[])
+{
+    ps_decoder_t *ps;
+    ps_stats_t ref, stats, all;
+    ptmr_t tm, inner;
+    int i;
+
+    ps = init_decoder("no");
+    decode(ps, &ref);
+    ps_get_all_stats(ps, &all);
+    check_counts(&ref, &all);
+    /* Cepstral mean normalization makes the second one different. */
+    decode(ps, &stats);
+    ps_get_all_stats(ps, &all);
+    TEST_EQUAL(ref.n_frame + stats.n_frame, all.n_frame);
+    TEST_EQUAL(ref.n_senone_eval + stats.n_senone_eval, all.n_senone_eval);
+    TEST_EQUAL(ref.n_bp + stats.n_bp, all.n_bp);
+    TEST_EQUAL(ref.n_bp_peak > stats.n_bp_peak
+               ? ref.n_bp_peak : stats.n_bp_peak, all.n_bp_peak);
+    TEST_ASSERT(all.t_mgau > stats.t_mgau);
+    TEST_ASSERT(all.t_lattice >= stats.t_lattice);
+    ps_free(ps);
+
+    ps = init_decoder("yes");
+    decode(ps, &stats);
+    check_counts(&ref, &stats);
+    ps_free(ps);
+
+    /* Cost of the timers, of which there are a few per frame. */
+    ptmr_init(&tm);
+    ptmr_init(&inner);
+    ptmr_start(&tm);
+    for (i = 0; i < 100000; ++i) {
+        ptmr_start(&inner);
+        ptmr_stop(&inner);
+    }
+    ptmr_stop(&tm);
+    printf("Timer overhead: %.2f usec per start/stop\n",
+           tm.t_elapsed / 100000 * 1e6);
+
+    return 0;
+}
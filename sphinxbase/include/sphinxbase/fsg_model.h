@@ -273,6 +273,30 @@ int32 fsg_model_tag_trans_add(fsg_model_t * fsg, int32 from, int32 to,
 SPHINXBASE_EXPORT
 glist_t fsg_model_null_trans_closure(fsg_model_t * fsg, glist_t nulls);
 
+/**
+ * Merge equivalent states of the given FSG.
+ *
+ * Two states are equivalent if they are both final or both not, and
+ * have transitions with the same words and probabilities to
+ * equivalent states.  Every path through the FSG is kept with the
+ * same words and score, so searching the minimized FSG gives the same
+ * results with less work.
+ *
+ * @return Newly created FSG with the same vocabulary, to be freed with
+ *         fsg_model_free().
+ */
+SPHINXBASE_EXPORT
+fsg_model_t *fsg_model_minimize(fsg_model_t *fsg);
+
+/**
+ * Make a copy of the given FSG, with the same states, transitions and
+ * vocabulary, which can be modified without affecting the original.
+ *
+ * @return Newly created FSG, to be freed with fsg_model_free().
+ */
+SPHINXBASE_EXPORT
+fsg_model_t *fsg_model_copy(fsg_model_t *fsg);
+
 /**
  * Get the list of transitions (if any) from state i to j.
  */
@@ -79,6 +79,7 @@ typedef enum ngram_file_type_e {
     NGRAM_ARPA,  /**< ARPABO text format (the standard). */
     NGRAM_DMP,   /**< Sphinx .DMP format. */
     NGRAM_DMP32, /**< Sphinx .DMP32 format (NOT SUPPORTED) */
+    NGRAM_TRIE,  /**< Memory-mappable trie format of any order. */
 } ngram_file_type_t;
 
 #define NGRAM_INVALID_WID -1 /**< Impossible word ID */
@@ -287,6 +287,18 @@ fe_init_auto_r(cmd_ln_t *config)
     fe->frame = ckd_calloc(fe->fft_size, sizeof(*fe->frame));
     fe->spec = ckd_calloc(fe->fft_size, sizeof(*fe->spec));
     fe->mfspec = ckd_calloc(fe->mel_fb->num_filters, sizeof(*fe->mfspec));
+#if FE_BATCH_SIZE > 1
+    /* Vectors have to be aligned to their size. */
+    fe->batch_buf = ckd_calloc(fe->fft_size * 2 + fe->mel_fb->num_filters + 1,
+                               sizeof(*fe->frames));
+    fe->frames = (fe_batch_t *)(((size_t)fe->batch_buf + sizeof(*fe->frames) - 1)
+                                & ~(sizeof(*fe->frames) - 1));
+    fe->specs = fe->frames + fe->fft_size;
+    fe->mfspecs = fe->specs + fe->fft_size;
+    fe->spchs = ckd_calloc(fe->frame_shift * FE_BATCH_SIZE, sizeof(*fe->spchs));
+    fe->ceps = (mfcc_t **)ckd_calloc_2d(FE_BATCH_SIZE, fe->feature_dimension,
+                                        sizeof(**fe->ceps));
+#endif
 
     /* create twiddle factors */
     fe->ccc = ckd_calloc(fe->fft_size / 4, sizeof(*fe->ccc));
@@ -498,26 +510,74 @@ fe_process_frames(fe_t *fe,
 
     /* Process all remaining frames. */
     while (*inout_nframes > 0 && *inout_nsamps >= (size_t)fe->frame_shift) {
-        fe_shift_frame(fe, *inout_spch, fe->frame_shift);
-        fe_write_frame(fe, buf_cep[outidx]);
-        if (!fe->vad_data->state_changed && fe->vad_data->global_state) {
-            (*inout_nframes)--;
-            outidx++;
-        }
-        /* Update input-output pointers and counters. */
-        *inout_spch += fe->frame_shift;
-        *inout_nsamps -= fe->frame_shift;
-        /* Amount of data behind the original input which is still needed. */
-        if (fe->num_overflow_samps > 0)
-            fe->num_overflow_samps -= fe->frame_shift;
-
-        if (fe->vad_data->state_changed && fe->vad_data->global_state) {
-            /* previous frame triggered vad into speech state */
-            while (*inout_nframes > 0 && fe_prespch_read_cep(fe->vad_data->prespch_buf, buf_cep[outidx]) != 0) {
+        int nfr;
+
+        /* Take as many frames at once as will surely fit in the
+         * output, even if the prespeech buffer gets dumped into it. */
+        nfr = *inout_nsamps / fe->frame_shift;
+        if (nfr > FE_BATCH_SIZE)
+            nfr = FE_BATCH_SIZE;
+        if (nfr > *inout_nframes - fe_prespch_ncep(fe->vad_data->prespch_buf))
+            nfr = *inout_nframes - fe_prespch_ncep(fe->vad_data->prespch_buf);
+        if (nfr < 2) {
+            fe_shift_frame(fe, *inout_spch, fe->frame_shift);
+            fe_write_frame(fe, buf_cep[outidx]);
+            if (!fe->vad_data->state_changed && fe->vad_data->global_state) {
                 (*inout_nframes)--;
                 outidx++;
             }
+            /* Update input-output pointers and counters. */
+            *inout_spch += fe->frame_shift;
+            *inout_nsamps -= fe->frame_shift;
+            /* Amount of data behind the original input which is still needed. */
+            if (fe->num_overflow_samps > 0)
+                fe->num_overflow_samps -= fe->frame_shift;
+
+            if (fe->vad_data->state_changed && fe->vad_data->global_state) {
+                /* previous frame triggered vad into speech state */
+                while (*inout_nframes > 0 && fe_prespch_read_cep(fe->vad_data->prespch_buf, buf_cep[outidx]) != 0) {
+                    (*inout_nframes)--;
+                    outidx++;
+                }
+            }
+            continue;
         }
+
+#if FE_BATCH_SIZE > 1
+        {
+            int32 is_speech[FE_BATCH_SIZE];
+            int i;
+
+            /* Read in a batch of frames and compute their features. */
+            for (i = 0; i < nfr; ++i) {
+                fe_shift_frame(fe, *inout_spch, fe->frame_shift);
+                fe_batch_frame(fe, i);
+                *inout_spch += fe->frame_shift;
+                *inout_nsamps -= fe->frame_shift;
+                if (fe->num_overflow_samps > 0)
+                    fe->num_overflow_samps -= fe->frame_shift;
+            }
+            fe_write_frames(fe, nfr, is_speech);
+
+            /* Now do VAD and output for each of them, in order. */
+            for (i = 0; i < nfr; ++i) {
+                memcpy(buf_cep[outidx], fe->ceps[i],
+                       fe->feature_dimension * sizeof(**buf_cep));
+                fe_vad_hangover(fe, buf_cep[outidx], is_speech[i],
+                                fe->spchs + i * fe->frame_shift);
+                if (!fe->vad_data->state_changed && fe->vad_data->global_state) {
+                    (*inout_nframes)--;
+                    outidx++;
+                }
+                if (fe->vad_data->state_changed && fe->vad_data->global_state) {
+                    while (*inout_nframes > 0 && fe_prespch_read_cep(fe->vad_data->prespch_buf, buf_cep[outidx]) != 0) {
+                        (*inout_nframes)--;
+                        outidx++;
+                    }
+                }
+            }
+        }
+#endif
     }
 
     /* How many relevant overflow samples are there left? */
@@ -666,6 +726,12 @@ fe_free(fe_t * fe)
     ckd_free(fe->sss);
     ckd_free(fe->spec);
     ckd_free(fe->mfspec);
+#if FE_BATCH_SIZE > 1
+    ckd_free(fe->batch_buf);
+    ckd_free(fe->spchs);
+    if (fe->ceps)
+        ckd_free_2d(fe->ceps);
+#endif
     ckd_free(fe->overflow_samps);
     ckd_free(fe->hamming_window);
 
@@ -112,6 +112,25 @@ typedef struct ringbuf_s {
 	int32 recs;
 } ringbuf_t;
 
+/*
+ * Number of frames processed at once by fe_write_frames().  Batches are
+ * vectors of frame_t (using the GCC vector extensions, which clang
+ * also supports), so batching is only done where those are available,
+ * and only in floating point.  Vectors wider than the hardware ones
+ * make for terrible code, so they are the same size as those.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(FIXED_POINT)
+#if defined(__AVX__)
+#define FE_BATCH_SIZE 4
+#else
+#define FE_BATCH_SIZE 2
+#endif
+typedef frame_t fe_batch_t
+    __attribute__ ((vector_size(FE_BATCH_SIZE * sizeof(frame_t))));
+#else
+#define FE_BATCH_SIZE 1
+#endif
+
 /* sqrt(1/2), also used for unitary DCT-II/DCT-III */
 #define SQRT_HALF FLOAT2MFCC(0.707106781186548)
 
@@ -179,6 +198,16 @@ struct fe_s {
     int16 *overflow_samps;
     int16 num_overflow_samps;    
     int16 prior;
+
+#if FE_BATCH_SIZE > 1
+    /* Buffers for processing FE_BATCH_SIZE frames at once.  Element k
+     * of frame b of the frames, spectra and mel spectra is
+     * frames[k][b], specs[k][b] and mfspecs[k][b]. */
+    void *batch_buf;
+    fe_batch_t *frames, *specs, *mfspecs;
+    int16 *spchs;
+    mfcc_t **ceps;
+#endif
 };
 
 void fe_init_dither(int32 seed);
@@ -195,6 +224,14 @@ int fe_shift_frame(fe_t *fe, int16 const *in, int32 len);
 /* Process a frame of data into features. */
 void fe_write_frame(fe_t *fe, mfcc_t *fea);
 
+/* Add the frame just loaded by fe_read_frame() or fe_shift_frame()
+ * to the batch buffers, in position b. */
+void fe_batch_frame(fe_t *fe, int b);
+
+/* Process the first nfr frames of the batch buffers into features in
+ * fe->ceps, with the VAD decision for each one in is_speech. */
+void fe_write_frames(fe_t *fe, int nfr, int32 *is_speech);
+
 /* Initialization functions. */
 int32 fe_build_melfilters(melfb_t *MEL_FB);
 int32 fe_compute_melcosine(melfb_t *MEL_FB);
@@ -79,6 +79,9 @@ struct noise_stats_s {
     powspec_t *floor;
     /* Peak for temporal masking */
     powspec_t *peak;
+    /* Scratch space for fe_track_snr() */
+    powspec_t *signal;
+    powspec_t *gain;
 
     /* Initialize it next time */
     uint8 undefined;
@@ -199,6 +202,10 @@ fe_init_noisestats(int num_filters)
         (powspec_t *) ckd_calloc(num_filters, sizeof(powspec_t));
     noise_stats->peak =
         (powspec_t *) ckd_calloc(num_filters, sizeof(powspec_t));
+    noise_stats->signal =
+        (powspec_t *) ckd_calloc(num_filters, sizeof(powspec_t));
+    noise_stats->gain =
+        (powspec_t *) ckd_calloc(num_filters, sizeof(powspec_t));
 
     noise_stats->undefined = TRUE;
     noise_stats->num_filters = num_filters;
@@ -252,6 +259,8 @@ fe_free_noisestats(noise_stats_t * noise_stats)
     ckd_free(noise_stats->noise);
     ckd_free(noise_stats->floor);
     ckd_free(noise_stats->peak);
+    ckd_free(noise_stats->signal);
+    ckd_free(noise_stats->gain);
     ckd_free(noise_stats);
 }
 
@@ -278,7 +287,7 @@ fe_track_snr(fe_t * fe, int32 *in_speech)
     mfspec = fe->mfspec;
     num_filts = noise_stats->num_filters;
 
-    signal = (powspec_t *) ckd_calloc(num_filts, sizeof(powspec_t));
+    signal = noise_stats->signal;
 
     if (noise_stats->undefined) {
         for (i = 0; i < num_filts; i++) {
@@ -317,14 +326,18 @@ fe_track_snr(fe_t * fe, int32 *in_speech)
         if (signal[i] < 1.0)
             signal[i] = 1.0;
         snr = log(noise_stats->power[i] / noise_stats->noise[i]);
-        log_signal = log(signal[i]);
 #else
         signal[i] = fe_log_sub(noise_stats->power[i], noise_stats->noise[i]);
         snr = noise_stats->power[i] - noise_stats->noise[i];
-        log_signal = signal[i];
 #endif    
         if (snr > lrt) {
             lrt = snr;
+            /* Only needed here, and log() is not cheap. */
+#ifndef FIXED_POINT
+            log_signal = log(signal[i]);
+#else
+            log_signal = signal[i];
+#endif
             if (log_signal > max_signal) {
 		max_signal = log_signal;
     	    }
@@ -347,7 +360,6 @@ fe_track_snr(fe_t * fe, int32 *in_speech)
 
     if (!fe->remove_noise) {
         //no need for further calculations if noise cancellation disabled
-        ckd_free(signal);
         return;
     }
 
@@ -356,7 +368,7 @@ fe_track_snr(fe_t * fe, int32 *in_speech)
             signal[i] = noise_stats->floor[i];
     }
 
-    gain = (powspec_t *) ckd_calloc(num_filts, sizeof(powspec_t));
+    gain = noise_stats->gain;
 #ifndef FIXED_POINT
     for (i = 0; i < num_filts; i++) {
         if (signal[i] < noise_stats->max_gain * noise_stats->power[i])
@@ -378,13 +390,10 @@ fe_track_snr(fe_t * fe, int32 *in_speech)
 
     /* Weight smoothing and time frequency normalization */
     fe_weight_smooth(noise_stats, mfspec, gain, num_filts);
-
-    ckd_free(gain);
-    ckd_free(signal);
 }
 
 void
-fe_vad_hangover(fe_t * fe, mfcc_t * fea, int32 is_speech)
+fe_vad_hangover(fe_t * fe, mfcc_t * fea, int32 is_speech, int16 * spch)
 {
     /* track vad state and deal with cepstrum prespeech buffer */
     fe->vad_data->state_changed = 0;
@@ -418,7 +427,7 @@ fe_vad_hangover(fe_t * fe, mfcc_t * fea, int32 is_speech)
 
     if (fe->vad_data->store_pcm) {
         if (is_speech || fe->vad_data->global_state)
-            fe_prespch_write_pcm(fe->vad_data->prespch_buf, fe->spch);
+            fe_prespch_write_pcm(fe->vad_data->prespch_buf, spch);
         if (!is_speech && !fe->vad_data->global_state)
             fe_prespch_reset_pcm(fe->vad_data->prespch_buf);
     }
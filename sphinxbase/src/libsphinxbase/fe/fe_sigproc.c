@@ -1360,9 +1360,246 @@ fe_write_frame(fe_t * fe, mfcc_t * fea)
     fe_track_snr(fe, &is_speech);
     fe_mel_cep(fe, fea);
     fe_lifter(fe, fea);
-    fe_vad_hangover(fe, fea, is_speech);
+    fe_vad_hangover(fe, fea, is_speech, fe->spch);
 }
 
+/*
+ * Batched versions of the above, which work on FE_BATCH_SIZE frames
+ * at once, using vectors which hold the same element of each frame.
+ * Each frame goes through exactly the same arithmetic as in the
+ * single-frame code, so the results are identical.
+ */
+#if FE_BATCH_SIZE > 1
+void
+fe_batch_frame(fe_t * fe, int b)
+{
+    int i;
+
+    for (i = 0; i < fe->fft_size; ++i)
+        fe->frames[i][b] = fe->frame[i];
+    if (fe->vad_data->store_pcm)
+        memcpy(fe->spchs + b * fe->frame_shift, fe->spch,
+               fe->frame_shift * sizeof(*fe->spchs));
+}
+
+static void
+fe_fft_real_batch(fe_t * fe)
+{
+    int i, j, k, m, n;
+    fe_batch_t *x, xt;
+
+    x = fe->frames;
+    m = fe->fft_order;
+    n = fe->fft_size;
+
+    /* Bit-reverse the input. */
+    j = 0;
+    for (i = 0; i < n - 1; ++i) {
+        if (i < j) {
+            xt = x[j];
+            x[j] = x[i];
+            x[i] = xt;
+        }
+        k = n / 2;
+        while (k <= j) {
+            j -= k;
+            k /= 2;
+        }
+        j += k;
+    }
+
+    /* Basic butterflies (2-point FFT, real twiddle factors) */
+    for (i = 0; i < n; i += 2) {
+        xt = x[i];
+        x[i] = (xt + x[i + 1]);
+        x[i + 1] = (xt - x[i + 1]);
+    }
+
+    /* The rest of the butterflies, in stages from 1..m */
+    for (k = 1; k < m; ++k) {
+        int n1, n2, n4;
+
+        n4 = k - 1;
+        n2 = k;
+        n1 = k + 1;
+        /* Stride over each (1 << (k+1)) points */
+        for (i = 0; i < n; i += (1 << n1)) {
+            /* Basic butterfly and the other ones with real twiddle
+             * factors (x[i + (1<<k-1)] is unchanged). */
+            xt = x[i];
+            x[i] = (xt + x[i + (1 << n2)]);
+            x[i + (1 << n2)] = (xt - x[i + (1 << n2)]);
+            x[i + (1 << n2) + (1 << n4)] = -x[i + (1 << n2) + (1 << n4)];
+
+            /* Butterflies with complex twiddle factors.
+             * There are (1<<k-1) of them.
+             */
+            for (j = 1; j < (1 << n4); ++j) {
+                frame_t cc, ss;
+                fe_batch_t t1, t2;
+                int i1, i2, i3, i4;
+
+                i1 = i + j;
+                i2 = i + (1 << n2) - j;
+                i3 = i + (1 << n2) + j;
+                i4 = i + (1 << n2) + (1 << n2) - j;
+
+                cc = fe->ccc[j << (m - n1)];
+                ss = fe->sss[j << (m - n1)];
+
+                t1 = COSMUL(x[i3], cc) + COSMUL(x[i4], ss);
+                t2 = COSMUL(x[i3], ss) - COSMUL(x[i4], cc);
+
+                x[i4] = (x[i2] - t2);
+                x[i3] = (-x[i2] - t2);
+                x[i2] = (x[i1] - t1);
+                x[i1] = (x[i1] + t1);
+            }
+        }
+    }
+}
+
+static void
+fe_spec_magnitude_batch(fe_t * fe)
+{
+    fe_batch_t *fft, *spec;
+    int32 j, fftsize;
+
+    fe_fft_real_batch(fe);
+
+    fft = fe->frames;
+    spec = fe->specs;
+    fftsize = fe->fft_size;
+
+    /* The first point (DC coefficient) has no imaginary part */
+    spec[0] = fft[0] * fft[0];
+    for (j = 1; j <= fftsize / 2; j++)
+        spec[j] = fft[j] * fft[j] + fft[fftsize - j] * fft[fftsize - j];
+}
+
+static void
+fe_mel_spec_batch(fe_t * fe)
+{
+    int whichfilt;
+
+    for (whichfilt = 0; whichfilt < fe->mel_fb->num_filters; whichfilt++) {
+        fe_batch_t *spec, acc = { 0 };
+        mfcc_t *coeffs;
+        int i;
+
+        spec = fe->specs + fe->mel_fb->spec_start[whichfilt];
+        coeffs = fe->mel_fb->filt_coeffs + fe->mel_fb->filt_start[whichfilt];
+
+        for (i = 0; i < fe->mel_fb->filt_width[whichfilt]; i++)
+            acc += spec[i] * (frame_t) coeffs[i];
+        fe->mfspecs[whichfilt] = acc;
+    }
+}
+
+static void
+fe_mel_cep_batch(fe_t * fe, int nfr)
+{
+    mfcc_t acc[FE_BATCH_SIZE];
+    frame_t *mfspec;
+    int32 i, j, b, nfilt;
+
+    /* It is simpler to get at the individual frames through a pointer
+     * to the first element of the vectors. */
+    mfspec = (frame_t *) fe->mfspecs;
+    nfilt = fe->mel_fb->num_filters;
+    for (i = 0; i < nfilt * FE_BATCH_SIZE; ++i)
+        mfspec[i] = log(mfspec[i] + LOG_FLOOR);
+
+    /* C0 first (its basis vector is 1), as in fe_spec2cep() and
+     * fe_dct2(). */
+    for (b = 0; b < FE_BATCH_SIZE; ++b) {
+        if (fe->transform == LEGACY_DCT)
+            acc[b] = mfspec[b] / 2;     /* beta = 0.5 */
+        else
+            acc[b] = mfspec[b];
+    }
+    for (j = 1; j < nfilt; j++)
+        for (b = 0; b < FE_BATCH_SIZE; ++b)
+            acc[b] += mfspec[j * FE_BATCH_SIZE + b];
+    for (b = 0; b < nfr; ++b) {
+        if (fe->transform == LEGACY_DCT)
+            fe->ceps[b][0] = acc[b] / (frame_t) nfilt;
+        else if (fe->transform == DCT_HTK)
+            fe->ceps[b][0] = COSMUL(acc[b], fe->mel_fb->sqrt_inv_2n);
+        else
+            fe->ceps[b][0] = COSMUL(acc[b], fe->mel_fb->sqrt_inv_n);
+    }
+
+    /* The others are accumulated in the output in the same order as
+     * in fe_spec2cep() and fe_dct2(), but doing them all at once for
+     * each mel spectrum element keeps the arithmetic units busy. */
+    for (b = 0; b < FE_BATCH_SIZE; ++b)
+        for (i = 1; i < fe->num_cepstra; ++i)
+            fe->ceps[b][i] = 0;
+    for (j = 0; j < nfilt; j++) {
+        int32 beta = (j == 0) ? 1 : 2;  /* 0.5 or 1.0 */
+
+        for (b = 0; b < FE_BATCH_SIZE; ++b) {
+            frame_t x = mfspec[j * FE_BATCH_SIZE + b];
+            mfcc_t *mfcep = fe->ceps[b];
+
+            if (fe->transform == LEGACY_DCT)
+                for (i = 1; i < fe->num_cepstra; ++i)
+                    mfcep[i] += COSMUL(x, fe->mel_fb->mel_cosine[i][j]) * beta;
+            else
+                for (i = 1; i < fe->num_cepstra; ++i)
+                    mfcep[i] += COSMUL(x, fe->mel_fb->mel_cosine[i][j]);
+        }
+    }
+    for (b = 0; b < nfr; ++b) {
+        for (i = 1; i < fe->num_cepstra; ++i) {
+            if (fe->transform == LEGACY_DCT)
+                fe->ceps[b][i] /= (frame_t) nfilt * 2;
+            else
+                fe->ceps[b][i] = COSMUL(fe->ceps[b][i],
+                                        fe->mel_fb->sqrt_inv_2n);
+        }
+    }
+}
+
+void
+fe_write_frames(fe_t * fe, int nfr, int32 *is_speech)
+{
+    int32 i, b, nfilt;
+
+    fe_spec_magnitude_batch(fe);
+    fe_mel_spec_batch(fe);
+
+    /* Noise tracking runs through the frames in order. */
+    nfilt = fe->mel_fb->num_filters;
+    for (b = 0; b < nfr; ++b) {
+        if (!(fe->remove_noise || fe->remove_silence)) {
+            is_speech[b] = TRUE;
+            continue;
+        }
+        for (i = 0; i < nfilt; ++i)
+            fe->mfspec[i] = fe->mfspecs[i][b];
+        fe_track_snr(fe, &is_speech[b]);
+        for (i = 0; i < nfilt; ++i)
+            fe->mfspecs[i][b] = fe->mfspec[i];
+    }
+
+    if (fe->log_spec == RAW_LOG_SPEC || fe->log_spec == SMOOTH_LOG_SPEC) {
+        /* Not worth batching, do them one at a time. */
+        for (b = 0; b < nfr; ++b) {
+            for (i = 0; i < nfilt; ++i)
+                fe->mfspec[i] = fe->mfspecs[i][b];
+            fe_mel_cep(fe, fe->ceps[b]);
+        }
+    }
+    else
+        fe_mel_cep_batch(fe, nfr);
+
+    for (b = 0; b < nfr; ++b)
+        fe_lifter(fe, fe->ceps[b]);
+}
+#endif                          /* FE_BATCH_SIZE > 1 */
+
 
 void *
 fe_create_2d(int32 d1, int32 d2, int32 elem_size)
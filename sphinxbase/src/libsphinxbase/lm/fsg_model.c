@@ -41,6 +41,7 @@
 #include <time.h>
 #endif                          /* _WIN32_WCE */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -279,6 +280,181 @@ fsg_model_null_trans_closure(fsg_model_t * fsg, glist_t nulls)
     return nulls;
 }
 
+/* Order transitions by word and destination, best probability first. */
+static int
+fsg_arc_cmp(const void *a, const void *b)
+{
+    const int32 *x = a, *y = b;
+
+    if (x[0] != y[0])
+        return x[0] < y[0] ? -1 : 1;
+    if (x[1] != y[1])
+        return x[1] < y[1] ? -1 : 1;
+    if (x[2] != y[2])
+        return x[2] > y[2] ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Signature of state s under the current partition: its class, whether
+ * it is final, and its transitions as (word, class of destination,
+ * probability), sorted and with only the best of any duplicates.
+ */
+static int32 *
+fsg_state_signature(fsg_model_t * fsg, int32 const *cls, int32 s,
+                    int32 *out_len)
+{
+    fsg_arciter_t *itor;
+    int32 *sig, *arcs;
+    int32 n, i, j;
+
+    n = 0;
+    for (itor = fsg_model_arcs(fsg, s); itor; itor = fsg_arciter_next(itor))
+        ++n;
+    sig = ckd_calloc(3 + n * 3, sizeof(*sig));
+    arcs = sig + 3;
+    i = 0;
+    for (itor = fsg_model_arcs(fsg, s); itor; itor = fsg_arciter_next(itor)) {
+        fsg_link_t *link = fsg_arciter_get(itor);
+        arcs[i * 3] = link->wid < 0 ? -1 : link->wid;
+        arcs[i * 3 + 1] = cls[link->to_state];
+        arcs[i * 3 + 2] = link->logs2prob;
+        ++i;
+    }
+    qsort(arcs, n, 3 * sizeof(*arcs), fsg_arc_cmp);
+    for (i = j = 0; i < n; ++i) {
+        /* Null transitions within a class become self-loops, which
+         * are dropped. */
+        if (arcs[i * 3] < 0 && arcs[i * 3 + 1] == cls[s])
+            continue;
+        if (j > 0 && arcs[(j - 1) * 3] == arcs[i * 3]
+            && arcs[(j - 1) * 3 + 1] == arcs[i * 3 + 1])
+            continue;
+        memmove(arcs + j * 3, arcs + i * 3, 3 * sizeof(*arcs));
+        ++j;
+    }
+    sig[0] = cls[s];
+    sig[1] = (s == fsg->final_state);
+    sig[2] = j;
+    *out_len = (3 + j * 3) * sizeof(*sig);
+    return sig;
+}
+
+/* Build an FSG whose states are the classes of those of fsg. */
+static fsg_model_t *
+fsg_model_merge(fsg_model_t * fsg, int32 const *cls, int32 n_cls)
+{
+    fsg_model_t *newfsg;
+    int32 *rep, i, s;
+
+    newfsg = fsg_model_init(fsg->name, fsg->lmath, fsg->lw, n_cls);
+    newfsg->start_state = cls[fsg->start_state];
+    newfsg->final_state = cls[fsg->final_state];
+    for (i = 0; i < fsg->n_word; ++i)
+        fsg_model_word_add(newfsg, fsg->vocab[i]);
+    if (fsg->silwords) {
+        newfsg->silwords = bitvec_alloc(newfsg->n_word_alloc);
+        for (i = 0; i < fsg->n_word; ++i)
+            if (bitvec_is_set(fsg->silwords, i))
+                bitvec_set(newfsg->silwords, i);
+    }
+    if (fsg->altwords) {
+        newfsg->altwords = bitvec_alloc(newfsg->n_word_alloc);
+        for (i = 0; i < fsg->n_word; ++i)
+            if (bitvec_is_set(fsg->altwords, i))
+                bitvec_set(newfsg->altwords, i);
+    }
+
+    /* All states in a class have the same transitions, so take
+     * those of the first one. */
+    rep = ckd_calloc(n_cls, sizeof(*rep));
+    for (i = 0; i < n_cls; ++i)
+        rep[i] = -1;
+    for (s = 0; s < fsg->n_state; ++s)
+        if (rep[cls[s]] == -1)
+            rep[cls[s]] = s;
+    for (i = 0; i < n_cls; ++i) {
+        fsg_arciter_t *itor;
+
+        for (itor = fsg_model_arcs(fsg, rep[i]); itor;
+             itor = fsg_arciter_next(itor)) {
+            fsg_link_t *link = fsg_arciter_get(itor);
+
+            if (link->wid < 0)
+                fsg_model_null_trans_add(newfsg, i, cls[link->to_state],
+                                         link->logs2prob);
+            else
+                fsg_model_trans_add(newfsg, i, cls[link->to_state],
+                                    link->logs2prob, link->wid);
+        }
+    }
+    ckd_free(rep);
+
+    return newfsg;
+}
+
+fsg_model_t *
+fsg_model_minimize(fsg_model_t * fsg)
+{
+    fsg_model_t *newfsg;
+    int32 *cls, **sigs;
+    int32 n_cls, s;
+
+    /* Refine the partition of states, starting with a single class,
+     * until no class is split any further. */
+    cls = ckd_calloc(fsg->n_state, sizeof(*cls));
+    sigs = ckd_calloc(fsg->n_state, sizeof(*sigs));
+    n_cls = 1;
+    while (TRUE) {
+        hash_table_t *h;
+        int32 *newcls, n_newcls;
+
+        h = hash_table_new(fsg->n_state, HASH_CASE_YES);
+        newcls = ckd_calloc(fsg->n_state, sizeof(*newcls));
+        n_newcls = 0;
+        for (s = 0; s < fsg->n_state; ++s) {
+            int32 len, c;
+
+            sigs[s] = fsg_state_signature(fsg, cls, s, &len);
+            c = hash_table_enter_bkey_int32(h, (char const *)sigs[s],
+                                            len, n_newcls);
+            if (c == n_newcls)
+                ++n_newcls;
+            newcls[s] = c;
+        }
+        hash_table_free(h);
+        for (s = 0; s < fsg->n_state; ++s)
+            ckd_free(sigs[s]);
+        ckd_free(cls);
+        cls = newcls;
+        if (n_newcls == n_cls)
+            break;
+        n_cls = n_newcls;
+    }
+    ckd_free(sigs);
+    E_INFO("Minimized FSG from %d to %d states\n", fsg->n_state, n_cls);
+
+    newfsg = fsg_model_merge(fsg, cls, n_cls);
+    ckd_free(cls);
+
+    return newfsg;
+}
+
+fsg_model_t *
+fsg_model_copy(fsg_model_t * fsg)
+{
+    fsg_model_t *newfsg;
+    int32 *cls, s;
+
+    cls = ckd_calloc(fsg->n_state, sizeof(*cls));
+    for (s = 0; s < fsg->n_state; ++s)
+        cls[s] = s;
+    newfsg = fsg_model_merge(fsg, cls, fsg->n_state);
+    ckd_free(cls);
+
+    return newfsg;
+}
+
 glist_t
 fsg_model_trans(fsg_model_t * fsg, int32 i, int32 j)
 {
@@ -44,29 +44,40 @@
 #include <assert.h>
 #include <limits.h>
 
-#include "sphinxbase/listelem_alloc.h"
 #include "sphinxbase/ckd_alloc.h"
 #include "sphinxbase/err.h"
 
 #include "lm3g_model.h"
 
 void
-lm3g_tginfo_free(ngram_model_t *base, lm3g_model_t *lm3g)
+lm3g_tgcache_init(ngram_model_t *base, lm3g_model_t *lm3g)
 {
-	if (lm3g->tginfo == NULL)
-		return;
-        listelem_alloc_free(lm3g->le);
-        ckd_free(lm3g->tginfo);
+    uint32 i, n_buckets;
+
+    /* One bucket for every few bigrams, within reason. */
+    for (n_buckets = 64; n_buckets < TGCACHE_MAX_BUCKETS
+             && n_buckets * TGCACHE_BUCKET_SZ < (uint32)base->n_counts[1];
+         n_buckets <<= 1)
+        ;
+    lm3g->tgcache_buf = ckd_malloc(n_buckets * sizeof(tgcache_bucket_t) + 63);
+    lm3g->tgcache = (tgcache_bucket_t *)
+        (((size_t)lm3g->tgcache_buf + 63) & ~(size_t)63);
+    lm3g->tgcache_mask = n_buckets - 1;
+    /* Empty entries have lw1 = -1, which never matches. */
+    memset(lm3g->tgcache, 0, n_buckets * sizeof(tgcache_bucket_t));
+    for (i = 0; i < n_buckets; ++i) {
+        int j;
+        for (j = 0; j < TGCACHE_BUCKET_SZ; ++j)
+            lm3g->tgcache[i].ent[j].w1 = 0xffffffff;
+    }
 }
 
 void
-lm3g_tginfo_reset(ngram_model_t *base, lm3g_model_t *lm3g)
+lm3g_tgcache_free(ngram_model_t *base, lm3g_model_t *lm3g)
 {
-    if (lm3g->tginfo == NULL)
-        return;
-    listelem_alloc_free(lm3g->le);
-    memset(lm3g->tginfo, 0, base->n_counts[0] * sizeof(tginfo_t *));
-    lm3g->le = listelem_alloc_init(sizeof(tginfo_t));
+    ckd_free(lm3g->tgcache_buf);
+    lm3g->tgcache_buf = NULL;
+    lm3g->tgcache = NULL;
 }
 
 void
@@ -145,11 +156,6 @@ lm3g_add_ug(ngram_model_t *base,
                                  sizeof(*lm3g->unigrams) * base->n_1g_alloc);
     memset(lm3g->unigrams + base->n_counts[0], 0,
            (base->n_1g_alloc - base->n_counts[0]) * sizeof(*lm3g->unigrams));
-    /* Reallocate tginfo array. */
-    lm3g->tginfo = ckd_realloc(lm3g->tginfo,
-                               sizeof(*lm3g->tginfo) * base->n_1g_alloc);
-    memset(lm3g->tginfo + base->n_counts[0], 0,
-           (base->n_1g_alloc - base->n_counts[0]) * sizeof(*lm3g->tginfo));
     /* FIXME: we really ought to update base->log_uniform *and*
      * renormalize all the other unigrams.  This is really slow, so I
      * will probably just provide a function to renormalize after
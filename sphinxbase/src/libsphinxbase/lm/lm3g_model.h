@@ -44,8 +44,6 @@
 #ifndef __NGRAM_MODEL_LM3G_H__
 #define __NGRAM_MODEL_LM3G_H__
 
-#include "sphinxbase/listelem_alloc.h"
-
 #include "ngram_model_internal.h"
 
 /**
@@ -123,18 +121,57 @@ typedef struct trigram_s trigram_t;
  * Trigram information cache.
  *
  * The following trigram information cache eliminates most traversals of 1g->2g->3g
- * tree to locate trigrams for a given bigram (lw1,lw2).  The organization is optimized
- * for locality of access (to the same lw1), given lw2.
+ * tree to locate trigrams for a given bigram (lw1,lw2).  It is an
+ * open-addressed hash table of cache-line sized buckets, each holding
+ * TGCACHE_BUCKET_SZ entries.
+ *
+ * Entries only hold indices into the model's (read-only) bigram and
+ * trigram tables, never weighted scores, so they are never stale and
+ * need not be flushed.  Any thread may fill in an entry while others
+ * are reading the table.  Each entry is guarded by a sequence number,
+ * which is odd while it is being written: a writer which cannot make
+ * it odd leaves the entry alone, and a reader which sees it odd, or
+ * changed after reading the entry, treats it as a miss.
+ */
+typedef struct tgcache_entry_s {
+    uint32 seq;         /**< Sequence number, odd while being written. */
+    uint32 w1;          /**< lw1, or 0xffffffff if the entry is empty. */
+    uint32 w2;          /**< lw2 */
+    uint32 t;           /**< Absolute index of first trigram for lw1,lw2,
+                           or TGCACHE_NO_BG if there is no such bigram. */
+    uint32 nb;          /**< Number of trigrams (upper 16 bits) and
+                           index into bo_wt2 (lower 16 bits). */
+} tgcache_entry_t;
+#define TGCACHE_BUCKET_SZ	3	/* 3 * 20 bytes, padded to one 64-byte cache line */
+typedef struct tgcache_bucket_s {
+    tgcache_entry_t ent[TGCACHE_BUCKET_SZ];
+    uint32 pad;
+} tgcache_bucket_t;
+#define TGCACHE_MAX_BUCKETS	(1<<14)	/* 1MB */
+#define TGCACHE_NO_BG		0xffffffff
+
+/*
+ * Atomic access to cache entries.  Without these the cache is never
+ * filled in, and every lookup goes to the bigram table.
  */
-typedef struct tginfo_s {
-    int32 w1;			/**< lw1 component of bigram lw1,lw2.  All bigrams with
-				   same lw2 linked together (see lm_t.tginfo). */
-    int32 n_tg;			/**< number tg for parent bigram lw1,lw2 */
-    int32 bowt;                 /**< tg bowt for lw1,lw2 */
-    int32 used;			/**< whether used since last lm_reset */
-    trigram_t *tg;		/**< Trigrams for lw1,lw2 */
-    struct tginfo_s *next;      /**< Next lw1 with same parent lw2; NULL if none. */
-} tginfo_t;
+#if defined(__GNUC__)
+#define TGCACHE_ATOMIC 1
+#define tgcache_load(p)	__atomic_load_n(p, __ATOMIC_RELAXED)
+#define tgcache_load_acquire(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define tgcache_store(p, v)	__atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define tgcache_store_release(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define tgcache_fence_acquire()	__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define tgcache_fence_release()	__atomic_thread_fence(__ATOMIC_RELEASE)
+/* Make sequence number seq odd, if it is still seq. */
+#define tgcache_claim(p, seq)	__atomic_compare_exchange_n(p, &(seq), (seq) + 1, \
+                                                    0, __ATOMIC_RELAXED, \
+                                                    __ATOMIC_RELAXED)
+#else
+#define TGCACHE_ATOMIC 0
+#define tgcache_load(p)	(*(p))
+#define tgcache_load_acquire(p)	(*(p))
+#define tgcache_fence_acquire()
+#endif
 
 /**
  * Common internal structure for Sphinx 3-gram models.
@@ -151,13 +188,13 @@ typedef struct lm3g_model_s {
     int32 n_prob3;	     /**< prob3 size */
     int32 *tseg_base;    /**< tseg_base[i>>LOG_BG_SEG_SZ] = index of 1st
                             trigram for bigram segment (i>>LOG_BG_SEG_SZ) */
-    tginfo_t **tginfo;   /**< tginfo[lw2] is head of linked list of trigram information for
-                            some cached subset of bigrams (*,lw2). */
-    listelem_alloc_t *le; /**< List element allocator for tginfo. */
+    tgcache_bucket_t *tgcache; /**< Trigram information cache (aligned). */
+    void *tgcache_buf;   /**< Storage for tgcache (unaligned). */
+    uint32 tgcache_mask; /**< Number of buckets in tgcache, minus one. */
 } lm3g_model_t;
 
-void lm3g_tginfo_free(ngram_model_t *base, lm3g_model_t *lm3g);
-void lm3g_tginfo_reset(ngram_model_t *base, lm3g_model_t *lm3g);
+void lm3g_tgcache_init(ngram_model_t *base, lm3g_model_t *lm3g);
+void lm3g_tgcache_free(ngram_model_t *base, lm3g_model_t *lm3g);
 void lm3g_apply_weights(ngram_model_t *base,
 			lm3g_model_t *lm3g,
 			float32 lw, float32 wip, float32 uw);
@@ -96,43 +96,6 @@ lm3g_bg_score(NGRAM_MODEL_TYPE *model,
     return (score);
 }
 
-static void
-load_tginfo(NGRAM_MODEL_TYPE *model, int32 lw1, int32 lw2)
-{
-    int32 i, n, b, t;
-    bigram_t *bg;
-    tginfo_t *tginfo;
-
-    /* First allocate space for tg information for bg lw1,lw2 */
-    tginfo = (tginfo_t *) listelem_malloc(model->lm3g.le);
-    tginfo->w1 = lw1;
-    tginfo->tg = NULL;
-    tginfo->next = model->lm3g.tginfo[lw2];
-    model->lm3g.tginfo[lw2] = tginfo;
-
-    /* Locate bigram lw1,lw2 */
-    b = model->lm3g.unigrams[lw1].bigrams;
-    n = model->lm3g.unigrams[lw1 + 1].bigrams - b;
-    bg = model->lm3g.bigrams + b;
-
-    if ((n > 0) && ((i = find_bg(bg, n, lw2)) >= 0)) {
-        tginfo->bowt = model->lm3g.bo_wt2[bg[i].bo_wt2].l;
-
-        /* Find t = Absolute first trigram index for bigram lw1,lw2 */
-        b += i;                 /* b = Absolute index of bigram lw1,lw2 on disk */
-        t = FIRST_TG(model, b);
-
-        tginfo->tg = model->lm3g.trigrams + t;
-
-        /* Find #tg for bigram w1,w2 */
-        tginfo->n_tg = FIRST_TG(model, b + 1) - t;
-    }
-    else {                      /* No bigram w1,w2 */
-        tginfo->bowt = 0;
-        tginfo->n_tg = 0;
-    }
-}
-
 /* Similar to find_bg */
 static int32
 find_tg(trigram_t * tg, int32 n, uint32 w)
@@ -155,47 +118,106 @@ find_tg(trigram_t * tg, int32 n, uint32 w)
     return ((i < e) ? i : -1);
 }
 
+/*
+ * Find the trigrams and the backoff weight for bigram lw1,lw2, going
+ * through the trigram cache (see lm3g_model.h).  Safe to call from
+ * several threads at once.
+ */
+static int32
+lm3g_tg_lookup(NGRAM_MODEL_TYPE *model, int32 lw1, int32 lw2,
+               trigram_t **out_tg, int32 *out_n_tg)
+{
+    tgcache_entry_t *ent;
+    uint32 h, seq, t, nb;
+    int32 i, n, b;
+    bigram_t *bg;
+
+    h = ((uint32)lw1 * 0x9e3779b1U) ^ ((uint32)lw2 * 0x85ebca6bU);
+    h ^= h >> 15;
+    ent = model->lm3g.tgcache[h & model->lm3g.tgcache_mask].ent;
+    for (i = 0; i < TGCACHE_BUCKET_SZ; ++i) {
+        uint32 w1, w2;
+
+        seq = tgcache_load_acquire(&ent[i].seq);
+        w1 = tgcache_load(&ent[i].w1);
+        w2 = tgcache_load(&ent[i].w2);
+        t = tgcache_load(&ent[i].t);
+        nb = tgcache_load(&ent[i].nb);
+        /* Make sure it was not being written meanwhile. */
+        tgcache_fence_acquire();
+        if (w1 == (uint32)lw1 && w2 == (uint32)lw2 && !(seq & 1)
+            && tgcache_load(&ent[i].seq) == seq)
+            goto found;
+    }
+
+    /* Not cached: locate bigram lw1,lw2 */
+    b = model->lm3g.unigrams[lw1].bigrams;
+    n = model->lm3g.unigrams[lw1 + 1].bigrams - b;
+    bg = model->lm3g.bigrams + b;
+    if ((n > 0) && ((i = find_bg(bg, n, lw2)) >= 0)) {
+        /* b = Absolute index of bigram lw1,lw2 */
+        b += i;
+        t = FIRST_TG(model, b);
+        n = FIRST_TG(model, b + 1) - t;
+        if (n > 0xffff) {
+            /* Too many to cache, should not happen. */
+            *out_tg = model->lm3g.trigrams + t;
+            *out_n_tg = n;
+            return model->lm3g.bo_wt2[bg[i].bo_wt2].l;
+        }
+        nb = ((uint32)n << 16) | bg[i].bo_wt2;
+    }
+    else {
+        t = TGCACHE_NO_BG;
+        nb = 0;
+    }
+#if TGCACHE_ATOMIC
+    /* Overwrite an entry in this bucket, chosen by the hash, unless
+     * another thread is already writing it. */
+    ent += ((h >> 16) * TGCACHE_BUCKET_SZ) >> 16;
+    seq = tgcache_load(&ent->seq);
+    if (!(seq & 1) && tgcache_claim(&ent->seq, seq)) {
+        /* Readers which see any of this will see seq change. */
+        tgcache_fence_release();
+        tgcache_store(&ent->w1, (uint32)lw1);
+        tgcache_store(&ent->w2, (uint32)lw2);
+        tgcache_store(&ent->t, t);
+        tgcache_store(&ent->nb, nb);
+        tgcache_store_release(&ent->seq, seq + 2);
+    }
+#endif
+
+found:
+    if (t == TGCACHE_NO_BG) {
+        *out_tg = NULL;
+        *out_n_tg = 0;
+        return 0;
+    }
+    *out_tg = model->lm3g.trigrams + t;
+    *out_n_tg = nb >> 16;
+    return model->lm3g.bo_wt2[nb & 0xffff].l;
+}
+
 static int32
 lm3g_tg_score(NGRAM_MODEL_TYPE *model, int32 lw1,
               int32 lw2, int32 lw3, int32 *n_used)
 {
     ngram_model_t *base = &model->base;
-    int32 i, n, score;
+    int32 i, n, score, bowt;
     trigram_t *tg;
-    tginfo_t *tginfo, *prev_tginfo;
 
     if ((base->n < 3) || (lw1 < 0) || (lw2 < 0))
         return (lm3g_bg_score(model, lw2, lw3, n_used));
 
-    prev_tginfo = NULL;
-    for (tginfo = model->lm3g.tginfo[lw2]; tginfo; tginfo = tginfo->next) {
-        if (tginfo->w1 == lw1)
-            break;
-        prev_tginfo = tginfo;
-    }
-
-    if (!tginfo) {
-        load_tginfo(model, lw1, lw2);
-        tginfo = model->lm3g.tginfo[lw2];
-    }
-    else if (prev_tginfo) {
-        prev_tginfo->next = tginfo->next;
-        tginfo->next = model->lm3g.tginfo[lw2];
-        model->lm3g.tginfo[lw2] = tginfo;
-    }
-
-    tginfo->used = 1;
-
-    /* Trigrams for w1,w2 now pointed to by tginfo */
-    n = tginfo->n_tg;
-    tg = tginfo->tg;
+    /* Trigrams for w1,w2 now pointed to by tg */
+    bowt = lm3g_tg_lookup(model, lw1, lw2, &tg, &n);
     if ((i = find_tg(tg, n, lw3)) >= 0) {
         /* Access mode = trigram */
         *n_used = 3;
         score = model->lm3g.prob3[tg[i].prob3].l;
     }
     else {
-        score = tginfo->bowt + lm3g_bg_score(model, lw2, lw3, n_used);
+        score = bowt + lm3g_bg_score(model, lw2, lw3, n_used);
     }
 
     return (score);
@@ -270,13 +292,6 @@ lm3g_template_add_ug(ngram_model_t *base,
     return lm3g_add_ug(base, &model->lm3g, wid, lweight);
 }
 
-static void
-lm3g_template_flush(ngram_model_t *base)
-{
-    NGRAM_MODEL_TYPE *model = (NGRAM_MODEL_TYPE *)base;
-    lm3g_tginfo_reset(base, &model->lm3g);
-}
-
 typedef struct lm3g_iter_s {
     ngram_iter_t base;
     unigram_t *ug;
@@ -315,37 +330,14 @@ lm3g_template_iter(ngram_model_t *base, int32 wid,
     }
     else if (n_hist == 2) {
         int32 i, n;
-        tginfo_t *tginfo, *prev_tginfo;
         /* Find the trigram, as in tg_score above (duplicate code...) */
         itor->ug = model->lm3g.unigrams + history[1];
-        prev_tginfo = NULL;
-        for (tginfo = model->lm3g.tginfo[history[0]];
-             tginfo; tginfo = tginfo->next) {
-            if (tginfo->w1 == history[1])
-                break;
-            prev_tginfo = tginfo;
-        }
-
-        if (!tginfo) {
-            load_tginfo(model, history[1], history[0]);
-            tginfo = model->lm3g.tginfo[history[0]];
-        }
-        else if (prev_tginfo) {
-            prev_tginfo->next = tginfo->next;
-            tginfo->next = model->lm3g.tginfo[history[0]];
-            model->lm3g.tginfo[history[0]] = tginfo;
-        }
-
-        tginfo->used = 1;
-
-        /* Trigrams for w1,w2 now pointed to by tginfo */
-        n = tginfo->n_tg;
-        itor->tg = tginfo->tg;
+        lm3g_tg_lookup(model, history[1], history[0], &itor->tg, &n);
         if ((i = find_tg(itor->tg, n, wid)) >= 0) {
             itor->tg += i;
             /* Now advance the bigram pointer accordingly.  FIXME:
              * Note that we actually already found the relevant bigram
-             * in load_tginfo. */
+             * in lm3g_tg_lookup. */
             itor->bg = model->lm3g.bigrams;
             while (FIRST_TG(model, (itor->bg - model->lm3g.bigrams + 1))
                    <= (itor->tg - model->lm3g.trigrams))
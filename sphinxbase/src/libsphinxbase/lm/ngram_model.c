@@ -92,6 +92,8 @@ ngram_file_name_to_type(const char *file_name)
          return NGRAM_ARPA;
      if (0 == strncmp_nocase(ext, ".DMP", 4))
          return NGRAM_DMP;
+     if (0 == strncmp_nocase(ext, ".TRIE", 5))
+         return NGRAM_TRIE;
      return NGRAM_INVALID;
  }
 
@@ -102,6 +104,8 @@ ngram_str_to_type(const char *str_name)
         return NGRAM_ARPA;
     if (0 == strcmp_nocase(str_name, "dmp"))
         return NGRAM_DMP;
+    if (0 == strcmp_nocase(str_name, "trie"))
+        return NGRAM_TRIE;
     return NGRAM_INVALID;
 }
 
@@ -113,6 +117,8 @@ ngram_type_to_str(int type)
         return "arpa";
     case NGRAM_DMP:
         return "dmp";
+    case NGRAM_TRIE:
+        return "trie";
     default:
         return NULL;
     }
@@ -129,6 +135,16 @@ ngram_type_to_str(int type)
 
      switch (file_type) {
      case NGRAM_AUTO: {
+         /* Tries are recognized by magic number or extension, so
+          * there's no need to scan a large binary file for ARPA
+          * headers or to try them after the other formats fail. */
+         if (ngram_file_name_to_type(file_name) == NGRAM_TRIE
+             || ngram_model_trie_probe(file_name)) {
+             model = ngram_model_trie_read(config, file_name, lmath);
+             if (model == NULL)
+                 return NULL;
+             break;
+         }
          if ((model = ngram_model_arpa_read(config, file_name, lmath)) != NULL)
              break;
          if ((model = ngram_model_dmp_read(config, file_name, lmath)) != NULL)
@@ -141,6 +157,9 @@ ngram_type_to_str(int type)
      case NGRAM_DMP:
          model = ngram_model_dmp_read(config, file_name, lmath);
          break;
+     case NGRAM_TRIE:
+         model = ngram_model_trie_read(config, file_name, lmath);
+         break;
      default:
          E_ERROR("language model file type not supported\n");
          return NULL;
@@ -181,6 +200,8 @@ ngram_type_to_str(int type)
          return ngram_model_arpa_write(model, file_name);
      case NGRAM_DMP:
          return ngram_model_dmp_write(model, file_name);
+     case NGRAM_TRIE:
+         return ngram_model_trie_write(model, file_name);
      default:
          E_ERROR("language model file type not supported\n");
          return -1;
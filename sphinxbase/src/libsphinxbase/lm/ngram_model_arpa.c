@@ -51,6 +51,7 @@
 #include "sphinxbase/strfuncs.h"
 
 #include "ngram_model_arpa.h"
+#include "ngram_model_trie.h"
 
 static ngram_funcs_t ngram_model_arpa_funcs;
 
@@ -59,10 +60,12 @@ static ngram_funcs_t ngram_model_arpa_funcs;
 #define FIRST_TG(m,b)		(TSEG_BASE((m),(b))+((m)->lm3g.bigrams[b].trigrams))
 
 /*
- * Read and return #unigrams, #bigrams, #trigrams as stated in input file.
+ * Read and return #unigrams, #bigrams, #trigrams as stated in input
+ * file, along with the order of the model, which may be higher.
  */
 static int
-ReadNgramCounts(lineiter_t **li, int32 * n_ug, int32 * n_bg, int32 * n_tg)
+ReadNgramCounts(lineiter_t **li, int32 * n_ug, int32 * n_bg, int32 * n_tg,
+                int32 * n_order)
 {
     int32 ngram, ngram_cnt;
 
@@ -78,10 +81,12 @@ ReadNgramCounts(lineiter_t **li, int32 * n_ug, int32 * n_bg, int32 * n_tg)
         return -1;
     }
 
-    *n_ug = *n_bg = *n_tg = 0;
+    *n_ug = *n_bg = *n_tg = *n_order = 0;
     while ((*li = lineiter_next(*li))) {
         if (sscanf((*li)->buf, "ngram %d=%d", &ngram, &ngram_cnt) != 2)
             break;
+        if (ngram > *n_order)
+            *n_order = ngram;
         switch (ngram) {
         case 1:
             *n_ug = ngram_cnt;
@@ -93,6 +98,9 @@ ReadNgramCounts(lineiter_t **li, int32 * n_ug, int32 * n_bg, int32 * n_tg)
             *n_tg = ngram_cnt;
             break;
         default:
+            /* Higher orders are handled by the trie reader. */
+            if (ngram > 3)
+                break;
             E_ERROR("Unknown ngram (%d)\n", ngram);
             return -1;
         }
@@ -469,11 +477,18 @@ ngram_model_arpa_read(cmd_ln_t *config,
     li = lineiter_start(fp);
  
     /* Read #unigrams, #bigrams, #trigrams from file */
-    if (ReadNgramCounts(&li, &n_unigram, &n_bigram, &n_trigram) == -1) {
+    if (ReadNgramCounts(&li, &n_unigram, &n_bigram, &n_trigram, &n) == -1) {
         lineiter_free(li);
         fclose_comp(fp, is_pipe);
         return NULL;
     }
+    if (n > 3) {
+        /* lm3g_model_t can't go past trigrams, so read it into a trie. */
+        E_INFO("Reading %d-gram model as a trie\n", n);
+        lineiter_free(li);
+        fclose_comp(fp, is_pipe);
+        return ngram_model_trie_read_arpa(config, file_name, lmath);
+    }
     E_INFO("ngrams 1=%d, 2=%d, 3=%d\n", n_unigram, n_bigram, n_trigram);
 
     /* Allocate space for LM, including initial OOVs and placeholders; initialize it */
@@ -558,9 +573,8 @@ ngram_model_arpa_read(cmd_ln_t *config,
 
         free_sorted_list(&model->sorted_prob3);
 
-        /* Initialize tginfo */
-        model->lm3g.tginfo = ckd_calloc(n_unigram, sizeof(tginfo_t *));
-        model->lm3g.le = listelem_alloc_init(sizeof(tginfo_t));
+        /* Initialize trigram cache */
+        lm3g_tgcache_init(base, &model->lm3g);
     }
 
     lineiter_free(li);
@@ -640,7 +654,7 @@ ngram_model_arpa_free(ngram_model_t *base)
     ckd_free(model->lm3g.prob2);
     ckd_free(model->lm3g.bo_wt2);
     ckd_free(model->lm3g.prob3);
-    lm3g_tginfo_free(base, &model->lm3g);
+    lm3g_tgcache_free(base, &model->lm3g);
     ckd_free(model->lm3g.tseg_base);
 }
 
@@ -650,7 +664,7 @@ static ngram_funcs_t ngram_model_arpa_funcs = {
     lm3g_template_score,            /* score */
     lm3g_template_raw_score,        /* raw_score */
     lm3g_template_add_ug,           /* add_ug */
-    lm3g_template_flush,            /* flush */
+    NULL,                           /* flush */
     lm3g_template_iter,             /* iter */
     lm3g_template_mgrams,           /* mgrams */
     lm3g_template_successors,       /* successors */
@@ -312,9 +312,8 @@ ngram_model_dmp_read(cmd_ln_t *config,
             }
         }
         E_INFO("%8d = LM.trigrams read\n", n_trigram);
-        /* Initialize tginfo */
-        model->lm3g.tginfo = ckd_calloc(n_unigram, sizeof(tginfo_t *));
-        model->lm3g.le = listelem_alloc_init(sizeof(tginfo_t));
+        /* Initialize trigram cache */
+        lm3g_tgcache_init(base, &model->lm3g);
     }
 
     if (n_bigram > 0) {
@@ -637,9 +636,8 @@ ngram_model_dmp_build(ngram_model_t *base)
         E_INFO("%8d = #trigrams created\n", newbase->n_counts[2]);
         E_INFO("%8d = #prob3 entries\n", model->lm3g.n_prob3);
         free_sorted_list(&sorted_prob3);
-        /* Initialize tginfo */
-        model->lm3g.tginfo = ckd_calloc(newbase->n_counts[0], sizeof(tginfo_t *));
-        model->lm3g.le = listelem_alloc_init(sizeof(tginfo_t));
+        /* Initialize trigram cache */
+        lm3g_tgcache_init(newbase, &model->lm3g);
     }
 
     return model;
@@ -950,7 +948,7 @@ ngram_model_dmp_free(ngram_model_t *base)
         ckd_free(model->lm3g.prob3);
     }
 
-    lm3g_tginfo_free(base, &model->lm3g);
+    lm3g_tgcache_free(base, &model->lm3g);
 }
 
 static ngram_funcs_t ngram_model_dmp_funcs = {
@@ -959,7 +957,7 @@ static ngram_funcs_t ngram_model_dmp_funcs = {
     lm3g_template_score,           /* score */
     lm3g_template_raw_score,       /* raw_score */
     lm3g_template_add_ug,          /* add_ug */
-    lm3g_template_flush,           /* flush */
+    NULL,                          /* flush */
     lm3g_template_iter,             /* iter */
     lm3g_template_mgrams,          /* mgrams */
     lm3g_template_successors,      /* successors */
@@ -234,6 +234,20 @@ ngram_model_t *ngram_model_dmp32_read(cmd_ln_t *config,
 				     const char *file_name,
 				     logmath_t *lmath);
 
+/**
+ * Read an N-Gram model from a trie file.
+ */
+ngram_model_t *ngram_model_trie_read(cmd_ln_t *config,
+                                     const char *file_name,
+                                     logmath_t *lmath);
+
+/**
+ * Check whether a file starts with the trie magic number.
+ *
+ * @return TRUE if it does, FALSE if it does not or cannot be read.
+ */
+int ngram_model_trie_probe(const char *file_name);
+
 /**
  * Write an N-Gram model to an ARPABO text file.
  */
@@ -244,6 +258,11 @@ int ngram_model_arpa_write(ngram_model_t *model,
  */
 int ngram_model_dmp_write(ngram_model_t *model,
 			  const char *file_name);
+/**
+ * Write an N-Gram model to a trie file.
+ */
+int ngram_model_trie_write(ngram_model_t *model,
+                           const char *file_name);
 
 /**
  * Read a probdef file.
@@ -0,0 +1,1425 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*
+ * \file ngram_model_trie.c Memory-mappable trie format language models
+ *
+ * Unlike lm3g_model_t, the trie has no limit on the order of the
+ * model or on the number of N-grams following any given history.
+ * Each level of the trie is a sorted array of bit-packed records, the
+ * successors of an entry being a contiguous range of the next level,
+ * and N-gram probabilities and backoff weights are quantized into
+ * small per-level tables.  Everything except those tables and the
+ * unigrams (which can be reweighted and added to) is used directly
+ * from the file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "sphinxbase/ckd_alloc.h"
+#include "sphinxbase/err.h"
+#include "sphinxbase/pio.h"
+#include "sphinxbase/strfuncs.h"
+
+#include "ngram_model_trie.h"
+
+static ngram_funcs_t ngram_model_trie_funcs;
+
+#define TRIE_BYTEORDER 0x11223344
+/** Alignment of all sections of a trie file. */
+#define TRIE_ALIGN(n) (((n) + 7) & ~(uint64)7)
+/** Records are read 64 bits at a time, so pad each level this much. */
+#define TRIE_PAD 8
+
+#define BINARY_SEARCH_THRESH 16
+
+static uint32
+trie_bits_get(uint8 const *bits, uint64 pos, int n_bits)
+{
+    uint64 val;
+
+    if (n_bits == 0)
+        return 0;
+#ifdef WORDS_BIGENDIAN
+    {
+        int i;
+
+        val = 0;
+        for (i = 7; i >= 0; --i)
+            val = (val << 8) | bits[(pos >> 3) + i];
+    }
+#else
+    memcpy(&val, bits + (pos >> 3), sizeof(val));
+#endif
+    return (uint32)((val >> (pos & 7)) & (((uint64)1 << n_bits) - 1));
+}
+
+static void
+trie_bits_put(uint8 *bits, uint64 pos, int n_bits, uint32 val)
+{
+    while (n_bits > 0) {
+        int shift = (int)(pos & 7);
+        int n = 8 - shift;
+
+        if (n > n_bits)
+            n = n_bits;
+        bits[pos >> 3] |= (uint8)((val & ((1 << n) - 1)) << shift);
+        val >>= n;
+        pos += n;
+        n_bits -= n;
+    }
+}
+
+#define REC_POS(lev,i) ((uint64)(i) * (lev)->rec_bits)
+
+static int32
+trie_wid(ngram_trie_level_t *lev, int32 i)
+{
+    return trie_bits_get(lev->bits, REC_POS(lev, i), lev->wid_bits);
+}
+
+static int32
+trie_prob(ngram_trie_level_t *lev, int32 i)
+{
+    return lev->prob[trie_bits_get(lev->bits, REC_POS(lev, i)
+                                   + lev->wid_bits, lev->prob_bits)];
+}
+
+static int32
+trie_bowt(ngram_trie_level_t *lev, int32 i)
+{
+    return lev->bowt[trie_bits_get(lev->bits, REC_POS(lev, i)
+                                   + lev->wid_bits + lev->prob_bits,
+                                   lev->bowt_bits)];
+}
+
+static int32
+trie_next(ngram_trie_level_t *lev, int32 i)
+{
+    return trie_bits_get(lev->bits, REC_POS(lev, i)
+                         + lev->wid_bits + lev->prob_bits + lev->bowt_bits,
+                         lev->next_bits);
+}
+
+/* Index of the first successor of entry i at level m. */
+static int32
+trie_first(ngram_model_trie_t *model, int m, int32 i)
+{
+    if (m == 0)
+        return model->ug_next[i];
+    return trie_next(model->levels + m, i);
+}
+
+/* Find the range of successors of entry i at level m, returning its size. */
+static int32
+trie_successors(ngram_model_trie_t *model, int m, int32 i,
+                int32 *out_b, int32 *out_e)
+{
+    if (m >= model->base.n - 1 || (m == 0 && i >= model->n_ug)) {
+        /* Highest order, or a unigram added after loading. */
+        *out_b = *out_e = 0;
+        return 0;
+    }
+    *out_b = trie_first(model, m, i);
+    *out_e = trie_first(model, m, i + 1);
+    return *out_e - *out_b;
+}
+
+/* Locate a word among the entries b to e of a level. */
+static int32
+trie_find(ngram_trie_level_t *lev, int32 b, int32 e, int32 wid)
+{
+    int32 i;
+
+    /* Binary search until segment size < threshold */
+    while (e - b > BINARY_SEARCH_THRESH) {
+        int32 w;
+
+        i = (b + e) >> 1;
+        w = trie_wid(lev, i);
+        if (w < wid)
+            b = i + 1;
+        else if (w > wid)
+            e = i;
+        else
+            return i;
+    }
+
+    /* Linear search within narrowed segment */
+    for (i = b; (i < e) && (trie_wid(lev, i) != wid); i++);
+    return ((i < e) ? i : -1);
+}
+
+/* Locate the entry for the n_hist most recent words of a history. */
+static int32
+trie_find_hist(ngram_model_trie_t *model, int32 *history, int32 n_hist)
+{
+    int32 i, m, b, e;
+
+    i = history[n_hist - 1];
+    for (m = 1; m < n_hist; ++m) {
+        if (trie_successors(model, m - 1, i, &b, &e) == 0)
+            return -1;
+        if ((i = trie_find(model->levels + m, b, e,
+                           history[n_hist - 1 - m])) < 0)
+            return -1;
+    }
+    return i;
+}
+
+/* Find the entry at level m - 1 that entry i at level m succeeds. */
+static int32
+trie_parent(ngram_model_trie_t *model, int m, int32 i)
+{
+    int32 b, e;
+
+    b = 0;
+    e = (m == 1) ? model->n_ug : model->levels[m - 1].n_entries;
+    /* Find the last entry whose successors start at or before i. */
+    while (e - b > 1) {
+        int32 mid = (b + e) >> 1;
+        if (trie_first(model, m - 1, mid) <= i)
+            b = mid;
+        else
+            e = mid;
+    }
+    return b;
+}
+
+static int32
+ngram_model_trie_score(ngram_model_t *base, int32 wid,
+                       int32 *history, int32 n_hist,
+                       int32 *n_used)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    int32 i, bowt;
+
+    if (n_hist > base->n - 1)
+        n_hist = base->n - 1;
+    for (i = 0; i < n_hist; ++i) {
+        if (history[i] < 0) {
+            n_hist = i;
+            break;
+        }
+    }
+
+    /* Back off from the longest history, accumulating the backoff
+     * weights of the histories found along the way. */
+    bowt = 0;
+    for (; n_hist > 0; --n_hist) {
+        int32 h, b, e;
+
+        if ((h = trie_find_hist(model, history, n_hist)) < 0)
+            continue;
+        if (trie_successors(model, n_hist - 1, h, &b, &e) > 0
+            && (i = trie_find(model->levels + n_hist, b, e, wid)) >= 0) {
+            *n_used = n_hist + 1;
+            return bowt + trie_prob(model->levels + n_hist, i);
+        }
+        if (n_hist == 1)
+            bowt += model->bowt1[h];
+        else
+            bowt += trie_bowt(model->levels + n_hist - 1, h);
+    }
+
+    /* Access mode = unigram */
+    *n_used = 1;
+    return bowt + model->prob1[wid];
+}
+
+static int32
+ngram_model_trie_raw_score(ngram_model_t *base, int32 wid,
+                           int32 *history, int32 n_hist,
+                           int32 *n_used)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    int32 score;
+
+    if (n_hist == 0) {
+        *n_used = 1;
+        return model->raw_prob1[wid];
+    }
+    score = ngram_model_trie_score(base, wid, history, n_hist, n_used);
+    /* FIXME (maybe): This doesn't undo unigram weighting in backoff cases. */
+    return (int32)((score - base->log_wip) / base->lw);
+}
+
+static int32
+trie_weight_prob1(ngram_model_t *base, int32 wid, int32 prob1,
+                  float32 lw, int32 log_wip, int32 log_uw,
+                  int32 log_uniform_weight)
+{
+    /* Interpolate unigram probability with uniform, except for <s>. */
+    if (base->word_str[wid] == NULL
+        || strcmp(base->word_str[wid], "<s>") != 0) /* FIXME: configurable start_sym */
+        prob1 = logmath_add(base->lmath, prob1 + log_uw,
+                            base->log_uniform + log_uniform_weight);
+    /* Apply language weight and WIP */
+    return (int32)(prob1 * lw) + log_wip;
+}
+
+static int
+ngram_model_trie_apply_weights(ngram_model_t *base, float32 lw,
+                               float32 wip, float32 uw)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    int32 log_wip, log_uw, log_uniform_weight;
+    int32 i, m;
+
+    /* Precalculate some log values we will like. */
+    log_wip = logmath_log(base->lmath, wip);
+    log_uw = logmath_log(base->lmath, uw);
+    log_uniform_weight = logmath_log(base->lmath, 1.0 - uw);
+
+    /* Unweighted values are kept around, so unlike lm3g_model_t
+     * there is no need to undo the previous weights first. */
+    for (i = 0; i < base->n_counts[0]; ++i) {
+        model->prob1[i] = trie_weight_prob1(base, i, model->raw_prob1[i],
+                                            lw, log_wip, log_uw,
+                                            log_uniform_weight);
+        model->bowt1[i] = (int32)(model->raw_bowt1[i] * lw);
+    }
+    for (m = 1; m < base->n; ++m) {
+        ngram_trie_level_t *lev = model->levels + m;
+
+        for (i = 0; i < lev->n_prob; ++i)
+            lev->prob[i] = (int32)(lev->raw_prob[i] * lw) + log_wip;
+        for (i = 0; i < lev->n_bowt; ++i)
+            lev->bowt[i] = (int32)(lev->raw_bowt[i] * lw);
+    }
+
+    /* Store updated values in the model. */
+    base->log_wip = log_wip;
+    base->log_uw = log_uw;
+    base->log_uniform_weight = log_uniform_weight;
+    base->lw = lw;
+    return 0;
+}
+
+static int32
+ngram_model_trie_add_ug(ngram_model_t *base, int32 wid, int32 lweight)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    size_t n_new;
+
+    /* Reallocate unigram arrays. */
+    n_new = base->n_1g_alloc - base->n_counts[0];
+    model->raw_prob1 = ckd_realloc(model->raw_prob1,
+                                   base->n_1g_alloc * sizeof(*model->raw_prob1));
+    model->raw_bowt1 = ckd_realloc(model->raw_bowt1,
+                                   base->n_1g_alloc * sizeof(*model->raw_bowt1));
+    model->prob1 = ckd_realloc(model->prob1,
+                               base->n_1g_alloc * sizeof(*model->prob1));
+    model->bowt1 = ckd_realloc(model->bowt1,
+                               base->n_1g_alloc * sizeof(*model->bowt1));
+    memset(model->raw_prob1 + base->n_counts[0], 0, n_new * sizeof(int32));
+    memset(model->raw_bowt1 + base->n_counts[0], 0, n_new * sizeof(int32));
+    memset(model->prob1 + base->n_counts[0], 0, n_new * sizeof(int32));
+    memset(model->bowt1 + base->n_counts[0], 0, n_new * sizeof(int32));
+
+    /* As in lm3g_add_ug(), the other unigrams are not renormalized.
+     * This word doesn't participate in any bigrams, so its backoff
+     * weight is irrelevant, and trie_successors() knows that it
+     * has no successors since it is past the end of the trie. */
+    model->raw_prob1[wid] = lweight + base->log_uniform;
+    model->prob1[wid] = trie_weight_prob1(base, wid, model->raw_prob1[wid],
+                                          base->lw, base->log_wip,
+                                          base->log_uw,
+                                          base->log_uniform_weight);
+    ++base->n_counts[0];
+    /* See the comment in lm3g_add_ug() about class words. */
+    if (wid >= base->n_counts[0])
+        base->n_counts[0] = wid + 1;
+
+    return model->prob1[wid];
+}
+
+typedef struct trie_iter_s {
+    ngram_iter_t base;
+    int32 *idx;       /**< Index of the current entry at levels 0 to m. */
+    int32 end;        /**< End of successors, for successor iterators. */
+} trie_iter_t;
+
+static trie_iter_t *
+trie_iter_new(ngram_model_t *base, int m, int successor)
+{
+    trie_iter_t *itor = ckd_calloc(1, sizeof(*itor));
+
+    ngram_iter_init((ngram_iter_t *)itor, base, m, successor);
+    itor->idx = ckd_calloc(base->n, sizeof(*itor->idx));
+    return itor;
+}
+
+static ngram_iter_t *
+ngram_model_trie_iter(ngram_model_t *base, int32 wid,
+                      int32 *history, int32 n_hist)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    trie_iter_t *itor;
+    int32 m, b, e;
+
+    itor = trie_iter_new(base, n_hist, FALSE);
+    itor->idx[0] = (n_hist > 0) ? history[n_hist - 1] : wid;
+    if (itor->idx[0] < 0 || itor->idx[0] >= base->n_counts[0])
+        goto fail;
+    for (m = 1; m <= n_hist; ++m) {
+        int32 w = (m < n_hist) ? history[n_hist - 1 - m] : wid;
+
+        if (trie_successors(model, m - 1, itor->idx[m - 1], &b, &e) == 0)
+            goto fail;
+        if ((itor->idx[m] = trie_find(model->levels + m, b, e, w)) < 0)
+            goto fail;
+    }
+    return (ngram_iter_t *)itor;
+
+fail:
+    ngram_iter_free((ngram_iter_t *)itor);
+    return NULL;
+}
+
+static ngram_iter_t *
+ngram_model_trie_mgrams(ngram_model_t *base, int m)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    trie_iter_t *itor;
+    int k;
+
+    if (base->n_counts[m] == 0)
+        return NULL;
+    itor = trie_iter_new(base, m, FALSE);
+    /* Find the ancestors of the first entry. */
+    for (k = m; k > 0; --k)
+        itor->idx[k - 1] = trie_parent(model, k, itor->idx[k]);
+    return (ngram_iter_t *)itor;
+}
+
+static ngram_iter_t *
+ngram_model_trie_successors(ngram_iter_t *bitor)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)bitor->model;
+    trie_iter_t *from = (trie_iter_t *)bitor;
+    trie_iter_t *itor;
+    int32 b, e;
+
+    if (trie_successors(model, bitor->m, from->idx[bitor->m], &b, &e) == 0)
+        return NULL;
+    itor = trie_iter_new(bitor->model, bitor->m + 1, TRUE);
+    memcpy(itor->idx, from->idx, (bitor->m + 1) * sizeof(*itor->idx));
+    itor->idx[bitor->m + 1] = b;
+    itor->end = e;
+    return (ngram_iter_t *)itor;
+}
+
+static int32 const *
+ngram_model_trie_iter_get(ngram_iter_t *base,
+                          int32 *out_score, int32 *out_bowt)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base->model;
+    trie_iter_t *itor = (trie_iter_t *)base;
+    int32 i = itor->idx[base->m];
+    int k;
+
+    base->wids[0] = itor->idx[0];
+    for (k = 1; k <= base->m; ++k)
+        base->wids[k] = trie_wid(model->levels + k, itor->idx[k]);
+    if (base->m == 0) {
+        *out_score = model->prob1[i];
+        *out_bowt = model->bowt1[i];
+    }
+    else {
+        *out_score = trie_prob(model->levels + base->m, i);
+        if (base->m < base->model->n - 1)
+            *out_bowt = trie_bowt(model->levels + base->m, i);
+        else
+            *out_bowt = 0;
+    }
+    return base->wids;
+}
+
+static ngram_iter_t *
+ngram_model_trie_iter_next(ngram_iter_t *base)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base->model;
+    trie_iter_t *itor = (trie_iter_t *)base;
+    int k;
+
+    ++itor->idx[base->m];
+    /* Check for end condition. */
+    if (base->successor) {
+        if (itor->idx[base->m] >= itor->end)
+            goto done;
+        return base;
+    }
+    if (itor->idx[base->m] >= base->model->n_counts[base->m])
+        goto done;
+    /* Advance ancestors as needed to get the ones this entry succeeds. */
+    for (k = base->m; k > 0; --k) {
+        while (itor->idx[k] >= trie_first(model, k - 1, itor->idx[k - 1] + 1))
+            ++itor->idx[k - 1];
+    }
+    return base;
+
+done:
+    ngram_iter_free(base);
+    return NULL;
+}
+
+static void
+ngram_model_trie_iter_free(ngram_iter_t *base)
+{
+    trie_iter_t *itor = (trie_iter_t *)base;
+
+    ckd_free(itor->idx);
+    ckd_free(itor);
+}
+
+static void
+ngram_model_trie_free(ngram_model_t *base)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *)base;
+    int m;
+
+    if (model->levels) {
+        for (m = 1; m < base->n; ++m) {
+            ckd_free(model->levels[m].raw_prob);
+            ckd_free(model->levels[m].raw_bowt);
+            ckd_free(model->levels[m].prob);
+            ckd_free(model->levels[m].bowt);
+        }
+        ckd_free(model->levels);
+    }
+    ckd_free(model->raw_prob1);
+    ckd_free(model->raw_bowt1);
+    ckd_free(model->prob1);
+    ckd_free(model->bowt1);
+    if (model->trie_mmap)
+        mmio_file_unmap(model->trie_mmap);
+    else
+        ckd_free(model->buf);
+}
+
+static int
+trie_range_ok(size_t len, uint64 offset, uint64 size)
+{
+    return offset <= len && size <= len - offset;
+}
+
+/* Check the header and level descriptions of a trie image. */
+static int
+trie_image_check(uint8 const *img, size_t len, const char *file_name)
+{
+    ngram_trie_header_t const *hdr = (ngram_trie_header_t const *)img;
+    ngram_trie_level_hdr_t const *lhdr;
+    uint64 i;
+    uint32 m, n_words;
+
+    if (len < sizeof(*hdr)
+        || 0 != memcmp(hdr->magic, NGRAM_TRIE_MAGIC, sizeof(hdr->magic))) {
+        E_ERROR("%s is not a trie format language model\n", file_name);
+        return -1;
+    }
+    if (hdr->byteorder != TRIE_BYTEORDER) {
+        E_ERROR("%s was written on a machine with different byte order, "
+                "please regenerate it\n", file_name);
+        return -1;
+    }
+    if (hdr->version != NGRAM_TRIE_VERSION) {
+        E_ERROR("%s has version %u, expected %u\n",
+                file_name, hdr->version, NGRAM_TRIE_VERSION);
+        return -1;
+    }
+    if (hdr->logbase <= 1.0 || hdr->log_shift > 30) {
+        E_ERROR("Invalid log base %f or shift %u in %s\n",
+                hdr->logbase, hdr->log_shift, file_name);
+        return -1;
+    }
+    if (hdr->order < 1 || hdr->order > 255 || hdr->n_words < 1
+        || !trie_range_ok(len, sizeof(*hdr),
+                          (uint64)(hdr->order - 1) * sizeof(*lhdr))) {
+        E_ERROR("Invalid order %u or word count %u in %s\n",
+                hdr->order, hdr->n_words, file_name);
+        return -1;
+    }
+
+    /* Word strings and unigrams. */
+    n_words = 0;
+    if (trie_range_ok(len, hdr->words_offset, hdr->words_len)
+        && hdr->words_len > 0
+        && img[hdr->words_offset + hdr->words_len - 1] == '\0') {
+        for (i = 0; i < hdr->words_len; ++i)
+            if (img[hdr->words_offset + i] == '\0')
+                ++n_words;
+    }
+    if (n_words != hdr->n_words) {
+        E_ERROR("Error reading word strings (%u doesn't match n_words %u)\n",
+                n_words, hdr->n_words);
+        return -1;
+    }
+    if (!trie_range_ok(len, hdr->ug_offset,
+                       TRIE_ALIGN((uint64)hdr->n_words * 8)
+                       + (hdr->order > 1 ? (uint64)(hdr->n_words + 1) * 4 : 0))) {
+        E_ERROR("Truncated unigrams in %s\n", file_name);
+        return -1;
+    }
+
+    /* Higher-order levels. */
+    lhdr = (ngram_trie_level_hdr_t const *)(img + sizeof(*hdr));
+    for (m = 1; m < hdr->order; ++m, ++lhdr) {
+        uint64 n_recs = lhdr->n_entries + (m < hdr->order - 1);
+        uint64 rec_bits = lhdr->wid_bits + lhdr->prob_bits
+            + lhdr->bowt_bits + lhdr->next_bits;
+
+        if (lhdr->wid_bits > 32 || lhdr->next_bits > 32
+            || lhdr->prob_bits > NGRAM_TRIE_QUANT_BITS
+            || lhdr->bowt_bits > NGRAM_TRIE_QUANT_BITS
+            || lhdr->n_entries > 0x7fffffff
+            || lhdr->n_prob > (1U << lhdr->prob_bits)
+            || lhdr->n_bowt > (1U << lhdr->bowt_bits)
+            || !trie_range_ok(len, lhdr->prob_offset,
+                              (uint64)lhdr->n_prob * sizeof(int32))
+            || !trie_range_ok(len, lhdr->bowt_offset,
+                              (uint64)lhdr->n_bowt * sizeof(int32))
+            || !trie_range_ok(len, lhdr->bits_offset, lhdr->bits_len)
+            || lhdr->bits_len < (n_recs * rec_bits + 7) / 8 + TRIE_PAD) {
+            E_ERROR("Invalid or truncated %u-grams in %s\n", m + 1, file_name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Copy log values from the image, converting them to lmath if needed. */
+static void
+trie_log_copy(logmath_t *lmath, ngram_trie_header_t const *hdr,
+              int32 *out_vals, int32 const *vals, int32 n_vals)
+{
+    float64 log10_of_base;
+    int32 i;
+
+    if (hdr->logbase == logmath_get_base(lmath)
+        && (int)hdr->log_shift == logmath_get_shift(lmath)) {
+        memcpy(out_vals, vals, n_vals * sizeof(*vals));
+        return;
+    }
+    log10_of_base = log10(hdr->logbase) * (1 << hdr->log_shift);
+    for (i = 0; i < n_vals; ++i)
+        out_vals[i] = logmath_log10_to_log(lmath, vals[i] * log10_of_base);
+}
+
+/* Allocate a table of 1 << n_bits values so stray indices are safe. */
+static int32 *
+trie_table_init(logmath_t *lmath, ngram_trie_header_t const *hdr,
+                int32 const *vals, int32 n_vals, int n_bits)
+{
+    int32 *table;
+
+    table = ckd_calloc((size_t)1 << n_bits, sizeof(*table));
+    trie_log_copy(lmath, hdr, table, vals, n_vals);
+    return table;
+}
+
+/*
+ * Create a model from a trie image, taking ownership of either
+ * trie_mmap or buf, whichever is not NULL.
+ */
+static ngram_model_t *
+ngram_model_trie_init(logmath_t *lmath, mmio_file_t *trie_mmap,
+                      uint8 *buf, uint8 const *img, size_t len,
+                      const char *file_name)
+{
+    ngram_trie_header_t const *hdr = (ngram_trie_header_t const *)img;
+    ngram_trie_level_hdr_t const *lhdr;
+    ngram_model_trie_t *model;
+    ngram_model_t *base;
+    int32 const *ug_vals;
+    char const *word;
+    int32 i, m, n_words;
+
+    if (trie_image_check(img, len, file_name) < 0) {
+        if (trie_mmap)
+            mmio_file_unmap(trie_mmap);
+        ckd_free(buf);
+        return NULL;
+    }
+    n_words = hdr->n_words;
+
+    model = ckd_calloc(1, sizeof(*model));
+    base = &model->base;
+    model->trie_mmap = trie_mmap;
+    model->buf = buf;
+    /* Make sure there is room for at least trigram counts. */
+    base->n_counts = ckd_calloc(hdr->order > 3 ? hdr->order : 3,
+                                sizeof(*base->n_counts));
+    ngram_model_init(base, &ngram_model_trie_funcs, lmath,
+                     hdr->order, n_words);
+    base->writable = FALSE;
+
+    /* Word strings are used in place. */
+    word = (char const *)img + hdr->words_offset;
+    for (i = 0; i < n_words; ++i) {
+        base->word_str[i] = (char *)word;
+        if (hash_table_enter(base->wid, base->word_str[i],
+                             (void *)(long)i) != (void *)(long)i) {
+            E_WARN("Duplicate word in dictionary: %s\n", base->word_str[i]);
+        }
+        word += strlen(word) + 1;
+    }
+
+    /* Unigrams are copied, since they change with weights and new words. */
+    model->n_ug = n_words;
+    ug_vals = (int32 const *)(img + hdr->ug_offset);
+    model->raw_prob1 = ckd_calloc(n_words, sizeof(*model->raw_prob1));
+    model->raw_bowt1 = ckd_calloc(n_words, sizeof(*model->raw_bowt1));
+    model->prob1 = ckd_calloc(n_words, sizeof(*model->prob1));
+    model->bowt1 = ckd_calloc(n_words, sizeof(*model->bowt1));
+    trie_log_copy(lmath, hdr, model->raw_prob1, ug_vals, n_words);
+    trie_log_copy(lmath, hdr, model->raw_bowt1, ug_vals + n_words, n_words);
+    memcpy(model->prob1, model->raw_prob1, n_words * sizeof(*model->prob1));
+    memcpy(model->bowt1, model->raw_bowt1, n_words * sizeof(*model->bowt1));
+    if (hdr->order > 1)
+        model->ug_next = (uint32 const *)(img + hdr->ug_offset
+                                          + TRIE_ALIGN((uint64)n_words * 8));
+    E_INFO("%8d = #unigrams\n", n_words);
+
+    /* Everything else but the quantization tables is used in place. */
+    model->levels = ckd_calloc(hdr->order, sizeof(*model->levels));
+    lhdr = (ngram_trie_level_hdr_t const *)(img + sizeof(*hdr));
+    for (m = 1; m < base->n; ++m, ++lhdr) {
+        ngram_trie_level_t *lev = model->levels + m;
+
+        lev->bits = img + lhdr->bits_offset;
+        lev->n_entries = lhdr->n_entries;
+        lev->wid_bits = lhdr->wid_bits;
+        lev->prob_bits = lhdr->prob_bits;
+        lev->bowt_bits = lhdr->bowt_bits;
+        lev->next_bits = lhdr->next_bits;
+        lev->rec_bits = lev->wid_bits + lev->prob_bits
+            + lev->bowt_bits + lev->next_bits;
+        lev->n_prob = lhdr->n_prob;
+        lev->n_bowt = lhdr->n_bowt;
+        lev->raw_prob = trie_table_init(lmath, hdr, (int32 const *)
+                                        (img + lhdr->prob_offset),
+                                        lev->n_prob, lev->prob_bits);
+        lev->raw_bowt = trie_table_init(lmath, hdr, (int32 const *)
+                                        (img + lhdr->bowt_offset),
+                                        lev->n_bowt, lev->bowt_bits);
+        lev->prob = ckd_calloc((size_t)1 << lev->prob_bits, sizeof(*lev->prob));
+        lev->bowt = ckd_calloc((size_t)1 << lev->bowt_bits, sizeof(*lev->bowt));
+        memcpy(lev->prob, lev->raw_prob, lev->n_prob * sizeof(*lev->prob));
+        memcpy(lev->bowt, lev->raw_bowt, lev->n_bowt * sizeof(*lev->bowt));
+        base->n_counts[m] = lev->n_entries;
+        E_INFO("%8d = #%d-grams (%d bits each, %d probs, %d bowts)\n",
+               lev->n_entries, m + 1, lev->rec_bits,
+               lev->n_prob, lev->n_bowt);
+    }
+
+    return base;
+}
+
+int
+ngram_model_trie_probe(const char *file_name)
+{
+    char magic[8];
+    FILE *fh;
+    int rv;
+
+    if ((fh = fopen(file_name, "rb")) == NULL)
+        return FALSE;
+    rv = (fread(magic, 1, sizeof(magic), fh) == sizeof(magic)
+          && 0 == memcmp(magic, NGRAM_TRIE_MAGIC, sizeof(magic)));
+    fclose(fh);
+    return rv;
+}
+
+ngram_model_t *
+ngram_model_trie_read(cmd_ln_t *config,
+                      const char *file_name,
+                      logmath_t *lmath)
+{
+    mmio_file_t *trie_mmap = NULL;
+    uint8 *buf = NULL;
+    uint8 const *img;
+    char magic[8];
+    FILE *fh;
+    long len;
+    int do_mmap;
+
+    do_mmap = FALSE;
+    if (config && cmd_ln_exists_r(config, "-mmap"))
+        do_mmap = cmd_ln_boolean_r(config, "-mmap");
+
+    if ((fh = fopen(file_name, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s", file_name);
+        return NULL;
+    }
+    if (fread(magic, 1, sizeof(magic), fh) != sizeof(magic)
+        || 0 != memcmp(magic, NGRAM_TRIE_MAGIC, sizeof(magic))) {
+        E_INFO("%s is not a trie format language model\n", file_name);
+        fclose(fh);
+        return NULL;
+    }
+    fseek(fh, 0, SEEK_END);
+    len = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+
+    if (do_mmap) {
+        if ((trie_mmap = mmio_file_read(file_name)) == NULL)
+            E_WARN("Failed to memory-map %s, will read it instead\n",
+                   file_name);
+        else
+            E_INFO("Mapped trie %s (%ld bytes)\n", file_name, len);
+    }
+    if (trie_mmap) {
+        img = mmio_file_ptr(trie_mmap);
+    }
+    else {
+        buf = ckd_malloc(len);
+        if (fread(buf, 1, len, fh) != (size_t)len) {
+            E_ERROR_SYSTEM("Failed to read %s", file_name);
+            ckd_free(buf);
+            fclose(fh);
+            return NULL;
+        }
+        img = buf;
+    }
+    fclose(fh);
+
+    return ngram_model_trie_init(lmath, trie_mmap, buf, img, len, file_name);
+}
+
+/**
+ * N-grams of one order, collected in no particular order before
+ * building a trie from them.
+ */
+typedef struct trie_ngrams_s {
+    int32 n;            /**< Number of N-grams */
+    int32 *wids;        /**< Word IDs, oldest first (NULL for unigrams) */
+    int32 *prob;        /**< Log probabilities */
+    int32 *bowt;        /**< Log backoff weights */
+} trie_ngrams_t;
+
+static void
+trie_ngrams_alloc(trie_ngrams_t *ng, int32 n, int order)
+{
+    ng->n = 0;
+    if (order > 1)
+        ng->wids = ckd_calloc((size_t)n * order, sizeof(*ng->wids));
+    ng->prob = ckd_calloc(n, sizeof(*ng->prob));
+    ng->bowt = ckd_calloc(n, sizeof(*ng->bowt));
+}
+
+static void
+trie_ngrams_free(trie_ngrams_t *ngrams, int order)
+{
+    int m;
+
+    for (m = 0; m < order; ++m) {
+        ckd_free(ngrams[m].wids);
+        ckd_free(ngrams[m].prob);
+        ckd_free(ngrams[m].bowt);
+    }
+    ckd_free(ngrams);
+}
+
+static int
+trie_wids_cmp(int32 const *a, int32 const *b, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        if (a[i] != b[i])
+            return (a[i] < b[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Sort N-grams by word IDs with a radix sort, returning the permutation. */
+static int32 *
+trie_sort(int32 const *wids, int32 n, int order, int32 n_words)
+{
+    int32 *perm, *tmp, *count;
+    int32 i;
+    int k;
+
+    perm = ckd_calloc(n, sizeof(*perm));
+    tmp = ckd_calloc(n, sizeof(*tmp));
+    count = ckd_calloc(n_words + 1, sizeof(*count));
+    for (i = 0; i < n; ++i)
+        perm[i] = i;
+    for (k = order - 1; k >= 0; --k) {
+        int32 *swap;
+
+        memset(count, 0, (n_words + 1) * sizeof(*count));
+        for (i = 0; i < n; ++i)
+            ++count[wids[(size_t)perm[i] * order + k] + 1];
+        for (i = 0; i < n_words; ++i)
+            count[i + 1] += count[i];
+        for (i = 0; i < n; ++i)
+            tmp[count[wids[(size_t)perm[i] * order + k]]++] = perm[i];
+        swap = perm;
+        perm = tmp;
+        tmp = swap;
+    }
+    ckd_free(tmp);
+    ckd_free(count);
+    return perm;
+}
+
+static int
+trie_int32_cmp(const void *a, const void *b)
+{
+    int32 x = *(int32 const *)a;
+    int32 y = *(int32 const *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/*
+ * Build a table of at most 1 << n_bits values for vals.  If there are
+ * few enough distinct values they are stored exactly, otherwise each
+ * table entry is the mean of an equally populated range of them.
+ */
+static int32
+trie_quant_build(int32 const *vals, int32 n, int n_bits, int32 **out_table)
+{
+    int32 *sorted, *table;
+    int32 i, n_uniq, n_table, max_table;
+
+    max_table = 1 << n_bits;
+    if (n == 0) {
+        *out_table = ckd_calloc(1, sizeof(**out_table));
+        return 1;
+    }
+    sorted = ckd_calloc(n, sizeof(*sorted));
+    memcpy(sorted, vals, n * sizeof(*sorted));
+    qsort(sorted, n, sizeof(*sorted), trie_int32_cmp);
+    for (n_uniq = 1, i = 1; i < n; ++i)
+        if (sorted[i] != sorted[i - 1])
+            ++n_uniq;
+
+    n_table = 0;
+    if (n_uniq <= max_table) {
+        table = ckd_calloc(n_uniq, sizeof(*table));
+        for (i = 0; i < n; ++i)
+            if (i == 0 || sorted[i] != sorted[i - 1])
+                table[n_table++] = sorted[i];
+    }
+    else {
+        table = ckd_calloc(max_table, sizeof(*table));
+        for (i = 0; i < max_table; ++i) {
+            int32 b = (int32)((int64)n * i / max_table);
+            int32 e = (int32)((int64)n * (i + 1) / max_table);
+            float64 sum = 0;
+            int32 mean;
+            int32 j;
+
+            for (j = b; j < e; ++j)
+                sum += sorted[j];
+            mean = (int32)floor(sum / (e - b) + 0.5);
+            if (n_table == 0 || mean != table[n_table - 1])
+                table[n_table++] = mean;
+        }
+    }
+    ckd_free(sorted);
+    *out_table = table;
+    return n_table;
+}
+
+/* Find the nearest entry in a quantization table. */
+static uint32
+trie_quant_index(int32 const *table, int32 n_table, int32 val)
+{
+    int32 b, e;
+
+    b = 0;
+    e = n_table;
+    while (b < e) {
+        int32 i = (b + e) >> 1;
+        if (table[i] < val)
+            b = i + 1;
+        else
+            e = i;
+    }
+    if (b == n_table)
+        return n_table - 1;
+    if (b > 0 && val - table[b - 1] < table[b] - val)
+        return b - 1;
+    return b;
+}
+
+/* Number of bits needed to represent values up to max_val. */
+static int
+trie_bits_for(uint32 max_val)
+{
+    int n_bits = 0;
+
+    while (max_val) {
+        ++n_bits;
+        max_val >>= 1;
+    }
+    return n_bits;
+}
+
+/*
+ * Build a trie image from a set of N-grams.  Higher-order N-grams
+ * without a lower-order prefix are dropped, as are duplicates.
+ */
+static uint8 *
+trie_build(logmath_t *lmath, char * const *words, int32 n_words, int order,
+           trie_ngrams_t *ngrams, size_t *out_len)
+{
+    ngram_trie_header_t hdr;
+    ngram_trie_level_hdr_t *lhdr;
+    trie_ngrams_t *sorted;
+    uint32 **first;
+    int32 **prob_tab, **bowt_tab;
+    uint8 *img;
+    uint64 off;
+    size_t words_len;
+    int32 i;
+    int m;
+
+    sorted = ckd_calloc(order, sizeof(*sorted));
+    sorted[0] = ngrams[0];
+    first = ckd_calloc(order, sizeof(*first));
+    for (m = 1; m < order; ++m) {
+        trie_ngrams_t *in = ngrams + m;
+        trie_ngrams_t *out = sorted + m;
+        trie_ngrams_t *parent = sorted + m - 1;
+        int32 *perm, p, n_parent, n_orphan, n_dup;
+
+        perm = trie_sort(in->wids, in->n, m + 1, n_words);
+        trie_ngrams_alloc(out, in->n, m + 1);
+        n_parent = (m == 1) ? n_words : parent->n;
+        first[m - 1] = ckd_calloc(n_parent + 1, sizeof(**first));
+        n_orphan = n_dup = 0;
+        for (i = 0, p = 0; i < in->n; ++i) {
+            int32 const *w = in->wids + (size_t)perm[i] * (m + 1);
+
+            /* Find the (m-1)-gram this one succeeds. */
+            if (m == 1)
+                p = w[0];
+            else {
+                while (p < n_parent
+                       && trie_wids_cmp(parent->wids + (size_t)p * m, w, m) < 0)
+                    ++p;
+                if (p == n_parent
+                    || trie_wids_cmp(parent->wids + (size_t)p * m, w, m) != 0) {
+                    ++n_orphan;
+                    continue;
+                }
+            }
+            if (out->n > 0
+                && trie_wids_cmp(out->wids + (size_t)(out->n - 1) * (m + 1),
+                                 w, m + 1) == 0) {
+                ++n_dup;
+                continue;
+            }
+            memcpy(out->wids + (size_t)out->n * (m + 1), w,
+                   (m + 1) * sizeof(*w));
+            out->prob[out->n] = in->prob[perm[i]];
+            out->bowt[out->n] = in->bowt[perm[i]];
+            ++out->n;
+            ++first[m - 1][p + 1];
+        }
+        for (p = 0; p < n_parent; ++p)
+            first[m - 1][p + 1] += first[m - 1][p];
+        if (n_orphan)
+            E_WARN("Dropped %d %d-grams with no matching %d-gram\n",
+                   n_orphan, m + 1, m);
+        if (n_dup)
+            E_WARN("Dropped %d duplicate %d-grams\n", n_dup, m + 1);
+        ckd_free(perm);
+    }
+
+    /* Quantize probabilities and backoff weights and lay out the file. */
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, NGRAM_TRIE_MAGIC, sizeof(hdr.magic));
+    hdr.byteorder = TRIE_BYTEORDER;
+    hdr.version = NGRAM_TRIE_VERSION;
+    hdr.order = order;
+    hdr.n_words = n_words;
+    hdr.logbase = logmath_get_base(lmath);
+    hdr.log_shift = logmath_get_shift(lmath);
+    off = sizeof(hdr) + (order - 1) * sizeof(*lhdr);
+    words_len = 0;
+    for (i = 0; i < n_words; ++i)
+        words_len += strlen(words[i]) + 1;
+    hdr.words_offset = off = TRIE_ALIGN(off);
+    hdr.words_len = words_len;
+    hdr.ug_offset = off = TRIE_ALIGN(off + words_len);
+    off += TRIE_ALIGN((uint64)n_words * 8);
+    if (order > 1)
+        off += TRIE_ALIGN((uint64)(n_words + 1) * 4);
+
+    lhdr = ckd_calloc(order, sizeof(*lhdr));
+    prob_tab = ckd_calloc(order, sizeof(*prob_tab));
+    bowt_tab = ckd_calloc(order, sizeof(*bowt_tab));
+    for (m = 1; m < order; ++m) {
+        ngram_trie_level_hdr_t *lh = lhdr + m;
+        uint64 n_recs = sorted[m].n + (m < order - 1);
+
+        lh->n_entries = sorted[m].n;
+        lh->n_prob = trie_quant_build(sorted[m].prob, sorted[m].n,
+                                      NGRAM_TRIE_QUANT_BITS, &prob_tab[m]);
+        lh->n_bowt = trie_quant_build(sorted[m].bowt,
+                                      (m < order - 1) ? sorted[m].n : 0,
+                                      NGRAM_TRIE_QUANT_BITS, &bowt_tab[m]);
+        lh->wid_bits = trie_bits_for(n_words - 1);
+        lh->prob_bits = trie_bits_for(lh->n_prob - 1);
+        if (m < order - 1) {
+            lh->bowt_bits = trie_bits_for(lh->n_bowt - 1);
+            lh->next_bits = trie_bits_for(sorted[m + 1].n);
+        }
+        lh->prob_offset = off;
+        off += TRIE_ALIGN((uint64)lh->n_prob * sizeof(int32));
+        lh->bowt_offset = off;
+        off += TRIE_ALIGN((uint64)lh->n_bowt * sizeof(int32));
+        lh->bits_offset = off;
+        lh->bits_len = (n_recs * (lh->wid_bits + lh->prob_bits
+                                  + lh->bowt_bits + lh->next_bits) + 7) / 8
+            + TRIE_PAD;
+        off += TRIE_ALIGN(lh->bits_len);
+    }
+
+    /* Now fill it in. */
+    *out_len = off;
+    img = ckd_calloc(off, 1);
+    memcpy(img, &hdr, sizeof(hdr));
+    if (order > 1)
+        memcpy(img + sizeof(hdr), lhdr + 1, (order - 1) * sizeof(*lhdr));
+    off = hdr.words_offset;
+    for (i = 0; i < n_words; ++i) {
+        size_t len = strlen(words[i]) + 1;
+        memcpy(img + off, words[i], len);
+        off += len;
+    }
+    memcpy(img + hdr.ug_offset, ngrams[0].prob, n_words * sizeof(int32));
+    memcpy(img + hdr.ug_offset + n_words * sizeof(int32),
+           ngrams[0].bowt, n_words * sizeof(int32));
+    if (order > 1)
+        memcpy(img + hdr.ug_offset + TRIE_ALIGN((uint64)n_words * 8),
+               first[0], (n_words + 1) * sizeof(uint32));
+    for (m = 1; m < order; ++m) {
+        ngram_trie_level_hdr_t *lh = lhdr + m;
+        uint8 *bits = img + lh->bits_offset;
+        uint64 pos = 0;
+
+        memcpy(img + lh->prob_offset, prob_tab[m], lh->n_prob * sizeof(int32));
+        memcpy(img + lh->bowt_offset, bowt_tab[m], lh->n_bowt * sizeof(int32));
+        for (i = 0; i < sorted[m].n; ++i) {
+            trie_bits_put(bits, pos, lh->wid_bits,
+                          sorted[m].wids[(size_t)i * (m + 1) + m]);
+            pos += lh->wid_bits;
+            trie_bits_put(bits, pos, lh->prob_bits,
+                          trie_quant_index(prob_tab[m], lh->n_prob,
+                                           sorted[m].prob[i]));
+            pos += lh->prob_bits;
+            if (m < order - 1) {
+                trie_bits_put(bits, pos, lh->bowt_bits,
+                              trie_quant_index(bowt_tab[m], lh->n_bowt,
+                                               sorted[m].bowt[i]));
+                pos += lh->bowt_bits;
+                trie_bits_put(bits, pos, lh->next_bits, first[m][i]);
+                pos += lh->next_bits;
+            }
+        }
+        /* Sentinel holding the end of the last successors. */
+        if (m < order - 1) {
+            pos += lh->wid_bits + lh->prob_bits + lh->bowt_bits;
+            trie_bits_put(bits, pos, lh->next_bits, first[m][i]);
+        }
+    }
+
+    for (m = 1; m < order; ++m) {
+        ckd_free(sorted[m].wids);
+        ckd_free(sorted[m].prob);
+        ckd_free(sorted[m].bowt);
+        ckd_free(prob_tab[m]);
+        ckd_free(bowt_tab[m]);
+    }
+    for (m = 0; m < order; ++m)
+        ckd_free(first[m]);
+    ckd_free(sorted);
+    ckd_free(first);
+    ckd_free(prob_tab);
+    ckd_free(bowt_tab);
+    ckd_free(lhdr);
+    return img;
+}
+
+int
+ngram_model_trie_write(ngram_model_t *model,
+                       const char *file_name)
+{
+    trie_ngrams_t *ngrams;
+    ngram_iter_t *itor;
+    uint8 *img;
+    size_t len;
+    FILE *fh;
+    int32 n_words;
+    int m;
+
+    /* Collect N-grams from the model through its iterators. */
+    n_words = model->n_counts[0];
+    ngrams = ckd_calloc(model->n, sizeof(*ngrams));
+    for (m = 0; m < model->n; ++m) {
+        trie_ngrams_t *ng = ngrams + m;
+
+        trie_ngrams_alloc(ng, model->n_counts[m], m + 1);
+        for (itor = ngram_model_mgrams(model, m); itor;
+             itor = ngram_iter_next(itor)) {
+            int32 const *wids;
+            int32 score, bowt;
+
+            wids = ngram_iter_get(itor, &score, &bowt);
+            if (m == 0) {
+                ng->prob[wids[0]] = score;
+                ng->bowt[wids[0]] = bowt;
+                continue;
+            }
+            if (ng->n == model->n_counts[m]) {
+                E_ERROR("Too many %d-grams\n", m + 1);
+                ngram_iter_free(itor);
+                break;
+            }
+            memcpy(ng->wids + (size_t)ng->n * (m + 1), wids,
+                   (m + 1) * sizeof(*wids));
+            ng->prob[ng->n] = score;
+            ng->bowt[ng->n] = bowt;
+            ++ng->n;
+        }
+    }
+    ngrams[0].n = n_words;
+    img = trie_build(model->lmath, model->word_str, n_words, model->n,
+                     ngrams, &len);
+    trie_ngrams_free(ngrams, model->n);
+
+    if ((fh = fopen(file_name, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s for writing", file_name);
+        ckd_free(img);
+        return -1;
+    }
+    if (fwrite(img, 1, len, fh) != len) {
+        E_ERROR_SYSTEM("Failed to write %s", file_name);
+        fclose(fh);
+        ckd_free(img);
+        return -1;
+    }
+    ckd_free(img);
+    return fclose(fh);
+}
+
+ngram_model_t *
+ngram_model_trie_read_arpa(cmd_ln_t *config,
+                           const char *file_name,
+                           logmath_t *lmath)
+{
+    lineiter_t *li;
+    FILE *fp;
+    int32 is_pipe;
+    hash_table_t *wid;
+    trie_ngrams_t *ngrams;
+    int32 *counts;
+    char **words, **wptr;
+    uint8 *img;
+    size_t len;
+    int32 i, n_words;
+    int order, m;
+
+    if ((fp = fopen_comp(file_name, "r", &is_pipe)) == NULL) {
+        E_ERROR("File %s not found\n", file_name);
+        return NULL;
+    }
+    li = lineiter_start(fp);
+
+    /* Skip to the '\data\' marker and read the N-gram counts. */
+    for (; li; li = lineiter_next(li)) {
+        string_trim(li->buf, STRING_BOTH);
+        if (strcmp(li->buf, "\\data\\") == 0)
+            break;
+    }
+    if (li == NULL) {
+        E_ERROR("No \\data\\ mark in LM file\n");
+        fclose_comp(fp, is_pipe);
+        return NULL;
+    }
+    order = 0;
+    counts = NULL;
+    while ((li = lineiter_next(li))) {
+        int32 ngram, ngram_cnt;
+
+        if (sscanf(li->buf, "ngram %d=%d", &ngram, &ngram_cnt) != 2)
+            break;
+        if (ngram < 1 || ngram > 255 || ngram_cnt < 0) {
+            E_ERROR("Bad ngram count: %s\n", li->buf);
+            goto error_out;
+        }
+        if (ngram > order) {
+            counts = ckd_realloc(counts, ngram * sizeof(*counts));
+            memset(counts + order, 0, (ngram - order) * sizeof(*counts));
+            order = ngram;
+        }
+        counts[ngram - 1] = ngram_cnt;
+    }
+    if (li == NULL || order == 0 || counts[0] == 0) {
+        E_ERROR("Bad or missing ngram counts\n");
+        goto error_out;
+    }
+
+    words = ckd_calloc(counts[0], sizeof(*words));
+    wid = hash_table_new(counts[0], FALSE);
+    ngrams = ckd_calloc(order, sizeof(*ngrams));
+    for (m = 0; m < order; ++m)
+        trie_ngrams_alloc(ngrams + m, counts[m], m + 1);
+    wptr = ckd_calloc(order + 2, sizeof(*wptr));
+
+    /* Read N-grams of each order. */
+    img = NULL;
+    m = -1;
+    n_words = 0;
+    for (; li; li = lineiter_next(li)) {
+        trie_ngrams_t *ng;
+        int32 n, k, ngram;
+
+        string_trim(li->buf, STRING_BOTH);
+        if (li->buf[0] == '\0')
+            continue;
+        if (li->buf[0] == '\\') {
+            if (strcmp(li->buf, "\\end\\") == 0)
+                break;
+            if (sscanf(li->buf, "\\%d-grams:", &ngram) != 1
+                || ngram < 1 || ngram > order) {
+                E_ERROR("Bad section header: %s\n", li->buf);
+                goto error_free;
+            }
+            m = ngram - 1;
+            E_INFO("Reading %d-grams\n", ngram);
+            continue;
+        }
+        if (m < 0)
+            continue;
+
+        ng = ngrams + m;
+        if ((n = str2words(li->buf, wptr, order + 2)) < m + 2 || n > m + 3) {
+            E_WARN("Format error; %d-gram ignored: %s\n", m + 1, li->buf);
+            continue;
+        }
+        if (ng->n >= counts[m]) {
+            E_ERROR("Too many %d-grams\n", m + 1);
+            goto error_free;
+        }
+        if (m == 0) {
+            /* Associate name with word id */
+            words[n_words] = ckd_salloc(wptr[1]);
+            if ((hash_table_enter_int32(wid, words[n_words], n_words))
+                != n_words) {
+                E_WARN("Duplicate word in dictionary: %s\n", words[n_words]);
+            }
+            ++n_words;
+        }
+        else {
+            for (k = 0; k <= m; ++k) {
+                int32 w;
+
+                if (hash_table_lookup_int32(wid, wptr[k + 1], &w) < 0) {
+                    E_ERROR("Unknown word: %s, skipping %d-gram\n",
+                            wptr[k + 1], m + 1);
+                    break;
+                }
+                ng->wids[(size_t)ng->n * (m + 1) + k] = w;
+            }
+            if (k <= m)
+                continue;
+        }
+        ng->prob[ng->n] = logmath_log10_to_log(lmath, atof_c(wptr[0]));
+        if (n == m + 3)
+            ng->bowt[ng->n] = logmath_log10_to_log(lmath, atof_c(wptr[m + 2]));
+        ++ng->n;
+    }
+    if (li == NULL) {
+        E_ERROR("Missing \\end\\ mark in LM file\n");
+        goto error_free;
+    }
+    for (m = 0; m < order; ++m) {
+        if (ngrams[m].n != counts[m])
+            E_WARN("Expected %d %d-grams, read %d\n",
+                   counts[m], m + 1, ngrams[m].n);
+    }
+    img = trie_build(lmath, words, n_words, order, ngrams, &len);
+
+error_free:
+    for (i = 0; i < n_words; ++i)
+        ckd_free(words[i]);
+    ckd_free(words);
+    ckd_free(wptr);
+    hash_table_free(wid);
+    trie_ngrams_free(ngrams, order);
+    ckd_free(counts);
+    lineiter_free(li);
+    fclose_comp(fp, is_pipe);
+    if (img == NULL)
+        return NULL;
+    return ngram_model_trie_init(lmath, NULL, img, img, len, file_name);
+
+error_out:
+    ckd_free(counts);
+    lineiter_free(li);
+    fclose_comp(fp, is_pipe);
+    return NULL;
+}
+
+static ngram_funcs_t ngram_model_trie_funcs = {
+    ngram_model_trie_free,          /* free */
+    ngram_model_trie_apply_weights, /* apply_weights */
+    ngram_model_trie_score,         /* score */
+    ngram_model_trie_raw_score,     /* raw_score */
+    ngram_model_trie_add_ug,        /* add_ug */
+    NULL,                           /* flush */
+    ngram_model_trie_iter,          /* iter */
+    ngram_model_trie_mgrams,        /* mgrams */
+    ngram_model_trie_successors,    /* successors */
+    ngram_model_trie_iter_get,      /* iter_get */
+    ngram_model_trie_iter_next,     /* iter_next */
+    ngram_model_trie_iter_free      /* iter_free */
+};
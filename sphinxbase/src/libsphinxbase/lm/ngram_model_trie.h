@@ -0,0 +1,147 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*
+ * \file ngram_model_trie.h Memory-mappable trie format for N-Gram models
+ */
+
+#ifndef __NGRAM_MODEL_TRIE_H__
+#define __NGRAM_MODEL_TRIE_H__
+
+#include "sphinxbase/mmio.h"
+
+#include "ngram_model_internal.h"
+
+#define NGRAM_TRIE_MAGIC "NGTRIE\0"
+#define NGRAM_TRIE_VERSION 1
+#define NGRAM_TRIE_QUANT_BITS 16 /**< Maximum bits per quantized value */
+
+/**
+ * On-disk header of a trie file.
+ *
+ * The header is followed by (order - 1) ngram_trie_level_hdr_t, one
+ * for each of the 2-gram through N-gram levels.  All offsets are from
+ * the start of the file and are 8-byte aligned, so that the whole file
+ * can be used in place once memory-mapped.  Probabilities and backoff
+ * weights are stored as integer logs in the base of the logmath_t used
+ * to write the file, and converted when loading only if it differs.
+ * Everything but the bit-packed N-gram records (which are always
+ * little-endian) is in the byte order of the machine that wrote the
+ * file.
+ */
+typedef struct ngram_trie_header_s {
+    char magic[8];      /**< NGRAM_TRIE_MAGIC */
+    uint32 byteorder;   /**< 0x11223344 in native byte order */
+    uint32 version;     /**< NGRAM_TRIE_VERSION */
+    uint32 order;       /**< N-Gram order */
+    uint32 n_words;     /**< Number of unigrams */
+    float64 logbase;    /**< Base of log values */
+    uint32 log_shift;   /**< Shift of log values */
+    uint32 pad;         /**< Unused */
+    uint64 words_offset; /**< NUL-separated word strings */
+    uint64 words_len;   /**< Length of word strings */
+    uint64 ug_offset;   /**< int32 prob[n_words], int32 bowt[n_words],
+                             uint32 next[n_words + 1] (latter if order > 1) */
+} ngram_trie_header_t;
+
+/**
+ * On-disk description of one level (2-grams and up) of the trie.
+ *
+ * Each entry of the level is a bit-packed record of its word ID,
+ * quantized probability, and (except for the highest order) quantized
+ * backoff weight and index of its first successor in the next level.
+ * All levels but the highest have one extra sentinel record holding
+ * only the end of the last entry's successors.
+ */
+typedef struct ngram_trie_level_hdr_s {
+    uint32 n_entries;   /**< Number of N-grams at this level */
+    uint8 wid_bits;     /**< Bits per word ID */
+    uint8 prob_bits;    /**< Bits per probability index */
+    uint8 bowt_bits;    /**< Bits per backoff weight index */
+    uint8 next_bits;    /**< Bits per successor index */
+    uint32 n_prob;      /**< Number of quantized probabilities */
+    uint32 n_bowt;      /**< Number of quantized backoff weights */
+    uint64 prob_offset; /**< int32 prob[n_prob] */
+    uint64 bowt_offset; /**< int32 bowt[n_bowt] */
+    uint64 bits_offset; /**< Bit-packed records */
+    uint64 bits_len;    /**< Length of records in bytes, including padding */
+} ngram_trie_level_hdr_t;
+
+/**
+ * In-memory view of one level of the trie.
+ */
+typedef struct ngram_trie_level_s {
+    uint8 const *bits;  /**< Bit-packed records (in the image) */
+    int32 n_entries;    /**< Number of N-grams at this level */
+    uint8 wid_bits;     /**< Bits per word ID */
+    uint8 prob_bits;    /**< Bits per probability index */
+    uint8 bowt_bits;    /**< Bits per backoff weight index */
+    uint8 next_bits;    /**< Bits per successor index */
+    uint32 rec_bits;    /**< Bits per record */
+    int32 n_prob;       /**< Number of quantized probabilities */
+    int32 n_bowt;       /**< Number of quantized backoff weights */
+    int32 *raw_prob;    /**< Unweighted log probabilities */
+    int32 *raw_bowt;    /**< Unweighted log backoff weights */
+    int32 *prob;        /**< Weighted log probabilities */
+    int32 *bowt;        /**< Weighted log backoff weights */
+} ngram_trie_level_t;
+
+/**
+ * Subclass of ngram_model for trie files.
+ */
+typedef struct ngram_model_trie_s {
+    ngram_model_t base;      /**< Base ngram_model_t structure */
+    mmio_file_t *trie_mmap;  /**< mmap() of trie file (or NULL if none) */
+    uint8 *buf;              /**< Trie image if not memory-mapped */
+    int32 n_ug;              /**< Number of unigrams in the trie itself */
+    uint32 const *ug_next;   /**< Index of first bigram for each unigram */
+    int32 *raw_prob1;        /**< Unweighted unigram log probabilities */
+    int32 *raw_bowt1;        /**< Unweighted unigram log backoff weights */
+    int32 *prob1;            /**< Weighted unigram log probabilities */
+    int32 *bowt1;            /**< Weighted unigram log backoff weights */
+    ngram_trie_level_t *levels; /**< Levels 1 to N-1 (0 is unused) */
+} ngram_model_trie_t;
+
+/**
+ * Read an ARPA file of any order directly into a trie.
+ *
+ * This is used by ngram_model_arpa_read() for files above trigram order.
+ */
+ngram_model_t *ngram_model_trie_read_arpa(cmd_ln_t *config,
+                                          const char *file_name,
+                                          logmath_t *lmath);
+
+#endif /* __NGRAM_MODEL_TRIE_H__ */
@@ -130,6 +130,11 @@ static arg_t defn[] = {
     "0",
     "Number of parts to run in (supersedes -nskip and -runlen if non-zero)" },
   
+  { "-nthreads",
+    ARG_INT32,
+    "1",
+    "If a control file was specified, the number of files to convert at once" },
+  
   { "-di",
     ARG_STRING,
     NULL,
@@ -57,6 +57,7 @@
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/byteorder.h>
 #include <sphinxbase/hash_table.h>
+#include <sphinxbase/sbthread.h>
 
 #include "sphinx_wave2feat.h"
 #include "cmd_ln_defn.h"
@@ -915,6 +916,9 @@ sphinx_wave2feat_convert_file(sphinx_wave2feat_t *wtf,
     }
     wtf->outfile = ckd_salloc(outfile);
 
+    /* Every file starts a new stream, so that its features do not
+     * depend on the files converted before it. */
+    fe_start_stream(wtf->fe);
     if ((nfloat = (*atype->decode)(wtf)) < 0) {
     	E_ERROR("Failed to convert");
     	goto error_out;
@@ -1010,6 +1014,215 @@ build_filenames(cmd_ln_t *config, char const *basename,
     }
 }
 
+/**
+ * Control file entries shared by the threads in convert_files_threaded().
+ */
+typedef struct ctl_job_s {
+    cmd_ln_t *config;   /**< Configuration to copy for each thread. */
+    char **infiles;     /**< Input files. */
+    char **outfiles;    /**< Output files. */
+    int *status;        /**< Result of converting each file. */
+    int n_files;        /**< Number of files. */
+    int next_file;      /**< Next file to convert. */
+    int next_readahead; /**< Next file to read ahead. */
+    int n_readahead;    /**< How far ahead of the converters to read. */
+    int stop;           /**< Set on error or when all files are done. */
+    sbmtx_t *mtx;       /**< Lock for the above. */
+    sbevent_t *evt;     /**< Signalled when next_file or stop changes. */
+} ctl_job_t;
+
+/**
+ * Make a private copy of a configuration, since converting a file
+ * may change some parameters in it.
+ */
+static cmd_ln_t *
+copy_config(cmd_ln_t *config)
+{
+    cmd_ln_t *copy;
+    int i;
+
+    if ((copy = cmd_ln_init(NULL, defn, FALSE, NULL)) == NULL)
+        return NULL;
+    for (i = 0; defn[i].name; ++i) {
+        anytype_t *val = cmd_ln_access_r(config, defn[i].name);
+
+        if (val == NULL)
+            continue;
+        if (defn[i].type & ARG_STRING)
+            cmd_ln_set_str_r(copy, defn[i].name, val->ptr);
+        else if (defn[i].type & ARG_FLOATING)
+            cmd_ln_set_float_r(copy, defn[i].name, val->fl);
+        else if (defn[i].type & (ARG_INTEGER | ARG_BOOLEAN))
+            cmd_ln_set_int_r(copy, defn[i].name, val->i);
+    }
+    return copy;
+}
+
+/**
+ * Undo the changes that converting the previous file made to a
+ * thread's configuration, so that the result for a file does not
+ * depend on which thread got it.
+ */
+static void
+reset_file_params(sphinx_wave2feat_t *wtf, cmd_ln_t *config)
+{
+    cmd_ln_set_int32_r(wtf->config, "-nchans",
+                       cmd_ln_int32_r(config, "-nchans"));
+    cmd_ln_set_float32_r(wtf->config, "-samprate",
+                         cmd_ln_float32_r(config, "-samprate"));
+    cmd_ln_set_str_r(wtf->config, "-input_endian",
+                     cmd_ln_str_r(config, "-input_endian"));
+    if (cmd_ln_int32_r(wtf->config, "-nfft")
+        != cmd_ln_int32_r(config, "-nfft")) {
+        cmd_ln_set_int32_r(wtf->config, "-nfft",
+                           cmd_ln_int32_r(config, "-nfft"));
+        fe_free(wtf->fe);
+        wtf->fe = fe_init_auto_r(wtf->config);
+    }
+}
+
+static int
+convert_main(sbthread_t *th)
+{
+    ctl_job_t *job = sbthread_arg(th);
+    sphinx_wave2feat_t *wtf;
+    cmd_ln_t *config;
+
+    /* Each thread has its own converter and front end. */
+    if ((config = copy_config(job->config)) == NULL)
+        return -1;
+    wtf = sphinx_wave2feat_init(config);
+    cmd_ln_free_r(config);
+    if (wtf == NULL)
+        return -1;
+
+    while (TRUE) {
+        int i;
+
+        /* Take the next file nobody is working on yet. */
+        sbmtx_lock(job->mtx);
+        if (job->stop || job->next_file == job->n_files) {
+            sbmtx_unlock(job->mtx);
+            break;
+        }
+        i = job->next_file++;
+        sbmtx_unlock(job->mtx);
+        sbevent_signal(job->evt);
+
+        reset_file_params(wtf, job->config);
+        job->status[i] = sphinx_wave2feat_convert_file(wtf, job->infiles[i],
+                                                       job->outfiles[i]);
+        if (job->status[i] != 0) {
+            sbmtx_lock(job->mtx);
+            job->stop = TRUE;
+            sbmtx_unlock(job->mtx);
+            sbevent_signal(job->evt);
+        }
+    }
+    sphinx_wave2feat_free(wtf);
+    return 0;
+}
+
+static int
+readahead_main(sbthread_t *th)
+{
+    ctl_job_t *job = sbthread_arg(th);
+    char *buf;
+
+    /* Read the next few input files so that they are in the operating
+     * system's cache by the time a converter gets to them. */
+    buf = ckd_malloc(65536);
+    while (TRUE) {
+        FILE *fh;
+        int i;
+
+        sbmtx_lock(job->mtx);
+        if (job->stop || job->next_readahead == job->n_files) {
+            sbmtx_unlock(job->mtx);
+            break;
+        }
+        if (job->next_readahead < job->next_file)
+            job->next_readahead = job->next_file;
+        if (job->next_readahead >= job->next_file + job->n_readahead) {
+            sbmtx_unlock(job->mtx);
+            sbevent_wait(job->evt, -1, -1);
+            continue;
+        }
+        i = job->next_readahead++;
+        sbmtx_unlock(job->mtx);
+
+        if ((fh = fopen(job->infiles[i], "rb")) == NULL)
+            continue;   /* The converter will complain about it. */
+        while (fread(buf, 1, 65536, fh) == 65536)
+            ;
+        fclose(fh);
+    }
+    ckd_free(buf);
+    return 0;
+}
+
+static int
+convert_files_threaded(cmd_ln_t *config, int nthreads,
+                       char **infiles, char **outfiles, int n_files)
+{
+    ctl_job_t job;
+    sbthread_t **threads, *readahead;
+    int i, n_failed, n_done, rv = 0;
+
+    memset(&job, 0, sizeof(job));
+    job.config = config;
+    job.infiles = infiles;
+    job.outfiles = outfiles;
+    job.n_files = n_files;
+    job.n_readahead = 2 * nthreads;
+    job.status = ckd_calloc(n_files, sizeof(*job.status));
+    for (i = 0; i < n_files; ++i)
+        job.status[i] = 1;      /* Not converted */
+    job.mtx = sbmtx_init();
+    job.evt = sbevent_init();
+
+    E_INFO("Converting %d files with %d threads\n", n_files, nthreads);
+    threads = ckd_calloc(nthreads, sizeof(*threads));
+    for (i = 0; i < nthreads; ++i)
+        threads[i] = sbthread_start(NULL, convert_main, &job);
+    readahead = sbthread_start(NULL, readahead_main, &job);
+    for (i = 0; i < nthreads; ++i) {
+        if (threads[i] == NULL || sbthread_wait(threads[i]) != 0) {
+            E_ERROR("Conversion thread %d failed to initialize\n", i);
+            rv = -1;
+        }
+        sbthread_free(threads[i]);
+    }
+    sbmtx_lock(job.mtx);
+    job.stop = TRUE;
+    sbmtx_unlock(job.mtx);
+    sbevent_signal(job.evt);
+    if (readahead) {
+        sbthread_wait(readahead);
+        sbthread_free(readahead);
+    }
+    ckd_free(threads);
+
+    /* Report the results for all of them in one place. */
+    n_failed = n_done = 0;
+    for (i = 0; i < n_files; ++i) {
+        if (job.status[i] == 0)
+            ++n_done;
+        else if (job.status[i] < 0) {
+            E_ERROR("Failed to convert %s to %s\n", infiles[i], outfiles[i]);
+            ++n_failed;
+        }
+    }
+    E_INFO("Converted %d of %d files, %d failed\n", n_done, n_files, n_failed);
+    if (n_failed > 0 || n_done < n_files)
+        rv = -1;
+
+    sbevent_free(job.evt);
+    sbmtx_free(job.mtx);
+    ckd_free(job.status);
+    return rv;
+}
+
 static int
 run_control_file(sphinx_wave2feat_t *wtf, char const *ctlfile)
 {
@@ -1017,7 +1230,8 @@ run_control_file(sphinx_wave2feat_t *wtf, char const *ctlfile)
     hash_iter_t *itor;
     lineiter_t *li;
     FILE *ctlfh;
-    int nskip, runlen, npart, rv = 0;
+    char **infiles, **outfiles;
+    int nskip, runlen, npart, nthreads, n_files, n_alloc, i, rv = 0;
 
     if ((ctlfh = fopen(ctlfile, "r")) == NULL) {
         E_ERROR_SYSTEM("Failed to open control file %s", ctlfile);
@@ -1047,6 +1261,10 @@ run_control_file(sphinx_wave2feat_t *wtf, char const *ctlfile)
         E_INFO("Processing all remaining utterances at position %d\n", nskip);
         files = hash_table_new(1000, HASH_CASE_YES);
     }
+    n_files = 0;
+    n_alloc = 1000;
+    infiles = ckd_calloc(n_alloc, sizeof(*infiles));
+    outfiles = ckd_calloc(n_alloc, sizeof(*outfiles));
     for (li = lineiter_start(ctlfh); li; li = lineiter_next(li)) {
         char *c, *infile, *outfile;
 
@@ -1067,21 +1285,49 @@ run_control_file(sphinx_wave2feat_t *wtf, char const *ctlfile)
     	    continue;
         }
         build_filenames(wtf->config, li->buf, &infile, &outfile);
-        if (hash_table_lookup(files, infile, NULL) == 0)
+        if (hash_table_lookup(files, infile, NULL) == 0) {
+            ckd_free(infile);
+            ckd_free(outfile);
             continue;
-        rv = sphinx_wave2feat_convert_file(wtf, infile, outfile);
+        }
         hash_table_enter(files, infile, outfile);
-        if (rv != 0) {
-            lineiter_free(li);
-            break;
+        if (n_files == n_alloc) {
+            n_alloc *= 2;
+            infiles = ckd_realloc(infiles, n_alloc * sizeof(*infiles));
+            outfiles = ckd_realloc(outfiles, n_alloc * sizeof(*outfiles));
         }
+        infiles[n_files] = infile;
+        outfiles[n_files] = outfile;
+        ++n_files;
     }
+
+    nthreads = cmd_ln_int32_r(wtf->config, "-nthreads");
+    if (nthreads > 1 && cmd_ln_boolean_r(wtf->config, "-dither")) {
+        /* The random number generator is global. */
+        E_WARN("Dithering can only be done with one thread\n");
+        nthreads = 1;
+    }
+    if (nthreads > n_files)
+        nthreads = n_files;
+    if (nthreads > 1)
+        rv = convert_files_threaded(wtf->config, nthreads,
+                                    infiles, outfiles, n_files);
+    else {
+        for (i = 0; i < n_files; ++i) {
+            rv = sphinx_wave2feat_convert_file(wtf, infiles[i], outfiles[i]);
+            if (rv != 0)
+                break;
+        }
+    }
+
     for (itor = hash_table_iter(files); itor;
          itor = hash_table_iter_next(itor)) {
         ckd_free((void *)hash_entry_key(itor->ent));
         ckd_free(hash_entry_val(itor->ent));
     }
     hash_table_free(files);
+    ckd_free(infiles);
+    ckd_free(outfiles);
 
     if (fclose(ctlfh) == EOF)
         E_ERROR_SYSTEM("Failed to close control file");
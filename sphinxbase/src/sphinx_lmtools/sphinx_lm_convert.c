@@ -74,12 +74,12 @@ static const arg_t defn[] = {
   { "-ifmt",
     ARG_STRING,
     NULL,
-    "Input language model format (will guess if not specified)"},
+    "Input language model format: arpa, dmp or trie (will guess if not specified)"},
 
   { "-ofmt",
     ARG_STRING,
     NULL,
-    "Output language model file (will guess if not specified)"},
+    "Output language model format: arpa, dmp or trie (will guess if not specified)"},
 
   { "-ienc",
     ARG_STRING,
@@ -114,7 +114,7 @@ static void
 usagemsg(char *pgm)
 {
     E_INFO("Usage: %s -i <input.lm> \\\n", pgm);
-    E_INFOCONT("\t[-ifmt txt] [-ofmt dmp]\n");
+    E_INFOCONT("\t[-ifmt arpa] [-ofmt dmp|trie]\n");
     E_INFOCONT("\t-o <output.lm.DMP>\n");
 
     exit(0);
@@ -35,6 +35,31 @@ if ! cmp chan3.raw.mfc chan3.sph.mfc; then
     fail "SPH and RAW compare"
 fi
 
+run_program sphinx_fe/sphinx_fe \
+-samprate 11025 \
+-frate 105 \
+-wlen 0.024 \
+-alpha 0.97 \
+-ncep 13 \
+-nfft 512 \
+-nfilt 36 \
+-upperf 5400 \
+-lowerf 130 \
+-blocksize 262500 \
+-nthreads 3 \
+-c $tests/regression/chan3.ctl \
+-di $tests/regression \
+-do . \
+-eo threads.mfc \
+-input_endian little \
+>> $tmpout 2>&1 
+
+for f in chan3.raw chan3.wav chan3.2chan.wav chan3.sph; do
+    if ! cmp $f.mfc $f.threads.mfc; then
+	fail "$f threaded compare"
+    fi
+done
+
 run_program sphinx_cepview/sphinx_cepview \
 -i 13 \
 -d 13 \
@@ -0,0 +1,151 @@
+#include <jsgf.h>
+#include <fsg_model.h>
+#include <strfuncs.h>
+#include <string.h>
+
+#include "test_macros.h"
+
+#define NO_PATH MAX_NEG_INT32
+
+/* Follow null transitions (which are already closed) from all states. */
+static void
+null_step(fsg_model_t *fsg, int32 *score)
+{
+    int32 *prev;
+    int32 s;
+
+    prev = ckd_calloc(fsg->n_state, sizeof(*prev));
+    memcpy(prev, score, fsg->n_state * sizeof(*prev));
+    for (s = 0; s < fsg->n_state; ++s) {
+        fsg_arciter_t *itor;
+
+        if (prev[s] == NO_PATH)
+            continue;
+        for (itor = fsg_model_arcs(fsg, s); itor;
+             itor = fsg_arciter_next(itor)) {
+            fsg_link_t *link = fsg_arciter_get(itor);
+            if (link->wid < 0
+                && prev[s] + link->logs2prob > score[link->to_state])
+                score[link->to_state] = prev[s] + link->logs2prob;
+        }
+    }
+    ckd_free(prev);
+}
+
+/* Best score of a word sequence from the start to the final state. */
+static int32
+best_score(fsg_model_t *fsg, char const *sentence)
+{
+    char *words[16], *buf;
+    int32 *score, *next, s, best;
+    int n, i;
+
+    buf = ckd_salloc(sentence);
+    n = str2words(buf, words, 16);
+    score = ckd_calloc(fsg->n_state, sizeof(*score));
+    next = ckd_calloc(fsg->n_state, sizeof(*next));
+    for (s = 0; s < fsg->n_state; ++s)
+        score[s] = NO_PATH;
+    score[fsg->start_state] = 0;
+    null_step(fsg, score);
+    for (i = 0; i < n; ++i) {
+        int32 wid = fsg_model_word_id(fsg, words[i]);
+
+        for (s = 0; s < fsg->n_state; ++s)
+            next[s] = NO_PATH;
+        for (s = 0; s < fsg->n_state; ++s) {
+            fsg_arciter_t *itor;
+
+            if (score[s] == NO_PATH)
+                continue;
+            for (itor = fsg_model_arcs(fsg, s); itor;
+                 itor = fsg_arciter_next(itor)) {
+                fsg_link_t *link = fsg_arciter_get(itor);
+                if (link->wid >= 0 && link->wid == wid
+                    && score[s] + link->logs2prob > next[link->to_state])
+                    next[link->to_state] = score[s] + link->logs2prob;
+            }
+        }
+        memcpy(score, next, fsg->n_state * sizeof(*score));
+        null_step(fsg, score);
+    }
+    best = score[fsg->final_state];
+    ckd_free(score);
+    ckd_free(next);
+    ckd_free(buf);
+    return best;
+}
+
+/* Return the number of states removed by minimization. */
+static int
+test_grammar(logmath_t *lmath, char const *grammar, char const *rulename,
+             char const **sentences)
+{
+    fsg_model_t *fsg, *minfsg;
+    jsgf_t *jsgf;
+    jsgf_rule_t *rule;
+    int i, n_removed;
+
+    jsgf = jsgf_parse_string(grammar, NULL);
+    TEST_ASSERT(jsgf);
+    rule = jsgf_get_rule(jsgf, rulename);
+    TEST_ASSERT(rule);
+    fsg = jsgf_build_fsg(jsgf, rule, lmath, 7.5);
+    TEST_ASSERT(fsg);
+    TEST_ASSERT(fsg_model_add_silence(fsg, "<sil>", -1, 0.3));
+
+    minfsg = fsg_model_minimize(fsg);
+    TEST_ASSERT(minfsg);
+    printf("%s: %d states, %d after minimization\n",
+           rulename, fsg_model_n_state(fsg), fsg_model_n_state(minfsg));
+    n_removed = fsg_model_n_state(fsg) - fsg_model_n_state(minfsg);
+    TEST_ASSERT(n_removed >= 0);
+    TEST_EQUAL(fsg_model_n_word(fsg), fsg_model_n_word(minfsg));
+    TEST_ASSERT(fsg_model_has_sil(minfsg));
+    TEST_ASSERT(fsg_model_is_filler(minfsg, fsg_model_word_id(minfsg, "<sil>")));
+
+    /* Every word sequence should get the same score in both. */
+    for (i = 0; sentences[i]; ++i) {
+        int32 score = best_score(fsg, sentences[i]);
+        printf("%s: %d\n", sentences[i], score);
+        TEST_EQUAL(score, best_score(minfsg, sentences[i]));
+    }
+
+    fsg_model_free(minfsg);
+    fsg_model_free(fsg);
+    jsgf_grammar_free(jsgf);
+    return n_removed;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logmath_t *lmath;
+    static char const *polite[] = {
+        "please", "could you", "<sil> oh mighty computer <sil>",
+        "", "could", "kindly please", NULL
+    };
+    static char const *sums[] = {
+        "one plus two", "three minus three", "<sil> two minus <sil> one",
+        "one plus", "plus two", "one plus two minus three", NULL
+    };
+
+    lmath = logmath_init(1.0001, 0, 0);
+
+    test_grammar(lmath,
+                 "#JSGF V1.0; grammar polite; "
+                 "public <startPolite> = "
+                 "[please | kindly | could you | oh mighty computer];",
+                 "polite.startPolite", polite);
+    /* Each reference to <num> is expanded separately, so the states
+     * before the last ones should be merged. */
+    TEST_ASSERT(test_grammar(lmath,
+                             "#JSGF V1.0; grammar sum; "
+                             "<num> = one | two | three; "
+                             "public <sum> = <num> plus <num> "
+                             "| <num> minus <num>;",
+                             "sum.sum", sums) > 0);
+
+    logmath_free(lmath);
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include <ngram_model.h>
+#include <logmath.h>
+#include <hash_table.h>
+#include <sbthread.h>
+#include <profile.h>
+#include <ckd_alloc.h>
+
+#include "test_macros.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Check trigram scores (which go through the trigram cache) against
+ * scores computed directly from the N-gram tables, from one thread and
+ * then from several threads sharing the same model, and report
+ * ngram_tg_score() throughput.
+ */
+
+#define N_QUERIES 200000
+#define N_THREADS 4
+#define N_PASSES 10
+
+typedef struct query_s {
+	int32 wid[3];	/* w1, w2, w3 */
+	int32 score;
+	int32 n_used;
+} query_t;
+
+static query_t *queries;
+static ngram_model_t *model;
+
+/* Score of w3 given w1,w2, computed without the trigram cache. */
+static int32
+direct_score(hash_table_t *tg, int32 const *wid, int32 *n_used)
+{
+	ngram_iter_t *itor;
+	int32 score, bowt;
+	int32 val;
+
+	if (hash_table_lookup_bkey_int32(tg, (char const *)wid,
+					 3 * sizeof(*wid), &val) == 0) {
+		*n_used = 3;
+		return val;
+	}
+	bowt = 0;
+	if ((itor = ngram_ng_iter(model, wid[1], (int32 *)wid, 1)) != NULL) {
+		ngram_iter_get(itor, &score, &bowt);
+		ngram_iter_free(itor);
+	}
+	return bowt + ngram_bg_score(model, wid[2], wid[1], n_used);
+}
+
+static void
+make_reference(void)
+{
+	hash_table_t *tg;
+	ngram_iter_t *itor;
+	int32 *keys, n_tg;
+	int i;
+
+	/* Collect all the trigrams. */
+	n_tg = ngram_model_get_counts(model)[2];
+	tg = hash_table_new(n_tg, HASH_CASE_YES);
+	keys = ckd_calloc(n_tg * 3, sizeof(*keys));
+	for (i = 0, itor = ngram_model_mgrams(model, 2); itor;
+	     ++i, itor = ngram_iter_next(itor)) {
+		int32 score, bowt;
+		int32 const *wids = ngram_iter_get(itor, &score, &bowt);
+
+		TEST_ASSERT(i < n_tg);
+		memcpy(keys + i * 3, wids, 3 * sizeof(*keys));
+		hash_table_enter_bkey(tg, (char const *)(keys + i * 3),
+				      3 * sizeof(*keys), (void *)(long)score);
+	}
+	for (i = 0; i < N_QUERIES; ++i)
+		queries[i].score = direct_score(tg, queries[i].wid,
+						&queries[i].n_used);
+	hash_table_free(tg);
+	ckd_free(keys);
+}
+
+static int
+check_queries(int start)
+{
+	int i, errors = 0;
+
+	for (i = 0; i < N_QUERIES; ++i) {
+		query_t *q = queries + (start + i) % N_QUERIES;
+		int32 n_used;
+
+		if (ngram_tg_score(model, q->wid[2], q->wid[1], q->wid[0],
+				   &n_used) != q->score
+		    || n_used != q->n_used)
+			++errors;
+	}
+	return errors;
+}
+
+static int
+check_main(sbthread_t *th)
+{
+	int *start = sbthread_arg(th);
+	return check_queries(*start);
+}
+
+static int
+bench_main(sbthread_t *th)
+{
+	int *start = sbthread_arg(th);
+	int32 total = 0;
+	int i, j;
+
+	for (j = 0; j < N_PASSES; ++j) {
+		for (i = 0; i < N_QUERIES; ++i) {
+			query_t *q = queries + (*start + i) % N_QUERIES;
+			int32 n_used;
+			total += ngram_tg_score(model, q->wid[2], q->wid[1],
+						q->wid[0], &n_used);
+		}
+	}
+	return total == 0;
+}
+
+static double
+run_threads(sbthread_main func, int n_threads, int *errors)
+{
+	sbthread_t *threads[N_THREADS];
+	int start[N_THREADS];
+	ptmr_t tm;
+	int i;
+
+	ptmr_init(&tm);
+	ptmr_start(&tm);
+	for (i = 0; i < n_threads; ++i) {
+		start[i] = i * N_QUERIES / n_threads;
+		threads[i] = sbthread_start(NULL, func, start + i);
+		TEST_ASSERT(threads[i]);
+	}
+	*errors = 0;
+	for (i = 0; i < n_threads; ++i) {
+		*errors += sbthread_wait(threads[i]);
+		sbthread_free(threads[i]);
+	}
+	ptmr_stop(&tm);
+	return tm.t_elapsed;
+}
+
+static void
+run_tests(char const *name)
+{
+	int32 const *counts;
+	uint32 seed = 42;
+	double t;
+	int i, errors;
+
+	counts = ngram_model_get_counts(model);
+	/* Every trigram in the model, then random triples, most of
+	 * which back off. */
+	i = 0;
+	{
+		ngram_iter_t *itor;
+		for (itor = ngram_model_mgrams(model, 2);
+		     itor && i < N_QUERIES / 2;
+		     itor = ngram_iter_next(itor), ++i) {
+			int32 score, bowt;
+			memcpy(queries[i].wid, ngram_iter_get(itor, &score, &bowt),
+			       3 * sizeof(int32));
+		}
+		if (itor)
+			ngram_iter_free(itor);
+	}
+	for (; i < N_QUERIES; ++i) {
+		int j;
+		for (j = 0; j < 3; ++j) {
+			seed = seed * 1103515245 + 12345;
+			queries[i].wid[j] = (seed >> 8) % counts[0];
+		}
+	}
+
+	make_reference();
+	TEST_EQUAL(0, check_queries(0));
+	TEST_EQUAL(0, check_queries(N_QUERIES / 3));
+	run_threads(check_main, N_THREADS, &errors);
+	TEST_EQUAL(0, errors);
+
+	/* Cached entries stay valid after weights change. */
+	ngram_model_apply_weights(model, 7.5, 0.5, 1.0);
+	make_reference();
+	TEST_EQUAL(0, check_queries(0));
+
+	t = run_threads(bench_main, 1, &errors);
+	printf("%s: 1 thread: %.2f M ngram_tg_score/sec\n", name,
+	       N_QUERIES * N_PASSES / t / 1e6);
+	t = run_threads(bench_main, N_THREADS, &errors);
+	printf("%s: %d threads: %.2f M ngram_tg_score/sec\n", name, N_THREADS,
+	       N_THREADS * N_QUERIES * N_PASSES / t / 1e6);
+}
+
+int
+main(int argc, char *argv[])
+{
+	logmath_t *lmath;
+
+	lmath = logmath_init(1.0001, 0, 0);
+	queries = ckd_calloc(N_QUERIES, sizeof(*queries));
+
+	model = ngram_model_read(NULL, LMDIR "/100.arpa.DMP", NGRAM_DMP, lmath);
+	TEST_ASSERT(model);
+	run_tests("100.arpa.DMP");
+	ngram_model_free(model);
+
+	model = ngram_model_read(NULL, LMDIR "/turtle.lm", NGRAM_ARPA, lmath);
+	TEST_ASSERT(model);
+	run_tests("turtle.lm");
+	ngram_model_free(model);
+
+	ckd_free(queries);
+	logmath_free(lmath);
+	return 0;
+}
@@ -0,0 +1,152 @@
+#include <ngram_model.h>
+#include <logmath.h>
+#include <strfuncs.h>
+
+#include "test_macros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static const arg_t defn[] = {
+	{ "-mmap", ARG_BOOLEAN, "yes", "use mmap" },
+	{ NULL, 0, NULL, NULL }
+};
+
+/* Check that every N-gram of ref scores the same in model. */
+static void
+compare_models(ngram_model_t *ref, ngram_model_t *model)
+{
+	int32 const *counts;
+	int m, n;
+
+	TEST_EQUAL(ngram_model_get_size(ref), ngram_model_get_size(model));
+	n = ngram_model_get_size(ref);
+	counts = ngram_model_get_counts(ref);
+	for (m = 0; m < n; ++m) {
+		ngram_iter_t *itor;
+		int32 n_grams = 0;
+
+		TEST_EQUAL(counts[m], ngram_model_get_counts(model)[m]);
+		for (itor = ngram_model_mgrams(ref, m); itor;
+		     itor = ngram_iter_next(itor)) {
+			int32 const *wids;
+			int32 hist[8], score, bowt, n_used, n_used2, i;
+
+			wids = ngram_iter_get(itor, &score, &bowt);
+			for (i = 0; i < m; ++i)
+				hist[i] = wids[m - 1 - i];
+			score = ngram_ng_score(ref, wids[m], hist, m, &n_used);
+			TEST_EQUAL_LOG(score, ngram_ng_score(model, wids[m], hist,
+							     m, &n_used2));
+			TEST_EQUAL(n_used, n_used2);
+			TEST_EQUAL(n_used, m + 1);
+			++n_grams;
+		}
+		TEST_EQUAL(n_grams, counts[m]);
+	}
+}
+
+/* Check backoff for all pairs and some triples of words. */
+static void
+compare_backoff(ngram_model_t *ref, ngram_model_t *model)
+{
+	int32 n_words, w1, w2, w3;
+
+	n_words = ngram_model_get_counts(ref)[0];
+	for (w1 = 0; w1 < n_words; ++w1) {
+		for (w2 = 0; w2 < n_words; ++w2) {
+			int32 n_used, n_used2;
+
+			TEST_EQUAL_LOG(ngram_bg_score(ref, w2, w1, &n_used),
+				       ngram_bg_score(model, w2, w1, &n_used2));
+			TEST_EQUAL(n_used, n_used2);
+			for (w3 = w2 % 7; w3 < n_words; w3 += 7) {
+				TEST_EQUAL_LOG(ngram_tg_score(ref, w3, w2, w1,
+							      &n_used),
+					       ngram_tg_score(model, w3, w2, w1,
+							      &n_used2));
+				TEST_EQUAL(n_used, n_used2);
+			}
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	logmath_t *lmath;
+	ngram_model_t *ref, *model, *model2;
+	cmd_ln_t *config;
+	int32 n_used;
+
+	lmath = logmath_init(1.0001, 0, 0);
+	config = cmd_ln_parse_r(NULL, defn, 0, NULL, FALSE);
+
+	/* Convert a trigram model and compare it with the original. */
+	ref = ngram_model_read(NULL, LMDIR "/turtle.lm", NGRAM_ARPA, lmath);
+	TEST_ASSERT(ref);
+	TEST_EQUAL(0, ngram_model_write(ref, "turtle.tmp.trie", NGRAM_AUTO));
+	model = ngram_model_read(NULL, "turtle.tmp.trie", NGRAM_TRIE, lmath);
+	TEST_ASSERT(model);
+	compare_models(ref, model);
+	compare_backoff(ref, model);
+	TEST_EQUAL(0, strcmp(ngram_word(model, 0), ngram_word(ref, 0)));
+
+	/* Weights should be applied in the same way. */
+	ngram_model_apply_weights(ref, 7.5, 0.5, 0.7);
+	ngram_model_apply_weights(model, 7.5, 0.5, 0.7);
+	compare_models(ref, model);
+	compare_backoff(ref, model);
+	ngram_model_free(ref);
+
+	/* Memory-mapped, and autodetected by name. */
+	model2 = ngram_model_read(config, "turtle.tmp.trie", NGRAM_AUTO, lmath);
+	TEST_ASSERT(model2);
+	ngram_model_apply_weights(model2, 7.5, 0.5, 0.7);
+	compare_models(model, model2);
+	ngram_model_free(model2);
+
+	/* Write a trie from a trie (like ARPA, this writes weighted scores). */
+	ngram_model_apply_weights(model, 1.0, 1.0, 1.0);
+	TEST_EQUAL(0, ngram_model_write(model, "turtle.tmp2.trie", NGRAM_TRIE));
+	model2 = ngram_model_read(config, "turtle.tmp2.trie", NGRAM_TRIE, lmath);
+	TEST_ASSERT(model2);
+	compare_models(model, model2);
+	compare_backoff(model, model2);
+	ngram_model_free(model2);
+	ngram_model_free(model);
+
+	/* A 4-gram ARPA model is read into a trie. */
+	model = ngram_model_read(NULL, LMDIR "/tiny4g.lm", NGRAM_ARPA, lmath);
+	TEST_ASSERT(model);
+	TEST_EQUAL(4, ngram_model_get_size(model));
+	TEST_EQUAL(2, ngram_model_get_counts(model)[3]);
+	TEST_EQUAL_LOG(ngram_score(model, "c", "b", "a", "<s>", NULL),
+		       logmath_log10_to_log(lmath, -0.05));
+	ngram_tg_score(model, ngram_wid(model, "c"), ngram_wid(model, "b"),
+		       ngram_wid(model, "a"), &n_used);
+	TEST_EQUAL(3, n_used);
+	/* Back off all the way from <s> a b to a unigram. */
+	TEST_EQUAL_LOG(ngram_score(model, "a", "b", "a", "<s>", NULL),
+		       logmath_log10_to_log(lmath, -0.12 - 0.15 - 0.2 - 0.6));
+	/* No <s> b c context, so no backoff weight for it. */
+	TEST_EQUAL_LOG(ngram_score(model, "</s>", "c", "b", "<s>", NULL),
+		       logmath_log10_to_log(lmath, -0.1));
+	/* Round trip through ARPA and trie. */
+	TEST_EQUAL(0, ngram_model_write(model, "tiny4g.tmp.arpa", NGRAM_ARPA));
+	model2 = ngram_model_read(NULL, "tiny4g.tmp.arpa", NGRAM_ARPA, lmath);
+	TEST_ASSERT(model2);
+	compare_models(model, model2);
+	ngram_model_free(model2);
+	TEST_EQUAL(0, ngram_model_write(model, "tiny4g.tmp.trie", NGRAM_AUTO));
+	model2 = ngram_model_read(config, "tiny4g.tmp.trie", NGRAM_AUTO, lmath);
+	TEST_ASSERT(model2);
+	compare_models(model, model2);
+	ngram_model_free(model2);
+	ngram_model_free(model);
+
+	cmd_ln_free_r(config);
+	logmath_free(lmath);
+	return 0;
+}
@@ -55,6 +55,7 @@ extern "C" {
 #endif
 
 #include <sphinxbase/prim_type.h>
+#include <sphinxbase/feat.h>
 #include <s3/vector.h>
 #include <s3/acmod_set.h>
 #include <s3/s3phseg_io.h>
@@ -157,6 +158,20 @@ corpus_set_partition(uint32 r,
 uint32
 corpus_get_begin(void);
 
+/* Read the cepstra of the next n_utt utterances in a background
+   thread while the current ones are used (0, the default, reads
+   each one when it is asked for) */
+int
+corpus_set_prefetch(uint32 n_utt);
+
+/* Keep the features computed by fcb for each utterance under dir,
+   and use them instead of the cepstra in later passes.  Features
+   computed with other parameters or transforms are ignored, and
+   none are cached with -cmn prior or -agc emax, which make them
+   depend on the utterances before. */
+int
+corpus_set_feat_cache_dir(const char *dir, feat_t *fcb);
+
 /* Initialization function to be called after
    configuration functions */
 
@@ -204,6 +219,21 @@ corpus_get_generic_featurevec(vector_t **mfc,
                               int32 *n_frame,
                               uint32 veclen);
 
+/* Features of the current utterance from the cache, if they are
+   there and no older than its cepstra.  Returns S3_ERROR if not. */
+int
+corpus_get_feat_cache(feat_t *fcb,
+		      mfcc_t ****out_feat,
+		      int32 *out_n_frame,
+		      int32 *out_n_frame_in);
+
+/* Store the features of the current utterance in the cache. */
+int
+corpus_put_feat_cache(feat_t *fcb,
+		      mfcc_t ***feat,
+		      int32 n_frame,
+		      int32 n_frame_in);
+
 int
 corpus_get_sildel(uint32 **sf,
 		  uint32 **ef,
@@ -83,6 +83,8 @@ typedef struct gauden_s {
     vector_t ***l_vacc;
     vector_t ****l_fullvacc;
     float32  ***l_dnom;
+
+    struct gauden_simd_s *simd;	/* vectorized evaluation (or NULL) */
 } gauden_t;
 
 #define MAX_LOG_DEN	10.0
@@ -0,0 +1,145 @@
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*********************************************************************
+ *
+ * File: gauden_simd.h
+ * 
+ * Description: 
+ *	Vectorized evaluation of diagonal Gaussian densities.
+ *
+ *	log_full_densities() and log_topn_densities() walk one
+ *	density and one dimension at a time over the density-major
+ *	mean and variance arrays in gauden_t.  Here we keep a
+ *	transposed (dimension-major) copy of each codebook so that a
+ *	block of densities can be scored against an observation with
+ *	vector instructions.  The arithmetic is still done in float64,
+ *	and each lane performs the same operations in the same order
+ *	as the scalar code, so on x86-64 the densities (and the top N
+ *	of them) are bit-identical.
+ *
+ *	The kernel is chosen at run time from the instruction sets
+ *	supported by the CPU, or forced with the -simd argument of bw.
+ *
+ *********************************************************************/
+
+#ifndef GAUDEN_SIMD_H
+#define GAUDEN_SIMD_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+#include <s3/gauden.h>
+
+/* Number of densities scored by one call to a block kernel */
+#define GAUDEN_SIMD_BLOCK 8
+
+typedef enum gauden_simd_type_e {
+    GAUDEN_SIMD_NONE,	/* scalar code in gauden.c */
+    GAUDEN_SIMD_SSE2,	/* 2 densities per instruction */
+    GAUDEN_SIMD_AVX2	/* 4 densities per instruction */
+} gauden_simd_type_t;
+
+/*
+ * Score one block of GAUDEN_SIMD_BLOCK densities.  If partial is
+ * FALSE, this computes the same thing as log_diag_eval().  If it is
+ * TRUE, it computes the partial distance used by
+ * log_topn_densities(), and gives up (returning 0) once every
+ * density in the block has fallen to thresh or below.  Otherwise it
+ * returns 1.
+ *
+ * mean, var and norm point to the first density of the block, and
+ * successive dimensions of mean and var are stride floats apart.
+ */
+typedef int (*gauden_simd_block_f)(float64 *out,
+				   const float32 *obs,
+				   const float32 *mean,
+				   const float32 *var,
+				   const float32 *norm,
+				   uint32 stride,
+				   uint32 veclen,
+				   int partial,
+				   float64 thresh);
+
+typedef struct gauden_simd_s {
+    gauden_simd_type_t type;
+    gauden_simd_block_f eval_block;
+
+    uint32 n_mgau;
+    uint32 n_feat;
+    uint32 n_density;
+    uint32 stride;	/* n_density rounded up to GAUDEN_SIMD_BLOCK */
+
+    float32 ***mean;	/* mean[cb][feat] is veclen x stride */
+    float32 ***var;	/* 1 / (2 sigma^2), laid out like mean */
+    float32 ***norm;	/* norm[cb][feat] is padded to stride */
+    void *buf;		/* storage for all of the above (unaligned) */
+
+    float64 tol;	/* if > 0, check against the scalar code */
+} gauden_simd_t;
+
+int
+gauden_simd_parse(const char *name);
+
+const char *
+gauden_simd_name(gauden_simd_type_t type);
+
+int
+gauden_simd_supported(gauden_simd_type_t type);
+
+/*
+ * Set up vectorized evaluation for g, whose variances and
+ * normalization terms must already have been precomputed by
+ * gauden_eval_precomp().  name is "auto", "none", "sse2" or "avx2".
+ * If tol is positive, every evaluation is repeated with the scalar
+ * code and training stops if any log density differs by more than
+ * tol.  Does nothing for full covariances.
+ */
+int
+gauden_simd_init(gauden_t *g,
+		 const char *name,
+		 float64 tol);
+
+void
+gauden_simd_free(gauden_simd_t *simd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAUDEN_SIMD_H */
@@ -110,6 +110,20 @@ s3gaucnt_read(const char *fn,
 	      uint32 *out_n_density,
 	      uint32 **out_veclen);
 
+/* Add the counts in fn to those given, which must have the same
+ * dimensions, without reading all of them into memory at once.  If
+ * wt_var is NULL, variance counts in fn are ignored. */
+int
+s3gaucnt_read_accum(const char *fn,
+		    vector_t ***wt_mean,
+		    vector_t ***wt_var,
+		    int32 pass2var,
+		    float32 ***dnom,
+		    uint32 n_mgau,
+		    uint32 n_feat,
+		    uint32 n_density,
+		    const uint32 *veclen);
+
 int
 s3gaucnt_write(const char *fn,
 	       vector_t ***wt_mean,
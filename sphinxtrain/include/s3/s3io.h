@@ -94,6 +94,27 @@ s3read_intv_3d(void ****arr,
 	       uint32 swap,
 	       uint32 *chksum);
 
+/* Add a float32 array of n_el elements, as written by
+ * bio_fwrite_1d(), to acc, reading it a piece at a time.  If acc is
+ * NULL, the array is only read (and checksummed). */
+int32
+s3read_accum_1d(float32 *acc,
+		uint32 n_el,
+		FILE *fp,
+		uint32 swap,
+		uint32 *chksum);
+
+/* Same, for a d1 x d2 x d3 array as written by bio_fwrite_3d(), which
+ * is added to a contiguous array such as one from ckd_calloc_3d(). */
+int32
+s3read_accum_3d(float32 ***acc,
+		uint32 d1,
+		uint32 d2,
+		uint32 d3,
+		FILE *fp,
+		uint32 swap,
+		uint32 *chksum);
+
 int
 areadfloat (char *file,
 	    float **data_ref,
@@ -64,6 +64,15 @@ s3mixw_read(const char *fn,
 	    uint32 *out_n_feat,
 	    uint32 *out_n_density);
 
+/* Add the counts in fn to mixw, which must have the given
+ * dimensions, without reading all of them into memory at once. */
+int
+s3mixw_read_accum(const char *fn,
+		  float32 ***mixw,
+		  uint32 n_mixw,
+		  uint32 n_feat,
+		  uint32 n_density);
+
 
 int
 s3mixw_intv_read(const char *fn,
@@ -64,6 +64,14 @@ s3tmat_read(const char *fn,
 	    uint32 *out_n_tmat,
 	    uint32 *out_n_state);
 
+/* Add the counts in fn to tmat, which must have the given
+ * dimensions, without reading all of them into memory at once. */
+int
+s3tmat_read_accum(const char *fn,
+		  float32 ***tmat,
+		  uint32 n_tmat,
+		  uint32 n_state);
+
 int
 s3tmat_write(const char *fn,
 	     float32 ***tmat,
@@ -60,6 +60,10 @@ int
 state_seq_free(state_t *s,
 	       unsigned int n);
 
+state_t *
+state_seq_copy(state_t *s,
+	       uint32 n);
+
 state_t *
 state_seq_make(uint32 *n_state,
 	       acmod_id_t *phone,
@@ -392,6 +392,64 @@ set_next_prior_state(uint32 *next_state,
 
 }
 
+/*
+ * Make a private copy of a sentence HMM from state_seq_make(), which
+ * reuses its storage from one utterance to the next.  The copy is
+ * freed with state_seq_free().
+ */
+state_t *
+state_seq_copy(state_t *s,
+	       uint32 n)
+{
+    state_t *out;
+    uint32 *next_state, *prior_state;
+    float32 *next_tprob, *prior_tprob;
+    uint32 i, total_next, total_prior;
+
+    for (i = 0, total_next = total_prior = 0; i < n; i++) {
+	total_next += s[i].n_next;
+	total_prior += s[i].n_prior;
+    }
+
+    out = ckd_calloc(n, sizeof(state_t));
+    next_state = ckd_calloc(total_next, sizeof(uint32));
+    next_tprob = ckd_calloc(total_next, sizeof(float32));
+    prior_state = ckd_calloc(total_prior, sizeof(uint32));
+    prior_tprob = ckd_calloc(total_prior, sizeof(float32));
+
+    for (i = 0; i < n; i++) {
+	out[i] = s[i];
+
+	if (s[i].n_next > 0) {
+	    memcpy(next_state, s[i].next_state, s[i].n_next * sizeof(uint32));
+	    memcpy(next_tprob, s[i].next_tprob, s[i].n_next * sizeof(float32));
+	    out[i].next_state = next_state;
+	    out[i].next_tprob = next_tprob;
+	    next_state += s[i].n_next;
+	    next_tprob += s[i].n_next;
+	}
+	else {
+	    out[i].next_state = NULL;
+	    out[i].next_tprob = NULL;
+	}
+
+	if (s[i].n_prior > 0) {
+	    memcpy(prior_state, s[i].prior_state, s[i].n_prior * sizeof(uint32));
+	    memcpy(prior_tprob, s[i].prior_tprob, s[i].n_prior * sizeof(float32));
+	    out[i].prior_state = prior_state;
+	    out[i].prior_tprob = prior_tprob;
+	    prior_state += s[i].n_prior;
+	    prior_tprob += s[i].n_prior;
+	}
+	else {
+	    out[i].prior_state = NULL;
+	    out[i].prior_tprob = NULL;
+	}
+    }
+
+    return out;
+}
+
 int
 state_seq_free(state_t *s,
 	       unsigned int n)
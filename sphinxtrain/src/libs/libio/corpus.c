@@ -67,10 +67,13 @@
 
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/pio.h>
+#include <sphinxbase/filename.h>
+#include <sphinxbase/sbthread.h>
 
 #include <sys_compat/file.h>
 #include <sys_compat/misc.h>
 
+#include <s3/s3io.h>
 #include <s3/mllr_io.h>
 #include <s3/acmod_set.h>
 #include <s3/s3.h>
@@ -91,6 +94,9 @@ int strcmp_ci(const char *a, const char *b);
 static char *
 mk_filename(uint32 type, char *rel_path);
 
+static int
+feat_cache_valid(char *path, uint32 sf, uint32 ef);
+
 static FILE *
 open_file_for_reading(uint32 type);
 
@@ -130,6 +136,9 @@ static const char *transcription_filename = NULL;
 /* Match flag for the utterance id */
 static uint32 fullsuffixmatch = 0;
 
+/* The name of the control file */
+static char *ctl_fn = NULL;
+
 /* Standard I/O file pointer for the control file */
 static FILE *ctl_fp = NULL;
 
@@ -200,6 +209,50 @@ static uint32 n_proc = 0;
 
 static uint32 begin;
 
+/* Cepstra read ahead of time for a batch of utterances */
+typedef struct pf_utt_s {
+    char *path;		/* Control file path, to match cur_ctl_path */
+    uint32 sf, ef;	/* Frame range, only NO_FRAME is read ahead */
+    char *fn;		/* MFCC file name, or NULL if not read */
+    float32 *coeff;	/* The cepstra, until they are handed over */
+    int n_c;		/* Number of coefficients, or -1 if none */
+} pf_utt_t;
+
+typedef struct pf_batch_s {
+    pf_utt_t *utt;
+    uint32 n_utt;
+    uint32 next;	/* Next one to be handed out */
+    sbthread_t *thread;	/* Reading them, if not done yet */
+} pf_batch_t;
+
+/* Number of utterances to read ahead in each batch (0 for none) */
+static uint32 n_prefetch = 0;
+
+/* Own handle on the control file, running ahead of ctl_fp */
+static FILE *pf_fp = NULL;
+
+/* Number of utterances left to read ahead, or UNTIL_EOF */
+static uint32 pf_n_run;
+
+/* One batch is used while the next one is read */
+static pf_batch_t pf_batch[2];
+static pf_batch_t *pf_cur = &pf_batch[0];
+static pf_batch_t *pf_next = &pf_batch[1];
+
+/* What was read ahead for the current utterance, if anything */
+static pf_utt_t *pf_utt = NULL;
+
+/* Directory of cached features (NULL for none) */
+static const char *feat_cache_dir = NULL;
+
+/* How the cached features are computed */
+static feat_t *feat_cache_fcb = NULL;
+
+#define FEAT_CACHE_MAGIC	"s3fcache"
+#define FEAT_CACHE_BYTEORDER	0x11223344
+/* The header is padded so that the features are aligned in the file */
+#define FEAT_CACHE_HDR_SIZE	16
+
 static
 int strcmp_ci(const char *a, const char *b)
 {
@@ -339,6 +392,8 @@ corpus_set_ctl_filename(const char *ctl_filename)
 	E_ERROR_SYSTEM("Unable to open %s for reading",  ctl_filename);
 	return S3_ERROR;
     }
+    ckd_free(ctl_fn);
+    ctl_fn = ckd_salloc(ctl_filename);
     
     li = lineiter_start_clean(ctl_fp);
 
@@ -439,10 +494,187 @@ corpus_set_interval(uint32 n_skip,
     return S3_SUCCESS;
 }
 
+/*
+ * Reading ahead.  The control file is read a batch of utterances
+ * ahead through its own file handle, and a thread reads their
+ * cepstra while the previous batch is used.  Utterances that are
+ * frame ranges of a larger file are left to be read in place, as
+ * areadfloat_part() keeps that file open from one call to the next.
+ */
+
+static int
+pf_read(sbthread_t *th)
+{
+    pf_batch_t *b = sbthread_arg(th);
+    uint32 i;
+
+    for (i = 0; i < b->n_utt; i++) {
+	pf_utt_t *u = &b->utt[i];
+
+	if (u->fn == NULL)
+	    continue;
+	if (areadfloat(u->fn, &u->coeff, &u->n_c) < 0) {
+	    /* It will be tried again, and reported, when it is used. */
+	    u->coeff = NULL;
+	    u->n_c = -1;
+	}
+    }
+
+    return 0;
+}
+
+static void
+pf_clear(pf_batch_t *b)
+{
+    uint32 i;
+
+    if (b->thread) {
+	sbthread_free(b->thread);
+	b->thread = NULL;
+    }
+    for (i = 0; i < b->n_utt; i++) {
+	free(b->utt[i].path);
+	ckd_free(b->utt[i].fn);
+	if (b->utt[i].coeff)
+	    free(b->utt[i].coeff);
+    }
+    b->n_utt = 0;
+    b->next = 0;
+}
+
+static void
+pf_fill(pf_batch_t *b)
+{
+    lineiter_t *li;
+
+    while (b->n_utt < n_prefetch && pf_n_run != 0) {
+	pf_utt_t *u;
+
+	if ((li = lineiter_start_clean(pf_fp)) == NULL)
+	    break;
+	u = &b->utt[b->n_utt++];
+	parse_ctl_line(li->buf, &u->path, &u->sf, &u->ef, NULL);
+	lineiter_free(li);
+	u->fn = NULL;
+	u->coeff = NULL;
+	u->n_c = -1;
+	/* The cache will serve it without the cepstra. */
+	if (u->sf == NO_FRAME && u->ef == NO_FRAME
+	    && !feat_cache_valid(u->path, u->sf, u->ef))
+	    u->fn = ckd_salloc(mk_filename(DATA_TYPE_MFCC, u->path));
+	if (pf_n_run != UNTIL_EOF)
+	    --pf_n_run;
+    }
+
+    if (b->n_utt > 0
+	&& (b->thread = sbthread_start(NULL, pf_read, b)) == NULL)
+	E_FATAL("Failed to start the corpus reading thread\n");
+}
+
+static void
+pf_start(void)
+{
+    if (n_prefetch == 0 || !requires_mfcc || next_ctl_path == NULL)
+	return;
+
+    if ((pf_fp = fopen(ctl_fn, "rb")) == NULL) {
+	E_ERROR_SYSTEM("Unable to open %s for reading ahead", ctl_fn);
+	return;
+    }
+    fseek(pf_fp, ftell(ctl_fp), SEEK_SET);
+
+    /* The next utterance has been read from the control file already. */
+    if (n_run == UNTIL_EOF)
+	pf_n_run = UNTIL_EOF;
+    else
+	pf_n_run = n_run > 0 ? n_run - 1 : 0;
+
+    pf_cur->utt = ckd_calloc(n_prefetch, sizeof(pf_utt_t));
+    pf_next->utt = ckd_calloc(n_prefetch, sizeof(pf_utt_t));
+    pf_fill(pf_next);
+}
+
+static void
+pf_stop(void)
+{
+    if (pf_fp == NULL)
+	return;
+
+    pf_clear(pf_cur);
+    pf_clear(pf_next);
+    ckd_free(pf_cur->utt);
+    ckd_free(pf_next->utt);
+    pf_cur->utt = pf_next->utt = NULL;
+    pf_utt = NULL;
+    fclose(pf_fp);
+    pf_fp = NULL;
+}
+
+/* Find what was read ahead for the utterance that is now current. */
+static void
+pf_advance(void)
+{
+    pf_utt_t *u;
+
+    if (pf_fp == NULL)
+	return;
+
+    /* Whatever the last one did not take is not needed any more. */
+    if (pf_utt && pf_utt->coeff) {
+	free(pf_utt->coeff);
+	pf_utt->coeff = NULL;
+    }
+    pf_utt = NULL;
+
+    if (pf_cur->next == pf_cur->n_utt) {
+	pf_batch_t *tmp;
+
+	pf_clear(pf_cur);
+	tmp = pf_cur;
+	pf_cur = pf_next;
+	pf_next = tmp;
+	/* Wait for it, then start on the one after. */
+	if (pf_cur->thread) {
+	    sbthread_free(pf_cur->thread);
+	    pf_cur->thread = NULL;
+	}
+	pf_fill(pf_next);
+    }
+
+    if (pf_cur->next == pf_cur->n_utt)
+	return;
+    u = &pf_cur->utt[pf_cur->next];
+    if (strcmp(u->path, cur_ctl_path) == 0
+	&& u->sf == cur_ctl_sf && u->ef == cur_ctl_ef) {
+	pf_utt = u;
+	++pf_cur->next;
+    }
+}
+
+int
+corpus_set_prefetch(uint32 n_utt)
+{
+    n_prefetch = n_utt;
+
+    return S3_SUCCESS;
+}
+
+int
+corpus_set_feat_cache_dir(const char *dir, feat_t *fcb)
+{
+    feat_cache_dir = dir;
+    feat_cache_fcb = fcb;
+
+    return S3_SUCCESS;
+}
+
 int
 corpus_reset()
 {
     lineiter_t* li;
+    int prefetching = (pf_fp != NULL);
+
+    pf_stop();
     n_run = UNTIL_EOF;
 
     assert(ctl_fp);
@@ -468,6 +700,9 @@ corpus_reset()
 
     corpus_set_interval(sv_n_skip, sv_run_len);
 
+    if (prefetching)
+	pf_start();
+
     return S3_SUCCESS;
 }
 
@@ -1088,6 +1323,8 @@ corpus_init()
     else {
 	E_INFO("Will process %d utts starting at %d\n", n_run, begin);
     }
+
+    pf_start();
     
     return S3_SUCCESS;
 }
@@ -1112,15 +1349,22 @@ corpus_next_utt()
     cur_ctl_ef = next_ctl_ef;
 
     if (n_run != UNTIL_EOF) {
-	if (n_run == 0) return FALSE;
+	if (n_run == 0) {
+	    pf_stop();
+	    return FALSE;
+	}
 
 	--n_run;
     }
 
     ++n_proc;
 
-    if (cur_ctl_path == NULL || strlen(cur_ctl_path) == 0)
+    if (cur_ctl_path == NULL || strlen(cur_ctl_path) == 0) {
+	pf_stop();
 	return FALSE;
+    }
+
+    pf_advance();
 
     /* if a big LSN file exists, position it to the correct line
      * corpus_set_ctl_filename() reads the first line of
@@ -1333,7 +1577,17 @@ corpus_get_generic_featurevec(vector_t **mfc,
 	cptr = NULL;
     }
 
-    do {
+    if (pf_utt && pf_utt->n_c >= 0) {
+	/* Read ahead already. */
+	ret = n_c = pf_utt->n_c;
+	if (mfc) {
+	    /* It is the caller's now, so read it again if asked twice. */
+	    coeff = pf_utt->coeff;
+	    pf_utt->coeff = NULL;
+	    pf_utt->n_c = -1;
+	}
+    }
+    else do {
 	if ((cur_ctl_sf == NO_FRAME) && (cur_ctl_ef == NO_FRAME)) {
 	    ret = areadfloat(mk_filename(DATA_TYPE_MFCC, cur_ctl_path),
 			     cptr, (int *)&n_c);
@@ -1392,6 +1646,261 @@ corpus_get_generic_featurevec(vector_t **mfc,
     return S3_SUCCESS;
 }
 
+/*
+ * Feature cache.  Each utterance has a file under feat_cache_dir,
+ * in the host's byte order, with a header of FEAT_CACHE_HDR_SIZE
+ * words (magic, byte order, input and output frame counts, number
+ * of streams, feature and frame dimensions, and two words of
+ * fingerprint of the feature computation) followed by the frames.
+ */
+
+static char *
+feat_cache_filename(char *path, uint32 sf, uint32 ef)
+{
+    static char fn[MAXPATHLEN];
+
+    if ((sf == NO_FRAME) && (ef == NO_FRAME))
+	sprintf(fn, "%s/%s.feat", feat_cache_dir, path);
+    else
+	sprintf(fn, "%s/%s_%u-%u.feat", feat_cache_dir, path, sf, ef);
+
+    return fn;
+}
+
+/* Number of values in each frame of a feature array, which is the
+ * stride of its data and not necessarily its dimension. */
+static uint32
+feat_frame_size(feat_t *fcb)
+{
+    uint32 i, k;
+
+    for (i = k = 0; i < fcb->n_stream; i++)
+	k += fcb->stream_len[i];
+
+    return k;
+}
+
+/* FNV-1a, continued from h. */
+static uint32
+feat_cache_hash(uint32 h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--) {
+	h ^= *p++;
+	h *= 16777619;
+    }
+    return h;
+}
+
+/* Fingerprint of everything that goes into computing the features,
+ * other than the cepstra: feature type, normalization and gain
+ * control, subvectors and the LDA/MLLT transform. */
+static void
+feat_cache_fingerprint(feat_t *fcb, uint32 *out)
+{
+    static const uint32 seed[2] = { 2166136261u, 3323198485u };
+    int32 param[6];
+    int i, j;
+
+    param[0] = fcb->cepsize;
+    param[1] = fcb->window_size;
+    param[2] = fcb->cmn;
+    param[3] = fcb->varnorm;
+    param[4] = fcb->agc;
+    param[5] = fcb->n_sv;
+    for (i = 0; i < 2; i++) {
+	uint32 h = seed[i];
+
+	h = feat_cache_hash(h, fcb->name, strlen(fcb->name));
+	h = feat_cache_hash(h, param, sizeof(param));
+	if (fcb->agc == AGC_NOISE && fcb->agc_struct)
+	    h = feat_cache_hash(h, &fcb->agc_struct->noise_thresh,
+				sizeof(fcb->agc_struct->noise_thresh));
+	if (fcb->subvecs) {
+	    for (j = 0; j < fcb->n_sv; j++) {
+		int32 *sv;
+
+		for (sv = fcb->subvecs[j]; *sv != -1; sv++)
+		    h = feat_cache_hash(h, sv, sizeof(*sv));
+		h = feat_cache_hash(h, sv, sizeof(*sv));
+	    }
+	}
+	if (fcb->lda) {
+	    /* Only the rows that are used. */
+	    h = feat_cache_hash(h, &fcb->out_dim, sizeof(fcb->out_dim));
+	    h = feat_cache_hash(h, fcb->lda[0][0], fcb->out_dim
+				* fcb->stream_len[0] * sizeof(mfcc_t));
+	}
+	out[i] = h;
+    }
+}
+
+static void
+feat_cache_header(feat_t *fcb, uint32 *hdr, int32 n_frame, int32 n_frame_in)
+{
+    memset(hdr, 0, FEAT_CACHE_HDR_SIZE * sizeof(*hdr));
+    memcpy(hdr, FEAT_CACHE_MAGIC, 2 * sizeof(*hdr));
+    hdr[2] = FEAT_CACHE_BYTEORDER;
+    hdr[3] = n_frame_in;
+    hdr[4] = n_frame;
+    hdr[5] = feat_dimension1(fcb);
+    hdr[6] = feat_dimension(fcb);
+    hdr[7] = feat_frame_size(fcb);
+    feat_cache_fingerprint(fcb, hdr + 8);
+}
+
+/* Whether features can be cached at all.  With live CMN or estimated
+ * AGC, they depend on the utterances that came before, and reading
+ * them from the cache would also skip updating those estimates. */
+static int
+feat_cache_usable(feat_t *fcb)
+{
+    static int warned = FALSE;
+
+    if (feat_cache_dir == NULL)
+	return FALSE;
+    if (fcb->cmn == CMN_PRIOR || fcb->agc == AGC_EMAX) {
+	if (!warned)
+	    E_WARN("Not caching features, which depend on earlier "
+		   "utterances with -cmn prior or -agc emax\n");
+	warned = TRUE;
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/* Open the cache file for an utterance, if it is valid, and read its
+ * header, leaving the file at the first frame. */
+static FILE *
+feat_cache_open(feat_t *fcb, char *path, uint32 sf, uint32 ef,
+		uint32 *hdr, int verbose)
+{
+    uint32 ref[FEAT_CACHE_HDR_SIZE];
+    struct stat cache_st, mfc_st;
+    char *fn;
+    FILE *fp;
+
+    if (!feat_cache_usable(fcb))
+	return NULL;
+
+    fn = feat_cache_filename(path, sf, ef);
+    if (stat(fn, &cache_st) < 0)
+	return NULL;
+    /* Cepstra written since then make it stale. */
+    if (stat(mk_filename(DATA_TYPE_MFCC, path), &mfc_st) == 0
+	&& mfc_st.st_mtime > cache_st.st_mtime)
+	return NULL;
+
+    if ((fp = fopen(fn, "rb")) == NULL)
+	return NULL;
+    if (fread(hdr, sizeof(*hdr), FEAT_CACHE_HDR_SIZE, fp)
+	!= FEAT_CACHE_HDR_SIZE) {
+	fclose(fp);
+	return NULL;
+    }
+    feat_cache_header(fcb, ref, hdr[4], hdr[3]);
+    if (memcmp(hdr, ref, sizeof(ref)) != 0 || hdr[4] == 0) {
+	if (verbose)
+	    E_WARN("Ignoring %s, made for other features\n", fn);
+	fclose(fp);
+	return NULL;
+    }
+
+    return fp;
+}
+
+static int
+feat_cache_valid(char *path, uint32 sf, uint32 ef)
+{
+    uint32 hdr[FEAT_CACHE_HDR_SIZE];
+    FILE *fp;
+
+    if (feat_cache_fcb == NULL
+	|| (fp = feat_cache_open(feat_cache_fcb, path, sf, ef,
+				 hdr, FALSE)) == NULL)
+	return FALSE;
+    fclose(fp);
+
+    return TRUE;
+}
+
+int
+corpus_get_feat_cache(feat_t *fcb,
+		      mfcc_t ****out_feat,
+		      int32 *out_n_frame,
+		      int32 *out_n_frame_in)
+{
+    uint32 hdr[FEAT_CACHE_HDR_SIZE];
+    mfcc_t ***feat;
+    FILE *fp;
+
+    if ((fp = feat_cache_open(fcb, cur_ctl_path, cur_ctl_sf, cur_ctl_ef,
+			      hdr, TRUE)) == NULL)
+	return S3_ERROR;
+
+    feat = feat_array_alloc(fcb, hdr[4]);
+    if (fread(feat[0][0], sizeof(mfcc_t), hdr[4] * hdr[7], fp)
+	!= hdr[4] * hdr[7]) {
+	E_WARN("Ignoring %s, which is truncated\n",
+	       feat_cache_filename(cur_ctl_path, cur_ctl_sf, cur_ctl_ef));
+	feat_array_free(feat);
+	fclose(fp);
+	return S3_ERROR;
+    }
+    fclose(fp);
+
+    *out_feat = feat;
+    *out_n_frame = hdr[4];
+    *out_n_frame_in = hdr[3];
+
+    return S3_SUCCESS;
+}
+
+int
+corpus_put_feat_cache(feat_t *fcb,
+		      mfcc_t ***feat,
+		      int32 n_frame,
+		      int32 n_frame_in)
+{
+    uint32 hdr[FEAT_CACHE_HDR_SIZE];
+    char fn[MAXPATHLEN], tmpfn[MAXPATHLEN + 4], dir[MAXPATHLEN];
+    size_t n;
+    FILE *fp;
+
+    if (n_frame <= 0 || !feat_cache_usable(fcb))
+	return S3_ERROR;
+
+    strcpy(fn, feat_cache_filename(cur_ctl_path, cur_ctl_sf, cur_ctl_ef));
+    path2dirname(fn, dir);
+    build_directory(dir);
+    /* Write it under another name first, so that nothing ever reads
+     * half of it. */
+    sprintf(tmpfn, "%s.tmp", fn);
+    if ((fp = fopen(tmpfn, "wb")) == NULL) {
+	E_ERROR_SYSTEM("Unable to open %s for writing", tmpfn);
+	return S3_ERROR;
+    }
+
+    feat_cache_header(fcb, hdr, n_frame, n_frame_in);
+    n = n_frame * hdr[7];
+    if (fwrite(hdr, sizeof(*hdr), FEAT_CACHE_HDR_SIZE, fp)
+	!= FEAT_CACHE_HDR_SIZE
+	|| fwrite(feat[0][0], sizeof(mfcc_t), n, fp) != n) {
+	E_ERROR_SYSTEM("Unable to write %s", tmpfn);
+	fclose(fp);
+	unlink(tmpfn);
+	return S3_ERROR;
+    }
+    if (fclose(fp) != 0 || rename(tmpfn, fn) != 0) {
+	E_ERROR_SYSTEM("Unable to write %s", fn);
+	unlink(tmpfn);
+	return S3_ERROR;
+    }
+
+    return S3_SUCCESS;
+}
+
 int
 corpus_get_seg(uint16 **seg,
 	       int32 *n_seg)
@@ -93,39 +93,24 @@ rdacc_tmat(const char *dir,
     sprintf(fn, "%s/tmat_counts", dir);
 
     if (ck_readable(fn)) {
-        if (s3tmat_read(fn,
-                        &in_tmat_acc,
-                        &n_tmat, &n_state_pm) != S3_SUCCESS) {
-            return S3_ERROR;
-        }
         tmat_acc = *inout_tmat_acc;
 
         if (tmat_acc == NULL) {
+            if (s3tmat_read(fn,
+                            &in_tmat_acc,
+                            &n_tmat, &n_state_pm) != S3_SUCCESS) {
+                return S3_ERROR;
+            }
             *inout_tmat_acc = tmat_acc = in_tmat_acc;
             *inout_n_tmat = n_tmat;
             *inout_n_state_pm = n_state_pm;
         }
         else {
-            int err = FALSE;
-
-            if (*inout_n_tmat != n_tmat) {
-                E_ERROR("# tmat in, %u != prior # tmat, %u\n",
-                        n_tmat, *inout_n_tmat);
-                err = TRUE;
-            }
-            if (*inout_n_state_pm != n_state_pm) {
-                E_ERROR("# tmat in, %u != prior # tmat, %u\n",
-                        n_state_pm, *inout_n_state_pm);
-                err = TRUE;
-            }
-
-            if (err)
+            /* Add them up as they are read */
+            if (s3tmat_read_accum(fn, tmat_acc, *inout_n_tmat,
+                                  *inout_n_state_pm) != S3_SUCCESS) {
                 return S3_ERROR;
-
-            accum_3d(tmat_acc, in_tmat_acc,
-                     n_tmat, n_state_pm - 1, n_state_pm);
-
-            ckd_free_3d((void ***) in_tmat_acc);
+            }
         }
     }
     else {
@@ -153,50 +138,26 @@ rdacc_mixw(const char *dir,
     sprintf(fn, "%s/mixw_counts", dir);
 
     if (ck_readable(fn)) {
-        if (s3mixw_read(fn,
-                        &in_mixw_acc,
-                        &n_mixw, &n_stream, &n_density) != S3_SUCCESS) {
-            return S3_ERROR;
-        }
-
         mixw_acc = *inout_mixw_acc;
 
         if (mixw_acc == NULL) {
+            if (s3mixw_read(fn,
+                            &in_mixw_acc,
+                            &n_mixw, &n_stream, &n_density) != S3_SUCCESS) {
+                return S3_ERROR;
+            }
             *inout_mixw_acc = mixw_acc = in_mixw_acc;
             *inout_n_mixw = n_mixw;
             *inout_n_stream = n_stream;
             *inout_n_density = n_density;
         }
         else {
-            int err = FALSE;
-
-            if (*inout_n_mixw != n_mixw) {
-                E_ERROR
-                    ("# mixw in file %s (== %u) != prior # mixw (== %u)\n",
-                     fn, n_mixw, *inout_n_mixw);
-                err = TRUE;
-            }
-
-            if (*inout_n_stream != n_stream) {
-                E_ERROR
-                    ("# stream in file %s (== %u) != prior # stream (== %u)\n",
-                     fn, n_stream, *inout_n_stream);
-                err = TRUE;
-            }
-
-            if (*inout_n_density != n_density) {
-                E_ERROR
-                    ("# density comp/mix in file %s (== %u) != prior # density (== %u)\n",
-                     fn, n_density, *inout_n_density);
-                err = TRUE;
-            }
-
-            if (err)
+            /* Add them up as they are read */
+            if (s3mixw_read_accum(fn, mixw_acc, *inout_n_mixw,
+                                  *inout_n_stream,
+                                  *inout_n_density) != S3_SUCCESS) {
                 return S3_ERROR;
-
-            accum_3d(mixw_acc, in_mixw_acc, n_mixw, n_stream, n_density);
-
-            ckd_free_3d((void ***) in_mixw_acc);
+            }
         }
     }
     else {
@@ -229,7 +190,6 @@ rdacc_den(const char *dir,
     uint32 n_stream;
     uint32 n_density;
     int32 pass2var;
-    int i;
 
     uint32 *in_veclen;
 
@@ -240,24 +200,23 @@ rdacc_den(const char *dir,
         return S3_ERROR;
     }
 
-    if (s3gaucnt_read(fn,
-                      &in_wt_mean,
-                      &in_wt_var,
-                      &pass2var,
-                      &in_dnom,
-                      &n_mgau,
-                      &n_stream, &n_density, &in_veclen) != S3_SUCCESS) {
-        fflush(stdout);
-        perror(fn);
-
-        return S3_ERROR;
-    }
-
     wt_mean = *inout_wt_mean;
     wt_var = *inout_wt_var;
     dnom = *inout_dnom;
 
     if (wt_mean == NULL) {
+        if (s3gaucnt_read(fn,
+                          &in_wt_mean,
+                          &in_wt_var,
+                          &pass2var,
+                          &in_dnom,
+                          &n_mgau,
+                          &n_stream, &n_density, &in_veclen) != S3_SUCCESS) {
+            fflush(stdout);
+            perror(fn);
+
+            return S3_ERROR;
+        }
 
         /* if a gauden_counts file exists, it will have reestimated means */
 
@@ -274,64 +233,12 @@ rdacc_den(const char *dir,
         }
     }
     else {
-        int err = FALSE;
-
-        /* check if matrices are able to be added */
-        if (*inout_n_mgau != n_mgau) {
-            E_ERROR
-                ("# mix. Gau. for file %s (== %u) != prior # mix. Gau. (== %u)\n",
-                 fn, n_mgau, *inout_n_mgau);
-            err = TRUE;
-        }
-
-        if (*inout_n_stream != n_stream) {
-            E_ERROR
-                ("# stream for file %s (== %u) != prior # stream (== %u)\n",
-                 fn, n_stream, *inout_n_stream);
-            err = TRUE;
-        }
-
-        if (*inout_n_density != n_density) {
-            E_ERROR
-                ("# density comp/mix for file %s (== %u) != prior # density, %u\n",
-                 fn, n_density, *inout_n_density);
-            err = TRUE;
-        }
-
-        if (*inout_pass2var != pass2var) {
-            E_ERROR("2 pass var %s in %s, but %s in others.\n",
-                    fn, (pass2var ? "true" : "false"),
-                    (*inout_pass2var ? "true" : "false"));
-            err = TRUE;
-        }
-
-        for (i = 0; i < n_stream; i++) {
-            if ((*inout_veclen)[i] != in_veclen[i]) {
-                E_ERROR
-                    ("vector length of stream %u (== %u) != prior length (== %u)\n",
-                     i, in_veclen[i], (*inout_veclen)[i]);
-                err = TRUE;
-            }
-        }
-
-        ckd_free(in_veclen);
-
-        if (err)
+        /* Add them up as they are read */
+        if (s3gaucnt_read_accum(fn, wt_mean, wt_var, *inout_pass2var, dnom,
+                                *inout_n_mgau, *inout_n_stream,
+                                *inout_n_density,
+                                *inout_veclen) != S3_SUCCESS) {
             return S3_ERROR;
-
-        /* accumulate values */
-        accum_3d(dnom, in_dnom, n_mgau, n_stream, n_density);
-
-        gauden_accum_param(wt_mean, in_wt_mean,
-                           n_mgau, n_stream, n_density, *inout_veclen);
-        gauden_free_param(in_wt_mean);
-
-        if (wt_var) {
-            assert(in_wt_var);
-
-            gauden_accum_param(wt_var, in_wt_var,
-                               n_mgau, n_stream, n_density, *inout_veclen);
-            gauden_free_param(in_wt_var);
         }
     }
 
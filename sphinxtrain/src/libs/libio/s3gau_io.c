@@ -388,6 +388,146 @@ s3gaucnt_read(const char *fn,
     return S3_SUCCESS;
 }
 
+int
+s3gaucnt_read_accum(const char *fn,
+		    vector_t ***wt_mean,
+		    vector_t ***wt_var,
+		    int32 pass2var,
+		    float32 ***dnom,
+		    uint32 n_cb,
+		    uint32 n_feat,
+		    uint32 n_density,
+		    const uint32 *veclen)
+{
+    uint32 rd_chksum = 0;
+    uint32 sv_chksum;
+    uint32 ignore;
+    char *ver;
+    char *do_chk;
+    FILE *fp;
+    uint32 swap;
+
+    uint32 hdr[5];		/* has_means, has_vars, pass2var, n_cb, n_density */
+    uint32 *in_veclen;
+    uint32 in_n_feat;
+    uint32 n_elem, blk, j;
+    int err = FALSE;
+
+    fp = s3open(fn, "rb", &swap);
+    if (fp == NULL)
+	return S3_ERROR;
+
+    /* check version id */
+    ver = s3get_gvn_fattr("version");
+    if (ver) {
+	if (strcmp(ver, GAUCNT_FILE_VERSION) != 0) {
+	    E_FATAL("Version mismatch for %s, file ver: %s != reader ver: %s\n",
+		    fn, ver, GAUCNT_FILE_VERSION);
+	}
+    }
+    else {
+	E_FATAL("No version attribute for %s\n", fn);
+    }
+    
+    /* if do_chk is non-NULL, there is a checksum after the data in the file */
+    do_chk = s3get_gvn_fattr("chksum0");
+
+    if (bio_fread((void *)hdr, sizeof(uint32), 5, fp, swap, &rd_chksum) != 5) {
+	s3close(fp);
+	return S3_ERROR;
+    }
+    if (bio_fread_1d((void **)&in_veclen, sizeof(uint32), &in_n_feat, fp, swap, &rd_chksum) < 0) {
+	s3close(fp);
+	return S3_ERROR;
+    }
+
+    /* check that the counts can be added */
+    if (hdr[3] != n_cb) {
+	E_ERROR("# mix. Gau. for file %s (== %u) != prior # mix. Gau. (== %u)\n",
+		fn, hdr[3], n_cb);
+	err = TRUE;
+    }
+    if (in_n_feat != n_feat) {
+	E_ERROR("# stream for file %s (== %u) != prior # stream (== %u)\n",
+		fn, in_n_feat, n_feat);
+	err = TRUE;
+    }
+    if (hdr[4] != n_density) {
+	E_ERROR("# density comp/mix for file %s (== %u) != prior # density, %u\n",
+		fn, hdr[4], n_density);
+	err = TRUE;
+    }
+    if (hdr[2] != (uint32)pass2var) {
+	E_ERROR("2 pass var %s in %s, but %s in others.\n",
+		(hdr[2] ? "true" : "false"), fn,
+		(pass2var ? "true" : "false"));
+	err = TRUE;
+    }
+    if (!hdr[0] != (wt_mean == NULL)) {
+	E_ERROR("Means %s in %s, but %s in others.\n",
+		(hdr[0] ? "present" : "absent"), fn,
+		(wt_mean ? "present" : "absent"));
+	err = TRUE;
+    }
+    if (!hdr[1] && wt_var) {
+	E_ERROR("No variances in %s, but present in others.\n", fn);
+	err = TRUE;
+    }
+    for (j = 0, blk = 0; !err && j < n_feat; j++) {
+	if (in_veclen[j] != veclen[j]) {
+	    E_ERROR("vector length of stream %u (== %u) != prior length (== %u)\n",
+		    j, in_veclen[j], veclen[j]);
+	    err = TRUE;
+	}
+	blk += veclen[j];
+    }
+    ckd_free(in_veclen);
+    if (err) {
+	s3close(fp);
+	return S3_ERROR;
+    }
+
+    n_elem = n_cb * n_density * blk;
+
+    if (hdr[0] &&
+	s3read_accum_1d(wt_mean[0][0][0], n_elem, fp, swap, &rd_chksum) != S3_SUCCESS)
+	goto error_loc;
+    if (hdr[1] &&
+	s3read_accum_1d(wt_var ? wt_var[0][0][0] : NULL,
+			n_elem, fp, swap, &rd_chksum) != S3_SUCCESS)
+	goto error_loc;
+    if (s3read_accum_3d(dnom, n_cb, n_feat, n_density,
+			fp, swap, &rd_chksum) != S3_SUCCESS)
+	goto error_loc;
+
+    if (do_chk) {
+	if (bio_fread(&sv_chksum, sizeof(uint32), 1, fp, swap, &ignore) != 1) {
+	    s3close(fp);
+	    return S3_ERROR;
+	}
+	
+	if (sv_chksum != rd_chksum) {
+	    E_FATAL("Checksum error; read corrupt data.\n");
+	}
+    }
+    
+    s3close(fp);
+
+    E_INFO("Accumulated %s%s%s%s [%ux%ux%u vector arrays]\n",
+	   fn,
+	   (hdr[0] ? " with means" : ""),
+	   (hdr[1] ? " with vars" : ""),
+	   (hdr[1] && pass2var ? " (2pass)" : ""),
+	   n_cb, n_feat, n_density);
+
+    return S3_SUCCESS;
+
+error_loc:
+    E_ERROR("Failed to accumulate counts from %s\n", fn);
+    s3close(fp);
+    return S3_ERROR;
+}
+
 int
 s3gaucnt_write(const char *fn,
 	       vector_t ***wt_mean,
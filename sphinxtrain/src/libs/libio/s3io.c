@@ -59,10 +59,21 @@
 
 #define MAX_ATTRIB 128
 
-static char *attrib[MAX_ATTRIB + 1] = { NULL };
-static char *value[MAX_ATTRIB + 1] = { NULL };
-static int32 alloc[MAX_ATTRIB];
-static int32 n_attrib = 0;
+/* Number of array elements read at a time by s3read_accum_1d() */
+#define ACCUM_CHUNK 4096
+
+/* The attributes of the file being read or written are kept per
+ * thread, so that several threads can read files at once. */
+#ifdef _MSC_VER
+#define S3IO_TLS __declspec(thread)
+#else
+#define S3IO_TLS __thread
+#endif
+
+static S3IO_TLS char *attrib[MAX_ATTRIB + 1] = { NULL };
+static S3IO_TLS char *value[MAX_ATTRIB + 1] = { NULL };
+static S3IO_TLS int32 alloc[MAX_ATTRIB];
+static S3IO_TLS int32 n_attrib = 0;
 
 void s3clr_fattr()
 {
@@ -399,6 +410,67 @@ bio_fread_intv_3d(void ****arr,
     return S3_SUCCESS;
 }
 
+int32
+s3read_accum_1d(float32 *acc,
+		uint32 n_el,
+		FILE *fp,
+		uint32 swap,
+		uint32 *chksum)
+{
+    float32 buf[ACCUM_CHUNK];
+    uint32 n, i, j;
+
+    if (bio_fread(&n, sizeof(uint32), 1, fp, swap, chksum) != 1) {
+	E_ERROR_SYSTEM("Unable to read array size");
+	return S3_ERROR;
+    }
+    if (n != n_el) {
+	E_ERROR("Array size %u != expected size %u\n", n, n_el);
+	return S3_ERROR;
+    }
+
+    for (i = 0; i < n_el; i += n) {
+	n = n_el - i;
+	if (n > ACCUM_CHUNK)
+	    n = ACCUM_CHUNK;
+	if (bio_fread(buf, sizeof(float32), n, fp, swap, chksum) != n) {
+	    E_ERROR_SYSTEM("Unable to read complete data");
+	    return S3_ERROR;
+	}
+	if (acc) {
+	    for (j = 0; j < n; j++)
+		acc[i + j] += buf[j];
+	}
+    }
+
+    return S3_SUCCESS;
+}
+
+int32
+s3read_accum_3d(float32 ***acc,
+		uint32 d1,
+		uint32 d2,
+		uint32 d3,
+		FILE *fp,
+		uint32 swap,
+		uint32 *chksum)
+{
+    uint32 l_d[3];
+
+    if (bio_fread(l_d, sizeof(uint32), 3, fp, swap, chksum) != 3) {
+	E_ERROR_SYSTEM("Unable to read array dimensions");
+	return S3_ERROR;
+    }
+    if (l_d[0] != d1 || l_d[1] != d2 || l_d[2] != d3) {
+	E_ERROR("Array dimensions %ux%ux%u != expected %ux%ux%u\n",
+		l_d[0], l_d[1], l_d[2], d1, d2, d3);
+	return S3_ERROR;
+    }
+
+    return s3read_accum_1d(acc ? acc[0][0] : NULL, d1 * d2 * d3,
+			   fp, swap, chksum);
+}
+
 /* Macro to byteswap an int variable.  x = ptr to variable */
 #define MYSWAP_INT(x)   *(x) = ((0x000000ff & (*(x))>>24) | \
                                 (0x0000ff00 & (*(x))>>8) | \
@@ -119,6 +119,66 @@ s3mixw_read(const char *fn,
     return S3_SUCCESS;
 }
 
+int
+s3mixw_read_accum(const char *fn,
+		  float32 ***mixw,
+		  uint32 n_mixw,
+		  uint32 n_feat,
+		  uint32 n_density)
+{
+    uint32 rd_chksum = 0;
+    uint32 sv_chksum;
+    uint32 ignore;
+    char *ver;
+    char *do_chk;
+    FILE *fp;
+    uint32 swap;
+
+    fp = s3open(fn, "rb", &swap);
+    if (fp == NULL)
+	return S3_ERROR;
+
+    /* check version id */
+    ver = s3get_gvn_fattr("version");
+    if (ver) {
+	if (strcmp(ver, MIXW_FILE_VERSION) != 0) {
+	    E_FATAL("Version mismatch for %s, file ver: %s != reader ver: %s\n",
+		    fn, ver, MIXW_FILE_VERSION);
+	}
+    }
+    else {
+	E_FATAL("No version attribute for %s\n", fn);
+    }
+    
+    /* if do_chk is non-NULL, there is a checksum after the data in the file */
+    do_chk = s3get_gvn_fattr("chksum0");
+
+    if (s3read_accum_3d(mixw, n_mixw, n_feat, n_density,
+			fp, swap, &rd_chksum) != S3_SUCCESS) {
+	E_ERROR("Failed to accumulate counts from %s\n", fn);
+	s3close(fp);
+	return S3_ERROR;
+    }
+
+    if (do_chk) {
+	if (bio_fread(&sv_chksum, sizeof(uint32), 1, fp, swap, &ignore) != 1) {
+	    s3close(fp);
+	    return S3_ERROR;
+	}
+
+	if (sv_chksum != rd_chksum) {
+	    E_FATAL("Checksum error; read corrupt data.\n");
+	}
+    }
+
+    s3close(fp);
+
+    E_INFO("Accumulated %s [%ux%ux%u array]\n",
+	   fn, n_mixw, n_feat, n_density);
+
+    return S3_SUCCESS;
+}
+
 int
 s3mixw_intv_read(const char *fn,
 		 uint32  mixw_s,
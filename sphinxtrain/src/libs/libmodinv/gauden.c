@@ -57,6 +57,7 @@
  *********************************************************************/
 
 #include <s3/gauden.h>
+#include <s3/gauden_simd.h>
 
 #include <sphinxbase/err.h>
 #include <sphinxbase/ckd_alloc.h>
@@ -127,6 +128,9 @@ gauden_free(gauden_t *g)
     if (g->norm)
 	ckd_free_3d((void ***)g->norm);
     g->norm = NULL;
+
+    gauden_simd_free(g->simd);
+    g->simd = NULL;
     
     if (g->veclen)
 	ckd_free(g->veclen);
@@ -989,25 +993,22 @@ log_full_densities_full(float64 *den,
     }
 }
 
-static void
-log_topn_densities(float64 *den,
-		   uint32 *den_idx,
-		   uint32 n_top,
-		   uint32 n_density,
-		   uint32 veclen,
-		   vector_t obs,
-		   vector_t *mean,
-		   vector_t *var,
-		   float32 *log_norm,
-		   uint32 *prev_den_idx)
+/* Seed the top N densities with the previous frame's top N (if
+ * any) and return the worst of them. */
+static float64
+topn_init(float64 *den,
+	  uint32 *den_idx,
+	  uint32 n_top,
+	  uint32 n_density,
+	  uint32 veclen,
+	  vector_t obs,
+	  vector_t *mean,
+	  vector_t *var,
+	  float32 *log_norm,
+	  uint32 *prev_den_idx)
 {
     uint32 i, j, k;
-    vector_t m;
-    vector_t v;
-    float64 diff;
     float64 d;
-    float64 worst;	/* worst density value of the top N density values
-			   seen so far */
 
     /* Initialize topn using the previous frame's top codeword indices */
     if (prev_den_idx) {
@@ -1035,7 +1036,58 @@ log_topn_densities(float64 *den,
 	}
     }
 
-    worst = den[n_top-1];
+    return den[n_top-1];
+}
+
+/* Insert density i, whose value d is better than the worst of the
+ * top N, and return the new worst value. */
+static float64
+topn_insert(float64 *den,
+	    uint32 *den_idx,
+	    uint32 n_top,
+	    uint32 i,
+	    float64 d)
+{
+    uint32 j, k;
+
+    /* This may already have been in topn from the initialization pass */
+    for (j = 0; j < n_top; j++)
+	if (den_idx[j] == i)
+	    break;
+    if (j < n_top)
+	return den[n_top-1]; /* It's already there, don't insert it */
+    for (k = n_top-1; k > 0 && d > den[k-1]; --k) {
+	den_idx[k] = den_idx[k-1];
+	den[k] = den[k-1];
+    }
+    den_idx[k] = i;
+    den[k] = d;
+
+    return den[n_top-1];
+}
+
+static void
+log_topn_densities(float64 *den,
+		   uint32 *den_idx,
+		   uint32 n_top,
+		   uint32 n_density,
+		   uint32 veclen,
+		   vector_t obs,
+		   vector_t *mean,
+		   vector_t *var,
+		   float32 *log_norm,
+		   uint32 *prev_den_idx)
+{
+    uint32 i, j;
+    vector_t m;
+    vector_t v;
+    float64 diff;
+    float64 d;
+    float64 worst;	/* worst density value of the top N density values
+			   seen so far */
+
+    worst = topn_init(den, den_idx, n_top, n_density, veclen,
+		      obs, mean, var, log_norm, prev_den_idx);
 
     for (i = 0; i < n_density; i++) {
 	m = mean[i];
@@ -1054,22 +1106,142 @@ log_topn_densities(float64 *den,
 	if (j < veclen || d <= worst)
 	    continue;
 
-	/* This may already have been in topn from the initialization pass */
-	for (j = 0; j < n_top; j++)
-	    if (den_idx[j] == i)
-		break;
-	if (j < n_top)
-	    continue; /* It's already there, don't insert it */
-	for (k = n_top-1; k > 0 && d > den[k-1]; --k) {
-	    den_idx[k] = den_idx[k-1];
-	    den[k] = den[k-1];
+	worst = topn_insert(den, den_idx, n_top, i, d);
+    }
+}
+
+/* Same as log_full_densities(), a block of densities at a time. */
+static void
+log_full_densities_simd(float64 *den,
+			uint32 *den_idx,
+			gauden_t *g,
+			uint32 mgau,
+			uint32 feat,
+			vector_t obs)
+{
+    gauden_simd_t *simd = g->simd;
+    float64 out[GAUDEN_SIMD_BLOCK];
+    float32 *mean = simd->mean[mgau][feat];
+    float32 *var = simd->var[mgau][feat];
+    float32 *norm = simd->norm[mgau][feat];
+    uint32 i, b, n;
+
+    for (i = 0; i < g->n_density; i += GAUDEN_SIMD_BLOCK) {
+	(*simd->eval_block)(out, obs, mean + i, var + i, norm + i,
+			    simd->stride, g->veclen[feat], FALSE, 0);
+	n = g->n_density - i;
+	if (n > GAUDEN_SIMD_BLOCK)
+	    n = GAUDEN_SIMD_BLOCK;
+	for (b = 0; b < n; b++) {
+	    den[i + b] = out[b];
+	    den_idx[i + b] = i + b;
+	}
+    }
+}
+
+/* Same as log_topn_densities(), a block of densities at a time.
+ * Blocks that all fall below the worst of the top N (as of the start
+ * of the block) are abandoned early; the rest are inserted in order,
+ * so the result does not depend on the block size. */
+static void
+log_topn_densities_simd(float64 *den,
+			uint32 *den_idx,
+			gauden_t *g,
+			uint32 mgau,
+			uint32 feat,
+			vector_t obs,
+			uint32 *prev_den_idx)
+{
+    gauden_simd_t *simd = g->simd;
+    float64 out[GAUDEN_SIMD_BLOCK];
+    float32 *mean = simd->mean[mgau][feat];
+    float32 *var = simd->var[mgau][feat];
+    float32 *norm = simd->norm[mgau][feat];
+    float64 worst;
+    uint32 i, b, n;
+
+    worst = topn_init(den, den_idx, g->n_top, g->n_density, g->veclen[feat],
+		      obs, g->mean[mgau][feat], g->var[mgau][feat],
+		      g->norm[mgau][feat], prev_den_idx);
+
+    for (i = 0; i < g->n_density; i += GAUDEN_SIMD_BLOCK) {
+	if (!(*simd->eval_block)(out, obs, mean + i, var + i, norm + i,
+				 simd->stride, g->veclen[feat], TRUE, worst))
+	    continue;
+	n = g->n_density - i;
+	if (n > GAUDEN_SIMD_BLOCK)
+	    n = GAUDEN_SIMD_BLOCK;
+	for (b = 0; b < n; b++) {
+	    /* Written this way round so that NaNs are skipped, as in
+	     * log_topn_densities() */
+	    if (!(out[b] > worst))
+		continue;
+	    worst = topn_insert(den, den_idx, g->n_top, i + b, out[b]);
 	}
-	den_idx[k] = i;
-	den[k] = d;
+    }
+}
+
+static void
+log_densities_simd(float64 *den,
+		   uint32 *den_idx,
+		   gauden_t *g,
+		   uint32 mgau,
+		   uint32 feat,
+		   vector_t obs,
+		   uint32 *prev_den_idx)
+{
+    if (g->n_top == g->n_density)
+	log_full_densities_simd(den, den_idx, g, mgau, feat, obs);
+    else
+	log_topn_densities_simd(den, den_idx, g, mgau, feat, obs,
+				prev_den_idx);
+}
+
+/* Evaluate densities with the scalar code first (prev_den_idx may be
+ * the same array as den_idx), then with the vector code, and compare
+ * the two. */
+static void
+check_densities_simd(float64 *den,
+		     uint32 *den_idx,
+		     gauden_t *g,
+		     uint32 mgau,
+		     uint32 feat,
+		     vector_t obs,
+		     uint32 *prev_den_idx)
+{
+    float64 *ref;
+    uint32 *ref_idx;
+    uint32 j;
+
+    ref = ckd_calloc(g->n_top, sizeof(float64));
+    ref_idx = ckd_calloc(g->n_top, sizeof(uint32));
 
-	worst = den[n_top-1];
+    if (g->n_top == g->n_density) {
+	log_full_densities(ref, ref_idx, g->n_density, g->veclen[feat], obs,
+			   g->mean[mgau][feat], g->var[mgau][feat],
+			   g->norm[mgau][feat]);
     }
-    worst = den[n_top-1];
+    else {
+	log_topn_densities(ref, ref_idx, g->n_top, g->n_density,
+			   g->veclen[feat], obs,
+			   g->mean[mgau][feat], g->var[mgau][feat],
+			   g->norm[mgau][feat], prev_den_idx);
+    }
+    log_densities_simd(den, den_idx, g, mgau, feat, obs, prev_den_idx);
+
+    /* Densities within the tolerance of each other may come out in a
+     * different order, so only the values are compared. */
+    for (j = 0; j < g->n_top; j++) {
+	if (fabs(den[j] - ref[j]) > g->simd->tol) {
+	    E_FATAL("Codebook %u stream %u: %s density %u (%u) = %e, "
+		    "scalar density %u (%u) = %e\n",
+		    mgau, feat, gauden_simd_name(g->simd->type),
+		    j, den_idx[j], den[j], j, ref_idx[j], ref[j]);
+	}
+    }
+
+    ckd_free(ref);
+    ckd_free(ref_idx);
 }
 
 static void
@@ -1234,6 +1406,16 @@ gauden_compute_log(float64 **den,		/* density array for a mixture Gaussian */
 			       g->norm[mgau][j]);
 	}
     }
+    else if (g->simd) {
+	for (j = 0; j < g->n_feat; j++) {
+	    if (g->simd->tol > 0)
+		check_densities_simd(den[j], den_idx[j], g, mgau, j, obs[j],
+				     prev_den_idx ? prev_den_idx[j] : NULL);
+	    else
+		log_densities_simd(den[j], den_idx[j], g, mgau, j, obs[j],
+				   prev_den_idx ? prev_den_idx[j] : NULL);
+	}
+    }
     else if (g->n_top == g->n_density) {
 	for (j = 0; j < g->n_feat; j++) {
 	    log_full_densities(den[j],
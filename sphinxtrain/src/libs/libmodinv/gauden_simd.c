@@ -0,0 +1,407 @@
+/* -*- c-basic-offset: 4 -*- */
+/* ====================================================================
+ * Copyright (c) 2014 Carnegie Mellon University.  All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+/*********************************************************************
+ *
+ * File: gauden_simd.c
+ * 
+ * Description: 
+ *	Vectorized evaluation of diagonal Gaussian densities.  See
+ *	gauden_simd.h.
+ *
+ *********************************************************************/
+
+#include <s3/gauden_simd.h>
+
+#include <sphinxbase/err.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include <float.h>
+#include <string.h>
+
+/*
+ * On x86 every kernel is compiled with a function-specific target so
+ * the rest of the library does not require the instruction set, and
+ * the CPU is checked at run time.  Elsewhere only the scalar code in
+ * gauden.c is used.
+ */
+#if (defined(__x86_64__) || defined(__i386__))				\
+    && (defined(__clang__)						\
+	|| (defined(__GNUC__)						\
+	    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define GAUDEN_SIMD_X86
+#include <immintrin.h>
+#define GAUDEN_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/* Alignment of transposed codebooks, enough for AVX. */
+#define GAUDEN_SIMD_ALIGN 32
+
+#ifdef GAUDEN_SIMD_X86
+/*
+ * The differences are taken in float32 and everything else is done
+ * in float64, exactly like log_diag_eval() (partial == FALSE) and
+ * log_topn_densities() (partial == TRUE).  No fused multiply-add.
+ */
+GAUDEN_SIMD_TARGET("sse2")
+static int
+eval_block_sse2(float64 *out,
+		const float32 *obs,
+		const float32 *mean,
+		const float32 *var,
+		const float32 *norm,
+		uint32 stride,
+		uint32 veclen,
+		int partial,
+		float64 thresh)
+{
+    __m128d d0, d1, d2, d3, n0, n1, n2, n3;
+    __m128d x0, x1, x2, x3, v0, v1, v2, v3;
+    __m128 o, f, g;
+    uint32 l;
+
+    f = _mm_load_ps(norm);
+    g = _mm_load_ps(norm + 4);
+    n0 = _mm_cvtps_pd(f);
+    n1 = _mm_cvtps_pd(_mm_movehl_ps(f, f));
+    n2 = _mm_cvtps_pd(g);
+    n3 = _mm_cvtps_pd(_mm_movehl_ps(g, g));
+
+#define LOAD_DIFF_SSE2()						\
+    o = _mm_set1_ps(obs[l]);						\
+    f = _mm_sub_ps(o, _mm_load_ps(mean));				\
+    g = _mm_sub_ps(o, _mm_load_ps(mean + 4));				\
+    x0 = _mm_cvtps_pd(f);						\
+    x1 = _mm_cvtps_pd(_mm_movehl_ps(f, f));				\
+    x2 = _mm_cvtps_pd(g);						\
+    x3 = _mm_cvtps_pd(_mm_movehl_ps(g, g));				\
+    f = _mm_load_ps(var);						\
+    g = _mm_load_ps(var + 4);						\
+    v0 = _mm_cvtps_pd(f);						\
+    v1 = _mm_cvtps_pd(_mm_movehl_ps(f, f));				\
+    v2 = _mm_cvtps_pd(g);						\
+    v3 = _mm_cvtps_pd(_mm_movehl_ps(g, g));				\
+    mean += stride;							\
+    var += stride
+
+    if (partial) {
+	__m128d t = _mm_set1_pd(thresh);
+
+	d0 = n0;
+	d1 = n1;
+	d2 = n2;
+	d3 = n3;
+	for (l = 0; l < veclen; l++) {
+	    LOAD_DIFF_SSE2();
+	    /* d -= diff * diff * v[j] */
+	    d0 = _mm_sub_pd(d0, _mm_mul_pd(_mm_mul_pd(x0, x0), v0));
+	    d1 = _mm_sub_pd(d1, _mm_mul_pd(_mm_mul_pd(x1, x1), v1));
+	    d2 = _mm_sub_pd(d2, _mm_mul_pd(_mm_mul_pd(x2, x2), v2));
+	    d3 = _mm_sub_pd(d3, _mm_mul_pd(_mm_mul_pd(x3, x3), v3));
+	    /* Distances only decrease, so once the whole block is at
+	     * or below the threshold none of it can make the top N. */
+	    if ((l & 3) == 3) {
+		__m128d alive = _mm_or_pd(_mm_or_pd(_mm_cmpgt_pd(d0, t),
+						    _mm_cmpgt_pd(d1, t)),
+					  _mm_or_pd(_mm_cmpgt_pd(d2, t),
+						    _mm_cmpgt_pd(d3, t)));
+		if (_mm_movemask_pd(alive) == 0)
+		    return 0;
+	    }
+	}
+    }
+    else {
+	d0 = d1 = d2 = d3 = _mm_setzero_pd();
+	for (l = 0; l < veclen; l++) {
+	    LOAD_DIFF_SSE2();
+	    /* d += var_fact[l] * diff * diff */
+	    d0 = _mm_add_pd(d0, _mm_mul_pd(_mm_mul_pd(v0, x0), x0));
+	    d1 = _mm_add_pd(d1, _mm_mul_pd(_mm_mul_pd(v1, x1), x1));
+	    d2 = _mm_add_pd(d2, _mm_mul_pd(_mm_mul_pd(v2, x2), x2));
+	    d3 = _mm_add_pd(d3, _mm_mul_pd(_mm_mul_pd(v3, x3), x3));
+	}
+	d0 = _mm_sub_pd(n0, d0);
+	d1 = _mm_sub_pd(n1, d1);
+	d2 = _mm_sub_pd(n2, d2);
+	d3 = _mm_sub_pd(n3, d3);
+    }
+#undef LOAD_DIFF_SSE2
+
+    _mm_storeu_pd(out, d0);
+    _mm_storeu_pd(out + 2, d1);
+    _mm_storeu_pd(out + 4, d2);
+    _mm_storeu_pd(out + 6, d3);
+    return 1;
+}
+
+GAUDEN_SIMD_TARGET("avx2")
+static int
+eval_block_avx2(float64 *out,
+		const float32 *obs,
+		const float32 *mean,
+		const float32 *var,
+		const float32 *norm,
+		uint32 stride,
+		uint32 veclen,
+		int partial,
+		float64 thresh)
+{
+    __m256d d0, d1, n0, n1, x0, x1, v0, v1;
+    __m256 f;
+    uint32 l;
+
+    f = _mm256_load_ps(norm);
+    n0 = _mm256_cvtps_pd(_mm256_castps256_ps128(f));
+    n1 = _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1));
+
+#define LOAD_DIFF_AVX2()						\
+    f = _mm256_sub_ps(_mm256_set1_ps(obs[l]), _mm256_load_ps(mean));	\
+    x0 = _mm256_cvtps_pd(_mm256_castps256_ps128(f));			\
+    x1 = _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1));			\
+    f = _mm256_load_ps(var);						\
+    v0 = _mm256_cvtps_pd(_mm256_castps256_ps128(f));			\
+    v1 = _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1));			\
+    mean += stride;							\
+    var += stride
+
+    if (partial) {
+	__m256d t = _mm256_set1_pd(thresh);
+
+	d0 = n0;
+	d1 = n1;
+	for (l = 0; l < veclen; l++) {
+	    LOAD_DIFF_AVX2();
+	    d0 = _mm256_sub_pd(d0, _mm256_mul_pd(_mm256_mul_pd(x0, x0), v0));
+	    d1 = _mm256_sub_pd(d1, _mm256_mul_pd(_mm256_mul_pd(x1, x1), v1));
+	    if ((l & 3) == 3) {
+		__m256d alive = _mm256_or_pd(_mm256_cmp_pd(d0, t, _CMP_GT_OQ),
+					     _mm256_cmp_pd(d1, t, _CMP_GT_OQ));
+		if (_mm256_movemask_pd(alive) == 0)
+		    return 0;
+	    }
+	}
+    }
+    else {
+	d0 = d1 = _mm256_setzero_pd();
+	for (l = 0; l < veclen; l++) {
+	    LOAD_DIFF_AVX2();
+	    d0 = _mm256_add_pd(d0, _mm256_mul_pd(_mm256_mul_pd(v0, x0), x0));
+	    d1 = _mm256_add_pd(d1, _mm256_mul_pd(_mm256_mul_pd(v1, x1), x1));
+	}
+	d0 = _mm256_sub_pd(n0, d0);
+	d1 = _mm256_sub_pd(n1, d1);
+    }
+#undef LOAD_DIFF_AVX2
+
+    _mm256_storeu_pd(out, d0);
+    _mm256_storeu_pd(out + 4, d1);
+    return 1;
+}
+
+static int
+cpu_has(gauden_simd_type_t type)
+{
+    __builtin_cpu_init();
+    switch (type) {
+    case GAUDEN_SIMD_SSE2:
+	return __builtin_cpu_supports("sse2");
+    case GAUDEN_SIMD_AVX2:
+	return __builtin_cpu_supports("avx2");
+    default:
+	return FALSE;
+    }
+}
+#endif /* GAUDEN_SIMD_X86 */
+
+static const char *gauden_simd_names[] = {
+    "none", "sse2", "avx2"
+};
+
+int
+gauden_simd_parse(const char *name)
+{
+    int i;
+
+    for (i = 0; i < sizeof(gauden_simd_names) / sizeof(gauden_simd_names[0]); i++)
+	if (strcmp(name, gauden_simd_names[i]) == 0)
+	    return i;
+    return -1;
+}
+
+const char *
+gauden_simd_name(gauden_simd_type_t type)
+{
+    return gauden_simd_names[type];
+}
+
+int
+gauden_simd_supported(gauden_simd_type_t type)
+{
+    switch (type) {
+    case GAUDEN_SIMD_NONE:
+	return TRUE;
+#ifdef GAUDEN_SIMD_X86
+    case GAUDEN_SIMD_SSE2:
+    case GAUDEN_SIMD_AVX2:
+	return cpu_has(type);
+#endif
+    default:
+	return FALSE;
+    }
+}
+
+static gauden_simd_block_f
+gauden_simd_kernel(gauden_simd_type_t type)
+{
+    switch (type) {
+#ifdef GAUDEN_SIMD_X86
+    case GAUDEN_SIMD_SSE2:
+	return eval_block_sse2;
+    case GAUDEN_SIMD_AVX2:
+	return eval_block_avx2;
+#endif
+    default:
+	return NULL;
+    }
+}
+
+int
+gauden_simd_init(gauden_t *g,
+		 const char *name,
+		 float64 tol)
+{
+    gauden_simd_t *simd;
+    float32 *ptr;
+    size_t n_float;
+    uint32 i, j, k, l;
+    int type;
+
+    gauden_simd_free(g->simd);
+    g->simd = NULL;
+
+    if (g->fullvar)
+	return S3_SUCCESS;
+
+    if (name == NULL || strcmp(name, "auto") == 0) {
+	if (gauden_simd_supported(GAUDEN_SIMD_AVX2))
+	    type = GAUDEN_SIMD_AVX2;
+	else if (gauden_simd_supported(GAUDEN_SIMD_SSE2))
+	    type = GAUDEN_SIMD_SSE2;
+	else
+	    type = GAUDEN_SIMD_NONE;
+    }
+    else {
+	if ((type = gauden_simd_parse(name)) < 0) {
+	    E_WARN("Unknown SIMD kernel %s, using scalar code\n", name);
+	    return S3_SUCCESS;
+	}
+	if (!gauden_simd_supported(type)) {
+	    E_WARN("SIMD kernel %s not supported on this machine, "
+		   "using scalar code\n", name);
+	    return S3_SUCCESS;
+	}
+    }
+    if (type == GAUDEN_SIMD_NONE) {
+	E_INFO("Using scalar Gaussian evaluation\n");
+	return S3_SUCCESS;
+    }
+
+    simd = ckd_calloc(1, sizeof(*simd));
+    simd->type = type;
+    simd->eval_block = gauden_simd_kernel(type);
+    simd->n_mgau = g->n_mgau;
+    simd->n_feat = g->n_feat;
+    simd->n_density = g->n_density;
+    simd->stride = (g->n_density + GAUDEN_SIMD_BLOCK - 1)
+	/ GAUDEN_SIMD_BLOCK * GAUDEN_SIMD_BLOCK;
+    simd->tol = tol;
+
+    /* Every row is a multiple of GAUDEN_SIMD_BLOCK floats so aligning
+     * the first one aligns them all. */
+    n_float = 0;
+    for (j = 0; j < g->n_feat; j++)
+	n_float += (2 * g->veclen[j] + 1) * simd->stride;
+    n_float *= g->n_mgau;
+    simd->buf = ckd_calloc(n_float * sizeof(float32) + GAUDEN_SIMD_ALIGN, 1);
+    ptr = (float32 *)(((size_t)simd->buf + GAUDEN_SIMD_ALIGN - 1)
+		      & ~(size_t)(GAUDEN_SIMD_ALIGN - 1));
+
+    simd->mean = (float32 ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(float32 *));
+    simd->var = (float32 ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(float32 *));
+    simd->norm = (float32 ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(float32 *));
+    for (i = 0; i < g->n_mgau; i++) {
+	for (j = 0; j < g->n_feat; j++) {
+	    simd->mean[i][j] = ptr;
+	    ptr += g->veclen[j] * simd->stride;
+	    simd->var[i][j] = ptr;
+	    ptr += g->veclen[j] * simd->stride;
+	    simd->norm[i][j] = ptr;
+	    ptr += simd->stride;
+
+	    for (k = 0; k < g->n_density; k++) {
+		for (l = 0; l < g->veclen[j]; l++) {
+		    simd->mean[i][j][l * simd->stride + k] = g->mean[i][j][k][l];
+		    simd->var[i][j][l * simd->stride + k] = g->var[i][j][k][l];
+		}
+		simd->norm[i][j][k] = g->norm[i][j][k];
+	    }
+	    /* Padding densities have zero mean and precision, and
+	     * score lower than any real one. */
+	    for (; k < simd->stride; k++)
+		simd->norm[i][j][k] = -FLT_MAX;
+	}
+    }
+    g->simd = simd;
+
+    E_INFO("Using %s Gaussian evaluation (%d densities per block)\n",
+	   gauden_simd_name(type), GAUDEN_SIMD_BLOCK);
+    if (tol > 0)
+	E_INFO("Checking against scalar evaluation, tolerance %e\n", tol);
+
+    return S3_SUCCESS;
+}
+
+void
+gauden_simd_free(gauden_simd_t *simd)
+{
+    if (simd == NULL)
+	return;
+    ckd_free_2d((void **)simd->mean);
+    ckd_free_2d((void **)simd->var);
+    ckd_free_2d((void **)simd->norm);
+    ckd_free(simd->buf);
+    ckd_free(simd);
+}
@@ -570,6 +570,101 @@ accum_global(model_inventory_t *inv,
     return S3_SUCCESS;
 }
 
+/*********************************************************************
+ *
+ * Function: 
+ *	accum_merge
+ * 
+ * Description: 
+ *	Add the global reestimation sums of one model inventory (e.g.
+ *	those of a worker thread, which shares its parameters with the
+ *	main inventory) into another, then clear them.
+ * 
+ * Function Inputs: 
+ *	model_inventory_t *inv -
+ *		The inventory whose sums are to be updated.
+ *	model_inventory_t *src -
+ *		The inventory whose sums are to be added and cleared.
+ * 
+ * Global Inputs: 
+ *	None
+ * 
+ * Return Values: 
+ *	None
+ * 
+ * Global Outputs: 
+ *	None
+ * 
+ *********************************************************************/
+void
+accum_merge(model_inventory_t *inv,
+	    model_inventory_t *src,
+	    int32 mixw_reest,
+	    int32 tmat_reest,
+	    int32 mean_reest,
+	    int32 var_reest,
+	    int32 var_is_full)
+{
+    gauden_t *g, *src_g;
+    uint32 i, j, k, l, ll;
+
+    g = inv->gauden;
+    src_g = src->gauden;
+
+    if (mixw_reest) {
+	for (i = 0; i < inv->n_mixw; i++) {
+	    for (j = 0; j < gauden_n_feat(g); j++) {
+		for (k = 0; k < gauden_n_density(g); k++) {
+		    inv->mixw_acc[i][j][k] += src->mixw_acc[i][j][k];
+		    src->mixw_acc[i][j][k] = 0;
+		}
+	    }
+	}
+    }
+
+    if (tmat_reest) {
+	for (i = 0; i < inv->n_tmat; i++) {
+	    for (j = 0; j < inv->n_state_pm-1; j++) {
+		for (k = 0; k < inv->n_state_pm; k++) {
+		    inv->tmat_acc[i][j][k] += src->tmat_acc[i][j][k];
+		    src->tmat_acc[i][j][k] = 0;
+		}
+	    }
+	}
+    }
+
+    if (!mean_reest && !var_reest)
+	return;
+
+    for (i = 0; i < gauden_n_mgau(g); i++) {
+	for (j = 0; j < gauden_n_feat(g); j++) {
+	    for (k = 0; k < gauden_n_density(g); k++) {
+		for (l = 0; l < g->veclen[j]; l++) {
+		    if (mean_reest) {
+			g->macc[i][j][k][l] += src_g->macc[i][j][k][l];
+			src_g->macc[i][j][k][l] = 0;
+		    }
+		    if (var_reest && var_is_full) {
+			for (ll = 0; ll < g->veclen[j]; ll++) {
+			    g->fullvacc[i][j][k][l][ll]
+				+= src_g->fullvacc[i][j][k][l][ll];
+			    src_g->fullvacc[i][j][k][l][ll] = 0;
+			}
+		    }
+		    else if (var_reest) {
+			g->vacc[i][j][k][l] += src_g->vacc[i][j][k][l];
+			src_g->vacc[i][j][k][l] = 0;
+		    }
+		}
+		if (g->dnom) {
+		    g->dnom[i][j][k] += src_g->dnom[i][j][k];
+		    src_g->dnom[i][j][k] = 0;
+		}
+	    }
+	}
+    }
+}
+
 /*********************************************************************
  *
  * Function: 
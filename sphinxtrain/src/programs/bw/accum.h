@@ -88,6 +88,15 @@ accum_global(model_inventory_t *inv,
 	     int32 var_reest,
 	     int32 var_is_full);
 
+void
+accum_merge(model_inventory_t *inv,
+	    model_inventory_t *src,
+	    int32 mixw_reest,
+	    int32 tmat_reest,
+	    int32 mean_reest,
+	    int32 var_reest,
+	    int32 var_is_full);
+
 int32
 accum_dump(const char *out_dir,
 	   model_inventory_t *inv,
@@ -59,12 +59,14 @@
 
 #include "accum.h"
 #include "baum_welch.h"
+#include "forward.h"
 
 #include <assert.h>
 #include <math.h>
 #include <string.h>
 
 #define S2_ALPHA_BETA_EPSILON	0.01
+#define INACTIVE		0xffffffff
 
 void
 partial_op(float64 *p_op,
@@ -226,6 +228,10 @@ den_terms(float64 **d_term,
  *		A 2-d array containing the scaled alpha variable.
  *		alpha[t][s] is scaled alpha at time t for state s.
  *
+ *	fwd_ckpt_t *ckpt -
+ *		Checkpoints from forward(), used to recompute the alphas
+ *		it did not keep, or NULL if it kept all of them.
+ *
  *	float64 *scale -
  *		The scale factor for each time frame.
  * 
@@ -290,6 +296,10 @@ den_terms(float64 **d_term,
  *		A boolean indicating whether or not to do variance
  *		reestimation.
  *
+ *	bw_utt_stats_t *stats -
+ *		If not NULL, where to record the average number of
+ *		active and reestimated states.
+ *
  * Global Inputs: 
  *	None
  * 
@@ -310,6 +320,7 @@ int32
 backward_update(float64 **active_alpha,
 		uint32 **active_astate,
 		uint32 *n_active_astate,
+		fwd_ckpt_t *ckpt,
 		float64 *scale,
 		float64 **dscale,
 		vector_t **feature,
@@ -327,7 +338,8 @@ backward_update(float64 **active_alpha,
 		int32 var_is_full,
 		FILE *pdumpfh,
 		bw_timers_t *timers,
-                feat_t *fcb)
+                feat_t *fcb,
+		bw_utt_stats_t *stats)
 {
     void *tt;			/* temp variable used to do
 				   pointer swapping */
@@ -341,6 +353,7 @@ backward_update(float64 **active_alpha,
     uint32 *tmp_non_emit;	/* list of active non-emitting states after pruning */
     uint32 n_tmp_non_emit;
     uint32 *active;	/* the active list for time t */
+    uint32 *amap;	/* sentence HMM state to active_astate[t] index */
     uint32 n_active;	/* the # of active states */
     uint32 *active_cb;
     uint32 *next_active; /* the active list for time t-1 */
@@ -388,11 +401,11 @@ backward_update(float64 **active_alpha,
     float64 p_reest_term;
     float64 post_j;
     float64 sum_reest_post_j = 0.0;
-    static float64 *p_op = NULL;
-    static float64 *p_ci_op = NULL;
+    float64 *p_op;
+    float64 *p_ci_op;
     float64 op;
-    static float64 **d_term = NULL;
-    static float64 **d_term_ci = NULL;
+    float64 **d_term;
+    float64 **d_term_ci;
 
     uint32 n_feat;
     uint32 n_density;
@@ -431,15 +444,12 @@ backward_update(float64 **active_alpha,
     n_density = gauden_n_density(g);
     n_top = gauden_n_top(g);
 
-    if (p_op == NULL) {
-	p_op    = ckd_calloc(n_feat, sizeof(float64));
-	p_ci_op = ckd_calloc(n_feat, sizeof(float64));
-    }
+    /* Not static, so that several utterances can be done at once */
+    p_op    = ckd_calloc(n_feat, sizeof(float64));
+    p_ci_op = ckd_calloc(n_feat, sizeof(float64));
 
-    if (d_term == NULL) {
-	d_term    = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
-	d_term_ci = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
-    }
+    d_term    = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
+    d_term_ci = (float64 **)ckd_calloc_2d(n_feat, n_top, sizeof(float64));
 
     /* Allocate space for source/destination beta */
     beta_a = ckd_calloc(n_state, sizeof(float64));
@@ -454,6 +464,10 @@ backward_update(float64 **active_alpha,
     active_b = ckd_calloc(n_state, sizeof(uint32));
     active_cb = ckd_calloc(2*n_state, sizeof(uint32));
 
+    /* All states are inactive until their frame comes up */
+    amap = ckd_malloc(n_state * sizeof(uint32));
+    memset(amap, 0xff, n_state * sizeof(uint32));
+
     /* count up the max possible number of active non-emitting states */
     n_non_emit = 0;
     for (s = 0; s < n_state; s++)
@@ -572,6 +586,9 @@ backward_update(float64 **active_alpha,
 #if BACKWARD_DEBUG
     E_INFO("Before updating non-emitting states\n");
 #endif
+    for (q = 0; q < n_active_astate[t]; q++)
+	amap[active_astate[t][q]] = q;
+
     /* Process non-emitting initial states first */
     for (s = 0; s < n_non_emit; s++) {
 	j = non_emit[s];
@@ -589,8 +606,7 @@ backward_update(float64 **active_alpha,
 #if BACKWARD_DEBUG
 	    E_INFO("Processing non-emitting state %d, prior %d\n",j, i);
 #endif
-	    for (q = 0; q < n_active_astate[t] && active_astate[t][q] != i; q++);
-	    if (q == n_active_astate[t]) {
+	    if ((q = amap[i]) == INACTIVE) {
 		/* state i not active in forward pass; skip it */
 		continue;
 	    }
@@ -651,6 +667,18 @@ backward_update(float64 **active_alpha,
 	    goto free;
 	}
 
+	/* Bring back the alphas for time t if they were not kept,
+	 * and look them up by state instead of those for t+1 */
+	for (q = 0; q < n_active_astate[t+1]; q++)
+	    amap[active_astate[t+1][q]] = INACTIVE;
+	if (forward_recompute(ckpt, t, active_alpha,
+			      active_astate, n_active_astate) != S3_SUCCESS) {
+	    retval = S3_ERROR;
+	    goto free;
+	}
+	for (q = 0; q < n_active_astate[t]; q++)
+	    amap[active_astate[t][q]] = q;
+
 	n_active_cb = 0;
 
 	/* zero beta at time t */
@@ -761,9 +789,7 @@ backward_update(float64 **active_alpha,
 #if BACKWARD_DEBUG	
 		E_INFO("For active state %d , state %d is its prior\n",j,i);
 #endif
-		for (q = 0; q < n_active_astate[t] &&
-			 active_astate[t][q] != i; q++);
-		if (q == n_active_astate[t]) {
+		if ((q = amap[i]) == INACTIVE) {
 		    /* state i not active in forward pass; skip it */
 		    continue;
 		}
@@ -955,9 +981,7 @@ backward_update(float64 **active_alpha,
 	for (s = 0, n_active = 0, pprob = 0; s < n_next_active; s++) {
 	    i = next_active[s];
 
-	    for (q = 0; q < n_active_astate[t] &&
-		     active_astate[t][q] != i; q++);
-	    if (q == n_active_astate[t]) {
+	    if ((q = amap[i]) == INACTIVE) {
 		/* state i not active in forward pass; skip it */
 		continue;
 	    }
@@ -977,9 +1001,7 @@ backward_update(float64 **active_alpha,
 	for (s = 0, n_tmp_non_emit = 0; s < n_non_emit; s++) {
 	    i = non_emit[s];
 
-	    for (q = 0; q < n_active_astate[t] &&
-		     active_astate[t][q] != i; q++);
-	    if (q == n_active_astate[t]) {
+	    if ((q = amap[i]) == INACTIVE) {
 		/* state i not active in forward pass; skip it */
 		continue;
 	    }
@@ -1032,9 +1054,7 @@ backward_update(float64 **active_alpha,
 	    for (u = 0; u < state_seq[j].n_prior; u++) {
 		i = prior[u];
 
-		for (q = 0; q < n_active_astate[t] &&
-			 active_astate[t][q] != i; q++);
-		if (q == n_active_astate[t]) {
+		if ((q = amap[i]) == INACTIVE) {
 		    /* state i not active in forward pass; skip it */
 		    continue;
 		}
@@ -1267,15 +1287,19 @@ backward_update(float64 **active_alpha,
 	    ptmr_stop(&timers->rstf_timer);
     }
 
-    printf(" %d", n_active_tot / n_obs);
-    printf(" %d", n_reest_tot / n_obs);
-    printf(" %e", t_pprob / n_obs);
+    if (stats) {
+	stats->bwd_done = TRUE;
+	stats->n_beta_active = n_active_tot / n_obs;
+	stats->n_reest = n_reest_tot / n_obs;
+	stats->pprob = t_pprob / n_obs;
+    }
 
 free:
 
     ckd_free(active_a);
     ckd_free(active_b);
     ckd_free(active_cb);
+    ckd_free(amap);
     ckd_free(non_emit);
     ckd_free(tmp_non_emit);
     ckd_free(asf_a);
@@ -1291,5 +1315,10 @@ free:
     ckd_free_3d((void ***)now_den);
     ckd_free_3d((void ***)now_den_idx);
 
+    ckd_free(p_op);
+    ckd_free(p_ci_op);
+    ckd_free_2d((void **)d_term);
+    ckd_free_2d((void **)d_term_ci);
+
     return (retval);
 }
@@ -54,11 +54,13 @@
 #include <s3/model_inventory.h>
 
 #include "baum_welch.h"
+#include "forward.h"
 
 int32
 backward_update(float64 **active_alpha,
 		uint32 **active_astate,
 		uint32 *n_active_astate,
+		fwd_ckpt_t *ckpt,
 		float64 *scale,
 		float64 **dscale,
 		vector_t **feature,
@@ -76,7 +78,8 @@ backward_update(float64 **active_alpha,
 		int32 var_is_full,
 		FILE *pdumpfn,
 		bw_timers_t *timers,
-		feat_t *fcb);
+		feat_t *fcb,
+		bw_utt_stats_t *stats);
 
 void
 partial_op(float64 *p_op,
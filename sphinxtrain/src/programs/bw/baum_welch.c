@@ -118,6 +118,15 @@
  *      s3phseg_t *phseg -
  *              An optional phone segmentation to use to constrain the
  *              forward lattice.
+ *
+ *	const char *uttid -
+ *		The name of the utterance, used for the -outphsegdir
+ *		file and in error messages.
+ *
+ *	bw_utt_stats_t *stats -
+ *		If not NULL, where to record the per-utterance state
+ *		statistics, for the caller to print.
+ *
  * Global Inputs: 
  *	None
  * 
@@ -147,7 +156,9 @@ baum_welch_update(float64 *log_forw_prob,
 		  int32 var_is_full,
 		  FILE *pdumpfh,
 		  bw_timers_t *timers,
-		  feat_t *fcb)
+		  feat_t *fcb,
+		  const char *uttid,
+		  bw_utt_stats_t *stats)
 {
     float64 *scale = NULL;
     float64 **dscale = NULL;
@@ -155,6 +166,8 @@ baum_welch_update(float64 *log_forw_prob,
     uint32 **active_astate;
     uint32 **bp;
     uint32 *n_active_astate;
+    fwd_ckpt_t *ckpt = NULL;
+    uint32 ckpt_intv = 0;
     float64 log_fp;	/* accumulator for the log of the probability
 			 * of observing the input given the model */
     uint32 t;		/* time */
@@ -173,6 +186,17 @@ baum_welch_update(float64 *log_forw_prob,
     active_astate = (uint32 **)ckd_calloc(n_obs, sizeof(uint32 *));
     bp = (uint32 **)ckd_calloc(n_obs, sizeof(uint32 *));
 
+    /* Backpointers are only needed to write a phone segmentation,
+     * which also needs all the alphas.  Otherwise, for long
+     * utterances, keep only every sqrt(n_obs)'th frame of them. */
+    if (cmd_ln_str("-outphsegdir") == NULL) {
+	ckd_free(bp);
+	bp = NULL;
+	if (cmd_ln_int32("-alphackpt") > 0
+	    && n_obs > (uint32)cmd_ln_int32("-alphackpt"))
+	    ckpt_intv = (uint32)ceil(sqrt((float64)n_obs));
+    }
+
     /* Compute the scaled alpha variable and scale factors
      * for all states and time subject to the pruning constraints */
     if (timers)
@@ -185,7 +209,8 @@ baum_welch_update(float64 *log_forw_prob,
     ret = forward(active_alpha, active_astate, n_active_astate, bp,
 		  scale, dscale,
 		  feature, n_obs, state, n_state,
-		  inv, a_beam, phseg, timers, 0);
+		  inv, a_beam, phseg, timers, stats,
+		  ckpt_intv, &ckpt);
 
 #if BW_DEBUG
     for (i=0 ; i < n_obs;i++){
@@ -202,11 +227,9 @@ baum_welch_update(float64 *log_forw_prob,
     /* Dump a phoneme segmentation if requested */
     if (cmd_ln_str("-outphsegdir")) {
 	    const char *phsegdir;
-	    char *segfn, *uttid;
+	    char *segfn;
 
 	    phsegdir = cmd_ln_str("-outphsegdir");
-	    uttid = (cmd_ln_int32("-outputfullpath")
-		     ? corpus_utt_full_name() : corpus_utt());
 	    segfn = ckd_calloc(strlen(phsegdir) + 1
 			       + strlen(uttid)
 			       + strlen(".phseg") + 1, 1);
@@ -239,12 +262,13 @@ baum_welch_update(float64 *log_forw_prob,
     E_INFO("Before Backward search\n");
 #endif
 
-    ret = backward_update(active_alpha, active_astate, n_active_astate, scale, dscale,
+    ret = backward_update(active_alpha, active_astate, n_active_astate, ckpt,
+			  scale, dscale,
 			  feature, n_obs,
 			  state, n_state,
 			  inv, b_beam, spthresh,
 			  mixw_reest, tmat_reest, mean_reest, var_reest, pass2var,
-			  var_is_full, pdumpfh, timers, fcb);
+			  var_is_full, pdumpfh, timers, fcb, stats);
     if (timers)
 	ptmr_stop(&timers->bwd_timer);
 
@@ -288,13 +312,15 @@ baum_welch_update(float64 *log_forw_prob,
 
     *log_forw_prob = log_fp;
 
+    forward_ckpt_free(ckpt);
     ckd_free((void *)scale);
     ckd_free(n_active_astate);
     for (i = 0; i < n_obs; i++) {
 	ckd_free((void *)active_alpha[i]);
 	ckd_free((void *)active_astate[i]);
 	ckd_free((void *)dscale[i]);
-	ckd_free((void *)bp[i]);
+	if (bp)
+	    ckd_free((void *)bp[i]);
     }
     ckd_free((void *)active_alpha);
     ckd_free((void *)active_astate);
@@ -304,6 +330,7 @@ baum_welch_update(float64 *log_forw_prob,
     return S3_SUCCESS;
 
 error:
+    forward_ckpt_free(ckpt);
     ckd_free((void *)scale);
     for (i = 0; i < n_obs; i++) {
 	if (dscale[i])
@@ -315,13 +342,26 @@ error:
     for (i = 0; i < n_obs; i++) {
 	ckd_free((void *)active_alpha[i]);
 	ckd_free((void *)active_astate[i]);
-	ckd_free((void *)bp[i]);
+	if (bp)
+	    ckd_free((void *)bp[i]);
     }
     ckd_free((void *)active_alpha);
     ckd_free((void *)active_astate);
     ckd_free(bp);
 
-    E_ERROR("%s ignored\n", corpus_utt_brief_name());
+    E_ERROR("%s ignored\n", uttid);
 
     return S3_ERROR;
 }
+
+void
+bw_utt_stats_print(bw_utt_stats_t *stats)
+{
+    if (stats->fwd_done)
+	printf(" %u ", stats->n_alpha_active);
+    if (stats->bwd_done) {
+	printf(" %d", stats->n_beta_active);
+	printf(" %d", stats->n_reest);
+	printf(" %e", stats->pprob);
+    }
+}
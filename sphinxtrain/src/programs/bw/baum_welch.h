@@ -74,6 +74,25 @@ typedef struct {
     ptmr_t rstu_timer;
 } bw_timers_t;
 
+/**
+ * \struct bw_utt_stats_s
+ *
+ * Statistics of the forward and backward passes over an utterance,
+ * which are printed on its utt> line.
+ */
+typedef struct {
+    int32 fwd_done;		/**< Set if the forward pass succeeded */
+    uint32 n_alpha_active;	/**< Average # of active states in it */
+    int32 bwd_done;		/**< Set if the backward pass succeeded */
+    uint32 n_beta_active;	/**< Average # of active states in it */
+    uint32 n_reest;		/**< Average # of states reestimated */
+    float64 pprob;		/**< Average pruned posterior probability */
+} bw_utt_stats_t;
+
+/* Print the statistics of the passes which succeeded to stdout */
+void
+bw_utt_stats_print(bw_utt_stats_t *stats);
+
 
 int32
 baum_welch_update(float64 *log_forw_prob,
@@ -94,6 +113,8 @@ baum_welch_update(float64 *log_forw_prob,
 		  int32 var_is_full,
 		  FILE *pdumpfh,
 		  bw_timers_t *timers,
-		  feat_t *fcb);
+		  feat_t *fcb,
+		  const char *uttid,
+		  bw_utt_stats_t *stats);
 
 #endif /* BAUM_WELCH_H */ 
@@ -61,6 +61,7 @@
 #include <string.h>
 
 #include "baum_welch.h"
+#include "forward.h"
 
 #define FORWARD_DEBUG 0
 #define INACTIVE	0xffff
@@ -152,6 +153,23 @@
  *              An optional phone segmentation to use to constrain the
  *              forward lattice.
  *
+ *	bw_utt_stats_t *stats -
+ *		If not NULL, where to record the average number of
+ *		active states.
+ *
+ *	uint32 ckpt_intv -
+ *		If non-zero, keep alpha only for every ckpt_intv'th
+ *		frame (and the last one), along with what is needed to
+ *		restart the forward pass there.  The other frames of
+ *		active_alpha[] and active_astate[] are freed and set to
+ *		NULL, and forward_recompute() restores them on demand.
+ *		Ignored if bp is non-NULL.
+ *
+ *	fwd_ckpt_t **out_ckpt -
+ *		On successful return, the checkpoints, to be passed to
+ *		forward_recompute() and freed with forward_ckpt_free(),
+ *		or NULL if none were taken.
+ *
  * Global Inputs: 
  * 	None
  *
@@ -176,6 +194,486 @@
  *
  *********************************************************************/
 
+/* Everything needed to run the forward pass one frame at a time, and
+ * to restart it from a checkpoint frame. */
+struct fwd_ckpt_s {
+    /* The utterance and the model */
+    vector_t **feature;
+    uint32 n_obs;
+    state_t *state_seq;
+    uint32 n_state;
+    model_inventory_t *inv;
+    float64 beam;
+    bw_timers_t *timers;
+
+    /* Scratch areas for a frame */
+    uint32 *next_active;	/* active states for time t (before pruning) */
+    uint32 *active_l_cb;	/* active (local) codebooks for time t */
+    uint16 *amap;		/* sentence HMM state to active list index */
+    float64 *outprob;		/* output probabilities for time t */
+    float64 *best_pred;		/* best predecessor scores (for bp) */
+    uint32 aalpha_alloc;
+    float64 ***now_den;		/* density values for time t */
+    uint32 ***now_den_idx;	/* density indices for time t */
+    uint32 n_l_cb;		/* # of distinct codebooks in the utterance */
+    int32 *acbframe;		/* frame in which a codebook was last active */
+
+    /* Checkpoints, every intv frames (or none if intv == 0) */
+    uint32 intv;
+    s3phseg_t **phseg;		/* phone segment at each checkpoint */
+    uint32 **den_idx;		/* top-N densities at each checkpoint
+				   (semi-continuous models only) */
+    uint32 block;		/* first frame of the recomputed block,
+				   or n_obs if there is none */
+};
+
+static int32
+forward_frame(fwd_ckpt_t *f,
+	      uint32 t,
+	      float64 **active_alpha,
+	      uint32 **active_astate,
+	      uint32 *n_active_astate,
+	      uint32 **bp,
+	      float64 *out_scale,
+	      float64 **out_dscale,
+	      s3phseg_t *phseg)
+{
+    uint32 i, j, s, u;
+    uint32 l_cb;
+    uint32 *active;
+    uint32 n_active;
+    uint32 n_active_l_cb;
+    uint32 *next_active;
+    uint32 n_next_active;
+    uint16 *amap;
+    uint32 *next;
+    float32 *tprob;
+    float64 prior_alpha;
+    float32 ***mixw;
+    gauden_t *g;
+    acmod_set_t *as;
+    state_t *state_seq;
+    float64 x;
+    float64 pthresh = 1e-300;
+    float64 balpha;
+    float64 scale;
+    float64 ***now_den;
+    uint32 ***now_den_idx;
+    float64 *outprob;
+    float64 *best_pred;
+    /* Can we prune this frame using phseg? */
+    int can_prune_phseg;
+
+    g = f->inv->gauden;
+    as = f->inv->mdef->acmod_set;
+    mixw = f->inv->mixw;
+    state_seq = f->state_seq;
+    now_den = f->now_den;
+    now_den_idx = f->now_den_idx;
+    outprob = f->outprob;
+    best_pred = f->best_pred;
+    amap = f->amap;
+    next_active = f->next_active;
+    n_next_active = 0;
+    n_active_l_cb = 0;
+
+    /* The active states at the previous frame */
+    active = active_astate[t-1];
+    n_active = n_active_astate[t-1];
+
+    /* assume next active state set about the same size as current;
+       adjust to actual size as necessary later */
+    active_alpha[t] = (float64 *)ckd_calloc(n_active, sizeof(float64));
+    if (bp) {
+	bp[t] = (uint32 *)ckd_calloc(n_active, sizeof(uint32));
+	/* reallocate the best score array and zero it out */
+	if (n_active > f->aalpha_alloc)
+	    best_pred = (float64 *)ckd_realloc(best_pred, n_active * sizeof(float64));
+	memset(best_pred, 0, n_active * sizeof(float64));
+    }
+    f->aalpha_alloc = n_active;
+
+    /* For all active states at the previous frame, activate their
+       successors in this frame and compute codebooks. */
+    /* (these are pre-computed so they can be scaled to avoid underflows) */
+    for (s = 0; s < n_active; s++) {
+	i = active[s];
+#if FORWARD_DEBUG
+	E_INFO("At time %d, In Gaussian computation, active state %d\n",t, i);
+#endif
+	/* get list of states adjacent to active state i */
+	next = state_seq[i].next_state;	
+
+	/* activate them all, computing their codebook densities if necessary */
+	for (u = 0; u < state_seq[i].n_next; u++) {
+	    j = next[u];
+#if FORWARD_DEBUG
+	    E_INFO("In Gaussian computation, active state %d, next state %d\n", i,j);
+#endif
+	    if (state_seq[j].mixw != TYING_NON_EMITTING) {
+		if (amap[j] == INACTIVE) {
+		    l_cb = state_seq[j].l_cb;
+			
+		    if (f->acbframe[l_cb] != t) {
+			/* Component density values not yet computed */
+			if (f->timers)
+			    ptmr_start(&f->timers->gau_timer);
+			gauden_compute_log(now_den[l_cb],
+					   now_den_idx[l_cb],
+					   f->feature[t],
+					   g,
+					   state_seq[j].cb,
+					   /* Preinitializing topn
+					      only really makes a
+					      difference for
+					      semi-continuous
+					      (n_l_cb == 1)
+					      models. */
+					   f->n_l_cb == 1
+					   ? now_den_idx[l_cb] : NULL);
+
+			f->active_l_cb[n_active_l_cb++] = l_cb;
+			f->acbframe[l_cb] = t;
+
+			if (f->timers)
+			    ptmr_stop(&f->timers->gau_timer);
+		    }
+
+		    /* Put next state j into the active list */
+		    amap[j] = n_next_active;
+
+		    /* Initialize the alpha variable to zero */
+		    active_alpha[t][n_next_active] = 0;
+
+		    /* Map active state list index to sentence HMM index */
+		    next_active[n_next_active] = j;
+
+		    ++n_next_active;
+
+		    if (n_next_active == f->aalpha_alloc) {
+			/* Need to reallocate the active_alpha array */
+			f->aalpha_alloc += ACHK;
+			active_alpha[t] = ckd_realloc(active_alpha[t],
+						      sizeof(float64) * f->aalpha_alloc);
+			/* And the backpointer array */
+			if (bp) {
+			    bp[t] = ckd_realloc(bp[t],
+						sizeof(uint32) * f->aalpha_alloc);
+			    /* And the best score array */
+			    best_pred = (float64 *)ckd_realloc(best_pred,
+							       sizeof(float64) * f->aalpha_alloc);
+			    /* Make sure the new stuff is zero */
+			    memset(bp[t] + f->aalpha_alloc - ACHK,
+				   0, sizeof(uint32) * ACHK);
+			    memset(best_pred + f->aalpha_alloc - ACHK,
+				   0, sizeof(float64) * ACHK);
+			}
+		    }
+		}
+	    }
+	}
+    }
+
+    /* Cope w/ numerical issues by dividing densities by max density */
+    *out_dscale = gauden_scale_densities_fwd(now_den, now_den_idx,
+					     f->active_l_cb, n_active_l_cb, g);
+	
+    /* Now, for all active states in the previous frame, compute
+       alpha for all successors in this frame. */
+    for (s = 0; s < n_active; s++) {
+	i = active[s];
+	    
+#if FORWARD_DEBUG
+	E_INFO("At time %d, In real state alpha update, active state %d\n",t, i);
+#endif
+	/* get list of states adjacent to active state i */
+	next = state_seq[i].next_state;	
+	/* get the associated transition probs */
+	tprob = state_seq[i].next_tprob;
+
+	/* the scaled alpha value for i at t-1 */
+	prior_alpha = active_alpha[t-1][s];
+
+	/* For all emitting states j adjacent to i, update their
+	 * alpha values.  */
+	for (u = 0; u < state_seq[i].n_next; u++) {
+	    j = next[u];
+#if FORWARD_DEBUG
+	    E_INFO("In real state update, active state %d, next state %d\n", i,j);
+#endif
+	    l_cb = state_seq[j].l_cb;
+
+	    if (state_seq[j].mixw != TYING_NON_EMITTING) {
+		/* Next state j is an emitting state */
+		outprob[j] = gauden_mixture(now_den[l_cb],
+					    now_den_idx[l_cb],
+					    mixw[state_seq[j].mixw],
+					    g);
+
+
+		/* update backpointers bp[t][j] */
+		x = prior_alpha * tprob[u];
+		if (bp) {
+		    if (x > best_pred[amap[j]]) {
+#if FORWARD_DEBUG
+			E_INFO("In real state update, backpointer %d => %d updated from %e to (%e * %e = %e)\n",
+			       i, j, best_pred[amap[j]], prior_alpha, tprob[u], x);
+#endif
+			best_pred[amap[j]] = x;
+			bp[t][amap[j]] = s;
+		    }
+		}
+		    
+		/* update the unscaled alpha[t][j] */
+		active_alpha[t][amap[j]] += x * outprob[j];
+	    }
+	    else {
+		/* already done below in the prior time frame */
+	    }
+	}
+    }
+
+#if FORWARD_DEBUG
+    if (bp) {
+	for (s = 0; s < n_next_active; ++s) {
+	    j = next_active[s];
+	    E_INFO("After real state update, best path to %d(%d) = %d(%d)\n",
+		   j, amap[j], active[bp[t][s]], bp[t][s]);
+	}
+    }
+#endif
+    /* Now, for all active states in this frame, consume any
+       following non-emitting states (multiplying in their
+       transition probabilities)  */
+    for (s = 0; s < n_next_active; s++) {
+	i = next_active[s];
+
+	/* find the successor states */
+	next = state_seq[i].next_state;
+	tprob = state_seq[i].next_tprob;
+
+	for (u = 0; u < state_seq[i].n_next; u++) {
+	    j = next[u];
+	    /* for any non-emitting ones */
+	    if (state_seq[j].mixw == TYING_NON_EMITTING) {
+#if FORWARD_DEBUG
+		E_INFO("In non-emitting state update, active state %d, next state %d\n",i,j);
+#endif
+		x = active_alpha[t][s] * tprob[u];
+
+#if FORWARD_DEBUG
+		E_INFO("In non-emitting state update, active_alpha[t][s]: %f,tprob[u]:  %f\n",active_alpha[t][s],tprob[u]);
+#endif
+		/* activate this state if necessary */
+		if (amap[j] == INACTIVE) {
+		    amap[j] = n_next_active;
+		    active_alpha[t][n_next_active] = 0;
+		    next_active[n_next_active] = j;
+		    ++n_next_active;
+
+		    if (n_next_active == f->aalpha_alloc) {
+			f->aalpha_alloc += ACHK;
+			active_alpha[t] = ckd_realloc(active_alpha[t],
+						      sizeof(float64) * f->aalpha_alloc);
+			if (bp) {
+			    bp[t] = ckd_realloc(bp[t],
+						sizeof(uint32) * f->aalpha_alloc);
+			    best_pred = (float64 *)ckd_realloc(best_pred,
+							       sizeof(float64) * f->aalpha_alloc);
+			    memset(bp[t] + f->aalpha_alloc - ACHK,
+				   0, sizeof(uint32) * ACHK);
+			    memset(best_pred + f->aalpha_alloc - ACHK,
+				   0, sizeof(float64) * ACHK);
+			}
+		    }
+		    if (bp) {
+			/* Give its backpointer a default value */
+			bp[t][amap[j]] = s;
+			best_pred[amap[j]] = x;
+		    }
+		}
+
+		/* update backpointers bp[t][j] */
+		if (bp && x > best_pred[amap[j]]) {
+		    bp[t][amap[j]] = s;
+		    best_pred[amap[j]] = x;
+		}
+		/* update its alpha value */
+		active_alpha[t][amap[j]] += x;
+	    }
+	}
+    }
+    f->best_pred = best_pred;
+
+#if FORWARD_DEBUG
+    for (s = 0; s < n_next_active; ++s) {
+	j = next_active[s];
+	if (bp && state_seq[j].mixw == TYING_NON_EMITTING) {
+	    E_INFO("After non-emitting state update, best path to %d(%d) = %d(%d)\n",
+		   j, amap[j], next_active[bp[t][s]], bp[t][s]);
+	    /* Assumptions about topology that might not be valid
+	     * but are useful for debugging. */
+	    assert(next_active[bp[t][s]] <= j);
+	    assert(j - next_active[bp[t][s]] <= 2);
+	}
+    }
+#endif
+    /* find best alpha value in current frame for pruning and scaling purposes */
+    balpha = 0;
+    /* also take the argmax to find the best backtrace */
+    for (s = 0; s < n_next_active; s++) {
+	if (balpha < active_alpha[t][s]) {
+	    balpha = active_alpha[t][s];
+	}
+    }
+
+    /* cope with some pathological case */
+    if (balpha == 0.0 && n_next_active > 0) {
+	E_ERROR("All %u active states,", n_next_active);
+	for (s = 0; s < n_next_active; s++) {
+	    if (state_seq[next_active[s]].mixw != TYING_NON_EMITTING)
+		fprintf(stderr, " %u", state_seq[next_active[s]].mixw);
+	    else
+		fprintf(stderr, " N(%u,%u)",
+			state_seq[next_active[s]].tmat, state_seq[next_active[s]].m_state);
+
+	}
+	fprintf(stderr, ", zero at time %u\n", t);
+	fflush(stderr);
+	return S3_ERROR;
+    }
+
+    /* and some related pathological cases */
+    if (balpha < 1e-300) {
+	E_ERROR("Best alpha < 1e-300\n");
+
+	return S3_ERROR;
+    }
+    if (n_next_active == 0) {
+	E_ERROR("No active states at time %u\n", t);
+	return S3_ERROR;
+    }
+
+    /* compute the scale factor */
+    *out_scale = scale = 1.0 / balpha;
+    /* compute the pruning threshold based on the beam */
+    if (log10(balpha) + log10(f->beam) > -300) {
+	pthresh = balpha * f->beam;
+    }
+    else {
+	/* avoiding underflow... */
+	pthresh = 1e-300;
+    }
+/* DEBUG XXXXX */
+/* pthresh = 0.0; */
+/* END DEBUG */
+
+    /* Determine if phone segmentation-based pruning would leave
+     * us with an empty active list (that would be bad!) */
+    can_prune_phseg = 0;
+    if (phseg) {
+	for (s = 0; s < n_next_active; ++s) 
+	    if (acmod_set_base_phone(as, state_seq[next_active[s]].phn)
+		== acmod_set_base_phone(as, phseg->phone))
+		break;
+	can_prune_phseg = !(s == n_next_active);
+#if FORWARD_DEBUG
+	if (!can_prune_phseg) {
+	    E_INFO("Will not apply phone-based pruning at timepoint %d "
+		   "(%d != %d) (%s != %s)\n", t,
+		   state_seq[next_active[s]].phn,
+		   phseg->phone,
+		   acmod_set_id2name(f->inv->mdef->acmod_set, state_seq[next_active[s]].phn),
+		   acmod_set_id2name(f->inv->mdef->acmod_set, phseg->phone)
+		   );
+	}
+#endif
+    }
+    /* Prune active states for the next frame and rescale their alphas. */
+    active = active_astate[t] = ckd_calloc(n_next_active, sizeof(uint32));
+    for (s = 0, n_active = 0; s < n_next_active; s++) {
+	/* "Snap" the backpointers for non-emitting states, so
+	   that they don't point to bogus indices (we will use
+	   amap to recover them). */
+	if (bp && state_seq[next_active[s]].mixw == TYING_NON_EMITTING) {
+#if FORWARD_DEBUG
+	    E_INFO("Snapping backpointer for %d, %d => %d\n",
+		   next_active[s], bp[t][s], next_active[bp[t][s]]);
+#endif
+	    bp[t][s] = next_active[bp[t][s]];
+	}
+	/* If we have a phone segmentation, use it instead of the beam. */
+	if (phseg && can_prune_phseg) {
+	    if (acmod_set_base_phone(as, state_seq[next_active[s]].phn)
+		== acmod_set_base_phone(as, phseg->phone)) {
+		active_alpha[t][n_active] = active_alpha[t][s] * scale;
+		active[n_active] = next_active[s];
+		if (bp)
+		    bp[t][n_active] = bp[t][s];
+		amap[next_active[s]] = n_active;
+		n_active++;
+	    }
+	    else {
+		amap[next_active[s]] = INACTIVE;
+	    }
+	}
+	else {
+	    if (active_alpha[t][s] > pthresh) {
+		active_alpha[t][n_active] = active_alpha[t][s] * scale;
+		active[n_active] = next_active[s];
+		if (bp)
+		    bp[t][n_active] = bp[t][s];
+		amap[next_active[s]] = n_active;
+		n_active++;
+	    }
+	    else {
+		amap[next_active[s]] = INACTIVE;
+	    }
+	}
+    }
+    /* Now recover the backpointers for non-emitting states. */
+    for (s = 0; s < n_active; ++s) {
+	if (bp && state_seq[active[s]].mixw == TYING_NON_EMITTING) {
+#if FORWARD_DEBUG
+	    E_INFO("Snapping backpointer for %d, %d => %d(%d)\n",
+		   active[s], bp[t][s], amap[bp[t][s]], active[amap[bp[t][s]]]);
+#endif
+	    bp[t][s] = amap[bp[t][s]];
+	}
+    }
+    /* And finally deactive all states. */
+    for (s = 0; s < n_active; ++s) {
+	amap[active[s]] = INACTIVE;
+    }
+    n_active_astate[t] = n_active;
+
+    /* Only keep as much as survived pruning */
+    if (n_active < f->aalpha_alloc) {
+	active_alpha[t] = ckd_realloc(active_alpha[t],
+				      n_active * sizeof(float64));
+	active_astate[t] = ckd_realloc(active_astate[t],
+				       n_active * sizeof(uint32));
+    }
+
+    return S3_SUCCESS;
+}
+
+/* Save what is needed to restart the forward pass after frame t */
+static void
+forward_save_ckpt(fwd_ckpt_t *f, uint32 t, s3phseg_t *phseg)
+{
+    uint32 c = t / f->intv;
+    gauden_t *g = f->inv->gauden;
+
+    f->phseg[c] = phseg;
+    if (f->den_idx) {
+	f->den_idx[c] = ckd_malloc(gauden_n_feat(g) * gauden_n_top(g)
+				   * sizeof(uint32));
+	memcpy(f->den_idx[c], &f->now_den_idx[0][0][0],
+	       gauden_n_feat(g) * gauden_n_top(g) * sizeof(uint32));
+    }
+}
+
 int32
 forward(float64 **active_alpha,
 	uint32 **active_astate,
@@ -191,81 +689,82 @@ forward(float64 **active_alpha,
 	float64 beam,
 	s3phseg_t *phseg,
 	bw_timers_t *timers,
-	uint32 mmi_train)
+	bw_utt_stats_t *stats,
+	uint32 ckpt_intv,
+	fwd_ckpt_t **out_ckpt)
 {
-    uint32 i, j, s, t, u;
-    uint32 l_cb;
-    uint32 *active_a;
-    uint32 *active_b;
-    uint32 *active;
+    uint32 i, t;
     uint32 *active_l_cb;
-    uint32 n_active;
-    uint32 n_active_l_cb;
     uint32 n_sum_active;
-    uint32 *next_active;
-    uint32 n_next_active;
-    uint32 aalpha_alloc;
-    uint16 *amap;
-    uint32 *next;
-    float32 *tprob;
-    float64 prior_alpha;
+    float64 *outprob;
     float32 ***mixw;
     gauden_t *g;
-    acmod_set_t *as;
-    float64 x;
-    float64 pthresh = 1e-300;
-    float64 balpha;
     float64 ***now_den;
     uint32 ***now_den_idx;
     uint32 retval = S3_SUCCESS;
     uint32 n_l_cb;
-    int32 *acbframe; /* Frame in which a codebook was last active */
-    float64 *outprob;
-    /* Can we prune this frame using phseg? */
-    int can_prune_phseg;
-    float64 *best_pred = NULL;
+    fwd_ckpt_t *f;
+
+    /* Backpointers are needed for every frame */
+    if (bp || out_ckpt == NULL || ckpt_intv >= n_obs)
+	ckpt_intv = 0;
+
+    f = ckd_calloc(1, sizeof(*f));
+    f->feature = feature;
+    f->n_obs = n_obs;
+    f->state_seq = state_seq;
+    f->n_state = n_state;
+    f->inv = inv;
+    f->beam = beam;
+    f->timers = timers;
+    f->intv = ckpt_intv;
+    f->block = n_obs;
     
     /* # of distinct codebooks referenced by this utterance */
-    n_l_cb = inv->n_cb_inverse;
+    n_l_cb = f->n_l_cb = inv->n_cb_inverse;
 
     /* active codebook frame index */
-    acbframe = ckd_calloc(n_l_cb, sizeof(*acbframe));
+    f->acbframe = ckd_calloc(n_l_cb, sizeof(int32));
 
     g = inv->gauden;
-    as = inv->mdef->acmod_set;
     /* density values and indices (for top-N eval) for some time t */
-    now_den = (float64 ***)ckd_calloc_3d(n_l_cb, gauden_n_feat(g), gauden_n_top(g),
-					 sizeof(float64));
-    now_den_idx = (uint32 ***)ckd_calloc_3d(n_l_cb, gauden_n_feat(g), gauden_n_top(g),
-					    sizeof(uint32));
+    now_den = f->now_den =
+	(float64 ***)ckd_calloc_3d(n_l_cb, gauden_n_feat(g), gauden_n_top(g),
+				   sizeof(float64));
+    now_den_idx = f->now_den_idx =
+	(uint32 ***)ckd_calloc_3d(n_l_cb, gauden_n_feat(g), gauden_n_top(g),
+				  sizeof(uint32));
     /* Mixing weight array */
     mixw = inv->mixw;
 
     /* Scratch area for output probabilities at some time t */
-    outprob = (float64 *)ckd_calloc(n_state, sizeof(float64));
+    outprob = f->outprob = (float64 *)ckd_calloc(n_state, sizeof(float64));
 
-    /* Active state lists for time t and t+1 */
-    active_a = ckd_calloc(n_state, sizeof(uint32));
-    active_b = ckd_calloc(n_state, sizeof(uint32));
+    /* Active state list for time t */
+    f->next_active = ckd_calloc(n_state, sizeof(uint32));
 
     /* Active (local) codebooks for some time t */
-    active_l_cb = ckd_calloc(n_state, sizeof(uint32));
+    active_l_cb = f->active_l_cb = ckd_calloc(n_state, sizeof(uint32));
 
     /* Mapping from sentence HMM state index to active state list index
     * for currently active time. */
-    amap = ckd_calloc(n_state, sizeof(uint16));
+    f->amap = ckd_calloc(n_state, sizeof(uint16));
     
-    /* set up the active and next_active lists and associated counts */
-    active = active_a;
-    next_active = active_b;
-    n_active = 0;
-    n_active_l_cb = 0;
     n_sum_active = 0;
-    n_next_active = 0;
 
     /* Initialize the active state map such that all states are inactive */
     for (i = 0; i < n_state; i++)
-	amap[i] = INACTIVE;
+	f->amap[i] = INACTIVE;
+
+    if (ckpt_intv) {
+	uint32 n_ckpt = (n_obs + ckpt_intv - 1) / ckpt_intv;
+
+	f->phseg = ckd_calloc(n_ckpt, sizeof(*f->phseg));
+	/* The top N of the previous frame are used as a starting
+	 * point for semi-continuous models, see below */
+	if (n_l_cb == 1)
+	    f->den_idx = ckd_calloc(n_ckpt, sizeof(*f->den_idx));
+    }
 
     /*
      * The following section computes the output liklihood of
@@ -312,13 +811,13 @@ forward(float64 **active_alpha,
     active_astate[0] = ckd_calloc(1, sizeof(uint32));
     if (bp)
 	bp[0] = ckd_calloc(1, sizeof(uint32)); /* Unused, actually */
-    aalpha_alloc = 1;
+    f->aalpha_alloc = 1;
 
     /*
      * Allocate the bestscore array for embedded Viterbi
      */
     if (bp)
-	best_pred = ckd_calloc(1, sizeof(float64));
+	f->best_pred = ckd_calloc(1, sizeof(float64));
 
     /* Compute scale for t == 0 */
     scale[0] = 1.0 / outprob[0];
@@ -330,9 +829,8 @@ forward(float64 **active_alpha,
     /* Only one initial state (for now) */
     n_active_astate[0] = 1;
 
-    /* insert the initial state in the active list */
-    active[n_active] = 0;
-    n_active++;
+    if (ckpt_intv)
+	forward_save_ckpt(f, 0, phseg);
 
     /* Compute scaled alpha over all remaining time in the utterance */
     for (t = 1; t < n_obs; t++) {
@@ -342,396 +840,124 @@ forward(float64 **active_alpha,
 	    if (t > phseg->ef)
 		phseg = phseg->next;
 	}
-	n_active_l_cb = 0;
-
-	/* assume next active state set about the same size as current;
-	   adjust to actual size as necessary later */
-	active_alpha[t] = (float64 *)ckd_calloc(n_active, sizeof(float64));
-	if (bp) {
-	    bp[t] = (uint32 *)ckd_calloc(n_active, sizeof(uint32));
-	    /* reallocate the best score array and zero it out */
-	    if (n_active > aalpha_alloc)
-		best_pred = (float64 *)ckd_realloc(best_pred, n_active * sizeof(float64));
-	    memset(best_pred, 0, n_active * sizeof(float64));
-	}
-	aalpha_alloc = n_active;
 
-	/* For all active states at the previous frame, activate their
-	   successors in this frame and compute codebooks. */
-	/* (these are pre-computed so they can be scaled to avoid underflows) */
-	for (s = 0; s < n_active; s++) {
-	    i = active[s];
-#if FORWARD_DEBUG
-	    E_INFO("At time %d, In Gaussian computation, active state %d\n",t, i);
-#endif
-	    /* get list of states adjacent to active state i */
-	    next = state_seq[i].next_state;	
-
-	    /* activate them all, computing their codebook densities if necessary */
-	    for (u = 0; u < state_seq[i].n_next; u++) {
-		j = next[u];
-#if FORWARD_DEBUG
-		E_INFO("In Gaussian computation, active state %d, next state %d\n", i,j);
-#endif
-		if (state_seq[j].mixw != TYING_NON_EMITTING) {
-		    if (amap[j] == INACTIVE) {
-			l_cb = state_seq[j].l_cb;
-			
-			if (acbframe[l_cb] != t) {
-			    /* Component density values not yet computed */
-			    if (timers)
-				ptmr_start(&timers->gau_timer);
-			    gauden_compute_log(now_den[l_cb],
-					       now_den_idx[l_cb],
-					       feature[t],
-					       g,
-					       state_seq[j].cb,
-					       /* Preinitializing topn
-						  only really makes a
-						  difference for
-						  semi-continuous
-						  (n_l_cb == 1)
-						  models. */
-					       n_l_cb == 1
-					       ? now_den_idx[l_cb] : NULL);
-
-			    active_l_cb[n_active_l_cb++] = l_cb;
-			    acbframe[l_cb] = t;
-
-			    if (timers)
-				ptmr_stop(&timers->gau_timer);
-			}
-
-			/* Put next state j into the active list */
-			amap[j] = n_next_active;
-
-			/* Initialize the alpha variable to zero */
-			active_alpha[t][n_next_active] = 0;
-
-			/* Map active state list index to sentence HMM index */
-			next_active[n_next_active] = j;
-
-			++n_next_active;
-
-			if (n_next_active == aalpha_alloc) {
-			    /* Need to reallocate the active_alpha array */
-			    aalpha_alloc += ACHK;
-			    active_alpha[t] = ckd_realloc(active_alpha[t],
-							  sizeof(float64) * aalpha_alloc);
-			    /* And the backpointer array */
-			    if (bp) {
-				bp[t] = ckd_realloc(bp[t],
-						    sizeof(uint32) * aalpha_alloc);
-				/* And the best score array */
-				best_pred = (float64 *)ckd_realloc(best_pred,
-								   sizeof(float64) * aalpha_alloc);
-				/* Make sure the new stuff is zero */
-				memset(bp[t] + aalpha_alloc - ACHK,
-				       0, sizeof(uint32) * ACHK);
-				memset(best_pred + aalpha_alloc - ACHK,
-				       0, sizeof(float64) * ACHK);
-			    }
-			}
-		    }
-		}
-	    }
-	}
-
-	/* Cope w/ numerical issues by dividing densities by max density */
-	dscale[t] = gauden_scale_densities_fwd(now_den, now_den_idx,
-					       active_l_cb, n_active_l_cb, g);
-	
-	/* Now, for all active states in the previous frame, compute
-	   alpha for all successors in this frame. */
-	for (s = 0; s < n_active; s++) {
-	    i = active[s];
-	    
-#if FORWARD_DEBUG
-	    E_INFO("At time %d, In real state alpha update, active state %d\n",t, i);
-#endif
-	    /* get list of states adjacent to active state i */
-	    next = state_seq[i].next_state;	
-	    /* get the associated transition probs */
-	    tprob = state_seq[i].next_tprob;
-
-	    /* the scaled alpha value for i at t-1 */
-	    prior_alpha = active_alpha[t-1][s];
-
-	    /* For all emitting states j adjacent to i, update their
-	     * alpha values.  */
-	    for (u = 0; u < state_seq[i].n_next; u++) {
-		j = next[u];
-#if FORWARD_DEBUG
-		E_INFO("In real state update, active state %d, next state %d\n", i,j);
-#endif
-		l_cb = state_seq[j].l_cb;
-
-		if (state_seq[j].mixw != TYING_NON_EMITTING) {
-		    /* Next state j is an emitting state */
-		    outprob[j] = gauden_mixture(now_den[l_cb],
-						now_den_idx[l_cb],
-						mixw[state_seq[j].mixw],
-						g);
-
-
-		    /* update backpointers bp[t][j] */
-		    x = prior_alpha * tprob[u];
-		    if (bp) {
-			if (x > best_pred[amap[j]]) {
-#if FORWARD_DEBUG
-			    E_INFO("In real state update, backpointer %d => %d updated from %e to (%e * %e = %e)\n",
-				   i, j, best_pred[amap[j]], prior_alpha, tprob[u], x);
-#endif
-			    best_pred[amap[j]] = x;
-			    bp[t][amap[j]] = s;
-			}
-		    }
-		    
-		    /* update the unscaled alpha[t][j] */
-		    active_alpha[t][amap[j]] += x * outprob[j];
-		}
-		else {
-		    /* already done below in the prior time frame */
-		}
-	    }
-	}
-
-#if FORWARD_DEBUG
-	if (bp) {
-	    for (s = 0; s < n_next_active; ++s) {
-		j = next_active[s];
-		E_INFO("After real state update, best path to %d(%d) = %d(%d)\n",
-		       j, amap[j], active[bp[t][s]], bp[t][s]);
-	    }
-	}
-#endif
-	/* Now, for all active states in this frame, consume any
-	   following non-emitting states (multiplying in their
-	   transition probabilities)  */
-	for (s = 0; s < n_next_active; s++) {
-	    i = next_active[s];
-
-	    /* find the successor states */
-	    next = state_seq[i].next_state;
-	    tprob = state_seq[i].next_tprob;
-
-	    for (u = 0; u < state_seq[i].n_next; u++) {
-		j = next[u];
-		/* for any non-emitting ones */
-		if (state_seq[j].mixw == TYING_NON_EMITTING) {
-#if FORWARD_DEBUG
-		    E_INFO("In non-emitting state update, active state %d, next state %d\n",i,j);
-#endif
-		    x = active_alpha[t][s] * tprob[u];
-
-#if FORWARD_DEBUG
-		    E_INFO("In non-emitting state update, active_alpha[t][s]: %f,tprob[u]:  %f\n",active_alpha[t][s],tprob[u]);
-#endif
-		    /* activate this state if necessary */
-		    if (amap[j] == INACTIVE) {
-			amap[j] = n_next_active;
-			active_alpha[t][n_next_active] = 0;
-			next_active[n_next_active] = j;
-			++n_next_active;
-
-			if (n_next_active == aalpha_alloc) {
-			    aalpha_alloc += ACHK;
-			    active_alpha[t] = ckd_realloc(active_alpha[t],
-							  sizeof(float64) * aalpha_alloc);
-			    if (bp) {
-				bp[t] = ckd_realloc(bp[t],
-						    sizeof(uint32) * aalpha_alloc);
-				best_pred = (float64 *)ckd_realloc(best_pred,
-								   sizeof(float64) * aalpha_alloc);
-				memset(bp[t] + aalpha_alloc - ACHK,
-				       0, sizeof(uint32) * ACHK);
-				memset(best_pred + aalpha_alloc - ACHK,
-				       0, sizeof(float64) * ACHK);
-			    }
-			}
-			if (bp) {
-			    /* Give its backpointer a default value */
-			    bp[t][amap[j]] = s;
-			    best_pred[amap[j]] = x;
-			}
-		    }
-
-		    /* update backpointers bp[t][j] */
-		    if (bp && x > best_pred[amap[j]]) {
-			bp[t][amap[j]] = s;
-			best_pred[amap[j]] = x;
-		    }
-		    /* update its alpha value */
-		    active_alpha[t][amap[j]] += x;
-		}
-	    }
-	}
-
-#if FORWARD_DEBUG
-	for (s = 0; s < n_next_active; ++s) {
-	    j = next_active[s];
-	    if (bp && state_seq[j].mixw == TYING_NON_EMITTING) {
-		E_INFO("After non-emitting state update, best path to %d(%d) = %d(%d)\n",
-		       j, amap[j], next_active[bp[t][s]], bp[t][s]);
-		/* Assumptions about topology that might not be valid
-		 * but are useful for debugging. */
-		assert(next_active[bp[t][s]] <= j);
-		assert(j - next_active[bp[t][s]] <= 2);
-	    }
-	}
-#endif
-	/* find best alpha value in current frame for pruning and scaling purposes */
-	balpha = 0;
-	/* also take the argmax to find the best backtrace */
-	for (s = 0; s < n_next_active; s++) {
-	    if (balpha < active_alpha[t][s]) {
-		balpha = active_alpha[t][s];
-	    }
+	if (forward_frame(f, t, active_alpha, active_astate, n_active_astate,
+			  bp, &scale[t], &dscale[t], phseg) != S3_SUCCESS) {
+	    retval = S3_ERROR;
+	    break;
 	}
-
-	/* cope with some pathological case */
-	if (balpha == 0.0 && n_next_active > 0) {
-	    E_ERROR("All %u active states,", n_next_active);
-	    for (s = 0; s < n_next_active; s++) {
-		if (state_seq[next_active[s]].mixw != TYING_NON_EMITTING)
-		    fprintf(stderr, " %u", state_seq[next_active[s]].mixw);
-		else
-		    fprintf(stderr, " N(%u,%u)",
-			    state_seq[next_active[s]].tmat, state_seq[next_active[s]].m_state);
-
+	n_sum_active += n_active_astate[t];
+
+	if (ckpt_intv) {
+	    if (t % ckpt_intv == 0)
+		forward_save_ckpt(f, t, phseg);
+	    /* The previous frame will be recomputed from its
+	     * checkpoint in the backward pass. */
+	    if ((t - 1) % ckpt_intv != 0) {
+		ckd_free(active_alpha[t-1]);
+		ckd_free(active_astate[t-1]);
+		active_alpha[t-1] = NULL;
+		active_astate[t-1] = NULL;
 	    }
-	    fprintf(stderr, ", zero at time %u\n", t);
-	    fflush(stderr);
-	    retval =  S3_ERROR;
-	    break;
 	}
+    }
+    if (stats) {
+	stats->fwd_done = TRUE;
+	stats->n_alpha_active = n_sum_active / n_obs;
+    }
+    
+cleanup:
+    if (retval == S3_SUCCESS && ckpt_intv) {
+	*out_ckpt = f;
+    }
+    else {
+	if (out_ckpt)
+	    *out_ckpt = NULL;
+	forward_ckpt_free(f);
+    }
 
-	/* and some related pathological cases */
-	if (balpha < 1e-300) {
-	    E_ERROR("Best alpha < 1e-300\n");
-
-	    retval = S3_ERROR;
+    return retval;
+}
 
-	    break;
-	}
-	if (n_next_active == 0) {
-	    E_ERROR("No active states at time %u\n", t);
-	    retval = S3_ERROR;
-	    break;
-	}
+int32
+forward_recompute(fwd_ckpt_t *f,
+		  uint32 t,
+		  float64 **active_alpha,
+		  uint32 **active_astate,
+		  uint32 *n_active_astate)
+{
+    uint32 c, u, l;
+    float64 scale;
+    float64 *dscale;
+    s3phseg_t *phseg;
+    gauden_t *g;
 
-	/* compute the scale factor */
-	scale[t] = 1.0 / balpha;
-	/* compute the pruning threshold based on the beam */
-	if (log10(balpha) + log10(beam) > -300) {
-	    pthresh = balpha * beam;
-	}
-	else {
-	    /* avoiding underflow... */
-	    pthresh = 1e-300;
+    if (f == NULL || active_alpha[t] != NULL)
+	return S3_SUCCESS;
+
+    /* The backward pass is done with the block after this one. */
+    if (f->block < f->n_obs) {
+	for (u = f->block + 1;
+	     u < f->block + f->intv && u < f->n_obs - 1; u++) {
+	    ckd_free(active_alpha[u]);
+	    ckd_free(active_astate[u]);
+	    active_alpha[u] = NULL;
+	    active_astate[u] = NULL;
 	}
-/* DEBUG XXXXX */
-/* pthresh = 0.0; */
-/* END DEBUG */
+    }
 
-	/* Determine if phone segmentation-based pruning would leave
-	 * us with an empty active list (that would be bad!) */
-	can_prune_phseg = 0;
+    /* Restart from the checkpoint at the start of this block. */
+    c = t / f->intv * f->intv;
+    g = f->inv->gauden;
+    for (l = 0; l < f->n_l_cb; l++)
+	f->acbframe[l] = -1;
+    if (f->den_idx)
+	memcpy(&f->now_den_idx[0][0][0], f->den_idx[c / f->intv],
+	       gauden_n_feat(g) * gauden_n_top(g) * sizeof(uint32));
+    phseg = f->phseg[c / f->intv];
+
+    /* The last frame is always kept, so don't redo it. */
+    for (u = c + 1; u < c + f->intv && u < f->n_obs - 1; u++) {
 	if (phseg) {
-	    for (s = 0; s < n_next_active; ++s) 
-		if (acmod_set_base_phone(as, state_seq[next_active[s]].phn)
-		    == acmod_set_base_phone(as, phseg->phone))
-		    break;
-	    can_prune_phseg = !(s == n_next_active);
-#if FORWARD_DEBUG
-	    if (!can_prune_phseg) {
-		E_INFO("Will not apply phone-based pruning at timepoint %d "
-		       "(%d != %d) (%s != %s)\n", t,
-		       state_seq[next_active[s]].phn,
-		       phseg->phone,
-		       acmod_set_id2name(inv->mdef->acmod_set, state_seq[next_active[s]].phn),
-		       acmod_set_id2name(inv->mdef->acmod_set, phseg->phone)
-		       );
-	    }
-#endif
-	}
-	/* Prune active states for the next frame and rescale their alphas. */
-	active_astate[t] = ckd_calloc(n_next_active, sizeof(uint32));
-	for (s = 0, n_active = 0; s < n_next_active; s++) {
-	    /* "Snap" the backpointers for non-emitting states, so
-	       that they don't point to bogus indices (we will use
-	       amap to recover them). */
-	    if (bp && state_seq[next_active[s]].mixw == TYING_NON_EMITTING) {
-#if FORWARD_DEBUG
-		E_INFO("Snapping backpointer for %d, %d => %d\n",
-		       next_active[s], bp[t][s], next_active[bp[t][s]]);
-#endif
-		bp[t][s] = next_active[bp[t][s]];
-	    }
-	    /* If we have a phone segmentation, use it instead of the beam. */
-	    if (phseg && can_prune_phseg) {
-		if (acmod_set_base_phone(as, state_seq[next_active[s]].phn)
-		    == acmod_set_base_phone(as, phseg->phone)) {
-		    active_alpha[t][n_active] = active_alpha[t][s] * scale[t];
-		    active[n_active] = active_astate[t][n_active] = next_active[s];
-		    if (bp)
-			bp[t][n_active] = bp[t][s];
-		    amap[next_active[s]] = n_active;
-		    n_active++;
-		}
-		else {
-		    amap[next_active[s]] = INACTIVE;
-		}
-	    }
-	    else {
-		if (active_alpha[t][s] > pthresh) {
-		    active_alpha[t][n_active] = active_alpha[t][s] * scale[t];
-		    active[n_active] = active_astate[t][n_active] = next_active[s];
-		    if (bp)
-			bp[t][n_active] = bp[t][s];
-		    amap[next_active[s]] = n_active;
-		    n_active++;
-		}
-		else {
-		    amap[next_active[s]] = INACTIVE;
-		}
-	    }
-	}
-	/* Now recover the backpointers for non-emitting states. */
-	for (s = 0; s < n_active; ++s) {
-	    if (bp && state_seq[active[s]].mixw == TYING_NON_EMITTING) {
-#if FORWARD_DEBUG
-		E_INFO("Snapping backpointer for %d, %d => %d(%d)\n",
-		       active[s], bp[t][s], amap[bp[t][s]], active[amap[bp[t][s]]]);
-#endif
-		bp[t][s] = amap[bp[t][s]];
-	    }
+	    if (u > phseg->ef)
+		phseg = phseg->next;
 	}
-	/* And finally deactive all states. */
-	for (s = 0; s < n_active; ++s) {
-	    amap[active[s]] = INACTIVE;
+	/* This should not fail, since it did the first time. */
+	if (forward_frame(f, u, active_alpha, active_astate, n_active_astate,
+			  NULL, &scale, &dscale, phseg) != S3_SUCCESS) {
+	    E_ERROR("Failed to recompute forward pass at frame %u\n", u);
+	    return S3_ERROR;
 	}
-	n_active_astate[t] = n_active;
-	n_next_active = 0;
-
-	n_sum_active += n_active;
+	ckd_free(dscale);
     }
-    if (!mmi_train)
-	printf(" %u ", n_sum_active / n_obs);
-    
-cleanup:
-    ckd_free(active_a);
-    ckd_free(active_b);
-    ckd_free(amap);
+    f->block = c;
 
-    ckd_free(active_l_cb);
-    ckd_free(acbframe);
+    return S3_SUCCESS;
+}
 
-    ckd_free(outprob);
-    ckd_free(best_pred);
+void
+forward_ckpt_free(fwd_ckpt_t *f)
+{
+    uint32 c;
+
+    if (f == NULL)
+	return;
+    if (f->den_idx) {
+	for (c = 0; c < (f->n_obs + f->intv - 1) / f->intv; c++)
+	    ckd_free(f->den_idx[c]);
+	ckd_free(f->den_idx);
+    }
+    ckd_free(f->phseg);
 
-    ckd_free_3d((void ***)now_den);
-    ckd_free_3d((void ***)now_den_idx);
+    ckd_free(f->next_active);
+    ckd_free(f->amap);
+    ckd_free(f->active_l_cb);
+    ckd_free(f->acbframe);
+    ckd_free(f->outprob);
+    ckd_free(f->best_pred);
 
-    return retval;
+    ckd_free_3d((void ***)f->now_den);
+    ckd_free_3d((void ***)f->now_den_idx);
+
+    ckd_free(f);
 }
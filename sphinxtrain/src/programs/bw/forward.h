@@ -54,6 +54,8 @@
 
 #include "baum_welch.h"
 
+typedef struct fwd_ckpt_s fwd_ckpt_t;
+
 uint32 *
 backtrace(state_t *state, uint32 fs_id, uint32 *n_vit_sseq);
 
@@ -72,7 +74,21 @@ forward(float64 **active_alpha,
 	float64 beam,
 	s3phseg_t *phseg,
 	bw_timers_t *timers,
-	uint32 mmi_train);
+	bw_utt_stats_t *stats,
+	uint32 ckpt_intv,
+	fwd_ckpt_t **out_ckpt);
+
+/* Restore the alphas of frame t, and of the rest of its block, from
+ * the checkpoint before it, if they were not kept by forward(). */
+int32
+forward_recompute(fwd_ckpt_t *ckpt,
+		  uint32 t,
+		  float64 **active_alpha,
+		  uint32 **active_astate,
+		  uint32 *n_active_astate);
+
+void
+forward_ckpt_free(fwd_ckpt_t *ckpt);
 
 void
 forward_set_viterbi(int state);
@@ -65,6 +65,8 @@
 #include <s3/mllr_io.h>
 #include <s3/ts2cb.h>
 #include <s3/s3cb2mllr_io.h>
+#include <s3/state_seq.h>
+#include <s3/gauden_simd.h>
 #include <sys_compat/misc.h>
 #include <sys_compat/time.h>
 #include <sys_compat/file.h>
@@ -72,6 +74,7 @@
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/profile.h>
 #include <sphinxbase/feat.h>
+#include <sphinxbase/sbthread.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -80,6 +83,7 @@
 #include <assert.h>
 
 #define DUMP_RETRY_PERIOD	3	/* If a count dump fails, retry every # of sec's */
+#define JOBS_PER_THREAD		4	/* # of utts read at once for each worker thread */
 
 /* the following parameters are used for MMIE training */
 #define LOG_ZERO	-1.0E10
@@ -544,6 +548,10 @@ main_initialize(int argc,
 	}
     }
 
+    corpus_set_prefetch(cmd_ln_int32("-prefetch"));
+    if (cmd_ln_str("-featcachedir"))
+	corpus_set_feat_cache_dir(cmd_ln_str("-featcachedir"), feat);
+
     /* BEWARE: this function call must be done after all the other corpus
        configuration */
     corpus_init();
@@ -609,9 +617,563 @@ main_initialize(int argc,
 	free_mllr_B(sxfrm_b, n_mllr, tmp_n_stream);
     }
 
+    /* Transposed codebooks for vectorized Gaussian evaluation, made
+     * once the means and variances are final. */
+    gauden_simd_init(inv->gauden,
+		     cmd_ln_str("-simd"),
+		     cmd_ln_float64("-simdtol"));
+
     return S3_SUCCESS;
 }
 
+static void
+dump_ckpt(model_inventory_t *inv,
+	  int32 mixw_reest,
+	  int32 tmat_reest,
+	  int32 mean_reest,
+	  int32 var_reest,
+	  int32 pass2var,
+	  int32 var_is_full)
+{
+    uint32 no_retries = 0;
+
+    while (accum_dump(cmd_ln_str("-accumdir"),
+		      inv,
+		      mixw_reest,
+		      tmat_reest,
+		      mean_reest,
+		      var_reest,
+		      pass2var,
+		      var_is_full,
+		      TRUE) != S3_SUCCESS) {
+	static int notified = FALSE;
+	time_t t;
+	char time_str[64];
+		
+	/*
+	 * If we were not able to dump the parameters, write one log entry
+	 * about the failure
+	 */
+	if (notified == FALSE) {
+	    t = time(NULL);
+	    strcpy(time_str, (const char *)ctime((const time_t *)&t));
+	    /* nuke the newline at the end of this. */
+	    time_str[strlen(time_str)-1] = '\0';
+	    E_WARN("Ckpt count dump failed on %s.  Retrying dump every %3.1f hour until success.\n",
+		   time_str, DUMP_RETRY_PERIOD/3600.0);
+		    
+	    notified = TRUE;
+	    no_retries++;
+	    if(no_retries>10){ 
+		E_FATAL("Failed to get the files after 10 retries(about 5 minutes).\n ");
+	    }
+	}
+	sleep(DUMP_RETRY_PERIOD);
+    }
+}
+
+/*
+ * With -nthreads, the main thread reads the corpus and builds the
+ * sentence HMMs a batch of utterances at a time, while worker threads
+ * run forward-backward on the previous batch.  Each worker adds to
+ * its own copy of the reestimation sums, which are merged into the
+ * main inventory at checkpoints and at the end.
+ */
+
+/* An utterance prepared by the main thread for a worker thread */
+typedef struct bw_job_s {
+    uint32 seq_no;		/* sequence # of utterance in corpus */
+    char *uttid;
+    uint32 n_frame_in;		/* # of cepstrum frames */
+    uint32 n_frame;		/* # of feature frames */
+    vector_t **f;		/* feature streams */
+    state_t *state_seq;		/* private copy of the sentence HMM */
+    uint32 n_state;
+    uint32 *mixw_inverse;	/* local->global mixing weight ID's for it */
+    uint32 n_mixw_inverse;
+    uint32 *cb_inverse;		/* local->global codebook ID's for it */
+    uint32 n_cb_inverse;
+    s3phseg_t *phseg;
+    FILE *pdumpfh;
+    float64 log_lik;		/* set by the worker */
+    bw_utt_stats_t stats;	/* set by the worker */
+    bw_timers_t timers;		/* set by both, with -timing */
+    int32 rv;			/* set by the worker */
+} bw_job_t;
+
+/* A batch of utterances shared out between the worker threads */
+typedef struct bw_batch_s {
+    bw_job_t *jobs;
+    uint32 n_jobs;
+    uint32 next;		/* next job to be taken by a worker */
+    int ckpt;			/* dump the counts after this batch */
+    int eof;			/* no more utterances after this batch */
+    sbmtx_t *mtx;
+} bw_batch_t;
+
+/* A worker thread and its reestimation sums */
+typedef struct bw_worker_s {
+    model_inventory_t inv;	/* parameters shared with the main inventory */
+    gauden_t gauden;
+    feat_t *feat;
+    bw_batch_t *batch;
+    sbthread_t *thread;
+
+    float64 a_beam;
+    float64 b_beam;
+    float32 spthresh;
+    int32 mixw_reest;
+    int32 tmat_reest;
+    int32 mean_reest;
+    int32 var_reest;
+    int32 pass2var;
+    int32 var_is_full;
+    int32 profile;
+
+    uint32 n_utt;
+    uint32 n_frame;
+    ptmr_t busy;
+} bw_worker_t;
+
+static void
+bw_worker_init(bw_worker_t *w, model_inventory_t *inv, feat_t *feat)
+{
+    memset(w, 0, sizeof(*w));
+
+    w->a_beam = cmd_ln_float64("-abeam");
+    w->b_beam = cmd_ln_float64("-bbeam");
+    w->spthresh = cmd_ln_float32("-spthresh");
+    w->mixw_reest = cmd_ln_int32("-mixwreest");
+    w->tmat_reest = cmd_ln_int32("-tmatreest");
+    w->mean_reest = cmd_ln_int32("-meanreest");
+    w->var_reest = cmd_ln_int32("-varreest");
+    w->pass2var = cmd_ln_int32("-2passvar");
+    w->var_is_full = cmd_ln_int32("-fullvar");
+    w->profile = cmd_ln_int32("-timing");
+    w->feat = feat;
+    ptmr_init(&w->busy);
+
+    /* Share the parameters, but not the accumulators or the
+     * per-utterance state. */
+    w->inv = *inv;
+    w->inv.mixw_acc = NULL;
+    w->inv.l_mixw_acc = NULL;
+    w->inv.mixw_inverse = NULL;
+    w->inv.n_mixw_inverse = 0;
+    w->inv.cb_inverse = NULL;
+    w->inv.n_cb_inverse = 0;
+    w->inv.tmat_acc = NULL;
+    w->inv.l_tmat_acc = NULL;
+
+    w->gauden = *inv->gauden;
+    w->gauden.macc = NULL;
+    w->gauden.vacc = NULL;
+    w->gauden.fullvacc = NULL;
+    w->gauden.dnom = NULL;
+    w->gauden.l_macc = NULL;
+    w->gauden.l_vacc = NULL;
+    w->gauden.l_fullvacc = NULL;
+    w->gauden.l_dnom = NULL;
+    w->inv.gauden = &w->gauden;
+
+    if (w->mixw_reest)
+	mod_inv_alloc_mixw_acc(&w->inv);
+    if (w->tmat_reest)
+	mod_inv_alloc_tmat_acc(&w->inv);
+    if (w->mean_reest || w->var_reest)
+	mod_inv_alloc_gauden_acc(&w->inv);
+}
+
+static void
+bw_worker_free(bw_worker_t *w)
+{
+    if (w->inv.mixw_acc)
+	ckd_free_3d((void ***)w->inv.mixw_acc);
+    if (w->inv.l_mixw_acc)
+	ckd_free_3d((void ***)w->inv.l_mixw_acc);
+    if (w->inv.tmat_acc)
+	ckd_free_3d((void ***)w->inv.tmat_acc);
+    if (w->inv.l_tmat_acc)
+	ckd_free_2d((void **)w->inv.l_tmat_acc);
+    gauden_free_acc(&w->gauden);
+    gauden_free_l_acc(&w->gauden);
+}
+
+static int
+bw_worker_main(sbthread_t *th)
+{
+    bw_worker_t *w = sbthread_arg(th);
+    bw_batch_t *batch = w->batch;
+    bw_job_t *job;
+
+    while (TRUE) {
+	sbmtx_lock(batch->mtx);
+	if (batch->next < batch->n_jobs)
+	    job = &batch->jobs[batch->next++];
+	else
+	    job = NULL;
+	sbmtx_unlock(batch->mtx);
+
+	if (job == NULL)
+	    break;
+	if (job->state_seq == NULL)
+	    continue;
+
+	/* The local ID's in the sentence HMM refer to these */
+	w->inv.mixw_inverse = job->mixw_inverse;
+	w->inv.n_mixw_inverse = job->n_mixw_inverse;
+	w->inv.cb_inverse = job->cb_inverse;
+	w->inv.n_cb_inverse = job->n_cb_inverse;
+
+	ptmr_start(&w->busy);
+	if (w->profile)
+	    ptmr_start(&job->timers.upd_timer);
+	job->rv = baum_welch_update(&job->log_lik,
+				    job->f, job->n_frame,
+				    job->state_seq, job->n_state,
+				    &w->inv,
+				    w->a_beam,
+				    w->b_beam,
+				    w->spthresh,
+				    job->phseg,
+				    w->mixw_reest,
+				    w->tmat_reest,
+				    w->mean_reest,
+				    w->var_reest,
+				    w->pass2var,
+				    w->var_is_full,
+				    job->pdumpfh,
+				    w->profile ? &job->timers : NULL,
+				    w->feat,
+				    job->uttid,
+				    &job->stats);
+	if (w->profile) {
+	    /* The utterance took this as well as reading it. */
+	    ptmr_stop(&job->timers.upd_timer);
+	    job->timers.utt_timer.t_cpu += job->timers.upd_timer.t_cpu;
+	    job->timers.utt_timer.t_elapsed += job->timers.upd_timer.t_elapsed;
+	}
+	ptmr_stop(&w->busy);
+	if (job->rv == S3_SUCCESS) {
+	    w->n_utt++;
+	    w->n_frame += job->n_frame;
+	}
+    }
+
+    /* These belong to the jobs */
+    w->inv.mixw_inverse = NULL;
+    w->inv.cb_inverse = NULL;
+
+    return 0;
+}
+
+static void
+bw_job_free(bw_job_t *job)
+{
+    if (job->f)
+	feat_array_free(job->f);
+    if (job->state_seq)
+	state_seq_free(job->state_seq, job->n_state);
+    ckd_free(job->mixw_inverse);
+    ckd_free(job->cb_inverse);
+    if (job->phseg)
+	s3phseg_free(job->phseg);
+    if (job->pdumpfh)
+	fclose(job->pdumpfh);
+    ckd_free(job->uttid);
+}
+
+/*
+ * Get the features of the current utterance, from the feature cache
+ * if they are there, otherwise from its cepstra, which are only
+ * turned into features if the utterance is long enough to be used
+ * and no longer than maxuttlen.  Sets *out_f to NULL if it is not.
+ */
+static void
+read_utt_feat(feat_t *feat,
+	      uint32 maxuttlen,
+	      mfcc_t ****out_f,
+	      int32 *out_n_frame,
+	      int32 *out_n_frame_in)
+{
+    vector_t *mfcc;
+    int32 n_frame;
+
+    *out_f = NULL;
+    if (corpus_get_feat_cache(feat, out_f, out_n_frame,
+			      out_n_frame_in) == S3_SUCCESS) {
+	if (*out_n_frame_in < 9
+	    || (maxuttlen > 0 && *out_n_frame_in > maxuttlen)) {
+	    feat_array_free(*out_f);
+	    *out_f = NULL;
+	}
+	return;
+    }
+
+    if (corpus_get_generic_featurevec(&mfcc, &n_frame,
+				      cmd_ln_int32("-ceplen")) < 0) {
+	E_FATAL("Can't read input features\n");
+    }
+    *out_n_frame_in = n_frame;
+
+    if (n_frame >= 9 && (maxuttlen == 0 || n_frame <= maxuttlen)) {
+	*out_f = feat_array_alloc(feat, n_frame + feat_window_size(feat));
+	feat_s2mfc2feat_live(feat, mfcc, &n_frame, TRUE, TRUE, *out_f);
+	corpus_put_feat_cache(feat, *out_f, n_frame, *out_n_frame_in);
+    }
+    *out_n_frame = n_frame;
+
+    if (mfcc) {
+	ckd_free(mfcc[0]);
+	ckd_free(mfcc);
+    }
+}
+
+/*
+ * Read the next utterance and build its sentence HMM.  Returns 1 if
+ * it is ready for a worker, 0 if it was skipped, -1 at the end of
+ * the corpus.
+ */
+static int
+bw_job_read(bw_job_t *job,
+	    uint32 *n_frame_skipped,
+	    model_inventory_t *inv,
+	    lexicon_t *lex,
+	    model_def_t *mdef,
+	    feat_t *feat)
+{
+    mfcc_t ***f;
+    int32 n_frame, n_frame_in;
+    uint32 maxuttlen;
+    const char *pdumpdir;
+    state_t *state_seq;
+    char *trans;
+    ptmr_t utt_timer;
+
+    if (!corpus_next_utt())
+	return -1;
+
+    ptmr_init(&utt_timer);
+    ptmr_start(&utt_timer);
+
+    maxuttlen = cmd_ln_int32("-maxuttlen");
+    pdumpdir = cmd_ln_str("-pdumpdir");
+
+    read_utt_feat(feat, maxuttlen, &f, &n_frame, &n_frame_in);
+
+    if (n_frame_in < 9) {
+	E_WARN("utt %s too short\n", corpus_utt());
+	return 0;
+    }
+
+    if ((maxuttlen > 0) && (n_frame_in > maxuttlen)) {
+	E_INFO("utt # frames > -maxuttlen; skipping\n");
+	*n_frame_skipped += n_frame_in;
+	return 0;
+    }
+
+    memset(job, 0, sizeof(*job));
+    job->rv = S3_ERROR;
+    job->uttid = ckd_salloc(cmd_ln_int32("-outputfullpath")
+			    ? corpus_utt_full_name() : corpus_utt());
+    job->n_frame_in = n_frame_in;
+    job->f = f;
+    job->n_frame = n_frame;
+
+    corpus_get_sent(&trans);
+    corpus_get_phseg(inv->acmod_set, &job->phseg);
+
+    if (pdumpdir) {
+	char *pdumpfn;
+
+	pdumpfn = string_join(pdumpdir, "/", job->uttid, ".pdump", NULL);
+	if ((job->pdumpfh = fopen(pdumpfn, "w")) == NULL)
+	    E_FATAL_SYSTEM("Failed to open %s for writing", pdumpfn);
+	ckd_free(pdumpfn);
+    }
+
+    /* The sentence HMM and its ID maps are overwritten by the next
+     * utterance, so the worker gets its own copies. */
+    state_seq = next_utt_states(&job->n_state, lex, inv, mdef, trans);
+    if (state_seq == NULL) {
+	E_WARN("Skipped utterance '%s'\n", trans);
+    }
+    else {
+	job->state_seq = state_seq_copy(state_seq, job->n_state);
+	job->n_mixw_inverse = inv->n_mixw_inverse;
+	job->mixw_inverse = ckd_calloc(inv->n_mixw_inverse, sizeof(uint32));
+	memcpy(job->mixw_inverse, inv->mixw_inverse,
+	       inv->n_mixw_inverse * sizeof(uint32));
+	job->n_cb_inverse = inv->n_cb_inverse;
+	job->cb_inverse = ckd_calloc(inv->n_cb_inverse, sizeof(uint32));
+	memcpy(job->cb_inverse, inv->cb_inverse,
+	       inv->n_cb_inverse * sizeof(uint32));
+    }
+    free(trans);	/* alloc'ed using strdup() */
+
+    ptmr_stop(&utt_timer);
+    job->timers.utt_timer = utt_timer;
+
+    return 1;
+}
+
+/*
+ * Read up to max_jobs utterances, stopping early at a checkpoint or
+ * at the end of the corpus.
+ */
+static void
+bw_batch_read(bw_batch_t *batch,
+	      uint32 max_jobs,
+	      uint32 ckpt_intv,
+	      uint32 *seq_no,
+	      uint32 *n_utt,
+	      uint32 *n_frame_skipped,
+	      model_inventory_t *inv,
+	      lexicon_t *lex,
+	      model_def_t *mdef,
+	      feat_t *feat)
+{
+    int rv;
+
+    batch->n_jobs = 0;
+    batch->next = 0;
+    batch->ckpt = FALSE;
+    while (!batch->eof && !batch->ckpt && batch->n_jobs < max_jobs) {
+	rv = bw_job_read(&batch->jobs[batch->n_jobs], n_frame_skipped,
+			 inv, lex, mdef, feat);
+	if (rv < 0) {
+	    batch->eof = TRUE;
+	}
+	else if (rv > 0) {
+	    batch->jobs[batch->n_jobs++].seq_no = (*seq_no)++;
+	    ++*n_utt;
+	    if ((ckpt_intv > 0) &&
+		((*n_utt % ckpt_intv) == 0) &&
+		(cmd_ln_str("-accumdir") != NULL))
+		batch->ckpt = TRUE;
+	}
+    }
+}
+
+static void
+reestimate_parallel(model_inventory_t *inv,
+		    lexicon_t *lex,
+		    model_def_t *mdef,
+		    feat_t *feat,
+		    uint32 n_thread,
+		    uint32 seq_no,
+		    uint32 ckpt_intv,
+		    uint32 *total_frames,
+		    float64 *total_log_lik,
+		    uint32 *n_frame_skipped)
+{
+    bw_worker_t *workers;
+    bw_batch_t batch[2], *cur, *next, *tmp;
+    uint32 max_jobs, n_utt, i;
+    int32 profile = cmd_ln_int32("-timing");
+
+    workers = ckd_calloc(n_thread, sizeof(*workers));
+    for (i = 0; i < n_thread; i++)
+	bw_worker_init(&workers[i], inv, feat);
+
+    max_jobs = n_thread * JOBS_PER_THREAD;
+    memset(batch, 0, sizeof(batch));
+    for (i = 0; i < 2; i++) {
+	batch[i].jobs = ckd_calloc(max_jobs, sizeof(bw_job_t));
+	batch[i].mtx = sbmtx_init();
+    }
+    cur = &batch[0];
+    next = &batch[1];
+
+    n_utt = 0;
+    bw_batch_read(cur, max_jobs, ckpt_intv, &seq_no, &n_utt,
+		  n_frame_skipped, inv, lex, mdef, feat);
+    while (cur->n_jobs > 0) {
+	for (i = 0; i < n_thread; i++) {
+	    workers[i].batch = cur;
+	    if ((workers[i].thread = sbthread_start(NULL, bw_worker_main,
+						    &workers[i])) == NULL)
+		E_FATAL("Failed to start worker thread %u\n", i);
+	}
+
+	/* Read the next batch while this one is being done, unless
+	 * the corpus has to stay put for a checkpoint. */
+	next->n_jobs = 0;
+	next->eof = cur->eof;
+	if (!cur->ckpt)
+	    bw_batch_read(next, max_jobs, ckpt_intv, &seq_no, &n_utt,
+			  n_frame_skipped, inv, lex, mdef, feat);
+
+	for (i = 0; i < n_thread; i++) {
+	    sbthread_free(workers[i].thread);
+	    workers[i].thread = NULL;
+	}
+
+	for (i = 0; i < cur->n_jobs; i++) {
+	    bw_job_t *job = &cur->jobs[i];
+
+	    printf("utt> %5u %25s %4u %4u %5u",
+		   job->seq_no, job->uttid,
+		   job->n_frame_in, job->n_frame - job->n_frame_in,
+		   job->n_state);
+	    bw_utt_stats_print(&job->stats);
+	    if (job->state_seq && job->rv == S3_SUCCESS) {
+		*total_frames += job->n_frame;
+		*total_log_lik += job->log_lik;
+		printf(" %e %e",
+		       (job->n_frame > 0 ? job->log_lik / job->n_frame : 0.0),
+		       job->log_lik);
+	    }
+	    if (profile)
+		print_all_timers(&job->timers, job->n_frame);
+	    printf("\n");
+	    bw_job_free(job);
+	}
+	fflush(stdout);
+
+	if (cur->ckpt) {
+	    for (i = 0; i < n_thread; i++)
+		accum_merge(inv, &workers[i].inv,
+			    workers[i].mixw_reest,
+			    workers[i].tmat_reest,
+			    workers[i].mean_reest,
+			    workers[i].var_reest,
+			    workers[i].var_is_full);
+	    dump_ckpt(inv,
+		      workers[0].mixw_reest,
+		      workers[0].tmat_reest,
+		      workers[0].mean_reest,
+		      workers[0].var_reest,
+		      workers[0].pass2var,
+		      workers[0].var_is_full);
+	    bw_batch_read(next, max_jobs, ckpt_intv, &seq_no, &n_utt,
+			  n_frame_skipped, inv, lex, mdef, feat);
+	}
+
+	tmp = cur;
+	cur = next;
+	next = tmp;
+    }
+
+    for (i = 0; i < n_thread; i++) {
+	E_INFO("Thread %u: %u utts, %u frames, %.2f sec busy\n",
+	       i, workers[i].n_utt, workers[i].n_frame,
+	       workers[i].busy.t_tot_elapsed);
+	accum_merge(inv, &workers[i].inv,
+		    workers[i].mixw_reest,
+		    workers[i].tmat_reest,
+		    workers[i].mean_reest,
+		    workers[i].var_reest,
+		    workers[i].var_is_full);
+	bw_worker_free(&workers[i]);
+    }
+    ckd_free(workers);
+    for (i = 0; i < 2; i++) {
+	ckd_free(batch[i].jobs);
+	sbmtx_free(batch[i].mtx);
+    }
+}
+
 void
 main_reestimate(model_inventory_t *inv,
 		lexicon_t *lex,
@@ -619,9 +1181,8 @@ main_reestimate(model_inventory_t *inv,
 		feat_t *feat,
 		int32 viterbi)
 {
-    vector_t *mfcc;	/* utterance cepstra */	
     int32 n_frame;	/* # of cepstrum frames  */
-    uint32 svd_n_frame;	/* # of cepstrum frames  */
+    int32 svd_n_frame;	/* # of cepstrum frames  */
     vector_t **f;		/* independent feature streams derived
 				 * from cepstra */
     state_t *state_seq;		/* sentence HMM state sequence for the
@@ -629,6 +1190,8 @@ main_reestimate(model_inventory_t *inv,
     uint32 n_state = 0;	/* # of sentence HMM states */
     float64 total_log_lik;	/* total log liklihood over corpus */
     float64 log_lik;		/* log liklihood for an utterance */
+    bw_utt_stats_t stats;	/* state statistics for an utterance */
+    int32 rv;
     uint32 total_frames;	/* # of frames over the corpus */
     float64 a_beam;		/* alpha pruning beam */
     float64 b_beam;		/* beta pruning beam */
@@ -641,7 +1204,6 @@ main_reestimate(model_inventory_t *inv,
     char *trans;
     const char *pdumpdir;
     FILE *pdumpfh;
-    uint32 in_veclen;
 
     bw_timers_t* timers = NULL;
     int32 profile;
@@ -662,6 +1224,8 @@ main_reestimate(model_inventory_t *inv,
     uint32 outputfullpath = 0;
     uint32 fullsuffixmatch = 0;
 
+    uint32 n_thread;
+
     E_INFO("Reestimation: %s\n",
 	(viterbi ? "Viterbi" : "Baum-Welch"));
 
@@ -694,12 +1258,23 @@ main_reestimate(model_inventory_t *inv,
     pass2var = cmd_ln_int32("-2passvar");
     var_is_full = cmd_ln_int32("-fullvar");
     pdumpdir = cmd_ln_str("-pdumpdir");
-    in_veclen = cmd_ln_int32("-ceplen");
 
     if (cmd_ln_str("-ckptintv")) {
 	ckpt_intv = cmd_ln_int32("-ckptintv");
     }
 
+    n_thread = cmd_ln_int32("-nthreads") > 1 ? cmd_ln_int32("-nthreads") : 1;
+    if (n_thread > 1 && viterbi) {
+	E_WARN("-nthreads is not supported for Viterbi training, using one thread\n");
+	n_thread = 1;
+    }
+    if (n_thread > 1 && cmd_ln_str("-outphsegdir")) {
+	E_WARN("-nthreads is not supported with -outphsegdir, using one thread\n");
+	n_thread = 1;
+    }
+    if (n_thread > 1)
+	E_INFO("Running forward-backward in %u threads\n", n_thread);
+
     if (cmd_ln_str("-accumdir") == NULL) {
 	E_WARN("NO ACCUMDIR SET.  No counts will be written; assuming debug\n");
     }
@@ -742,7 +1317,17 @@ main_reestimate(model_inventory_t *inv,
 
     n_utt = 0;
 
-    while (corpus_next_utt()) {
+    if (n_thread > 1) {
+	if (timers)
+	    ptmr_start(&timers->utt_timer);
+	reestimate_parallel(inv, lex, mdef, feat, n_thread, seq_no, ckpt_intv,
+			    &total_frames, &total_log_lik, &n_frame_skipped);
+	if (timers)
+	    ptmr_stop(&timers->utt_timer);
+    }
+
+    /* Otherwise, one utterance at a time in this thread. */
+    while (n_thread == 1 && corpus_next_utt()) {
 	/* Zero timers before utt processing begins */
 	if (timers) {
 	    ptmr_reset(&timers->utt_timer);
@@ -762,37 +1347,21 @@ main_reestimate(model_inventory_t *inv,
 	       seq_no,
 	       (outputfullpath ? corpus_utt_full_name() : corpus_utt()));
 
-        if (corpus_get_generic_featurevec(&mfcc, &n_frame, in_veclen) < 0) {
-	        E_FATAL("Can't read input features\n");
-	}
+	read_utt_feat(feat, maxuttlen, &f, &n_frame, &svd_n_frame);
 
-	printf(" %4u", n_frame);
+	printf(" %4u", svd_n_frame);
 
-	if (n_frame < 9) {
+	if (svd_n_frame < 9) {
 	    E_WARN("utt %s too short\n", corpus_utt());
-	    if (mfcc) {
-		ckd_free(mfcc[0]);
-		ckd_free(mfcc);
-	    }
 	    continue;
 	}
 
-	if ((maxuttlen > 0) && (n_frame > maxuttlen)) {
+	if ((maxuttlen > 0) && (svd_n_frame > maxuttlen)) {
 	    E_INFO("utt # frames > -maxuttlen; skipping\n");
-	    n_frame_skipped += n_frame;
-	    if (mfcc) {
-		ckd_free(mfcc[0]);
-		ckd_free(mfcc);
-	    }
-
+	    n_frame_skipped += svd_n_frame;
 	    continue;
 	}
 
-	svd_n_frame = n_frame;
-
-	f = feat_array_alloc(feat, n_frame + feat_window_size(feat));
-	feat_s2mfc2feat_live(feat, mfcc, &n_frame, TRUE, TRUE, f);
-
 	printf(" %4u", n_frame - svd_n_frame);
 
 	/* Get the transcript */
@@ -830,23 +1399,28 @@ main_reestimate(model_inventory_t *inv,
 	    E_WARN("Skipped utterance '%s'\n", trans);
 	} else if (!viterbi) {
 	    /* accumulate reestimation sums for the utterance */
-	    if (baum_welch_update(&log_lik,
-				  f, n_frame,
-				  state_seq, n_state,
-				  inv,
-				  a_beam,
-				  b_beam,
-				  spthresh,
-				  phseg,
-				  mixw_reest,
-				  tmat_reest,
-				  mean_reest,
-				  var_reest,
-				  pass2var,
-				  var_is_full,
-				  pdumpfh,
-				  timers,
-				  feat) == S3_SUCCESS) {
+	    memset(&stats, 0, sizeof(stats));
+	    rv = baum_welch_update(&log_lik,
+				   f, n_frame,
+				   state_seq, n_state,
+				   inv,
+				   a_beam,
+				   b_beam,
+				   spthresh,
+				   phseg,
+				   mixw_reest,
+				   tmat_reest,
+				   mean_reest,
+				   var_reest,
+				   pass2var,
+				   var_is_full,
+				   pdumpfh,
+				   timers,
+				   feat,
+				   (outputfullpath ? corpus_utt_full_name() : corpus_utt()),
+				   &stats);
+	    bw_utt_stats_print(&stats);
+	    if (rv == S3_SUCCESS) {
 		total_frames += n_frame;
 		total_log_lik += log_lik;
 		
@@ -886,8 +1460,6 @@ main_reestimate(model_inventory_t *inv,
 
 	if (pdumpfh)
 		fclose(pdumpfh);
-	free(mfcc[0]);
-	ckd_free(mfcc);
 	feat_array_free(f);
 	free(trans);	/* alloc'ed using strdup() */
 
@@ -906,39 +1478,13 @@ main_reestimate(model_inventory_t *inv,
 	if ((ckpt_intv > 0) &&
 	    ((n_utt % ckpt_intv) == 0) &&
 	    (cmd_ln_str("-accumdir") != NULL)) {
-	    while (accum_dump(cmd_ln_str("-accumdir"),
-			      inv,
-			      mixw_reest,
-			      tmat_reest,
-			      mean_reest,
-			      var_reest,
-			      pass2var,
-			      var_is_full,
-			      TRUE) != S3_SUCCESS) {
-		static int notified = FALSE;
-		time_t t;
-		char time_str[64];
-		
-		/*
-		 * If we were not able to dump the parameters, write one log entry
-		 * about the failure
-		 */
-		if (notified == FALSE) {
-		    t = time(NULL);
-		    strcpy(time_str, (const char *)ctime((const time_t *)&t));
-		    /* nuke the newline at the end of this. */
-		    time_str[strlen(time_str)-1] = '\0';
-		    E_WARN("Ckpt count dump failed on %s.  Retrying dump every %3.1f hour until success.\n",
-			   time_str, DUMP_RETRY_PERIOD/3600.0);
-		    
-		    notified = TRUE;
-		    no_retries++;
-		    if(no_retries>10){ 
-		      E_FATAL("Failed to get the files after 10 retries(about 5 minutes).\n ");
-		    }
-		}
-		sleep(DUMP_RETRY_PERIOD);
-	    }
+	    dump_ckpt(inv,
+		      mixw_reest,
+		      tmat_reest,
+		      mean_reest,
+		      var_reest,
+		      pass2var,
+		      var_is_full);
 	}
     }
 
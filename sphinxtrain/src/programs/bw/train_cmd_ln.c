@@ -511,7 +511,37 @@ If yo want to do parallel training for N machines. Run N trainers with \n\
 	  ARG_INT32,
 	  NULL,
 	  "Checkpoint the reestimation sums every -chkptintv utts" },
-	
+
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads doing forward-backward on separate utterances (Baum-Welch only)" },
+
+	{ "-simd",
+	  ARG_STRING,
+	  "auto",
+	  "Vector instructions for Gaussian evaluation: auto, none, sse2, avx2" },
+
+	{ "-simdtol",
+	  ARG_FLOAT64,
+	  "0",
+	  "If > 0, check vectorized Gaussian evaluation against the scalar code and stop if a log density differs by more than this" },
+
+	{ "-alphackpt",
+	  ARG_INT32,
+	  "0",
+	  "Checkpoint the forward pass of utterances longer than this many frames, keeping alphas only every sqrt(frames) frames and recomputing the rest in the backward pass (0 never does)" },
+
+	{ "-prefetch",
+	  ARG_INT32,
+	  "0",
+	  "Read the cepstra of this many utterances ahead in a background thread (0 reads each one when it is needed)" },
+
+	{ "-featcachedir",
+	  ARG_STRING,
+	  NULL,
+	  "Keep the computed features of each utterance in this directory and reuse them in later iterations; features made with other parameters are recomputed, and none are kept with -cmn prior or -agc emax" },
+
 	{ "-outputfullpath",
 	  ARG_BOOLEAN,
 	  "no",
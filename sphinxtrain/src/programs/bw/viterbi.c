@@ -293,6 +293,7 @@ viterbi_update(float64 *log_forw_prob,
 			 * of observing the input given the model */
     uint32 max_n_next = 0;
     uint32 n_cb;
+    bw_utt_stats_t stats;
 
     static float64 *p_op = NULL;
     static float64 *p_ci_op = NULL;
@@ -331,10 +332,12 @@ viterbi_update(float64 *log_forw_prob,
     /* Run forward algorithm, which has embedded Viterbi. */
     if (timers)
 	ptmr_start(&timers->fwd_timer);
+    memset(&stats, 0, sizeof(stats));
     ret = forward(active_alpha, active_astate, n_active_astate, bp,
 		  scale, dscale,
 		  feature, n_obs, state_seq, n_state,
-		  inv, a_beam, phseg, timers, 0);
+		  inv, a_beam, phseg, timers, &stats, 0, NULL);
+    bw_utt_stats_print(&stats);
     /* Dump a phoneme segmentation if requested */
     if (cmd_ln_str("-outphsegdir")) {
 	    const char *phsegdir;
@@ -733,7 +736,7 @@ mmi_viterbi_run(float64 *log_forw_prob,
     ret = forward(active_alpha, active_astate, n_active_astate, bp,
 		  scale, dscale,
 		  feature, n_obs, state_seq, n_state,
-		  inv, a_beam, NULL, NULL, 1);
+		  inv, a_beam, NULL, NULL, NULL, 0, NULL);
 
     if (ret != S3_SUCCESS) {
 
@@ -869,7 +872,7 @@ mmi_viterbi_update(vector_t **feature,
     ret = forward(active_alpha, active_astate, n_active_astate, bp,
 		  scale, dscale,
 		  feature, n_obs, state_seq, n_state,
-		  inv, a_beam, NULL, NULL, 1);
+		  inv, a_beam, NULL, NULL, NULL, 0, NULL);
     
     if (cmd_ln_str("-outphsegdir")) {
 	E_FATAL("current MMI implementation don't support -outphsegdir\n");
@@ -58,6 +58,7 @@
 #include <s3/mllr_io.h>
 
 #include <sphinxbase/matrix.h>
+#include <sphinxbase/sbthread.h>
 
 #include <sys_compat/file.h>
 #include <sys_compat/misc.h>
@@ -84,6 +85,284 @@ initialize(int argc,
 }
 
 
+/*
+ * With -nthreads, each thread adds up the counts from its share of the
+ * accumulator directories, and then pairs of threads merge their
+ * sums, halving their number each round until one is left.
+ */
+
+/* Reestimation sums read from some of the accumulator directories */
+typedef struct norm_acc_s {
+    const char **accum_dir;	/* Directories to read */
+    uint32 n_dir;
+
+    float32 ***mixw_acc;
+    uint32 n_mixw;
+    uint32 n_stream;
+    uint32 n_density;
+
+    float32 ***tmat_acc;
+    uint32 n_tmat;
+    uint32 n_state_pm;
+
+    vector_t ***wt_mean;
+    vector_t ***wt_var;
+    vector_t ****wt_fullvar;
+    int32 pass2var;
+    float32 ***dnom;
+    uint32 n_mgau;
+    uint32 n_gau_stream;
+    uint32 n_gau_density;
+    uint32 *veclen;
+
+    struct norm_acc_s *other;	/* Sums to merge into these ones */
+    int err;
+} norm_acc_t;
+
+static void
+rdacc_dir(norm_acc_t *acc, const char *dir)
+{
+    int32 var_is_full = cmd_ln_int32("-fullvar");
+
+    E_INFO("Reading and accumulating counts from %s\n", dir);
+
+    if (cmd_ln_str("-mixwfn")) {
+	rdacc_mixw(dir,
+		   &acc->mixw_acc, &acc->n_mixw,
+		   &acc->n_stream, &acc->n_density);
+    }
+
+    if (cmd_ln_str("-tmatfn")) {
+	rdacc_tmat(dir,
+		   &acc->tmat_acc, &acc->n_tmat, &acc->n_state_pm);
+    }
+
+    if (cmd_ln_str("-meanfn") || cmd_ln_str("-varfn")) {
+	if (var_is_full)
+	    rdacc_den_full(dir,
+			   &acc->wt_mean,
+			   &acc->wt_fullvar,
+			   &acc->pass2var,
+			   &acc->dnom,
+			   &acc->n_mgau,
+			   &acc->n_gau_stream,
+			   &acc->n_gau_density,
+			   &acc->veclen);
+	else
+	    rdacc_den(dir,
+		      &acc->wt_mean,
+		      &acc->wt_var,
+		      &acc->pass2var,
+		      &acc->dnom,
+		      &acc->n_mgau,
+		      &acc->n_gau_stream,
+		      &acc->n_gau_density,
+		      &acc->veclen);
+
+	if (cmd_ln_str("-mixwfn")) {
+	    if (acc->n_stream != acc->n_gau_stream) {
+		E_ERROR("mixw inconsistent w/ densities WRT # "
+			"streams (%u != %u)\n",
+			acc->n_stream, acc->n_gau_stream);
+	    }
+
+	    if (acc->n_density != acc->n_gau_density) {
+		E_ERROR("mixw inconsistent w/ densities WRT # "
+			"den/mix (%u != %u)\n",
+			acc->n_density, acc->n_gau_density);
+	    }
+	}
+	else {
+	    acc->n_stream = acc->n_gau_stream;
+	    acc->n_density = acc->n_gau_density;
+	}
+    }
+}
+
+static int
+rdacc_thread(sbthread_t *th)
+{
+    norm_acc_t *acc = sbthread_arg(th);
+    uint32 i;
+
+    for (i = 0; i < acc->n_dir; i++)
+	rdacc_dir(acc, acc->accum_dir[i]);
+
+    return 0;
+}
+
+/* Add the sums in acc->other to acc, and free them */
+static int
+merge_thread(sbthread_t *th)
+{
+    norm_acc_t *acc = sbthread_arg(th);
+    norm_acc_t *other = acc->other;
+    uint32 i;
+
+    if (acc->mixw_acc == NULL && acc->wt_mean == NULL) {
+	acc->n_stream = other->n_stream;
+	acc->n_density = other->n_density;
+    }
+
+    if (other->mixw_acc) {
+	if (acc->mixw_acc == NULL) {
+	    acc->mixw_acc = other->mixw_acc;
+	    acc->n_mixw = other->n_mixw;
+	}
+	else if (acc->n_mixw != other->n_mixw
+		 || acc->n_stream != other->n_stream
+		 || acc->n_density != other->n_density) {
+	    E_ERROR("Mixing weight counts have different sizes "
+		    "(%ux%ux%u != %ux%ux%u)\n",
+		    other->n_mixw, other->n_stream, other->n_density,
+		    acc->n_mixw, acc->n_stream, acc->n_density);
+	    acc->err = TRUE;
+	    ckd_free_3d((void ***)other->mixw_acc);
+	}
+	else {
+	    accum_3d(acc->mixw_acc, other->mixw_acc,
+		     acc->n_mixw, acc->n_stream, acc->n_density);
+	    ckd_free_3d((void ***)other->mixw_acc);
+	}
+    }
+    if (other->tmat_acc) {
+	if (acc->tmat_acc == NULL) {
+	    acc->tmat_acc = other->tmat_acc;
+	    acc->n_tmat = other->n_tmat;
+	    acc->n_state_pm = other->n_state_pm;
+	}
+	else if (acc->n_tmat != other->n_tmat
+		 || acc->n_state_pm != other->n_state_pm) {
+	    E_ERROR("Transition matrix counts have different sizes "
+		    "(%ux%u != %ux%u)\n",
+		    other->n_tmat, other->n_state_pm,
+		    acc->n_tmat, acc->n_state_pm);
+	    acc->err = TRUE;
+	    ckd_free_3d((void ***)other->tmat_acc);
+	}
+	else {
+	    accum_3d(acc->tmat_acc, other->tmat_acc,
+		     acc->n_tmat, acc->n_state_pm - 1, acc->n_state_pm);
+	    ckd_free_3d((void ***)other->tmat_acc);
+	}
+    }
+
+    if (other->wt_mean) {
+	if (acc->wt_mean == NULL) {
+	    acc->wt_mean = other->wt_mean;
+	    acc->wt_var = other->wt_var;
+	    acc->wt_fullvar = other->wt_fullvar;
+	    acc->pass2var = other->pass2var;
+	    acc->dnom = other->dnom;
+	    acc->n_mgau = other->n_mgau;
+	    acc->n_gau_stream = other->n_gau_stream;
+	    acc->n_gau_density = other->n_gau_density;
+	    acc->veclen = other->veclen;
+	    other->veclen = NULL;
+	}
+	else {
+	    int err = FALSE;
+
+	    if (acc->n_mgau != other->n_mgau
+		|| acc->n_gau_stream != other->n_gau_stream
+		|| acc->n_gau_density != other->n_gau_density) {
+		E_ERROR("Gaussian density counts have different sizes "
+			"(%ux%ux%u != %ux%ux%u)\n",
+			other->n_mgau, other->n_gau_stream, other->n_gau_density,
+			acc->n_mgau, acc->n_gau_stream, acc->n_gau_density);
+		err = TRUE;
+	    }
+	    for (i = 0; !err && i < acc->n_gau_stream; i++) {
+		if (acc->veclen[i] != other->veclen[i]) {
+		    E_ERROR("vector length of stream %u (== %u) != prior length (== %u)\n",
+			    i, other->veclen[i], acc->veclen[i]);
+		    err = TRUE;
+		}
+	    }
+	    if (acc->pass2var != other->pass2var) {
+		E_ERROR("2 pass var %s in some accumulators, but %s in others.\n",
+			(other->pass2var ? "true" : "false"),
+			(acc->pass2var ? "true" : "false"));
+		err = TRUE;
+	    }
+
+	    if (!err) {
+		accum_3d(acc->dnom, other->dnom,
+			 acc->n_mgau, acc->n_gau_stream, acc->n_gau_density);
+		gauden_accum_param(acc->wt_mean, other->wt_mean,
+				   acc->n_mgau, acc->n_gau_stream,
+				   acc->n_gau_density, acc->veclen);
+		if (acc->wt_var && other->wt_var)
+		    gauden_accum_param(acc->wt_var, other->wt_var,
+				       acc->n_mgau, acc->n_gau_stream,
+				       acc->n_gau_density, acc->veclen);
+		if (acc->wt_fullvar && other->wt_fullvar)
+		    gauden_accum_param_full(acc->wt_fullvar, other->wt_fullvar,
+					    acc->n_mgau, acc->n_gau_stream,
+					    acc->n_gau_density, acc->veclen);
+	    }
+	    else
+		acc->err = TRUE;
+
+	    ckd_free_3d((void ***)other->dnom);
+	    gauden_free_param(other->wt_mean);
+	    if (other->wt_var)
+		gauden_free_param(other->wt_var);
+	    if (other->wt_fullvar)
+		gauden_free_param_full(other->wt_fullvar);
+	}
+    }
+    ckd_free(other->veclen);
+    acc->err |= other->err;
+
+    return 0;
+}
+
+/* Read the counts from all n_dir accumulator directories using
+ * n_thread threads, leaving the total in acc[0] */
+static int
+rdacc_parallel(norm_acc_t *acc, const char **accum_dir, uint32 n_dir,
+	       uint32 n_thread)
+{
+    sbthread_t **threads;
+    uint32 i, step;
+
+    threads = ckd_calloc(n_thread, sizeof(*threads));
+
+    /* Give each thread a contiguous run of directories */
+    for (i = 0; i < n_thread; i++) {
+	acc[i].accum_dir = accum_dir + (size_t)n_dir * i / n_thread;
+	acc[i].n_dir = (size_t)n_dir * (i + 1) / n_thread
+	    - (size_t)n_dir * i / n_thread;
+	if ((threads[i] = sbthread_start(NULL, rdacc_thread,
+					 &acc[i])) == NULL)
+	    E_FATAL("Failed to start thread %u\n", i);
+    }
+    for (i = 0; i < n_thread; i++) {
+	sbthread_wait(threads[i]);
+	sbthread_free(threads[i]);
+    }
+
+    /* Merge them pairwise */
+    for (step = 1; step < n_thread; step *= 2) {
+	E_INFO("Merging counts from %u threads\n",
+	       (n_thread + step - 1) / step);
+	for (i = 0; i + step < n_thread; i += 2 * step) {
+	    acc[i].other = &acc[i + step];
+	    if ((threads[i] = sbthread_start(NULL, merge_thread,
+					     &acc[i])) == NULL)
+		E_FATAL("Failed to start thread %u\n", i);
+	}
+	for (i = 0; i + step < n_thread; i += 2 * step) {
+	    sbthread_wait(threads[i]);
+	    sbthread_free(threads[i]);
+	}
+    }
+    ckd_free(threads);
+
+    return acc[0].err ? S3_ERROR : S3_SUCCESS;
+}
+
 static int
 normalize()
 {
@@ -123,6 +402,8 @@ normalize()
     const char *out_var_fn;
     const char *out_dcount_fn;
     
+    norm_acc_t *acc;
+    uint32 n_dir, n_thread;
     int err;
     uint32 no_retries=0;
 
@@ -202,61 +483,41 @@ normalize()
 	ckd_free(veclen);
     }
 
-    n_stream = 0;
-    for (i = 0; accum_dir[i]; i++) {
-	E_INFO("Reading and accumulating counts from %s\n", accum_dir[i]);
-
-	if (out_mixw_fn) {
-	    rdacc_mixw(accum_dir[i],
-		       &mixw_acc, &n_mixw, &n_stream, &n_density);
-	}
-
-	if (out_tmat_fn) {
-	    rdacc_tmat(accum_dir[i],
-		       &tmat_acc, &n_tmat, &n_state_pm);
-	}
-
-	if (out_mean_fn || out_var_fn) {
-	    if (var_is_full)
-		rdacc_den_full(accum_dir[i],
-			       &wt_mean,
-			       &wt_fullvar,
-			       &pass2var,
-			       &dnom,
-			       &n_mgau,
-			       &n_gau_stream,
-			       &n_gau_density,
-			       &veclen);
-	    else
-		rdacc_den(accum_dir[i],
-			  &wt_mean,
-			  &wt_var,
-			  &pass2var,
-			  &dnom,
-			  &n_mgau,
-			  &n_gau_stream,
-			  &n_gau_density,
-			  &veclen);
-
-	    if (out_mixw_fn) {
-		if (n_stream != n_gau_stream) {
-		    E_ERROR("mixw inconsistent w/ densities WRT # "
-			    "streams (%u != %u)\n",
-			    n_stream, n_gau_stream);
-		}
+    for (n_dir = 0; accum_dir[n_dir]; n_dir++)
+	;
+    n_thread = cmd_ln_int32("-nthreads") > 1 ? cmd_ln_int32("-nthreads") : 1;
+    if (n_thread > n_dir)
+	n_thread = n_dir;
+    acc = ckd_calloc(n_thread, sizeof(*acc));
+    if (n_thread > 1) {
+	E_INFO("Reading counts in %u threads\n", n_thread);
+	if (rdacc_parallel(acc, accum_dir, n_dir, n_thread) != S3_SUCCESS)
+	    E_FATAL("Failed to merge counts\n");
+    }
+    else {
+	for (i = 0; i < n_dir; i++)
+	    rdacc_dir(acc, accum_dir[i]);
+    }
 
-		if (n_density != n_gau_density) {
-		    E_ERROR("mixw inconsistent w/ densities WRT # "
-			    "den/mix (%u != %u)\n",
-			    n_density, n_gau_density);
-		}
-	    }
-	    else {
-		n_stream = n_gau_stream;
-		n_density = n_gau_density;
-	    }
-	}
+    mixw_acc = acc->mixw_acc;
+    n_mixw = acc->n_mixw;
+    n_stream = acc->n_stream;
+    n_density = acc->n_density;
+    tmat_acc = acc->tmat_acc;
+    n_tmat = acc->n_tmat;
+    n_state_pm = acc->n_state_pm;
+    wt_mean = acc->wt_mean;
+    wt_var = acc->wt_var;
+    wt_fullvar = acc->wt_fullvar;
+    pass2var = acc->pass2var;
+    dnom = acc->dnom;
+    if (dnom) {
+	n_mgau = acc->n_mgau;
+	n_gau_stream = acc->n_gau_stream;
+	n_gau_density = acc->n_gau_density;
     }
+    veclen = acc->veclen;
+    ckd_free(acc);
 
     if (oaccum_dir && mixw_acc) {
 	/* write the total mixing weight reest. accumulators */
@@ -142,6 +142,10 @@ norm \n\
 	  ARG_BOOLEAN,
 	  "no",
 	  "Tie all covariances together"},
+	{ "-nthreads",
+	  ARG_INT32,
+	  "1",
+	  "Number of threads reading and adding up the accumulator directories; each one holds a full set of counts (not for MMIE)"},
 	{ "-mmie",
 	  ARG_BOOLEAN,
 	  "no",